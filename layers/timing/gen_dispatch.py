@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+"""Generate the timing layer's dispatch tables and wrappers from vk.xml.
+
+Every command whose first parameter is a dispatchable handle gets a
+wrapper that times the call into the next layer. Commands the layer
+implements by hand (instance/device creation and destruction, the
+proc address queries) only get a call id. Global commands and the
+device layer/extension queries are not intercepted.
+
+Writes, into OUT_DIR:
+  vk_timing_dispatch.h   call ids and names, dispatch tables, loaders
+  vk_timing_wrappers.inc wrapper functions and the lookup table
+
+Usage:
+  python3 layers/timing/gen_dispatch.py VK_XML OUT_DIR
+"""
+
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+INSTANCE_HANDLES = {'VkInstance', 'VkPhysicalDevice'}
+DEVICE_HANDLES = {'VkDevice', 'VkQueue', 'VkCommandBuffer'}
+
+# Implemented in vk_timing_layer.cpp, still timed where they go down the chain
+MANUAL = {
+    'vkDestroyInstance',
+    'vkCreateDevice',
+    'vkDestroyDevice',
+    'vkGetInstanceProcAddr',
+    'vkGetDeviceProcAddr',
+}
+
+# Passed through untouched
+SKIPPED = {
+    'vkEnumerateDeviceLayerProperties',
+    'vkEnumerateDeviceExtensionProperties',
+}
+
+
+def for_vulkan(elem, attr='api'):
+    """True unless the element is restricted to other APIs (e.g. vulkansc)."""
+    api = elem.get(attr)
+    return api is None or 'vulkan' in api.split(',')
+
+
+def inner_text(elem):
+    """Element text without <comment> children."""
+    text = elem.text or ''
+    for child in elem:
+        if child.tag != 'comment':
+            text += inner_text(child)
+        text += child.tail or ''
+    return ' '.join(text.split())
+
+
+class Command:
+    def __init__(self, name, ret, params):
+        self.name = name
+        self.ret = ret
+        self.params = params      # [(decl, name, type)]
+        self.protect = None
+        self.level = None
+
+    @property
+    def field(self):
+        return self.name[2:]
+
+
+def load_commands(path):
+    root = ET.parse(path).getroot()
+
+    protects = {}
+    for p in root.iter('platform'):
+        protects[p.get('name')] = p.get('protect')
+
+    definitions = {}
+    aliases = {}
+
+    for cmd in root.find('commands'):
+        if not for_vulkan(cmd):
+            continue
+
+        if cmd.get('alias'):
+            aliases[cmd.get('name')] = cmd.get('alias')
+            continue
+
+        proto = cmd.find('proto')
+        name = proto.find('name').text
+        full = inner_text(proto)
+        ret = full[:full.rfind(name)].strip()
+
+        params = []
+        for p in cmd.findall('param'):
+            if not for_vulkan(p):
+                continue
+            params.append((inner_text(p), p.find('name').text, p.find('type').text))
+
+        definitions[name] = Command(name, ret, params)
+
+    for alias, target in aliases.items():
+        base = definitions[target]
+        definitions[alias] = Command(alias, base.ret, base.params)
+
+    # Only commands some Vulkan version or extension actually requires.
+    # A command counts as core or unguarded if any requirer is.
+    required = {}
+
+    for feature in root.findall('feature'):
+        if not for_vulkan(feature):
+            continue
+        for req in feature.findall('require'):
+            if not for_vulkan(req):
+                continue
+            for c in req.findall('command'):
+                required[c.get('name')] = None
+
+    for ext in root.find('extensions'):
+        if not for_vulkan(ext, 'supported'):
+            continue
+        protect = protects.get(ext.get('platform'))
+        for req in ext.findall('require'):
+            if not for_vulkan(req):
+                continue
+            for c in req.findall('command'):
+                name = c.get('name')
+                if name in required and required[name] is None:
+                    continue
+                required[name] = protect
+
+    commands = []
+
+    for name in sorted(required):
+        cmd = definitions.get(name)
+        if cmd is None or not cmd.params or name in SKIPPED:
+            continue
+
+        first = cmd.params[0][2]
+        if first in INSTANCE_HANDLES:
+            cmd.level = 'instance'
+        elif first in DEVICE_HANDLES:
+            cmd.level = 'device'
+        else:
+            continue
+
+        cmd.protect = required[name]
+        commands.append(cmd)
+
+    return commands
+
+
+def guarded(lines, cmd, body):
+    if cmd.protect:
+        lines.append(f'#ifdef {cmd.protect}')
+    lines.extend(body)
+    if cmd.protect:
+        lines.append('#endif')
+
+
+def write_dispatch(commands, source):
+    lines = [
+        f'// Generated by gen_dispatch.py from {source}, do not edit.',
+        '#pragma once',
+        '',
+        'namespace vk_timing {',
+        '',
+        '  enum CallId : uint32_t {',
+    ]
+    for cmd in commands:
+        lines.append(f'    Call_{cmd.name},')
+    lines += [
+        '    CallCount',
+        '  };',
+        '',
+        '  static const char* const CallNames[CallCount] = {',
+    ]
+    for cmd in commands:
+        lines.append(f'    "{cmd.name}",')
+    lines += ['  };', '']
+
+    for level, handle in (('instance', 'VkInstance'), ('device', 'VkDevice')):
+        table = level.capitalize() + 'Dispatch'
+        lines.append(f'  struct {table} {{')
+        for cmd in commands:
+            if cmd.level == level:
+                guarded(lines, cmd, [f'    PFN_{cmd.name} {cmd.field};'])
+        lines += ['  };', '']
+
+        gpa = 'PFN_vkGetInstanceProcAddr' if level == 'instance' else 'PFN_vkGetDeviceProcAddr'
+        lines.append(f'  inline void Load{table}({table}& table, {gpa} gpa, {handle} handle) {{')
+        for cmd in commands:
+            if cmd.level == level:
+                guarded(lines, cmd, [
+                    f'    table.{cmd.field} = reinterpret_cast<PFN_{cmd.name}>(gpa(handle, "{cmd.name}"));'])
+        lines += ['  }', '']
+
+    lines += ['}', '']
+    return '\n'.join(lines)
+
+
+def write_wrappers(commands, source):
+    lines = [
+        f'// Generated by gen_dispatch.py from {source}, do not edit.',
+        '// Included by vk_timing_layer.cpp inside namespace vk_timing.',
+        '',
+    ]
+
+    wrapped = [c for c in commands if c.name not in MANUAL]
+
+    for cmd in wrapped:
+        table = 'GetInstanceTable' if cmd.level == 'instance' else 'GetDeviceTable'
+        decls = ', '.join(p[0] for p in cmd.params)
+        args = ', '.join(p[1] for p in cmd.params)
+        call = f'{table}({cmd.params[0][1]}).{cmd.field}({args});'
+        body = [
+            f'  static VKAPI_ATTR {cmd.ret} VKAPI_CALL Wrap_{cmd.name}({decls}) {{',
+            f'    CallTimer timer(Call_{cmd.name});',
+            f'    {"" if cmd.ret == "void" else "return "}{call}',
+            '  }',
+        ]
+        guarded(lines, cmd, body)
+        lines.append('')
+
+    lines.append('  static const WrapperEntry Wrappers[] = {')
+    for cmd in sorted(wrapped, key=lambda c: c.name):
+        guarded(lines, cmd, [
+            f'    {{ "{cmd.name}", reinterpret_cast<PFN_vkVoidFunction>(&Wrap_{cmd.name}), '
+            f'{"true" if cmd.level == "device" else "false"} }},'])
+    lines += ['  };', '']
+
+    return '\n'.join(lines)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+
+    xml_path, out_dir = sys.argv[1:]
+    commands = load_commands(xml_path)
+
+    missing = MANUAL - {c.name for c in commands}
+    if missing:
+        print(f"Error: {xml_path} lacks {', '.join(sorted(missing))}")
+        sys.exit(1)
+
+    os.makedirs(out_dir, exist_ok=True)
+    source = os.path.basename(xml_path)
+
+    with open(os.path.join(out_dir, 'vk_timing_dispatch.h'), 'w') as f:
+        f.write(write_dispatch(commands, source))
+    with open(os.path.join(out_dir, 'vk_timing_wrappers.inc'), 'w') as f:
+        f.write(write_wrappers(commands, source))
+
+    instance = sum(1 for c in commands if c.level == 'instance')
+    print(f"{len(commands)} commands ({instance} instance, {len(commands) - instance} device)")
+
+
+if __name__ == '__main__':
+    main()
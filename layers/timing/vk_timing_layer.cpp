@@ -0,0 +1,441 @@
+/*
+ * VK_LAYER_FNV_timing
+ *
+ * Times every Vulkan call made through a dispatchable handle and
+ * writes one 24-byte record per call to a binary trace (format in
+ * src/util/trace/trace_ring.h). Replaces MVK_CONFIG_TRACE_VULKAN_CALLS
+ * text logging, which slows the game down too much for its timings
+ * to mean anything.
+ *
+ * Wrappers and dispatch tables are generated from vk.xml by
+ * gen_dispatch.py, so the layer covers whatever the headers it is
+ * built against define and works with any ICD.
+ *
+ * Environment:
+ *   VK_TIMING_OUTPUT  trace file, default vk_timing_<pid>.bin in the
+ *                     working directory. Instances created after the
+ *                     last one was destroyed write to FILE.2, FILE.3...
+ *
+ * Summarize with: vk_timing_summary FILE
+ */
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_layer.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "util/trace/trace_ring.h"
+
+#include "vk_timing_dispatch.h"
+
+#define VK_TIMING_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace vk_timing {
+
+  using dxvk::TraceClock;
+  using dxvk::TraceWriter;
+
+  struct InstanceData {
+    InstanceDispatch table;
+    VkInstance       instance;
+  };
+
+  struct DeviceData {
+    DeviceDispatch   table;
+  };
+
+  struct WrapperEntry {
+    const char*        name;
+    PFN_vkVoidFunction function;
+    bool               device;
+  };
+
+
+  /**
+   * \brief Maps loader dispatch keys to layer data
+   *
+   * The loader stores its dispatch table pointer in the first word
+   * of every dispatchable handle, shared by an instance and its
+   * physical devices, and by a device and its queues and command
+   * buffers. Lookups are a lock-free scan, there are only ever a
+   * handful of instances and devices.
+   */
+  template<typename T>
+  class DispatchMap {
+
+  public:
+
+    T* find(const void* handle) const {
+      void* key = dispatchKey(handle);
+
+      for (uint32_t i = 0; i < MaxEntries; i++) {
+        if (m_keys[i].load(std::memory_order_acquire) == key)
+          return m_values[i];
+      }
+
+      return nullptr;
+    }
+
+    bool insert(const void* handle, T* value) {
+      std::lock_guard lock(m_mutex);
+
+      for (uint32_t i = 0; i < MaxEntries; i++) {
+        if (!m_keys[i].load(std::memory_order_relaxed)) {
+          m_values[i] = value;
+          m_keys[i].store(dispatchKey(handle), std::memory_order_release);
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    T* erase(const void* handle) {
+      std::lock_guard lock(m_mutex);
+      void* key = dispatchKey(handle);
+
+      for (uint32_t i = 0; i < MaxEntries; i++) {
+        if (m_keys[i].load(std::memory_order_relaxed) == key) {
+          m_keys[i].store(nullptr, std::memory_order_release);
+          return m_values[i];
+        }
+      }
+
+      return nullptr;
+    }
+
+  private:
+
+    static constexpr uint32_t MaxEntries = 32;
+
+    std::mutex          m_mutex;
+    std::atomic<void*>  m_keys[MaxEntries] = { };
+    T*                  m_values[MaxEntries] = { };
+
+    static void* dispatchKey(const void* handle) {
+      return *static_cast<void* const*>(handle);
+    }
+
+  };
+
+
+  DispatchMap<InstanceData> g_instances;
+  DispatchMap<DeviceData>   g_devices;
+
+  // Writer lives from the first instance until the last one is
+  // destroyed, which the application may only do once no other
+  // Vulkan calls are in flight.
+  std::mutex                g_writerMutex;
+  uint32_t                  g_instanceCount = 0;
+  uint32_t                  g_session       = 0;
+  std::atomic<TraceWriter*> g_writer        = { nullptr };
+
+
+  /**
+   * \brief Records the enclosing call on scope exit
+   */
+  class CallTimer {
+
+  public:
+
+    explicit CallTimer(uint32_t id)
+    : m_id(id), m_start(TraceClock::now()) { }
+
+    ~CallTimer() {
+      uint64_t end = TraceClock::now();
+
+      if (TraceWriter* writer = g_writer.load(std::memory_order_acquire))
+        writer->record(m_id, m_start, end);
+    }
+
+    CallTimer             (const CallTimer&) = delete;
+    CallTimer& operator = (const CallTimer&) = delete;
+
+  private:
+
+    uint32_t m_id;
+    uint64_t m_start;
+
+  };
+
+
+  const InstanceDispatch& GetInstanceTable(const void* handle) {
+    return g_instances.find(handle)->table;
+  }
+
+  const DeviceDispatch& GetDeviceTable(const void* handle) {
+    return g_devices.find(handle)->table;
+  }
+
+
+  void OpenWriter() {
+    std::lock_guard lock(g_writerMutex);
+
+    if (g_instanceCount++)
+      return;
+
+    const char* env = std::getenv("VK_TIMING_OUTPUT");
+    std::string path = env && *env ? env : "vk_timing_" + std::to_string(getpid()) + ".bin";
+
+    if (++g_session > 1)
+      path += "." + std::to_string(g_session);
+
+    std::vector<std::string> names(CallNames, CallNames + CallCount);
+    auto writer = std::make_unique<TraceWriter>(path, names);
+
+    if (!writer->isOpen()) {
+      std::fprintf(stderr, "vk_timing: cannot open %s\n", path.c_str());
+      return;
+    }
+
+    std::fprintf(stderr, "vk_timing: writing %s\n", path.c_str());
+    g_writer.store(writer.release(), std::memory_order_release);
+  }
+
+
+  void CloseWriter() {
+    std::lock_guard lock(g_writerMutex);
+
+    if (--g_instanceCount)
+      return;
+
+    std::unique_ptr<TraceWriter> writer(g_writer.exchange(nullptr));
+
+    if (writer) {
+      writer->close();
+
+      auto stats = writer->getStats();
+      std::fprintf(stderr, "vk_timing: %llu calls from %u threads, %llu dropped\n",
+        (unsigned long long)(stats.records + stats.dropped), stats.threads,
+        (unsigned long long)stats.dropped);
+    }
+  }
+
+
+#include "vk_timing_wrappers.inc"
+
+
+  PFN_vkVoidFunction FindWrapper(const char* pName, bool device) {
+    auto entry = std::lower_bound(std::begin(Wrappers), std::end(Wrappers), pName,
+      [] (const WrapperEntry& e, const char* name) { return std::strcmp(e.name, name) < 0; });
+
+    if (entry == std::end(Wrappers) || std::strcmp(entry->name, pName) || (device && !entry->device))
+      return nullptr;
+
+    return entry->function;
+  }
+
+
+  template<typename T>
+  T* FindLayerLink(const void* pNext, VkStructureType sType) {
+    auto info = static_cast<T*>(const_cast<void*>(pNext));
+
+    while (info && !(info->sType == sType && info->function == VK_LAYER_LINK_INFO))
+      info = static_cast<T*>(const_cast<void*>(info->pNext));
+
+    return info;
+  }
+
+
+  VKAPI_ATTR VkResult VKAPI_CALL CreateInstance(
+      const VkInstanceCreateInfo*   pCreateInfo,
+      const VkAllocationCallbacks*  pAllocator,
+            VkInstance*             pInstance) {
+    auto link = FindLayerLink<VkLayerInstanceCreateInfo>(
+      pCreateInfo->pNext, VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO);
+
+    if (!link)
+      return VK_ERROR_INITIALIZATION_FAILED;
+
+    PFN_vkGetInstanceProcAddr gipa = link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    link->u.pLayerInfo = link->u.pLayerInfo->pNext;
+
+    auto createInstance = reinterpret_cast<PFN_vkCreateInstance>(gipa(VK_NULL_HANDLE, "vkCreateInstance"));
+    VkResult vr = createInstance(pCreateInfo, pAllocator, pInstance);
+
+    if (vr != VK_SUCCESS)
+      return vr;
+
+    auto data = std::make_unique<InstanceData>();
+    LoadInstanceDispatch(data->table, gipa, *pInstance);
+    data->table.GetInstanceProcAddr = gipa;
+    data->instance = *pInstance;
+
+    if (!g_instances.insert(*pInstance, data.get())) {
+      data->table.DestroyInstance(*pInstance, pAllocator);
+      return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    data.release();
+    OpenWriter();
+    return VK_SUCCESS;
+  }
+
+
+  VKAPI_ATTR void VKAPI_CALL DestroyInstance(
+            VkInstance              instance,
+      const VkAllocationCallbacks*  pAllocator) {
+    if (!instance)
+      return;
+
+    std::unique_ptr<InstanceData> data(g_instances.erase(instance));
+
+    { CallTimer timer(Call_vkDestroyInstance);
+      data->table.DestroyInstance(instance, pAllocator); }
+
+    CloseWriter();
+  }
+
+
+  VKAPI_ATTR VkResult VKAPI_CALL CreateDevice(
+            VkPhysicalDevice        physicalDevice,
+      const VkDeviceCreateInfo*     pCreateInfo,
+      const VkAllocationCallbacks*  pAllocator,
+            VkDevice*               pDevice) {
+    CallTimer timer(Call_vkCreateDevice);
+
+    auto link = FindLayerLink<VkLayerDeviceCreateInfo>(
+      pCreateInfo->pNext, VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO);
+
+    if (!link)
+      return VK_ERROR_INITIALIZATION_FAILED;
+
+    PFN_vkGetInstanceProcAddr gipa = link->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+    PFN_vkGetDeviceProcAddr   gdpa = link->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+    link->u.pLayerInfo = link->u.pLayerInfo->pNext;
+
+    InstanceData* instance = g_instances.find(physicalDevice);
+
+    auto createDevice = reinterpret_cast<PFN_vkCreateDevice>(gipa(instance->instance, "vkCreateDevice"));
+    VkResult vr = createDevice(physicalDevice, pCreateInfo, pAllocator, pDevice);
+
+    if (vr != VK_SUCCESS)
+      return vr;
+
+    auto data = std::make_unique<DeviceData>();
+    LoadDeviceDispatch(data->table, gdpa, *pDevice);
+    data->table.GetDeviceProcAddr = gdpa;
+
+    if (!g_devices.insert(*pDevice, data.get())) {
+      data->table.DestroyDevice(*pDevice, pAllocator);
+      return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    data.release();
+    return VK_SUCCESS;
+  }
+
+
+  VKAPI_ATTR void VKAPI_CALL DestroyDevice(
+            VkDevice                device,
+      const VkAllocationCallbacks*  pAllocator) {
+    if (!device)
+      return;
+
+    CallTimer timer(Call_vkDestroyDevice);
+
+    std::unique_ptr<DeviceData> data(g_devices.erase(device));
+    data->table.DestroyDevice(device, pAllocator);
+  }
+
+
+  VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(
+            VkDevice                device,
+      const char*                   pName);
+
+
+  PFN_vkVoidFunction FindManual(const char* pName, bool device) {
+    static const WrapperEntry s_manual[] = {
+      { "vkCreateDevice",        reinterpret_cast<PFN_vkVoidFunction>(&CreateDevice),      false },
+      { "vkCreateInstance",      reinterpret_cast<PFN_vkVoidFunction>(&CreateInstance),    false },
+      { "vkDestroyDevice",       reinterpret_cast<PFN_vkVoidFunction>(&DestroyDevice),     true  },
+      { "vkDestroyInstance",     reinterpret_cast<PFN_vkVoidFunction>(&DestroyInstance),   false },
+      { "vkGetDeviceProcAddr",   reinterpret_cast<PFN_vkVoidFunction>(&GetDeviceProcAddr), true  },
+    };
+
+    for (const auto& e : s_manual) {
+      if (!std::strcmp(e.name, pName) && (e.device || !device))
+        return e.function;
+    }
+
+    return nullptr;
+  }
+
+
+  VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetInstanceProcAddr(
+            VkInstance              instance,
+      const char*                   pName) {
+    if (!std::strcmp(pName, "vkGetInstanceProcAddr"))
+      return reinterpret_cast<PFN_vkVoidFunction>(&GetInstanceProcAddr);
+
+    if (PFN_vkVoidFunction manual = FindManual(pName, false))
+      return manual;
+
+    InstanceData* data = instance ? g_instances.find(instance) : nullptr;
+
+    if (!data)
+      return nullptr;
+
+    PFN_vkVoidFunction next = data->table.GetInstanceProcAddr(instance, pName);
+
+    if (!next)
+      return nullptr;
+
+    PFN_vkVoidFunction wrapper = FindWrapper(pName, false);
+    return wrapper ? wrapper : next;
+  }
+
+
+  VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL GetDeviceProcAddr(
+            VkDevice                device,
+      const char*                   pName) {
+    if (PFN_vkVoidFunction manual = FindManual(pName, true))
+      return manual;
+
+    DeviceData* data = device ? g_devices.find(device) : nullptr;
+
+    if (!data)
+      return nullptr;
+
+    PFN_vkVoidFunction next = data->table.GetDeviceProcAddr(device, pName);
+
+    if (!next)
+      return nullptr;
+
+    PFN_vkVoidFunction wrapper = FindWrapper(pName, true);
+    return wrapper ? wrapper : next;
+  }
+
+}
+
+
+VK_TIMING_EXPORT VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(
+        VkNegotiateLayerInterface*  pVersionStruct) {
+  if (pVersionStruct->loaderLayerInterfaceVersion < 2)
+    return VK_ERROR_INITIALIZATION_FAILED;
+
+  pVersionStruct->loaderLayerInterfaceVersion = 2;
+  pVersionStruct->pfnGetInstanceProcAddr       = &vk_timing::GetInstanceProcAddr;
+  pVersionStruct->pfnGetDeviceProcAddr         = &vk_timing::GetDeviceProcAddr;
+  pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+  return VK_SUCCESS;
+}
+
+
+VK_TIMING_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(
+        VkInstance                  instance,
+  const char*                       pName) {
+  return vk_timing::GetInstanceProcAddr(instance, pName);
+}
+
+
+VK_TIMING_EXPORT VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(
+        VkDevice                    device,
+  const char*                       pName) {
+  return vk_timing::GetDeviceProcAddr(device, pName);
+}
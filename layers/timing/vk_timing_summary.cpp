@@ -0,0 +1,87 @@
+/*
+ * Summarizes a trace written by VK_LAYER_FNV_timing.
+ *
+ * - Per function: calls, total time, average, p99 and max, most
+ *   total time first
+ * - Slow calls: every call over --slow-us, in the order they were
+ *   made, with the thread that made them
+ *
+ * Usage: vk_timing_summary FILE [--slow-us N] [--top N]
+ */
+
+#include "util/trace/trace_summary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace dxvk;
+
+static int usage() {
+    fprintf(stderr, "Usage: vk_timing_summary FILE [--slow-us N] [--top N]\n");
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    double slowUs = 1000.0;
+    size_t top = 40;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--slow-us") && i + 1 < argc)
+            slowUs = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--top") && i + 1 < argc)
+            top = size_t(atoi(argv[++i]));
+        else if (!path && argv[i][0] != '-')
+            path = argv[i];
+        else
+            return usage();
+    }
+
+    if (!path)
+        return usage();
+
+    TraceSummary summary;
+
+    if (!summary.loadFile(path)) {
+        fprintf(stderr, "Error: %s is not a vk_timing trace\n", path);
+        return 1;
+    }
+
+    printf("======================================================================\n");
+    printf("VULKAN CALL TIMING\n");
+    printf("======================================================================\n");
+    printf("Trace:   %s\n", path);
+    printf("Calls:   %zu over %.1f ms, %u threads\n",
+        summary.records().size(), summary.spanMs(), summary.threadCount());
+
+    if (summary.dropped())
+        printf("Dropped: %llu calls (rings full, totals are low)\n", (unsigned long long)summary.dropped());
+
+    auto functions = summary.functions();
+
+    printf("\n%-44s %10s %11s %9s %9s %10s\n", "Function", "Calls", "Total ms", "Avg us", "p99 us", "Max us");
+    printf("----------------------------------------------------------------------------------------------------\n");
+
+    for (size_t i = 0; i < functions.size() && i < top; i++) {
+        const auto& f = functions[i];
+        printf("%-44s %10llu %11.2f %9.2f %9.2f %10.2f\n", f.name.c_str(), (unsigned long long)f.count,
+            f.totalNs / 1e6, f.avgNs / 1e3, f.p99Ns / 1e3, f.maxNs / 1e3);
+    }
+
+    if (functions.size() > top)
+        printf("... %zu more functions\n", functions.size() - top);
+
+    auto slow = summary.slowCalls(slowUs * 1e3);
+
+    printf("\nSlow calls (>= %.0f us): %zu\n", slowUs, slow.size());
+
+    if (!slow.empty()) {
+        printf("%12s %7s  %-44s %12s\n", "Time ms", "Thread", "Function", "Duration us");
+
+        for (const auto& s : slow)
+            printf("%12.3f %7u  %-44s %12.1f\n", s.timeMs, s.thread, s.name.c_str(), s.durationNs / 1e3);
+    }
+
+    return 0;
+}
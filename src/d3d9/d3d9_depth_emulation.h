@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+namespace dxvk {
+
+  /**
+   * \brief D3D9 depth formats backed by a 24-bit depth buffer
+   */
+  enum class D3D9DepthFormat : uint32_t {
+    D16,    ///< D3DFMT_D16
+    D24S8,  ///< D3DFMT_D24S8
+    D24X8,  ///< D3DFMT_D24X8
+    Intz,   ///< INTZ, D24S8 that can be sampled
+    Df24,   ///< DF24, sampled with depth compare only
+  };
+
+
+  /**
+   * \brief Vulkan depth format
+   *
+   * Values match VkFormat, so they can be cast directly.
+   */
+  enum class D3D9DepthVkFormat : uint32_t {
+    D16_UNORM          = 124,
+    D24_UNORM_S8_UINT  = 129,
+    D32_SFLOAT_S8_UINT = 130,
+  };
+
+
+  /**
+   * \brief Depth formats the device supports
+   *
+   * The default describes Apple GPUs, which have no
+   * D24_UNORM_S8_UINT.
+   */
+  struct D3D9DepthFormatSupport {
+    bool d24s8 = false;
+  };
+
+
+  /**
+   * \brief Image format for a D3D9 depth format
+   *
+   * Emulated formats store 24-bit unorm depth as 32-bit float.
+   * Depth tests and compare sampling give the same results up
+   * to the precision of the stored value; anything that reads
+   * the raw D24S8 bits needs a converted copy.
+   */
+  struct D3D9DepthFormatInfo {
+    D3D9DepthVkFormat format;
+    bool              emulated;
+  };
+
+
+  inline D3D9DepthFormatInfo D3D9GetDepthFormatInfo(D3D9DepthFormat format, const D3D9DepthFormatSupport& support) {
+    if (format == D3D9DepthFormat::D16)
+      return { D3D9DepthVkFormat::D16_UNORM, false };
+
+    if (support.d24s8)
+      return { D3D9DepthVkFormat::D24_UNORM_S8_UINT, false };
+
+    return { D3D9DepthVkFormat::D32_SFLOAT_S8_UINT, true };
+  }
+
+
+  /**
+   * \brief Packs depth and stencil into D24S8
+   *
+   * Depth goes into the upper 24 bits, stencil into the lower
+   * 8, as in a locked D24S8 surface. Depth is clamped to [0, 1]
+   * and rounded to nearest like a Vulkan unorm conversion; NaN
+   * becomes 0. Computed in double, since a float cannot hold
+   * d * (2^24 - 1) exactly.
+   */
+  inline uint32_t D3D9PackD24S8(float depth, uint8_t stencil) {
+    double d = double(depth);
+    d = d > 0.0 ? (d < 1.0 ? d : 1.0) : 0.0;
+
+    uint32_t unorm = uint32_t(d * 16777215.0 + 0.5);
+    return (unorm << 8) | stencil;
+  }
+
+
+  /**
+   * \brief Unpacks D24S8 depth to float
+   *
+   * Exact inverse of D3D9PackD24S8 for every 24-bit value,
+   * used when D24S8 data is written to an emulated image.
+   */
+  inline float D3D9UnpackD24S8Depth(uint32_t packed) {
+    return float(double(packed >> 8) / 16777215.0);
+  }
+
+
+  /**
+   * \brief Reference conversion of a D32S8 image to D24S8
+   *
+   * What the conversion pass computes per texel. Also used for
+   * CPU readback when the image is already mapped.
+   */
+  inline void D3D9ConvertD32S8ToD24S8(
+          uint32_t* dst,
+    const float*    depth,
+    const uint8_t*  stencil,
+          uint32_t  count) {
+    for (uint32_t i = 0; i < count; i++)
+      dst[i] = D3D9PackD24S8(depth[i], stencil ? stencil[i] : 0);
+  }
+
+
+  /**
+   * \brief Conversion pass request
+   *
+   * The device records one compute dispatch that reads depth
+   * and stencil of the image and writes packed D24S8 texels to
+   * its packed copy (an R32_UINT image, also used for INTZ reads
+   * that need the exact 24-bit value).
+   */
+  struct D3D9DepthConversion {
+    uint64_t image;
+    uint64_t version;
+    uint32_t width;
+    uint32_t height;
+  };
+
+
+  /**
+   * \brief Packed copy of a depth image
+   *
+   * If \c emulated is \c false, the image has the native format
+   * and can be copied or read directly.
+   */
+  struct D3D9DepthPackedView {
+    bool     emulated   = false;
+    bool     converted  = false;  ///< A conversion was recorded by this call
+    uint64_t version    = 0;      ///< Image version the packed copy holds
+  };
+
+
+  struct D3D9DepthEmulationStats {
+    uint64_t conversions      = 0;  ///< Conversion passes recorded
+    uint64_t reuses           = 0;  ///< Requests served by an up-to-date copy
+    uint32_t frameConversions = 0;  ///< Conversion passes recorded this frame
+    uint32_t emulatedImages   = 0;
+  };
+
+
+  /**
+   * \brief Depth format emulation
+   *
+   * Tracks depth images whose D3D9 format is emulated and keeps
+   * one packed D24S8 copy per image. Every operation that needs
+   * the raw bits (GetRenderTargetData and lock readbacks, copies
+   * to a D24S8 destination, exact INTZ reads) asks for the packed
+   * copy. It is converted in one pass when the image was written
+   * since the last conversion, and reused otherwise.
+   *
+   * The device bumps the version when a render pass stores depth
+   * or stencil, on clears and on copies into the image, not per
+   * draw. Used on the CS thread only.
+   */
+  class D3D9DepthEmulator {
+
+  public:
+
+    using ConvertFn = std::function<void (const D3D9DepthConversion&)>;
+
+    D3D9DepthEmulator(
+      const D3D9DepthFormatSupport& support,
+            ConvertFn               convert)
+    : m_support(support), m_convert(std::move(convert)) { }
+
+    D3D9DepthEmulator             (const D3D9DepthEmulator&) = delete;
+    D3D9DepthEmulator& operator = (const D3D9DepthEmulator&) = delete;
+
+    /**
+     * \brief Registers a depth image
+     *
+     * \param [in] image Image id
+     * \param [in] format D3D9 format
+     * \param [in] width Width
+     * \param [in] height Height
+     * \returns Format to create the image with
+     */
+    D3D9DepthFormatInfo RegisterImage(uint64_t image, D3D9DepthFormat format, uint32_t width, uint32_t height) {
+      D3D9DepthFormatInfo info = D3D9GetDepthFormatInfo(format, m_support);
+
+      if (info.emulated) {
+        Image& entry = m_images[image];
+        entry.width  = width;
+        entry.height = height;
+      }
+
+      return info;
+    }
+
+    /**
+     * \brief Forgets a destroyed image
+     */
+    void UnregisterImage(uint64_t image) {
+      m_images.erase(image);
+    }
+
+    /**
+     * \brief Marks depth or stencil as written
+     */
+    void MarkWritten(uint64_t image) {
+      auto entry = m_images.find(image);
+
+      if (entry != m_images.end())
+        entry->second.version += 1;
+    }
+
+    /**
+     * \brief Gets the packed D24S8 copy of an image
+     *
+     * Records a conversion if the copy is out of date.
+     * \param [in] image Image id
+     * \returns Packed view state
+     */
+    D3D9DepthPackedView GetPacked(uint64_t image) {
+      D3D9DepthPackedView view;
+      auto entry = m_images.find(image);
+
+      if (entry == m_images.end())
+        return view;
+
+      Image& e = entry->second;
+      view.emulated = true;
+      view.version  = e.version;
+
+      if (e.packedVersion == e.version) {
+        m_stats.reuses += 1;
+        return view;
+      }
+
+      m_convert({ image, e.version, e.width, e.height });
+      e.packedVersion = e.version;
+
+      m_stats.conversions += 1;
+      m_stats.frameConversions += 1;
+
+      view.converted = true;
+      return view;
+    }
+
+    /**
+     * \brief Checks whether an image is emulated
+     */
+    bool IsEmulated(uint64_t image) const {
+      return m_images.find(image) != m_images.end();
+    }
+
+    /**
+     * \brief Resets the per-frame counter
+     * \returns Conversions recorded in the frame
+     */
+    uint32_t EndFrame() {
+      uint32_t count = m_stats.frameConversions;
+      m_stats.frameConversions = 0;
+      return count;
+    }
+
+    D3D9DepthEmulationStats GetStats() const {
+      D3D9DepthEmulationStats stats = m_stats;
+      stats.emulatedImages = uint32_t(m_images.size());
+      return stats;
+    }
+
+  private:
+
+    struct Image {
+      uint32_t width          = 0;
+      uint32_t height         = 0;
+      uint64_t version        = 1;  ///< Images start out written (cleared)
+      uint64_t packedVersion  = 0;
+    };
+
+    D3D9DepthFormatSupport  m_support;
+    ConvertFn               m_convert;
+
+    std::unordered_map<uint64_t, Image> m_images;
+    D3D9DepthEmulationStats             m_stats;
+
+  };
+
+}
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Discard ring options
+   */
+  struct D3D9DiscardRingOptions {
+    /// Slices allocated with the first chunk
+    uint32_t initialSlices  = 4;
+    /// Upper bound on slices per buffer. Once reached, a discard
+    /// waits for the oldest slice instead of allocating.
+    uint32_t maxSlices      = 64;
+    /// Frames the ring must use at most half its slices before the
+    /// newest chunk is released
+    uint32_t shrinkFrames   = 300;
+  };
+
+
+  /**
+   * \brief Lock mode, derived from the D3DLOCK flags
+   */
+  enum class D3D9DiscardLockMode : uint32_t {
+    Discard,      ///< D3DLOCK_DISCARD
+    NoOverwrite,  ///< D3DLOCK_NOOVERWRITE
+    Default,      ///< Neither, caller must sync on the returned fence
+  };
+
+
+  /**
+   * \brief Buffer chunk holding a number of slices
+   *
+   * One vkAllocateMemory allocation, persistently mapped.
+   */
+  struct D3D9DiscardChunk {
+    void*     mapPtr  = nullptr;
+    uint64_t  handle  = 0;
+  };
+
+
+  /**
+   * \brief Slice returned by a lock
+   */
+  struct D3D9DiscardSlice {
+    void*     mapPtr  = nullptr;
+    uint64_t  handle  = 0;  ///< Chunk handle
+    uint64_t  offset  = 0;  ///< Offset of the slice within the chunk
+    uint32_t  index   = 0;  ///< Slice index within the ring
+    uint64_t  fence   = 0;  ///< For \c Default locks, sequence to wait for
+  };
+
+
+  /**
+   * \brief Discard ring statistics
+   *
+   * Published through the perf monitor's discard fields.
+   */
+  struct D3D9DiscardRingStats {
+    uint64_t discards     = 0;
+    uint64_t noOverwrites = 0;
+    uint64_t allocations  = 0;  ///< Chunks allocated
+    uint64_t frees        = 0;  ///< Chunks released by shrinking
+    uint64_t stalls       = 0;  ///< Discards that had to wait
+    uint32_t slices       = 0;  ///< Current slice count
+    uint32_t peakInFlight = 0;  ///< Most slices in flight in one frame
+  };
+
+
+  /**
+   * \brief Rename-on-discard slice ring for dynamic buffers
+   *
+   * Dynamic vertex and index buffers get locked with D3DLOCK_DISCARD
+   * many times per frame. Every discard needs backing memory the GPU
+   * is not reading, and DXVK allocates a new slice whenever its free
+   * list is empty, so the memory allocator shows up in steady state
+   * and a burst of discards can stall.
+   *
+   * Each buffer owns a ring of fixed-size slices carved out of a few
+   * large chunks:
+   *
+   * - A discard retires the current slice with the fence of the
+   *   command list being recorded and takes the oldest free slice.
+   *   Slices become free again once their fence has completed.
+   * - D3DLOCK_NOOVERWRITE returns the current slice without any
+   *   tracking; the app promises not to touch data in use.
+   * - When no slice is free, the ring grows by a chunk as large as
+   *   all existing slices, up to \c maxSlices, and otherwise waits
+   *   for the oldest slice. Since growth follows the number of
+   *   slices in flight, the ring settles at discards per frame times
+   *   the frame latency and stops allocating.
+   * - If the ring used at most half its slices for \c shrinkFrames
+   *   frames, the newest chunk is released once it is idle.
+   *
+   * Not thread-safe, the buffer is locked under the device lock.
+   */
+  class D3D9DiscardRing {
+
+  public:
+
+    using AllocFn   = std::function<D3D9DiscardChunk (uint64_t size)>;
+    using FreeFn    = std::function<void (const D3D9DiscardChunk& chunk)>;
+    using IsDoneFn  = std::function<bool (uint64_t sequence)>;
+    using WaitFn    = std::function<void (uint64_t sequence)>;
+
+    D3D9DiscardRing(
+      const D3D9DiscardRingOptions& options,
+            uint64_t                sliceSize,
+            AllocFn                 alloc,
+            FreeFn                  free,
+            IsDoneFn                isDone,
+            WaitFn                  wait)
+    : m_options   (options),
+      m_sliceSize (sliceSize),
+      m_alloc     (std::move(alloc)),
+      m_free      (std::move(free)),
+      m_isDone    (std::move(isDone)),
+      m_wait      (std::move(wait)) {
+      addChunk(std::max(1u, m_options.initialSlices));
+      m_current = popFree();
+    }
+
+    ~D3D9DiscardRing() {
+      for (const auto& s : m_inFlight)
+        m_wait(s.second);
+
+      for (const auto& c : m_chunks)
+        m_free(c.chunk);
+    }
+
+    D3D9DiscardRing             (const D3D9DiscardRing&) = delete;
+    D3D9DiscardRing& operator = (const D3D9DiscardRing&) = delete;
+
+    /**
+     * \brief Locks the buffer
+     *
+     * \param [in] mode Lock mode
+     * \param [in] sequence Sequence number of the command list that
+     *    is currently being recorded, i.e. the last one that can
+     *    have used the current slice
+     * \returns Slice to write to. The device binds it as the buffer's
+     *    backing storage for subsequent draws.
+     */
+    D3D9DiscardSlice Lock(D3D9DiscardLockMode mode, uint64_t sequence) {
+      if (mode == D3D9DiscardLockMode::NoOverwrite) {
+        m_stats.noOverwrites += 1;
+        return getSlice(m_current, 0);
+      }
+
+      if (mode == D3D9DiscardLockMode::Default)
+        return getSlice(m_current, sequence);
+
+      m_stats.discards += 1;
+
+      m_inFlight.push_back({ m_current, sequence });
+      m_current = acquire();
+
+      m_frameInFlight = std::max(m_frameInFlight, uint32_t(m_inFlight.size()) + 1);
+      return getSlice(m_current, 0);
+    }
+
+    /**
+     * \brief Ends the frame
+     *
+     * Recycles completed slices and shrinks the ring if demand
+     * dropped for long enough.
+     */
+    void EndFrame() {
+      recycle();
+
+      m_stats.peakInFlight = std::max(m_stats.peakInFlight, m_frameInFlight);
+
+      if (m_frameInFlight * 2 <= m_sliceCount && m_chunks.size() > 1)
+        m_lowFrames += 1;
+      else
+        m_lowFrames = 0;
+
+      if (m_lowFrames >= m_options.shrinkFrames && tryShrink())
+        m_lowFrames = 0;
+
+      m_frameInFlight = 0;
+    }
+
+    D3D9DiscardRingStats GetStats() const {
+      D3D9DiscardRingStats stats = m_stats;
+      stats.slices = m_sliceCount;
+      return stats;
+    }
+
+  private:
+
+    struct Chunk {
+      D3D9DiscardChunk  chunk;
+      uint32_t          first = 0;
+      uint32_t          count = 0;
+    };
+
+    D3D9DiscardRingOptions  m_options;
+    uint64_t                m_sliceSize;
+
+    AllocFn                 m_alloc;
+    FreeFn                  m_free;
+    IsDoneFn                m_isDone;
+    WaitFn                  m_wait;
+
+    std::vector<Chunk>      m_chunks;
+    std::deque<uint32_t>    m_freeSlices;
+    std::deque<std::pair<uint32_t, uint64_t>> m_inFlight;
+
+    uint32_t                m_sliceCount    = 0;
+    uint32_t                m_current       = 0;
+    uint32_t                m_frameInFlight = 0;
+    uint32_t                m_lowFrames     = 0;
+
+    D3D9DiscardRingStats    m_stats;
+
+    D3D9DiscardSlice getSlice(uint32_t index, uint64_t fence) const {
+      const Chunk& c = chunkOf(index);
+
+      D3D9DiscardSlice slice;
+      slice.offset  = uint64_t(index - c.first) * m_sliceSize;
+      slice.mapPtr  = static_cast<char*>(c.chunk.mapPtr) + slice.offset;
+      slice.handle  = c.chunk.handle;
+      slice.index   = index;
+      slice.fence   = fence;
+      return slice;
+    }
+
+    const Chunk& chunkOf(uint32_t index) const {
+      for (const Chunk& c : m_chunks) {
+        if (index < c.first + c.count)
+          return c;
+      }
+
+      return m_chunks.back();
+    }
+
+    void addChunk(uint32_t count) {
+      Chunk& c = m_chunks.emplace_back();
+      c.chunk = m_alloc(m_sliceSize * count);
+      c.first = m_sliceCount;
+      c.count = count;
+
+      for (uint32_t i = 0; i < count; i++)
+        m_freeSlices.push_back(m_sliceCount + i);
+
+      m_sliceCount += count;
+      m_stats.allocations += 1;
+    }
+
+    uint32_t popFree() {
+      uint32_t index = m_freeSlices.front();
+      m_freeSlices.pop_front();
+      return index;
+    }
+
+    void recycle() {
+      // Fences complete in order, so only the front needs checking
+      while (!m_inFlight.empty() && m_isDone(m_inFlight.front().second)) {
+        m_freeSlices.push_back(m_inFlight.front().first);
+        m_inFlight.pop_front();
+      }
+    }
+
+    uint32_t acquire() {
+      recycle();
+
+      if (m_freeSlices.empty()) {
+        uint32_t grow = m_sliceCount < m_options.maxSlices
+          ? std::min(m_sliceCount, m_options.maxSlices - m_sliceCount) : 0u;
+
+        if (grow) {
+          addChunk(grow);
+        } else {
+          m_wait(m_inFlight.front().second);
+          m_stats.stalls += 1;
+          recycle();
+        }
+      }
+
+      return popFree();
+    }
+
+    bool tryShrink() {
+      Chunk& last = m_chunks.back();
+
+      // Only release the chunk if none of its slices are in use
+      if (m_current >= last.first)
+        return false;
+
+      for (const auto& s : m_inFlight) {
+        if (s.first >= last.first)
+          return false;
+      }
+
+      m_freeSlices.erase(std::remove_if(m_freeSlices.begin(), m_freeSlices.end(),
+        [&last] (uint32_t index) { return index >= last.first; }), m_freeSlices.end());
+
+      m_free(last.chunk);
+      m_sliceCount -= last.count;
+      m_chunks.pop_back();
+      m_stats.frees += 1;
+      return true;
+    }
+
+  };
+
+}
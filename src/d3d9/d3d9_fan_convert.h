@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define D3D9_FAN_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define D3D9_FAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace dxvk {
+
+  /**
+   * \brief Index type, D3DFMT_INDEX16 or D3DFMT_INDEX32
+   */
+  enum class D3D9IndexType : uint32_t {
+    Uint16 = 2,
+    Uint32 = 4,
+  };
+
+
+  /*
+   * Triangle i of a fan over v0..vn is emitted as
+   * (v[i+1], v[i+2], v[0]). That is a rotation of (v0, v[i+1],
+   * v[i+2]), so the winding is unchanged, and the first vertex
+   * is the one D3D9 uses for flat shading of fans.
+   */
+
+  namespace fan_scalar {
+
+    template<typename T>
+    inline void Generate(T* dst, uint32_t first, uint32_t triCount) {
+      for (uint32_t i = first; i < first + triCount; i++) {
+        dst[0] = T(i + 1);
+        dst[1] = T(i + 2);
+        dst[2] = T(0);
+        dst += 3;
+      }
+    }
+
+    template<typename T>
+    inline void Convert(T* dst, const T* src, uint32_t triCount) {
+      T pivot = src[0];
+
+      for (uint32_t i = 0; i < triCount; i++) {
+        dst[0] = src[i + 1];
+        dst[1] = src[i + 2];
+        dst[2] = pivot;
+        dst += 3;
+      }
+    }
+
+  }
+
+
+  namespace fan_simd {
+
+    /*
+     * Generates indices for a non-indexed fan starting at vertex 0.
+     * Index k of the output belongs to triangle k / 3; per group of
+     * three vectors the pattern advances by one vector width of
+     * triangles in the first two positions and stays 0 in the third,
+     * so each iteration is three adds and three stores.
+     */
+    template<typename T, uint32_t Lanes>
+    struct Pattern {
+      T base[3][Lanes];
+      T step[3][Lanes];
+
+      Pattern() {
+        for (uint32_t k = 0; k < 3 * Lanes; k++) {
+          uint32_t tri = k / 3;
+          uint32_t pos = k % 3;
+
+          base[k / Lanes][k % Lanes] = pos == 2 ? T(0) : T(tri + 1 + pos);
+          step[k / Lanes][k % Lanes] = pos == 2 ? T(0) : T(Lanes);
+        }
+      }
+    };
+
+#if defined(D3D9_FAN_SSE2)
+    inline void Generate(uint16_t* dst, uint32_t triCount) {
+      static const Pattern<uint16_t, 8> p;
+
+      __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[0]));
+      __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[1]));
+      __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[2]));
+      __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[0]));
+      __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[1]));
+      __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[2]));
+
+      uint32_t i = 0;
+
+      for (; i + 8 <= triCount; i += 8) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  0), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst +  8), v1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), v2);
+        v0 = _mm_add_epi16(v0, s0);
+        v1 = _mm_add_epi16(v1, s1);
+        v2 = _mm_add_epi16(v2, s2);
+        dst += 24;
+      }
+
+      fan_scalar::Generate(dst, i, triCount - i);
+    }
+
+    inline void Generate(uint32_t* dst, uint32_t triCount) {
+      static const Pattern<uint32_t, 4> p;
+
+      __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[0]));
+      __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[1]));
+      __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.base[2]));
+      __m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[0]));
+      __m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[1]));
+      __m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p.step[2]));
+
+      uint32_t i = 0;
+
+      for (; i + 4 <= triCount; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4), v1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8), v2);
+        v0 = _mm_add_epi32(v0, s0);
+        v1 = _mm_add_epi32(v1, s1);
+        v2 = _mm_add_epi32(v2, s2);
+        dst += 12;
+      }
+
+      fan_scalar::Generate(dst, i, triCount - i);
+    }
+#elif defined(D3D9_FAN_NEON)
+    inline void Generate(uint16_t* dst, uint32_t triCount) {
+      static const Pattern<uint16_t, 8> p;
+
+      uint16x8_t v0 = vld1q_u16(p.base[0]), s0 = vld1q_u16(p.step[0]);
+      uint16x8_t v1 = vld1q_u16(p.base[1]), s1 = vld1q_u16(p.step[1]);
+      uint16x8_t v2 = vld1q_u16(p.base[2]), s2 = vld1q_u16(p.step[2]);
+
+      uint32_t i = 0;
+
+      for (; i + 8 <= triCount; i += 8) {
+        vst1q_u16(dst +  0, v0);
+        vst1q_u16(dst +  8, v1);
+        vst1q_u16(dst + 16, v2);
+        v0 = vaddq_u16(v0, s0);
+        v1 = vaddq_u16(v1, s1);
+        v2 = vaddq_u16(v2, s2);
+        dst += 24;
+      }
+
+      fan_scalar::Generate(dst, i, triCount - i);
+    }
+
+    inline void Generate(uint32_t* dst, uint32_t triCount) {
+      static const Pattern<uint32_t, 4> p;
+
+      uint32x4_t v0 = vld1q_u32(p.base[0]), s0 = vld1q_u32(p.step[0]);
+      uint32x4_t v1 = vld1q_u32(p.base[1]), s1 = vld1q_u32(p.step[1]);
+      uint32x4_t v2 = vld1q_u32(p.base[2]), s2 = vld1q_u32(p.step[2]);
+
+      uint32_t i = 0;
+
+      for (; i + 4 <= triCount; i += 4) {
+        vst1q_u32(dst + 0, v0);
+        vst1q_u32(dst + 4, v1);
+        vst1q_u32(dst + 8, v2);
+        v0 = vaddq_u32(v0, s0);
+        v1 = vaddq_u32(v1, s1);
+        v2 = vaddq_u32(v2, s2);
+        dst += 12;
+      }
+
+      fan_scalar::Generate(dst, i, triCount - i);
+    }
+#else
+    template<typename T>
+    inline void Generate(T* dst, uint32_t triCount) {
+      fan_scalar::Generate(dst, 0, triCount);
+    }
+#endif
+
+  }
+
+
+  /**
+   * \brief Converted fan draw
+   *
+   * Draw \c indexCount indices as a triangle list, with the
+   * vertex offset of the original draw. \c id identifies the
+   * index data: the device uploads it to an index buffer the
+   * first time it sees an id and reuses that copy afterwards.
+   */
+  struct D3D9FanDraw {
+    const void*   indices    = nullptr;
+    D3D9IndexType indexType  = D3D9IndexType::Uint16;
+    uint32_t      indexCount = 0;
+    uint64_t      id         = 0;
+  };
+
+
+  /**
+   * \brief Fan conversion cache options
+   */
+  struct D3D9FanCacheOptions {
+    /// Bytes of converted indexed fans kept for reuse
+    uint32_t maxCachedBytes = 4u << 20;
+    /// Triangles the shared non-indexed pattern starts with
+    uint32_t minPatternTris = 1024;
+  };
+
+
+  /**
+   * \brief Fan conversion statistics
+   */
+  struct D3D9FanCacheStats {
+    uint64_t nonIndexedDraws = 0;  ///< Served from the shared pattern
+    uint64_t indexedHits     = 0;  ///< Served from a cached conversion
+    uint64_t indexedMisses   = 0;  ///< Converted and cached
+    uint64_t uncached        = 0;  ///< Converted without a source buffer (UP draws)
+    uint64_t evictions       = 0;
+    uint32_t patternGrowths  = 0;
+    uint32_t cachedBytes     = 0;
+  };
+
+
+  /**
+   * \brief Triangle fan to list conversion cache
+   *
+   * Metal has no triangle fans, so DXVK converts every fan draw
+   * to an indexed triangle list before it reaches the backend.
+   *
+   * Non-indexed fans only depend on the vertex count: they all
+   * draw a prefix of one shared index pattern, generated with
+   * SIMD and grown by doubling, with the start vertex as the
+   * vertex offset. There is no per-draw work.
+   *
+   * Indexed fans are converted once per source index buffer,
+   * buffer version and index range, and kept in an LRU cache
+   * with a byte budget. The version must change whenever the
+   * buffer contents do, i.e. on every write lock.
+   */
+  class D3D9FanConverter {
+
+  public:
+
+    explicit D3D9FanConverter(const D3D9FanCacheOptions& options = D3D9FanCacheOptions())
+    : m_options(options) { }
+
+    D3D9FanConverter             (const D3D9FanConverter&) = delete;
+    D3D9FanConverter& operator = (const D3D9FanConverter&) = delete;
+
+    /**
+     * \brief Converts a non-indexed fan
+     *
+     * DrawPrimitive and DrawPrimitiveUP. The result is valid
+     * until the next call that grows the pattern.
+     * \param [in] primCount Triangle count
+     * \returns Draw, with the start vertex as the vertex offset
+     */
+    D3D9FanDraw ConvertNonIndexed(uint32_t primCount) {
+      m_stats.nonIndexedDraws += 1;
+
+      bool wide = primCount + 2 > 0x10000;
+      Pattern& pattern = wide ? m_pattern32 : m_pattern16;
+
+      if (pattern.triCount < primCount)
+        growPattern(pattern, primCount, wide);
+
+      D3D9FanDraw draw;
+      draw.indices    = pattern.data.data();
+      draw.indexType  = wide ? D3D9IndexType::Uint32 : D3D9IndexType::Uint16;
+      draw.indexCount = primCount * 3;
+      draw.id         = pattern.id;
+      return draw;
+    }
+
+    /**
+     * \brief Converts an indexed fan
+     *
+     * DrawIndexedPrimitive with a buffer id, DrawIndexedPrimitiveUP
+     * without one. Uncached results are valid until the next
+     * uncached conversion, cached ones until the next call.
+     * \param [in] bufferId Index buffer, or 0 for user memory
+     * \param [in] version Index buffer version
+     * \param [in] type Index type
+     * \param [in] indices Source indices at \c startIndex
+     * \param [in] startIndex Index of the first vertex of the fan
+     * \param [in] primCount Triangle count
+     * \returns Draw, with the base vertex as the vertex offset
+     */
+    D3D9FanDraw ConvertIndexed(
+            uint64_t      bufferId,
+            uint64_t      version,
+            D3D9IndexType type,
+      const void*         indices,
+            uint32_t      startIndex,
+            uint32_t      primCount) {
+      D3D9FanDraw draw;
+      draw.indexType  = type;
+      draw.indexCount = primCount * 3;
+
+      if (!bufferId) {
+        m_stats.uncached += 1;
+        convert(m_scratch, type, indices, primCount);
+        draw.indices = m_scratch.data();
+        draw.id      = m_nextId++;
+        return draw;
+      }
+
+      Key key = { bufferId, version, startIndex, primCount | (uint64_t(type) << 32) };
+      auto entry = m_entries.find(key);
+
+      if (entry != m_entries.end()) {
+        m_stats.indexedHits += 1;
+        m_lru.splice(m_lru.end(), m_lru, entry->second.lru);
+      } else {
+        m_stats.indexedMisses += 1;
+
+        Entry e;
+        convert(e.data, type, indices, primCount);
+        e.id = m_nextId++;
+        e.lru = m_lru.insert(m_lru.end(), key);
+
+        m_cachedBytes += uint32_t(e.data.size());
+        entry = m_entries.emplace(key, std::move(e)).first;
+
+        evict(entry->first);
+      }
+
+      draw.indices = entry->second.data.data();
+      draw.id      = entry->second.id;
+      return draw;
+    }
+
+    /**
+     * \brief Drops all conversions of a buffer
+     *
+     * Called when the index buffer is destroyed. Stale
+     * versions of live buffers age out through the LRU.
+     */
+    void InvalidateBuffer(uint64_t bufferId) {
+      for (auto i = m_lru.begin(); i != m_lru.end(); ) {
+        if (i->bufferId == bufferId) {
+          auto entry = m_entries.find(*i);
+          m_cachedBytes -= uint32_t(entry->second.data.size());
+          m_entries.erase(entry);
+          i = m_lru.erase(i);
+        } else {
+          i++;
+        }
+      }
+    }
+
+    D3D9FanCacheStats GetStats() const {
+      D3D9FanCacheStats stats = m_stats;
+      stats.cachedBytes = m_cachedBytes;
+      return stats;
+    }
+
+  private:
+
+    struct Key {
+      uint64_t bufferId;
+      uint64_t version;
+      uint64_t startIndex;
+      uint64_t countAndType;
+
+      bool operator == (const Key& other) const {
+        return bufferId     == other.bufferId
+            && version      == other.version
+            && startIndex   == other.startIndex
+            && countAndType == other.countAndType;
+      }
+    };
+
+    struct KeyHash {
+      size_t operator () (const Key& k) const {
+        uint64_t h = k.bufferId * 0x9e3779b97f4a7c15ull;
+        h = (h ^ k.version)      * 0x9e3779b97f4a7c15ull;
+        h = (h ^ k.startIndex)   * 0x9e3779b97f4a7c15ull;
+        h = (h ^ k.countAndType) * 0x9e3779b97f4a7c15ull;
+        return size_t(h ^ (h >> 32));
+      }
+    };
+
+    struct Entry {
+      std::vector<uint8_t>      data;
+      uint64_t                  id = 0;
+      std::list<Key>::iterator  lru;
+    };
+
+    struct Pattern {
+      std::vector<uint8_t>  data;
+      uint32_t              triCount = 0;
+      uint64_t              id       = 0;
+    };
+
+    D3D9FanCacheOptions   m_options;
+    D3D9FanCacheStats     m_stats;
+
+    Pattern               m_pattern16;
+    Pattern               m_pattern32;
+
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    std::list<Key>                          m_lru;
+    uint32_t                                m_cachedBytes = 0;
+
+    std::vector<uint8_t>  m_scratch;
+    uint64_t              m_nextId = 1;
+
+    void growPattern(Pattern& pattern, uint32_t primCount, bool wide) {
+      uint32_t triCount = std::max(pattern.triCount, m_options.minPatternTris);
+
+      while (triCount < primCount)
+        triCount *= 2;
+
+      // 16-bit patterns stop where the indices would wrap
+      if (!wide)
+        triCount = std::min(triCount, 0xfffeu);
+
+      if (wide) {
+        pattern.data.resize(size_t(triCount) * 3 * sizeof(uint32_t));
+        fan_simd::Generate(reinterpret_cast<uint32_t*>(pattern.data.data()), triCount);
+      } else {
+        pattern.data.resize(size_t(triCount) * 3 * sizeof(uint16_t));
+        fan_simd::Generate(reinterpret_cast<uint16_t*>(pattern.data.data()), triCount);
+      }
+
+      pattern.triCount = triCount;
+      pattern.id = m_nextId++;
+
+      m_stats.patternGrowths += 1;
+    }
+
+    static void convert(std::vector<uint8_t>& dst, D3D9IndexType type, const void* src, uint32_t primCount) {
+      dst.resize(size_t(primCount) * 3 * uint32_t(type));
+
+      if (type == D3D9IndexType::Uint16) {
+        fan_scalar::Convert(reinterpret_cast<uint16_t*>(dst.data()),
+          reinterpret_cast<const uint16_t*>(src), primCount);
+      } else {
+        fan_scalar::Convert(reinterpret_cast<uint32_t*>(dst.data()),
+          reinterpret_cast<const uint32_t*>(src), primCount);
+      }
+    }
+
+    void evict(const Key& keep) {
+      while (m_cachedBytes > m_options.maxCachedBytes && !(m_lru.front() == keep)) {
+        auto entry = m_entries.find(m_lru.front());
+        m_cachedBytes -= uint32_t(entry->second.data.size());
+        m_entries.erase(entry);
+        m_lru.pop_front();
+        m_stats.evictions += 1;
+      }
+    }
+
+  };
+
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "d3d9_format_convert_kernels.h"
+
+#include "../util/task/task_scheduler.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Converts a D3D9 palette to B8G8R8A8
+   *
+   * \param [in] entries 256 PALETTEENTRY structs (R, G, B, flags),
+   *    where the flags byte is used as alpha
+   * \param [out] palette Converted palette
+   */
+  inline void D3D9ConvertPalette(const uint8_t* entries, uint32_t* palette) {
+    for (uint32_t i = 0; i < 256; i++, entries += 4)
+      palette[i] = convert_scalar::bgra(entries[2], entries[1], entries[0], entries[3]);
+  }
+
+
+  /**
+   * \brief Texture conversion job
+   *
+   * Source and destination must stay valid until the job's fence
+   * is signaled. The destination is normally a staging buffer
+   * slice, so the converted data never needs another copy.
+   */
+  struct D3D9ConversionJob {
+    D3D9ConversionFormat  format    = D3D9ConversionFormat::R8G8B8;
+    const uint8_t*        src       = nullptr;
+    size_t                srcPitch  = 0;
+    uint8_t*              dst       = nullptr;
+    size_t                dstPitch  = 0;
+    uint32_t              width     = 0;
+    uint32_t              height    = 0;
+    const uint32_t*       palette   = nullptr;  ///< B8G8R8A8, P8 only
+  };
+
+
+  /**
+   * \brief Conversion statistics
+   */
+  struct D3D9ConversionStats {
+    uint64_t jobs       = 0;
+    uint64_t bytes      = 0;  ///< Destination bytes written
+    uint64_t waits      = 0;  ///< Waits that found the job unfinished
+    uint64_t waitTimeUs = 0;
+  };
+
+
+  /**
+   * \brief Background texture format converter
+   *
+   * Runs conversions for formats Metal lacks on the task scheduler
+   * instead of the thread calling LockRect/UnlockRect. Each job is
+   * split into row slice tasks in the prefetch lane, and is
+   * identified by a fence value. The device records the fence with
+   * the texture and only waits on it when a draw samples the texture
+   * before conversion finished. Waiting boosts the job's slices to
+   * frame-critical and runs them on the waiting thread as well.
+   */
+  class D3D9FormatConverter {
+
+  public:
+
+    /**
+     * \brief Creates the converter with its own scheduler
+     *
+     * \param [in] workerCount Worker thread count. 0 picks one less
+     *    than the number of CPU cores, but at least one.
+     */
+    explicit D3D9FormatConverter(uint32_t workerCount = 0)
+    : m_isa         (D3D9GetBestConversionIsa()),
+      m_ownScheduler(std::make_unique<TaskScheduler>(workerCount)),
+      m_scheduler   (m_ownScheduler.get()) { }
+
+    /**
+     * \brief Creates the converter on a shared scheduler
+     * \param [in] scheduler Device task scheduler
+     */
+    explicit D3D9FormatConverter(TaskScheduler& scheduler)
+    : m_isa         (D3D9GetBestConversionIsa()),
+      m_scheduler   (&scheduler) { }
+
+    ~D3D9FormatConverter() {
+      // Slice tasks reference the converter
+      WaitAll();
+    }
+
+    D3D9FormatConverter             (const D3D9FormatConverter&) = delete;
+    D3D9FormatConverter& operator = (const D3D9FormatConverter&) = delete;
+
+    D3D9ConversionIsa GetIsa() const {
+      return m_isa;
+    }
+
+    /**
+     * \brief Overrides the instruction set
+     *
+     * Only meant for tests and benchmarks. Must not be
+     * called while jobs are in flight.
+     */
+    void SetIsa(D3D9ConversionIsa isa) {
+      m_isa = isa;
+    }
+
+    /**
+     * \brief Converts an image on the calling thread
+     */
+    void ConvertSync(const D3D9ConversionJob& job) const {
+      convertRows(job, m_isa, 0, job.height);
+    }
+
+    /**
+     * \brief Queues a conversion
+     *
+     * \param [in] job Conversion job
+     * \returns Fence value to wait on before using the data
+     */
+    uint64_t Submit(const D3D9ConversionJob& job) {
+      uint32_t rowBytes = job.width * 4;
+      uint32_t rowsPerSlice = std::max(1u, uint32_t(SliceBytes / std::max(1u, rowBytes)));
+      uint32_t sliceCount = (job.height + rowsPerSlice - 1) / rowsPerSlice;
+
+      uint64_t fence;
+
+      { std::lock_guard lock(m_mutex);
+        fence = ++m_nextFence;
+
+        m_stats.jobs += 1;
+        m_stats.bytes += uint64_t(rowBytes) * job.height; }
+
+      if (!sliceCount)
+        return fence;
+
+      auto shared = std::make_shared<D3D9ConversionJob>(job);
+      TaskRef done = m_scheduler->create(TaskPriority::Prefetch, [] { });
+
+      for (uint32_t i = 0; i < sliceCount; i++) {
+        uint32_t row = i * rowsPerSlice;
+        uint32_t rows = std::min(rowsPerSlice, job.height - row);
+
+        TaskRef slice = m_scheduler->create(TaskPriority::Prefetch,
+          [this, shared, row, rows] { convertRows(*shared, m_isa, row, rows); });
+
+        m_scheduler->addDependency(done, slice);
+        m_scheduler->submit(slice);
+      }
+
+      { std::lock_guard lock(m_mutex);
+        m_pending.emplace(fence, done); }
+
+      m_scheduler->submit(done);
+      return fence;
+    }
+
+    /**
+     * \brief Checks whether a conversion has finished
+     */
+    bool IsComplete(uint64_t fence) {
+      std::lock_guard lock(m_mutex);
+      auto entry = m_pending.find(fence);
+
+      if (entry == m_pending.end())
+        return true;
+
+      if (!entry->second->isDone())
+        return false;
+
+      m_pending.erase(entry);
+      return true;
+    }
+
+    /**
+     * \brief Waits for a conversion to finish
+     *
+     * Runs the job's slices on the calling thread while waiting.
+     */
+    void Wait(uint64_t fence) {
+      TaskRef task;
+
+      { std::lock_guard lock(m_mutex);
+        auto entry = m_pending.find(fence);
+
+        if (entry == m_pending.end())
+          return;
+
+        task = entry->second; }
+
+      if (!task->isDone()) {
+        auto start = std::chrono::steady_clock::now();
+        m_scheduler->wait(task);
+
+        std::lock_guard lock(m_mutex);
+        m_stats.waits += 1;
+        m_stats.waitTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count();
+      }
+
+      std::lock_guard lock(m_mutex);
+      m_pending.erase(fence);
+    }
+
+    /**
+     * \brief Waits for all queued conversions
+     */
+    void WaitAll() {
+      std::vector<uint64_t> fences;
+
+      { std::lock_guard lock(m_mutex);
+        for (const auto& entry : m_pending)
+          fences.push_back(entry.first); }
+
+      for (uint64_t fence : fences)
+        Wait(fence);
+    }
+
+    D3D9ConversionStats GetStats() {
+      std::lock_guard lock(m_mutex);
+      return m_stats;
+    }
+
+  private:
+
+    /// Destination bytes per slice, small enough to spread one
+    /// 1024x1024 texture across workers, large enough to amortize
+    /// the per-task overhead
+    static constexpr uint32_t SliceBytes = 256u << 10;
+
+    D3D9ConversionIsa           m_isa;
+
+    std::unique_ptr<TaskScheduler> m_ownScheduler;
+    TaskScheduler*              m_scheduler;
+
+    std::mutex                  m_mutex;
+    std::unordered_map<uint64_t, TaskRef> m_pending;
+    uint64_t                    m_nextFence = 0;
+    D3D9ConversionStats         m_stats;
+
+    static void convertRows(const D3D9ConversionJob& job, D3D9ConversionIsa isa, uint32_t row, uint32_t rows) {
+      D3D9ConvertRowFn fn = D3D9GetConvertRowFn(job.format, isa);
+
+      for (uint32_t y = row; y < row + rows; y++) {
+        fn(job.src + y * job.srcPitch,
+          reinterpret_cast<uint32_t*>(job.dst + y * job.dstPitch),
+          job.width, job.palette);
+      }
+    }
+
+  };
+
+}
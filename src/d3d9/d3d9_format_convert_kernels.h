@@ -0,0 +1,551 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define D3D9_CONVERT_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define D3D9_CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace dxvk {
+
+  /**
+   * \brief Source formats that need CPU conversion
+   *
+   * All of them are converted to B8G8R8A8 (the memory layout of
+   * D3DFMT_A8R8G8B8), which every Metal device supports.
+   */
+  enum class D3D9ConversionFormat : uint32_t {
+    R8G8B8,       ///< D3DFMT_R8G8B8, bytes B, G, R
+    L8,           ///< D3DFMT_L8
+    A8L8,         ///< D3DFMT_A8L8, bytes L, A
+    X1R5G5B5,     ///< D3DFMT_X1R5G5B5
+    A1R5G5B5,     ///< D3DFMT_A1R5G5B5
+    R5G6B5,       ///< D3DFMT_R5G6B5, no B5G6R5 on Intel Macs
+    A4R4G4B4,     ///< D3DFMT_A4R4G4B4
+    P8,           ///< D3DFMT_P8 with a 256-entry palette
+    Count
+  };
+
+
+  /**
+   * \brief Instruction set used by conversion kernels
+   */
+  enum class D3D9ConversionIsa : uint32_t {
+    Scalar,
+    Avx2,
+    Neon,
+  };
+
+
+  /**
+   * \brief Row conversion function
+   *
+   * \param [in] src Source row
+   * \param [out] dst Destination row, B8G8R8A8
+   * \param [in] width Pixel count
+   * \param [in] palette B8G8R8A8 palette, only used for P8
+   */
+  using D3D9ConvertRowFn = void (*) (
+    const uint8_t*  src,
+          uint32_t* dst,
+          uint32_t  width,
+    const uint32_t* palette);
+
+
+  inline uint32_t D3D9ConversionSourceBpp(D3D9ConversionFormat format) {
+    switch (format) {
+      case D3D9ConversionFormat::R8G8B8:   return 3;
+      case D3D9ConversionFormat::L8:       return 1;
+      case D3D9ConversionFormat::P8:       return 1;
+      default:                             return 2;
+    }
+  }
+
+
+  inline const char* D3D9ConversionFormatName(D3D9ConversionFormat format) {
+    switch (format) {
+      case D3D9ConversionFormat::R8G8B8:   return "R8G8B8";
+      case D3D9ConversionFormat::L8:       return "L8";
+      case D3D9ConversionFormat::A8L8:     return "A8L8";
+      case D3D9ConversionFormat::X1R5G5B5: return "X1R5G5B5";
+      case D3D9ConversionFormat::A1R5G5B5: return "A1R5G5B5";
+      case D3D9ConversionFormat::R5G6B5:   return "R5G6B5";
+      case D3D9ConversionFormat::A4R4G4B4: return "A4R4G4B4";
+      case D3D9ConversionFormat::P8:       return "P8";
+      default:                             return "Unknown";
+    }
+  }
+
+
+  /**
+   * \brief Scalar reference kernels
+   *
+   * Bit replication when widening channels, so that 0 maps to 0
+   * and the maximum maps to 255. SIMD kernels must match exactly.
+   */
+  namespace convert_scalar {
+
+    inline uint32_t expand4(uint32_t v) { return (v << 4) | v; }
+    inline uint32_t expand5(uint32_t v) { return (v << 3) | (v >> 2); }
+    inline uint32_t expand6(uint32_t v) { return (v << 2) | (v >> 4); }
+
+    inline uint32_t bgra(uint32_t b, uint32_t g, uint32_t r, uint32_t a) {
+      return b | (g << 8) | (r << 16) | (a << 24);
+    }
+
+    inline uint16_t load16(const uint8_t* src) {
+      uint16_t v;
+      std::memcpy(&v, src, sizeof(v));
+      return v;
+    }
+
+    inline void R8G8B8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 3)
+        dst[x] = bgra(src[0], src[1], src[2], 0xff);
+    }
+
+    inline void L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++)
+        dst[x] = bgra(src[x], src[x], src[x], 0xff);
+    }
+
+    inline void A8L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 2)
+        dst[x] = bgra(src[0], src[0], src[0], src[1]);
+    }
+
+    inline void X1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 2) {
+        uint32_t p = load16(src);
+        dst[x] = bgra(expand5(p & 0x1f), expand5((p >> 5) & 0x1f), expand5((p >> 10) & 0x1f), 0xff);
+      }
+    }
+
+    inline void A1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 2) {
+        uint32_t p = load16(src);
+        dst[x] = bgra(expand5(p & 0x1f), expand5((p >> 5) & 0x1f), expand5((p >> 10) & 0x1f), (p & 0x8000) ? 0xff : 0x00);
+      }
+    }
+
+    inline void R5G6B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 2) {
+        uint32_t p = load16(src);
+        dst[x] = bgra(expand5(p & 0x1f), expand6((p >> 5) & 0x3f), expand5(p >> 11), 0xff);
+      }
+    }
+
+    inline void A4R4G4B4(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t*) {
+      for (uint32_t x = 0; x < width; x++, src += 2) {
+        uint32_t p = load16(src);
+        dst[x] = bgra(expand4(p & 0xf), expand4((p >> 4) & 0xf), expand4((p >> 8) & 0xf), expand4(p >> 12));
+      }
+    }
+
+    inline void P8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      for (uint32_t x = 0; x < width; x++)
+        dst[x] = palette[src[x]];
+    }
+
+  }
+
+
+#ifdef D3D9_CONVERT_X86
+  /**
+   * \brief AVX2 kernels
+   *
+   * Compiled with per-function target attributes so the rest
+   * of the build does not require AVX2; selected at runtime.
+   * Rows are processed in full vectors, the remainder falls
+   * back to the scalar kernel.
+   */
+  namespace convert_avx2 {
+
+#define D3D9_AVX2 __attribute__((target("avx2")))
+
+    D3D9_AVX2 inline __m256i alphaMask() {
+      return _mm256_set1_epi32(int32_t(0xff000000u));
+    }
+
+    D3D9_AVX2 inline void R8G8B8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+      uint32_t x = 0;
+
+      // The upper load reads 16 bytes at pixel 4, i.e. up to
+      // byte 28 of the 8 pixels, so keep two pixels of slack
+      for (; x + 10 <= width; x += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * x + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alphaMask());
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+      }
+
+      convert_scalar::R8G8B8(src + 3 * x, dst + x, width - x, palette);
+    }
+
+    D3D9_AVX2 inline void L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i shuffle0 = _mm256_setr_epi8(
+        0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1,
+        4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1);
+      const __m256i shuffle1 = _mm256_setr_epi8(
+         8,  8,  8, -1,  9,  9,  9, -1, 10, 10, 10, -1, 11, 11, 11, -1,
+        12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1);
+
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        __m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x + 0), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle0), alphaMask()));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x + 8), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle1), alphaMask()));
+      }
+
+      convert_scalar::L8(src + x, dst + x, width - x, palette);
+    }
+
+    D3D9_AVX2 inline void A8L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i shuffle = _mm256_setr_epi8(
+        0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7,
+        8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+
+      uint32_t x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+        __m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * x)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_shuffle_epi8(v, shuffle));
+      }
+
+      convert_scalar::A8L8(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    /* Interleaves 16-bit BG and RA words of 16 pixels into two
+     * registers of eight B8G8R8A8 pixels each, in pixel order */
+    D3D9_AVX2 inline void store16(uint32_t* dst, __m256i bg, __m256i ra) {
+      __m256i lo = _mm256_unpacklo_epi16(bg, ra);
+      __m256i hi = _mm256_unpackhi_epi16(bg, ra);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 0), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+
+    D3D9_AVX2 inline __m256i expand5(__m256i v) {
+      return _mm256_or_si256(_mm256_slli_epi16(v, 3), _mm256_srli_epi16(v, 2));
+    }
+
+    D3D9_AVX2 inline __m256i expand6(__m256i v) {
+      return _mm256_or_si256(_mm256_slli_epi16(v, 2), _mm256_srli_epi16(v, 4));
+    }
+
+    D3D9_AVX2 inline __m256i expand4(__m256i v) {
+      return _mm256_or_si256(_mm256_slli_epi16(v, 4), v);
+    }
+
+    D3D9_AVX2 inline __m256i load16(const uint8_t* src) {
+      return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    }
+
+    template<bool HasAlpha>
+    D3D9_AVX2 inline void X555(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i mask5 = _mm256_set1_epi16(0x1f);
+
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        __m256i p = load16(src + 2 * x);
+        __m256i b = expand5(_mm256_and_si256(p, mask5));
+        __m256i g = expand5(_mm256_and_si256(_mm256_srli_epi16(p, 5), mask5));
+        __m256i r = expand5(_mm256_and_si256(_mm256_srli_epi16(p, 10), mask5));
+        __m256i a = HasAlpha
+          ? _mm256_srai_epi16(p, 15)
+          : _mm256_set1_epi16(-1);
+
+        store16(dst + x,
+          _mm256_or_si256(b, _mm256_slli_epi16(g, 8)),
+          _mm256_or_si256(r, _mm256_slli_epi16(a, 8)));
+      }
+
+      if (HasAlpha)
+        convert_scalar::A1R5G5B5(src + 2 * x, dst + x, width - x, palette);
+      else
+        convert_scalar::X1R5G5B5(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    D3D9_AVX2 inline void X1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      X555<false>(src, dst, width, palette);
+    }
+
+    D3D9_AVX2 inline void A1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      X555<true>(src, dst, width, palette);
+    }
+
+    D3D9_AVX2 inline void R5G6B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i mask5 = _mm256_set1_epi16(0x1f);
+      const __m256i mask6 = _mm256_set1_epi16(0x3f);
+      const __m256i alpha = _mm256_set1_epi16(int16_t(0xff00));
+
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        __m256i p = load16(src + 2 * x);
+        __m256i b = expand5(_mm256_and_si256(p, mask5));
+        __m256i g = expand6(_mm256_and_si256(_mm256_srli_epi16(p, 5), mask6));
+        __m256i r = expand5(_mm256_srli_epi16(p, 11));
+
+        store16(dst + x,
+          _mm256_or_si256(b, _mm256_slli_epi16(g, 8)),
+          _mm256_or_si256(r, alpha));
+      }
+
+      convert_scalar::R5G6B5(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    D3D9_AVX2 inline void A4R4G4B4(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const __m256i mask4 = _mm256_set1_epi16(0xf);
+
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        __m256i p = load16(src + 2 * x);
+        __m256i b = expand4(_mm256_and_si256(p, mask4));
+        __m256i g = expand4(_mm256_and_si256(_mm256_srli_epi16(p, 4), mask4));
+        __m256i r = expand4(_mm256_and_si256(_mm256_srli_epi16(p, 8), mask4));
+        __m256i a = expand4(_mm256_srli_epi16(p, 12));
+
+        store16(dst + x,
+          _mm256_or_si256(b, _mm256_slli_epi16(g, 8)),
+          _mm256_or_si256(r, _mm256_slli_epi16(a, 8)));
+      }
+
+      convert_scalar::A4R4G4B4(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    D3D9_AVX2 inline void P8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      uint32_t x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)));
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), idx, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), v);
+      }
+
+      convert_scalar::P8(src + x, dst + x, width - x, palette);
+    }
+
+#undef D3D9_AVX2
+
+  }
+#endif
+
+
+#ifdef D3D9_CONVERT_NEON
+  /**
+   * \brief NEON kernels
+   *
+   * Structured loads and stores do the (de)interleaving. P8 has
+   * no NEON kernel, table lookups are limited to 64 bytes.
+   */
+  namespace convert_neon {
+
+    inline void R8G8B8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        uint8x16x3_t s = vld3q_u8(src + 3 * x);
+        uint8x16x4_t d = { { s.val[0], s.val[1], s.val[2], vdupq_n_u8(0xff) } };
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      convert_scalar::R8G8B8(src + 3 * x, dst + x, width - x, palette);
+    }
+
+    inline void L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        uint8x16_t l = vld1q_u8(src + x);
+        uint8x16x4_t d = { { l, l, l, vdupq_n_u8(0xff) } };
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      convert_scalar::L8(src + x, dst + x, width - x, palette);
+    }
+
+    inline void A8L8(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      uint32_t x = 0;
+
+      for (; x + 16 <= width; x += 16) {
+        uint8x16x2_t s = vld2q_u8(src + 2 * x);
+        uint8x16x4_t d = { { s.val[0], s.val[0], s.val[0], s.val[1] } };
+        vst4q_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      convert_scalar::A8L8(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    inline uint8x8_t expand5(uint16x8_t v) {
+      return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 3), vshrq_n_u16(v, 2)));
+    }
+
+    inline uint8x8_t expand6(uint16x8_t v) {
+      return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 2), vshrq_n_u16(v, 4)));
+    }
+
+    inline uint8x8_t expand4(uint16x8_t v) {
+      return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 4), v));
+    }
+
+    inline uint16x8_t load16(const uint8_t* src) {
+      return vreinterpretq_u16_u8(vld1q_u8(src));
+    }
+
+    template<bool HasAlpha>
+    inline void X555(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+
+      uint32_t x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+        uint16x8_t p = load16(src + 2 * x);
+        uint8x8x4_t d;
+        d.val[0] = expand5(vandq_u16(p, mask5));
+        d.val[1] = expand5(vandq_u16(vshrq_n_u16(p, 5), mask5));
+        d.val[2] = expand5(vandq_u16(vshrq_n_u16(p, 10), mask5));
+        d.val[3] = HasAlpha
+          ? vmovn_u16(vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(p), 15)))
+          : vdup_n_u8(0xff);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      if (HasAlpha)
+        convert_scalar::A1R5G5B5(src + 2 * x, dst + x, width - x, palette);
+      else
+        convert_scalar::X1R5G5B5(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    inline void X1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      X555<false>(src, dst, width, palette);
+    }
+
+    inline void A1R5G5B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      X555<true>(src, dst, width, palette);
+    }
+
+    inline void R5G6B5(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      uint32_t x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+        uint16x8_t p = load16(src + 2 * x);
+        uint8x8x4_t d;
+        d.val[0] = expand5(vandq_u16(p, vdupq_n_u16(0x1f)));
+        d.val[1] = expand6(vandq_u16(vshrq_n_u16(p, 5), vdupq_n_u16(0x3f)));
+        d.val[2] = expand5(vshrq_n_u16(p, 11));
+        d.val[3] = vdup_n_u8(0xff);
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      convert_scalar::R5G6B5(src + 2 * x, dst + x, width - x, palette);
+    }
+
+    inline void A4R4G4B4(const uint8_t* src, uint32_t* dst, uint32_t width, const uint32_t* palette) {
+      const uint16x8_t mask4 = vdupq_n_u16(0xf);
+
+      uint32_t x = 0;
+
+      for (; x + 8 <= width; x += 8) {
+        uint16x8_t p = load16(src + 2 * x);
+        uint8x8x4_t d;
+        d.val[0] = expand4(vandq_u16(p, mask4));
+        d.val[1] = expand4(vandq_u16(vshrq_n_u16(p, 4), mask4));
+        d.val[2] = expand4(vandq_u16(vshrq_n_u16(p, 8), mask4));
+        d.val[3] = expand4(vshrq_n_u16(p, 12));
+        vst4_u8(reinterpret_cast<uint8_t*>(dst + x), d);
+      }
+
+      convert_scalar::A4R4G4B4(src + 2 * x, dst + x, width - x, palette);
+    }
+
+  }
+#endif
+
+
+  /**
+   * \brief Picks the best instruction set for this CPU
+   *
+   * Wine on Apple Silicon runs x86 code under Rosetta, which
+   * only exposes AVX2 on recent macOS versions, so the scalar
+   * fallback has to stay fast enough on its own.
+   */
+  inline D3D9ConversionIsa D3D9GetBestConversionIsa() {
+#if defined(D3D9_CONVERT_X86)
+    if (__builtin_cpu_supports("avx2"))
+      return D3D9ConversionIsa::Avx2;
+#elif defined(D3D9_CONVERT_NEON)
+    return D3D9ConversionIsa::Neon;
+#endif
+    return D3D9ConversionIsa::Scalar;
+  }
+
+
+  /**
+   * \brief Looks up the row kernel for a format
+   *
+   * Falls back to the scalar kernel if the requested
+   * instruction set is not available for the format.
+   */
+  inline D3D9ConvertRowFn D3D9GetConvertRowFn(D3D9ConversionFormat format, D3D9ConversionIsa isa) {
+#define D3D9_CONVERT_CASE(ns, fmt) case D3D9ConversionFormat::fmt: return &ns::fmt
+
+#if defined(D3D9_CONVERT_X86)
+    if (isa == D3D9ConversionIsa::Avx2) {
+      switch (format) {
+        D3D9_CONVERT_CASE(convert_avx2, R8G8B8);
+        D3D9_CONVERT_CASE(convert_avx2, L8);
+        D3D9_CONVERT_CASE(convert_avx2, A8L8);
+        D3D9_CONVERT_CASE(convert_avx2, X1R5G5B5);
+        D3D9_CONVERT_CASE(convert_avx2, A1R5G5B5);
+        D3D9_CONVERT_CASE(convert_avx2, R5G6B5);
+        D3D9_CONVERT_CASE(convert_avx2, A4R4G4B4);
+        D3D9_CONVERT_CASE(convert_avx2, P8);
+        default: break;
+      }
+    }
+#elif defined(D3D9_CONVERT_NEON)
+    if (isa == D3D9ConversionIsa::Neon) {
+      switch (format) {
+        D3D9_CONVERT_CASE(convert_neon, R8G8B8);
+        D3D9_CONVERT_CASE(convert_neon, L8);
+        D3D9_CONVERT_CASE(convert_neon, A8L8);
+        D3D9_CONVERT_CASE(convert_neon, X1R5G5B5);
+        D3D9_CONVERT_CASE(convert_neon, A1R5G5B5);
+        D3D9_CONVERT_CASE(convert_neon, R5G6B5);
+        D3D9_CONVERT_CASE(convert_neon, A4R4G4B4);
+        default: break;
+      }
+    }
+#else
+    (void)isa;
+#endif
+
+    switch (format) {
+      D3D9_CONVERT_CASE(convert_scalar, R8G8B8);
+      D3D9_CONVERT_CASE(convert_scalar, L8);
+      D3D9_CONVERT_CASE(convert_scalar, A8L8);
+      D3D9_CONVERT_CASE(convert_scalar, X1R5G5B5);
+      D3D9_CONVERT_CASE(convert_scalar, A1R5G5B5);
+      D3D9_CONVERT_CASE(convert_scalar, R5G6B5);
+      D3D9_CONVERT_CASE(convert_scalar, A4R4G4B4);
+      D3D9_CONVERT_CASE(convert_scalar, P8);
+      default: return nullptr;
+    }
+
+#undef D3D9_CONVERT_CASE
+  }
+
+}
@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Query resolver options
+   */
+  struct D3D9QueryResolverOptions {
+    /// Query pool slots. Must cover all queries issued over the
+    /// frame latency plus \c maxPollFrames, otherwise Begin waits
+    /// for the batch that last used a slot.
+    uint32_t poolSize       = 4096;
+    /// GetData with D3DGETDATA_FLUSH only blocks once the query
+    /// has been ended this many frames ago
+    uint32_t maxPollFrames  = 2;
+    /// GetData with D3DGETDATA_FLUSH on a query that is still in
+    /// the current batch resolves the batch early after this many
+    /// polls, so apps spinning on a query within a frame progress
+    uint32_t spinPolls      = 64;
+  };
+
+
+  /**
+   * \brief Query result slot in the resolve buffer
+   *
+   * Matches vkCmdCopyQueryPoolResults with VK_QUERY_RESULT_64_BIT
+   * and VK_QUERY_RESULT_WITH_AVAILABILITY_BIT, with a stride of
+   * 16 bytes.
+   */
+  struct D3D9QueryResultSlot {
+    uint64_t value;
+    uint64_t available;
+  };
+
+
+  /**
+   * \brief Batched query state
+   *
+   * Embedded in D3D9Query. Only touched by the resolver.
+   */
+  struct D3D9BatchedQuery {
+    uint64_t  alloc     = 0;  ///< Allocation number, slot is alloc % poolSize
+    uint64_t  batch     = 0;  ///< Resolve batch, 0 if not ended
+    uint64_t  endFrame  = 0;
+    uint64_t  value     = 0;
+    uint32_t  polls     = 0;
+    bool      ended     = false;
+    bool      ready     = false;
+  };
+
+
+  /**
+   * \brief GetData result
+   */
+  enum class D3D9QueryStatus : uint32_t {
+    Ready,      ///< Value is valid, S_OK
+    NotReady,   ///< S_FALSE, no flush needed
+    Flush,      ///< The batch was resolved early, caller must submit
+  };
+
+
+  /**
+   * \brief Query resolver statistics
+   */
+  struct D3D9QueryResolverStats {
+    uint64_t batches      = 0;  ///< Resolve batches recorded
+    uint64_t copies       = 0;  ///< Copy commands recorded
+    uint64_t earlyFlushes = 0;  ///< Submits caused by GetData
+    uint64_t waits        = 0;  ///< GetData calls that blocked
+    uint64_t polls        = 0;  ///< GetData calls
+    uint64_t slotWaits    = 0;  ///< Begin calls that waited for a slot
+    uint64_t lostResults  = 0;  ///< Results overwritten before GetData
+    uint64_t requeues     = 0;  ///< Slots copied before their query finished
+  };
+
+
+  /**
+   * \brief Batched query resolver
+   *
+   * With D3DGETDATA_FLUSH, GetData on a pending query flushes the
+   * command list so the query makes progress. Games poll dozens of
+   * occlusion queries per frame, and every one of those flushes is
+   * a separate submit, which is expensive with MoltenVK.
+   *
+   * The resolver allocates query pool slots linearly and records one
+   * vkCmdCopyQueryPoolResults per contiguous run of slots ended in
+   * the frame, usually a single one, into a persistently mapped
+   * buffer. Queries begun but not yet ended are still active and
+   * must not be copied, so they split the runs and go with the
+   * batch they end in. GetData only looks at that buffer:
+   *
+   * - Once the copy has completed, the result is returned. Copies
+   *   do not wait for the query, so a slot the GPU had not finished
+   *   yet is copied again with the next batch.
+   * - Otherwise the query is reported as not ready without flushing,
+   *   since the copy is submitted with the frame anyway.
+   * - With D3DGETDATA_FLUSH, queries ended \c maxPollFrames frames
+   *   ago block on their copy instead, and queries still in the
+   *   current batch resolve it early after \c spinPolls polls, in
+   *   which case the caller has to submit.
+   *
+   * The device resets each slot before reusing it, e.g. with
+   * vkCmdResetQueryPool in Begin. Not thread-safe, calls are
+   * serialized by the device lock.
+   */
+  class D3D9QueryBatchResolver {
+
+  public:
+
+    /// Records a copy of \c count slots starting at \c first into
+    /// the resolve buffer at the same offset
+    using CopyFn     = std::function<void (uint32_t first, uint32_t count)>;
+    /// Returns the sequence number of the command list the copies
+    /// of the current batch are recorded into
+    using SequenceFn = std::function<uint64_t ()>;
+    using IsDoneFn   = std::function<bool (uint64_t sequence)>;
+    /// Waits for a sequence number, submitting the current
+    /// command list first if it has not been submitted yet
+    using WaitFn     = std::function<void (uint64_t sequence)>;
+
+    D3D9QueryBatchResolver(
+      const D3D9QueryResolverOptions& options,
+      const D3D9QueryResultSlot*      results,
+            CopyFn                    copy,
+            SequenceFn                sequence,
+            IsDoneFn                  isDone,
+            WaitFn                    wait)
+    : m_options   (options),
+      m_results   (results),
+      m_copy      (std::move(copy)),
+      m_sequence  (std::move(sequence)),
+      m_isDone    (std::move(isDone)),
+      m_wait      (std::move(wait)),
+      m_slotOwner (options.poolSize, 0),
+      m_slotBatch (options.poolSize, 0) { }
+
+    D3D9QueryBatchResolver             (const D3D9QueryBatchResolver&) = delete;
+    D3D9QueryBatchResolver& operator = (const D3D9QueryBatchResolver&) = delete;
+
+    /**
+     * \brief Allocates a slot for a query
+     *
+     * Called from Issue(D3DISSUE_BEGIN), or from Issue(D3DISSUE_END)
+     * for queries without a begin. Discards any previous result.
+     * \returns Query pool slot to begin or write the query to
+     */
+    uint32_t Begin(D3D9BatchedQuery& query) {
+      uint64_t alloc = ++m_nextAlloc;
+      uint32_t slot = uint32_t(alloc % m_options.poolSize);
+
+      // The previous user of the slot must have been copied out
+      // before the device resets it
+      uint64_t prevBatch = m_slotBatch[slot];
+
+      if (prevBatch > m_completedBatch)
+        updateCompleted();
+
+      if (prevBatch > m_completedBatch) {
+        if (prevBatch == m_currentBatch)
+          ResolveBatch();
+
+        waitForBatch(prevBatch);
+        m_stats.slotWaits += 1;
+      }
+
+      m_slotOwner[slot] = alloc;
+
+      query = D3D9BatchedQuery();
+      query.alloc = alloc;
+      return slot;
+    }
+
+    /**
+     * \brief Ends a query
+     *
+     * Adds the query to the current batch.
+     */
+    void End(D3D9BatchedQuery& query) {
+      query.ended     = true;
+      query.batch     = m_currentBatch;
+      query.endFrame  = m_frame;
+
+      uint32_t slot = uint32_t(query.alloc % m_options.poolSize);
+
+      if (m_slotBatch[slot] != m_currentBatch) {
+        m_slotBatch[slot] = m_currentBatch;
+        m_batchSlots.push_back(slot);
+      }
+    }
+
+    /**
+     * \brief Polls a query result
+     *
+     * \param [in] query Query
+     * \param [in] flush Whether D3DGETDATA_FLUSH was set
+     * \param [out] value Result, valid if \c Ready is returned
+     */
+    D3D9QueryStatus GetData(D3D9BatchedQuery& query, bool flush, uint64_t& value) {
+      m_stats.polls += 1;
+
+      if (query.ready) {
+        value = query.value;
+        return D3D9QueryStatus::Ready;
+      }
+
+      if (!query.ended)
+        return D3D9QueryStatus::NotReady;
+
+      if (query.batch == m_currentBatch) {
+        // Nothing to poll until the batch is copied. Only resolve
+        // early if the app keeps spinning on this query.
+        if (flush && ++query.polls >= m_options.spinPolls) {
+          ResolveBatch();
+          m_stats.earlyFlushes += 1;
+          return D3D9QueryStatus::Flush;
+        }
+
+        return D3D9QueryStatus::NotReady;
+      }
+
+      updateCompleted();
+
+      if (query.batch > m_completedBatch) {
+        if (!flush || m_frame - query.endFrame < m_options.maxPollFrames)
+          return D3D9QueryStatus::NotReady;
+
+        waitForBatch(query.batch);
+        m_stats.waits += 1;
+      }
+
+      return readResult(query, value);
+    }
+
+    /**
+     * \brief Records the copy for the current batch
+     *
+     * Called at the end of each frame before the final submit,
+     * and when GetData resolves a batch early.
+     */
+    void ResolveBatch() {
+      if (!m_batchSlots.empty()) {
+        // Slots are ended roughly in allocation order, so sorting
+        // is cheap and most batches collapse into a single run
+        std::sort(m_batchSlots.begin(), m_batchSlots.end());
+
+        size_t runStart = 0;
+
+        for (size_t i = 1; i <= m_batchSlots.size(); i++) {
+          if (i == m_batchSlots.size() || m_batchSlots[i] != m_batchSlots[i - 1] + 1) {
+            m_copy(m_batchSlots[runStart], uint32_t(i - runStart));
+            m_stats.copies += 1;
+            runStart = i;
+          }
+        }
+
+        m_inFlight.push_back({ m_currentBatch, m_sequence() });
+        m_stats.batches += 1;
+      } else if (m_inFlight.empty()) {
+        // Empty batch, nothing can reference it
+        m_completedBatch = m_currentBatch;
+      } else {
+        // Keep batches ordered behind the ones still in flight
+        m_inFlight.push_back({ m_currentBatch, m_sequence() });
+      }
+
+      m_batchSlots.clear();
+      m_currentBatch += 1;
+    }
+
+    /**
+     * \brief Ends the frame
+     */
+    void EndFrame() {
+      ResolveBatch();
+      m_frame += 1;
+    }
+
+    D3D9QueryResolverStats GetStats() const {
+      return m_stats;
+    }
+
+  private:
+
+    D3D9QueryResolverOptions    m_options;
+    const D3D9QueryResultSlot*  m_results;
+
+    CopyFn                      m_copy;
+    SequenceFn                  m_sequence;
+    IsDoneFn                    m_isDone;
+    WaitFn                      m_wait;
+
+    std::vector<uint64_t>       m_slotOwner;
+    std::vector<uint64_t>       m_slotBatch;
+
+    /// Slots ended in the current batch
+    std::vector<uint32_t>       m_batchSlots;
+
+    /// Batches whose copy has been recorded but not completed,
+    /// with the sequence number of their command list
+    std::deque<std::pair<uint64_t, uint64_t>> m_inFlight;
+
+    uint64_t                    m_nextAlloc       = 0;
+    uint64_t                    m_currentBatch    = 1;
+    uint64_t                    m_completedBatch  = 0;
+    uint64_t                    m_frame           = 0;
+
+    D3D9QueryResolverStats      m_stats;
+
+    void updateCompleted() {
+      // Command lists complete in order, so do batches
+      while (!m_inFlight.empty() && m_isDone(m_inFlight.front().second)) {
+        m_completedBatch = m_inFlight.front().first;
+        m_inFlight.pop_front();
+      }
+    }
+
+    void waitForBatch(uint64_t batch) {
+      while (!m_inFlight.empty() && m_inFlight.front().first <= batch) {
+        m_wait(m_inFlight.front().second);
+        m_completedBatch = m_inFlight.front().first;
+        m_inFlight.pop_front();
+      }
+
+      m_completedBatch = std::max(m_completedBatch, batch);
+    }
+
+    void requeue(D3D9BatchedQuery& query, uint32_t slot) {
+      query.batch = m_currentBatch;
+      query.polls = 0;
+
+      m_stats.requeues += 1;
+
+      if (m_slotBatch[slot] != m_currentBatch) {
+        m_slotBatch[slot] = m_currentBatch;
+        m_batchSlots.push_back(slot);
+      }
+    }
+
+    D3D9QueryStatus readResult(D3D9BatchedQuery& query, uint64_t& value) {
+      uint32_t slot = uint32_t(query.alloc % m_options.poolSize);
+
+      if (m_slotOwner[slot] != query.alloc) {
+        // Slot was reused before the app asked. Report the query as
+        // fully visible, the conservative answer for occlusion tests.
+        m_stats.lostResults += 1;
+        query.value = ~0ull;
+      } else {
+        if (!m_results[slot].available) {
+          // The copy ran before the query finished, nothing copies
+          // the slot again unless it goes into the next batch
+          requeue(query, slot);
+          return D3D9QueryStatus::NotReady;
+        }
+
+        query.value = m_results[slot].value;
+      }
+
+      query.ready = true;
+      value = query.value;
+      return D3D9QueryStatus::Ready;
+    }
+
+  };
+
+}
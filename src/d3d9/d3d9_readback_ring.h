@@ -0,0 +1,315 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Readback ring options
+   */
+  struct D3D9ReadbackOptions {
+    /// Serve reads from copies made at the end of earlier frames
+    /// instead of syncing. Opt-in, set by whoever creates the
+    /// ring; no config option maps to it yet.
+    bool      enabled     = false;
+    /// Staging buffers per surface. Must exceed the frame latency,
+    /// otherwise copies get skipped while the GPU still owns a slot.
+    uint32_t  slotCount   = 3;
+    /// Surfaces not read for this many frames lose their buffers
+    uint32_t  idleFrames  = 60;
+  };
+
+
+  /**
+   * \brief Host-visible staging buffer
+   */
+  struct D3D9ReadbackBuffer {
+    void*     mapPtr  = nullptr;
+    uint64_t  handle  = 0;
+  };
+
+
+  /**
+   * \brief Readback result
+   */
+  enum class D3D9ReadbackStatus : uint32_t {
+    Sync,       ///< No usable copy, caller must do the synchronous readback
+    Served,     ///< Data is from an earlier frame, no sync needed
+    Waited,     ///< Had to wait for a pending copy, but not for the device
+  };
+
+
+  struct D3D9ReadbackResult {
+    D3D9ReadbackStatus  status    = D3D9ReadbackStatus::Sync;
+    const void*         data      = nullptr;
+    uint32_t            frameAge  = 0;  ///< Frames between copy and read
+  };
+
+
+  /**
+   * \brief Readback statistics
+   */
+  struct D3D9ReadbackStats {
+    uint64_t syncsAvoided   = 0;  ///< Reads served without any wait
+    uint64_t syncsForced    = 0;  ///< Reads that needed a full sync
+    uint64_t copyWaits      = 0;  ///< Reads that waited on one copy
+    uint64_t waitTimeUs     = 0;  ///< Time spent in copy waits
+    uint64_t copiesIssued   = 0;
+    uint64_t copiesSkipped  = 0;  ///< Slot still owned by the GPU
+    uint32_t surfaces       = 0;  ///< Surfaces with staging buffers
+  };
+
+
+  /**
+   * \brief Readback ring for render target reads
+   *
+   * GetRenderTargetData and read locks of render targets normally
+   * flush and wait for the GPU to go idle, which costs tens of ms
+   * with MoltenVK's submit overhead. Games mostly use these for
+   * screenshots, minimaps and post-processing that tolerates being
+   * one frame behind.
+   *
+   * Once a surface has been read, the ring copies it into one of
+   * its host-visible staging buffers at the end of every frame. The
+   * next read returns the newest copy the GPU has finished instead
+   * of syncing. Only the first read of a surface, or a read without
+   * any completed or pending copy, takes the synchronous path.
+   *
+   * GPU interaction goes through callbacks so the ring does not
+   * depend on the device: \c copy records an image to buffer copy
+   * and returns its submission sequence number, \c isDone and \c wait
+   * query and wait for a sequence number.
+   *
+   * Not thread-safe, calls are serialized by the device lock.
+   */
+  class D3D9ReadbackRing {
+
+  public:
+
+    using AllocFn   = std::function<D3D9ReadbackBuffer (size_t size)>;
+    using FreeFn    = std::function<void (const D3D9ReadbackBuffer& buffer)>;
+    using CopyFn    = std::function<uint64_t (uint64_t surface, const D3D9ReadbackBuffer& buffer)>;
+    using IsDoneFn  = std::function<bool (uint64_t sequence)>;
+    using WaitFn    = std::function<void (uint64_t sequence)>;
+
+    D3D9ReadbackRing(
+      const D3D9ReadbackOptions& options,
+            AllocFn              alloc,
+            FreeFn               free,
+            CopyFn               copy,
+            IsDoneFn             isDone,
+            WaitFn               wait)
+    : m_options (options),
+      m_alloc   (std::move(alloc)),
+      m_free    (std::move(free)),
+      m_copy    (std::move(copy)),
+      m_isDone  (std::move(isDone)),
+      m_wait    (std::move(wait)) { }
+
+    ~D3D9ReadbackRing() {
+      for (auto& s : m_surfaces)
+        freeSurface(s.second);
+    }
+
+    D3D9ReadbackRing             (const D3D9ReadbackRing&) = delete;
+    D3D9ReadbackRing& operator = (const D3D9ReadbackRing&) = delete;
+
+    bool IsEnabled() const {
+      return m_options.enabled;
+    }
+
+    /**
+     * \brief Reads back a surface
+     *
+     * \param [in] surface Surface ID
+     * \param [in] size Size of the surface data in bytes
+     * \returns Data of the newest usable copy, or \c Sync if the
+     *    caller has to read back synchronously. The data pointer
+     *    stays valid until the next call to \ref EndFrame.
+     */
+    D3D9ReadbackResult Read(uint64_t surface, size_t size) {
+      D3D9ReadbackResult result;
+
+      if (!m_options.enabled) {
+        m_stats.syncsForced += 1;
+        return result;
+      }
+
+      auto entry = m_surfaces.find(surface);
+
+      if (entry == m_surfaces.end() || entry->second.size != size) {
+        // First read, or the surface was recreated with another size:
+        // sync this time and start copying at the end of each frame
+        if (entry != m_surfaces.end()) {
+          freeSurface(entry->second);
+          m_surfaces.erase(entry);
+        }
+
+        SurfaceEntry& s = m_surfaces[surface];
+        s.size = size;
+        s.lastRead = m_frame;
+        s.slots.resize(m_options.slotCount);
+
+        m_stats.syncsForced += 1;
+        return result;
+      }
+
+      SurfaceEntry& s = entry->second;
+      s.lastRead = m_frame;
+
+      // Newest completed copy wins. Without one, waiting for the
+      // newest pending copy is still much cheaper than flushing
+      // and idling the device.
+      Slot* newestDone = nullptr;
+      Slot* newestPending = nullptr;
+
+      for (Slot& slot : s.slots) {
+        if (!slot.valid)
+          continue;
+
+        if (!slot.done)
+          slot.done = m_isDone(slot.sequence);
+
+        Slot*& best = slot.done ? newestDone : newestPending;
+
+        if (!best || slot.frame > best->frame)
+          best = &slot;
+      }
+
+      if (newestDone) {
+        result.status = D3D9ReadbackStatus::Served;
+        result.data = newestDone->buffer.mapPtr;
+        result.frameAge = uint32_t(m_frame - newestDone->frame);
+        m_stats.syncsAvoided += 1;
+        return result;
+      }
+
+      if (newestPending) {
+        auto start = std::chrono::steady_clock::now();
+        m_wait(newestPending->sequence);
+        newestPending->done = true;
+
+        m_stats.copyWaits += 1;
+        m_stats.waitTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count();
+
+        result.status = D3D9ReadbackStatus::Waited;
+        result.data = newestPending->buffer.mapPtr;
+        result.frameAge = uint32_t(m_frame - newestPending->frame);
+        return result;
+      }
+
+      m_stats.syncsForced += 1;
+      return result;
+    }
+
+    /**
+     * \brief Issues the end-of-frame copies
+     *
+     * Copies every surface read within the last \c idleFrames
+     * frames into its next staging slot, and drops idle surfaces.
+     * Call before submitting the frame's last command list.
+     */
+    void EndFrame() {
+      for (auto s = m_surfaces.begin(); s != m_surfaces.end(); ) {
+        SurfaceEntry& e = s->second;
+
+        if (m_frame - e.lastRead > m_options.idleFrames) {
+          freeSurface(e);
+          s = m_surfaces.erase(s);
+          continue;
+        }
+
+        Slot& slot = e.slots[e.nextSlot];
+
+        if (slot.valid && !slot.done && !(slot.done = m_isDone(slot.sequence))) {
+          m_stats.copiesSkipped += 1;
+        } else {
+          if (!slot.buffer.mapPtr)
+            slot.buffer = m_alloc(e.size);
+
+          slot.sequence = m_copy(s->first, slot.buffer);
+          slot.frame    = m_frame;
+          slot.valid    = true;
+          slot.done     = false;
+
+          e.nextSlot = (e.nextSlot + 1) % uint32_t(e.slots.size());
+          m_stats.copiesIssued += 1;
+        }
+
+        ++s;
+      }
+
+      m_frame += 1;
+    }
+
+    /**
+     * \brief Drops a surface, e.g. on release or reset
+     */
+    void Remove(uint64_t surface) {
+      auto entry = m_surfaces.find(surface);
+
+      if (entry != m_surfaces.end()) {
+        freeSurface(entry->second);
+        m_surfaces.erase(entry);
+      }
+    }
+
+    D3D9ReadbackStats GetStats() const {
+      D3D9ReadbackStats stats = m_stats;
+      stats.surfaces = uint32_t(m_surfaces.size());
+      return stats;
+    }
+
+  private:
+
+    struct Slot {
+      D3D9ReadbackBuffer  buffer;
+      uint64_t            sequence  = 0;
+      uint64_t            frame     = 0;
+      bool                valid     = false;
+      bool                done      = false;
+    };
+
+    struct SurfaceEntry {
+      size_t              size      = 0;
+      uint64_t            lastRead  = 0;
+      uint32_t            nextSlot  = 0;
+      std::vector<Slot>   slots;
+    };
+
+    D3D9ReadbackOptions   m_options;
+
+    AllocFn               m_alloc;
+    FreeFn                m_free;
+    CopyFn                m_copy;
+    IsDoneFn              m_isDone;
+    WaitFn                m_wait;
+
+    uint64_t              m_frame = 0;
+    D3D9ReadbackStats     m_stats;
+
+    std::unordered_map<uint64_t, SurfaceEntry> m_surfaces;
+
+    void freeSurface(SurfaceEntry& e) {
+      for (Slot& slot : e.slots) {
+        if (!slot.buffer.mapPtr)
+          continue;
+
+        // The GPU may still be writing to the buffer
+        if (slot.valid && !slot.done)
+          m_wait(slot.sequence);
+
+        m_free(slot.buffer);
+        slot.buffer = D3D9ReadbackBuffer();
+      }
+    }
+
+  };
+
+}
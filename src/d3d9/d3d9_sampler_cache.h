@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace dxvk {
+
+  /**
+   * \brief D3D9 sampler state
+   *
+   * Raw values as set through SetSamplerState, using the
+   * D3DTEXTUREADDRESS and D3DTEXTUREFILTERTYPE enums.
+   */
+  struct D3D9SamplerState {
+    uint32_t  addressU      = 1;  ///< D3DTADDRESS_WRAP
+    uint32_t  addressV      = 1;
+    uint32_t  addressW      = 1;
+    uint32_t  borderColor   = 0;
+    uint32_t  magFilter     = 1;  ///< D3DTEXF_POINT
+    uint32_t  minFilter     = 1;
+    uint32_t  mipFilter     = 0;  ///< D3DTEXF_NONE
+    float     mipLodBias    = 0.0f;
+    uint32_t  maxMipLevel   = 0;
+    uint32_t  maxAnisotropy = 1;
+    uint32_t  depthCompare  = 0;  ///< Bound to a depth texture
+  };
+
+
+  /**
+   * \brief Packed sampler key
+   *
+   * Low 32 bits hold the sampler state, high 32 bits the border
+   * color. Fields that do not affect the sampler are zeroed, so
+   * equivalent states share a key. Bit 31 is always set, so a
+   * valid key is never zero.
+   *
+   * | Bits  | Field                                   |
+   * |-------|-----------------------------------------|
+   * | 0-8   | Address U/V/W, D3DTADDRESS - 1          |
+   * | 9-14  | Mag/min/mip filter, clamped to 3        |
+   * | 15-18 | Max anisotropy - 1, 0 unless anisotropic |
+   * | 19-22 | Max mip level                           |
+   * | 23-29 | LOD bias in 1/4 steps, biased by 64     |
+   * | 30    | Depth compare                           |
+   * | 31    | Valid                                   |
+   * | 32-63 | Border color, 0 unless an address mode is border |
+   */
+  using D3D9SamplerKey = uint64_t;
+
+
+  /**
+   * \brief Packs sampler state into a key
+   *
+   * Branch-free: clamps use min/max and the masks for anisotropy
+   * and border color come from comparisons, so this compiles to
+   * straight-line code with a lot of SetSamplerState churn.
+   */
+  inline D3D9SamplerKey D3D9PackSamplerKey(const D3D9SamplerState& s) {
+    constexpr uint32_t Border = 4;       // D3DTADDRESS_BORDER
+    constexpr uint32_t Anisotropic = 3;  // D3DTEXF_ANISOTROPIC
+
+    uint64_t u = std::min(s.addressU - 1u, 4u);
+    uint64_t v = std::min(s.addressV - 1u, 4u);
+    uint64_t w = std::min(s.addressW - 1u, 4u);
+
+    uint64_t mag = std::min(s.magFilter, 3u);
+    uint64_t min = std::min(s.minFilter, 3u);
+    uint64_t mip = std::min(s.mipFilter, 3u);
+
+    uint64_t isAniso = uint64_t((s.magFilter == Anisotropic) | (s.minFilter == Anisotropic));
+    uint64_t aniso = uint64_t(std::min(std::max(s.maxAnisotropy, 1u) - 1u, 15u)) & (0 - isAniso);
+
+    uint64_t maxMip = std::min(s.maxMipLevel, 15u);
+
+    // Round to the nearest 1/4, [-16, 15.75] maps to [0, 127], NaN to 0
+    float bias = std::min(15.75f, std::max(-16.0f, s.mipLodBias));
+    uint64_t lodBias = uint64_t(bias * 4.0f + 64.5f);
+
+    uint64_t isBorder = uint64_t((s.addressU == Border) | (s.addressV == Border) | (s.addressW == Border));
+    uint64_t border = uint64_t(s.borderColor) & (0 - isBorder);
+
+    return u | (v << 3) | (w << 6)
+         | (mag << 9) | (min << 11) | (mip << 13)
+         | (aniso << 15) | (maxMip << 19) | (lodBias << 23)
+         | (uint64_t(s.depthCompare != 0) << 30)
+         | (1ull << 31) | (border << 32);
+  }
+
+
+  /**
+   * \brief Unpacks a key into normalized sampler state
+   */
+  inline D3D9SamplerState D3D9UnpackSamplerKey(D3D9SamplerKey key) {
+    D3D9SamplerState s;
+    s.addressU      = uint32_t((key >>  0) & 0x7) + 1;
+    s.addressV      = uint32_t((key >>  3) & 0x7) + 1;
+    s.addressW      = uint32_t((key >>  6) & 0x7) + 1;
+    s.magFilter     = uint32_t((key >>  9) & 0x3);
+    s.minFilter     = uint32_t((key >> 11) & 0x3);
+    s.mipFilter     = uint32_t((key >> 13) & 0x3);
+    s.maxAnisotropy = uint32_t((key >> 15) & 0xf) + 1;
+    s.maxMipLevel   = uint32_t((key >> 19) & 0xf);
+    s.mipLodBias    = float(int32_t((key >> 23) & 0x7f) - 64) * 0.25f;
+    s.depthCompare  = uint32_t((key >> 30) & 0x1);
+    s.borderColor   = uint32_t(key >> 32);
+    return s;
+  }
+
+
+  /**
+   * \brief Sampler cache options
+   */
+  struct D3D9SamplerCacheOptions {
+    /// Slots in the bindless sampler heap
+    uint32_t heapSize     = 1024;
+    /// Distinct keys the cache can remember. Keys stay in the map
+    /// for the lifetime of the device, only heap slots are reused.
+    uint32_t keyCapacity  = 8192;
+    /// Frames a slot must be unused before it can be reused,
+    /// i.e. the maximum number of frames in flight
+    uint32_t frameLatency = 3;
+  };
+
+
+  /**
+   * \brief Sampler cache statistics
+   *
+   * Only slow paths are counted, hits are lookups minus misses.
+   */
+  struct D3D9SamplerCacheStats {
+    uint64_t misses     = 0;  ///< Lookups that had to write a heap slot
+    uint64_t evictions  = 0;  ///< Heap slots reused for another key
+    uint64_t overflows  = 0;  ///< Lookups without a usable heap slot
+    uint32_t keys       = 0;  ///< Distinct keys seen
+  };
+
+
+  /**
+   * \brief Lock-free sampler cache
+   *
+   * Maps packed sampler keys to slots in the bindless sampler heap
+   * that the fixed-function shaders index through the packed sampler
+   * indices push constant. FNV changes sampler state per draw, so
+   * this runs for every draw on the game thread and never takes a
+   * lock:
+   *
+   * - Keys live in an open-addressing table of atomics. New keys
+   *   are inserted with a CAS and never removed, so probing needs no
+   *   tombstones and a hit is one or two atomic loads.
+   * - Each key record holds its heap slot. Every heap slot records
+   *   its owning key, so a slot taken over by another key is detected
+   *   on lookup and the key simply gets a new slot.
+   * - Unused slots are handed out first. Once the heap is full, the
+   *   least recently used slot that has not been used for
+   *   \c frameLatency frames is reused. If there is none, the lookup
+   *   fails and the caller falls back to a regular sampler binding.
+   *
+   * The write callback creates the sampler and writes its descriptor
+   * into the heap slot. It may run concurrently for different slots.
+   */
+  class D3D9SamplerCache {
+
+  public:
+
+    static constexpr uint32_t InvalidSlot = ~0u;
+
+    using WriteFn = std::function<void (uint32_t slot, D3D9SamplerKey key)>;
+
+    D3D9SamplerCache(
+      const D3D9SamplerCacheOptions& options,
+            WriteFn                  write)
+    : m_options   (options),
+      m_write     (std::move(write)),
+      m_mask      (roundUpPow2(std::min(options.keyCapacity, uint32_t(OwnerMask >> 2)) * 2) - 1),
+      m_keys      (new std::atomic<uint64_t>[m_mask + 1]),
+      m_records   (new Record[m_mask + 1]),
+      m_slots     (new Slot[options.heapSize]) {
+      for (uint32_t i = 0; i <= m_mask; i++)
+        m_keys[i].store(0, std::memory_order_relaxed);
+    }
+
+    D3D9SamplerCache             (const D3D9SamplerCache&) = delete;
+    D3D9SamplerCache& operator = (const D3D9SamplerCache&) = delete;
+
+    /**
+     * \brief Looks up the heap slot for a sampler
+     *
+     * \param [in] key Packed sampler key
+     * \returns Heap slot, or \c InvalidSlot if the key table is
+     *    full or all heap slots are in use by frames in flight
+     */
+    uint32_t Lookup(D3D9SamplerKey key) {
+      uint32_t index = findOrInsert(key);
+
+      if (index == InvalidSlot) {
+        m_stats.overflows.fetch_add(1, std::memory_order_relaxed);
+        return InvalidSlot;
+      }
+
+      Record& record = m_records[index];
+      uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+      while (true) {
+        uint32_t slot = record.slot.load(std::memory_order_acquire);
+
+        if (slot == PendingSlot) {
+          // Another thread is writing the descriptor
+          std::this_thread::yield();
+          continue;
+        }
+
+        if (slot != InvalidSlot && touch(m_slots[slot], index, frame))
+          return slot;
+
+        // Not resident, or the slot was taken over by another key
+        if (record.slot.compare_exchange_weak(slot, PendingSlot, std::memory_order_acquire))
+          return assignSlot(record, index, frame);
+      }
+    }
+
+    /**
+     * \brief Packs the state and looks it up
+     */
+    uint32_t Lookup(const D3D9SamplerState& state) {
+      return Lookup(D3D9PackSamplerKey(state));
+    }
+
+    /**
+     * \brief Advances the frame counter used for LRU
+     */
+    void EndFrame() {
+      m_frame.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    D3D9SamplerCacheStats GetStats() const {
+      D3D9SamplerCacheStats stats;
+      stats.misses    = m_stats.misses.load();
+      stats.evictions = m_stats.evictions.load();
+      stats.overflows = m_stats.overflows.load();
+      stats.keys      = m_stats.keys.load();
+      return stats;
+    }
+
+  private:
+
+    static constexpr uint32_t PendingSlot = ~1u;
+
+    /// Heap slot state, owning record index in the low 24 bits and
+    /// the frame of last use above. Kept in one atomic so a lookup
+    /// that marks the slot as used and an eviction cannot both win.
+    static constexpr uint32_t OwnerBits   = 24;
+    static constexpr uint64_t OwnerMask   = (1ull << OwnerBits) - 1;
+
+    struct Record {
+      std::atomic<uint32_t> slot = { InvalidSlot };
+    };
+
+    struct alignas(64) Slot {
+      std::atomic<uint64_t> state = { OwnerMask };
+    };
+
+    D3D9SamplerCacheOptions m_options;
+    WriteFn                 m_write;
+
+    uint32_t                                    m_mask;
+    std::unique_ptr<std::atomic<uint64_t>[]>    m_keys;
+    std::unique_ptr<Record[]>                   m_records;
+    std::unique_ptr<Slot[]>                     m_slots;
+
+    std::atomic<uint32_t>   m_nextSlot  = { 0 };
+    std::atomic<uint64_t>   m_frame     = { 1 };
+
+    struct {
+      std::atomic<uint64_t> misses    = { 0 };
+      std::atomic<uint64_t> evictions = { 0 };
+      std::atomic<uint64_t> overflows = { 0 };
+      std::atomic<uint32_t> keys      = { 0 };
+    } m_stats;
+
+    static uint32_t roundUpPow2(uint32_t n) {
+      uint32_t p = 16;
+
+      while (p < n)
+        p <<= 1;
+
+      return p;
+    }
+
+    uint32_t findOrInsert(D3D9SamplerKey key) {
+      uint32_t index = uint32_t((key * 0x9e3779b97f4a7c15ull) >> 40) & m_mask;
+
+      for (uint32_t i = 0; i <= m_mask; i++) {
+        uint64_t current = m_keys[index].load(std::memory_order_acquire);
+
+        if (current == key)
+          return index;
+
+        if (!current) {
+          if (m_stats.keys.load(std::memory_order_relaxed) >= m_options.keyCapacity)
+            return InvalidSlot;
+
+          if (m_keys[index].compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+            m_stats.keys.fetch_add(1, std::memory_order_relaxed);
+            return index;
+          }
+
+          // Lost the race, check what the other thread inserted
+          if (current == key)
+            return index;
+        }
+
+        index = (index + 1) & m_mask;
+      }
+
+      return InvalidSlot;
+    }
+
+    static uint64_t makeState(uint32_t owner, uint64_t frame) {
+      return uint64_t(owner) | (frame << OwnerBits);
+    }
+
+    static bool touch(Slot& slot, uint32_t index, uint64_t frame) {
+      uint64_t state = slot.state.load(std::memory_order_acquire);
+      uint64_t used = makeState(index, frame);
+
+      // Only write once per frame to avoid dirtying the cache
+      // line on every hit
+      while ((state & OwnerMask) == index) {
+        if (state == used || slot.state.compare_exchange_weak(state, used, std::memory_order_acq_rel))
+          return true;
+      }
+
+      return false;
+    }
+
+    uint32_t assignSlot(Record& record, uint32_t index, uint64_t frame) {
+      uint32_t slot = allocateSlot(index, frame);
+
+      if (slot != InvalidSlot) {
+        m_write(slot, m_keys[index].load(std::memory_order_relaxed));
+        m_stats.misses.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        m_stats.overflows.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      record.slot.store(slot, std::memory_order_release);
+      return slot;
+    }
+
+    uint32_t allocateSlot(uint32_t index, uint64_t frame) {
+      // Fresh slots first
+      uint32_t next = m_nextSlot.load(std::memory_order_relaxed);
+
+      while (next < m_options.heapSize) {
+        if (m_nextSlot.compare_exchange_weak(next, next + 1, std::memory_order_relaxed)) {
+          m_slots[next].state.store(makeState(index, frame), std::memory_order_release);
+          return next;
+        }
+      }
+
+      // Heap is full, take over the least recently used slot that
+      // no frame in flight can still reference
+      while (true) {
+        uint32_t victim = InvalidSlot;
+        uint64_t victimState = 0;
+        uint64_t oldest = frame > m_options.frameLatency ? frame - m_options.frameLatency : 0;
+
+        for (uint32_t i = 0; i < m_options.heapSize; i++) {
+          uint64_t state = m_slots[i].state.load(std::memory_order_relaxed);
+          uint64_t lastUse = state >> OwnerBits;
+
+          if (lastUse < oldest) {
+            oldest = lastUse;
+            victim = i;
+            victimState = state;
+          }
+        }
+
+        if (victim == InvalidSlot)
+          return InvalidSlot;
+
+        // Claim the slot. If a lookup used it or another thread
+        // claimed it in the meantime, look for another one.
+        if (!m_slots[victim].state.compare_exchange_strong(victimState,
+            makeState(index, frame), std::memory_order_acq_rel))
+          continue;
+
+        m_stats.evictions.fetch_add(1, std::memory_order_relaxed);
+        return victim;
+      }
+    }
+
+  };
+
+}
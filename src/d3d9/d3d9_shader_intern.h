@@ -0,0 +1,255 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Size of D3D9 shader bytecode
+   *
+   * CreateVertexShader and CreatePixelShader get no length, so
+   * the bytecode is walked up to the end token. Shader model 1
+   * instructions have no length field; their parameter tokens
+   * have bit 31 set, except for the four raw values of \c def.
+   * \param [in] code Bytecode
+   * \param [in] maxDwords Readable dwords
+   * \returns Size in dwords including the end token, or 0 if
+   *    the version token is invalid or there is no end token
+   */
+  inline size_t D3D9GetShaderBytecodeSize(const uint32_t* code, size_t maxDwords = SIZE_MAX) {
+    constexpr uint32_t EndToken     = 0x0000ffff;
+    constexpr uint32_t CommentToken = 0xfffe;
+    constexpr uint32_t OpDef        = 0x51;
+
+    if (!code || !maxDwords)
+      return 0;
+
+    uint32_t type = code[0] >> 16;
+    uint32_t major = (code[0] >> 8) & 0xff;
+
+    if ((type != 0xfffe && type != 0xffff) || major < 1 || major > 3)
+      return 0;
+
+    size_t pos = 1;
+
+    while (pos < maxDwords) {
+      uint32_t token = code[pos];
+
+      if (token == EndToken)
+        return pos + 1;
+
+      size_t length;
+
+      if ((token & 0xffff) == CommentToken) {
+        length = (token >> 16) & 0x7fff;
+      } else if (major >= 2) {
+        length = (token >> 24) & 0xf;
+      } else if ((token & 0xffff) == OpDef) {
+        length = 5;
+      } else {
+        length = 0;
+
+        while (pos + 1 + length < maxDwords && (code[pos + 1 + length] & 0x80000000u))
+          length++;
+      }
+
+      pos += 1 + length;
+    }
+
+    return 0;
+  }
+
+
+  /**
+   * \brief Default bytecode hash
+   *
+   * 64-bit multiply-xorshift over dword pairs. Only used to find
+   * candidates, equality is always decided by a full compare.
+   */
+  struct D3D9ShaderBytecodeHash {
+    uint64_t operator () (const uint32_t* code, size_t dwords) const {
+      uint64_t hash = 0xcbf29ce484222325ull ^ (dwords * 0x9e3779b97f4a7c15ull);
+
+      // Two dwords per step, the multiply chain is the bottleneck
+      size_t i = 0;
+
+      for ( ; i + 2 <= dwords; i += 2) {
+        hash = (hash ^ (uint64_t(code[i]) | (uint64_t(code[i + 1]) << 32))) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+      }
+
+      if (i < dwords) {
+        hash = (hash ^ code[i]) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+      }
+
+      return hash;
+    }
+  };
+
+
+  /**
+   * \brief Shader intern table statistics
+   */
+  struct D3D9ShaderInternStats {
+    uint32_t shaders      = 0;  ///< Distinct bytecode blobs
+    uint64_t creations    = 0;  ///< Intern calls
+    uint64_t translations = 0;  ///< Calls that translated the bytecode
+    uint64_t duplicates   = 0;  ///< Calls that returned an existing shader
+    uint64_t bytesSaved   = 0;  ///< Bytecode not translated again
+    uint64_t collisions   = 0;  ///< Same hash and length, different bytecode
+  };
+
+
+  /**
+   * \brief Device-level shader bytecode intern table
+   *
+   * Games create the same bytecode many times, FNV once per
+   * material instance. CreateVertexShader and CreatePixelShader
+   * look the bytecode up here by hash and length, with a full
+   * compare on a match, and only translate it if it is new, so
+   * identical bytecode shares one compiled module and its
+   * descriptor metadata.
+   *
+   * The translation runs outside the lock. Concurrent calls
+   * with the same new bytecode wait for the first one instead
+   * of translating it again. A translation may fail by
+   * returning \c nullptr, which is cached like a shader; if it
+   * throws, the entry is dropped and the next call retries.
+   *
+   * Shaders live as long as the table. Vertex and pixel shaders
+   * can share a table, the version token tells them apart.
+   * \tparam T Compiled shader
+   * \tparam Hash Bytecode hash
+   */
+  template<typename T, typename Hash = D3D9ShaderBytecodeHash>
+  class D3D9ShaderInternTable {
+
+  public:
+
+    D3D9ShaderInternTable() = default;
+
+    D3D9ShaderInternTable             (const D3D9ShaderInternTable&) = delete;
+    D3D9ShaderInternTable& operator = (const D3D9ShaderInternTable&) = delete;
+
+    /**
+     * \brief Interns a shader
+     *
+     * \param [in] code Bytecode
+     * \param [in] dwords Size, see D3D9GetShaderBytecodeSize
+     * \param [in] translate Called as \c translate(code, dwords)
+     *    if the bytecode is new, returns \c std::unique_ptr<T>
+     * \returns Shader, stable for the table's lifetime, or
+     *    \c nullptr if the translation failed
+     */
+    template<typename Fn>
+    const T* Intern(const uint32_t* code, size_t dwords, Fn&& translate) {
+      Key key = { Hash()(code, dwords), dwords };
+
+      std::promise<const T*> promise;
+      Entry* entry = nullptr;
+
+      { std::unique_lock lock(m_mutex);
+        m_stats.creations += 1;
+
+        auto& chain = m_entries[key];
+
+        for (const auto& e : chain) {
+          if (!std::memcmp(e->code.data(), code, dwords * sizeof(uint32_t))) {
+            m_stats.duplicates += 1;
+            m_stats.bytesSaved += dwords * sizeof(uint32_t);
+
+            std::shared_future<const T*> result = e->result;
+            lock.unlock();
+            return result.get();
+          }
+        }
+
+        m_stats.collisions += chain.empty() ? 0 : 1;
+        m_stats.translations += 1;
+
+        chain.push_back(std::make_unique<Entry>());
+        entry = chain.back().get();
+        entry->code.assign(code, code + dwords);
+        entry->result = promise.get_future().share();
+      }
+
+      try {
+        entry->object = translate(code, dwords);
+      } catch (...) {
+        drop(key, entry);
+        promise.set_exception(std::current_exception());
+        throw;
+      }
+
+      promise.set_value(entry->object.get());
+      return entry->object.get();
+    }
+
+    D3D9ShaderInternStats GetStats() const {
+      std::lock_guard lock(m_mutex);
+
+      D3D9ShaderInternStats stats = m_stats;
+
+      for (const auto& chain : m_entries)
+        stats.shaders += uint32_t(chain.second.size());
+
+      return stats;
+    }
+
+  private:
+
+    struct Key {
+      uint64_t hash;
+      size_t   dwords;
+
+      bool operator == (const Key& other) const {
+        return hash == other.hash && dwords == other.dwords;
+      }
+    };
+
+    struct KeyHash {
+      size_t operator () (const Key& key) const {
+        return size_t(key.hash ^ (key.dwords * 0x9e3779b97f4a7c15ull));
+      }
+    };
+
+    struct Entry {
+      std::vector<uint32_t>        code;
+      std::shared_future<const T*> result;
+      std::unique_ptr<T>           object;
+    };
+
+    mutable std::mutex m_mutex;
+
+    std::unordered_map<Key, std::vector<std::unique_ptr<Entry>>, KeyHash> m_entries;
+
+    D3D9ShaderInternStats m_stats;
+
+    void drop(const Key& key, Entry* entry) {
+      std::lock_guard lock(m_mutex);
+
+      auto& chain = m_entries[key];
+
+      for (auto i = chain.begin(); i != chain.end(); i++) {
+        // Waiters hold their own copy of the future
+        if (i->get() == entry) {
+          chain.erase(i);
+          break;
+        }
+      }
+
+      if (chain.empty())
+        m_entries.erase(key);
+    }
+
+  };
+
+}
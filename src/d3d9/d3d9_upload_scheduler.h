@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Upload scheduler options
+   */
+  struct D3D9UploadSchedulerOptions {
+    /// Bytes uploaded per frame before deferring the rest
+    uint64_t budgetBytes  = 8ull << 20;
+    /// Time spent uploading per frame before deferring the rest
+    uint64_t budgetTimeUs = 2000;
+    /// Mips at or below this size form the mip tail, which is
+    /// uploaded for every pending texture before any larger mip
+    uint64_t mipTailBytes = 64ull << 10;
+  };
+
+
+  /**
+   * \brief Upload scheduler statistics
+   *
+   * Published through the perf monitor's upload fields.
+   */
+  struct D3D9UploadStats {
+    uint64_t uploadedBytes   = 0;   ///< Total bytes uploaded
+    uint64_t frameBytes      = 0;   ///< Bytes uploaded in the last frame
+    uint64_t deferredBytes   = 0;   ///< Bytes still pending
+    uint64_t blockingBytes   = 0;   ///< Bytes a draw had to wait for
+    uint32_t frames          = 0;   ///< Frames processed
+    uint32_t budgetHitFrames = 0;   ///< Frames that ran out of budget
+    uint32_t pendingTextures = 0;   ///< Textures not fully resident
+  };
+
+
+  /**
+   * \brief Upload callback
+   *
+   * Uploads a single mip level of a managed texture, i.e.
+   * copies it from the mapping to the GPU image.
+   */
+  using D3D9UploadFn = std::function<void (uint64_t texture, uint32_t mip)>;
+
+
+  /**
+   * \brief Per-frame upload scheduler for managed textures
+   *
+   * With deferred surface creation, managed textures are uploaded
+   * on first use, so entering a new cell uploads dozens of full mip
+   * chains in a single frame. The scheduler spreads that work out:
+   *
+   * - Mip tails of all pending textures go first, so every texture
+   *   has data to sample after one frame.
+   * - Larger mips follow round-robin, smallest first, until the byte
+   *   or time budget of the frame runs out. The rest waits for the
+   *   next frame. A mip that does not fit the remaining bytes is
+   *   skipped so smaller ones behind it still go, and its texture
+   *   moves to the front of the queue for the next frame.
+   * - Resident mips always form a contiguous range ending at the
+   *   smallest mip. Draws clamp the texture's LOD to that range,
+   *   e.g. by folding it into D3DSAMP_MAXMIPLEVEL, which already
+   *   maps to the sampler's minLod.
+   * - A draw only blocks if the texture has nothing resident, or if
+   *   it needs the full chain (\c strict, e.g. texldl or mip filter
+   *   NONE on mip 0).
+   *
+   * Not thread-safe, calls are serialized by the device lock.
+   */
+  class D3D9UploadScheduler {
+
+  public:
+
+    D3D9UploadScheduler(
+      const D3D9UploadSchedulerOptions& options,
+            D3D9UploadFn                upload)
+    : m_options(options), m_upload(std::move(upload)) { }
+
+    /**
+     * \brief Queues a texture for upload
+     *
+     * Replaces any pending upload of the same texture, e.g.
+     * after the application locked and rewrote it.
+     * \param [in] texture Texture ID
+     * \param [in] mipSizes Size of each mip in bytes, mip 0 first
+     */
+    void Enqueue(uint64_t texture, std::vector<uint64_t> mipSizes) {
+      if (mipSizes.empty())
+        return;
+
+      Remove(texture);
+
+      TextureEntry entry;
+      entry.mipSizes    = std::move(mipSizes);
+      entry.residentMip = uint32_t(entry.mipSizes.size());
+
+      for (uint64_t size : entry.mipSizes)
+        m_deferredBytes += size;
+
+      m_textures.emplace(texture, std::move(entry));
+      m_pending.push_back(texture);
+    }
+
+    /**
+     * \brief Drops a texture, e.g. on release
+     */
+    void Remove(uint64_t texture) {
+      auto entry = m_textures.find(texture);
+
+      if (entry == m_textures.end())
+        return;
+
+      m_deferredBytes -= entry->second.pendingBytes();
+      m_textures.erase(entry);
+      m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), texture), m_pending.end());
+    }
+
+    /**
+     * \brief Prepares a texture for a draw
+     *
+     * Uploads synchronously only what the draw cannot do without.
+     * \param [in] texture Texture ID
+     * \param [in] strict Whether the draw needs every mip
+     * \returns Most detailed resident mip, to be used as LOD clamp.
+     *    0 if the texture is fully resident or not managed by us.
+     */
+    uint32_t PrepareDraw(uint64_t texture, bool strict) {
+      auto entry = m_textures.find(texture);
+
+      if (entry == m_textures.end())
+        return 0;
+
+      TextureEntry& e = entry->second;
+
+      if (strict) {
+        while (e.residentMip > 0)
+          uploadNextMip(texture, e, true);
+      } else if (e.residentMip == e.mipSizes.size()) {
+        uploadTail(texture, e, true);
+      }
+
+      uint32_t lod = e.residentMip;
+
+      if (!lod)
+        complete(texture);
+
+      return lod;
+    }
+
+    /**
+     * \brief Queries the LOD clamp of a texture
+     *
+     * \returns Most detailed resident mip, or the mip
+     *    count if nothing has been uploaded yet.
+     */
+    uint32_t GetResidentMip(uint64_t texture) const {
+      auto entry = m_textures.find(texture);
+      return entry != m_textures.end() ? entry->second.residentMip : 0;
+    }
+
+    /**
+     * \brief Runs the budgeted uploads of one frame
+     *
+     * Call once per frame, before the first draw.
+     */
+    void ProcessFrame() {
+      auto start = std::chrono::steady_clock::now();
+
+      m_frameBytes = 0;
+      m_frames += 1;
+
+      bool timeUp = false;
+
+      // The first upload of a frame always goes, so that
+      // even a mip larger than the budget makes progress
+      auto fits = [&] (uint64_t nextSize) {
+        if (!m_frameBytes)
+          return true;
+
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start).count();
+
+        timeUp = us >= m_options.budgetTimeUs;
+        return !timeUp && m_frameBytes + nextSize <= m_options.budgetBytes;
+      };
+
+      std::vector<uint64_t> skipped;
+
+      // Mip tails first, so that every texture becomes usable
+      for (size_t i = 0; i < m_pending.size() && !timeUp; i++) {
+        TextureEntry& e = m_textures.at(m_pending[i]);
+
+        if (e.residentMip != e.mipSizes.size())
+          continue;
+
+        if (fits(e.tailBytes(m_options.mipTailBytes)))
+          uploadTail(m_pending[i], e, false);
+        else
+          skipped.push_back(m_pending[i]);
+      }
+
+      // Then one mip per texture and round, smallest first. Mips
+      // that do not fit are skipped, smaller ones may still fit.
+      bool progress = true;
+
+      while (!timeUp && progress) {
+        progress = false;
+
+        for (size_t i = 0; i < m_pending.size() && !timeUp; i++) {
+          TextureEntry& e = m_textures.at(m_pending[i]);
+
+          // Done, or its tail did not fit
+          if (!e.residentMip || e.residentMip == e.mipSizes.size())
+            continue;
+
+          if (fits(e.mipSizes[e.residentMip - 1])) {
+            uploadNextMip(m_pending[i], e, false);
+            progress = true;
+          } else if (std::find(skipped.begin(), skipped.end(), m_pending[i]) == skipped.end()) {
+            skipped.push_back(m_pending[i]);
+          }
+        }
+      }
+
+      bool budgetHit = timeUp || !skipped.empty();
+
+      // Skipped textures go first next frame, so a large mip
+      // is not starved by a stream of smaller textures
+      std::stable_partition(m_pending.begin(), m_pending.end(), [&] (uint64_t texture) {
+        return std::find(skipped.begin(), skipped.end(), texture) != skipped.end();
+      });
+
+      if (budgetHit)
+        m_budgetHitFrames += 1;
+
+      // Fully resident textures leave the scheduler
+      std::vector<uint64_t> done;
+
+      for (uint64_t texture : m_pending) {
+        if (!m_textures.at(texture).residentMip)
+          done.push_back(texture);
+      }
+
+      for (uint64_t texture : done)
+        complete(texture);
+    }
+
+    /**
+     * \brief Queries statistics
+     */
+    D3D9UploadStats GetStats() const {
+      D3D9UploadStats stats;
+      stats.uploadedBytes   = m_uploadedBytes;
+      stats.frameBytes      = m_frameBytes;
+      stats.deferredBytes   = m_deferredBytes;
+      stats.blockingBytes   = m_blockingBytes;
+      stats.frames          = m_frames;
+      stats.budgetHitFrames = m_budgetHitFrames;
+      stats.pendingTextures = uint32_t(m_pending.size());
+      return stats;
+    }
+
+  private:
+
+    struct TextureEntry {
+      std::vector<uint64_t> mipSizes;
+      uint32_t              residentMip = 0;
+
+      uint64_t pendingBytes() const {
+        uint64_t bytes = 0;
+
+        for (uint32_t i = 0; i < residentMip; i++)
+          bytes += mipSizes[i];
+
+        return bytes;
+      }
+
+      uint64_t tailBytes(uint64_t tailSize) const {
+        uint64_t bytes = mipSizes.back();
+
+        for (uint32_t i = uint32_t(mipSizes.size()) - 1; i > 0 && mipSizes[i - 1] <= tailSize; i--)
+          bytes += mipSizes[i - 1];
+
+        return bytes;
+      }
+    };
+
+    D3D9UploadSchedulerOptions  m_options;
+    D3D9UploadFn                m_upload;
+
+    std::unordered_map<uint64_t, TextureEntry> m_textures;
+    std::vector<uint64_t>       m_pending;
+
+    uint64_t                    m_uploadedBytes   = 0;
+    uint64_t                    m_frameBytes      = 0;
+    uint64_t                    m_deferredBytes   = 0;
+    uint64_t                    m_blockingBytes   = 0;
+    uint32_t                    m_frames          = 0;
+    uint32_t                    m_budgetHitFrames = 0;
+
+    void uploadNextMip(uint64_t texture, TextureEntry& e, bool blocking) {
+      uint32_t mip = --e.residentMip;
+      uint64_t size = e.mipSizes[mip];
+
+      m_upload(texture, mip);
+
+      m_uploadedBytes += size;
+      m_deferredBytes -= size;
+
+      if (blocking)
+        m_blockingBytes += size;
+      else
+        m_frameBytes += size;
+    }
+
+    void uploadTail(uint64_t texture, TextureEntry& e, bool blocking) {
+      // The smallest mip always counts as tail, even if it is
+      // larger than the tail size, so that there is something
+      // to sample from afterwards.
+      do {
+        uploadNextMip(texture, e, blocking);
+      } while (e.residentMip > 0 && e.mipSizes[e.residentMip - 1] <= m_options.mipTailBytes);
+    }
+
+    void complete(uint64_t texture) {
+      m_textures.erase(texture);
+      m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), texture), m_pending.end());
+    }
+
+  };
+
+}
@@ -0,0 +1,885 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief D3DDECLTYPE
+   */
+  enum class D3D9DeclType : uint8_t {
+    Float1    = 0,
+    Float2    = 1,
+    Float3    = 2,
+    Float4    = 3,
+    D3DColor  = 4,
+    UByte4    = 5,
+    Short2    = 6,
+    Short4    = 7,
+    UByte4N   = 8,
+    Short2N   = 9,
+    Short4N   = 10,
+    UShort2N  = 11,
+    UShort4N  = 12,
+    UDec3     = 13,
+    Dec3N     = 14,
+    Float16_2 = 15,
+    Float16_4 = 16,
+    Unused    = 17,
+  };
+
+
+  /**
+   * \brief D3DDECLUSAGE
+   */
+  enum class D3D9DeclUsage : uint8_t {
+    Position     = 0,
+    BlendWeight  = 1,
+    BlendIndices = 2,
+    Normal       = 3,
+    PSize        = 4,
+    Texcoord     = 5,
+    Tangent      = 6,
+    Binormal     = 7,
+    TessFactor   = 8,
+    PositionT    = 9,
+    Color        = 10,
+    Fog          = 11,
+    Depth        = 12,
+    Sample       = 13,
+  };
+
+
+  /**
+   * \brief Vertex element
+   *
+   * Same layout as D3DVERTEXELEMENT9. Arrays passed to
+   * CreateVertexDeclaration end with an element whose
+   * stream is 0xff (D3DDECL_END).
+   */
+  struct D3D9VertexElement {
+    uint16_t      stream;
+    uint16_t      offset;
+    D3D9DeclType  type;
+    uint8_t       method;
+    D3D9DeclUsage usage;
+    uint8_t       usageIndex;
+
+    bool operator == (const D3D9VertexElement& other) const {
+      return stream     == other.stream
+          && offset     == other.offset
+          && type       == other.type
+          && method     == other.method
+          && usage      == other.usage
+          && usageIndex == other.usageIndex;
+    }
+  };
+
+  static_assert(sizeof(D3D9VertexElement) == 8);
+
+
+  /**
+   * \brief Vertex fetch format
+   *
+   * Values match VkFormat, so they can be cast directly.
+   */
+  enum class D3D9VertexFormat : uint32_t {
+    Undefined                  = 0,
+    R8G8B8A8_UNORM             = 37,
+    R8G8B8A8_USCALED           = 39,
+    R8G8B8A8_UINT              = 41,
+    B8G8R8A8_UNORM             = 44,
+    A2B10G10R10_SNORM_PACK32   = 65,
+    A2B10G10R10_USCALED_PACK32 = 66,
+    R16G16_UNORM               = 77,
+    R16G16_SNORM               = 78,
+    R16G16_SSCALED             = 80,
+    R16G16_SINT                = 82,
+    R16G16_SFLOAT              = 83,
+    R16G16B16A16_UNORM         = 91,
+    R16G16B16A16_SNORM         = 92,
+    R16G16B16A16_SSCALED       = 94,
+    R16G16B16A16_SINT          = 96,
+    R16G16B16A16_SFLOAT        = 97,
+    R32_UINT                   = 98,
+    R32_SFLOAT                 = 100,
+    R32G32_SFLOAT              = 103,
+    R32G32B32_SFLOAT           = 106,
+    R32G32B32A32_SFLOAT        = 109,
+  };
+
+
+  /**
+   * \brief Conversion applied by the vertex shader after fetching
+   */
+  enum class D3D9VertexConvert : uint8_t {
+    None        = 0,  ///< Fetched value is used as is
+    UintToFloat = 1,  ///< Fetched as UINT, converted to float (USCALED)
+    SintToFloat = 2,  ///< Fetched as SINT, converted to float (SSCALED)
+    UnpackUDec3 = 3,  ///< Fetched as R32_UINT, unpacked to 10:10:10:2 and converted
+  };
+
+
+  /**
+   * \brief Vertex fetch formats the device supports
+   *
+   * The defaults describe MoltenVK: Metal has BGRA8 vertex
+   * fetch but no scaled integer formats.
+   */
+  struct D3D9VertexFormatSupport {
+    bool bgra8  = true;   ///< B8G8R8A8_UNORM
+    bool scaled = false;  ///< USCALED and SSCALED formats
+  };
+
+
+  /**
+   * \brief How to fetch one vertex element
+   *
+   * The swizzle holds the source component for each of the
+   * four outputs in two bits each, 0xe4 is the identity.
+   */
+  struct D3D9VertexFetch {
+    D3D9VertexFormat  format  = D3D9VertexFormat::Undefined;
+    D3D9VertexConvert convert = D3D9VertexConvert::None;
+    uint8_t           swizzle = IdentitySwizzle;
+    uint8_t           size    = 0;  ///< Bytes
+
+    static constexpr uint8_t IdentitySwizzle = 0xe4;
+    static constexpr uint8_t BgraSwizzle     = 0xc6;
+  };
+
+
+  /**
+   * \brief Size of a vertex element in bytes
+   * \returns Size, or 0 for invalid types
+   */
+  inline uint32_t D3D9GetDeclTypeSize(D3D9DeclType type) {
+    static constexpr uint8_t sizes[] = {
+      4, 8, 12, 16,   // Float1-4
+      4, 4, 4, 8,     // D3DColor, UByte4, Short2, Short4
+      4, 4, 8, 4, 8,  // UByte4N, Short2N, Short4N, UShort2N, UShort4N
+      4, 4, 4, 8,     // UDec3, Dec3N, Float16_2, Float16_4
+    };
+
+    return uint32_t(type) < sizeof(sizes) ? sizes[uint32_t(type)] : 0;
+  }
+
+
+  /**
+   * \brief Picks the fetch format and conversion for a type
+   *
+   * Formats the device cannot fetch are fetched as the
+   * matching integer format and converted in the shader.
+   * D3DCOLOR is stored as BGRA; without BGRA vertex fetch
+   * it is fetched as RGBA and swizzled.
+   */
+  inline D3D9VertexFetch D3D9GetVertexFetch(D3D9DeclType type, const D3D9VertexFormatSupport& support) {
+    D3D9VertexFetch fetch;
+    fetch.size = uint8_t(D3D9GetDeclTypeSize(type));
+
+    auto scaled = [&] (D3D9VertexFormat native, D3D9VertexFormat integer, D3D9VertexConvert convert) {
+      if (support.scaled) {
+        fetch.format = native;
+      } else {
+        fetch.format = integer;
+        fetch.convert = convert;
+      }
+    };
+
+    switch (type) {
+      case D3D9DeclType::Float1:    fetch.format = D3D9VertexFormat::R32_SFLOAT;          break;
+      case D3D9DeclType::Float2:    fetch.format = D3D9VertexFormat::R32G32_SFLOAT;       break;
+      case D3D9DeclType::Float3:    fetch.format = D3D9VertexFormat::R32G32B32_SFLOAT;    break;
+      case D3D9DeclType::Float4:    fetch.format = D3D9VertexFormat::R32G32B32A32_SFLOAT; break;
+      case D3D9DeclType::UByte4N:   fetch.format = D3D9VertexFormat::R8G8B8A8_UNORM;      break;
+      case D3D9DeclType::Short2N:   fetch.format = D3D9VertexFormat::R16G16_SNORM;        break;
+      case D3D9DeclType::Short4N:   fetch.format = D3D9VertexFormat::R16G16B16A16_SNORM;  break;
+      case D3D9DeclType::UShort2N:  fetch.format = D3D9VertexFormat::R16G16_UNORM;        break;
+      case D3D9DeclType::UShort4N:  fetch.format = D3D9VertexFormat::R16G16B16A16_UNORM;  break;
+      case D3D9DeclType::Dec3N:     fetch.format = D3D9VertexFormat::A2B10G10R10_SNORM_PACK32; break;
+      case D3D9DeclType::Float16_2: fetch.format = D3D9VertexFormat::R16G16_SFLOAT;       break;
+      case D3D9DeclType::Float16_4: fetch.format = D3D9VertexFormat::R16G16B16A16_SFLOAT; break;
+
+      case D3D9DeclType::D3DColor:
+        if (support.bgra8) {
+          fetch.format = D3D9VertexFormat::B8G8R8A8_UNORM;
+        } else {
+          fetch.format = D3D9VertexFormat::R8G8B8A8_UNORM;
+          fetch.swizzle = D3D9VertexFetch::BgraSwizzle;
+        }
+        break;
+
+      case D3D9DeclType::UByte4:
+        scaled(D3D9VertexFormat::R8G8B8A8_USCALED, D3D9VertexFormat::R8G8B8A8_UINT, D3D9VertexConvert::UintToFloat);
+        break;
+
+      case D3D9DeclType::Short2:
+        scaled(D3D9VertexFormat::R16G16_SSCALED, D3D9VertexFormat::R16G16_SINT, D3D9VertexConvert::SintToFloat);
+        break;
+
+      case D3D9DeclType::Short4:
+        scaled(D3D9VertexFormat::R16G16B16A16_SSCALED, D3D9VertexFormat::R16G16B16A16_SINT, D3D9VertexConvert::SintToFloat);
+        break;
+
+      case D3D9DeclType::UDec3:
+        // No 10:10:10:2 integer vertex format on Metal either
+        scaled(D3D9VertexFormat::A2B10G10R10_USCALED_PACK32, D3D9VertexFormat::R32_UINT, D3D9VertexConvert::UnpackUDec3);
+        break;
+
+      default:
+        fetch.size = 0;
+        break;
+    }
+
+    return fetch;
+  }
+
+
+  /**
+   * \brief Vertex attribute, matches DxvkVertexAttribute
+   */
+  struct D3D9VertexAttribute {
+    uint32_t          location;
+    uint32_t          binding;
+    D3D9VertexFormat  format;
+    uint32_t          offset;
+  };
+
+
+  /**
+   * \brief Vertex binding used by a layout
+   *
+   * The extent is the number of bytes per vertex the
+   * layout reads from the stream, which the stream's
+   * stride must cover.
+   */
+  struct D3D9VertexBinding {
+    uint32_t binding;
+    uint32_t extent;
+  };
+
+
+  /**
+   * \brief Shader-side conversion of one attribute
+   */
+  struct D3D9VertexConversion {
+    uint32_t          location;
+    D3D9VertexConvert convert;
+    uint8_t           swizzle;
+  };
+
+
+  /**
+   * \brief Vertex shader input (dcl_usageN vN)
+   */
+  struct D3D9VertexInput {
+    uint32_t      location;
+    D3D9DeclUsage usage;
+    uint8_t       usageIndex;
+
+    bool operator == (const D3D9VertexInput& other) const {
+      return location == other.location && usage == other.usage && usageIndex == other.usageIndex;
+    }
+  };
+
+
+  inline uint64_t D3D9HashCombine(uint64_t seed, uint64_t value) {
+    return seed ^ (value * 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+  }
+
+
+  /**
+   * \brief Vertex shader input signature
+   *
+   * Built once per shader. The fixed-function pipeline
+   * uses one signature per vertex shader key.
+   */
+  class D3D9VertexShaderInputs {
+
+  public:
+
+    static constexpr uint32_t MaxInputs = 16;
+
+    explicit D3D9VertexShaderInputs(std::vector<D3D9VertexInput> inputs)
+    : m_inputs(std::move(inputs)) {
+      m_hash = m_inputs.size();
+
+      for (const auto& i : m_inputs) {
+        m_hash = D3D9HashCombine(m_hash, i.location
+          | (uint32_t(i.usage) << 8) | (uint32_t(i.usageIndex) << 16));
+      }
+    }
+
+    const std::vector<D3D9VertexInput>& Inputs() const {
+      return m_inputs;
+    }
+
+    uint64_t Hash() const {
+      return m_hash;
+    }
+
+    bool operator == (const D3D9VertexShaderInputs& other) const {
+      return m_hash == other.m_hash && m_inputs == other.m_inputs;
+    }
+
+  private:
+
+    std::vector<D3D9VertexInput> m_inputs;
+    uint64_t                     m_hash;
+
+  };
+
+
+  /**
+   * \brief Input layout for a declaration and shader
+   *
+   * Everything the pipeline needs from the vertex input
+   * state, plus the hash it contributes to the pipeline
+   * key. Shader inputs without a matching element are in
+   * \c missingMask and read zero from a dummy binding.
+   */
+  struct D3D9InputLayout {
+    std::vector<D3D9VertexAttribute>  attributes;
+    std::vector<D3D9VertexBinding>    bindings;
+    std::vector<D3D9VertexConversion> conversions;
+    uint32_t                          missingMask = 0;
+    uint64_t                          hash        = 0;
+  };
+
+
+  /**
+   * \brief Fixed-function inputs present in a declaration
+   */
+  enum D3D9VertexDeclFlag : uint32_t {
+    D3D9VertexDeclHasPositionT    = 1u << 0,
+    D3D9VertexDeclHasColor0       = 1u << 1,
+    D3D9VertexDeclHasColor1       = 1u << 2,
+    D3D9VertexDeclHasPointSize    = 1u << 3,
+    D3D9VertexDeclHasFog          = 1u << 4,
+    D3D9VertexDeclHasBlendWeight  = 1u << 5,
+    D3D9VertexDeclHasBlendIndices = 1u << 6,
+    D3D9VertexDeclHasNormal       = 1u << 7,
+  };
+
+
+  class D3D9VertexDeclCache;
+
+  /**
+   * \brief Interned vertex declaration
+   *
+   * Owned by the D3D9VertexDeclCache and immutable apart
+   * from the layout memo, so identical declarations are
+   * the same object and can be compared by pointer. Fetch
+   * formats, flags and the hash are computed once when the
+   * declaration is first created.
+   */
+  class D3D9VertexDecl {
+    friend class D3D9VertexDeclCache;
+  public:
+
+    const std::vector<D3D9VertexElement>& Elements() const {
+      return m_elements;
+    }
+
+    /**
+     * \brief Fetch format and conversion per element
+     */
+    const std::vector<D3D9VertexFetch>& Fetches() const {
+      return m_fetches;
+    }
+
+    uint64_t Hash() const {
+      return m_hash;
+    }
+
+    uint32_t Flags() const {
+      return m_flags;
+    }
+
+    uint32_t TexcoordMask() const {
+      return m_texcoordMask;
+    }
+
+    uint32_t StreamMask() const {
+      return m_streamMask;
+    }
+
+    /**
+     * \brief Gets the input layout for a shader
+     *
+     * Builds the layout on first use and memoizes it for the
+     * lifetime of the declaration. Takes a lock, callers on
+     * the draw path go through D3D9VertexInputState.
+     * \param [in] inputs Vertex shader inputs
+     * \returns Input layout, stable pointer
+     */
+    const D3D9InputLayout* GetLayout(const D3D9VertexShaderInputs& inputs) {
+      std::lock_guard lock(m_mutex);
+
+      for (const auto& entry : m_layouts) {
+        if (entry.inputs == inputs)
+          return entry.layout.get();
+      }
+
+      m_layouts.push_back({ inputs, buildLayout(inputs) });
+      m_layoutBuilds.fetch_add(1, std::memory_order_relaxed);
+      return m_layouts.back().layout.get();
+    }
+
+  private:
+
+    struct LayoutEntry {
+      D3D9VertexShaderInputs           inputs;
+      std::unique_ptr<D3D9InputLayout> layout;
+    };
+
+    std::vector<D3D9VertexElement> m_elements;
+    std::vector<D3D9VertexFetch>   m_fetches;
+    uint64_t                       m_hash          = 0;
+    uint32_t                       m_flags         = 0;
+    uint32_t                       m_texcoordMask  = 0;
+    uint32_t                       m_streamMask    = 0;
+
+    std::mutex                     m_mutex;
+    std::vector<LayoutEntry>       m_layouts;
+    std::atomic<uint32_t>&         m_layoutBuilds;
+
+    D3D9VertexDecl(
+            std::vector<D3D9VertexElement> elements,
+            uint64_t                       hash,
+      const D3D9VertexFormatSupport&       support,
+            std::atomic<uint32_t>&         layoutBuilds)
+    : m_elements(std::move(elements)), m_hash(hash), m_layoutBuilds(layoutBuilds) {
+      for (const auto& e : m_elements) {
+        m_fetches.push_back(D3D9GetVertexFetch(e.type, support));
+        m_streamMask |= 1u << e.stream;
+
+        switch (e.usage) {
+          case D3D9DeclUsage::PositionT:    m_flags |= D3D9VertexDeclHasPositionT;    break;
+          case D3D9DeclUsage::PSize:        m_flags |= D3D9VertexDeclHasPointSize;    break;
+          case D3D9DeclUsage::Fog:          m_flags |= D3D9VertexDeclHasFog;          break;
+          case D3D9DeclUsage::BlendWeight:  m_flags |= D3D9VertexDeclHasBlendWeight;  break;
+          case D3D9DeclUsage::BlendIndices: m_flags |= D3D9VertexDeclHasBlendIndices; break;
+          case D3D9DeclUsage::Normal:       m_flags |= D3D9VertexDeclHasNormal;       break;
+
+          case D3D9DeclUsage::Color:
+            if (e.usageIndex == 0) m_flags |= D3D9VertexDeclHasColor0;
+            if (e.usageIndex == 1) m_flags |= D3D9VertexDeclHasColor1;
+            break;
+
+          case D3D9DeclUsage::Texcoord:
+            if (e.usageIndex < 8)
+              m_texcoordMask |= 1u << e.usageIndex;
+            break;
+
+          default:
+            break;
+        }
+      }
+    }
+
+    int32_t findElement(const D3D9VertexInput& input) const {
+      for (uint32_t i = 0; i < m_elements.size(); i++) {
+        const auto& e = m_elements[i];
+
+        if (e.usage == input.usage && e.usageIndex == input.usageIndex)
+          return int32_t(i);
+      }
+
+      // Pre-transformed positions feed position 0
+      if (input.usage == D3D9DeclUsage::Position && input.usageIndex == 0) {
+        for (uint32_t i = 0; i < m_elements.size(); i++) {
+          if (m_elements[i].usage == D3D9DeclUsage::PositionT)
+            return int32_t(i);
+        }
+      }
+
+      return -1;
+    }
+
+    std::unique_ptr<D3D9InputLayout> buildLayout(const D3D9VertexShaderInputs& inputs) const {
+      auto layout = std::make_unique<D3D9InputLayout>();
+      uint32_t extents[16] = { };
+      uint32_t streams = 0;
+
+      for (const auto& input : inputs.Inputs()) {
+        int32_t index = findElement(input);
+
+        if (index < 0) {
+          layout->missingMask |= 1u << input.location;
+          continue;
+        }
+
+        const auto& e = m_elements[index];
+        const auto& f = m_fetches[index];
+
+        layout->attributes.push_back({ input.location, e.stream, f.format, e.offset });
+
+        if (f.convert != D3D9VertexConvert::None || f.swizzle != D3D9VertexFetch::IdentitySwizzle)
+          layout->conversions.push_back({ input.location, f.convert, f.swizzle });
+
+        streams |= 1u << e.stream;
+        extents[e.stream] = std::max(extents[e.stream], uint32_t(e.offset) + f.size);
+      }
+
+      for (uint32_t s = 0; s < 16; s++) {
+        if (streams & (1u << s))
+          layout->bindings.push_back({ s, extents[s] });
+      }
+
+      uint64_t hash = layout->missingMask;
+
+      for (const auto& a : layout->attributes) {
+        hash = D3D9HashCombine(hash, a.location | (a.binding << 8) | (uint64_t(a.format) << 16));
+        hash = D3D9HashCombine(hash, a.offset);
+      }
+
+      for (const auto& c : layout->conversions)
+        hash = D3D9HashCombine(hash, c.location | (uint32_t(c.convert) << 8) | (uint32_t(c.swizzle) << 16));
+
+      layout->hash = hash;
+      return layout;
+    }
+
+  };
+
+
+  /**
+   * \brief Declaration set through SetFVF
+   *
+   * One per FVF code, owned by the cache. Codes that differ only
+   * in bits the translation ignores, and explicit declarations
+   * with the same elements, share \c decl, so the code is kept
+   * here rather than on the declaration.
+   */
+  struct D3D9FvfDecl {
+    uint32_t        fvf  = 0;
+    D3D9VertexDecl* decl = nullptr;
+  };
+
+
+  /**
+   * \brief Vertex declaration cache statistics
+   */
+  struct D3D9VertexDeclStats {
+    uint32_t decls        = 0;  ///< Distinct declarations
+    uint64_t internHits   = 0;  ///< Creations that returned an existing declaration
+    uint64_t fvfMisses    = 0;  ///< FVF codes translated
+    uint32_t layoutBuilds = 0;  ///< Input layouts built
+  };
+
+
+  /**
+   * \brief Vertex declaration cache
+   *
+   * Interns declarations by content, so CreateVertexDeclaration
+   * with identical elements returns the same object, and memoizes
+   * SetFVF translations. FVF declarations go through the same
+   * table, so an FVF and an explicit declaration with the same
+   * elements share one object and its layouts.
+   *
+   * Declarations live as long as the cache. Games create a few
+   * dozen, so they are never freed.
+   */
+  class D3D9VertexDeclCache {
+
+  public:
+
+    static constexpr uint32_t MaxElements = 64;  ///< MAXD3DDECLLENGTH
+    static constexpr uint32_t MaxStreams  = 16;
+    static constexpr uint16_t EndStream   = 0xff;
+
+    explicit D3D9VertexDeclCache(const D3D9VertexFormatSupport& support = D3D9VertexFormatSupport())
+    : m_support(support) { }
+
+    D3D9VertexDeclCache             (const D3D9VertexDeclCache&) = delete;
+    D3D9VertexDeclCache& operator = (const D3D9VertexDeclCache&) = delete;
+
+    /**
+     * \brief Interns a declaration
+     *
+     * \param [in] elements Elements, terminated by D3DDECL_END
+     * \returns Declaration, or \c nullptr if the elements are
+     *    invalid (unknown type, misaligned offset, stream out
+     *    of range or a usage declared twice)
+     */
+    D3D9VertexDecl* Intern(const D3D9VertexElement* elements) {
+      std::vector<D3D9VertexElement> list;
+
+      for (uint32_t i = 0; elements[i].stream != EndStream; i++) {
+        if (i == MaxElements)
+          return nullptr;
+
+        list.push_back(elements[i]);
+      }
+
+      if (!validate(list))
+        return nullptr;
+
+      std::lock_guard lock(m_mutex);
+      return intern(std::move(list));
+    }
+
+    /**
+     * \brief Gets the declaration for an FVF code
+     * \returns FVF declaration, stable pointer, or \c nullptr
+     *    if the code is invalid
+     */
+    const D3D9FvfDecl* FromFvf(uint32_t fvf) {
+      std::lock_guard lock(m_mutex);
+
+      auto entry = m_fvfDecls.find(fvf);
+
+      if (entry == m_fvfDecls.end()) {
+        std::vector<D3D9VertexElement> list;
+        D3D9FvfDecl fvfDecl;
+        fvfDecl.fvf = fvf;
+
+        if (TranslateFvf(fvf, list) && validate(list))
+          fvfDecl.decl = intern(std::move(list));
+
+        m_stats.fvfMisses += 1;
+        entry = m_fvfDecls.insert({ fvf, fvfDecl }).first;
+      }
+
+      return entry->second.decl ? &entry->second : nullptr;
+    }
+
+    /**
+     * \brief Translates an FVF code to vertex elements
+     *
+     * All elements are in stream 0, in FVF order.
+     * \returns \c false if the code is invalid
+     */
+    static bool TranslateFvf(uint32_t fvf, std::vector<D3D9VertexElement>& elements) {
+      uint16_t offset = 0;
+
+      auto add = [&] (D3D9DeclType type, D3D9DeclUsage usage, uint8_t index) {
+        elements.push_back({ 0, offset, type, 0, usage, index });
+        offset += uint16_t(D3D9GetDeclTypeSize(type));
+      };
+
+      uint32_t position = fvf & FvfPositionMask;
+
+      switch (position) {
+        case 0:
+          break;
+
+        case FvfXyz:
+          add(D3D9DeclType::Float3, D3D9DeclUsage::Position, 0);
+          break;
+
+        case FvfXyzRhw:
+          add(D3D9DeclType::Float4, D3D9DeclUsage::PositionT, 0);
+          break;
+
+        case FvfXyzw:
+          add(D3D9DeclType::Float4, D3D9DeclUsage::Position, 0);
+          break;
+
+        case FvfXyzB1: case FvfXyzB2: case FvfXyzB3: case FvfXyzB4: case FvfXyzB5: {
+          add(D3D9DeclType::Float3, D3D9DeclUsage::Position, 0);
+
+          // The last beta may hold blend indices instead of a weight
+          uint32_t betas = (position - FvfXyzB1) / 2 + 1;
+          uint32_t lastBeta = fvf & (FvfLastBetaUByte4 | FvfLastBetaD3DColor);
+
+          if (lastBeta == (FvfLastBetaUByte4 | FvfLastBetaD3DColor))
+            return false;
+
+          uint32_t weights = betas - (lastBeta ? 1 : 0);
+
+          if (weights > 4)
+            return false;
+
+          if (weights)
+            add(D3D9DeclType(uint32_t(D3D9DeclType::Float1) + weights - 1), D3D9DeclUsage::BlendWeight, 0);
+
+          if (lastBeta) {
+            add(lastBeta == FvfLastBetaUByte4 ? D3D9DeclType::UByte4 : D3D9DeclType::D3DColor,
+              D3D9DeclUsage::BlendIndices, 0);
+          }
+        } break;
+
+        default:
+          return false;
+      }
+
+      if (fvf & FvfNormal)
+        add(D3D9DeclType::Float3, D3D9DeclUsage::Normal, 0);
+
+      if (fvf & FvfPSize)
+        add(D3D9DeclType::Float1, D3D9DeclUsage::PSize, 0);
+
+      if (fvf & FvfDiffuse)
+        add(D3D9DeclType::D3DColor, D3D9DeclUsage::Color, 0);
+
+      if (fvf & FvfSpecular)
+        add(D3D9DeclType::D3DColor, D3D9DeclUsage::Color, 1);
+
+      uint32_t texcoords = (fvf >> 8) & 0xf;
+
+      if (texcoords > 8)
+        return false;
+
+      for (uint32_t i = 0; i < texcoords; i++) {
+        // D3DFVF_TEXCOORDSIZEn: 0 = 2, 1 = 3, 2 = 4, 3 = 1 floats
+        static constexpr D3D9DeclType types[] = {
+          D3D9DeclType::Float2, D3D9DeclType::Float3,
+          D3D9DeclType::Float4, D3D9DeclType::Float1 };
+
+        add(types[(fvf >> (16 + 2 * i)) & 0x3], D3D9DeclUsage::Texcoord, uint8_t(i));
+      }
+
+      return true;
+    }
+
+    D3D9VertexDeclStats GetStats() const {
+      std::lock_guard lock(m_mutex);
+
+      D3D9VertexDeclStats stats = m_stats;
+      stats.decls = uint32_t(m_decls.size());
+      stats.layoutBuilds = m_layoutBuilds.load(std::memory_order_relaxed);
+      return stats;
+    }
+
+  private:
+
+    static constexpr uint32_t FvfXyz              = 0x002;
+    static constexpr uint32_t FvfXyzRhw           = 0x004;
+    static constexpr uint32_t FvfXyzB1            = 0x006;
+    static constexpr uint32_t FvfXyzB2            = 0x008;
+    static constexpr uint32_t FvfXyzB3            = 0x00a;
+    static constexpr uint32_t FvfXyzB4            = 0x00c;
+    static constexpr uint32_t FvfXyzB5            = 0x00e;
+    static constexpr uint32_t FvfXyzw             = 0x4002;
+    static constexpr uint32_t FvfPositionMask     = 0x400e;
+    static constexpr uint32_t FvfNormal           = 0x010;
+    static constexpr uint32_t FvfPSize            = 0x020;
+    static constexpr uint32_t FvfDiffuse          = 0x040;
+    static constexpr uint32_t FvfSpecular         = 0x080;
+    static constexpr uint32_t FvfLastBetaUByte4   = 0x1000;
+    static constexpr uint32_t FvfLastBetaD3DColor = 0x8000;
+
+    D3D9VertexFormatSupport m_support;
+
+    mutable std::mutex      m_mutex;
+
+    std::vector<std::unique_ptr<D3D9VertexDecl>>         m_decls;
+    std::unordered_multimap<uint64_t, D3D9VertexDecl*>   m_declsByHash;
+    std::unordered_map<uint32_t, D3D9FvfDecl>            m_fvfDecls;
+
+    D3D9VertexDeclStats     m_stats;
+    std::atomic<uint32_t>   m_layoutBuilds = { 0 };
+
+    static bool validate(const std::vector<D3D9VertexElement>& elements) {
+      for (uint32_t i = 0; i < elements.size(); i++) {
+        const auto& e = elements[i];
+
+        if (e.stream >= MaxStreams || (e.offset & 0x3)
+         || !D3D9GetDeclTypeSize(e.type)
+         || uint32_t(e.usage) > uint32_t(D3D9DeclUsage::Sample))
+          return false;
+
+        for (uint32_t j = 0; j < i; j++) {
+          if (elements[j].usage == e.usage && elements[j].usageIndex == e.usageIndex)
+            return false;
+        }
+      }
+
+      return true;
+    }
+
+    static uint64_t hashElements(const std::vector<D3D9VertexElement>& elements) {
+      uint64_t hash = elements.size();
+
+      for (const auto& e : elements) {
+        hash = D3D9HashCombine(hash, uint64_t(e.stream) | (uint64_t(e.offset) << 16)
+          | (uint64_t(e.type) << 32) | (uint64_t(e.method) << 40)
+          | (uint64_t(e.usage) << 48) | (uint64_t(e.usageIndex) << 56));
+      }
+
+      return hash;
+    }
+
+    D3D9VertexDecl* intern(std::vector<D3D9VertexElement> elements) {
+      uint64_t hash = hashElements(elements);
+      auto range = m_declsByHash.equal_range(hash);
+
+      for (auto i = range.first; i != range.second; i++) {
+        if (i->second->m_elements == elements) {
+          m_stats.internHits += 1;
+          return i->second;
+        }
+      }
+
+      m_decls.emplace_back(new D3D9VertexDecl(std::move(elements), hash, m_support, m_layoutBuilds));
+
+      D3D9VertexDecl* decl = m_decls.back().get();
+      m_declsByHash.insert({ hash, decl });
+      return decl;
+    }
+
+  };
+
+
+  /**
+   * \brief Bound vertex input state
+   *
+   * Lives in the device's state tracker. Rebinding the same
+   * declaration and shader is two pointer compares; only a
+   * change looks up the memoized layout.
+   */
+  class D3D9VertexInputState {
+
+  public:
+
+    /**
+     * \brief Binds a declaration and shader inputs
+     *
+     * \param [in] decl Vertex declaration
+     * \param [in] inputs Vertex shader inputs
+     * \returns \c true if the layout changed and the pipeline
+     *    key and vertex bindings must be updated
+     */
+    bool Bind(D3D9VertexDecl* decl, const D3D9VertexShaderInputs* inputs) {
+      if (decl == m_decl && inputs == m_inputs)
+        return false;
+
+      m_decl = decl;
+      m_inputs = inputs;
+
+      const D3D9InputLayout* layout = decl && inputs
+        ? decl->GetLayout(*inputs)
+        : nullptr;
+
+      if (layout == m_layout)
+        return false;
+
+      m_layout = layout;
+      return true;
+    }
+
+    /**
+     * \brief Current layout
+     * \returns Layout, or \c nullptr if nothing is bound
+     */
+    const D3D9InputLayout* GetLayout() const {
+      return m_layout;
+    }
+
+  private:
+
+    D3D9VertexDecl*               m_decl   = nullptr;
+    const D3D9VertexShaderInputs* m_inputs = nullptr;
+    const D3D9InputLayout*        m_layout = nullptr;
+
+  };
+
+}
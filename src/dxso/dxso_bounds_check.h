@@ -0,0 +1,121 @@
+#pragma once
+
+#include "dxso_float_emulation.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Number of float constants a shader can address
+   *
+   * The size of the constant buffer DxsoCompiler declares and the
+   * bound a manual check compares relative indices against: 256 for
+   * vertex shaders, 224 for ps_3_0 and 32 for ps_2_x.
+   */
+  inline uint32_t DxsoGetFloatConstantCount(const DxsoProgram& program) {
+    if (program.type == DxsoProgramType::VertexShader)
+      return 256;
+
+    return program.major >= 3 ? 224 : 32;
+  }
+
+
+  /**
+   * \brief Relative float constant reads of an operand
+   *
+   * One for plain operands, one per matrix row for the matrix
+   * operand of \c m4x4 and friends, as each row is a separate load.
+   * Zero unless the operand is a relatively addressed constant.
+   */
+  inline uint32_t DxsoGetRelativeConstantReads(const DxsoInstruction& ins, uint32_t operand) {
+    const DxsoRegister& reg = ins.src[operand];
+
+    if (!reg.relative || reg.type != DxsoRegisterType::Const)
+      return 0;
+
+    uint32_t count = DxsoGetMultiplyOperandCount(ins.opcode);
+    return operand == 1 && count > 2 ? count - 1 : 1;
+  }
+
+
+  struct DxsoBoundsCheckStats {
+    uint32_t instructions   = 0;  ///< Decoded instructions
+    uint32_t relativeReads  = 0;  ///< Relatively addressed constant loads
+    uint32_t checks         = 0;  ///< Loads this plan guards
+    uint32_t checkOps       = 0;  ///< SPIR-V instructions the guards add
+  };
+
+
+  /**
+   * \brief Shader bounds checks for one shader
+   *
+   * With \c robustBufferAccess2, a relatively addressed constant
+   * load past the end of the constant buffer returns zero, which is
+   * what D3D9 returns, and DxsoCompiler emits the plain load. Our
+   * DXVK patch disables the feature for MoltenVK, so every such load
+   * is guarded instead: the index is compared against the constant
+   * count (\c OpULessThan), the result splatted to a \c bvec4
+   * (\c OpCompositeConstruct) and the loaded vector replaced by zero
+   * when out of range (\c OpSelect).
+   *
+   * Absolute constant reads are never checked, they are validated
+   * against the same count when the shader is created.
+   */
+  class DxsoBoundsCheckPlan {
+
+  public:
+
+    /// SPIR-V instructions of one manual check
+    static constexpr uint32_t OpsPerCheck = 3;
+
+    DxsoBoundsCheckPlan(
+      const DxsoProgram&  program,
+            bool          robustness2)
+    : m_masks(program.instructions.size(), 0u) {
+      m_stats.instructions = uint32_t(program.instructions.size());
+
+      for (size_t i = 0; i < m_masks.size(); i++) {
+        const DxsoInstruction& ins = program.instructions[i];
+
+        for (uint32_t j = 0; j < ins.srcCount; j++) {
+          uint32_t reads = DxsoGetRelativeConstantReads(ins, j);
+
+          if (!reads)
+            continue;
+
+          m_stats.relativeReads += reads;
+
+          if (!robustness2) {
+            m_masks[i] |= 1u << j;
+            m_stats.checks   += reads;
+            m_stats.checkOps += reads * OpsPerCheck;
+          }
+        }
+      }
+    }
+
+    /**
+     * \brief Checks whether loads of a source operand are guarded
+     *
+     * \param [in] instruction Instruction index
+     * \param [in] operand Source index
+     */
+    bool NeedsBoundsCheck(uint32_t instruction, uint32_t operand) const {
+      return (m_masks[instruction] >> operand) & 0x1;
+    }
+
+    uint32_t GetCheckMask(uint32_t instruction) const {
+      return m_masks[instruction];
+    }
+
+    DxsoBoundsCheckStats GetStats() const {
+      return m_stats;
+    }
+
+  private:
+
+    std::vector<uint32_t> m_masks;
+    DxsoBoundsCheckStats  m_stats;
+
+  };
+
+}
@@ -0,0 +1,910 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Float emulation level
+   *
+   * Mirrors the option in d3d9_options.h, with \c FastStrict added.
+   * \c Strict clamps both operands of every legacy multiply to
+   * [-FLT_MAX, FLT_MAX] with NClamp, so 0 * inf gives 0 as on D3D9
+   * hardware. \c FastStrict only clamps operands the analysis below
+   * cannot prove finite; clamping a finite value is a no-op, so the
+   * results are bit for bit those of \c Strict.
+   */
+  enum class D3D9FloatEmulation : uint32_t {
+    Disabled,
+    Enabled,
+    Strict,
+    FastStrict,
+  };
+
+
+  enum class DxsoProgramType : uint32_t {
+    VertexShader  = 0,
+    PixelShader   = 1,
+  };
+
+
+  /**
+   * \brief Shader opcode
+   *
+   * Values match D3DSHADER_INSTRUCTION_OPCODE_TYPE.
+   */
+  enum class DxsoOpcode : uint32_t {
+    Nop           = 0,
+    Mov           = 1,
+    Add           = 2,
+    Sub           = 3,
+    Mad           = 4,
+    Mul           = 5,
+    Rcp           = 6,
+    Rsq           = 7,
+    Dp3           = 8,
+    Dp4           = 9,
+    Min           = 10,
+    Max           = 11,
+    Slt           = 12,
+    Sge           = 13,
+    Exp           = 14,
+    Log           = 15,
+    Lit           = 16,
+    Dst           = 17,
+    Lrp           = 18,
+    Frc           = 19,
+    M4x4          = 20,
+    M4x3          = 21,
+    M3x4          = 22,
+    M3x3          = 23,
+    M3x2          = 24,
+    Call          = 25,
+    CallNz        = 26,
+    Loop          = 27,
+    Ret           = 28,
+    EndLoop       = 29,
+    Label         = 30,
+    Dcl           = 31,
+    Pow           = 32,
+    Crs           = 33,
+    Sgn           = 34,
+    Abs           = 35,
+    Nrm           = 36,
+    SinCos        = 37,
+    Rep           = 38,
+    EndRep        = 39,
+    If            = 40,
+    Ifc           = 41,
+    Else          = 42,
+    EndIf         = 43,
+    Break         = 44,
+    BreakC        = 45,
+    Mova          = 46,
+    DefB          = 47,
+    DefI          = 48,
+    TexKill       = 65,
+    Tex           = 66,
+    ExpP          = 78,
+    LogP          = 79,
+    Cnd           = 80,
+    Def           = 81,
+    Cmp           = 88,
+    Dp2Add        = 90,
+    Dsx           = 91,
+    Dsy           = 92,
+    TexLdd        = 93,
+    SetP          = 94,
+    TexLdl        = 95,
+    BreakP        = 96,
+    Comment       = 0xfffe,
+    End           = 0xffff,
+  };
+
+
+  /**
+   * \brief Register type
+   *
+   * Values match D3DSHADER_PARAM_REGISTER_TYPE.
+   */
+  enum class DxsoRegisterType : uint32_t {
+    Temp          = 0,
+    Input         = 1,
+    Const         = 2,
+    Addr          = 3,  ///< Texture (t#) in pixel shaders
+    RasterizerOut = 4,
+    AttributeOut  = 5,
+    Output        = 6,
+    ConstInt      = 7,
+    ColorOut      = 8,
+    DepthOut      = 9,
+    Sampler       = 10,
+    Const2        = 11,
+    Const3        = 12,
+    Const4        = 13,
+    ConstBool     = 14,
+    Loop          = 15,
+    TempFloat16   = 16,
+    MiscType      = 17,
+    Label         = 18,
+    Predicate     = 19,
+  };
+
+
+  /**
+   * \brief Source modifier
+   *
+   * Values match D3DSHADER_PARAM_SRCMOD_TYPE.
+   */
+  enum class DxsoRegModifier : uint32_t {
+    None          = 0,
+    Neg           = 1,
+    Bias          = 2,
+    BiasNeg       = 3,
+    Sign          = 4,
+    SignNeg       = 5,
+    Comp          = 6,
+    X2            = 7,
+    X2Neg         = 8,
+    Dz            = 9,
+    Dw            = 10,
+    Abs           = 11,
+    AbsNeg        = 12,
+    Not           = 13,
+  };
+
+
+  struct DxsoRegister {
+    DxsoRegisterType  type      = DxsoRegisterType::Temp;
+    uint32_t          index     = 0;
+    bool              relative  = false;
+    uint32_t          mask      = 0xf;    ///< Write mask, destination only
+    bool              saturate  = false;  ///< Destination only
+    uint32_t          swizzle   = 0xe4;   ///< Two bits per component, source only
+    DxsoRegModifier   modifier  = DxsoRegModifier::None;
+
+    uint32_t component(uint32_t i) const {
+      return (swizzle >> (2 * i)) & 0x3;
+    }
+  };
+
+
+  struct DxsoInstruction {
+    DxsoOpcode    opcode      = DxsoOpcode::Nop;
+    uint32_t      control     = 0;      ///< Opcode specific bits, e.g. the ifc comparison
+    bool          predicated  = false;
+    bool          hasDst      = false;
+    DxsoRegister  dst;
+    uint32_t      srcCount    = 0;
+    DxsoRegister  src[4];
+    uint32_t      def[4]      = { };    ///< def, defi and defb values, dcl usage token
+  };
+
+
+  /**
+   * \brief Decoded shader
+   */
+  struct DxsoProgram {
+    DxsoProgramType               type  = DxsoProgramType::VertexShader;
+    uint32_t                      major = 0;
+    uint32_t                      minor = 0;
+    std::vector<DxsoInstruction>  instructions;
+  };
+
+
+  /**
+   * \brief Decodes shader model 2 and 3 bytecode
+   *
+   * Only the parts the float analysis needs. Shader model 1 has
+   * no instruction length field and is rejected, those shaders
+   * keep Strict emulation.
+   * \param [in] code Bytecode, starting with the version token
+   * \param [in] dwords Bytecode size in dwords
+   * \param [out] program Decoded shader
+   * \returns \c true on success
+   */
+  inline bool DxsoDecode(const uint32_t* code, size_t dwords, DxsoProgram& program) {
+    program = DxsoProgram();
+
+    if (!dwords)
+      return false;
+
+    uint32_t version = code[0];
+
+    if ((version & 0xffff0000u) == 0xfffe0000u)
+      program.type = DxsoProgramType::VertexShader;
+    else if ((version & 0xffff0000u) == 0xffff0000u)
+      program.type = DxsoProgramType::PixelShader;
+    else
+      return false;
+
+    program.major = (version >> 8) & 0xff;
+    program.minor = version & 0xff;
+
+    if (program.major < 2 || program.major > 3)
+      return false;
+
+    auto decodeRegister = [] (uint32_t token) {
+      DxsoRegister reg;
+      reg.type      = DxsoRegisterType(((token >> 28) & 0x7) | ((token >> 8) & 0x18));
+      reg.index     = token & 0x7ff;
+      reg.relative  = (token >> 13) & 0x1;
+      return reg;
+    };
+
+    size_t pos = 1;
+
+    while (pos < dwords) {
+      uint32_t token = code[pos++];
+      uint32_t opcode = token & 0xffff;
+
+      if (opcode == uint32_t(DxsoOpcode::End))
+        return true;
+
+      if (opcode == uint32_t(DxsoOpcode::Comment)) {
+        pos += (token >> 16) & 0x7fff;
+        continue;
+      }
+
+      uint32_t length = (token >> 24) & 0xf;
+
+      if (pos + length > dwords)
+        return false;
+
+      const uint32_t* params = &code[pos];
+      const uint32_t* end    = params + length;
+      pos += length;
+
+      DxsoInstruction ins;
+      ins.opcode      = DxsoOpcode(opcode);
+      ins.control     = (token >> 16) & 0xff;
+      ins.predicated  = (token >> 28) & 0x1;
+
+      switch (ins.opcode) {
+        case DxsoOpcode::Nop:
+        case DxsoOpcode::Call:
+        case DxsoOpcode::CallNz:
+        case DxsoOpcode::Loop:
+        case DxsoOpcode::Ret:
+        case DxsoOpcode::EndLoop:
+        case DxsoOpcode::Label:
+        case DxsoOpcode::Rep:
+        case DxsoOpcode::EndRep:
+        case DxsoOpcode::If:
+        case DxsoOpcode::Ifc:
+        case DxsoOpcode::Else:
+        case DxsoOpcode::EndIf:
+        case DxsoOpcode::Break:
+        case DxsoOpcode::BreakC:
+        case DxsoOpcode::BreakP:
+        case DxsoOpcode::TexKill:
+          break;
+
+        case DxsoOpcode::Dcl:
+          // Usage token, then the declared register
+          if (length < 2)
+            return false;
+          ins.def[0] = *params++;
+          ins.hasDst = true;
+          break;
+
+        default:
+          ins.hasDst = true;
+      }
+
+      if (ins.hasDst) {
+        if (params == end)
+          return false;
+
+        uint32_t dst = *params++;
+        ins.dst = decodeRegister(dst);
+        ins.dst.mask     = (dst >> 16) & 0xf;
+        ins.dst.saturate = (dst >> 20) & 0x1;
+
+        if (ins.dst.relative && params != end)
+          params++;
+
+        // The predicate register follows the destination
+        if (ins.predicated && params != end)
+          params++;
+      }
+
+      if (ins.opcode == DxsoOpcode::Def
+       || ins.opcode == DxsoOpcode::DefI
+       || ins.opcode == DxsoOpcode::DefB) {
+        for (uint32_t i = 0; i < 4 && params != end; i++)
+          ins.def[i] = *params++;
+      } else {
+        while (params != end) {
+          if (ins.srcCount == 4)
+            return false;
+
+          uint32_t src = *params++;
+          DxsoRegister& reg = ins.src[ins.srcCount++];
+          reg = decodeRegister(src);
+          reg.swizzle  = (src >> 16) & 0xff;
+          reg.modifier = DxsoRegModifier((src >> 24) & 0xf);
+
+          if (reg.relative && params != end)
+            params++;
+        }
+      }
+
+      program.instructions.push_back(ins);
+    }
+
+    // No end token
+    return false;
+  }
+
+
+  /**
+   * \brief Number of multiplied operands of a legacy multiply
+   *
+   * Matrix instructions count their source vector plus one
+   * operand per matrix row. Returns 0 for all other opcodes.
+   */
+  inline uint32_t DxsoGetMultiplyOperandCount(DxsoOpcode opcode) {
+    switch (opcode) {
+      case DxsoOpcode::Mul:
+      case DxsoOpcode::Mad:
+      case DxsoOpcode::Dp2Add:
+      case DxsoOpcode::Dp3:
+      case DxsoOpcode::Dp4:     return 2;
+      case DxsoOpcode::M4x4:
+      case DxsoOpcode::M3x4:    return 5;
+      case DxsoOpcode::M4x3:
+      case DxsoOpcode::M3x3:    return 4;
+      case DxsoOpcode::M3x2:    return 3;
+      default:                  return 0;
+    }
+  }
+
+
+  struct DxsoFloatAnalysisOptions {
+    /// Color inputs of ps_2_x and below lie in [0, 1]. D3D9 saturates
+    /// the color interpolators, the vertex stage has to as well.
+    bool saturatedColorInputs = true;
+    /// Loop passes before bounds that keep growing are widened to inf
+    uint32_t maxLoopPasses = 4;
+  };
+
+
+  struct DxsoFloatEmulationStats {
+    uint32_t instructions   = 0;  ///< Decoded instructions
+    uint32_t multiplies     = 0;  ///< Legacy multiplies, one per matrix row
+    uint32_t strictClamps   = 0;  ///< Operand clamps Strict emits
+    uint32_t clamps         = 0;  ///< Operand clamps this plan emits
+    bool     analyzed       = false;  ///< \c false if the shader fell back to Strict
+  };
+
+
+  /**
+   * \brief Float emulation plan for one shader
+   *
+   * Computes, for every legacy multiply, which operands need the
+   * NClamp that implements 0 * inf = 0. With \c FastStrict, an
+   * interval analysis tracks an upper bound on the magnitude of
+   * each temp component:
+   *
+   * - \c def constants, saturated results, \c frc, \c sincos, the
+   *   comparison results and (optionally) color inputs are bounded
+   * - uniform constants, texture samples, \c rcp, \c rsq, \c log,
+   *   \c pow, \c nrm and vertex inputs are not
+   * - arithmetic propagates bounds, and a bound above FLT_MAX means
+   *   the value may be inf or NaN
+   *
+   * Branches merge both sides, loops are iterated to a fixed point
+   * and widened. An operand is clamped whenever it may be non-finite,
+   * not only when the other operand may also be zero: Strict turns
+   * inf * 0.5 into a finite value too, and FastStrict has to match it.
+   * Shaders with subroutines are not analysed and use Strict.
+   *
+   * DxsoCompiler counts instructions as it decodes them and asks
+   * \c NeedsClamp when it emits a multiply.
+   */
+  class DxsoFloatEmulationPlan {
+
+  public:
+
+    DxsoFloatEmulationPlan(
+      const DxsoProgram&              program,
+            D3D9FloatEmulation        mode,
+      const DxsoFloatAnalysisOptions& options = DxsoFloatAnalysisOptions())
+    : m_program(&program), m_options(options),
+      m_masks(program.instructions.size(), 0u) {
+      m_stats.instructions = uint32_t(program.instructions.size());
+
+      bool strict = mode == D3D9FloatEmulation::Strict
+                 || mode == D3D9FloatEmulation::FastStrict;
+
+      if (mode == D3D9FloatEmulation::FastStrict)
+        m_stats.analyzed = Analyze();
+
+      for (size_t i = 0; i < m_masks.size(); i++) {
+        uint32_t count = DxsoGetMultiplyOperandCount(program.instructions[i].opcode);
+        uint32_t all = (1u << count) - 1u;
+
+        if (!m_stats.analyzed)
+          m_masks[i] = strict ? all : 0u;
+
+        m_stats.multiplies   += count > 2 ? count - 1 : (count ? 1 : 0);
+        m_stats.strictClamps += count;
+        m_stats.clamps       += Popcount(m_masks[i]);
+      }
+
+      m_program = nullptr;
+    }
+
+    /**
+     * \brief Checks whether a multiply operand needs a clamp
+     *
+     * \param [in] instruction Instruction index
+     * \param [in] operand Source index; for matrix instructions
+     *    0 is the vector and 1 + i the i-th row
+     */
+    bool NeedsClamp(uint32_t instruction, uint32_t operand) const {
+      return (m_masks[instruction] >> operand) & 0x1;
+    }
+
+    uint32_t GetClampMask(uint32_t instruction) const {
+      return m_masks[instruction];
+    }
+
+    DxsoFloatEmulationStats GetStats() const {
+      return m_stats;
+    }
+
+  private:
+
+    static constexpr uint32_t MaxTemps = 32;
+    static constexpr double   Unbounded = std::numeric_limits<double>::infinity();
+
+    using Vec   = std::array<double, 4>;
+    using State = std::array<Vec, MaxTemps>;
+
+    struct Block {
+      size_t elseIndex  = 0;
+      size_t endIndex   = 0;
+    };
+
+    const DxsoProgram*        m_program;  ///< Only during construction
+    DxsoFloatAnalysisOptions  m_options;
+
+    std::vector<uint32_t>     m_masks;
+    std::vector<Block>        m_blocks;
+    std::vector<Vec>          m_consts;
+    std::vector<bool>         m_defined;
+    std::vector<std::vector<State>> m_breaks;
+
+    DxsoFloatEmulationStats   m_stats;
+
+    static uint32_t Popcount(uint32_t x) {
+      uint32_t n = 0;
+      for ( ; x; x &= x - 1)
+        n++;
+      return n;
+    }
+
+    /* Bounds are inflated slightly so float rounding of the actual
+     * values cannot exceed them */
+    static double Bound(double x) {
+      x *= 1.0 + 0x1p-20;
+      return x > double(std::numeric_limits<float>::max()) ? Unbounded : x;
+    }
+
+    /* Multiply operands are clamped whenever they are unbounded, so
+     * in the product they are at most FLT_MAX */
+    static double Product(double a, double b) {
+      double max = double(std::numeric_limits<float>::max());
+      return Bound(std::min(a, max) * std::min(b, max));
+    }
+
+    static bool Finite(double x) {
+      return x != Unbounded;
+    }
+
+    static void Merge(State& dst, const State& src) {
+      for (uint32_t r = 0; r < MaxTemps; r++) {
+        for (uint32_t c = 0; c < 4; c++)
+          dst[r][c] = std::max(dst[r][c], src[r][c]);
+      }
+    }
+
+    bool Analyze() {
+      const auto& ins = m_program->instructions;
+
+      // Match blocks and collect def constants. Subroutines would
+      // need an interprocedural analysis, which is not worth it.
+      m_blocks.resize(ins.size());
+      std::vector<size_t> stack;
+
+      for (size_t i = 0; i < ins.size(); i++) {
+        switch (ins[i].opcode) {
+          case DxsoOpcode::Call:
+          case DxsoOpcode::CallNz:
+          case DxsoOpcode::Label:
+          case DxsoOpcode::Ret:
+            return false;
+
+          case DxsoOpcode::If:
+          case DxsoOpcode::Ifc:
+          case DxsoOpcode::Loop:
+          case DxsoOpcode::Rep:
+            stack.push_back(i);
+            break;
+
+          case DxsoOpcode::Else:
+            if (stack.empty() || ins[stack.back()].opcode == DxsoOpcode::Loop
+                              || ins[stack.back()].opcode == DxsoOpcode::Rep)
+              return false;
+            m_blocks[stack.back()].elseIndex = i;
+            break;
+
+          case DxsoOpcode::EndIf:
+          case DxsoOpcode::EndLoop:
+          case DxsoOpcode::EndRep:
+            if (stack.empty())
+              return false;
+            m_blocks[stack.back()].endIndex = i;
+            stack.pop_back();
+            break;
+
+          case DxsoOpcode::Def:
+            if (!ins[i].dst.relative) {
+              uint32_t index = ins[i].dst.index;
+
+              if (index >= m_consts.size()) {
+                m_consts.resize(index + 1);
+                m_defined.resize(index + 1, false);
+              }
+
+              for (uint32_t c = 0; c < 4; c++) {
+                float value;
+                std::memcpy(&value, &ins[i].def[c], sizeof(value));
+                m_consts[index][c] = std::isfinite(value) ? Bound(std::fabs(double(value))) : Unbounded;
+              }
+
+              m_defined[index] = true;
+            }
+            break;
+
+          default:
+            break;
+        }
+      }
+
+      if (!stack.empty())
+        return false;
+
+      // Temps start out as zero
+      State state = { };
+      AnalyzeRange(0, ins.size(), state);
+      return true;
+    }
+
+    void AnalyzeRange(size_t begin, size_t end, State& state) {
+      const auto& ins = m_program->instructions;
+
+      for (size_t i = begin; i < end; i++) {
+        switch (ins[i].opcode) {
+          case DxsoOpcode::If:
+          case DxsoOpcode::Ifc: {
+            const Block& block = m_blocks[i];
+            State other = state;
+
+            if (block.elseIndex) {
+              AnalyzeRange(i + 1, block.elseIndex, state);
+              AnalyzeRange(block.elseIndex + 1, block.endIndex, other);
+            } else {
+              AnalyzeRange(i + 1, block.endIndex, state);
+            }
+
+            Merge(state, other);
+            i = block.endIndex;
+          } break;
+
+          case DxsoOpcode::Loop:
+          case DxsoOpcode::Rep: {
+            const Block& block = m_blocks[i];
+            m_breaks.emplace_back();
+
+            // Iterate the body until the loop head state is stable,
+            // widening whatever still grows after a few passes
+            for (uint32_t pass = 0; ; pass++) {
+              State body = state;
+              AnalyzeRange(i + 1, block.endIndex, body);
+
+              State head = state;
+              Merge(head, body);
+
+              if (head == state)
+                break;
+
+              if (pass + 1 >= m_options.maxLoopPasses) {
+                for (uint32_t r = 0; r < MaxTemps; r++) {
+                  for (uint32_t c = 0; c < 4; c++) {
+                    if (head[r][c] > state[r][c])
+                      head[r][c] = Unbounded;
+                  }
+                }
+              }
+
+              state = head;
+            }
+
+            for (const auto& s : m_breaks.back())
+              Merge(state, s);
+
+            m_breaks.pop_back();
+            i = block.endIndex;
+          } break;
+
+          case DxsoOpcode::Break:
+          case DxsoOpcode::BreakC:
+          case DxsoOpcode::BreakP:
+            if (!m_breaks.empty())
+              m_breaks.back().push_back(state);
+            break;
+
+          default:
+            AnalyzeInstruction(i, state);
+        }
+      }
+    }
+
+    Vec LoadRegister(const DxsoRegister& reg, const State& state, uint32_t offset = 0) const {
+      Vec v;
+      v.fill(Unbounded);
+
+      if (reg.relative)
+        return v;
+
+      uint32_t index = reg.index + offset;
+
+      switch (reg.type) {
+        case DxsoRegisterType::Temp:
+          if (index < MaxTemps)
+            v = state[index];
+          break;
+
+        case DxsoRegisterType::Const:
+          if (index < m_consts.size() && m_defined[index])
+            v = m_consts[index];
+          break;
+
+        case DxsoRegisterType::Input:
+          if (m_program->type == DxsoProgramType::PixelShader
+           && m_program->major < 3 && m_options.saturatedColorInputs)
+            v.fill(1.0);
+          break;
+
+        case DxsoRegisterType::MiscType:
+          // vPos is in pixels, vFace is +-1
+          v.fill(index ? 1.0 : 32768.0);
+          break;
+
+        default:
+          break;
+      }
+
+      return v;
+    }
+
+    Vec LoadSource(const DxsoRegister& reg, const State& state, uint32_t offset = 0) const {
+      Vec r = LoadRegister(reg, state, offset);
+      Vec v;
+
+      for (uint32_t c = 0; c < 4; c++) {
+        double x = r[reg.component(c)];
+
+        switch (reg.modifier) {
+          case DxsoRegModifier::Bias:
+          case DxsoRegModifier::BiasNeg:  x = Bound(x + 0.5); break;
+          case DxsoRegModifier::Sign:
+          case DxsoRegModifier::SignNeg:  x = Bound(2.0 * x + 1.0); break;
+          case DxsoRegModifier::Comp:     x = Bound(x + 1.0); break;
+          case DxsoRegModifier::X2:
+          case DxsoRegModifier::X2Neg:    x = Bound(2.0 * x); break;
+          case DxsoRegModifier::Dz:
+          case DxsoRegModifier::Dw:       x = Unbounded; break;
+          default: break;
+        }
+
+        v[c] = x;
+      }
+
+      return v;
+    }
+
+    /* Whether any component the instruction reads may be non-finite */
+    static bool MayBeNonFinite(const Vec& v, uint32_t mask) {
+      for (uint32_t c = 0; c < 4; c++) {
+        if (((mask >> c) & 1) && !Finite(v[c]))
+          return true;
+      }
+      return false;
+    }
+
+    static double Dot(const Vec& a, const Vec& b, uint32_t n) {
+      double sum = 0.0;
+      for (uint32_t c = 0; c < n; c++)
+        sum += Product(a[c], b[c]);
+      return Bound(sum);
+    }
+
+    void AnalyzeInstruction(size_t index, State& state) {
+      const DxsoInstruction& ins = m_program->instructions[index];
+
+      if (!ins.hasDst || ins.opcode == DxsoOpcode::Dcl
+       || ins.opcode == DxsoOpcode::Def
+       || ins.opcode == DxsoOpcode::DefI
+       || ins.opcode == DxsoOpcode::DefB)
+        return;
+
+      Vec a = ins.srcCount > 0 ? LoadSource(ins.src[0], state) : Vec();
+      Vec b = ins.srcCount > 1 ? LoadSource(ins.src[1], state) : Vec();
+      Vec c = ins.srcCount > 2 ? LoadSource(ins.src[2], state) : Vec();
+
+      Vec result;
+      result.fill(Unbounded);
+
+      uint32_t mask = ins.dst.mask;
+      uint32_t& clamps = m_masks[index];
+
+      auto componentwise = [&] (auto fn) {
+        for (uint32_t i = 0; i < 4; i++)
+          result[i] = fn(a[i], b[i], c[i]);
+      };
+
+      auto splat = [&] (double x) {
+        result.fill(x);
+      };
+
+      switch (ins.opcode) {
+        case DxsoOpcode::Mov:
+        case DxsoOpcode::Abs:
+          componentwise([] (double x, double, double) { return x; });
+          break;
+
+        case DxsoOpcode::Add:
+        case DxsoOpcode::Sub:
+          componentwise([] (double x, double y, double) { return Bound(x + y); });
+          break;
+
+        case DxsoOpcode::Mul:
+        case DxsoOpcode::Mad:
+          if (MayBeNonFinite(a, mask)) clamps |= 1u << 0;
+          if (MayBeNonFinite(b, mask)) clamps |= 1u << 1;
+
+          componentwise([&] (double x, double y, double z) {
+            return ins.opcode == DxsoOpcode::Mad ? Bound(Product(x, y) + z) : Product(x, y);
+          });
+          break;
+
+        case DxsoOpcode::Dp2Add:
+        case DxsoOpcode::Dp3:
+        case DxsoOpcode::Dp4: {
+          uint32_t n = ins.opcode == DxsoOpcode::Dp4 ? 4 : (ins.opcode == DxsoOpcode::Dp3 ? 3 : 2);
+          uint32_t read = (1u << n) - 1u;
+
+          if (MayBeNonFinite(a, read)) clamps |= 1u << 0;
+          if (MayBeNonFinite(b, read)) clamps |= 1u << 1;
+
+          double dot = Dot(a, b, n);
+          splat(ins.opcode == DxsoOpcode::Dp2Add ? Bound(dot + c[0]) : dot);
+        } break;
+
+        case DxsoOpcode::M4x4:
+        case DxsoOpcode::M4x3:
+        case DxsoOpcode::M3x4:
+        case DxsoOpcode::M3x3:
+        case DxsoOpcode::M3x2: {
+          uint32_t rows = DxsoGetMultiplyOperandCount(ins.opcode) - 1;
+          uint32_t n = (ins.opcode == DxsoOpcode::M4x4 || ins.opcode == DxsoOpcode::M4x3) ? 4 : 3;
+          uint32_t read = (1u << n) - 1u;
+
+          if (MayBeNonFinite(a, read))
+            clamps |= 1u << 0;
+
+          for (uint32_t r = 0; r < rows; r++) {
+            Vec row = ins.srcCount > 1 ? LoadSource(ins.src[1], state, r) : Vec();
+
+            if (MayBeNonFinite(row, read))
+              clamps |= 1u << (1 + r);
+
+            result[r] = Dot(a, row, n);
+          }
+        } break;
+
+        case DxsoOpcode::Min:
+        case DxsoOpcode::Max:
+        case DxsoOpcode::Cmp:
+        case DxsoOpcode::Cnd:
+          componentwise([&] (double x, double y, double z) {
+            bool select = ins.opcode == DxsoOpcode::Cmp || ins.opcode == DxsoOpcode::Cnd;
+            return select ? std::max(y, z) : std::max(x, y);
+          });
+          break;
+
+        case DxsoOpcode::Slt:
+        case DxsoOpcode::Sge:
+          splat(1.0);
+          break;
+
+        case DxsoOpcode::Frc:
+        case DxsoOpcode::Sgn:
+          // frc and sign of inf or NaN give NaN
+          componentwise([] (double x, double, double) { return Finite(x) ? 1.0 : Unbounded; });
+          break;
+
+        case DxsoOpcode::SinCos:
+          splat(Finite(a[0]) ? 1.0 : Unbounded);
+          break;
+
+        case DxsoOpcode::Exp:
+        case DxsoOpcode::ExpP: {
+          double x = *std::max_element(a.begin(), a.end());
+          splat(x < 128.0 ? Bound(std::exp2(x)) : Unbounded);
+        } break;
+
+        case DxsoOpcode::Lit:
+          result = { 1.0, Finite(a[0]) ? a[0] : Unbounded, Unbounded, 1.0 };
+          break;
+
+        case DxsoOpcode::Dst:
+          result = { 1.0, Product(a[1], b[1]), a[2], b[3] };
+          break;
+
+        case DxsoOpcode::Lrp:
+          componentwise([] (double x, double y, double z) {
+            double d = Bound(y + z);
+            return Finite(x) && Finite(d) ? Bound(x * d + z) : Unbounded;
+          });
+          break;
+
+        case DxsoOpcode::Crs:
+          componentwise([&] (double, double, double) {
+            double x = *std::max_element(a.begin(), a.begin() + 3);
+            double y = *std::max_element(b.begin(), b.begin() + 3);
+            return Finite(x) && Finite(y) ? Bound(2.0 * x * y) : Unbounded;
+          });
+          break;
+
+        case DxsoOpcode::Dsx:
+        case DxsoOpcode::Dsy:
+          componentwise([] (double x, double, double) { return Bound(2.0 * x); });
+          break;
+
+        default:
+          // Texture samples, rcp, rsq, log, pow, nrm and anything
+          // else may produce inf or NaN
+          break;
+      }
+
+      if (ins.dst.saturate)
+        result.fill(1.0);
+
+      if (ins.dst.type != DxsoRegisterType::Temp || ins.dst.relative || ins.dst.index >= MaxTemps)
+        return;
+
+      Vec& dst = state[ins.dst.index];
+
+      for (uint32_t i = 0; i < 4; i++) {
+        if (!((mask >> i) & 1))
+          continue;
+
+        // A predicated write may not happen
+        dst[i] = ins.predicated ? std::max(dst[i], result[i]) : result[i];
+      }
+    }
+
+  };
+
+}
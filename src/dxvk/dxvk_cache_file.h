@@ -0,0 +1,690 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk {
+
+  /**
+   * \brief CRC32C (Castagnoli)
+   *
+   * Used for per-entry corruption detection. Table-driven
+   * so it works the same on every target we build for.
+   */
+  class DxvkCrc32c {
+
+  public:
+
+    static uint32_t compute(const void* data, size_t size, uint32_t crc = 0) {
+      static const std::array<uint32_t, 256> table = buildTable();
+
+      auto bytes = reinterpret_cast<const uint8_t*>(data);
+      crc = ~crc;
+
+      for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+      return ~crc;
+    }
+
+  private:
+
+    static std::array<uint32_t, 256> buildTable() {
+      std::array<uint32_t, 256> table = { };
+
+      for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (uint32_t j = 0; j < 8; j++)
+          crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78u : 0u);
+
+        table[i] = crc;
+      }
+
+      return table;
+    }
+
+  };
+
+
+  /**
+   * \brief Cache file key
+   *
+   * 128 bits of a content hash. Ordered by the high
+   * half first so the index can be binary searched.
+   */
+  struct DxvkCacheFileKey {
+    uint64_t lo = 0;
+    uint64_t hi = 0;
+
+    bool operator == (const DxvkCacheFileKey& other) const {
+      return lo == other.lo && hi == other.hi;
+    }
+
+    bool operator < (const DxvkCacheFileKey& other) const {
+      return hi < other.hi || (hi == other.hi && lo < other.lo);
+    }
+  };
+
+
+  struct DxvkCacheFileKeyHash {
+    size_t operator () (const DxvkCacheFileKey& key) const {
+      return size_t(key.lo ^ (key.hi * 0x9e3779b97f4a7c15ull));
+    }
+  };
+
+
+  /**
+   * \brief Cache file header
+   *
+   * Layout of the file:
+   *   [header][sorted index entries][entry blobs]
+   * All offsets are in bytes, little endian.
+   */
+  struct DxvkCacheFileHeader {
+    char      magic[4];       ///< "DXCF"
+    uint32_t  version;
+    uint32_t  entryCount;
+    uint32_t  reserved;
+    uint64_t  indexOffset;    ///< Absolute offset of the index
+    uint64_t  dataOffset;     ///< Absolute offset of the blob region
+    uint64_t  dataSize;       ///< Size of the blob region
+  };
+
+  static_assert(sizeof(DxvkCacheFileHeader) == 40);
+
+
+  /**
+   * \brief Cache file index entry
+   *
+   * Index entries are sorted by key. The CRC covers
+   * the blob, so a corrupted entry is detected on
+   * first access without touching other entries.
+   */
+  struct DxvkCacheFileEntry {
+    DxvkCacheFileKey  key;
+    uint64_t          offset;   ///< Relative to \c dataOffset
+    uint32_t          size;
+    uint32_t          crc;
+  };
+
+  static_assert(sizeof(DxvkCacheFileEntry) == 32);
+
+
+  /**
+   * \brief Journal record header
+   *
+   * Entries added at runtime are appended to a separate
+   * journal file (\c <path>.journal) and merged into the
+   * main file offline by \ref DxvkCacheFile::compact. The
+   * header CRC catches records torn by a crash mid-append.
+   */
+  struct DxvkCacheFileJournalRecord {
+    char              magic[4];   ///< "DXCJ"
+    uint32_t          size;
+    DxvkCacheFileKey  key;
+    uint32_t          crc;        ///< CRC32C of the data
+    uint32_t          headerCrc;  ///< CRC32C of the preceding fields
+  };
+
+  static_assert(sizeof(DxvkCacheFileJournalRecord) == 32);
+
+
+  /**
+   * \brief Cache lookup result
+   */
+  enum class DxvkCacheLookup : uint32_t {
+    Found,
+    Missing,
+    Corrupt,
+  };
+
+
+  /**
+   * \brief Cache file statistics
+   */
+  struct DxvkCacheFileStats {
+    uint64_t lookups        = 0;
+    uint64_t hits           = 0;
+    uint64_t misses         = 0;
+    uint64_t corrupt        = 0;
+    uint64_t verifiedBytes  = 0;
+    uint64_t journalEntries = 0;
+  };
+
+
+  /**
+   * \brief Cache file writer
+   *
+   * Builds a complete cache file. Used for offline
+   * compaction and by tools that generate caches.
+   */
+  class DxvkCacheFileWriter {
+
+  public:
+
+    void add(const DxvkCacheFileKey& key, const void* data, size_t size) {
+      auto bytes = reinterpret_cast<const char*>(data);
+      m_entries[key].assign(bytes, bytes + size);
+    }
+
+    size_t size() const {
+      return m_entries.size();
+    }
+
+    /**
+     * \brief Writes the cache file
+     *
+     * Writes to a temporary file first and renames it over
+     * the target, so readers never observe a partial file.
+     * \param [in] path Target file path
+     * \returns \c true on success
+     */
+    bool write(const std::string& path) const {
+      std::vector<const std::pair<const DxvkCacheFileKey, std::vector<char>>*> sorted;
+      sorted.reserve(m_entries.size());
+
+      for (const auto& e : m_entries)
+        sorted.push_back(&e);
+
+      std::sort(sorted.begin(), sorted.end(),
+        [] (auto a, auto b) { return a->first < b->first; });
+
+      DxvkCacheFileHeader header = { };
+      std::memcpy(header.magic, "DXCF", 4);
+      header.version     = Version;
+      header.entryCount  = uint32_t(sorted.size());
+      header.indexOffset = sizeof(header);
+      header.dataOffset  = header.indexOffset + sorted.size() * sizeof(DxvkCacheFileEntry);
+
+      std::vector<DxvkCacheFileEntry> index;
+      index.reserve(sorted.size());
+
+      uint64_t offset = 0;
+
+      for (auto e : sorted) {
+        DxvkCacheFileEntry& entry = index.emplace_back();
+        entry.key    = e->first;
+        entry.offset = offset;
+        entry.size   = uint32_t(e->second.size());
+        entry.crc    = DxvkCrc32c::compute(e->second.data(), e->second.size());
+        offset += e->second.size();
+      }
+
+      header.dataSize = offset;
+
+      std::string tmpPath = path + ".tmp";
+      std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+
+      if (!file)
+        return false;
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(DxvkCacheFileEntry));
+
+      for (auto e : sorted)
+        file.write(e->second.data(), e->second.size());
+
+      file.close();
+
+      if (!file) {
+        std::remove(tmpPath.c_str());
+        return false;
+      }
+
+#ifdef _WIN32
+      return MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+      return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+    }
+
+    static constexpr uint32_t Version = 1;
+
+  private:
+
+    std::unordered_map<DxvkCacheFileKey, std::vector<char>, DxvkCacheFileKeyHash> m_entries;
+
+  };
+
+
+  /**
+   * \brief Memory-mapped cache file
+   *
+   * Maps the file read-only and looks entries up lazily by
+   * binary search over the sorted index, so opening the cache
+   * costs the same regardless of its size and only the pages
+   * of entries that are actually used get faulted in.
+   *
+   * Lookups in the mapped file are lock-free. Each entry is
+   * CRC-checked once on first access; a corrupted entry is
+   * reported as such and does not affect any other entry.
+   * New entries go to the journal, which is only consulted
+   * on a miss in the mapped index or for a corrupted entry,
+   * whose replacement is journaled like a new entry.
+   */
+  class DxvkCacheFile {
+
+  public:
+
+    explicit DxvkCacheFile(const std::string& path)
+    : m_path(path) {
+      mapFile();
+      loadJournal();
+    }
+
+    ~DxvkCacheFile() {
+      unmapFile();
+    }
+
+    DxvkCacheFile             (const DxvkCacheFile&) = delete;
+    DxvkCacheFile& operator = (const DxvkCacheFile&) = delete;
+
+    /**
+     * \brief Checks whether the mapped file is usable
+     *
+     * A missing or invalid main file is not an error, the
+     * cache then only serves entries from the journal.
+     */
+    bool isMapped() const {
+      return m_index != nullptr;
+    }
+
+    uint32_t entryCount() const {
+      return m_entryCount;
+    }
+
+    /**
+     * \brief Looks up an entry
+     *
+     * \param [in] key Entry key
+     * \param [out] data Pointer to entry data, valid for the
+     *    lifetime of the cache file object
+     * \param [out] size Entry size in bytes
+     * \returns Lookup result
+     */
+    DxvkCacheLookup lookup(const DxvkCacheFileKey& key, const void** data, size_t* size) {
+      m_lookups.fetch_add(1, std::memory_order_relaxed);
+
+      const DxvkCacheFileEntry* entry = findEntry(key);
+      bool corrupt = false;
+
+      if (entry) {
+        if (verifyEntry(uint32_t(entry - m_index))) {
+          *data = m_data + entry->offset;
+          *size = entry->size;
+
+          m_hits.fetch_add(1, std::memory_order_relaxed);
+          return DxvkCacheLookup::Found;
+        }
+
+        // The journal may hold a replacement
+        corrupt = true;
+      }
+
+      std::lock_guard lock(m_journalMutex);
+      auto journalEntry = m_journal.find(key);
+
+      if (journalEntry == m_journal.end()) {
+        if (corrupt) {
+          m_corrupt.fetch_add(1, std::memory_order_relaxed);
+          return DxvkCacheLookup::Corrupt;
+        }
+
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+        return DxvkCacheLookup::Missing;
+      }
+
+      *data = journalEntry->second.data();
+      *size = journalEntry->second.size();
+
+      m_hits.fetch_add(1, std::memory_order_relaxed);
+      return DxvkCacheLookup::Found;
+    }
+
+    /**
+     * \brief Appends an entry to the journal
+     *
+     * The entry becomes visible to lookups immediately and
+     * is merged into the main file by the next compaction.
+     * \param [in] key Entry key
+     * \param [in] data Entry data
+     * \param [in] size Entry size
+     * \returns \c true if the record was written
+     */
+    bool append(const DxvkCacheFileKey& key, const void* data, size_t size) {
+      // A corrupted mapped entry gets replaced through the journal
+      if (hasValidEntry(key))
+        return true;
+
+      auto bytes = reinterpret_cast<const char*>(data);
+
+      DxvkCacheFileJournalRecord record = { };
+      std::memcpy(record.magic, "DXCJ", 4);
+      record.size      = uint32_t(size);
+      record.key       = key;
+      record.crc       = DxvkCrc32c::compute(data, size);
+      record.headerCrc = DxvkCrc32c::compute(&record, offsetof(DxvkCacheFileJournalRecord, headerCrc));
+
+      std::lock_guard lock(m_journalMutex);
+
+      if (!m_journal.emplace(key, std::vector<char>(bytes, bytes + size)).second)
+        return true;
+
+      if (!m_journalFile.is_open())
+        m_journalFile.open(journalPath(m_path), std::ios::binary | std::ios::app);
+
+      m_journalFile.write(reinterpret_cast<const char*>(&record), sizeof(record));
+      m_journalFile.write(bytes, size);
+      m_journalFile.flush();
+      return bool(m_journalFile);
+    }
+
+    /**
+     * \brief Queries statistics
+     */
+    DxvkCacheFileStats getStats() {
+      DxvkCacheFileStats stats;
+      stats.lookups       = m_lookups.load(std::memory_order_relaxed);
+      stats.hits          = m_hits.load(std::memory_order_relaxed);
+      stats.misses        = m_misses.load(std::memory_order_relaxed);
+      stats.corrupt       = m_corrupt.load(std::memory_order_relaxed);
+      stats.verifiedBytes = m_verifiedBytes.load(std::memory_order_relaxed);
+
+      std::lock_guard lock(m_journalMutex);
+      stats.journalEntries = m_journal.size();
+      return stats;
+    }
+
+    /**
+     * \brief Merges the journal into the main file
+     *
+     * Offline operation, must not run while another process
+     * has the cache open. Corrupted entries are dropped.
+     * \param [in] path Cache file path
+     * \returns \c true on success
+     */
+    static bool compact(const std::string& path) {
+      DxvkCacheFileWriter writer;
+
+      { DxvkCacheFile cache(path);
+
+        for (uint32_t i = 0; i < cache.m_entryCount; i++) {
+          const DxvkCacheFileEntry& entry = cache.m_index[i];
+
+          if (cache.verifyEntry(i))
+            writer.add(entry.key, cache.m_data + entry.offset, entry.size);
+        }
+
+        for (const auto& e : cache.m_journal)
+          writer.add(e.first, e.second.data(), e.second.size());
+      }
+
+      if (!writer.write(path))
+        return false;
+
+      std::remove(journalPath(path).c_str());
+      return true;
+    }
+
+    static std::string journalPath(const std::string& path) {
+      return path + ".journal";
+    }
+
+  private:
+
+    enum class EntryState : uint8_t {
+      Unknown = 0,
+      Valid   = 1,
+      Corrupt = 2,
+    };
+
+    std::string                 m_path;
+
+#ifdef _WIN32
+    HANDLE                      m_fileHandle    = INVALID_HANDLE_VALUE;
+    HANDLE                      m_mappingHandle = nullptr;
+#else
+    int                         m_fd            = -1;
+#endif
+
+    const char*                 m_mapping       = nullptr;
+    size_t                      m_mappingSize   = 0;
+
+    const DxvkCacheFileEntry*   m_index         = nullptr;
+    const char*                 m_data          = nullptr;
+    uint64_t                    m_dataSize      = 0;
+    uint32_t                    m_entryCount    = 0;
+
+    std::unique_ptr<std::atomic<EntryState>[]> m_entryStates;
+
+    std::atomic<uint64_t>       m_lookups       = { 0ull };
+    std::atomic<uint64_t>       m_hits          = { 0ull };
+    std::atomic<uint64_t>       m_misses        = { 0ull };
+    std::atomic<uint64_t>       m_corrupt       = { 0ull };
+    std::atomic<uint64_t>       m_verifiedBytes = { 0ull };
+
+    std::mutex                  m_journalMutex;
+    std::ofstream               m_journalFile;
+    std::unordered_map<DxvkCacheFileKey, std::vector<char>, DxvkCacheFileKeyHash> m_journal;
+
+    const DxvkCacheFileEntry* findEntry(const DxvkCacheFileKey& key) const {
+      if (!m_index)
+        return nullptr;
+
+      const DxvkCacheFileEntry* end = m_index + m_entryCount;
+      const DxvkCacheFileEntry* entry = std::lower_bound(m_index, end, key,
+        [] (const DxvkCacheFileEntry& e, const DxvkCacheFileKey& k) { return e.key < k; });
+
+      return (entry != end && entry->key == key) ? entry : nullptr;
+    }
+
+    bool hasValidEntry(const DxvkCacheFileKey& key) {
+      const DxvkCacheFileEntry* entry = findEntry(key);
+      return entry && verifyEntry(uint32_t(entry - m_index));
+    }
+
+    bool verifyEntry(uint32_t index) {
+      EntryState state = m_entryStates[index].load(std::memory_order_acquire);
+
+      if (state == EntryState::Unknown) {
+        const DxvkCacheFileEntry& entry = m_index[index];
+
+        // Offsets come from the file, bound them without overflowing
+        bool valid = entry.offset <= m_dataSize
+          && entry.size <= m_dataSize - entry.offset
+          && DxvkCrc32c::compute(m_data + entry.offset, entry.size) == entry.crc;
+
+        // Racing threads compute the same result, so a plain store is fine
+        state = valid ? EntryState::Valid : EntryState::Corrupt;
+        m_entryStates[index].store(state, std::memory_order_release);
+        m_verifiedBytes.fetch_add(entry.size, std::memory_order_relaxed);
+      }
+
+      return state == EntryState::Valid;
+    }
+
+    void mapFile() {
+#ifdef _WIN32
+      m_fileHandle = CreateFileA(m_path.c_str(), GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+      if (m_fileHandle == INVALID_HANDLE_VALUE)
+        return;
+
+      LARGE_INTEGER fileSize;
+
+      if (!GetFileSizeEx(m_fileHandle, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(DxvkCacheFileHeader)))
+        return;
+
+      m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+      if (!m_mappingHandle)
+        return;
+
+      m_mapping = reinterpret_cast<const char*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+      m_mappingSize = size_t(fileSize.QuadPart);
+#else
+      m_fd = open(m_path.c_str(), O_RDONLY);
+
+      if (m_fd < 0)
+        return;
+
+      struct stat st;
+
+      if (fstat(m_fd, &st) || size_t(st.st_size) < sizeof(DxvkCacheFileHeader))
+        return;
+
+      void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, m_fd, 0);
+
+      if (mapping == MAP_FAILED)
+        return;
+
+      m_mapping = reinterpret_cast<const char*>(mapping);
+      m_mappingSize = size_t(st.st_size);
+#endif
+
+      if (!m_mapping)
+        return;
+
+      DxvkCacheFileHeader header;
+      std::memcpy(&header, m_mapping, sizeof(header));
+
+      bool valid = !std::memcmp(header.magic, "DXCF", 4)
+        && header.version == DxvkCacheFileWriter::Version
+        && header.dataOffset <= m_mappingSize
+        && header.dataSize <= m_mappingSize - header.dataOffset
+        && header.indexOffset <= header.dataOffset
+        && uint64_t(header.entryCount) * sizeof(DxvkCacheFileEntry) <= header.dataOffset - header.indexOffset
+        && header.indexOffset % alignof(DxvkCacheFileEntry) == 0;
+
+      if (!valid) {
+        unmapFile();
+        return;
+      }
+
+      m_index = reinterpret_cast<const DxvkCacheFileEntry*>(m_mapping + header.indexOffset);
+      m_data = m_mapping + header.dataOffset;
+      m_dataSize = header.dataSize;
+      m_entryCount = header.entryCount;
+      m_entryStates = std::make_unique<std::atomic<EntryState>[]>(m_entryCount);
+    }
+
+    void unmapFile() {
+#ifdef _WIN32
+      if (m_mapping)
+        UnmapViewOfFile(m_mapping);
+
+      if (m_mappingHandle)
+        CloseHandle(m_mappingHandle);
+
+      if (m_fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(m_fileHandle);
+
+      m_mappingHandle = nullptr;
+      m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+      if (m_mapping)
+        munmap(const_cast<char*>(m_mapping), m_mappingSize);
+
+      if (m_fd >= 0)
+        close(m_fd);
+
+      m_fd = -1;
+#endif
+
+      m_mapping = nullptr;
+      m_mappingSize = 0;
+      m_index = nullptr;
+      m_data = nullptr;
+      m_dataSize = 0;
+      m_entryCount = 0;
+    }
+
+    void loadJournal() {
+      std::ifstream file(journalPath(m_path), std::ios::binary);
+
+      if (!file)
+        return;
+
+      DxvkCacheFileJournalRecord record;
+      std::vector<char> data;
+      uint64_t validSize = 0;
+
+      // Stop at the first torn or corrupted record, everything
+      // after it was written after a crash and is not trusted
+      while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        if (std::memcmp(record.magic, "DXCJ", 4)
+         || record.headerCrc != DxvkCrc32c::compute(&record, offsetof(DxvkCacheFileJournalRecord, headerCrc)))
+          break;
+
+        data.resize(record.size);
+
+        if (!file.read(data.data(), record.size)
+         || record.crc != DxvkCrc32c::compute(data.data(), data.size()))
+          break;
+
+        validSize += sizeof(record) + record.size;
+
+        if (!hasValidEntry(record.key))
+          m_journal.emplace(record.key, data);
+      }
+
+      file.clear();
+      file.seekg(0, std::ios::end);
+      uint64_t fileSize = uint64_t(file.tellg());
+      file.close();
+
+      // Appends go to the end of the file, so cut the torn tail
+      // off first or every later record would sit behind it
+      if (fileSize > validSize)
+        truncateJournal(validSize);
+    }
+
+    bool truncateJournal(uint64_t size) {
+      std::string path = journalPath(m_path);
+
+#ifdef _WIN32
+      HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+      if (handle == INVALID_HANDLE_VALUE)
+        return false;
+
+      LARGE_INTEGER offset;
+      offset.QuadPart = LONGLONG(size);
+
+      bool success = SetFilePointerEx(handle, offset, nullptr, FILE_BEGIN)
+        && SetEndOfFile(handle);
+
+      CloseHandle(handle);
+      return success;
+#else
+      return truncate(path.c_str(), off_t(size)) == 0;
+#endif
+    }
+
+  };
+
+}
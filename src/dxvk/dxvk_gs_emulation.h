@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "dxvk_xfb_emulation.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Output topology of a geometry stage
+   *
+   * Strips are assembled into list primitives by the compute
+   * variant, so the ring is always drawn as a list.
+   */
+  enum class DxvkGsOutputTopology : uint32_t {
+    PointList,
+    LineStrip,
+    TriangleStrip,
+  };
+
+
+  inline uint32_t dxvkGsVerticesPerPrimitive(DxvkGsOutputTopology topology) {
+    switch (topology) {
+      case DxvkGsOutputTopology::PointList:     return 1;
+      case DxvkGsOutputTopology::LineStrip:     return 2;
+      case DxvkGsOutputTopology::TriangleStrip: return 3;
+    }
+
+    return 1;
+  }
+
+
+  /**
+   * \brief List vertices a stage invocation can produce
+   *
+   * A strip of \c n vertices makes \c n-2 triangles or \c n-1 lines,
+   * and cutting a strip never adds primitives, so this bounds the
+   * output of \c [maxvertexcount(n)] after strip assembly.
+   */
+  inline uint32_t dxvkGsMaxListVertices(DxvkGsOutputTopology topology, uint32_t maxVertexCount) {
+    uint32_t n = dxvkGsVerticesPerPrimitive(topology);
+
+    if (maxVertexCount < n)
+      return 0;
+
+    return (maxVertexCount - n + 1) * n;
+  }
+
+
+  /**
+   * \brief Geometry stage properties
+   *
+   * Filled in by the shader compiler.
+   */
+  struct DxvkGsInfo {
+    DxvkGsOutputTopology outputTopology = DxvkGsOutputTopology::TriangleStrip;
+    uint32_t maxVertexCount = 0;      ///< \c [maxvertexcount(n)]
+    uint32_t instanceCount  = 1;      ///< \c [instance(n)]
+    uint32_t outputStride   = 0;      ///< Bytes per output vertex in the ring
+    bool     copiesInput    = false;  ///< Emits its input vertices once, in order, unchanged
+    bool     exportsLayer   = false;  ///< Writes the layer or viewport index
+  };
+
+
+  struct DxvkGsDrawInfo {
+    DxvkXfbTopology topology      = DxvkXfbTopology::TriangleList;
+    uint32_t        vertexCount   = 0;      ///< Vertices or indices per instance
+    uint32_t        instanceCount = 1;
+    bool            indirect      = false;
+  };
+
+
+  enum class DxvkGsPath : uint32_t {
+    Passthrough,  ///< Draw without the stage, no compute pass
+    Compute,      ///< Compute pre-pass into the ring, indirect draw
+    Unsupported,  ///< Draw is skipped
+  };
+
+
+  /**
+   * \brief Emulation options
+   */
+  struct DxvkGsOptions {
+    /// Size of the output ring in bytes. The ring is drawn as a
+    /// vertex buffer, one reservation per batch.
+    uint32_t  ringSize      = 16u << 20;
+    /// Size of the scratch buffer the stage writes uncompacted
+    /// output to. Bounds the input primitives of a batch.
+    uint32_t  scratchSize   = 4u << 20;
+    /// Whether the vertex stage can write the layer and viewport
+    /// index, i.e. \c shaderOutputLayer and \c shaderOutputViewportIndex
+    bool      vertexLayerOutput = false;
+  };
+
+
+  /**
+   * \brief Prefix sum block size
+   *
+   * The scan sums the counts of \c DxvkGsScanBlockSize primitives
+   * per invocation, then scans the block sums in one invocation,
+   * so a batch has at most \c DxvkGsMaxScanBlocks blocks.
+   */
+  constexpr uint32_t DxvkGsScanBlockSize = 64;
+  constexpr uint32_t DxvkGsMaxScanBlocks = 4096;
+
+
+  /**
+   * \brief One compute pre-pass and indirect draw
+   *
+   * Input primitives are flattened across draw instances and stage
+   * instances, see \ref DxvkGsEmulation::getPrimitive.
+   */
+  struct DxvkGsBatch {
+    uint32_t firstPrimitive = 0;
+    uint32_t primitiveCount = 0;
+    uint32_t blockCount     = 0;      ///< Scan blocks
+    uint32_t ringOffset     = 0;      ///< Byte offset of the reserved range
+    uint32_t firstVertex    = 0;      ///< \c ringOffset in vertices
+    bool     barrier        = false;  ///< Range was drawn earlier in the same command list
+  };
+
+
+  struct DxvkGsPrimitive {
+    uint32_t instance   = 0;  ///< Draw instance
+    uint32_t primitive  = 0;  ///< Input primitive within the instance
+    uint32_t gsInstance = 0;  ///< Stage instance
+  };
+
+
+  /**
+   * \brief Emulation statistics
+   */
+  struct DxvkGsStats {
+    uint64_t passthroughDraws = 0;
+    uint64_t computeDraws     = 0;
+    uint64_t skippedDraws     = 0;  ///< Unsupported
+    uint64_t batches          = 0;
+    uint64_t wraps            = 0;  ///< Ring wrapped around
+    uint64_t stalls           = 0;  ///< Waited for a range still in use
+  };
+
+
+  /**
+   * \brief Geometry stage emulation
+   *
+   * MoltenVK has no geometry shaders. For a draw with a geometry
+   * stage, the vertex and geometry stages are compiled into one
+   * compute variant with one invocation per input primitive. The
+   * variant fetches the primitive's vertices in draw order (see
+   * \ref dxvkXfbPrimitiveVertex), runs the vertex stage on each,
+   * then the geometry stage, assembling emitted strips into list
+   * primitives. It stores up to \c slotVertices list vertices to
+   * the primitive's slot in the scratch buffer and their number to
+   * a count buffer.
+   *
+   * D3D requires the output in input primitive order, so the slots
+   * are compacted rather than appended with atomics:
+   *
+   * 1. One invocation per scan block sums the block's counts.
+   * 2. One invocation scans the block sums and writes the indirect
+   *    draw arguments: the total as vertex count, \c firstVertex.
+   * 3. One invocation per primitive adds the counts before it in
+   *    its block to the block's offset and copies its vertices to
+   *    the reserved ring range.
+   *
+   * The ring is then drawn as a list with \c vkCmdDrawIndirect and
+   * a vertex stage that only forwards the stored outputs.
+   *
+   * A stage that emits its input primitive unchanged is dropped
+   * instead, and the draw goes through as is. Layered output needs
+   * the vertex stage to write the layer, and indirect draws would
+   * need the batches planned on the GPU; both are unsupported for
+   * now and the draw is skipped.
+   *
+   * Ring ranges are reserved for the worst case, since the actual
+   * counts are only known on the GPU. Ranges are tracked with the
+   * sequence number of the command list that draws them, like the
+   * other rings. Reusing a range still in flight waits for it, or,
+   * if the same command list drew it, needs a barrier between that
+   * draw and the pre-pass.
+   *
+   * Not thread-safe, used from the CS thread only.
+   */
+  class DxvkGsEmulation {
+
+  public:
+
+    using IsDoneFn  = std::function<bool (uint64_t sequence)>;
+    using WaitFn    = std::function<void (uint64_t sequence)>;
+
+    DxvkGsEmulation(
+      const DxvkGsOptions& options,
+            IsDoneFn       isDone,
+            WaitFn         wait)
+    : m_options (options),
+      m_isDone  (std::move(isDone)),
+      m_wait    (std::move(wait)) { }
+
+    /**
+     * \brief Picks how to run a draw
+     *
+     * \param [in] gs Stage properties
+     * \param [in] draw Draw parameters
+     */
+    DxvkGsPath selectPath(const DxvkGsInfo& gs, const DxvkGsDrawInfo& draw) const {
+      if (gs.copiesInput && gs.instanceCount == 1 && !gs.exportsLayer
+       && gs.maxVertexCount >= dxvkXfbVerticesPerPrimitive(draw.topology)
+       && dxvkGsVerticesPerPrimitive(gs.outputTopology) == dxvkXfbVerticesPerPrimitive(draw.topology))
+        return DxvkGsPath::Passthrough;
+
+      if (draw.indirect || (gs.exportsLayer && !m_options.vertexLayerOutput))
+        return DxvkGsPath::Unsupported;
+
+      uint32_t slotBytes = getSlotVertices(gs) * gs.outputStride;
+
+      if (!slotBytes || slotBytes > m_options.scratchSize || slotBytes > m_options.ringSize)
+        return DxvkGsPath::Unsupported;
+
+      return DxvkGsPath::Compute;
+    }
+
+    /**
+     * \brief Scratch slot size of one input primitive
+     *
+     * \param [in] gs Stage properties
+     * \returns List vertices per slot
+     */
+    uint32_t getSlotVertices(const DxvkGsInfo& gs) const {
+      return dxvkGsMaxListVertices(gs.outputTopology, gs.maxVertexCount);
+    }
+
+    /**
+     * \brief Input primitives of one batch
+     *
+     * \param [in] gs Stage properties
+     */
+    uint32_t getBatchLimit(const DxvkGsInfo& gs) const {
+      uint32_t slotBytes = getSlotVertices(gs) * gs.outputStride;
+
+      if (!slotBytes)
+        return 0;
+
+      return std::min({
+        m_options.scratchSize / slotBytes,
+        m_options.ringSize / slotBytes,
+        DxvkGsScanBlockSize * DxvkGsMaxScanBlocks });
+    }
+
+    /**
+     * \brief Maps a flattened primitive index
+     *
+     * Stage instances of a primitive are adjacent, and primitives
+     * of a draw instance are adjacent, which is the order D3D
+     * draws the output in.
+     * \param [in] gs Stage properties
+     * \param [in] draw Draw parameters
+     * \param [in] index Flattened index
+     */
+    DxvkGsPrimitive getPrimitive(const DxvkGsInfo& gs, const DxvkGsDrawInfo& draw, uint32_t index) const {
+      uint32_t primitives = dxvkXfbPrimitiveCount(draw.topology, draw.vertexCount);
+      uint32_t instances = std::max(gs.instanceCount, 1u);
+
+      DxvkGsPrimitive result;
+      result.gsInstance = index % instances;
+      result.primitive  = primitives ? (index / instances) % primitives : 0;
+      result.instance   = primitives ? index / (instances * primitives) : 0;
+      return result;
+    }
+
+    /**
+     * \brief Plans a draw
+     *
+     * \param [in] gs Stage properties
+     * \param [in] draw Draw parameters
+     * \param [in] sequence Sequence number of the command list being
+     *    recorded, which draws the reserved ring ranges
+     * \param [out] batches Batches to record, in order. Empty unless
+     *    the path is \c Compute and the draw has primitives.
+     * \returns Path to take
+     */
+    DxvkGsPath draw(
+      const DxvkGsInfo&               gs,
+      const DxvkGsDrawInfo&           draw,
+            uint64_t                  sequence,
+            std::vector<DxvkGsBatch>& batches) {
+      batches.clear();
+
+      DxvkGsPath path = selectPath(gs, draw);
+
+      if (path == DxvkGsPath::Passthrough) {
+        m_stats.passthroughDraws += 1;
+        return path;
+      }
+
+      if (path == DxvkGsPath::Unsupported) {
+        m_stats.skippedDraws += 1;
+        return path;
+      }
+
+      m_stats.computeDraws += 1;
+
+      uint32_t total = dxvkXfbPrimitiveCount(draw.topology, draw.vertexCount)
+                     * draw.instanceCount * gs.instanceCount;
+      uint32_t limit = getBatchLimit(gs);
+      uint32_t slotBytes = getSlotVertices(gs) * gs.outputStride;
+
+      for (uint32_t first = 0; first < total; first += limit) {
+        DxvkGsBatch& batch = batches.emplace_back();
+        batch.firstPrimitive = first;
+        batch.primitiveCount = std::min(limit, total - first);
+        batch.blockCount = (batch.primitiveCount + DxvkGsScanBlockSize - 1) / DxvkGsScanBlockSize;
+        batch.barrier = reserve(batch.primitiveCount * slotBytes, gs.outputStride, sequence, batch.ringOffset);
+        batch.firstVertex = batch.ringOffset / gs.outputStride;
+      }
+
+      m_stats.batches += batches.size();
+      return path;
+    }
+
+    DxvkGsStats getStats() const {
+      return m_stats;
+    }
+
+  private:
+
+    struct Range {
+      uint32_t begin;
+      uint32_t end;
+      uint64_t sequence;
+    };
+
+    DxvkGsOptions     m_options;
+
+    IsDoneFn          m_isDone;
+    WaitFn            m_wait;
+
+    std::deque<Range> m_inFlight;
+    uint32_t          m_head = 0;
+
+    DxvkGsStats       m_stats;
+
+    /**
+     * \brief Reserves a ring range
+     *
+     * \returns \c true if the range overlaps one drawn by the same
+     *    command list, which needs a barrier instead of a wait
+     */
+    bool reserve(uint32_t size, uint32_t stride, uint64_t sequence, uint32_t& offset) {
+      // The ring is drawn with firstVertex, so ranges start on a vertex
+      uint32_t begin = ((m_head + stride - 1) / stride) * stride;
+
+      if (begin + size > m_options.ringSize) {
+        begin = 0;
+        m_stats.wraps += 1;
+      }
+
+      uint32_t end = begin + size;
+
+      bool     barrier = false;
+      bool     stall   = false;
+      uint64_t wait    = 0;
+
+      for (const Range& r : m_inFlight) {
+        if (r.begin >= end || r.end <= begin)
+          continue;
+
+        if (r.sequence == sequence) {
+          barrier = true;
+        } else {
+          stall = true;
+          wait  = std::max(wait, r.sequence);
+        }
+      }
+
+      // Command lists complete in order, so waiting for the newest
+      // overlapping one frees all of them
+      if (stall && !m_isDone(wait)) {
+        m_wait(wait);
+        m_stats.stalls += 1;
+      }
+
+      m_inFlight.erase(std::remove_if(m_inFlight.begin(), m_inFlight.end(),
+        [&] (const Range& r) {
+          bool overlaps = r.begin < end && r.end > begin;
+          return overlaps || (r.sequence != sequence && m_isDone(r.sequence));
+        }), m_inFlight.end());
+
+      m_inFlight.push_back({ begin, end, sequence });
+      m_head = end;
+
+      offset = begin;
+      return barrier;
+    }
+
+  };
+
+}
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Set of bindings within one descriptor set
+   */
+  class DxvkBindingMask {
+
+  public:
+
+    static constexpr uint32_t MaxBindings = 256;
+
+    void set(uint32_t binding) {
+      if (binding < MaxBindings)
+        m_bits[binding / 64] |= uint64_t(1) << (binding % 64);
+    }
+
+    void clr(uint32_t binding) {
+      if (binding < MaxBindings)
+        m_bits[binding / 64] &= ~(uint64_t(1) << (binding % 64));
+    }
+
+    bool test(uint32_t binding) const {
+      return binding < MaxBindings
+        && ((m_bits[binding / 64] >> (binding % 64)) & 1);
+    }
+
+    bool any() const {
+      return (m_bits[0] | m_bits[1] | m_bits[2] | m_bits[3]) != 0;
+    }
+
+    uint32_t count() const {
+      uint32_t n = 0;
+
+      for (uint64_t word : m_bits) {
+        for ( ; word; word &= word - 1)
+          n++;
+      }
+
+      return n;
+    }
+
+    DxvkBindingMask operator & (const DxvkBindingMask& other) const {
+      DxvkBindingMask result;
+      for (uint32_t i = 0; i < 4; i++)
+        result.m_bits[i] = m_bits[i] & other.m_bits[i];
+      return result;
+    }
+
+    DxvkBindingMask operator | (const DxvkBindingMask& other) const {
+      DxvkBindingMask result;
+      for (uint32_t i = 0; i < 4; i++)
+        result.m_bits[i] = m_bits[i] | other.m_bits[i];
+      return result;
+    }
+
+    bool operator == (const DxvkBindingMask& other) const {
+      return m_bits == other.m_bits;
+    }
+
+    bool operator != (const DxvkBindingMask& other) const {
+      return m_bits != other.m_bits;
+    }
+
+  private:
+
+    std::array<uint64_t, 4> m_bits = { };
+
+  };
+
+
+  /**
+   * \brief Resource variable of a SPIR-V module
+   */
+  struct DxvkSpirvBinding {
+    uint32_t varId;
+    uint32_t storageClass;
+    uint32_t set;
+    uint32_t binding;
+    bool     used;
+  };
+
+
+  /**
+   * \brief Resource bindings of a SPIR-V module
+   */
+  struct DxvkSpirvBindingUsage {
+    static constexpr uint32_t MaxSets = 4;
+
+    bool                          valid   = false;
+    uint32_t                      removed = 0;  ///< Variables removed from the module
+    std::vector<DxvkSpirvBinding> bindings;
+    std::array<DxvkBindingMask, MaxSets> declared;
+    std::array<DxvkBindingMask, MaxSets> used;
+
+    bool isDeclared(uint32_t set, uint32_t binding) const {
+      return set < MaxSets && declared[set].test(binding);
+    }
+
+    bool isUsed(uint32_t set, uint32_t binding) const {
+      return set < MaxSets && used[set].test(binding);
+    }
+  };
+
+
+  /**
+   * \brief Removes unused resource variables from SPIR-V
+   *
+   * Post-compile pass over modules produced by DxsoCompiler and the
+   * fixed function generator. A UniformConstant, Uniform or
+   * StorageBuffer variable with a binding decoration is unused if
+   * its id appears in no instruction other than its declaration,
+   * its names, its decorations and entry point interfaces. Those
+   * are removed together with the variable; the types it used stay,
+   * they cost nothing once translated.
+   *
+   * Literal operands are not told apart from ids, so a literal that
+   * happens to equal the id keeps a variable alive. That only ever
+   * keeps too much.
+   *
+   * Only the module is changed. The compiler still lists pruned
+   * bindings in \c m_bindings and the device still writes their
+   * descriptors; \c used tells which ones it could skip.
+   */
+  class DxvkSpirvBindingPruner {
+
+  public:
+
+    static constexpr uint32_t Magic = 0x07230203;
+
+    /**
+     * \brief Prunes unused bindings in place
+     *
+     * Invalid modules are left alone.
+     * \param [in,out] code SPIR-V words
+     * \returns Declared and used bindings
+     */
+    static DxvkSpirvBindingUsage prune(std::vector<uint32_t>& code) {
+      DxvkSpirvBindingUsage usage;
+
+      if (code.size() < HeaderWords || code[0] != Magic || !walk(code, [] (uint32_t, const uint32_t*, uint32_t) { }))
+        return usage;
+
+      usage.valid = true;
+
+      // Resource variables and their bindings
+      std::unordered_map<uint32_t, DxvkSpirvBinding> vars;
+      std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> decorations;
+
+      walk(code, [&] (uint32_t op, const uint32_t* w, uint32_t n) {
+        if (op == OpVariable && n >= 4 && isResourceClass(w[3]))
+          vars[w[2]] = { w[2], w[3], 0, 0, false };
+
+        if (op == OpDecorate && n >= 4) {
+          auto& d = decorations[w[1]];
+          if (w[2] == DecorationDescriptorSet) d.first  = w[3];
+          if (w[2] == DecorationBinding)       d.second = w[3] + 1;
+        }
+      });
+
+      for (auto i = vars.begin(); i != vars.end(); ) {
+        auto d = decorations.find(i->first);
+
+        if (d == decorations.end() || !d->second.second) {
+          i = vars.erase(i);
+        } else {
+          i->second.set     = d->second.first;
+          i->second.binding = d->second.second - 1;
+          ++i;
+        }
+      }
+
+      // Any other mention of a variable id is a use
+      walk(code, [&] (uint32_t op, const uint32_t* w, uint32_t n) {
+        uint32_t first = 1;
+
+        switch (op) {
+          case OpName:
+          case OpDecorate:
+          case OpDecorateId:
+          case OpDecorateString:
+            return;
+
+          case OpEntryPoint:
+            // Interface ids are a declaration, not a use
+            return;
+
+          case OpVariable:
+            if (vars.count(w[2]))
+              first = 3;
+            break;
+
+          case OpSource:
+          case OpSourceExtension:
+          case OpString:
+          case OpExtension:
+          case OpExtInstImport:
+          case OpModuleProcessed:
+            return;
+        }
+
+        for (uint32_t i = first; i < n; i++) {
+          auto v = vars.find(w[i]);
+
+          if (v != vars.end())
+            v->second.used = true;
+        }
+      });
+
+      std::unordered_set<uint32_t> dead;
+
+      for (const auto& v : vars) {
+        const DxvkSpirvBinding& b = v.second;
+
+        if (b.set < DxvkSpirvBindingUsage::MaxSets) {
+          usage.declared[b.set].set(b.binding);
+
+          if (b.used)
+            usage.used[b.set].set(b.binding);
+        }
+
+        if (!b.used)
+          dead.insert(b.varId);
+
+        usage.bindings.push_back(b);
+      }
+
+      std::sort(usage.bindings.begin(), usage.bindings.end(),
+        [] (const DxvkSpirvBinding& a, const DxvkSpirvBinding& b) {
+          return a.set != b.set ? a.set < b.set
+               : (a.binding != b.binding ? a.binding < b.binding : a.varId < b.varId);
+        });
+
+      if (dead.empty())
+        return usage;
+
+      // Rewrite the module without the dead variables
+      std::vector<uint32_t> result(code.begin(), code.begin() + HeaderWords);
+      result.reserve(code.size());
+
+      walk(code, [&] (uint32_t op, const uint32_t* w, uint32_t n) {
+        switch (op) {
+          case OpName:
+          case OpDecorate:
+          case OpDecorateId:
+          case OpDecorateString:
+            if (n >= 2 && dead.count(w[1]))
+              return;
+            break;
+
+          case OpVariable:
+            if (n >= 3 && dead.count(w[2])) {
+              usage.removed += 1;
+              return;
+            }
+            break;
+
+          case OpEntryPoint: {
+            size_t start = result.size();
+            uint32_t interfaceStart = entryPointInterface(w, n);
+
+            result.insert(result.end(), w, w + interfaceStart);
+
+            for (uint32_t i = interfaceStart; i < n; i++) {
+              if (!dead.count(w[i]))
+                result.push_back(w[i]);
+            }
+
+            uint32_t count = uint32_t(result.size() - start);
+            result[start] = (count << 16) | op;
+          } return;
+        }
+
+        result.insert(result.end(), w, w + n);
+      });
+
+      code = std::move(result);
+      return usage;
+    }
+
+  private:
+
+    static constexpr uint32_t HeaderWords = 5;
+
+    static constexpr uint32_t OpSource            = 3;
+    static constexpr uint32_t OpSourceExtension   = 4;
+    static constexpr uint32_t OpName              = 5;
+    static constexpr uint32_t OpString            = 7;
+    static constexpr uint32_t OpExtension         = 10;
+    static constexpr uint32_t OpExtInstImport     = 11;
+    static constexpr uint32_t OpEntryPoint        = 15;
+    static constexpr uint32_t OpVariable          = 59;
+    static constexpr uint32_t OpDecorate          = 71;
+    static constexpr uint32_t OpModuleProcessed   = 330;
+    static constexpr uint32_t OpDecorateId        = 332;
+    static constexpr uint32_t OpDecorateString    = 5632;
+
+    static constexpr uint32_t DecorationBinding       = 33;
+    static constexpr uint32_t DecorationDescriptorSet = 34;
+
+    static constexpr uint32_t StorageClassUniformConstant = 0;
+    static constexpr uint32_t StorageClassUniform         = 2;
+    static constexpr uint32_t StorageClassStorageBuffer   = 12;
+
+    static bool isResourceClass(uint32_t storageClass) {
+      return storageClass == StorageClassUniformConstant
+          || storageClass == StorageClassUniform
+          || storageClass == StorageClassStorageBuffer;
+    }
+
+    /* Calls fn(opcode, words, wordCount) for every instruction,
+     * returns false if an instruction is truncated */
+    template<typename Fn>
+    static bool walk(const std::vector<uint32_t>& code, Fn&& fn) {
+      size_t pos = HeaderWords;
+
+      while (pos < code.size()) {
+        uint32_t count = code[pos] >> 16;
+
+        if (!count || pos + count > code.size())
+          return false;
+
+        fn(code[pos] & 0xffff, &code[pos], count);
+        pos += count;
+      }
+
+      return true;
+    }
+
+    /* OpEntryPoint model, function, name string, interface ids */
+    static uint32_t entryPointInterface(const uint32_t* w, uint32_t n) {
+      uint32_t i = 3;
+
+      while (i < n) {
+        uint32_t word = w[i++];
+
+        if (!(word & 0xff000000u))
+          break;
+      }
+
+      return std::min(i, n);
+    }
+
+  };
+
+}
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace dxvk {
+
+  /**
+   * \brief Primitive topology of a captured draw
+   *
+   * Transform feedback writes every primitive as an independent
+   * list primitive, so strips and fans only matter for which
+   * vertices make up a primitive.
+   */
+  enum class DxvkXfbTopology : uint32_t {
+    PointList,
+    LineList,
+    LineStrip,
+    TriangleList,
+    TriangleStrip,
+    TriangleFan,
+  };
+
+
+  inline uint32_t dxvkXfbVerticesPerPrimitive(DxvkXfbTopology topology) {
+    switch (topology) {
+      case DxvkXfbTopology::PointList:     return 1;
+      case DxvkXfbTopology::LineList:
+      case DxvkXfbTopology::LineStrip:     return 2;
+      case DxvkXfbTopology::TriangleList:
+      case DxvkXfbTopology::TriangleStrip:
+      case DxvkXfbTopology::TriangleFan:   return 3;
+    }
+
+    return 1;
+  }
+
+
+  inline uint32_t dxvkXfbPrimitiveCount(DxvkXfbTopology topology, uint32_t vertexCount) {
+    switch (topology) {
+      case DxvkXfbTopology::PointList:     return vertexCount;
+      case DxvkXfbTopology::LineList:      return vertexCount / 2;
+      case DxvkXfbTopology::LineStrip:     return vertexCount >= 2 ? vertexCount - 1 : 0;
+      case DxvkXfbTopology::TriangleList:  return vertexCount / 3;
+      case DxvkXfbTopology::TriangleStrip:
+      case DxvkXfbTopology::TriangleFan:   return vertexCount >= 3 ? vertexCount - 2 : 0;
+    }
+
+    return 0;
+  }
+
+
+  /**
+   * \brief Draw order index of a captured vertex
+   *
+   * Index into the vertex (or index buffer) sequence of vertex
+   * \c k of primitive \c p, in the order the primitive is written.
+   * Follows the Vulkan vertex order: odd strip triangles swap their
+   * last two vertices to keep the winding, fan triangle \c p is
+   * \c (p+1, p+2, 0).
+   */
+  inline uint32_t dxvkXfbPrimitiveVertex(DxvkXfbTopology topology, uint32_t p, uint32_t k) {
+    switch (topology) {
+      case DxvkXfbTopology::PointList:     return p;
+      case DxvkXfbTopology::LineList:      return 2 * p + k;
+      case DxvkXfbTopology::LineStrip:     return p + k;
+      case DxvkXfbTopology::TriangleList:  return 3 * p + k;
+      case DxvkXfbTopology::TriangleStrip: return p + (k && (p & 1) ? 3 - k : k);
+      case DxvkXfbTopology::TriangleFan:   return k == 2 ? 0 : p + k + 1;
+    }
+
+    return p;
+  }
+
+
+  constexpr uint32_t MaxNumXfbBuffers = 4;
+
+  /**
+   * \brief How the emulated stage finds its output slot
+   *
+   * \c Direct writes primitive \c p to slot \c p, which is correct
+   * whenever every input primitive produces exactly one output
+   * primitive. \c Atomic reserves slots with an atomic add, for
+   * geometry stages that emit a varying number of primitives.
+   */
+  enum class DxvkXfbEmulationMode : uint32_t {
+    Direct,
+    Atomic,
+  };
+
+
+  /**
+   * \brief Transform feedback counter value
+   *
+   * What a counter buffer holds after \c vkCmdEndTransformFeedbackEXT.
+   * Known when every draw of the section was resolved on the CPU,
+   * otherwise the offset only exists in the GPU state buffer.
+   */
+  struct DxvkXfbCounter {
+    bool     known  = false;
+    uint32_t offset = 0;
+  };
+
+
+  struct DxvkXfbDrawInfo {
+    DxvkXfbTopology topology      = DxvkXfbTopology::TriangleList;
+    uint32_t        vertexCount   = 0;      ///< Vertices or indices per instance
+    uint32_t        instanceCount = 1;
+    bool            indirect      = false;  ///< Counts live in a GPU buffer
+    uint32_t        geometryVertices = 0;   ///< Vertices per emitted primitive, 0 without a geometry stage
+  };
+
+
+  /**
+   * \brief Arguments of one emulated draw
+   *
+   * Push constants of the emulation variant, plus what the context
+   * records around the dispatch.
+   */
+  struct DxvkXfbDrawArgs {
+    DxvkXfbEmulationMode mode = DxvkXfbEmulationMode::Direct;
+    uint32_t primitiveCount   = 0;  ///< Input primitives, 0 for indirect draws
+    uint32_t primitiveVertices = 1; ///< Vertices per written primitive
+    uint32_t primitiveLimit   = 0;  ///< Primitives that fit, CPU resolved draws only
+    std::array<uint32_t, MaxNumXfbBuffers> offsets = { };  ///< Byte offsets of slot 0
+    bool     upload           = false;  ///< Write \c offsets to the GPU state first
+    bool     resolve          = false;  ///< Counts are resolved on the GPU
+  };
+
+
+  struct DxvkXfbQueryResult {
+    uint64_t primitivesWritten = 0;
+    uint64_t primitivesNeeded  = 0;
+    bool     gpu               = false;  ///< Add the GPU state delta
+  };
+
+
+  /**
+   * \brief Transform feedback emulation state
+   *
+   * Tracks what \c VK_EXT_transform_feedback would track when the
+   * device does not have it. The vertex stage is compiled into a
+   * compute variant with one invocation per input primitive: it
+   * fetches the primitive's vertices in draw order, runs the stage
+   * and stores the outputs to the bound buffers with storage buffer
+   * writes at
+   *
+   *   offsets[b] + (slot * primitiveVertices + k) * stride[b]
+   *
+   * A primitive is written only if it fits in every bound buffer,
+   * like native transform feedback, but always counts as needed.
+   *
+   * Most draws are resolved here: without a geometry stage, slot
+   * equals the primitive index, so offsets, the number of primitives
+   * that fit and the query counts are all known on the CPU and the
+   * variant gets them as push constants. Indirect draws, geometry
+   * stages and draws after such a draw keep their offsets and counts
+   * in a GPU state buffer instead:
+   *
+   *   struct { uint offsets[4]; uint written; uint needed; uint drawNeeded; }
+   *
+   * Every invocation adds its emitted primitive count to
+   * \c drawNeeded; in \c Atomic mode the value returned is its slot.
+   * A one-invocation resolve dispatch after the draw writes
+   * min(drawNeeded, limit) primitives into the offsets and counts.
+   * Since slots are handed out in order, the primitives written are
+   * always the first ones reserved.
+   *
+   * Only stream 0 is emulated.
+   */
+  class DxvkXfbEmulation {
+
+  public:
+
+    /**
+     * \brief Binds a buffer range
+     *
+     * \param [in] index Buffer index
+     * \param [in] size Range size in bytes
+     * \param [in] stride Vertex stride of the stage's outputs to
+     *    this buffer, 0 if the stage writes nothing to it
+     */
+    void bindBuffer(uint32_t index, uint32_t size, uint32_t stride) {
+      if (index < MaxNumXfbBuffers) {
+        m_buffers[index].size   = size;
+        m_buffers[index].stride = stride;
+      }
+    }
+
+    /**
+     * \brief Begins or resumes capture
+     *
+     * Buffers without a counter start at offset 0.
+     * \param [in] count Number of counters
+     * \param [in] counters Counter values, may be \c nullptr
+     * \returns \c true if a counter is only known on the GPU, in
+     *    which case the counter buffers are copied to the state
+     */
+    bool begin(uint32_t count, const DxvkXfbCounter* counters) {
+      m_active = true;
+      m_gpuOffsets = false;
+
+      for (uint32_t i = 0; i < MaxNumXfbBuffers; i++) {
+        m_buffers[i].offset = 0;
+
+        if (counters && i < count) {
+          m_buffers[i].offset = counters[i].offset;
+          m_gpuOffsets |= !counters[i].known;
+        }
+      }
+
+      return m_gpuOffsets;
+    }
+
+    /**
+     * \brief Ends or pauses capture
+     *
+     * \param [in] count Number of counters
+     * \param [out] counters Counter values to store, may be \c nullptr
+     */
+    void end(uint32_t count, DxvkXfbCounter* counters) {
+      for (uint32_t i = 0; counters && i < count && i < MaxNumXfbBuffers; i++) {
+        counters[i].known  = !m_gpuOffsets;
+        counters[i].offset = m_gpuOffsets ? 0 : m_buffers[i].offset;
+      }
+
+      m_active = false;
+    }
+
+    bool isActive() const {
+      return m_active;
+    }
+
+    uint32_t getOffset(uint32_t index) const {
+      return m_buffers[index].offset;
+    }
+
+    /**
+     * \brief Plans a draw
+     *
+     * \param [in] info Draw parameters
+     * \returns Variant arguments
+     */
+    DxvkXfbDrawArgs draw(const DxvkXfbDrawInfo& info) {
+      DxvkXfbDrawArgs args;
+
+      if (!m_active)
+        return args;
+
+      if (!info.indirect) {
+        args.primitiveCount = dxvkXfbPrimitiveCount(info.topology, info.vertexCount)
+                            * info.instanceCount;
+      }
+
+      args.primitiveVertices = info.geometryVertices
+        ? info.geometryVertices
+        : dxvkXfbVerticesPerPrimitive(info.topology);
+
+      if (info.geometryVertices)
+        args.mode = DxvkXfbEmulationMode::Atomic;
+
+      for (uint32_t i = 0; i < MaxNumXfbBuffers; i++)
+        args.offsets[i] = m_buffers[i].offset;
+
+      if (info.indirect || info.geometryVertices || m_gpuOffsets) {
+        args.upload  = !m_gpuOffsets;
+        args.resolve = true;
+
+        m_gpuOffsets = true;
+        m_gpuDraws  += 1;
+        return args;
+      }
+
+      uint32_t limit = getPrimitiveLimit(args.primitiveVertices);
+      uint32_t written = std::min(args.primitiveCount, limit);
+
+      for (auto& buffer : m_buffers)
+        buffer.offset += written * args.primitiveVertices * buffer.stride;
+
+      m_written += written;
+      m_needed  += args.primitiveCount;
+
+      args.primitiveLimit = written;
+      return args;
+    }
+
+    /**
+     * \brief Primitives that still fit
+     *
+     * The smallest number of whole primitives any buffer the stage
+     * writes has room for. The resolve dispatch computes the same
+     * from the GPU state.
+     * \param [in] vertices Vertices per primitive
+     */
+    uint32_t getPrimitiveLimit(uint32_t vertices) const {
+      uint32_t limit = ~0u;
+
+      for (const auto& buffer : m_buffers) {
+        if (!buffer.stride)
+          continue;
+
+        uint32_t space = buffer.size > buffer.offset ? buffer.size - buffer.offset : 0;
+        limit = std::min(limit, space / (vertices * buffer.stride));
+      }
+
+      return limit;
+    }
+
+    void beginQuery() {
+      m_queryWritten  = m_written;
+      m_queryNeeded   = m_needed;
+      m_queryGpuDraws = m_gpuDraws;
+    }
+
+    /**
+     * \brief Ends a primitives written query
+     *
+     * If a draw since \c beginQuery was resolved on the GPU, the
+     * difference of the GPU state counts copied at begin and end
+     * has to be added to the result.
+     */
+    DxvkXfbQueryResult endQuery() const {
+      DxvkXfbQueryResult result;
+      result.primitivesWritten = m_written - m_queryWritten;
+      result.primitivesNeeded  = m_needed  - m_queryNeeded;
+      result.gpu               = m_gpuDraws != m_queryGpuDraws;
+      return result;
+    }
+
+  private:
+
+    struct Buffer {
+      uint32_t size   = 0;
+      uint32_t stride = 0;
+      uint32_t offset = 0;
+    };
+
+    std::array<Buffer, MaxNumXfbBuffers> m_buffers;
+
+    bool     m_active     = false;
+    bool     m_gpuOffsets = false;
+
+    uint64_t m_written    = 0;
+    uint64_t m_needed     = 0;
+    uint32_t m_gpuDraws   = 0;
+
+    uint64_t m_queryWritten  = 0;
+    uint64_t m_queryNeeded   = 0;
+    uint32_t m_queryGpuDraws = 0;
+
+  };
+
+}
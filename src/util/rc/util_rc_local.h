@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Local reference table statistics
+   */
+  struct RcLocalStats {
+    uint64_t acquires   = 0;  ///< Local references taken
+    uint64_t releases   = 0;  ///< Local references dropped
+    uint64_t atomicIncs = 0;  ///< incRef calls on the objects
+    uint64_t atomicDecs = 0;  ///< decRef calls on the objects
+    uint32_t objects    = 0;  ///< Objects currently in the table
+    uint32_t retired    = 0;  ///< Objects waiting for their epoch
+  };
+
+
+  /**
+   * \brief Thread-owned reference table
+   *
+   * Binding a resource on the CS thread copies an \c Rc, and
+   * replacing the binding releases one, so every bind costs two
+   * atomic operations on a reference count that the game thread
+   * may be touching at the same time.
+   *
+   * The table instead holds one real reference per object and
+   * counts binding references with plain integers. It is owned by
+   * a single thread and must not be shared:
+   *
+   * - \ref acquire takes the real reference the first time an object
+   *   is seen and only increments the local count after that.
+   * - \ref release only decrements the local count. Objects whose
+   *   count dropped to zero stay in the table, so rebinding them is
+   *   still free.
+   * - \ref reconcile, called once per CS chunk or submission, moves
+   *   unreferenced objects to a retire list tagged with an epoch.
+   * - \ref retire drops the real reference of objects whose epoch
+   *   has completed, e.g. once the submission's fence signaled.
+   *
+   * \tparam T Object type with DXVK's \c RcObject interface, i.e.
+   *    \c incRef and a \c decRef that returns the new count
+   */
+  template<typename T>
+  class RcLocalTable {
+
+  public:
+
+    RcLocalTable()
+    : m_entries(InitialCapacity) { }
+
+    ~RcLocalTable() {
+      for (const Entry& e : m_entries) {
+        if (e.object)
+          decRef(e.object);
+      }
+
+      for (const auto& r : m_retired)
+        decRef(r.second);
+    }
+
+    RcLocalTable             (const RcLocalTable&) = delete;
+    RcLocalTable& operator = (const RcLocalTable&) = delete;
+
+    /**
+     * \brief Takes a binding reference
+     * \param [in] object Object, may be \c nullptr
+     */
+    void acquire(T* object) {
+      if (!object)
+        return;
+
+      Entry& e = find(object);
+      e.refs += 1;
+
+      m_stats.acquires += 1;
+
+      if (!e.object) {
+        e.object = object;
+        incRef(object);
+
+        if (++m_count * 4 > m_entries.size() * 3)
+          rehash(m_entries.size() * 2);
+      }
+    }
+
+    /**
+     * \brief Drops a binding reference
+     *
+     * The object stays alive at least until \ref retire is
+     * called with the epoch it gets reconciled in.
+     * \param [in] object Object, may be \c nullptr
+     */
+    void release(T* object) {
+      if (!object)
+        return;
+
+      Entry& e = find(object);
+
+      if (e.object) {
+        e.refs -= 1;
+        m_stats.releases += 1;
+      }
+    }
+
+    /**
+     * \brief Replaces a binding
+     *
+     * Acquires the new object before releasing the old one,
+     * so rebinding the same object never touches the table's
+     * real reference.
+     * \param [in,out] slot Binding slot
+     * \param [in] object New object
+     */
+    void rebind(T*& slot, T* object) {
+      if (slot == object)
+        return;
+
+      acquire(object);
+      release(slot);
+      slot = object;
+    }
+
+    /**
+     * \brief Reconciles local and real references
+     *
+     * Moves objects without binding references to the retire
+     * list. Call once per CS chunk or submission.
+     * \param [in] epoch Epoch that must complete before the
+     *    unreferenced objects can be released
+     */
+    void reconcile(uint64_t epoch) {
+      bool removed = false;
+
+      for (Entry& e : m_entries) {
+        if (e.object && !e.refs) {
+          m_retired.push_back({ epoch, e.object });
+          e.object = nullptr;
+          m_count -= 1;
+          removed = true;
+        }
+      }
+
+      // Removing entries breaks probe sequences
+      if (removed)
+        rehash(m_entries.size());
+    }
+
+    /**
+     * \brief Releases retired objects
+     * \param [in] completedEpoch Last completed epoch
+     */
+    void retire(uint64_t completedEpoch) {
+      while (!m_retired.empty() && m_retired.front().first <= completedEpoch) {
+        decRef(m_retired.front().second);
+        m_retired.pop_front();
+      }
+    }
+
+    /**
+     * \brief Queries local reference count
+     *
+     * Only meant for tests.
+     */
+    uint32_t getRefs(T* object) {
+      Entry& e = find(object);
+      return e.object ? e.refs : 0;
+    }
+
+    RcLocalStats getStats() const {
+      RcLocalStats stats = m_stats;
+      stats.objects = m_count;
+      stats.retired = uint32_t(m_retired.size());
+      return stats;
+    }
+
+  private:
+
+    static constexpr size_t InitialCapacity = 64;
+
+    struct Entry {
+      T*        object  = nullptr;
+      uint32_t  refs    = 0;
+    };
+
+    std::vector<Entry>                    m_entries;
+    size_t                                m_count = 0;
+    std::deque<std::pair<uint64_t, T*>>   m_retired;
+    RcLocalStats                          m_stats;
+
+    static size_t hash(const T* object) {
+      uintptr_t p = reinterpret_cast<uintptr_t>(object);
+      return size_t((p >> 4) * 0x9e3779b97f4a7c15ull >> 32);
+    }
+
+    Entry& find(const T* object) {
+      size_t mask = m_entries.size() - 1;
+      size_t index = hash(object) & mask;
+
+      while (m_entries[index].object && m_entries[index].object != object)
+        index = (index + 1) & mask;
+
+      return m_entries[index];
+    }
+
+    void rehash(size_t capacity) {
+      std::vector<Entry> entries(capacity);
+      std::swap(entries, m_entries);
+
+      for (const Entry& e : entries) {
+        if (e.object)
+          find(e.object) = e;
+      }
+    }
+
+    void incRef(T* object) {
+      object->incRef();
+      m_stats.atomicIncs += 1;
+    }
+
+    void decRef(T* object) {
+      m_stats.atomicDecs += 1;
+
+      if (!object->decRef())
+        delete object;
+    }
+
+  };
+
+}
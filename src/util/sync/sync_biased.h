@@ -0,0 +1,378 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk::sync {
+
+  /**
+   * \brief Asymmetric memory barrier
+   *
+   * Lets a hot thread order a store before a later load with a
+   * compiler barrier only, as long as the rare thread it races
+   * against issues a process-wide barrier that interrupts every
+   * running thread. Uses \c FlushProcessWriteBuffers on Windows,
+   * which Wine implements on macOS, and expedited \c membarrier on
+   * Linux. Elsewhere both sides fall back to full fences.
+   */
+  class AsymmetricBarrier {
+
+  public:
+
+    /**
+     * \brief Checks for a process-wide barrier
+     * \returns \c true if \ref heavy interrupts all threads
+     */
+    static bool isSupported() {
+      static const bool s_supported = init();
+      return s_supported;
+    }
+
+    /**
+     * \brief Fast-side barrier
+     * \param [in] asymmetric Whether the other side uses \ref heavy
+     */
+    static void light(bool asymmetric) {
+      if (asymmetric)
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /**
+     * \brief Slow-side barrier
+     * \param [in] asymmetric Whether the other side uses \ref light
+     */
+    static void heavy(bool asymmetric) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (asymmetric) {
+#if defined(_WIN32)
+        FlushProcessWriteBuffers();
+#elif defined(__linux__)
+        syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+#endif
+      }
+    }
+
+  private:
+
+    static bool init() {
+#if defined(_WIN32)
+      return true;
+#elif defined(__linux__)
+      long cmds = syscall(__NR_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+
+      if (cmds < 0 || !(cmds & MEMBARRIER_CMD_PRIVATE_EXPEDITED))
+        return false;
+
+      return !syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0);
+#else
+      return false;
+#endif
+    }
+
+  };
+
+
+  /**
+   * \brief Small per-thread index
+   *
+   * Dense index shared by all biased locks, so that each lock can
+   * keep a fixed array of per-thread flags. Indices of exited
+   * threads are reused.
+   */
+  class BiasedThreadIndex {
+
+  public:
+
+    static uint32_t get() {
+      thread_local BiasedThreadIndex s_index;
+      return s_index.m_index;
+    }
+
+  private:
+
+    struct Registry {
+      std::mutex            mutex;
+      std::vector<uint32_t> free;
+      uint32_t              next = 0;
+    };
+
+    uint32_t m_index;
+
+    BiasedThreadIndex() {
+      Registry& r = registry();
+      std::lock_guard lock(r.mutex);
+
+      if (r.free.empty()) {
+        m_index = r.next++;
+      } else {
+        m_index = r.free.back();
+        r.free.pop_back();
+      }
+    }
+
+    ~BiasedThreadIndex() {
+      Registry& r = registry();
+      std::lock_guard lock(r.mutex);
+      r.free.push_back(m_index);
+    }
+
+    static Registry& registry() {
+      // Leaked so that thread exit after static destruction is safe
+      static Registry* s_registry = new Registry();
+      return *s_registry;
+    }
+
+  };
+
+
+  /**
+   * \brief Biased lock options
+   */
+  struct BiasedMutexOptions {
+    /// Consecutive slow acquisitions by one thread before
+    /// the lock gets biased towards that thread
+    uint32_t rebiasThreshold = 32;
+    /// Use the process-wide barrier if the platform has one,
+    /// otherwise the owner pays a full fence per acquisition
+    bool     asymmetric      = true;
+  };
+
+
+  /**
+   * \brief Biased lock statistics
+   */
+  struct BiasedMutexStats {
+    uint64_t slowAcquires = 0;  ///< Acquisitions through the mutex
+    uint64_t contentions  = 0;  ///< Slow acquisitions that had to wait
+    uint64_t revocations  = 0;  ///< Biases revoked by another thread
+    uint64_t rebiases     = 0;  ///< Biases granted
+  };
+
+
+  /**
+   * \brief Owner-biased recursive mutex
+   *
+   * Drop-in for the recursive lock taken by every call on a
+   * \c D3DCREATE_MULTITHREADED device, where nearly all calls come
+   * from one thread.
+   *
+   * The lock is biased towards the thread that took it through
+   * the mutex \ref BiasedMutexOptions::rebiasThreshold times in a
+   * row. That thread enters by setting its own flag, issuing a
+   * compiler barrier and checking that it still owns the bias: no
+   * atomic read-modify-write and no shared cache line written.
+   * Recursion only bumps its flag.
+   *
+   * Any other thread takes the mutex, clears the bias, issues a
+   * process-wide barrier so that the owner either sees the cleared
+   * bias or its flag is visible, and waits for the flag to drop.
+   * It releases the mutex while waiting, so the owner may still
+   * take it, and any thread that gets the mutex in the meantime
+   * waits for the same flag before entering, or fails a try_lock.
+   * The owner then goes through the mutex as well until it has
+   * earned the bias again.
+   *
+   * Threads beyond \ref MaxThreads never get the bias.
+   */
+  class BiasedRecursiveMutex {
+
+  public:
+
+    static constexpr uint32_t MaxThreads = 64;
+
+    explicit BiasedRecursiveMutex(const BiasedMutexOptions& options = BiasedMutexOptions())
+    : m_threshold (options.rebiasThreshold),
+      m_asymmetric(options.asymmetric && AsymmetricBarrier::isSupported()) { }
+
+    BiasedRecursiveMutex             (const BiasedRecursiveMutex&) = delete;
+    BiasedRecursiveMutex& operator = (const BiasedRecursiveMutex&) = delete;
+
+    void lock() {
+      uint32_t self = BiasedThreadIndex::get();
+
+      if (!tryLockFast(self))
+        lockSlow(self);
+    }
+
+    bool try_lock() {
+      uint32_t self = BiasedThreadIndex::get();
+
+      if (tryLockFast(self))
+        return true;
+
+      if (!m_mutex.try_lock())
+        return false;
+
+      return enterSlow(self, false, false);
+    }
+
+    void unlock() {
+      uint32_t self = BiasedThreadIndex::get();
+
+      if (self < MaxThreads) {
+        std::atomic<uint32_t>& inside = m_inside[self].depth;
+        uint32_t depth = inside.load(std::memory_order_relaxed);
+
+        if (depth) {
+          inside.store(depth - 1, std::memory_order_release);
+          return;
+        }
+      }
+
+      m_slowDepth -= 1;
+      m_mutex.unlock();
+    }
+
+    /**
+     * \brief Checks whether the process-wide barrier is used
+     * \returns \c true if the owner only issues compiler barriers
+     */
+    bool isAsymmetric() const {
+      return m_asymmetric;
+    }
+
+    /**
+     * \brief Queries statistics
+     *
+     * Takes the underlying mutex, but does not revoke the bias.
+     * \returns Lock statistics
+     */
+    BiasedMutexStats getStats() {
+      std::lock_guard lock(m_mutex);
+      return m_stats;
+    }
+
+  private:
+
+    struct alignas(64) ThreadFlag {
+      std::atomic<uint32_t> depth = { 0u };
+    };
+
+    std::recursive_mutex  m_mutex;
+    std::atomic<uint32_t> m_bias = { 0u };  ///< Owner index + 1, or 0
+
+    uint32_t              m_threshold;
+    bool                  m_asymmetric;
+
+    // Protected by m_mutex
+    uint32_t              m_slowDepth  = 0;
+    uint32_t              m_lastThread = ~0u;
+    uint32_t              m_streak     = 0;
+    uint32_t              m_revoked    = 0;  ///< Former owner index + 1, or 0
+    BiasedMutexStats      m_stats;
+
+    ThreadFlag            m_inside[MaxThreads];
+
+    bool tryLockFast(uint32_t self) {
+      if (self >= MaxThreads)
+        return false;
+
+      std::atomic<uint32_t>& inside = m_inside[self].depth;
+      uint32_t depth = inside.load(std::memory_order_relaxed);
+
+      // Nobody can revoke the bias while we are inside
+      if (depth) {
+        inside.store(depth + 1, std::memory_order_relaxed);
+        return true;
+      }
+
+      if (m_bias.load(std::memory_order_relaxed) != self + 1)
+        return false;
+
+      inside.store(1, std::memory_order_relaxed);
+      AsymmetricBarrier::light(m_asymmetric);
+
+      if (m_bias.load(std::memory_order_acquire) == self + 1)
+        return true;
+
+      inside.store(0, std::memory_order_release);
+      return false;
+    }
+
+    void lockSlow(uint32_t self) {
+      bool contended = !m_mutex.try_lock();
+
+      if (contended)
+        m_mutex.lock();
+
+      enterSlow(self, contended, true);
+    }
+
+    bool enterSlow(uint32_t self, bool contended, bool wait) {
+      // Recursive acquisition, we already hold the mutex and
+      // no other thread can own the bias
+      if (m_slowDepth++)
+        return true;
+
+      m_stats.slowAcquires += 1;
+      m_stats.contentions += contended ? 1 : 0;
+
+      while (true) {
+        uint32_t bias = m_bias.load(std::memory_order_relaxed);
+
+        if (bias && bias != self + 1) {
+          m_bias.store(0, std::memory_order_relaxed);
+          AsymmetricBarrier::heavy(m_asymmetric);
+
+          m_revoked = bias;
+          m_stats.revocations += 1;
+        }
+
+        if (!m_revoked)
+          break;
+
+        std::atomic<uint32_t>& inside = m_inside[m_revoked - 1].depth;
+
+        if (!inside.load(std::memory_order_acquire)) {
+          m_revoked = 0;
+          break;
+        }
+
+        // Wait without the mutex since the former owner may need it
+        // before it leaves. The bias may be granted again meanwhile.
+        m_slowDepth = 0;
+        m_mutex.unlock();
+
+        if (!wait)
+          return false;
+
+        while (inside.load(std::memory_order_acquire))
+          std::this_thread::yield();
+
+        m_mutex.lock();
+        m_slowDepth = 1;
+      }
+
+      if (self >= MaxThreads)
+        return true;
+
+      if (m_lastThread != self) {
+        m_lastThread = self;
+        m_streak = 0;
+      }
+
+      if (++m_streak >= m_threshold && !m_bias.load(std::memory_order_relaxed)) {
+        m_bias.store(self + 1, std::memory_order_relaxed);
+        m_stats.rebiases += 1;
+      }
+
+      return true;
+    }
+
+  };
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Work-stealing deque
+   *
+   * Chase-Lev deque with the memory orderings from Lê et al.,
+   * "Correct and Efficient Work-Stealing for Weak Memory Models".
+   * The owning thread pushes and pops at the bottom without locks
+   * and, unless the deque is nearly empty, without atomic
+   * read-modify-write operations. Any thread may steal from the
+   * top with one compare-and-swap.
+   *
+   * The ring grows when full. Old rings stay alive until the deque
+   * is destroyed, since a thief may still be reading from one.
+   *
+   * \tparam T Pointer type
+   */
+  template<typename T>
+  class TaskDeque {
+
+  public:
+
+    explicit TaskDeque(size_t capacity = 256) {
+      size_t size = 1;
+
+      while (size < capacity)
+        size *= 2;
+
+      m_rings.push_back(std::make_unique<Ring>(size));
+      m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    TaskDeque             (const TaskDeque&) = delete;
+    TaskDeque& operator = (const TaskDeque&) = delete;
+
+    /**
+     * \brief Pushes an item
+     *
+     * Must only be called by the owning thread.
+     * \param [in] item Item
+     */
+    void push(T item) {
+      int64_t b = m_bottom.load(std::memory_order_relaxed);
+      int64_t t = m_top.load(std::memory_order_acquire);
+      Ring* ring = m_ring.load(std::memory_order_relaxed);
+
+      if (b - t > int64_t(ring->mask))
+        ring = grow(ring, t, b);
+
+      ring->at(b).store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Pops the most recently pushed item
+     *
+     * Must only be called by the owning thread.
+     * \returns Item, or \c nullptr if the deque is empty
+     */
+    T pop() {
+      int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+      Ring* ring = m_ring.load(std::memory_order_relaxed);
+
+      m_bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      int64_t t = m_top.load(std::memory_order_relaxed);
+
+      if (t > b) {
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      T item = ring->at(b).load(std::memory_order_relaxed);
+
+      if (t == b) {
+        // Last item, race against thieves
+        if (!m_top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed))
+          item = nullptr;
+
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+      }
+
+      return item;
+    }
+
+    /**
+     * \brief Steals the least recently pushed item
+     *
+     * May be called by any thread.
+     * \param [out] aborted Set if another thread won the race,
+     *    in which case the deque may not be empty
+     * \returns Item, or \c nullptr if the deque is empty
+     *    or the steal was aborted
+     */
+    T steal(bool& aborted) {
+      aborted = false;
+
+      int64_t t = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = m_bottom.load(std::memory_order_acquire);
+
+      if (t >= b)
+        return nullptr;
+
+      Ring* ring = m_ring.load(std::memory_order_acquire);
+      T item = ring->at(t).load(std::memory_order_relaxed);
+
+      if (!m_top.compare_exchange_strong(t, t + 1,
+          std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        aborted = true;
+        return nullptr;
+      }
+
+      return item;
+    }
+
+    /**
+     * \brief Estimates the item count
+     * \returns Item count, may be stale
+     */
+    size_t size() const {
+      int64_t b = m_bottom.load(std::memory_order_relaxed);
+      int64_t t = m_top.load(std::memory_order_relaxed);
+      return b > t ? size_t(b - t) : 0;
+    }
+
+  private:
+
+    struct Ring {
+      explicit Ring(size_t size)
+      : mask(size - 1), items(new std::atomic<T>[size]) { }
+
+      size_t                          mask;
+      std::unique_ptr<std::atomic<T>[]> items;
+
+      std::atomic<T>& at(int64_t index) {
+        return items[size_t(index) & mask];
+      }
+    };
+
+    alignas(64) std::atomic<int64_t> m_top    = { 0 };
+    alignas(64) std::atomic<int64_t> m_bottom = { 0 };
+    std::atomic<Ring*>               m_ring   = { nullptr };
+
+    // Owner only
+    std::vector<std::unique_ptr<Ring>> m_rings;
+
+    Ring* grow(Ring* ring, int64_t t, int64_t b) {
+      auto next = std::make_unique<Ring>((ring->mask + 1) * 2);
+
+      for (int64_t i = t; i < b; i++)
+        next->at(i).store(ring->at(i).load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+      Ring* result = next.get();
+      m_rings.push_back(std::move(next));
+      m_ring.store(result, std::memory_order_release);
+      return result;
+    }
+
+  };
+
+}
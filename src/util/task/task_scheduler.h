@@ -0,0 +1,630 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "task_deque.h"
+
+#include "../util_thread_role.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Task priority lane
+   *
+   * Workers drain lanes strictly in order, so no frame-critical
+   * task waits behind prefetch or idle work that is merely queued.
+   */
+  enum class TaskPriority : uint32_t {
+    FrameCritical = 0,  ///< Needed by the current frame
+    Prefetch      = 1,  ///< Needed soon, e.g. shader and texture prefetch
+    Idle          = 2,  ///< Cache I/O, trace writing
+    Count
+  };
+
+
+  /**
+   * \brief Task scheduler statistics
+   */
+  struct TaskSchedulerStats {
+    uint64_t executed      = 0;  ///< Tasks run
+    uint64_t steals        = 0;  ///< Tasks taken from another worker
+    uint64_t stealAttempts = 0;  ///< Steal attempts, successful or not
+    uint64_t boosts        = 0;  ///< Priority raised by a dependent or waiter
+    uint64_t sleeps        = 0;  ///< Times a worker went to sleep
+  };
+
+
+  /**
+   * \brief Scheduled task
+   *
+   * Reference counted. Created through \ref TaskScheduler::create,
+   * every created task must eventually be submitted.
+   */
+  class Task {
+    friend class TaskRef;
+    friend class TaskScheduler;
+  public:
+
+    Task(TaskPriority priority, std::function<void ()>&& fn)
+    : m_fn(std::move(fn)), m_priority(uint32_t(priority)) { }
+
+    /**
+     * \brief Checks whether the task has finished
+     * \returns \c true if the task ran
+     */
+    bool isDone() const {
+      return m_state.load() == Done;
+    }
+
+    /**
+     * \brief Current priority, including boosts
+     * \returns Priority lane
+     */
+    TaskPriority getPriority() const {
+      return TaskPriority(m_priority.load());
+    }
+
+  private:
+
+    enum State : uint32_t {
+      Pending = 0,  ///< Waiting for dependencies or submission
+      Queued  = 1,  ///< In at least one queue
+      Running = 2,
+      Done    = 3,
+    };
+
+    std::function<void ()> m_fn;
+
+    std::atomic<uint32_t>  m_refs     = { 0u };
+    std::atomic<uint32_t>  m_state    = { uint32_t(Pending) };
+    std::atomic<uint32_t>  m_priority;
+    std::atomic<uint32_t>  m_pending  = { 1u };  ///< Dependencies + submit hold
+
+    std::mutex             m_mutex;
+    std::vector<Task*>     m_successors;    ///< Referenced until we complete
+    std::vector<Task*>     m_dependencies;  ///< Referenced until we are ready
+    bool                   m_hasDependencies = false;
+
+    void incRef() {
+      m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void decRef() {
+      if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+    }
+
+  };
+
+
+  /**
+   * \brief Task reference
+   */
+  class TaskRef {
+
+  public:
+
+    TaskRef() = default;
+
+    explicit TaskRef(Task* task)
+    : m_task(task) { if (m_task) m_task->incRef(); }
+
+    TaskRef(const TaskRef& other)
+    : m_task(other.m_task) { if (m_task) m_task->incRef(); }
+
+    TaskRef(TaskRef&& other)
+    : m_task(other.m_task) { other.m_task = nullptr; }
+
+    ~TaskRef() { if (m_task) m_task->decRef(); }
+
+    TaskRef& operator = (TaskRef other) {
+      std::swap(m_task, other.m_task);
+      return *this;
+    }
+
+    Task* operator -> () const { return m_task; }
+    Task* ptr() const { return m_task; }
+
+    explicit operator bool () const { return m_task != nullptr; }
+
+  private:
+
+    Task* m_task = nullptr;
+
+  };
+
+
+  /**
+   * \brief Work-stealing task scheduler
+   *
+   * One pool for DXVK's background work: shader translation,
+   * pipeline compilation, texture conversion, cache I/O. Each worker
+   * owns one \ref TaskDeque per priority lane. Tasks spawned by a
+   * worker go to its own deque, tasks from other threads to a shared
+   * injection queue, and idle workers steal from the others.
+   *
+   * Workers always take the highest-priority task they can find,
+   * from any source, before looking at a lower lane. Priorities are
+   * inherited along dependencies: a task that a higher-priority task
+   * depends on, or that a thread waits on, is boosted together with
+   * its own dependencies, so a frame-critical task never waits for
+   * idle work that cannot get a worker.
+   *
+   * A thread that waits on a task runs frame-critical tasks itself
+   * until the task is done.
+   */
+  class TaskScheduler {
+    static constexpr uint32_t LaneCount = uint32_t(TaskPriority::Count);
+  public:
+
+    /**
+     * \brief Creates the scheduler
+     *
+     * \param [in] workerCount Worker thread count. 0 picks one less
+     *    than the number of CPU cores, but at least one.
+     * \param [in] roles Thread role registry for the workers, or
+     *    \c nullptr. Workers register as background compile threads.
+     */
+    explicit TaskScheduler(uint32_t workerCount = 0, ThreadRoleRegistry* roles = nullptr)
+    : m_roles(roles) {
+      if (!workerCount)
+        workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1u;
+
+      for (uint32_t i = 0; i < workerCount; i++)
+        m_workers.push_back(std::make_unique<Worker>());
+
+      for (uint32_t i = 0; i < workerCount; i++)
+        m_workers[i]->thread = std::thread([this, i] { runWorker(i); });
+    }
+
+    ~TaskScheduler() {
+      m_stopped.store(true);
+
+      { std::lock_guard lock(m_sleepMutex); }
+      m_sleepCond.notify_all();
+
+      for (auto& w : m_workers)
+        w->thread.join();
+    }
+
+    TaskScheduler             (const TaskScheduler&) = delete;
+    TaskScheduler& operator = (const TaskScheduler&) = delete;
+
+    uint32_t getWorkerCount() const {
+      return uint32_t(m_workers.size());
+    }
+
+    /**
+     * \brief Creates a task without submitting it
+     *
+     * Dependencies can be added until the task is submitted.
+     * \param [in] priority Priority lane
+     * \param [in] fn Task function
+     * \returns Task reference
+     */
+    TaskRef create(TaskPriority priority, std::function<void ()> fn) {
+      return TaskRef(new Task(priority, std::move(fn)));
+    }
+
+    /**
+     * \brief Makes a task wait for another task
+     *
+     * The dependency inherits the task's priority if it is higher.
+     * Must be called before \c task is submitted.
+     * \param [in] task Dependent task
+     * \param [in] dependency Task that must finish first
+     */
+    void addDependency(const TaskRef& task, const TaskRef& dependency) {
+      Task* t = task.ptr();
+      Task* d = dependency.ptr();
+
+      { std::lock_guard lock(d->m_mutex);
+
+        if (d->m_state.load() == Task::Done)
+          return;
+
+        t->m_pending.fetch_add(1);
+        t->incRef();
+        d->m_successors.push_back(t); }
+
+      { std::lock_guard lock(t->m_mutex);
+        d->incRef();
+        t->m_dependencies.push_back(d);
+        t->m_hasDependencies = true; }
+
+      boost(d, t->m_priority.load());
+    }
+
+    /**
+     * \brief Submits a task
+     *
+     * The task gets queued once all its dependencies are done.
+     * \param [in] task Task
+     */
+    void submit(const TaskRef& task) {
+      if (task->m_pending.fetch_sub(1) == 1)
+        makeReady(task.ptr());
+    }
+
+    /**
+     * \brief Creates and submits a task
+     *
+     * \param [in] priority Priority lane
+     * \param [in] fn Task function
+     * \param [in] dependencies Tasks that must finish first
+     * \returns Task reference
+     */
+    TaskRef spawn(TaskPriority priority, std::function<void ()> fn,
+            std::initializer_list<TaskRef> dependencies = { }) {
+      TaskRef task = create(priority, std::move(fn));
+
+      for (const auto& d : dependencies)
+        addDependency(task, d);
+
+      submit(task);
+      return task;
+    }
+
+    /**
+     * \brief Waits for a task
+     *
+     * Boosts the task and its dependencies to frame-critical and
+     * runs frame-critical tasks on the calling thread meanwhile.
+     * \param [in] task Task
+     */
+    void wait(const TaskRef& task) {
+      if (task->isDone())
+        return;
+
+      boost(task.ptr(), uint32_t(TaskPriority::FrameCritical));
+
+      int32_t self = currentWorker();
+      m_waiters.fetch_add(1);
+
+      while (!task->isDone()) {
+        if (Task* t = findWork(self, uint32_t(TaskPriority::FrameCritical))) {
+          execute(t, self);
+          continue;
+        }
+
+        std::unique_lock lock(m_waitMutex);
+
+        if (!task->isDone())
+          m_waitCond.wait(lock);
+      }
+
+      m_waiters.fetch_sub(1);
+    }
+
+    TaskSchedulerStats getStats() const {
+      TaskSchedulerStats stats = m_external.read();
+
+      for (const auto& w : m_workers) {
+        TaskSchedulerStats s = w->stats.read();
+        stats.executed      += s.executed;
+        stats.steals        += s.steals;
+        stats.stealAttempts += s.stealAttempts;
+        stats.boosts        += s.boosts;
+        stats.sleeps        += s.sleeps;
+      }
+
+      return stats;
+    }
+
+  private:
+
+    /// Failed scans before a worker goes to sleep
+    static constexpr uint32_t SpinCount = 64;
+
+    /// Tasks a worker moves from the injection queue at once
+    static constexpr uint32_t InjectionBatch = 32;
+
+    struct Counters {
+      std::atomic<uint64_t> executed      = { 0ull };
+      std::atomic<uint64_t> steals        = { 0ull };
+      std::atomic<uint64_t> stealAttempts = { 0ull };
+      std::atomic<uint64_t> boosts        = { 0ull };
+      std::atomic<uint64_t> sleeps        = { 0ull };
+
+      TaskSchedulerStats read() const {
+        TaskSchedulerStats s;
+        s.executed      = executed.load(std::memory_order_relaxed);
+        s.steals        = steals.load(std::memory_order_relaxed);
+        s.stealAttempts = stealAttempts.load(std::memory_order_relaxed);
+        s.boosts        = boosts.load(std::memory_order_relaxed);
+        s.sleeps        = sleeps.load(std::memory_order_relaxed);
+        return s;
+      }
+    };
+
+    struct alignas(64) Worker {
+      std::array<TaskDeque<Task*>, LaneCount> lanes;
+      Counters                                stats;
+      std::thread                             thread;
+    };
+
+    struct Injection {
+      std::mutex            mutex;
+      std::deque<Task*>     tasks;
+      std::atomic<uint32_t> count = { 0u };
+    };
+
+    struct Context {
+      const TaskScheduler*  scheduler = nullptr;
+      int32_t               worker    = -1;
+    };
+
+    ThreadRoleRegistry*                   m_roles;
+    std::vector<std::unique_ptr<Worker>>  m_workers;
+    std::array<Injection, LaneCount>      m_injection;
+    Counters                              m_external;
+
+    std::atomic<bool>                     m_stopped  = { false };
+    std::atomic<uint64_t>                 m_epoch    = { 0ull };
+    std::atomic<uint32_t>                 m_sleepers = { 0u };
+    std::mutex                            m_sleepMutex;
+    std::condition_variable               m_sleepCond;
+
+    std::atomic<uint32_t>                 m_waiters  = { 0u };
+    std::mutex                            m_waitMutex;
+    std::condition_variable               m_waitCond;
+
+    static Context& context() {
+      thread_local Context s_context;
+      return s_context;
+    }
+
+    int32_t currentWorker() const {
+      const Context& c = context();
+      return c.scheduler == this ? c.worker : -1;
+    }
+
+    Counters& counters(int32_t self) {
+      return self >= 0 ? m_workers[self]->stats : m_external;
+    }
+
+    static void bump(std::atomic<uint64_t>& counter, int32_t self) {
+      // Worker counters have a single writer
+      if (self >= 0)
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      else
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void boost(Task* task, uint32_t priority) {
+      uint32_t current = task->m_priority.load();
+
+      do {
+        if (current <= priority)
+          return;
+      } while (!task->m_priority.compare_exchange_weak(current, priority));
+
+      bump(counters(currentWorker()).boosts, currentWorker());
+
+      uint32_t state = task->m_state.load();
+
+      if (state == Task::Queued) {
+        // Queue another copy in the higher lane, whichever copy
+        // is found first runs the task
+        enqueue(task, priority);
+      } else if (state == Task::Pending) {
+        std::vector<Task*> dependencies;
+
+        { std::lock_guard lock(task->m_mutex);
+          dependencies = task->m_dependencies;
+
+          for (Task* d : dependencies)
+            d->incRef(); }
+
+        for (Task* d : dependencies) {
+          boost(d, priority);
+          d->decRef();
+        }
+      }
+    }
+
+    void makeReady(Task* task) {
+      // Written before submission, ordered by m_pending
+      if (task->m_hasDependencies) {
+        std::vector<Task*> dependencies;
+
+        { std::lock_guard lock(task->m_mutex);
+          dependencies = std::move(task->m_dependencies); }
+
+        for (Task* d : dependencies)
+          d->decRef();
+      }
+
+      task->m_state.store(Task::Queued);
+      enqueue(task, task->m_priority.load());
+    }
+
+    void enqueue(Task* task, uint32_t lane) {
+      task->incRef();
+
+      int32_t self = currentWorker();
+
+      if (self >= 0) {
+        m_workers[self]->lanes[lane].push(task);
+      } else {
+        Injection& q = m_injection[lane];
+        std::lock_guard lock(q.mutex);
+        q.tasks.push_back(task);
+        q.count.fetch_add(1);
+      }
+
+      // Pairs with the fence in runWorker: either the sleeping
+      // worker's final scan sees the task, or we see the worker
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      if (m_sleepers.load(std::memory_order_relaxed)) {
+        m_epoch.fetch_add(1);
+
+        { std::lock_guard lock(m_sleepMutex); }
+        m_sleepCond.notify_one();
+      }
+    }
+
+    Task* findWork(int32_t self, uint32_t maxLane) {
+      Counters& c = counters(self);
+
+      for (uint32_t lane = 0; lane <= maxLane; lane++) {
+        if (self >= 0) {
+          if (Task* t = m_workers[self]->lanes[lane].pop())
+            return t;
+        }
+
+        Injection& q = m_injection[lane];
+
+        if (q.count.load(std::memory_order_relaxed)) {
+          std::lock_guard lock(q.mutex);
+
+          if (!q.tasks.empty()) {
+            Task* t = q.tasks.front();
+            q.tasks.pop_front();
+
+            // Workers take a batch into their own deque, where
+            // it can be popped without the lock or stolen
+            uint32_t batch = 1;
+
+            if (self >= 0) {
+              uint32_t share = uint32_t(q.tasks.size() / (m_workers.size() + 1));
+
+              for (uint32_t i = 0; i < std::min(share, InjectionBatch - 1); i++) {
+                m_workers[self]->lanes[lane].push(q.tasks.front());
+                q.tasks.pop_front();
+                batch += 1;
+              }
+            }
+
+            q.count.fetch_sub(batch);
+            return t;
+          }
+        }
+
+        uint32_t count = uint32_t(m_workers.size());
+        uint32_t start = self >= 0 ? uint32_t(self) + 1 : 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+          uint32_t victim = (start + i) % count;
+
+          if (int32_t(victim) == self || !m_workers[victim]->lanes[lane].size())
+            continue;
+
+          bool aborted = false;
+          Task* t = m_workers[victim]->lanes[lane].steal(aborted);
+          bump(c.stealAttempts, self);
+
+          if (t) {
+            bump(c.steals, self);
+            return t;
+          }
+        }
+      }
+
+      return nullptr;
+    }
+
+    void execute(Task* task, int32_t self) {
+      uint32_t expected = Task::Queued;
+
+      // Another copy of a boosted task already ran it
+      if (!task->m_state.compare_exchange_strong(expected, Task::Running)) {
+        task->decRef();
+        return;
+      }
+
+      task->m_fn();
+      task->m_fn = nullptr;
+
+      std::vector<Task*> successors;
+
+      { std::lock_guard lock(task->m_mutex);
+        task->m_state.store(Task::Done);
+        successors = std::move(task->m_successors); }
+
+      for (Task* s : successors) {
+        if (s->m_pending.fetch_sub(1) == 1)
+          makeReady(s);
+        s->decRef();
+      }
+
+      bump(counters(self).executed, self);
+
+      if (m_waiters.load()) {
+        { std::lock_guard lock(m_waitMutex); }
+        m_waitCond.notify_all();
+      }
+
+      task->decRef();
+    }
+
+    void runWorker(uint32_t index) {
+      context() = { this, int32_t(index) };
+
+      std::unique_ptr<ThreadRoleScope> role;
+
+      if (m_roles) {
+        role = std::make_unique<ThreadRoleScope>(*m_roles,
+          ThreadRole::BackgroundCompile, "dxvk-worker-" + std::to_string(index));
+      }
+
+      uint32_t spins = 0;
+      uint32_t maxLane = LaneCount - 1;
+
+      while (true) {
+        if (Task* t = findWork(int32_t(index), maxLane)) {
+          execute(t, int32_t(index));
+          spins = 0;
+          continue;
+        }
+
+        if (m_stopped.load())
+          break;
+
+        if (++spins < SpinCount) {
+          std::this_thread::yield();
+          continue;
+        }
+
+        spins = 0;
+
+        // Announce before the final scan, so that a task queued
+        // after it sees us and wakes us up
+        m_sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t epoch = m_epoch.load();
+
+        if (Task* t = findWork(int32_t(index), maxLane)) {
+          m_sleepers.fetch_sub(1);
+          execute(t, int32_t(index));
+          continue;
+        }
+
+        bump(m_workers[index]->stats.sleeps, int32_t(index));
+
+        { std::unique_lock lock(m_sleepMutex);
+          m_sleepCond.wait(lock, [&] {
+            return m_epoch.load() != epoch || m_stopped.load();
+          }); }
+
+        m_sleepers.fetch_sub(1);
+      }
+    }
+
+  };
+
+}
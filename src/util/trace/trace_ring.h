@@ -0,0 +1,502 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace dxvk {
+
+  /**
+   * \brief Cycle counter used for call timing
+   *
+   * The TSC on x86, the virtual counter on ARM64. Both are
+   * constant-rate and synchronized across cores on the CPUs we
+   * run on. Elsewhere falls back to \c steady_clock.
+   */
+  class TraceClock {
+
+  public:
+
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+      return __rdtsc();
+#elif defined(__aarch64__)
+      uint64_t ticks;
+      asm volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+      return ticks;
+#else
+      return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    /**
+     * \brief Counter frequency
+     *
+     * Read from \c cntfrq_el0 on ARM64, measured against
+     * \c steady_clock over a few milliseconds on x86.
+     * \returns Ticks per nanosecond
+     */
+    static double ticksPerNs() {
+      static const double s_ticksPerNs = calibrate();
+      return s_ticksPerNs;
+    }
+
+  private:
+
+    static double calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+      auto t0 = std::chrono::steady_clock::now();
+      uint64_t c0 = now();
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+      auto t1 = std::chrono::steady_clock::now();
+      uint64_t c1 = now();
+
+      double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+      return ns > 0.0 ? double(c1 - c0) / ns : 1.0;
+#elif defined(__aarch64__)
+      uint64_t freq;
+      asm volatile("mrs %0, cntfrq_el0" : "=r" (freq));
+      return double(freq) / 1e9;
+#else
+      return 1.0;
+#endif
+    }
+
+  };
+
+
+  /**
+   * \brief Timed call
+   *
+   * Fixed-size record as written to trace files.
+   */
+  struct TraceRecord {
+    uint64_t start;     ///< Clock ticks
+    uint64_t duration;  ///< Clock ticks
+    uint32_t id;        ///< Function index in the file's name table
+    uint32_t thread;    ///< Index of the calling thread's ring
+  };
+
+  static_assert(sizeof(TraceRecord) == 24);
+
+
+  /**
+   * \brief Trace file header
+   *
+   * Followed by \c nameBytes of null-terminated function names,
+   * then records until the end of the file. \c dropped is filled
+   * in when the writer closes, a crashed run leaves it at zero.
+   */
+  struct TraceFileHeader {
+    char     magic[8];      ///< "VKTIMING"
+    uint32_t version;
+    uint32_t recordSize;
+    double   ticksPerNs;
+    uint64_t startTicks;
+    uint32_t nameCount;
+    uint32_t nameBytes;
+    uint64_t dropped;       ///< Records lost to full rings
+  };
+
+  static_assert(sizeof(TraceFileHeader) == 48);
+
+  static constexpr char     TraceFileMagic[8] = { 'V', 'K', 'T', 'I', 'M', 'I', 'N', 'G' };
+  static constexpr uint32_t TraceFileVersion  = 1;
+
+
+  /**
+   * \brief Single-producer ring of records
+   *
+   * Written by one application thread at a time, drained by
+   * the writer thread. Never blocks the producer: records that do not fit
+   * are dropped and counted.
+   */
+  class TraceRing {
+
+  public:
+
+    TraceRing(uint32_t thread, size_t capacity)
+    : m_thread(thread), m_mask(roundUp(capacity) - 1), m_records(m_mask + 1) { }
+
+    uint32_t thread() const {
+      return m_thread;
+    }
+
+    /**
+     * \brief Gives up the ring
+     *
+     * Called by the owning thread when it exits or stops
+     * recording to this ring. Records already pushed are
+     * still drained.
+     */
+    void retire() {
+      m_retired.store(true, std::memory_order_release);
+    }
+
+    /**
+     * \brief Takes over a retired ring
+     *
+     * \param [in] thread Thread index for new records
+     * \returns \c true if the ring was retired and now
+     *    belongs to the calling thread
+     */
+    bool reclaim(uint32_t thread) {
+      if (!m_retired.load(std::memory_order_relaxed)
+       || !m_retired.exchange(false, std::memory_order_acquire))
+        return false;
+
+      m_thread = thread;
+      return true;
+    }
+
+    /**
+     * \brief Adds a record
+     *
+     * Only called by the owning thread.
+     * \returns \c false if the ring was full
+     */
+    bool push(uint32_t id, uint64_t start, uint64_t end) {
+      uint64_t head = m_head.load(std::memory_order_relaxed);
+
+      if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+        m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+      }
+
+      TraceRecord& r = m_records[head & m_mask];
+      r.start    = start;
+      r.duration = end - start;
+      r.id       = id;
+      r.thread   = m_thread;
+
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * \brief Takes all records written so far
+     *
+     * Only called by the draining thread.
+     * \param [in] fn Called as \c fn(records, count) for up to
+     *    two contiguous spans
+     * \returns Number of records drained
+     */
+    template<typename Fn>
+    size_t drain(Fn&& fn) {
+      uint64_t tail = m_tail.load(std::memory_order_relaxed);
+      uint64_t head = m_head.load(std::memory_order_acquire);
+
+      size_t count = size_t(head - tail);
+
+      if (!count)
+        return 0;
+
+      size_t first = std::min(count, size_t(m_mask + 1 - (tail & m_mask)));
+      fn(&m_records[tail & m_mask], first);
+
+      if (first < count)
+        fn(&m_records[0], count - first);
+
+      m_tail.store(head, std::memory_order_release);
+      return count;
+    }
+
+    uint64_t dropped() const {
+      return m_dropped.load(std::memory_order_relaxed);
+    }
+
+  private:
+
+    uint32_t                  m_thread;
+    uint64_t                  m_mask;
+    std::vector<TraceRecord>  m_records;
+
+    alignas(64) std::atomic<uint64_t> m_head    = { 0 };
+    std::atomic<uint64_t>             m_dropped = { 0 };
+    std::atomic<bool>                 m_retired = { false };
+    alignas(64) std::atomic<uint64_t> m_tail    = { 0 };
+
+    static size_t roundUp(size_t n) {
+      size_t p = 2;
+
+      while (p < n)
+        p <<= 1;
+
+      return p;
+    }
+
+  };
+
+
+  /**
+   * \brief Trace writer options
+   */
+  struct TraceWriterOptions {
+    size_t   ringCapacity    = 1u << 16;  ///< Records per thread
+    uint32_t drainIntervalMs = 2;
+  };
+
+
+  /**
+   * \brief Trace writer statistics
+   */
+  struct TraceWriterStats {
+    uint64_t records = 0;  ///< Records written to the file
+    uint64_t dropped = 0;  ///< Records lost to full rings
+    uint32_t threads = 0;  ///< Threads that recorded calls
+    uint32_t rings   = 0;  ///< Rings allocated
+  };
+
+
+  /**
+   * \brief Binary call trace writer
+   *
+   * Each calling thread gets its own ring on first use, found
+   * through a thread-local cache afterwards, so recording a call
+   * is two counter reads and a few stores. A background thread
+   * drains all rings to the file every few milliseconds.
+   *
+   * A ring is retired when its thread exits and handed to the
+   * next thread that needs one, so memory is bounded by the
+   * number of threads recording at once rather than by every
+   * thread the process ever ran. Records keep the index of the
+   * thread that wrote them.
+   *
+   * The thread-local cache holds one writer, so a thread that
+   * alternates between two live writers gets a new ring on each
+   * switch. The layer has a single process-wide writer.
+   */
+  class TraceWriter {
+
+  public:
+
+    /**
+     * \brief Opens the trace file
+     *
+     * \param [in] path Output file
+     * \param [in] names Function names, indexed by record id
+     * \param [in] options Ring size and drain interval
+     */
+    TraceWriter(const std::string& path, const std::vector<std::string>& names,
+        const TraceWriterOptions& options = TraceWriterOptions())
+    : m_options(options), m_serial(nextSerial()) {
+      m_file = std::fopen(path.c_str(), "wb");
+
+      if (!m_file)
+        return;
+
+      std::string blob;
+
+      for (const auto& n : names) {
+        blob += n;
+        blob += '\0';
+      }
+
+      TraceFileHeader header = { };
+      std::memcpy(header.magic, TraceFileMagic, sizeof(header.magic));
+      header.version    = TraceFileVersion;
+      header.recordSize = sizeof(TraceRecord);
+      header.ticksPerNs = TraceClock::ticksPerNs();
+      header.startTicks = TraceClock::now();
+      header.nameCount  = uint32_t(names.size());
+      header.nameBytes  = uint32_t(blob.size());
+
+      std::fwrite(&header, sizeof(header), 1, m_file);
+      std::fwrite(blob.data(), 1, blob.size(), m_file);
+
+      m_thread = std::thread([this] { runDrain(); });
+    }
+
+    ~TraceWriter() {
+      close();
+    }
+
+    TraceWriter             (const TraceWriter&) = delete;
+    TraceWriter& operator = (const TraceWriter&) = delete;
+
+    bool isOpen() const {
+      return m_file != nullptr;
+    }
+
+    /**
+     * \brief Writes remaining records and closes the file
+     *
+     * No thread may record calls during or after this. Stats
+     * stay available and are final afterwards.
+     */
+    void close() {
+      if (!m_file)
+        return;
+
+      { std::lock_guard lock(m_mutex);
+        m_stopped = true; }
+
+      m_cond.notify_one();
+      m_thread.join();
+
+      drainAll();
+
+      uint64_t dropped = getStats().dropped;
+      std::fseek(m_file, offsetof(TraceFileHeader, dropped), SEEK_SET);
+      std::fwrite(&dropped, sizeof(dropped), 1, m_file);
+      std::fclose(m_file);
+
+      m_file = nullptr;
+    }
+
+    /**
+     * \brief Records a call
+     *
+     * \param [in] id Function index
+     * \param [in] start Clock ticks at entry
+     * \param [in] end Clock ticks at exit
+     */
+    void record(uint32_t id, uint64_t start, uint64_t end) {
+      ThreadCache& cache = s_cache;
+
+      if (cache.serial != m_serial) {
+        if (!m_file)
+          return;
+
+        std::shared_ptr<TraceRing> ring = addRing();
+
+        cache.ring   = ring.get();
+        cache.serial = m_serial;
+
+        s_lease.reset(std::move(ring));
+      }
+
+      cache.ring->push(id, start, end);
+    }
+
+    TraceWriterStats getStats() const {
+      std::lock_guard lock(m_ringMutex);
+
+      TraceWriterStats stats;
+      stats.records = m_written.load();
+      stats.threads = m_threadCount;
+      stats.rings   = uint32_t(m_rings.size());
+
+      for (const auto& r : m_rings)
+        stats.dropped += r->dropped();
+
+      return stats;
+    }
+
+  private:
+
+    // Zero-initialized, serials start at 1
+    struct ThreadCache {
+      uint64_t   serial;
+      TraceRing* ring;
+    };
+
+    // Retires the cached ring on thread exit or when the cache
+    // moves on to another writer. Holds a reference so this is
+    // safe after the writer is gone. Only touched on the slow
+    // path, the destructor keeps it out of s_cache.
+    struct RingLease {
+      std::shared_ptr<TraceRing> ring;
+
+      ~RingLease() {
+        if (ring)
+          ring->retire();
+      }
+
+      void reset(std::shared_ptr<TraceRing>&& next) {
+        if (ring)
+          ring->retire();
+
+        ring = std::move(next);
+      }
+    };
+
+    static inline thread_local ThreadCache s_cache;
+    static inline thread_local RingLease   s_lease;
+
+    TraceWriterOptions                      m_options;
+    uint64_t                                m_serial;
+    std::FILE*                              m_file = nullptr;
+
+    mutable std::mutex                      m_ringMutex;
+    std::vector<std::shared_ptr<TraceRing>> m_rings;
+    uint32_t                                m_threadCount = 0;
+    std::atomic<uint64_t>                   m_written = { 0 };
+
+    std::mutex                              m_mutex;
+    std::condition_variable                 m_cond;
+    bool                                    m_stopped = false;
+    std::thread                             m_thread;
+
+    static uint64_t nextSerial() {
+      static std::atomic<uint64_t> s_serial = { 0 };
+      return ++s_serial;
+    }
+
+    std::shared_ptr<TraceRing> addRing() {
+      std::lock_guard lock(m_ringMutex);
+      uint32_t thread = m_threadCount++;
+
+      for (const auto& r : m_rings) {
+        if (r->reclaim(thread))
+          return r;
+      }
+
+      m_rings.push_back(std::make_shared<TraceRing>(thread, m_options.ringCapacity));
+      return m_rings.back();
+    }
+
+    void drainAll() {
+      size_t count;
+
+      { std::lock_guard lock(m_ringMutex);
+        count = m_rings.size(); }
+
+      // Rings are only ever appended, existing ones stay put
+      for (size_t i = 0; i < count; i++) {
+        TraceRing* ring;
+
+        { std::lock_guard lock(m_ringMutex);
+          ring = m_rings[i].get(); }
+
+        size_t n = ring->drain([this] (const TraceRecord* records, size_t span) {
+          std::fwrite(records, sizeof(TraceRecord), span, m_file);
+        });
+
+        m_written.fetch_add(n, std::memory_order_relaxed);
+      }
+    }
+
+    void runDrain() {
+      std::unique_lock lock(m_mutex);
+
+      while (!m_stopped) {
+        m_cond.wait_for(lock, std::chrono::milliseconds(m_options.drainIntervalMs));
+
+        lock.unlock();
+        drainAll();
+        std::fflush(m_file);
+        lock.lock();
+      }
+    }
+
+  };
+
+}
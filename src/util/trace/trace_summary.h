@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trace_ring.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Per-function call statistics
+   */
+  struct TraceCallStats {
+    uint32_t    id      = 0;
+    std::string name;
+    uint64_t    count   = 0;
+    double      totalNs = 0.0;
+    double      avgNs   = 0.0;
+    double      p99Ns   = 0.0;
+    double      maxNs   = 0.0;
+  };
+
+
+  /**
+   * \brief Call above the slow-call threshold
+   */
+  struct TraceSlowCall {
+    double      timeMs;      ///< Since the trace started
+    uint32_t    thread;
+    std::string name;
+    double      durationNs;
+  };
+
+
+  /**
+   * \brief Reads and summarizes a binary call trace
+   *
+   * Files cut short by a crash are read up to the last
+   * complete record.
+   */
+  class TraceSummary {
+
+  public:
+
+    /**
+     * \brief Parses a trace
+     * \param [in] data File contents
+     * \returns \c false if the header is invalid
+     */
+    bool load(const std::vector<uint8_t>& data) {
+      m_names.clear();
+      m_records.clear();
+
+      if (data.size() < sizeof(TraceFileHeader))
+        return false;
+
+      std::memcpy(&m_header, data.data(), sizeof(m_header));
+
+      if (std::memcmp(m_header.magic, TraceFileMagic, sizeof(TraceFileMagic))
+       || m_header.version != TraceFileVersion
+       || m_header.recordSize != sizeof(TraceRecord)
+       || !(m_header.ticksPerNs > 0.0)
+       || data.size() - sizeof(TraceFileHeader) < m_header.nameBytes)
+        return false;
+
+      const char* names = reinterpret_cast<const char*>(&data[sizeof(TraceFileHeader)]);
+      size_t pos = 0;
+
+      for (uint32_t i = 0; i < m_header.nameCount; i++) {
+        const void* end = std::memchr(names + pos, 0, m_header.nameBytes - pos);
+
+        if (!end)
+          return false;
+
+        m_names.emplace_back(names + pos);
+        pos = size_t(static_cast<const char*>(end) - names) + 1;
+      }
+
+      size_t offset = sizeof(TraceFileHeader) + m_header.nameBytes;
+      size_t count  = (data.size() - offset) / sizeof(TraceRecord);
+
+      m_records.resize(count);
+
+      if (count)
+        std::memcpy(m_records.data(), &data[offset], count * sizeof(TraceRecord));
+
+      std::stable_sort(m_records.begin(), m_records.end(),
+        [] (const TraceRecord& a, const TraceRecord& b) { return a.start < b.start; });
+
+      return true;
+    }
+
+    bool loadFile(const std::string& path) {
+      std::FILE* f = std::fopen(path.c_str(), "rb");
+
+      if (!f)
+        return false;
+
+      std::vector<uint8_t> data;
+      uint8_t buffer[65536];
+      size_t n;
+
+      while ((n = std::fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+      std::fclose(f);
+      return load(data);
+    }
+
+    const std::vector<TraceRecord>& records() const {
+      return m_records;
+    }
+
+    const std::string& name(uint32_t id) const {
+      static const std::string s_unknown = "<unknown>";
+      return id < m_names.size() ? m_names[id] : s_unknown;
+    }
+
+    /**
+     * \brief Records the writer could not keep
+     */
+    uint64_t dropped() const {
+      return m_header.dropped;
+    }
+
+    double toNs(uint64_t ticks) const {
+      return double(ticks) / m_header.ticksPerNs;
+    }
+
+    uint32_t threadCount() const {
+      uint32_t threads = 0;
+
+      for (const auto& r : m_records)
+        threads = std::max(threads, r.thread + 1);
+
+      return threads;
+    }
+
+    /**
+     * \brief Time from the first call's start to the last call's end
+     */
+    double spanMs() const {
+      if (m_records.empty())
+        return 0.0;
+
+      uint64_t end = 0;
+
+      for (const auto& r : m_records)
+        end = std::max(end, r.start + r.duration);
+
+      return toNs(end - m_records.front().start) / 1e6;
+    }
+
+    /**
+     * \brief Statistics per function
+     * \returns Functions with at least one call, most total time first
+     */
+    std::vector<TraceCallStats> functions() const {
+      std::vector<std::vector<uint64_t>> durations;
+
+      for (const auto& r : m_records) {
+        if (r.id >= durations.size())
+          durations.resize(r.id + 1);
+
+        durations[r.id].push_back(r.duration);
+      }
+
+      std::vector<TraceCallStats> result;
+
+      for (uint32_t id = 0; id < durations.size(); id++) {
+        auto& d = durations[id];
+
+        if (d.empty())
+          continue;
+
+        TraceCallStats s;
+        s.id    = id;
+        s.name  = name(id);
+        s.count = d.size();
+
+        uint64_t total = 0;
+
+        for (uint64_t t : d)
+          total += t;
+
+        // Nearest-rank percentile
+        size_t rank = (d.size() * 99 + 99) / 100 - 1;
+        std::nth_element(d.begin(), d.begin() + rank, d.end());
+
+        s.totalNs = toNs(total);
+        s.avgNs   = s.totalNs / double(s.count);
+        s.p99Ns   = toNs(d[rank]);
+        s.maxNs   = toNs(*std::max_element(d.begin() + rank, d.end()));
+        result.push_back(std::move(s));
+      }
+
+      std::sort(result.begin(), result.end(),
+        [] (const TraceCallStats& a, const TraceCallStats& b) { return a.totalNs > b.totalNs; });
+
+      return result;
+    }
+
+    /**
+     * \brief Calls slower than a threshold, in start order
+     * \param [in] thresholdNs Minimum duration
+     */
+    std::vector<TraceSlowCall> slowCalls(double thresholdNs) const {
+      std::vector<TraceSlowCall> result;
+
+      if (m_records.empty())
+        return result;
+
+      uint64_t origin = m_records.front().start;
+
+      for (const auto& r : m_records) {
+        double ns = toNs(r.duration);
+
+        if (ns >= thresholdNs)
+          result.push_back({ toNs(r.start - origin) / 1e6, r.thread, name(r.id), ns });
+      }
+
+      return result;
+    }
+
+  private:
+
+    TraceFileHeader           m_header = { };
+    std::vector<std::string>  m_names;
+    std::vector<TraceRecord>  m_records;
+
+  };
+
+}
@@ -0,0 +1,579 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk {
+
+  /**
+   * \brief Thread role
+   *
+   * What a DXVK thread does, which decides where it may run
+   * and at which priority.
+   */
+  enum class ThreadRole : uint32_t {
+    RenderCritical    = 0,  ///< CS thread, presenter
+    Submit            = 1,  ///< Submission and queue threads
+    BackgroundCompile = 2,  ///< Shader and pipeline compile workers
+    Io                = 3,  ///< State cache writer, file loading
+    Count
+  };
+
+
+  /**
+   * \brief Thread priority
+   */
+  enum class ThreadPriority : uint32_t {
+    Lowest  = 0,
+    Low     = 1,
+    Normal  = 2,
+    High    = 3,
+  };
+
+
+  /**
+   * \brief Policy for one role
+   */
+  struct ThreadRolePolicy {
+    /// CPUs the threads may run on, 0 for no restriction
+    uint64_t        cpuMask   = 0;
+    /// Scheduling priority
+    ThreadPriority  priority  = ThreadPriority::Normal;
+  };
+
+
+  /**
+   * \brief CPU core classes
+   *
+   * On hybrid CPUs, the cores within \c PerformanceTolerance
+   * percent of the highest capacity, maximum clock or efficiency
+   * class are
+   * performance cores and the rest are efficiency cores. On
+   * homogeneous CPUs the efficiency mask is 0.
+   */
+  struct ThreadCpuTopology {
+    /// Per-core boost (Turbo Boost Max 3.0, CPPC preferred cores)
+    /// spreads the maximum clock of identical cores by a few percent,
+    /// while efficiency cores are well below 90% of the fastest core
+    static constexpr uint64_t PerformanceTolerance = 10;
+
+    uint64_t performanceMask = 0;
+    uint64_t efficiencyMask  = 0;
+
+    bool isHeterogeneous() const {
+      return performanceMask && efficiencyMask;
+    }
+  };
+
+
+  /**
+   * \brief CPU time of one thread
+   */
+  struct ThreadCpuSample {
+    std::string     name;
+    ThreadRole      role;
+    uint64_t        cpuTimeNs;
+  };
+
+
+  /**
+   * \brief Thread role registry statistics
+   */
+  struct ThreadRoleStats {
+    uint32_t threads        = 0;  ///< Currently registered threads
+    uint32_t policyFailures = 0;  ///< Affinity or priority calls that failed
+  };
+
+
+  /**
+   * \brief Thread role registry
+   *
+   * DXVK threads register themselves with a role when they start,
+   * through \ref ThreadRoleScope, and the registry applies the
+   * role's affinity and priority policy through the platform API.
+   * Changing a policy re-applies it to all running threads of the
+   * role. The registry also reads each thread's CPU clock, so the
+   * perf monitor can show where CPU time goes per role.
+   *
+   * On hybrid CPUs the default policy keeps render and submit
+   * threads on performance cores and compile workers on efficiency
+   * cores, so that background compilation cannot take the core the
+   * CS thread needs.
+   */
+  class ThreadRoleRegistry {
+
+  public:
+
+    static constexpr uint32_t RoleCount = uint32_t(ThreadRole::Count);
+
+    ThreadRoleRegistry()
+    : ThreadRoleRegistry(detectTopology()) { }
+
+    explicit ThreadRoleRegistry(const ThreadCpuTopology& topology)
+    : m_topology(topology) {
+      m_policies[uint32_t(ThreadRole::RenderCritical)]    = { topology.performanceMask, ThreadPriority::High   };
+      m_policies[uint32_t(ThreadRole::Submit)]            = { topology.performanceMask, ThreadPriority::High   };
+      m_policies[uint32_t(ThreadRole::BackgroundCompile)] = { topology.efficiencyMask,  ThreadPriority::Low    };
+      m_policies[uint32_t(ThreadRole::Io)]                = { 0,                        ThreadPriority::Normal };
+
+      if (!topology.isHeterogeneous()) {
+        m_policies[uint32_t(ThreadRole::RenderCritical)].cpuMask = 0;
+        m_policies[uint32_t(ThreadRole::Submit)].cpuMask = 0;
+      }
+    }
+
+    ~ThreadRoleRegistry() {
+#if defined(_WIN32)
+      for (const auto& t : m_threads)
+        CloseHandle(t.handle);
+#endif
+    }
+
+    ThreadRoleRegistry             (const ThreadRoleRegistry&) = delete;
+    ThreadRoleRegistry& operator = (const ThreadRoleRegistry&) = delete;
+
+    /**
+     * \brief Registers the calling thread
+     *
+     * Applies the role's policy to the thread.
+     * \param [in] role Thread role
+     * \param [in] name Thread name, e.g. \c "dxvk-cs"
+     * \returns \c true if the policy was applied fully
+     */
+    bool registerThread(ThreadRole role, const std::string& name) {
+      Thread thread;
+      thread.name = name;
+      thread.role = role;
+
+#if defined(_WIN32)
+      DuplicateHandle(GetCurrentProcess(), GetCurrentThread(),
+        GetCurrentProcess(), &thread.handle, 0, FALSE, DUPLICATE_SAME_ACCESS);
+#elif defined(__linux__)
+      thread.tid = pid_t(syscall(SYS_gettid));
+      pthread_getcpuclockid(pthread_self(), &thread.clock);
+#endif
+
+      std::lock_guard lock(m_mutex);
+      bool applied = applyPolicy(thread, m_policies[uint32_t(role)]);
+      m_threads.push_back(std::move(thread));
+      return applied;
+    }
+
+    /**
+     * \brief Unregisters the calling thread
+     *
+     * Must be called by the thread itself before it exits. Its
+     * CPU time is added to the role's total.
+     */
+    void unregisterThread() {
+      std::lock_guard lock(m_mutex);
+
+      for (auto t = m_threads.begin(); t != m_threads.end(); t++) {
+        if (!isCurrentThread(*t))
+          continue;
+
+        m_exitedNs[uint32_t(t->role)] += readCpuTime(*t);
+
+#if defined(_WIN32)
+        CloseHandle(t->handle);
+#endif
+        m_threads.erase(t);
+        return;
+      }
+    }
+
+    /**
+     * \brief Changes a role's policy
+     *
+     * Applies the policy to all registered threads of the role.
+     * \param [in] role Thread role
+     * \param [in] policy New policy
+     * \returns \c true if the policy was applied to all threads
+     */
+    bool setPolicy(ThreadRole role, const ThreadRolePolicy& policy) {
+      std::lock_guard lock(m_mutex);
+      m_policies[uint32_t(role)] = policy;
+
+      bool applied = true;
+
+      for (const auto& t : m_threads) {
+        if (t.role == role)
+          applied &= applyPolicy(t, policy);
+      }
+
+      return applied;
+    }
+
+    /**
+     * \brief Queries a role's policy
+     * \param [in] role Thread role
+     * \returns Current policy
+     */
+    ThreadRolePolicy getPolicy(ThreadRole role) {
+      std::lock_guard lock(m_mutex);
+      return m_policies[uint32_t(role)];
+    }
+
+    /**
+     * \brief Reads CPU time of all registered threads
+     * \returns One sample per thread
+     */
+    std::vector<ThreadCpuSample> sampleThreads() {
+      std::lock_guard lock(m_mutex);
+
+      std::vector<ThreadCpuSample> samples;
+      samples.reserve(m_threads.size());
+
+      for (const auto& t : m_threads)
+        samples.push_back({ t.name, t.role, readCpuTime(t) });
+
+      return samples;
+    }
+
+    /**
+     * \brief Reads CPU time per role
+     *
+     * Includes threads of the role that have already exited.
+     * \returns CPU time in nanoseconds, indexed by role
+     */
+    std::array<uint64_t, RoleCount> sampleRoles() {
+      std::lock_guard lock(m_mutex);
+      std::array<uint64_t, RoleCount> result = m_exitedNs;
+
+      for (const auto& t : m_threads)
+        result[uint32_t(t.role)] += readCpuTime(t);
+
+      return result;
+    }
+
+    /**
+     * \brief Detected core classes
+     * \returns CPU topology
+     */
+    const ThreadCpuTopology& getTopology() const {
+      return m_topology;
+    }
+
+    ThreadRoleStats getStats() {
+      std::lock_guard lock(m_mutex);
+      ThreadRoleStats stats;
+      stats.threads = uint32_t(m_threads.size());
+      stats.policyFailures = m_policyFailures;
+      return stats;
+    }
+
+    /**
+     * \brief Parses a CPU list
+     *
+     * Accepts the format used by \c taskset and the Linux sysfs,
+     * e.g. \c "0-3,8,10-11", for the option strings of
+     * \c dxvk.threadAffinity.
+     * \param [in] list CPU list
+     * \returns CPU mask, 0 if the list is empty or malformed
+     */
+    static uint64_t parseCpuList(const std::string& list) {
+      uint64_t mask = 0;
+      const char* p = list.c_str();
+
+      while (*p) {
+        char* end = nullptr;
+        unsigned long first = std::strtoul(p, &end, 10);
+
+        if (end == p)
+          return 0;
+
+        unsigned long last = first;
+
+        if (*end == '-') {
+          p = end + 1;
+          last = std::strtoul(p, &end, 10);
+
+          if (end == p)
+            return 0;
+        }
+
+        if (first > last || last >= 64)
+          return 0;
+
+        for (unsigned long i = first; i <= last; i++)
+          mask |= uint64_t(1) << i;
+
+        if (*end == ',')
+          end += 1;
+        else if (*end)
+          return 0;
+
+        p = end;
+      }
+
+      return mask;
+    }
+
+    /**
+     * \brief Detects performance and efficiency cores
+     *
+     * Uses the core efficiency class on Windows, which Wine fills
+     * in from the host, and \c cpu_capacity or the maximum frequency
+     * from sysfs on Linux. Elsewhere all cores are treated as equal.
+     * \returns CPU topology
+     */
+    static ThreadCpuTopology detectTopology() {
+      std::array<uint64_t, 64> score = { };
+
+#if defined(_WIN32)
+      DWORD size = 0;
+      GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &size);
+
+      std::vector<char> buffer(size);
+      auto info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+
+      if (size && GetLogicalProcessorInformationEx(RelationProcessorCore, info, &size)) {
+        for (DWORD offset = 0; offset < size; ) {
+          auto core = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(&buffer[offset]);
+
+          // Higher classes are faster. Only group 0 fits the masks.
+          for (WORD g = 0; g < core->Processor.GroupCount; g++) {
+            const GROUP_AFFINITY& group = core->Processor.GroupMask[g];
+
+            if (group.Group)
+              continue;
+
+            for (uint32_t i = 0; i < 64; i++) {
+              if (uint64_t(group.Mask) & (uint64_t(1) << i))
+                score[i] = uint64_t(core->Processor.EfficiencyClass) + 1;
+            }
+          }
+
+          offset += core->Size;
+        }
+      }
+#elif defined(__linux__)
+      for (uint32_t i = 0; i < 64; i++) {
+        score[i] = readSysfs(i, "cpu_capacity");
+
+        if (!score[i])
+          score[i] = readSysfs(i, "cpufreq/cpuinfo_max_freq");
+      }
+#endif
+
+      return classifyCores(score);
+    }
+
+    /**
+     * \brief Splits cores into performance and efficiency cores
+     *
+     * \param [in] score Capacity, maximum clock or efficiency class
+     *    plus one per core, 0 for cores that are not present
+     * \returns CPU topology
+     */
+    static ThreadCpuTopology classifyCores(const std::array<uint64_t, 64>& score) {
+      ThreadCpuTopology topology;
+      uint64_t best = *std::max_element(score.begin(), score.end());
+
+      for (uint32_t i = 0; i < 64; i++) {
+        if (!score[i])
+          continue;
+
+        if (score[i] * 100 >= best * (100 - ThreadCpuTopology::PerformanceTolerance))
+          topology.performanceMask |= uint64_t(1) << i;
+        else
+          topology.efficiencyMask |= uint64_t(1) << i;
+      }
+
+      return topology;
+    }
+
+  private:
+
+    struct Thread {
+      std::string name;
+      ThreadRole  role;
+#if defined(_WIN32)
+      HANDLE      handle = nullptr;
+#elif defined(__linux__)
+      pid_t       tid    = 0;
+      clockid_t   clock  = 0;
+#endif
+    };
+
+    std::mutex                          m_mutex;
+    ThreadCpuTopology                   m_topology;
+    std::array<ThreadRolePolicy, RoleCount> m_policies;
+    std::array<uint64_t, RoleCount>     m_exitedNs = { };
+    std::vector<Thread>                 m_threads;
+    uint32_t                            m_policyFailures = 0;
+
+    bool applyPolicy(const Thread& thread, const ThreadRolePolicy& policy) {
+      bool applied = true;
+
+#if defined(_WIN32)
+      DWORD_PTR processMask = 0, systemMask = 0;
+      GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+
+      DWORD_PTR mask = DWORD_PTR(policy.cpuMask) & processMask;
+
+      // An empty intersection would be rejected, run anywhere instead
+      if (!mask)
+        mask = processMask;
+
+      applied &= SetThreadAffinityMask(thread.handle, mask) != 0;
+
+      static const int priorities[] = {
+        THREAD_PRIORITY_LOWEST, THREAD_PRIORITY_BELOW_NORMAL,
+        THREAD_PRIORITY_NORMAL, THREAD_PRIORITY_ABOVE_NORMAL,
+      };
+
+      applied &= SetThreadPriority(thread.handle, priorities[uint32_t(policy.priority)]) != 0;
+#elif defined(__linux__)
+      // The process affinity, as the main thread has it. The calling
+      // thread may itself be pinned by its own role.
+      cpu_set_t available;
+      CPU_ZERO(&available);
+      sched_getaffinity(getpid(), sizeof(available), &available);
+
+      cpu_set_t set;
+      CPU_ZERO(&set);
+
+      for (uint32_t i = 0; i < 64; i++) {
+        bool allowed = !policy.cpuMask || (policy.cpuMask & (uint64_t(1) << i));
+
+        if (allowed && CPU_ISSET(i, &available))
+          CPU_SET(i, &set);
+      }
+
+      for (uint32_t i = 64; i < CPU_SETSIZE; i++) {
+        if (!policy.cpuMask && CPU_ISSET(i, &available))
+          CPU_SET(i, &set);
+      }
+
+      if (!CPU_COUNT(&set))
+        set = available;
+
+      applied &= !sched_setaffinity(thread.tid, sizeof(set), &set);
+
+      // Per-thread nice value. Raising priority needs CAP_SYS_NICE
+      // or RLIMIT_NICE, so fall back to the default nice value for
+      // High instead of reporting every unprivileged run as failed.
+      static const int niceValues[] = { 19, 10, 0, -5 };
+      int nice = niceValues[uint32_t(policy.priority)];
+
+      if (setpriority(PRIO_PROCESS, id_t(thread.tid), nice)) {
+        bool denied = errno == EACCES || errno == EPERM;
+        applied &= nice < 0 && denied && !setpriority(PRIO_PROCESS, id_t(thread.tid), 0);
+      }
+#else
+      (void)thread;
+      (void)policy;
+      applied = false;
+#endif
+
+      if (!applied)
+        m_policyFailures += 1;
+
+      return applied;
+    }
+
+    static uint64_t readCpuTime(const Thread& thread) {
+#if defined(_WIN32)
+      FILETIME creation, exit, kernel, user;
+
+      if (!GetThreadTimes(thread.handle, &creation, &exit, &kernel, &user))
+        return 0;
+
+      uint64_t k = (uint64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+      uint64_t u = (uint64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+      return (k + u) * 100;
+#elif defined(__linux__)
+      struct timespec ts;
+
+      if (clock_gettime(thread.clock, &ts))
+        return 0;
+
+      return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+#else
+      (void)thread;
+      return 0;
+#endif
+    }
+
+    static bool isCurrentThread(const Thread& thread) {
+#if defined(_WIN32)
+      return GetThreadId(thread.handle) == GetCurrentThreadId();
+#elif defined(__linux__)
+      return thread.tid == pid_t(syscall(SYS_gettid));
+#else
+      (void)thread;
+      return false;
+#endif
+    }
+
+#if defined(__linux__)
+    static uint64_t readSysfs(uint32_t cpu, const char* file) {
+      char path[128];
+      std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/%s", cpu, file);
+
+      FILE* f = std::fopen(path, "r");
+
+      if (!f)
+        return 0;
+
+      unsigned long long value = 0;
+
+      if (std::fscanf(f, "%llu", &value) != 1)
+        value = 0;
+
+      std::fclose(f);
+      return uint64_t(value);
+    }
+#endif
+
+  };
+
+
+  /**
+   * \brief Registers the calling thread for its lifetime
+   *
+   * Create at the top of a thread's entry point, e.g. in
+   * \c DxvkCsThread::threadFunc.
+   */
+  class ThreadRoleScope {
+
+  public:
+
+    ThreadRoleScope(ThreadRoleRegistry& registry, ThreadRole role, const std::string& name)
+    : m_registry(registry) {
+      m_registry.registerThread(role, name);
+    }
+
+    ~ThreadRoleScope() {
+      m_registry.unregisterThread();
+    }
+
+    ThreadRoleScope             (const ThreadRoleScope&) = delete;
+    ThreadRoleScope& operator = (const ThreadRoleScope&) = delete;
+
+  private:
+
+    ThreadRoleRegistry& m_registry;
+
+  };
+
+}
@@ -0,0 +1,215 @@
+/*
+ * Cache File Startup Benchmark
+ *
+ * Compares the startup cost of an eagerly loaded pipeline cache
+ * (read the whole file, verify and insert every entry into a hash
+ * map, which is what a stream-parsed state cache does) against the
+ * memory-mapped cache in src/dxvk/dxvk_cache_file.h, which only
+ * maps the file and resolves the entries a frame actually asks for.
+ *
+ * "Time to first frame" is modelled as open + the lookups needed
+ * by the first frame (--first-frame, default 300 of the entries).
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "dxvk/dxvk_cache_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static long minor_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static DxvkCacheFileKey make_key(std::mt19937_64& rng) {
+    DxvkCacheFileKey key;
+    key.lo = rng();
+    key.hi = rng();
+    return key;
+}
+
+struct RunResult {
+    double ms;
+    long faults;
+    uint64_t checksum;
+};
+
+/* Eager load: read everything, verify everything, then look up */
+static RunResult run_eager(const std::string& path, const std::vector<DxvkCacheFileKey>& lookups) {
+    long faults = minor_faults();
+    auto start = Clock::now();
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    DxvkCacheFileHeader header;
+    memcpy(&header, contents.data(), sizeof(header));
+
+    std::unordered_map<DxvkCacheFileKey, std::vector<char>, DxvkCacheFileKeyHash> entries;
+    entries.reserve(header.entryCount);
+
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        DxvkCacheFileEntry entry;
+        memcpy(&entry, contents.data() + header.indexOffset + i * sizeof(entry), sizeof(entry));
+
+        const char* blob = contents.data() + header.dataOffset + entry.offset;
+
+        if (DxvkCrc32c::compute(blob, entry.size) == entry.crc)
+            entries.emplace(entry.key, std::vector<char>(blob, blob + entry.size));
+    }
+
+    uint64_t checksum = 0;
+
+    for (const auto& key : lookups) {
+        auto e = entries.find(key);
+        if (e != entries.end())
+            checksum += uint8_t(e->second[0]) + e->second.size();
+    }
+
+    return { elapsed_ms(start), minor_faults() - faults, checksum };
+}
+
+/* Lazy load: map the file, resolve only what is asked for */
+static RunResult run_mapped(const std::string& path, const std::vector<DxvkCacheFileKey>& lookups) {
+    long faults = minor_faults();
+    auto start = Clock::now();
+
+    DxvkCacheFile cache(path);
+    uint64_t checksum = 0;
+
+    for (const auto& key : lookups) {
+        const void* data = nullptr;
+        size_t size = 0;
+
+        if (cache.lookup(key, &data, &size) == DxvkCacheLookup::Found)
+            checksum += *reinterpret_cast<const uint8_t*>(data) + size;
+    }
+
+    return { elapsed_ms(start), minor_faults() - faults, checksum };
+}
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+int main(int argc, char** argv) {
+    uint32_t entryCount = 10000;
+    uint32_t firstFrame = 300;
+    uint32_t iterations = 5;
+    uint32_t minSize = 2048;
+    uint32_t maxSize = 16384;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--entries") && i + 1 < argc)
+            entryCount = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--first-frame") && i + 1 < argc)
+            firstFrame = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--entries N] [--first-frame N] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    firstFrame = std::min(firstFrame, entryCount);
+
+    char dirTemplate[] = "/tmp/bench_cache_file.XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        fprintf(stderr, "Failed to create temp directory\n");
+        return 1;
+    }
+    std::string path = std::string(dirTemplate) + "/pipelines.dxcf";
+
+    // Entry sizes roughly match translated MSL / pipeline binaries
+    std::mt19937_64 rng(0x5eed);
+    std::vector<DxvkCacheFileKey> keys;
+    DxvkCacheFileWriter writer;
+    std::vector<char> blob;
+
+    for (uint32_t i = 0; i < entryCount; i++) {
+        blob.resize(minSize + rng() % (maxSize - minSize));
+        for (size_t j = 0; j < blob.size(); j += 8) {
+            uint64_t v = rng();
+            memcpy(&blob[j], &v, std::min<size_t>(8, blob.size() - j));
+        }
+        keys.push_back(make_key(rng));
+        writer.add(keys.back(), blob.data(), blob.size());
+    }
+
+    auto writeStart = Clock::now();
+    if (!writer.write(path)) {
+        fprintf(stderr, "Failed to write %s\n", path.c_str());
+        return 1;
+    }
+    double writeMs = elapsed_ms(writeStart);
+
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::vector<DxvkCacheFileKey> lookups(keys.begin(), keys.begin() + firstFrame);
+
+    std::vector<double> eagerMs, mappedMs;
+    long eagerFaults = 0, mappedFaults = 0;
+    bool checksumsMatch = true;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        RunResult eager = run_eager(path, lookups);
+        RunResult mapped = run_mapped(path, lookups);
+        eagerMs.push_back(eager.ms);
+        mappedMs.push_back(mapped.ms);
+        eagerFaults = eager.faults;
+        mappedFaults = mapped.faults;
+        checksumsMatch &= eager.checksum == mapped.checksum;
+    }
+
+    long fileSize = 0;
+    { FILE* f = fopen(path.c_str(), "rb");
+      fseek(f, 0, SEEK_END);
+      fileSize = ftell(f);
+      fclose(f); }
+
+    remove(path.c_str());
+    rmdir(dirTemplate);
+
+    double eager = median(eagerMs);
+    double mapped = median(mappedMs);
+
+    printf("{\n");
+    printf("  \"benchmark\": \"cache_file_startup\",\n");
+    printf("  \"entries\": %u,\n", entryCount);
+    printf("  \"first_frame_lookups\": %u,\n", firstFrame);
+    printf("  \"file_bytes\": %ld,\n", fileSize);
+    printf("  \"iterations\": %u,\n", iterations);
+    printf("  \"write_ms\": %.3f,\n", writeMs);
+    printf("  \"eager_ms\": %.3f,\n", eager);
+    printf("  \"mapped_ms\": %.3f,\n", mapped);
+    printf("  \"speedup\": %.1f,\n", mapped > 0.0 ? eager / mapped : 0.0);
+    printf("  \"eager_minor_faults\": %ld,\n", eagerFaults);
+    printf("  \"mapped_minor_faults\": %ld,\n", mappedFaults);
+    printf("  \"results_match\": %s\n", checksumsMatch ? "true" : "false");
+    printf("}\n");
+
+    return checksumsMatch ? 0 : 1;
+}
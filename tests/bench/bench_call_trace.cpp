@@ -0,0 +1,329 @@
+/*
+ * Call Trace Overhead Benchmark
+ *
+ * Measures what the Vulkan timing layer (layers/timing) adds to each
+ * call it wraps: two clock reads and a push into the calling thread's
+ * ring (src/util/trace/trace_ring.h), with the drain thread writing
+ * to a file in the background as it does in the game.
+ *
+ * - clock_ns: one TraceClock::now()
+ * - overhead_ns: a timed call minus the same call untimed, for one
+ *   thread and for several recording at once
+ * - wrapper_overhead_ns: the same through a copy of a generated
+ *   wrapper, which adds the GetDeviceTable lookup (the DispatchMap
+ *   scan, with the device in the last of its 32 slots), the g_writer
+ *   acquire load and the CallTimer object
+ * - drop_rate: share of records lost to full rings. Each ring holds
+ *   everything one thread records, so this should be 0
+ * - within_budget: both stay under 100 ns in every case and no
+ *   record was dropped
+ *
+ * The wrapped call is an empty function behind a pointer, like the
+ * next layer's entry point. Calls are timed in thread CPU time, so
+ * threads sharing a core do not count each other's work.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "util/trace/trace_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+static constexpr double   BudgetNs    = 100.0;
+static constexpr uint32_t WarmupCalls = 1000;
+static constexpr uint32_t Rounds      = 5;
+
+static double thread_cpu_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return double(ts.tv_sec) * 1e9 + double(ts.tv_nsec);
+}
+
+__attribute__((noinline)) static uint32_t next_call(uint32_t x) {
+    asm volatile("" : "+r" (x));
+    return x + 1;
+}
+
+static uint32_t (*volatile g_next)(uint32_t) = next_call;
+
+static double untimed_ns(uint32_t calls) {
+    uint32_t (*fn)(uint32_t) = g_next;
+    uint32_t sink = 0;
+
+    double start = thread_cpu_ns();
+    for (uint32_t i = 0; i < calls; i++)
+        sink = fn(sink);
+    double ns = thread_cpu_ns() - start;
+
+    return sink == calls ? ns / calls : 0.0;
+}
+
+static double timed_ns(TraceWriter& writer, uint32_t calls) {
+    uint32_t (*fn)(uint32_t) = g_next;
+    uint32_t sink = 0;
+
+    double start = thread_cpu_ns();
+    for (uint32_t i = 0; i < calls; i++) {
+        uint64_t t0 = TraceClock::now();
+        sink = fn(sink);
+        writer.record(i & 63, t0, TraceClock::now());
+    }
+    double ns = thread_cpu_ns() - start;
+
+    return sink == calls ? ns / calls : 0.0;
+}
+
+/* ============================================
+ * Generated wrapper, as in layers/timing/vk_timing_layer.cpp
+ * ============================================ */
+template<typename T>
+class DispatchMap {
+
+public:
+
+    T* find(const void* handle) const {
+        void* key = dispatchKey(handle);
+
+        for (uint32_t i = 0; i < MaxEntries; i++) {
+            if (m_keys[i].load(std::memory_order_acquire) == key)
+                return m_values[i];
+        }
+
+        return nullptr;
+    }
+
+    bool insert(const void* handle, T* value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (uint32_t i = 0; i < MaxEntries; i++) {
+            if (!m_keys[i].load(std::memory_order_relaxed)) {
+                m_values[i] = value;
+                m_keys[i].store(dispatchKey(handle), std::memory_order_release);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static constexpr uint32_t MaxEntries = 32;
+
+private:
+
+    std::mutex          m_mutex;
+    std::atomic<void*>  m_keys[MaxEntries] = { };
+    T*                  m_values[MaxEntries] = { };
+
+    static void* dispatchKey(const void* handle) {
+        return *static_cast<void* const*>(handle);
+    }
+
+};
+
+struct DeviceDispatch {
+    uint32_t (*next)(uint32_t);
+};
+
+struct DeviceData {
+    DeviceDispatch table;
+};
+
+/* Dispatchable handle, the loader's table pointer comes first */
+struct Handle {
+    void* loaderTable;
+};
+
+static DispatchMap<DeviceData>   g_devices;
+static std::atomic<TraceWriter*> g_writer = { nullptr };
+
+class CallTimer {
+
+public:
+
+    explicit CallTimer(uint32_t id)
+    : m_id(id), m_start(TraceClock::now()) { }
+
+    ~CallTimer() {
+        uint64_t end = TraceClock::now();
+
+        if (TraceWriter* writer = g_writer.load(std::memory_order_acquire))
+            writer->record(m_id, m_start, end);
+    }
+
+    CallTimer             (const CallTimer&) = delete;
+    CallTimer& operator = (const CallTimer&) = delete;
+
+private:
+
+    uint32_t m_id;
+    uint64_t m_start;
+
+};
+
+static const DeviceDispatch& GetDeviceTable(const void* handle) {
+    return g_devices.find(handle)->table;
+}
+
+__attribute__((noinline)) static uint32_t Wrap_next(const Handle* device, uint32_t x) {
+    CallTimer timer(7);
+    return GetDeviceTable(device).next(x);
+}
+
+static uint32_t (*volatile g_wrapper)(const Handle*, uint32_t) = Wrap_next;
+
+static Handle g_device;
+
+static double wrapped_ns(uint32_t calls) {
+    uint32_t (*fn)(const Handle*, uint32_t) = g_wrapper;
+    uint32_t sink = 0;
+
+    double start = thread_cpu_ns();
+    for (uint32_t i = 0; i < calls; i++)
+        sink = fn(&g_device, sink);
+    double ns = thread_cpu_ns() - start;
+
+    return sink == calls ? ns / calls : 0.0;
+}
+
+/* Overhead per call with the given number of threads recording */
+static double overhead_ns(TraceWriter& writer, uint32_t threadCount, uint32_t calls, bool wrapper) {
+    std::vector<double> results(threadCount);
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&writer, &results, t, calls, wrapper] {
+            auto timed = [&] (uint32_t n) {
+                return wrapper ? wrapped_ns(n) : timed_ns(writer, n);
+            };
+
+            // Warm up the thread's ring before measuring
+            timed(WarmupCalls);
+
+            double best = 1e9;
+            for (uint32_t round = 0; round < Rounds; round++)
+                best = std::min(best, timed(calls) - untimed_ns(calls));
+            results[t] = best;
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    double worst = 0.0;
+    for (double r : results)
+        worst = std::max(worst, r);
+    return worst;
+}
+
+int main(int argc, char** argv) {
+    uint32_t calls = 200000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--calls") && i + 1 < argc)
+            calls = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--calls N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < 64; i++)
+        names.push_back("vkFunction" + std::to_string(i));
+
+    std::string path = "/tmp/bench_call_trace." + std::to_string(getpid()) + ".bin";
+
+    uint32_t sink = 0;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < calls; i++)
+        sink += uint32_t(TraceClock::now());
+    double clockNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls;
+
+    // Other dispatch keys take every slot before the device's
+    static Handle others[DispatchMap<DeviceData>::MaxEntries - 1];
+    static void* otherKeys[DispatchMap<DeviceData>::MaxEntries - 1];
+    static void* deviceKey;
+    static DeviceData deviceData = { { next_call } };
+
+    for (uint32_t i = 0; i < DispatchMap<DeviceData>::MaxEntries - 1; i++) {
+        others[i].loaderTable = &otherKeys[i];
+        g_devices.insert(&others[i], &deviceData);
+    }
+
+    g_device.loaderTable = &deviceKey;
+    g_devices.insert(&g_device, &deviceData);
+
+    static const uint32_t threadCounts[] = { 1, 2, 4 };
+    double overhead[3];
+    double wrapperOverhead[3];
+    TraceWriterStats stats;
+
+    // A ring that fills between drains drops records and skews the
+    // timings, so size it for everything one thread records
+    TraceWriterOptions options;
+    options.ringCapacity = size_t(WarmupCalls) + size_t(Rounds) * calls;
+
+    { TraceWriter writer(path, names, options);
+
+      if (!writer.isOpen()) {
+          fprintf(stderr, "Cannot open %s\n", path.c_str());
+          return 1;
+      }
+
+      g_writer.store(&writer, std::memory_order_release);
+
+      for (uint32_t i = 0; i < 3; i++) {
+          overhead[i] = overhead_ns(writer, threadCounts[i], calls, false);
+          wrapperOverhead[i] = overhead_ns(writer, threadCounts[i], calls, true);
+      }
+
+      g_writer.store(nullptr, std::memory_order_release);
+      stats = writer.getStats(); }
+
+    remove(path.c_str());
+
+    uint64_t total = stats.records + stats.dropped;
+    double dropRate = total ? double(stats.dropped) / double(total) : 0.0;
+
+    bool withinBudget = !stats.dropped;
+    for (uint32_t i = 0; i < 3; i++)
+        withinBudget &= overhead[i] < BudgetNs && wrapperOverhead[i] < BudgetNs;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"call_trace\",\n");
+    printf("  \"calls_per_thread\": %u,\n", calls);
+    printf("  \"ticks_per_ns\": %.3f,\n", TraceClock::ticksPerNs());
+    printf("  \"clock_ns\": %.1f,\n", sink ? clockNs : 0.0);
+    printf("  \"threads\": [\n");
+
+    for (uint32_t i = 0; i < 3; i++) {
+        printf("    { \"threads\": %u, \"overhead_ns\": %.1f, \"wrapper_overhead_ns\": %.1f }%s\n",
+            threadCounts[i], overhead[i], wrapperOverhead[i], i + 1 < 3 ? "," : "");
+    }
+
+    printf("  ],\n");
+    printf("  \"records_written\": %llu,\n", (unsigned long long)stats.records);
+    printf("  \"records_dropped\": %llu,\n", (unsigned long long)stats.dropped);
+    printf("  \"drop_rate\": %.4f,\n", dropRate);
+    printf("  \"budget_ns\": %.0f,\n", BudgetNs);
+    printf("  \"within_budget\": %s\n", withinBudget ? "true" : "false");
+    printf("}\n");
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Device Lock Benchmark
+ *
+ * Measures D3D9 calls per second on the game thread when every
+ * call takes the device lock of a D3DCREATE_MULTITHREADED device:
+ * a plain recursive mutex, as DXVK's D3D9Multithread works today,
+ * and the owner-biased mutex in src/util/sync/sync_biased.h, with
+ * the process-wide barrier and with full fences.
+ *
+ * Each call does a little state work and one in four calls nests
+ * the lock, like SetRenderState from inside a state block. With
+ * contention enabled a second thread, standing in for an NVSE
+ * plugin thread, makes a locked call every --interval microseconds.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "util/sync/sync_biased.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+using namespace dxvk::sync;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct DeviceState {
+    uint32_t renderStates[256] = { };
+    uint64_t calls = 0;
+};
+
+template<typename Lock>
+static void device_call(Lock& lock, DeviceState& state, uint32_t i) {
+    std::lock_guard guard(lock);
+    state.renderStates[i & 0xff] = i;
+    state.calls += 1;
+
+    if (!(i & 3)) {
+        std::lock_guard nested(lock);
+        state.renderStates[(i >> 8) & 0xff] ^= i;
+    }
+}
+
+struct Result {
+    double callsPerSecond;
+    uint64_t otherCalls;
+};
+
+template<typename Lock>
+static Result run(Lock& lock, uint32_t calls, bool contention, uint32_t intervalUs, uint32_t iterations) {
+    DeviceState state;
+    std::atomic<bool> stop = { false };
+    std::atomic<uint64_t> otherCalls = { 0 };
+    std::thread other;
+
+    if (contention) {
+        other = std::thread([&] {
+            uint32_t i = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                device_call(lock, state, i++);
+                otherCalls.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::microseconds(intervalUs));
+            }
+        });
+    }
+
+    double best = 1e30;
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        auto start = Clock::now();
+
+        for (uint32_t i = 0; i < calls; i++)
+            device_call(lock, state, i);
+
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    if (contention) {
+        stop = true;
+        other.join();
+    }
+
+    return { double(calls) / best, otherCalls.load() };
+}
+
+static void print_stats(const char* name, BiasedRecursiveMutex& lock) {
+    BiasedMutexStats stats = lock.getStats();
+    printf("\"%s_slow_acquires\": %llu, \"%s_contentions\": %llu, \"%s_revocations\": %llu",
+        name, (unsigned long long)stats.slowAcquires,
+        name, (unsigned long long)stats.contentions,
+        name, (unsigned long long)stats.revocations);
+}
+
+int main(int argc, char** argv) {
+    uint32_t calls = 1u << 22;
+    uint32_t iterations = 5;
+    uint32_t intervalUs = 100;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--calls") && i + 1 < argc)
+            calls = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--interval") && i + 1 < argc)
+            intervalUs = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--calls N] [--interval US]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    BiasedMutexOptions fenceOptions;
+    fenceOptions.asymmetric = false;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"device_lock\",\n");
+    printf("  \"calls\": %u,\n", calls);
+    printf("  \"process_wide_barrier\": %s,\n", AsymmetricBarrier::isSupported() ? "true" : "false");
+    printf("  \"contention_interval_us\": %u,\n", intervalUs);
+    printf("  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    printf("  \"results\": [\n");
+
+    for (uint32_t c = 0; c < 2; c++) {
+        bool contention = c != 0;
+
+        std::recursive_mutex mutex;
+        BiasedRecursiveMutex biased;
+        BiasedRecursiveMutex fenced(fenceOptions);
+
+        Result rm = run(mutex, calls, contention, intervalUs, iterations);
+        Result rb = run(biased, calls, contention, intervalUs, iterations);
+        Result rf = run(fenced, calls, contention, intervalUs, iterations);
+
+        printf("    { \"contention\": %s, \"recursive_mutex_mcalls_per_s\": %.1f, "
+               "\"biased_mcalls_per_s\": %.1f, \"biased_fence_mcalls_per_s\": %.1f, "
+               "\"speedup\": %.2f, \"other_thread_calls\": %llu, ",
+            contention ? "true" : "false", rm.callsPerSecond / 1e6,
+            rb.callsPerSecond / 1e6, rf.callsPerSecond / 1e6,
+            rb.callsPerSecond / rm.callsPerSecond,
+            (unsigned long long)rb.otherCalls);
+        print_stats("biased", biased);
+        printf(" }%s\n", c == 0 ? "," : "");
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,414 @@
+/*
+ * DXSO Front End Benchmark (dxso-bench)
+ *
+ * Extracts every unique vertex and pixel shader (resource types 5
+ * and 6) from the .d3d9trace files in a directory and compiles each
+ * one through the DXSO front end in this tree, spread over N worker
+ * threads of src/util/task/task_scheduler.h:
+ *
+ * - D3D9GetShaderBytecodeSize and DxsoDecode
+ *   (src/d3d9/d3d9_shader_intern.h, src/dxso/dxso_float_emulation.h)
+ * - the FastStrict float emulation plan
+ * - the binding layout DxsoCompiler declares: the constant buffer,
+ *   a color and a depth image per sampler (volume textures have no
+ *   depth image), and for pixel shaders the fixed function and
+ *   shared data buffers
+ *
+ * The SPIR-V backend of DxsoCompiler lives in DXVK, not here. With
+ * --spirv DIR, the modules make run-shaderdump wrote are paired with
+ * the bytecode by name (VS_/PS_ plus the bytecode's SHA-1, as DXVK
+ * names shaders) and run through the binding pruning pass of
+ * src/dxvk/dxvk_spirv_prune.h as the optional optimisation step, which
+ * adds SPIR-V size and used binding counts to the report.
+ *
+ * Per shader: instructions, frontend_us, clamps, bindings and, when
+ * paired, spirv_bytes / spirv_bytes_pruned / bindings_used. Totals
+ * include frontend_shaders_per_s over all threads, for regression
+ * gating. The timings cover the front end steps above only; SPIR-V
+ * generation is not timed, and the report says so with
+ * "backend_timed": false.
+ *
+ * Run with: make dxso-bench [TRACES_DIR=...] [THREADS=N]
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_shader_intern.h"
+#include "dxso/dxso_float_emulation.h"
+#include "dxvk/dxvk_spirv_prune.h"
+#include "util/task/task_scheduler.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+/* ============================================
+ * SHA-1, to find DXVK's dump of a shader
+ * ============================================ */
+static std::string sha1_hex(const uint8_t* data, size_t size) {
+    uint32_t h[5] = { 0x67452301u, 0xefcdab89u, 0x98badcfeu, 0x10325476u, 0xc3d2e1f0u };
+
+    std::vector<uint8_t> msg(data, data + size);
+    msg.push_back(0x80);
+    while (msg.size() % 64 != 56)
+        msg.push_back(0);
+    for (int i = 7; i >= 0; i--)
+        msg.push_back(uint8_t((uint64_t(size) * 8) >> (8 * i)));
+
+    auto rol = [] (uint32_t v, uint32_t n) { return (v << n) | (v >> (32 - n)); };
+
+    for (size_t block = 0; block < msg.size(); block += 64) {
+        uint32_t w[80];
+
+        for (uint32_t i = 0; i < 16; i++) {
+            const uint8_t* p = &msg[block + 4 * i];
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+
+        for (uint32_t i = 16; i < 80; i++)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+        for (uint32_t i = 0; i < 80; i++) {
+            uint32_t f, k;
+
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999u; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1u; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdcu; }
+            else             { f = b ^ c ^ d;                   k = 0xca62c1d6u; }
+
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    char hex[41];
+    for (uint32_t i = 0; i < 5; i++)
+        snprintf(&hex[8 * i], 9, "%08x", h[i]);
+
+    return std::string(hex, 40);
+}
+
+/* ============================================
+ * Trace reading
+ * ============================================ */
+static constexpr uint64_t TraceMagic      = 0x4543415254394433ull;  // "D3D9TRAC"
+static constexpr size_t   TraceHeaderSize = 88;
+static constexpr size_t   TraceEntrySize  = 56;
+
+struct Shader {
+    std::string           name;
+    bool                  ps;
+    std::vector<uint32_t> code;
+    std::vector<uint32_t> spirv;
+};
+
+template<typename T>
+static T read_at(const std::vector<uint8_t>& file, size_t offset) {
+    T value = T();
+    if (offset + sizeof(T) <= file.size())
+        memcpy(&value, &file[offset], sizeof(T));
+    return value;
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+    fclose(f);
+    return true;
+}
+
+static void load_trace(const std::string& path, std::map<std::vector<uint32_t>, bool>& unique, uint32_t& objects) {
+    std::vector<uint8_t> file;
+
+    if (!read_file(path, file) || file.size() < TraceHeaderSize || read_at<uint64_t>(file, 0) != TraceMagic)
+        return;
+
+    uint32_t resourceCount   = read_at<uint32_t>(file, 24);
+    uint64_t resourcesOffset = read_at<uint64_t>(file, 56);
+
+    for (uint32_t i = 0; i < resourceCount; i++) {
+        size_t entry = resourcesOffset + i * TraceEntrySize;
+
+        if (entry + TraceEntrySize > file.size())
+            break;
+
+        uint8_t  type       = read_at<uint8_t>(file, entry + 4);
+        uint64_t dataOffset = read_at<uint64_t>(file, entry + 8);
+        uint64_t dataSize   = read_at<uint64_t>(file, entry + 16);
+
+        if ((type != 5 && type != 6) || !dataOffset || dataSize % 4
+         || dataOffset + dataSize > file.size())
+            continue;
+
+        std::vector<uint32_t> code(dataSize / 4);
+        memcpy(code.data(), &file[dataOffset], dataSize);
+
+        unique.insert({ std::move(code), type == 6 });
+        objects++;
+    }
+}
+
+static std::vector<Shader> load_shaders(const char* traces, const char* spirv, uint32_t& objects, uint32_t& paired) {
+    std::map<std::vector<uint32_t>, bool> unique;
+    std::vector<std::string> files;
+
+    if (DIR* d = opendir(traces)) {
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+
+            if (name.size() > 10 && !name.compare(name.size() - 10, 10, ".d3d9trace"))
+                files.push_back(std::string(traces) + "/" + name);
+        }
+
+        closedir(d);
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (const auto& f : files)
+        load_trace(f, unique, objects);
+
+    std::vector<Shader> shaders;
+
+    for (const auto& entry : unique) {
+        Shader s;
+        s.ps   = entry.second;
+        s.code = entry.first;
+        s.name = std::string(s.ps ? "PS_" : "VS_")
+          + sha1_hex(reinterpret_cast<const uint8_t*>(s.code.data()), s.code.size() * sizeof(uint32_t));
+
+        std::vector<uint8_t> data;
+
+        if (spirv && read_file(std::string(spirv) + "/" + s.name + ".spv", data) && data.size() % 4 == 0) {
+            s.spirv.resize(data.size() / 4);
+            memcpy(s.spirv.data(), data.data(), data.size());
+            paired++;
+        }
+
+        shaders.push_back(std::move(s));
+    }
+
+    return shaders;
+}
+
+/* ============================================
+ * Compile
+ * ============================================ */
+struct Result {
+    bool     supported     = false;
+    uint32_t instructions  = 0;
+    uint32_t strictClamps  = 0;
+    uint32_t fastClamps    = 0;
+    uint32_t bindings      = 0;
+    size_t   spirvPruned   = 0;  ///< Words
+    uint32_t bindingsUsed  = 0;
+    uint64_t ns            = 0;
+};
+
+static uint32_t count_bindings(const DxsoProgram& program) {
+    constexpr uint32_t TextureTypeVolume = 4;
+
+    bool ps = program.type == DxsoProgramType::PixelShader;
+    uint32_t bindings = ps ? 3 : 1;
+
+    for (const auto& ins : program.instructions) {
+        if (ins.opcode == DxsoOpcode::Dcl && ins.dst.type == DxsoRegisterType::Sampler)
+            bindings += ((ins.def[0] >> 27) & 0xf) == TextureTypeVolume ? 1 : 2;
+    }
+
+    return bindings;
+}
+
+static void compile(const Shader& s, Result& result) {
+    auto start = Clock::now();
+
+    size_t dwords = D3D9GetShaderBytecodeSize(s.code.data(), s.code.size());
+    DxsoProgram program;
+
+    if (!dwords || !DxsoDecode(s.code.data(), dwords, program)) {
+        result.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        return;
+    }
+
+    DxsoFloatEmulationStats stats = DxsoFloatEmulationPlan(program, D3D9FloatEmulation::FastStrict).GetStats();
+    uint32_t bindings = count_bindings(program);
+
+    size_t spirvPruned = 0;
+    uint32_t bindingsUsed = 0;
+
+    if (!s.spirv.empty()) {
+        std::vector<uint32_t> code = s.spirv;
+        DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+
+        if (usage.valid) {
+            spirvPruned = code.size();
+
+            for (uint32_t set = 0; set < DxvkSpirvBindingUsage::MaxSets; set++)
+                bindingsUsed += usage.used[set].count();
+        }
+    }
+
+    result.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    result.supported    = true;
+    result.instructions = stats.instructions;
+    result.strictClamps = stats.strictClamps;
+    result.fastClamps   = stats.clamps;
+    result.bindings     = bindings;
+    result.spirvPruned  = spirvPruned;
+    result.bindingsUsed = bindingsUsed;
+}
+
+int main(int argc, char** argv) {
+    const char* traces = "traces";
+    const char* spirv = nullptr;
+    uint32_t threads = 0;
+    uint32_t iterations = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--traces") && i + 1 < argc)
+            traces = argv[++i];
+        else if (!strcmp(argv[i], "--spirv") && i + 1 < argc)
+            spirv = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            threads = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = std::max(1, atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--traces DIR] [--spirv DIR] [--threads N] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    uint32_t objects = 0, paired = 0;
+    std::vector<Shader> shaders = load_shaders(traces, spirv, objects, paired);
+
+    if (shaders.empty()) {
+        fprintf(stderr, "No shaders found in %s/*.d3d9trace\n", traces);
+        return 1;
+    }
+
+    // Each task compiles one shader once; tasks of one shader
+    // write the same result, only the time accumulates
+    std::vector<std::vector<Result>> results(iterations, std::vector<Result>(shaders.size()));
+    double wallMs;
+    uint32_t workers;
+
+    { TaskScheduler scheduler(threads);
+      workers = scheduler.getWorkerCount();
+
+      std::vector<TaskRef> tasks;
+      tasks.reserve(shaders.size() * iterations);
+
+      auto start = Clock::now();
+
+      for (uint32_t n = 0; n < iterations; n++) {
+          for (size_t i = 0; i < shaders.size(); i++) {
+              tasks.push_back(scheduler.spawn(TaskPriority::Prefetch, [&, n, i] {
+                  compile(shaders[i], results[n][i]);
+              }));
+          }
+      }
+
+      for (const auto& t : tasks)
+          scheduler.wait(t);
+
+      wallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    uint32_t supported = 0;
+    uint32_t pruned = 0;
+    uint64_t strictClamps = 0, fastClamps = 0, bindings = 0, bindingsUsed = 0;
+    uint64_t spirvWords = 0, spirvPrunedWords = 0, totalNs = 0;
+    bool first = true;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"dxso\",\n");
+    printf("  \"traces\": \"%s\",\n", traces);
+    printf("  \"spirv\": \"%s\",\n", spirv ? spirv : "");
+    printf("  \"shaders\": [\n");
+
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const Shader& s = shaders[i];
+        const Result& r = results[0][i];
+
+        uint64_t ns = 0;
+        for (uint32_t n = 0; n < iterations; n++)
+            ns += results[n][i].ns;
+
+        double us = double(ns) / 1000.0 / iterations;
+        totalNs += ns;
+
+        printf("%s    { \"name\": \"%s\", \"bytes\": %zu, \"supported\": %s, \"frontend_us\": %.2f",
+            first ? "" : ",\n", s.name.c_str(), s.code.size() * sizeof(uint32_t), r.supported ? "true" : "false", us);
+        first = false;
+
+        if (r.supported) {
+            supported++;
+            strictClamps += r.strictClamps;
+            fastClamps   += r.fastClamps;
+            bindings     += r.bindings;
+
+            printf(", \"instructions\": %u, \"strict_clamps\": %u, \"fast_clamps\": %u, \"bindings\": %u",
+                r.instructions, r.strictClamps, r.fastClamps, r.bindings);
+
+            if (r.spirvPruned) {
+                spirvWords       += s.spirv.size();
+                spirvPrunedWords += r.spirvPruned;
+                bindingsUsed     += r.bindingsUsed;
+                pruned           += 1;
+
+                printf(", \"spirv_bytes\": %zu, \"spirv_bytes_pruned\": %zu, \"bindings_used\": %u",
+                    s.spirv.size() * sizeof(uint32_t), r.spirvPruned * sizeof(uint32_t), r.bindingsUsed);
+            }
+        }
+
+        printf(" }");
+    }
+
+    size_t compiles = shaders.size() * iterations;
+
+    printf("\n  ],\n");
+    printf("  \"total\": {\n");
+    printf("    \"trace_entries\": %u,\n", objects);
+    printf("    \"unique\": %zu,\n", shaders.size());
+    printf("    \"supported\": %u,\n", supported);
+    printf("    \"spirv_paired\": %u,\n", paired);
+    printf("    \"threads\": %u,\n", workers);
+    printf("    \"iterations\": %u,\n", iterations);
+    printf("    \"strict_clamps\": %llu,\n", (unsigned long long)strictClamps);
+    printf("    \"fast_clamps\": %llu,\n", (unsigned long long)fastClamps);
+    printf("    \"bindings_avg\": %.2f,\n", supported ? double(bindings) / supported : 0.0);
+    printf("    \"bindings_used_avg\": %.2f,\n", pruned ? double(bindingsUsed) / pruned : 0.0);
+    printf("    \"spirv_bytes\": %llu,\n", (unsigned long long)spirvWords * 4);
+    printf("    \"spirv_bytes_pruned\": %llu,\n", (unsigned long long)spirvPrunedWords * 4);
+    printf("    \"backend_timed\": false,\n");
+    printf("    \"frontend_us_avg\": %.2f,\n", double(totalNs) / 1000.0 / compiles);
+    printf("    \"wall_ms\": %.2f,\n", wallMs);
+    printf("    \"frontend_shaders_per_s\": %.0f\n", wallMs > 0.0 ? double(compiles) * 1000.0 / wallMs : 0.0);
+    printf("  }\n");
+    printf("}\n");
+
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Triangle Fan Conversion Benchmark
+ *
+ * Measures the fan to list conversion in src/d3d9/d3d9_fan_convert.h
+ * against converting every fan draw, as the translation layers do
+ * today:
+ *
+ * - per_frame: a frame of fan draws modelled on FNV (UI quads and
+ *   particle fans drawn non-indexed, LOD meshes from static index
+ *   buffers, a few DrawIndexedPrimitiveUP fans), reporting index
+ *   conversions per frame and CPU time per frame
+ * - pattern: GB/s for generating non-indexed fan indices with the
+ *   SIMD kernel and the scalar reference
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_fan_convert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct FanDraw {
+    uint32_t buffer;      ///< Index buffer, 0 for non-indexed, ~0u for UP
+    uint32_t startIndex;
+    uint32_t primCount;
+};
+
+int main(int argc, char** argv) {
+    uint32_t frames = 500;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(65);
+
+    // Eight static index buffers
+    std::vector<std::vector<uint16_t>> buffers(8, std::vector<uint16_t>(16384));
+    for (auto& b : buffers) {
+        for (auto& i : b)
+            i = uint16_t(rng() % 4096);
+    }
+
+    // 400 fan draws: 240 UI quads, 100 particle fans, 50 mesh fans, 10 UP fans
+    std::vector<FanDraw> frame;
+    for (uint32_t i = 0; i < 240; i++)
+        frame.push_back({ 0, 0, 2 });
+    for (uint32_t i = 0; i < 100; i++)
+        frame.push_back({ 0, 0, uint32_t(8 + rng() % 56) });
+    for (uint32_t i = 0; i < 50; i++)
+        frame.push_back({ uint32_t(1 + rng() % 8), uint32_t(rng() % 60) * 256, uint32_t(16 + rng() % 200) });
+    for (uint32_t i = 0; i < 10; i++)
+        frame.push_back({ ~0u, uint32_t(rng() % 60) * 256, uint32_t(4 + rng() % 20) });
+    std::shuffle(frame.begin(), frame.end(), rng);
+
+    auto source = [&] (const FanDraw& d) -> const uint16_t* {
+        return &buffers[d.buffer == ~0u ? 0 : d.buffer - 1][d.startIndex];
+    };
+
+    // Convert every draw
+    std::vector<uint16_t> scratch(3 * 1024);
+    uint64_t sink = 0;
+    uint32_t baselineConversions = 0;
+
+    auto start = Clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        for (const auto& d : frame) {
+            if (!d.buffer)
+                fan_scalar::Generate(scratch.data(), 0, d.primCount);
+            else
+                fan_scalar::Convert(scratch.data(), source(d), d.primCount);
+
+            sink += scratch[d.primCount * 3 - 1];
+            baselineConversions++;
+        }
+    }
+    double baselineUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+
+    // Cached conversion
+    D3D9FanConverter converter;
+
+    start = Clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        for (const auto& d : frame) {
+            D3D9FanDraw draw;
+
+            if (!d.buffer) {
+                draw = converter.ConvertNonIndexed(d.primCount);
+            } else {
+                draw = converter.ConvertIndexed(d.buffer == ~0u ? 0 : d.buffer, 1,
+                    D3D9IndexType::Uint16, source(d), d.startIndex, d.primCount);
+            }
+
+            sink += draw.id;
+        }
+    }
+    double cachedUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+
+    D3D9FanCacheStats stats = converter.GetStats();
+    uint64_t cachedConversions = stats.indexedMisses + stats.uncached + stats.patternGrowths;
+
+    // Pattern generation throughput, 16-bit, 64k triangles
+    const uint32_t patternTris = 65534;
+    const uint32_t patternIterations = 2000;
+    std::vector<uint16_t> pattern(patternTris * 3);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < patternIterations; i++) {
+        fan_scalar::Generate(pattern.data(), 0, patternTris);
+        sink += pattern[i % pattern.size()];
+    }
+    double scalarSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < patternIterations; i++) {
+        fan_simd::Generate(pattern.data(), patternTris);
+        sink += pattern[i % pattern.size()];
+    }
+    double simdSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    double patternBytes = double(pattern.size()) * sizeof(uint16_t) * patternIterations;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"fan_convert\",\n");
+    printf("  \"fan_draws_per_frame\": %zu,\n", frame.size());
+    printf("  \"per_frame\": {\n");
+    printf("    \"conversions_baseline\": %.1f,\n", double(baselineConversions) / frames);
+    printf("    \"conversions_cached\": %.2f,\n", double(cachedConversions) / frames);
+    printf("    \"conversions_avoided\": %.1f,\n", double(baselineConversions - cachedConversions) / frames);
+    printf("    \"baseline_us\": %.2f,\n", baselineUs);
+    printf("    \"cached_us\": %.2f,\n", cachedUs);
+    printf("    \"speedup\": %.2f\n", baselineUs / cachedUs);
+    printf("  },\n");
+    printf("  \"pattern\": { \"scalar_gb_per_s\": %.2f, \"simd_gb_per_s\": %.2f, \"speedup\": %.2f },\n",
+        patternBytes / scalarSec / 1e9, patternBytes / simdSec / 1e9, scalarSec / simdSec);
+    printf("  \"cached_bytes\": %u,\n", stats.cachedBytes);
+    printf("  \"checksum\": %llu\n", (unsigned long long)(sink & 0xffff));
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,306 @@
+/*
+ * Float Emulation Benchmark
+ *
+ * Reports what the FastStrict plan in src/dxso/dxso_float_emulation.h
+ * saves over Strict, per shader:
+ *
+ * - multiplies: legacy multiplies (one per matrix row)
+ * - strict_clamps / fast_clamps: NClamp instructions each level emits,
+ *   the delta is the SPIR-V instructions FastStrict removes
+ * - analyze_us: time to decode and analyse the shader, which is added
+ *   to every shader compile
+ *
+ * Without arguments, runs on built-in shaders modelled on FNV's (skinned
+ * and static vertex shaders, diffuse, normal mapped, bloom and tonemap
+ * pixel shaders). With --shaders DIR, runs on the .dxso files that
+ * tools/analyze_d3d9trace.py --dump-shaders DIR extracts from traces.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "dxso/dxso_float_emulation.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Shader {
+    std::string           name;
+    std::vector<uint32_t> code;
+};
+
+static uint32_t reg(DxsoRegisterType type, uint32_t index) {
+    uint32_t t = uint32_t(type);
+    return 0x80000000u | ((t & 0x7) << 28) | ((t & 0x18) << 8) | index;
+}
+
+static uint32_t dst(DxsoRegisterType type, uint32_t index, uint32_t mask = 0xf, bool sat = false) {
+    return reg(type, index) | (mask << 16) | (sat ? 1u << 20 : 0u);
+}
+
+static uint32_t src(DxsoRegisterType type, uint32_t index, uint32_t swizzle = 0xe4) {
+    return reg(type, index) | (swizzle << 16);
+}
+
+struct Assembler {
+    Shader shader;
+
+    Assembler(const char* name, bool ps) {
+        shader.name = name;
+        shader.code.push_back(ps ? 0xffff0200u : 0xfffe0200u);
+    }
+
+    void op(DxsoOpcode opcode, std::initializer_list<uint32_t> params) {
+        shader.code.push_back(uint32_t(opcode) | (uint32_t(params.size()) << 24));
+        shader.code.insert(shader.code.end(), params.begin(), params.end());
+    }
+
+    void def(uint32_t index, float x, float y, float z, float w) {
+        float v[4] = { x, y, z, w };
+        uint32_t u[4];
+        memcpy(u, v, sizeof(u));
+        op(DxsoOpcode::Def, { dst(DxsoRegisterType::Const, index), u[0], u[1], u[2], u[3] });
+    }
+
+    Shader finish() {
+        shader.code.push_back(uint32_t(DxsoOpcode::End));
+        return shader;
+    }
+};
+
+static const DxsoRegisterType R  = DxsoRegisterType::Temp;
+static const DxsoRegisterType V  = DxsoRegisterType::Input;
+static const DxsoRegisterType C  = DxsoRegisterType::Const;
+static const DxsoRegisterType T  = DxsoRegisterType::Addr;
+static const DxsoRegisterType S  = DxsoRegisterType::Sampler;
+static const DxsoRegisterType O  = DxsoRegisterType::Output;
+static const DxsoRegisterType OC = DxsoRegisterType::ColorOut;
+
+static std::vector<Shader> builtin_shaders() {
+    std::vector<Shader> shaders;
+
+    {   // Static geometry: transform, one directional light, fog
+        Assembler a("vs_static", false);
+        a.def(40, 0.5f, 1.0f, 0.0f, 0.0f);
+        a.op(DxsoOpcode::M4x4, { dst(DxsoRegisterType::RasterizerOut, 0), src(V, 0), src(C, 0) });
+        a.op(DxsoOpcode::M3x3, { dst(R, 0, 0x7), src(V, 1), src(C, 4) });
+        a.op(DxsoOpcode::Dp3, { dst(R, 1, 0x1), src(R, 0), src(C, 8) });
+        a.op(DxsoOpcode::Max, { dst(R, 1, 0x1), src(R, 1), src(C, 40, 0xaa) });
+        a.op(DxsoOpcode::Mad, { dst(O, 0), src(R, 1, 0x00), src(C, 9), src(C, 10) });
+        a.op(DxsoOpcode::Dp4, { dst(R, 2, 0x1), src(V, 0), src(C, 2) });
+        a.op(DxsoOpcode::Mad, { dst(O, 1, 0x1, true), src(R, 2, 0x00), src(C, 11), src(C, 11, 0x55) });
+        a.op(DxsoOpcode::Mov, { dst(O, 2), src(V, 2) });
+        shaders.push_back(a.finish());
+    }
+
+    {   // Skinned: four bone blend
+        Assembler a("vs_skinned", false);
+        a.def(90, 1.0f, 0.0f, 0.0f, 0.0f);
+        a.op(DxsoOpcode::M4x4, { dst(R, 0), src(V, 0), src(C, 20) });
+        a.op(DxsoOpcode::M4x4, { dst(R, 1), src(V, 0), src(C, 24) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0), src(R, 0), src(V, 3, 0x00) });
+        a.op(DxsoOpcode::Mad, { dst(R, 0), src(R, 1), src(V, 3, 0x55), src(R, 0) });
+        a.op(DxsoOpcode::M4x4, { dst(DxsoRegisterType::RasterizerOut, 0), src(R, 0), src(C, 0) });
+        a.op(DxsoOpcode::Mov, { dst(O, 0), src(V, 2) });
+        shaders.push_back(a.finish());
+    }
+
+    {   // Diffuse texture times vertex color times material
+        Assembler a("ps_diffuse", true);
+        a.op(DxsoOpcode::Tex, { dst(R, 0), src(T, 0), src(S, 0) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0), src(R, 0), src(V, 0) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0, 0x7), src(R, 0), src(C, 0) });
+        a.op(DxsoOpcode::Mov, { dst(OC, 0), src(R, 0) });
+        shaders.push_back(a.finish());
+    }
+
+    {   // Normal map, one light, specular from the alpha channel
+        Assembler a("ps_normalmap", true);
+        a.def(5, 2.0f, -1.0f, 0.5f, 0.0f);
+        a.op(DxsoOpcode::Tex, { dst(R, 0), src(T, 0), src(S, 0) });
+        a.op(DxsoOpcode::Tex, { dst(R, 1), src(T, 0), src(S, 1) });
+        a.op(DxsoOpcode::Mad, { dst(R, 0, 0x7), src(R, 0), src(C, 5, 0x00), src(C, 5, 0x55) });
+        a.op(DxsoOpcode::Nrm, { dst(R, 2), src(T, 1) });
+        a.op(DxsoOpcode::Dp3, { dst(R, 3, 0x1, true), src(R, 0), src(R, 2) });
+        a.op(DxsoOpcode::Mul, { dst(R, 4, 0x7), src(R, 3, 0x00), src(C, 1) });
+        a.op(DxsoOpcode::Add, { dst(R, 4, 0x7, true), src(R, 4), src(C, 2) });
+        a.op(DxsoOpcode::Mul, { dst(R, 1, 0x7), src(R, 1), src(R, 4) });
+        a.op(DxsoOpcode::Mul, { dst(R, 3, 0x2), src(R, 3, 0x00), src(R, 3, 0x00) });
+        a.op(DxsoOpcode::Mul, { dst(R, 3, 0x2), src(R, 3, 0x55), src(R, 0, 0xff) });
+        a.op(DxsoOpcode::Mad, { dst(R, 1, 0x7), src(R, 3, 0x55), src(C, 3), src(R, 1) });
+        a.op(DxsoOpcode::Mul, { dst(R, 1, 0x7), src(R, 1), src(V, 0) });
+        a.op(DxsoOpcode::Mov, { dst(OC, 0), src(R, 1) });
+        shaders.push_back(a.finish());
+    }
+
+    {   // Four tap bloom with threshold
+        Assembler a("ps_bloom", true);
+        a.def(0, 0.25f, 0.6f, 2.5f, 1.0f);
+        for (uint32_t i = 0; i < 4; i++)
+            a.op(DxsoOpcode::Tex, { dst(R, i), src(T, i), src(S, 0) });
+        a.op(DxsoOpcode::Add, { dst(R, 0), src(R, 0), src(R, 1) });
+        a.op(DxsoOpcode::Add, { dst(R, 2), src(R, 2), src(R, 3) });
+        a.op(DxsoOpcode::Add, { dst(R, 0), src(R, 0), src(R, 2) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0), src(R, 0), src(C, 0, 0x00) });
+        a.op(DxsoOpcode::Add, { dst(R, 1, 0xf, true), src(R, 0), src(C, 0, 0x55) });
+        a.op(DxsoOpcode::Mul, { dst(R, 1), src(R, 1), src(C, 0, 0xaa) });
+        a.op(DxsoOpcode::Mul, { dst(R, 1), src(R, 1), src(C, 4) });
+        a.op(DxsoOpcode::Mov, { dst(OC, 0), src(R, 1) });
+        shaders.push_back(a.finish());
+    }
+
+    {   // HDR tonemap: luminance, exposure from the adapted luminance
+        Assembler a("ps_tonemap", true);
+        a.def(0, 0.299f, 0.587f, 0.114f, 0.0f);
+        a.def(1, 1.0f, 0.18f, 0.0001f, 0.5f);
+        a.op(DxsoOpcode::Tex, { dst(R, 0), src(T, 0), src(S, 0) });
+        a.op(DxsoOpcode::Tex, { dst(R, 1), src(T, 0), src(S, 1) });
+        a.op(DxsoOpcode::Dp3, { dst(R, 2, 0x1), src(R, 0), src(C, 0) });
+        a.op(DxsoOpcode::Add, { dst(R, 1, 0x1), src(R, 1), src(C, 1, 0xaa) });
+        a.op(DxsoOpcode::Rcp, { dst(R, 1, 0x1), src(R, 1, 0x00) });
+        a.op(DxsoOpcode::Mul, { dst(R, 1, 0x1), src(R, 1), src(C, 1, 0x55) });
+        a.op(DxsoOpcode::Mul, { dst(R, 3, 0x1), src(R, 2), src(R, 1) });
+        a.op(DxsoOpcode::Add, { dst(R, 4, 0x1), src(R, 3), src(C, 1, 0x00) });
+        a.op(DxsoOpcode::Rcp, { dst(R, 4, 0x1), src(R, 4, 0x00) });
+        a.op(DxsoOpcode::Mul, { dst(R, 3, 0x1, true), src(R, 3), src(R, 4) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0, 0x7), src(R, 0), src(R, 1, 0x00) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0, 0x7, true), src(R, 0), src(R, 4, 0x00) });
+        a.op(DxsoOpcode::Lrp, { dst(R, 0, 0x7), src(C, 2, 0xff), src(R, 0), src(R, 3, 0x00) });
+        a.op(DxsoOpcode::Mul, { dst(R, 0, 0x7), src(R, 0), src(C, 1, 0xff) });
+        a.op(DxsoOpcode::Mov, { dst(OC, 0), src(R, 0) });
+        shaders.push_back(a.finish());
+    }
+
+    return shaders;
+}
+
+static std::vector<Shader> load_shaders(const char* dir) {
+    std::vector<Shader> shaders;
+    DIR* d = opendir(dir);
+
+    if (!d)
+        return shaders;
+
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+
+        if (name.size() < 5 || name.compare(name.size() - 5, 5, ".dxso"))
+            continue;
+
+        FILE* f = fopen((std::string(dir) + "/" + name).c_str(), "rb");
+        if (!f)
+            continue;
+
+        Shader s;
+        s.name = name.substr(0, name.size() - 5);
+
+        uint32_t token;
+        while (fread(&token, sizeof(token), 1, f) == 1)
+            s.code.push_back(token);
+
+        fclose(f);
+        shaders.push_back(std::move(s));
+    }
+
+    closedir(d);
+    return shaders;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = nullptr;
+    uint32_t iterations = 2000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--shaders") && i + 1 < argc)
+            dir = argv[++i];
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--shaders DIR] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Shader> shaders = dir ? load_shaders(dir) : builtin_shaders();
+
+    if (shaders.empty()) {
+        fprintf(stderr, "No shaders found in %s\n", dir);
+        return 1;
+    }
+
+    uint64_t multiplies = 0, strictClamps = 0, fastClamps = 0;
+    uint32_t analyzed = 0, unsupported = 0;
+    double totalUs = 0.0;
+    uint64_t sink = 0;
+    bool first = true;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"float_emulation\",\n");
+    printf("  \"source\": \"%s\",\n", dir ? dir : "builtin");
+    printf("  \"shaders\": [\n");
+
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const Shader& s = shaders[i];
+        DxsoProgram program;
+
+        if (!DxsoDecode(s.code.data(), s.code.size(), program)) {
+            unsupported++;
+            continue;
+        }
+
+        uint32_t runs = dir ? iterations / 10 + 1 : iterations;
+
+        auto start = Clock::now();
+        for (uint32_t n = 0; n < runs; n++) {
+            DxsoProgram p;
+            DxsoDecode(s.code.data(), s.code.size(), p);
+            sink += DxsoFloatEmulationPlan(p, D3D9FloatEmulation::FastStrict).GetStats().clamps;
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / runs;
+
+        DxsoFloatEmulationStats stats = DxsoFloatEmulationPlan(program, D3D9FloatEmulation::FastStrict).GetStats();
+
+        multiplies   += stats.multiplies;
+        strictClamps += stats.strictClamps;
+        fastClamps   += stats.clamps;
+        analyzed     += stats.analyzed;
+        totalUs      += us;
+
+        printf("%s    { \"name\": \"%s\", \"instructions\": %u, \"multiplies\": %u, "
+               "\"strict_clamps\": %u, \"fast_clamps\": %u, \"delta\": %d, "
+               "\"analyzed\": %s, \"analyze_us\": %.2f }",
+            first ? "" : ",\n", s.name.c_str(), stats.instructions, stats.multiplies, stats.strictClamps, stats.clamps,
+            int(stats.clamps) - int(stats.strictClamps), stats.analyzed ? "true" : "false",
+            us);
+        first = false;
+    }
+
+    uint32_t decoded = uint32_t(shaders.size()) - unsupported;
+
+    printf("\n  ],\n");
+    printf("  \"total\": {\n");
+    printf("    \"shaders\": %u,\n", decoded);
+    printf("    \"unsupported\": %u,\n", unsupported);
+    printf("    \"analyzed\": %u,\n", analyzed);
+    printf("    \"multiplies\": %llu,\n", (unsigned long long)multiplies);
+    printf("    \"strict_clamps\": %llu,\n", (unsigned long long)strictClamps);
+    printf("    \"fast_clamps\": %llu,\n", (unsigned long long)fastClamps);
+    printf("    \"clamps_removed_pct\": %.1f,\n",
+        strictClamps ? 100.0 * double(strictClamps - fastClamps) / double(strictClamps) : 0.0);
+    printf("    \"analyze_us_avg\": %.2f\n", decoded ? totalUs / decoded : 0.0);
+    printf("  },\n");
+    printf("  \"checksum\": %llu\n", (unsigned long long)(sink & 0xffff));
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Query Resolve Benchmark
+ *
+ * Counts command list submits per frame caused by occlusion query
+ * polling, for DXVK's per-query flush on D3DGETDATA_FLUSH and for the
+ * batched resolver in src/d3d9/d3d9_query_resolver.h.
+ *
+ * The frame is modelled on FNV's occlusion culling: every object
+ * issues a query around its draw, and reads the previous frame's
+ * result with D3DGETDATA_FLUSH right before. Optionally a few queries
+ * per frame are spun on immediately (sun/flare visibility). Time is
+ * counted in ticks, one per draw or poll, and a submitted command
+ * list completes 'latency' frames of ticks later.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_query_resolver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace dxvk;
+
+struct Scenario {
+    const char* name;
+    uint32_t objects;       // queries polled next frame
+    uint32_t spinQueries;   // queries spun on within the frame
+    uint32_t latency;       // frames between submit and completion
+};
+
+/* Simulated queue: command lists complete a fixed number of ticks
+ * after they are submitted */
+struct SimQueue {
+    uint64_t ticksPerFrame;
+    uint64_t latencyTicks;
+    uint64_t tick = 0;
+    uint64_t recording = 1;
+    uint64_t recorded = 0;  // commands in the current list
+    uint64_t submits = 0;
+    std::vector<uint64_t> submitTick = { 0 };  // per sequence number
+
+    SimQueue(uint64_t ticksPerFrame, uint32_t latency)
+    : ticksPerFrame(ticksPerFrame), latencyTicks(ticksPerFrame * latency) { }
+
+    void submit() {
+        submitTick.push_back(tick);
+        recording++;
+        recorded = 0;
+        submits++;
+    }
+
+    bool isDone(uint64_t seq) const {
+        return seq < recording && tick >= submitTick[seq] + latencyTicks;
+    }
+
+    void wait(uint64_t seq) {
+        if (seq >= recording)
+            submit();
+        tick = std::max(tick, submitTick[seq] + latencyTicks);
+    }
+};
+
+/* DXVK today: a query is available once its command list completed,
+ * and every D3DGETDATA_FLUSH poll on a pending query submits the
+ * current command list if it has any work in it */
+static double run_baseline(const Scenario& s, uint32_t frames) {
+    SimQueue queue(uint64_t(s.objects) * 2 + s.spinQueries * 8, s.latency);
+
+    std::vector<uint64_t> querySeq(s.objects, 0);
+    uint64_t frameSubmits = 0;
+
+    auto poll = [&] (uint64_t seq) {
+        queue.tick++;
+        if (!seq || queue.isDone(seq))
+            return true;
+        if (queue.recorded) {
+            queue.submit();
+            frameSubmits++;
+        }
+        return false;
+    };
+
+    for (uint32_t f = 0; f < frames; f++) {
+        for (uint32_t i = 0; i < s.objects; i++) {
+            poll(querySeq[i]);
+            queue.tick++;
+            queue.recorded++;
+            querySeq[i] = queue.recording;
+        }
+
+        for (uint32_t i = 0; i < s.spinQueries; i++) {
+            queue.recorded++;
+            uint64_t seq = queue.recording;
+            while (!poll(seq))
+                continue;
+        }
+
+        queue.submit();
+    }
+
+    return double(frameSubmits) / frames;
+}
+
+static double run_batched(const Scenario& s, uint32_t frames, D3D9QueryResolverStats& stats) {
+    SimQueue queue(uint64_t(s.objects) * 2 + s.spinQueries * 8, s.latency);
+
+    D3D9QueryResolverOptions options;
+    std::vector<D3D9QueryResultSlot> results(options.poolSize);
+
+    struct Copy { uint64_t seq; uint32_t first, count; };
+    std::vector<Copy> copies;
+
+    // Copies land in the mapped buffer once their command list is done
+    auto applyCopies = [&] (uint64_t seq) {
+        for (auto& c : copies) {
+            if (c.seq <= seq) {
+                for (uint32_t i = c.first; i < c.first + c.count; i++)
+                    results[i] = { 1, 1 };
+                c.seq = ~0ull;
+            }
+        }
+    };
+
+    auto resolver = std::make_unique<D3D9QueryBatchResolver>(options, results.data(),
+        [&] (uint32_t first, uint32_t count) { copies.push_back({ queue.recording, first, count }); },
+        [&] () { return queue.recording; },
+        [&] (uint64_t seq) {
+            if (!queue.isDone(seq))
+                return false;
+            applyCopies(seq);
+            return true;
+        },
+        [&] (uint64_t seq) {
+            queue.wait(seq);
+            applyCopies(seq);
+        });
+
+    std::vector<D3D9BatchedQuery> objects(s.objects);
+    std::vector<D3D9BatchedQuery> spins(s.spinQueries);
+    uint64_t value = 0;
+
+    for (uint32_t f = 0; f < frames; f++) {
+        for (auto& q : objects) {
+            queue.tick++;
+            resolver->GetData(q, true, value);
+
+            resolver->Begin(q);
+            queue.tick++;
+            queue.recorded++;
+            resolver->End(q);
+        }
+
+        for (auto& q : spins) {
+            resolver->Begin(q);
+            queue.recorded++;
+            resolver->End(q);
+
+            D3D9QueryStatus status;
+            while ((status = resolver->GetData(q, true, value)) != D3D9QueryStatus::Ready) {
+                queue.tick++;
+                if (status == D3D9QueryStatus::Flush)
+                    queue.submit();
+            }
+        }
+
+        resolver->EndFrame();
+        queue.submit();
+
+        // Keep the copy list short
+        copies.erase(std::remove_if(copies.begin(), copies.end(),
+            [] (const Copy& c) { return c.seq == ~0ull; }), copies.end());
+    }
+
+    stats = resolver->GetStats();
+    return double(stats.earlyFlushes + stats.waits) / frames;
+}
+
+int main(int argc, char** argv) {
+    uint32_t frames = 300;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    static const Scenario scenarios[] = {
+        { "interior",       150, 0, 1 },
+        { "exterior",       400, 0, 2 },
+        { "exterior_deep",  400, 0, 3 },
+        { "exterior_spin",  400, 2, 2 },
+    };
+
+    printf("{\n");
+    printf("  \"benchmark\": \"query_resolve\",\n");
+    printf("  \"frames\": %u,\n", frames);
+    printf("  \"scenarios\": [\n");
+
+    for (size_t i = 0; i < std::size(scenarios); i++) {
+        const Scenario& s = scenarios[i];
+
+        D3D9QueryResolverStats stats;
+        double baseline = run_baseline(s, frames);
+        double batched = run_batched(s, frames, stats);
+
+        printf("    { \"name\": \"%s\", \"queries_per_frame\": %u, \"latency_frames\": %u, "
+               "\"query_submits_per_frame_flush\": %.2f, \"query_submits_per_frame_batched\": %.2f, "
+               "\"copies_per_frame\": %.2f, \"blocking_waits\": %llu }%s\n",
+            s.name, s.objects + s.spinQueries, s.latency, baseline, batched,
+            double(stats.copies) / frames, (unsigned long long)stats.waits,
+            i + 1 < std::size(scenarios) ? "," : "");
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Sampler Cache Benchmark
+ *
+ * Measures sampler lookups per second for a mutex-protected
+ * unordered_map, as DXVK's D3D9 sampler map works today, and for
+ * the lock-free cache in src/d3d9/d3d9_sampler_cache.h, on one
+ * thread and with several threads looking up at once.
+ *
+ * The key stream is modelled on FNV: a few hundred distinct sampler
+ * states with a Zipf distribution (a handful of wrap/linear states
+ * dominate). Each lookup packs the raw D3D9 sampler state first, so
+ * packing cost is included. The d3d9 traces carry no sampler state,
+ * so the stream is synthetic.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_sampler_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+/* DXVK today: sampler map behind a lock */
+class MutexSamplerMap {
+public:
+    uint32_t lookup(D3D9SamplerKey key) {
+        std::lock_guard lock(m_mutex);
+        auto entry = m_map.find(key);
+        if (entry != m_map.end())
+            return entry->second;
+        uint32_t slot = uint32_t(m_map.size());
+        m_map.emplace(key, slot);
+        return slot;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::unordered_map<D3D9SamplerKey, uint32_t> m_map;
+};
+
+static std::vector<D3D9SamplerState> make_states(uint32_t count, std::mt19937& rng) {
+    std::vector<D3D9SamplerState> states(count);
+    for (auto& s : states) {
+        s.addressU = 1 + rng() % 4;
+        s.addressV = 1 + rng() % 4;
+        s.addressW = 1 + rng() % 4;
+        s.magFilter = 1 + rng() % 3;
+        s.minFilter = 1 + rng() % 3;
+        s.mipFilter = rng() % 3;
+        s.maxAnisotropy = 1u << (rng() % 5);
+        s.maxMipLevel = rng() % 4;
+        s.mipLodBias = float(int32_t(rng() % 9) - 4) * 0.25f;
+        s.borderColor = rng();
+    }
+    return states;
+}
+
+/* Zipf-distributed stream of state indices */
+static std::vector<uint32_t> make_stream(uint32_t states, uint32_t length, std::mt19937& rng) {
+    std::vector<double> cdf(states);
+    double sum = 0.0;
+    for (uint32_t i = 0; i < states; i++)
+        cdf[i] = (sum += 1.0 / double(i + 1));
+
+    std::uniform_real_distribution<double> dist(0.0, sum);
+    std::vector<uint32_t> stream(length);
+    for (auto& s : stream)
+        s = uint32_t(std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin());
+    return stream;
+}
+
+template<typename Fn>
+static double lookups_per_second(uint32_t threads, uint32_t iterations, size_t perThread, Fn&& fn) {
+    double best = 1e30;
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        std::atomic<bool> go = { false };
+        std::vector<std::thread> workers;
+
+        for (uint32_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                fn(t);
+            });
+        }
+
+        auto start = Clock::now();
+        go = true;
+
+        for (auto& w : workers)
+            w.join();
+
+        best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    return double(perThread) * threads / best;
+}
+
+int main(int argc, char** argv) {
+    uint32_t stateCount = 300;
+    uint32_t streamLength = 1u << 20;
+    uint32_t iterations = 5;
+    uint32_t maxThreads = 4;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--states") && i + 1 < argc)
+            stateCount = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--length") && i + 1 < argc)
+            streamLength = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            maxThreads = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--states N] [--length N] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(60);
+    std::vector<D3D9SamplerState> states = make_states(stateCount, rng);
+    std::vector<uint32_t> stream = make_stream(stateCount, streamLength, rng);
+
+    D3D9SamplerCacheOptions options;
+    std::vector<D3D9SamplerKey> heap(options.heapSize);
+    D3D9SamplerCache cache(options, [&] (uint32_t slot, D3D9SamplerKey key) { heap[slot] = key; });
+    MutexSamplerMap map;
+
+    // Count distinct keys after normalization
+    std::unordered_map<D3D9SamplerKey, uint32_t> distinct;
+    for (const auto& s : states)
+        distinct[D3D9PackSamplerKey(s)]++;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"sampler_cache\",\n");
+    printf("  \"states\": %u,\n", stateCount);
+    printf("  \"distinct_keys\": %zu,\n", distinct.size());
+    printf("  \"stream_length\": %u,\n", streamLength);
+    printf("  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    printf("  \"results\": [\n");
+
+    for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+        std::atomic<uint64_t> sink = { 0 };
+
+        double mutexRate = lookups_per_second(threads, iterations, stream.size(), [&] (uint32_t t) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < stream.size(); i++)
+                sum += map.lookup(D3D9PackSamplerKey(states[stream[(i + t * 7919) % stream.size()]]));
+            sink += sum;
+        });
+
+        double cacheRate = lookups_per_second(threads, iterations, stream.size(), [&] (uint32_t t) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < stream.size(); i++)
+                sum += cache.Lookup(states[stream[(i + t * 7919) % stream.size()]]);
+            sink += sum;
+        });
+
+        printf("    { \"threads\": %u, \"mutex_map_mlookups_per_s\": %.1f, "
+               "\"lockfree_mlookups_per_s\": %.1f, \"speedup\": %.2f }%s\n",
+            threads, mutexRate / 1e6, cacheRate / 1e6, cacheRate / mutexRate,
+            threads * 2 <= maxThreads ? "," : "");
+    }
+
+    D3D9SamplerCacheStats stats = cache.GetStats();
+
+    printf("  ],\n");
+    printf("  \"misses\": %llu,\n", (unsigned long long)stats.misses);
+    printf("  \"evictions\": %llu\n", (unsigned long long)stats.evictions);
+    printf("}\n");
+    return 0;
+}
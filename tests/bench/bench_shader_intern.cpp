@@ -0,0 +1,211 @@
+/*
+ * Shader Intern Table Benchmark
+ *
+ * Replays a shader creation trace through the intern table in
+ * src/d3d9/d3d9_shader_intern.h and reports:
+ *
+ * - creations / translations / duplicates: Create*Shader calls, how many
+ *   of them translated bytecode and how many got an existing shader
+ * - bytes_saved: bytecode that was not translated again
+ * - lookup_ns: cost of a creation that hits, hashing plus the full
+ *   compare, which every duplicate pays instead of a translation
+ * - size_sweep: lookup cost by bytecode size
+ *
+ * Without arguments, replays a built-in trace modelled on FNV (a few
+ * hundred shaders, each created once per material instance). With
+ * --shaders DIR, replays DIR/creates.txt as written by
+ * tools/analyze_d3d9trace.py --dump-shaders DIR.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_shader_intern.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct CompiledShader {
+    size_t dwords;
+};
+
+struct Trace {
+    std::vector<std::vector<uint32_t>> shaders;
+    std::vector<uint32_t>              creates;
+};
+
+static uint32_t lcg(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static std::vector<uint32_t> make_shader(uint32_t seed, uint32_t instructions) {
+    uint32_t state = seed * 2654435761u + 1;
+    std::vector<uint32_t> code = { (seed & 1) ? 0xffff0300u : 0xfffe0300u };
+
+    for (uint32_t i = 0; i < instructions; i++) {
+        code.push_back(0x4u | (4u << 24));  // mad
+        code.push_back(0x800f0000u | (lcg(state) % 32));
+        code.push_back(0x80e40000u | (lcg(state) % 32));
+        code.push_back(0xa0e40000u | (lcg(state) % 256));
+        code.push_back(0x80e40000u | (lcg(state) % 32));
+    }
+
+    code.push_back(0x0000ffffu);
+    return code;
+}
+
+static Trace builtin_trace() {
+    Trace trace;
+    uint32_t state = 11;
+
+    for (uint32_t i = 0; i < 400; i++) {
+        trace.shaders.push_back(make_shader(i, 8 + lcg(state) % 120));
+
+        // Most shaders back a handful of materials, a few back hundreds
+        uint32_t instances = 1 + lcg(state) % 6;
+        if (lcg(state) % 20 == 0)
+            instances += 50 + lcg(state) % 200;
+
+        for (uint32_t j = 0; j < instances; j++)
+            trace.creates.push_back(i);
+    }
+
+    for (size_t i = trace.creates.size() - 1; i > 0; i--)
+        std::swap(trace.creates[i], trace.creates[lcg(state) % (i + 1)]);
+
+    return trace;
+}
+
+static Trace load_trace(const char* dir) {
+    Trace trace;
+    std::map<std::string, uint32_t> files;
+
+    FILE* list = fopen((std::string(dir) + "/creates.txt").c_str(), "r");
+    if (!list)
+        return trace;
+
+    char line[256];
+    while (fgets(line, sizeof(line), list)) {
+        std::string name = line;
+        while (!name.empty() && (name.back() == '\n' || name.back() == '\r'))
+            name.pop_back();
+
+        auto entry = files.find(name);
+
+        if (entry == files.end()) {
+            FILE* f = fopen((std::string(dir) + "/" + name).c_str(), "rb");
+            if (!f)
+                continue;
+
+            std::vector<uint32_t> code;
+            uint32_t token;
+            while (fread(&token, sizeof(token), 1, f) == 1)
+                code.push_back(token);
+            fclose(f);
+
+            entry = files.insert({ name, uint32_t(trace.shaders.size()) }).first;
+            trace.shaders.push_back(std::move(code));
+        }
+
+        trace.creates.push_back(entry->second);
+    }
+
+    fclose(list);
+    return trace;
+}
+
+static double lookup_ns(const std::vector<uint32_t>& code, uint32_t iterations) {
+    D3D9ShaderInternTable<CompiledShader> table;
+    auto translate = [] (const uint32_t*, size_t n) {
+        return std::make_unique<CompiledShader>(CompiledShader { n });
+    };
+
+    table.Intern(code.data(), code.size(), translate);
+
+    uint64_t sink = 0;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        sink += table.Intern(code.data(), code.size(), translate)->dwords;
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations;
+
+    return sink ? ns : 0.0;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = nullptr;
+    uint32_t iterations = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--shaders") && i + 1 < argc)
+            dir = argv[++i];
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--shaders DIR] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Trace trace = dir ? load_trace(dir) : builtin_trace();
+
+    if (trace.creates.empty()) {
+        fprintf(stderr, "No creation trace found in %s\n", dir);
+        return 1;
+    }
+
+    D3D9ShaderInternTable<CompiledShader> table;
+    uint64_t translated = 0;
+
+    auto start = Clock::now();
+    for (uint32_t index : trace.creates) {
+        const auto& code = trace.shaders[index];
+        table.Intern(code.data(), code.size(), [&] (const uint32_t*, size_t n) {
+            translated++;
+            return std::make_unique<CompiledShader>(CompiledShader { n });
+        });
+    }
+    double replayUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    D3D9ShaderInternStats stats = table.GetStats();
+
+    double lookupTotal = 0.0;
+    for (const auto& code : trace.shaders)
+        lookupTotal += lookup_ns(code, iterations / 100 + 1);
+
+    printf("{\n");
+    printf("  \"benchmark\": \"shader_intern\",\n");
+    printf("  \"source\": \"%s\",\n", dir ? dir : "builtin");
+    printf("  \"creations\": %llu,\n", (unsigned long long)stats.creations);
+    printf("  \"unique\": %zu,\n", trace.shaders.size());
+    printf("  \"translations\": %llu,\n", (unsigned long long)translated);
+    printf("  \"duplicates\": %llu,\n", (unsigned long long)stats.duplicates);
+    printf("  \"bytes_saved\": %llu,\n", (unsigned long long)stats.bytesSaved);
+    printf("  \"collisions\": %llu,\n", (unsigned long long)stats.collisions);
+    printf("  \"replay_us\": %.1f,\n", replayUs);
+    printf("  \"lookup_ns_avg\": %.1f,\n", lookupTotal / double(trace.shaders.size()));
+    printf("  \"size_sweep\": [\n");
+
+    static const uint32_t sizes[] = { 16, 64, 256, 1024, 4096 };
+
+    for (uint32_t i = 0; i < 5; i++) {
+        std::vector<uint32_t> code = make_shader(i, sizes[i] / 5);
+        printf("    { \"bytes\": %zu, \"lookup_ns\": %.1f }%s\n",
+            code.size() * sizeof(uint32_t), lookup_ns(code, iterations), i + 1 < 5 ? "," : "");
+    }
+
+    printf("  ]\n");
+    printf("}\n");
+
+    return translated == trace.shaders.size() ? 0 : 1;
+}
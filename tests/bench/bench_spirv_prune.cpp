@@ -0,0 +1,261 @@
+/*
+ * SPIR-V Binding Pruning Benchmark
+ *
+ * Reports what src/dxvk/dxvk_spirv_prune.h removes, per shader:
+ *
+ * - bindings_before / bindings_after: resource bindings the module
+ *   declares before and after pruning, i.e. descriptors the device
+ *   writes for every draw with the shader bound
+ * - words_before / words_after: module size
+ * - prune_us: time for the pass, which is added to every shader compile
+ *
+ * Without arguments, runs on built-in modules laid out like DxsoCompiler
+ * output (doubled color/depth sampler bindings, fixed function and
+ * shared data buffers, of which each shader only uses some). With
+ * --spirv DIR, runs on the .spv files make run-shaderdump writes.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "dxvk/dxvk_spirv_prune.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Shader {
+    std::string           name;
+    std::vector<uint32_t> code;
+};
+
+/* Declares every listed binding, loads the used ones */
+struct ModuleDesc {
+    const char*                     name;
+    std::initializer_list<uint32_t> images;     ///< Color image bindings, depth is +16
+    std::initializer_list<uint32_t> sampled;
+    std::initializer_list<uint32_t> buffers;
+    std::initializer_list<uint32_t> read;
+};
+
+static Shader build_module(const ModuleDesc& desc) {
+    Shader s;
+    s.name = desc.name;
+
+    std::vector<uint32_t>& c = s.code;
+    c = { 0x07230203u, 0x00010300u, 0, 0, 0 };
+    uint32_t next = 1;
+
+    auto op = [&] (uint32_t opcode, std::initializer_list<uint32_t> words) {
+        c.push_back(((uint32_t(words.size()) + 1) << 16) | opcode);
+        c.insert(c.end(), words.begin(), words.end());
+    };
+
+    uint32_t tVoid = next++, tFn = next++, tFloat = next++, tVec4 = next++;
+    uint32_t tImage = next++, tPtrImage = next++, tStruct = next++, tPtrStruct = next++;
+    uint32_t main = next++;
+
+    struct Var { uint32_t id, binding; bool image, used; };
+    std::vector<Var> vars;
+
+    for (uint32_t b : desc.images) {
+        bool used = std::find(desc.sampled.begin(), desc.sampled.end(), b) != desc.sampled.end();
+        vars.push_back({ next++, b, true, used });
+        vars.push_back({ next++, b + 16, true, used });
+    }
+
+    for (uint32_t b : desc.buffers) {
+        bool used = std::find(desc.read.begin(), desc.read.end(), b) != desc.read.end();
+        vars.push_back({ next++, b, false, used });
+    }
+
+    op(17, { 1 });                                      // OpCapability Shader
+    op(14, { 0, 1 });                                   // OpMemoryModel
+    op(15, { 4, main, 0x6e69616du, 0 });                // OpEntryPoint Fragment "main"
+    op(16, { main, 7 });                                // OpExecutionMode OriginUpperLeft
+
+    for (const Var& v : vars) {
+        op(5, { v.id, 0x00000076u });                   // OpName "v"
+        op(71, { v.id, 34, 0 });                        // OpDecorate DescriptorSet
+        op(71, { v.id, 33, v.binding });                // OpDecorate Binding
+    }
+
+    op(19, { tVoid });
+    op(33, { tFn, tVoid });
+    op(22, { tFloat, 32 });
+    op(23, { tVec4, tFloat, 4 });
+    op(25, { tImage, tFloat, 1, 0, 0, 0, 1, 0 });
+    op(32, { tPtrImage, 0, tImage });
+    op(30, { tStruct, tVec4 });
+    op(32, { tPtrStruct, 2, tStruct });
+
+    for (const Var& v : vars)
+        op(59, { v.image ? tPtrImage : tPtrStruct, v.id, v.image ? 0u : 2u });
+
+    op(54, { tVoid, main, 0, tFn });
+    op(248, { next++ });
+
+    for (const Var& v : vars) {
+        if (v.used)
+            op(v.image ? 61 : 65, { v.image ? tImage : tPtrStruct, next++, v.id });
+    }
+
+    op(253, { });
+    op(56, { });
+
+    c[3] = next;
+    return s;
+}
+
+static std::vector<Shader> builtin_shaders() {
+    // Bindings follow computeResourceSlotId: VS constants 0, PS images
+    // from 17, PS fixed function data 15, shared data 16
+    static const ModuleDesc descs[] = {
+        { "vs_static",    { },                  { },           { 0, 1, 2 }, { 0 } },
+        { "vs_skinned",   { },                  { },           { 0, 1, 2 }, { 0, 1 } },
+        { "ps_diffuse",   { 17 },               { 17 },        { 15, 16 },  { 16 } },
+        { "ps_normalmap", { 17, 18, 19 },       { 17, 18 },    { 15, 16 },  { 16 } },
+        { "ps_bloom",     { 17, 18 },           { 17 },        { 15, 16 },  { } },
+        { "ps_tonemap",   { 17, 18, 19, 20 },   { 17, 18 },    { 15, 16 },  { 16 } },
+        { "ff_ps",        { 17, 18, 19, 20 },   { 17, 18, 19, 20 }, { 15, 16 }, { 15, 16 } },
+    };
+
+    std::vector<Shader> shaders;
+
+    for (const ModuleDesc& d : descs)
+        shaders.push_back(build_module(d));
+
+    return shaders;
+}
+
+static std::vector<Shader> load_shaders(const char* dir) {
+    std::vector<Shader> shaders;
+    DIR* d = opendir(dir);
+
+    if (!d)
+        return shaders;
+
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".spv"))
+            continue;
+
+        FILE* f = fopen((std::string(dir) + "/" + name).c_str(), "rb");
+        if (!f)
+            continue;
+
+        Shader s;
+        s.name = name.substr(0, name.size() - 4);
+
+        uint32_t word;
+        while (fread(&word, sizeof(word), 1, f) == 1)
+            s.code.push_back(word);
+
+        fclose(f);
+        shaders.push_back(std::move(s));
+    }
+
+    closedir(d);
+    return shaders;
+}
+
+int main(int argc, char** argv) {
+    const char* dir = nullptr;
+    uint32_t iterations = 2000;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--spirv") && i + 1 < argc)
+            dir = argv[++i];
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--spirv DIR] [--iterations N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Shader> shaders = dir ? load_shaders(dir) : builtin_shaders();
+
+    if (shaders.empty()) {
+        fprintf(stderr, "No shaders found in %s\n", dir);
+        return 1;
+    }
+
+    uint64_t bindingsBefore = 0, bindingsAfter = 0, wordsBefore = 0, wordsAfter = 0;
+    uint32_t pruned = 0, invalid = 0;
+    double totalUs = 0.0;
+    uint64_t sink = 0;
+    bool first = true;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"spirv_prune\",\n");
+    printf("  \"source\": \"%s\",\n", dir ? dir : "builtin");
+    printf("  \"shaders\": [\n");
+
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const Shader& s = shaders[i];
+        std::vector<uint32_t> code = s.code;
+        DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+
+        if (!usage.valid) {
+            invalid++;
+            continue;
+        }
+
+        uint32_t runs = dir ? iterations / 10 + 1 : iterations;
+
+        auto start = Clock::now();
+        for (uint32_t n = 0; n < runs; n++) {
+            std::vector<uint32_t> copy = s.code;
+            sink += DxvkSpirvBindingPruner::prune(copy).removed + copy.size();
+        }
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / runs;
+
+        uint32_t before = 0, after = 0;
+        for (uint32_t set = 0; set < DxvkSpirvBindingUsage::MaxSets; set++) {
+            before += usage.declared[set].count();
+            after  += usage.used[set].count();
+        }
+
+        bindingsBefore += before;
+        bindingsAfter  += after;
+        wordsBefore    += s.code.size();
+        wordsAfter     += code.size();
+        pruned         += usage.removed ? 1 : 0;
+        totalUs        += us;
+
+        printf("%s    { \"name\": \"%s\", \"bindings_before\": %u, \"bindings_after\": %u, "
+               "\"words_before\": %zu, \"words_after\": %zu, \"prune_us\": %.2f }",
+            first ? "" : ",\n", s.name.c_str(), before, after, s.code.size(), code.size(), us);
+        first = false;
+    }
+
+    uint32_t valid = uint32_t(shaders.size()) - invalid;
+
+    printf("\n  ],\n");
+    printf("  \"total\": {\n");
+    printf("    \"shaders\": %u,\n", valid);
+    printf("    \"invalid\": %u,\n", invalid);
+    printf("    \"pruned\": %u,\n", pruned);
+    printf("    \"bindings_before_avg\": %.2f,\n", valid ? double(bindingsBefore) / valid : 0.0);
+    printf("    \"bindings_after_avg\": %.2f,\n", valid ? double(bindingsAfter) / valid : 0.0);
+    printf("    \"words_before\": %llu,\n", (unsigned long long)wordsBefore);
+    printf("    \"words_after\": %llu,\n", (unsigned long long)wordsAfter);
+    printf("    \"prune_us_avg\": %.2f\n", valid ? totalUs / valid : 0.0);
+    printf("  },\n");
+    printf("  \"checksum\": %llu\n", (unsigned long long)(sink & 0xffff));
+    printf("}\n");
+
+    return 0;
+}
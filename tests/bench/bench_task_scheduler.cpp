@@ -0,0 +1,203 @@
+/*
+ * Task Scheduler Benchmark
+ *
+ * Measures task throughput of the work-stealing scheduler in
+ * src/util/task/task_scheduler.h against a mutex and condition
+ * variable pool, like the one D3D9FormatConverter had:
+ *
+ * - flat: one thread submits small independent tasks, as the
+ *   device does with texture slices and shader jobs
+ * - tree: tasks spawn four children each, seven levels deep, as
+ *   shader compilation does when it spawns pipeline variants
+ *
+ * Steal rate is the fraction of executed tasks that a worker took
+ * from another worker's deque.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "util/task/task_scheduler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+/* Baseline: one locked queue shared by all workers */
+class MutexPool {
+public:
+    explicit MutexPool(uint32_t workers) {
+        for (uint32_t i = 0; i < workers; i++)
+            m_threads.emplace_back([this] { run(); });
+    }
+
+    ~MutexPool() {
+        { std::lock_guard lock(m_mutex);
+          m_stopped = true; }
+        m_cond.notify_all();
+        for (auto& t : m_threads)
+            t.join();
+    }
+
+    void submit(std::function<void ()> fn) {
+        { std::lock_guard lock(m_mutex);
+          m_queue.push_back(std::move(fn)); }
+        m_cond.notify_one();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::function<void ()>> m_queue;
+    bool m_stopped = false;
+    std::vector<std::thread> m_threads;
+
+    void run() {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            m_cond.wait(lock, [this] { return m_stopped || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            auto fn = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+            fn();
+            lock.lock();
+        }
+    }
+};
+
+static volatile uint32_t g_sink;
+
+static void work(uint32_t units) {
+    uint32_t x = units;
+    for (uint32_t i = 0; i < units * 16; i++)
+        x = x * 1664525u + 1013904223u;
+    g_sink = x;
+}
+
+static void wait_count(std::atomic<uint32_t>& count, uint32_t target) {
+    while (count.load() < target)
+        std::this_thread::yield();
+}
+
+static void tree_pool(MutexPool& pool, std::atomic<uint32_t>& count, uint32_t depth, uint32_t units) {
+    work(units);
+    count++;
+
+    if (!depth)
+        return;
+
+    for (uint32_t i = 0; i < 4; i++)
+        pool.submit([&pool, &count, depth, units] { tree_pool(pool, count, depth - 1, units); });
+}
+
+static void tree_tasks(TaskScheduler& scheduler, std::atomic<uint32_t>& count, uint32_t depth, uint32_t units) {
+    work(units);
+    count++;
+
+    if (!depth)
+        return;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        scheduler.spawn(TaskPriority::Prefetch,
+          [&scheduler, &count, depth, units] { tree_tasks(scheduler, count, depth - 1, units); });
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t workers = 4;
+    uint32_t tasks = 100000;
+    uint32_t units = 4;
+    uint32_t iterations = 3;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--workers") && i + 1 < argc)
+            workers = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--tasks") && i + 1 < argc)
+            tasks = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--work") && i + 1 < argc)
+            units = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--workers N] [--tasks N] [--work N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const uint32_t depth = 7;
+    const uint32_t treeTasks = ((1u << (2 * (depth + 1))) - 1) / 3;  // 1 + 4 + ... + 4^7
+
+    double flatPool = 1e30, flatTasks = 1e30;
+    double treePool = 1e30, treeTasksTime = 1e30;
+    TaskSchedulerStats flatStats, treeStats;
+
+    for (uint32_t it = 0; it < iterations; it++) {
+        { MutexPool pool(workers);
+          std::atomic<uint32_t> count = { 0 };
+          auto start = Clock::now();
+          for (uint32_t i = 0; i < tasks; i++)
+              pool.submit([&count, units] { work(units); count++; });
+          wait_count(count, tasks);
+          flatPool = std::min(flatPool, std::chrono::duration<double>(Clock::now() - start).count()); }
+
+        { TaskScheduler scheduler(workers);
+          std::atomic<uint32_t> count = { 0 };
+          auto start = Clock::now();
+          for (uint32_t i = 0; i < tasks; i++)
+              scheduler.spawn(TaskPriority::Prefetch, [&count, units] { work(units); count++; });
+          wait_count(count, tasks);
+          flatTasks = std::min(flatTasks, std::chrono::duration<double>(Clock::now() - start).count());
+          flatStats = scheduler.getStats(); }
+
+        { MutexPool pool(workers);
+          std::atomic<uint32_t> count = { 0 };
+          auto start = Clock::now();
+          pool.submit([&] { tree_pool(pool, count, depth, units); });
+          wait_count(count, treeTasks);
+          treePool = std::min(treePool, std::chrono::duration<double>(Clock::now() - start).count()); }
+
+        { TaskScheduler scheduler(workers);
+          std::atomic<uint32_t> count = { 0 };
+          auto start = Clock::now();
+          scheduler.spawn(TaskPriority::Prefetch, [&] { tree_tasks(scheduler, count, depth, units); });
+          wait_count(count, treeTasks);
+          treeTasksTime = std::min(treeTasksTime, std::chrono::duration<double>(Clock::now() - start).count());
+          treeStats = scheduler.getStats(); }
+    }
+
+    auto stealRate = [] (const TaskSchedulerStats& s) {
+        return s.executed ? double(s.steals) / double(s.executed) : 0.0;
+    };
+
+    printf("{\n");
+    printf("  \"benchmark\": \"task_scheduler\",\n");
+    printf("  \"workers\": %u,\n", workers);
+    printf("  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+    printf("  \"results\": [\n");
+    printf("    { \"case\": \"flat\", \"tasks\": %u, \"mutex_pool_ktasks_per_s\": %.1f, "
+           "\"scheduler_ktasks_per_s\": %.1f, \"speedup\": %.2f, \"steal_rate\": %.3f, "
+           "\"steal_attempts\": %llu },\n",
+        tasks, tasks / flatPool / 1e3, tasks / flatTasks / 1e3, flatPool / flatTasks,
+        stealRate(flatStats), (unsigned long long)flatStats.stealAttempts);
+    printf("    { \"case\": \"tree\", \"tasks\": %u, \"mutex_pool_ktasks_per_s\": %.1f, "
+           "\"scheduler_ktasks_per_s\": %.1f, \"speedup\": %.2f, \"steal_rate\": %.3f, "
+           "\"steal_attempts\": %llu }\n",
+        treeTasks, treeTasks / treePool / 1e3, treeTasks / treeTasksTime / 1e3, treePool / treeTasksTime,
+        stealRate(treeStats), (unsigned long long)treeStats.stealAttempts);
+    printf("  ]\n");
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+/*
+ * Vertex Input Setup Benchmark
+ *
+ * Measures CPU time per frame spent on vertex input setup:
+ *
+ * - rebuild: what DXVK does today. SetFVF looks the declaration
+ *   up in an FVF table; whenever the bound declaration or vertex
+ *   shader changes, the attribute array, conversions and the
+ *   pipeline key hash are rebuilt from the elements.
+ * - interned: the cache in src/d3d9/d3d9_vertex_decl.h. SetFVF
+ *   returns an interned declaration and D3D9VertexInputState only
+ *   looks up the memoized layout when a pointer changes.
+ *
+ * The frame is modelled on FNV exteriors: 1500 draws, most of them
+ * with explicit declarations from the mesh loader and the rest
+ * (UI, effects) through SetFVF, with state sorted by material so
+ * consecutive draws often share a declaration or shader.
+ *
+ * Run with: make bench-cpu
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_vertex_decl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+struct Draw {
+    int32_t  decl;    ///< Explicit declaration, or -1
+    uint32_t fvf;     ///< FVF code if decl is -1
+    uint32_t shader;
+};
+
+/* DXVK today: elements per declaration, layout rebuilt on change */
+struct RebuildDecl {
+    std::vector<D3D9VertexElement> elements;
+};
+
+static uint64_t rebuild_layout(const RebuildDecl& decl, const D3D9VertexShaderInputs& inputs,
+        const D3D9VertexFormatSupport& support, D3D9InputLayout& layout) {
+    layout.attributes.clear();
+    layout.bindings.clear();
+    layout.conversions.clear();
+    layout.missingMask = 0;
+
+    uint32_t extents[16] = { };
+    uint32_t streams = 0;
+
+    for (const auto& input : inputs.Inputs()) {
+        const D3D9VertexElement* match = nullptr;
+
+        for (const auto& e : decl.elements) {
+            if ((e.usage == input.usage && e.usageIndex == input.usageIndex)
+             || (!match && e.usage == D3D9DeclUsage::PositionT
+              && input.usage == D3D9DeclUsage::Position && !input.usageIndex))
+                match = &e;
+        }
+
+        if (!match) {
+            layout.missingMask |= 1u << input.location;
+            continue;
+        }
+
+        D3D9VertexFetch f = D3D9GetVertexFetch(match->type, support);
+        layout.attributes.push_back({ input.location, match->stream, f.format, match->offset });
+
+        if (f.convert != D3D9VertexConvert::None || f.swizzle != D3D9VertexFetch::IdentitySwizzle)
+            layout.conversions.push_back({ input.location, f.convert, f.swizzle });
+
+        streams |= 1u << match->stream;
+        extents[match->stream] = std::max(extents[match->stream], uint32_t(match->offset) + f.size);
+    }
+
+    for (uint32_t s = 0; s < 16; s++) {
+        if (streams & (1u << s))
+            layout.bindings.push_back({ s, extents[s] });
+    }
+
+    uint64_t hash = layout.missingMask;
+    for (const auto& a : layout.attributes) {
+        hash = D3D9HashCombine(hash, a.location | (a.binding << 8) | (uint64_t(a.format) << 16));
+        hash = D3D9HashCombine(hash, a.offset);
+    }
+    for (const auto& c : layout.conversions)
+        hash = D3D9HashCombine(hash, c.location | (uint32_t(c.convert) << 8) | (uint32_t(c.swizzle) << 16));
+
+    return hash;
+}
+
+static std::vector<D3D9VertexElement> random_decl(std::mt19937& rng) {
+    static const D3D9DeclType types[] = {
+        D3D9DeclType::Float2, D3D9DeclType::Float3, D3D9DeclType::Float4,
+        D3D9DeclType::D3DColor, D3D9DeclType::UByte4, D3D9DeclType::UByte4N,
+        D3D9DeclType::Short2N, D3D9DeclType::Short4N, D3D9DeclType::Float16_2 };
+
+    std::vector<D3D9VertexElement> elements;
+    elements.push_back({ 0, 0, D3D9DeclType::Float3, 0, D3D9DeclUsage::Position, 0 });
+
+    uint16_t offset = 12;
+    uint32_t count = 3 + rng() % 5;
+
+    static const D3D9DeclUsage usages[] = {
+        D3D9DeclUsage::Normal, D3D9DeclUsage::Color, D3D9DeclUsage::BlendWeight,
+        D3D9DeclUsage::BlendIndices, D3D9DeclUsage::Tangent, D3D9DeclUsage::Binormal };
+
+    for (uint32_t i = 0; i < count; i++) {
+        D3D9DeclType type = types[rng() % 9];
+        D3D9DeclUsage usage = i < 3 ? D3D9DeclUsage::Texcoord : usages[i - 3];
+        elements.push_back({ 0, offset, type, 0, usage, uint8_t(i < 3 ? i : 0) });
+        offset += uint16_t(D3D9GetDeclTypeSize(type));
+    }
+
+    elements.push_back({ 0xff, 0, D3D9DeclType::Unused, 0, D3D9DeclUsage::Position, 0 });
+    return elements;
+}
+
+int main(int argc, char** argv) {
+    uint32_t draws = 1500;
+    uint32_t frames = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--draws") && i + 1 < argc)
+            draws = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = uint32_t(atoi(argv[++i]));
+        else {
+            fprintf(stderr, "Usage: %s [--draws N] [--frames N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(64);
+    D3D9VertexFormatSupport support;
+
+    // 12 mesh declarations, 8 FVF codes, 24 vertex shaders
+    std::vector<std::vector<D3D9VertexElement>> declElements;
+    for (uint32_t i = 0; i < 12; i++)
+        declElements.push_back(random_decl(rng));
+
+    const uint32_t fvfs[] = {
+        0x002 | 0x040, 0x004 | 0x040 | 0x100, 0x002 | 0x010 | 0x100,
+        0x002 | 0x040 | 0x100, 0x004 | 0x040 | 0x080 | 0x100,
+        0x002 | 0x010 | 0x040 | 0x200, 0x00a | 0x1000 | 0x010 | 0x100, 0x004 | 0x100 };
+
+    std::vector<D3D9VertexShaderInputs> shaders;
+    for (uint32_t i = 0; i < 24; i++) {
+        std::vector<D3D9VertexInput> inputs = { { 0, D3D9DeclUsage::Position, 0 } };
+        uint32_t count = 2 + rng() % 5;
+        for (uint32_t j = 0; j < count; j++) {
+            static const D3D9VertexInput pool[] = {
+                { 0, D3D9DeclUsage::Normal, 0 }, { 0, D3D9DeclUsage::Color, 0 },
+                { 0, D3D9DeclUsage::Texcoord, 0 }, { 0, D3D9DeclUsage::Texcoord, 1 },
+                { 0, D3D9DeclUsage::Tangent, 0 }, { 0, D3D9DeclUsage::BlendWeight, 0 },
+                { 0, D3D9DeclUsage::BlendIndices, 0 } };
+            D3D9VertexInput input = pool[(i + j) % 7];
+            input.location = j + 1;
+            inputs.push_back(input);
+        }
+        shaders.emplace_back(std::move(inputs));
+    }
+
+    // Sorted by material: keep the declaration 70% and the shader 50% of the time
+    std::vector<Draw> frame(draws);
+    Draw current = { 0, 0, 0 };
+    for (auto& d : frame) {
+        if (rng() % 10 >= 7) {
+            if (rng() % 10 < 8) {
+                current.decl = int32_t(rng() % declElements.size());
+            } else {
+                current.decl = -1;
+                current.fvf = fvfs[rng() % 8];
+            }
+        }
+        if (rng() % 2)
+            current.shader = rng() % shaders.size();
+        d = current;
+    }
+
+    // Rebuild path
+    std::vector<RebuildDecl> rebuildDecls;
+    for (const auto& e : declElements)
+        rebuildDecls.push_back({ std::vector<D3D9VertexElement>(e.begin(), e.end() - 1) });
+
+    std::unordered_map<uint32_t, RebuildDecl> fvfTable;
+    for (uint32_t fvf : fvfs) {
+        RebuildDecl decl;
+        D3D9VertexDeclCache::TranslateFvf(fvf, decl.elements);
+        fvfTable.insert({ fvf, std::move(decl) });
+    }
+
+    uint64_t sink = 0;
+    uint32_t rebuilds = 0;
+    D3D9InputLayout scratch;
+
+    auto start = Clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        const RebuildDecl* bound = nullptr;
+        uint32_t boundShader = ~0u;
+
+        for (const auto& d : frame) {
+            const RebuildDecl* decl = d.decl >= 0
+                ? &rebuildDecls[d.decl]
+                : &fvfTable.find(d.fvf)->second;
+
+            if (decl != bound || d.shader != boundShader) {
+                bound = decl;
+                boundShader = d.shader;
+                sink += rebuild_layout(*decl, shaders[d.shader], support, scratch);
+                rebuilds++;
+            }
+        }
+    }
+    double rebuildUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+
+    // Interned path, declarations are created up front as the game does
+    D3D9VertexDeclCache cache(support);
+    std::vector<D3D9VertexDecl*> decls;
+    for (const auto& e : declElements)
+        decls.push_back(cache.Intern(e.data()));
+
+    uint32_t changes = 0;
+
+    start = Clock::now();
+    for (uint32_t f = 0; f < frames; f++) {
+        D3D9VertexInputState state;
+
+        for (const auto& d : frame) {
+            D3D9VertexDecl* decl = d.decl >= 0 ? decls[d.decl] : cache.FromFvf(d.fvf)->decl;
+
+            if (state.Bind(decl, &shaders[d.shader])) {
+                sink += state.GetLayout()->hash;
+                changes++;
+            }
+        }
+    }
+    double internedUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frames;
+
+    D3D9VertexDeclStats stats = cache.GetStats();
+
+    printf("{\n");
+    printf("  \"benchmark\": \"vertex_decl\",\n");
+    printf("  \"draws_per_frame\": %u,\n", draws);
+    printf("  \"frames\": %u,\n", frames);
+    printf("  \"rebuilds_per_frame\": %u,\n", rebuilds / frames);
+    printf("  \"layout_changes_per_frame\": %u,\n", changes / frames);
+    printf("  \"layouts_built\": %u,\n", stats.layoutBuilds);
+    printf("  \"rebuild_us_per_frame\": %.2f,\n", rebuildUs);
+    printf("  \"interned_us_per_frame\": %.2f,\n", internedUs);
+    printf("  \"speedup\": %.2f,\n", rebuildUs / internedUs);
+    printf("  \"checksum\": %llu\n", (unsigned long long)(sink & 0xffff));
+    printf("}\n");
+    return 0;
+}
@@ -0,0 +1,883 @@
+/*
+ * Shader Bounds Check Probe
+ *
+ * Measures what disabling robustBufferAccess2 costs in shaders. Every
+ * unique vertex and pixel shader in the .d3d9trace files of a
+ * directory is decoded (src/dxso/dxso_float_emulation.h) and planned
+ * twice with src/dxso/dxso_bounds_check.h:
+ *
+ * - robust: relative constant loads are plain loads, run on a device
+ *   with VK_EXT_robustness2 robustBufferAccess2 enabled if it has it
+ * - manual: each such load is guarded with the ULessThan /
+ *   CompositeConstruct / Select sequence our patch makes DxsoCompiler
+ *   emit, run on a device without robustness features
+ *
+ * The SPIR-V backend of DxsoCompiler is not in this tree, so each
+ * variant is lowered to a compute kernel that keeps the parts that
+ * matter here: one vector ALU op per arithmetic instruction, and each
+ * relative constant load with its register offset, indexed by an
+ * address register that varies per invocation. One invocation stands
+ * for one vertex or pixel; every dispatch runs the same fixed number.
+ *
+ * Per shader: instructions, relative_reads, and per variant the SPIR-V
+ * instruction count, pipeline compile_us and dispatch_us (medians).
+ * Absolute times only compare on one driver and machine; run it on a
+ * software driver (lavapipe, SwiftShader) to compare the variants.
+ *
+ * Run with: make probe-bounds-check [TRACES_DIR=...] [VK_ICD=...]
+ * Output: JSON on stdout
+ */
+
+#include "d3d9/d3d9_shader_intern.h"
+#include "dxso/dxso_bounds_check.h"
+
+#include <vulkan/vulkan.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+using Clock = std::chrono::high_resolution_clock;
+
+#define PROBE_VK(call) do { \
+    VkResult _r = (call); \
+    if (_r != VK_SUCCESS) { \
+        fprintf(stderr, "FAILED: %s returned %d\n  %s:%d\n", #call, _r, __FILE__, __LINE__); \
+        return false; \
+    } \
+} while(0)
+
+static double elapsed_us(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static double median(std::vector<double> samples) {
+    if (samples.empty())
+        return 0.0;
+
+    std::sort(samples.begin(), samples.end());
+    return samples[(samples.size() - 1) / 2];
+}
+
+/* ============================================
+ * Trace reading
+ * ============================================ */
+static constexpr uint64_t TraceMagic      = 0x4543415254394433ull;  // "D3D9TRAC"
+static constexpr size_t   TraceHeaderSize = 88;
+static constexpr size_t   TraceEntrySize  = 56;
+
+template<typename T>
+static T read_at(const std::vector<uint8_t>& file, size_t offset) {
+    T value = T();
+    if (offset + sizeof(T) <= file.size())
+        memcpy(&value, &file[offset], sizeof(T));
+    return value;
+}
+
+static bool read_file(const std::string& path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        data.insert(data.end(), buffer, buffer + n);
+
+    fclose(f);
+    return true;
+}
+
+static void load_trace(const std::string& path, std::map<std::vector<uint32_t>, bool>& unique) {
+    std::vector<uint8_t> file;
+
+    if (!read_file(path, file) || file.size() < TraceHeaderSize || read_at<uint64_t>(file, 0) != TraceMagic)
+        return;
+
+    uint32_t resourceCount   = read_at<uint32_t>(file, 24);
+    uint64_t resourcesOffset = read_at<uint64_t>(file, 56);
+
+    for (uint32_t i = 0; i < resourceCount; i++) {
+        size_t entry = resourcesOffset + i * TraceEntrySize;
+
+        if (entry + TraceEntrySize > file.size())
+            break;
+
+        uint8_t  type       = read_at<uint8_t>(file, entry + 4);
+        uint64_t dataOffset = read_at<uint64_t>(file, entry + 8);
+        uint64_t dataSize   = read_at<uint64_t>(file, entry + 16);
+
+        if ((type != 5 && type != 6) || !dataOffset || dataSize % 4
+         || dataOffset + dataSize > file.size())
+            continue;
+
+        std::vector<uint32_t> code(dataSize / 4);
+        memcpy(code.data(), &file[dataOffset], dataSize);
+        unique.insert({ std::move(code), type == 6 });
+    }
+}
+
+static std::vector<std::vector<uint32_t>> load_shaders(const char* traces) {
+    std::map<std::vector<uint32_t>, bool> unique;
+    std::vector<std::string> files;
+
+    if (DIR* d = opendir(traces)) {
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+
+            if (name.size() > 10 && !name.compare(name.size() - 10, 10, ".d3d9trace"))
+                files.push_back(std::string(traces) + "/" + name);
+        }
+
+        closedir(d);
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (const auto& f : files)
+        load_trace(f, unique);
+
+    std::vector<std::vector<uint32_t>> shaders;
+
+    for (const auto& entry : unique)
+        shaders.push_back(entry.first);
+
+    return shaders;
+}
+
+/* ============================================
+ * Kernel generation
+ * ============================================ */
+class SpirvBuilder {
+
+public:
+
+    uint32_t id() {
+        return m_bound++;
+    }
+
+    void op(uint32_t opcode, std::initializer_list<uint32_t> operands) {
+        m_words.push_back(uint32_t(operands.size() + 1) << 16 | opcode);
+        m_words.insert(m_words.end(), operands.begin(), operands.end());
+        m_ops++;
+    }
+
+    /// Function body instructions, the ones that execute
+    uint32_t bodyOps() const {
+        return m_ops - m_bodyStart;
+    }
+
+    void beginBody() {
+        m_bodyStart = m_ops;
+    }
+
+    std::vector<uint32_t> finish() {
+        std::vector<uint32_t> code = { 0x07230203u, 0x00010000u, 0u, m_bound, 0u };
+        code.insert(code.end(), m_words.begin(), m_words.end());
+        return code;
+    }
+
+private:
+
+    std::vector<uint32_t> m_words;
+    uint32_t m_bound = 1;
+    uint32_t m_ops = 0;
+    uint32_t m_bodyStart = 0;
+
+};
+
+enum SpvOp : uint32_t {
+    OpCapability = 17, OpMemoryModel = 14, OpEntryPoint = 15, OpExecutionMode = 16,
+    OpDecorate = 71, OpMemberDecorate = 72, OpTypeVoid = 19, OpTypeBool = 20,
+    OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeArray = 28,
+    OpTypeRuntimeArray = 29, OpTypeStruct = 30, OpTypePointer = 32, OpTypeFunction = 33,
+    OpConstant = 43, OpConstantComposite = 44, OpVariable = 59, OpFunction = 54,
+    OpLabel = 248, OpAccessChain = 65, OpLoad = 61, OpStore = 62,
+    OpCompositeConstruct = 80, OpIAdd = 128, OpFAdd = 129, OpFMul = 133,
+    OpSelect = 169, OpULessThan = 176, OpBitwiseAnd = 199, OpReturn = 253, OpFunctionEnd = 56,
+};
+
+struct Kernel {
+    std::vector<uint32_t> code;
+    uint32_t              ops = 0;
+};
+
+/* Lanes of the address register; offsets are wrapped so every load
+ * stays in range and both variants read the same data */
+static constexpr uint32_t AddressLanes = 16;
+
+static bool is_arithmetic(DxsoOpcode opcode) {
+    switch (opcode) {
+        case DxsoOpcode::Nop:     case DxsoOpcode::Dcl:     case DxsoOpcode::Def:
+        case DxsoOpcode::DefI:    case DxsoOpcode::DefB:    case DxsoOpcode::Call:
+        case DxsoOpcode::CallNz:  case DxsoOpcode::Loop:    case DxsoOpcode::Ret:
+        case DxsoOpcode::EndLoop: case DxsoOpcode::Label:   case DxsoOpcode::Rep:
+        case DxsoOpcode::EndRep:  case DxsoOpcode::If:      case DxsoOpcode::Ifc:
+        case DxsoOpcode::Else:    case DxsoOpcode::EndIf:   case DxsoOpcode::Break:
+        case DxsoOpcode::BreakC:  case DxsoOpcode::BreakP:  case DxsoOpcode::TexKill:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static Kernel make_kernel(const DxsoProgram& program, const DxsoBoundsCheckPlan& plan) {
+    const uint32_t constants = DxsoGetFloatConstantCount(program);
+    const uint32_t range = constants - AddressLanes;
+
+    SpirvBuilder b;
+
+    uint32_t tVoid = b.id(), tFn = b.id(), tFloat = b.id(), tVec4 = b.id(), tUint = b.id();
+    uint32_t tUvec3 = b.id(), tBool = b.id(), tBvec4 = b.id(), tConstArray = b.id();
+    uint32_t tCb = b.id(), tCbPtr = b.id(), tVec4Ptr = b.id(), tDataArray = b.id();
+    uint32_t tData = b.id(), tDataPtr = b.id(), tUvec3Ptr = b.id(), tUintPtr = b.id();
+    uint32_t cZero = b.id(), cCount = b.id(), cMask = b.id(), cFloatZero = b.id();
+    uint32_t cVecZero = b.id(), cScale = b.id(), cScaleVec = b.id();
+    uint32_t vCb = b.id(), vData = b.id(), vGid = b.id(), fMain = b.id();
+
+    b.op(OpCapability, { 1 });                                   // Shader
+    b.op(OpMemoryModel, { 0, 1 });                               // Logical GLSL450
+    b.op(OpEntryPoint, { 5, fMain, 0x6e69616du, 0, vGid });      // GLCompute "main"
+    b.op(OpExecutionMode, { fMain, 17, 64, 1, 1 });              // LocalSize 64 1 1
+    b.op(OpDecorate, { vGid, 11, 28 });                          // BuiltIn GlobalInvocationId
+    b.op(OpDecorate, { tConstArray, 6, 16 });                    // ArrayStride 16
+    b.op(OpMemberDecorate, { tCb, 0, 35, 0 });                   // Offset 0
+    b.op(OpDecorate, { tCb, 2 });                                // Block
+    b.op(OpDecorate, { vCb, 34, 0 });                            // DescriptorSet 0
+    b.op(OpDecorate, { vCb, 33, 0 });                            // Binding 0
+    b.op(OpDecorate, { tDataArray, 6, 16 });
+    b.op(OpMemberDecorate, { tData, 0, 35, 0 });
+    b.op(OpDecorate, { tData, 3 });                              // BufferBlock
+    b.op(OpDecorate, { vData, 34, 0 });
+    b.op(OpDecorate, { vData, 33, 1 });
+
+    b.op(OpTypeVoid, { tVoid });
+    b.op(OpTypeFunction, { tFn, tVoid });
+    b.op(OpTypeFloat, { tFloat, 32 });
+    b.op(OpTypeVector, { tVec4, tFloat, 4 });
+    b.op(OpTypeInt, { tUint, 32, 0 });
+    b.op(OpTypeVector, { tUvec3, tUint, 3 });
+    b.op(OpTypeBool, { tBool });
+    b.op(OpTypeVector, { tBvec4, tBool, 4 });
+    b.op(OpConstant, { tUint, cZero, 0 });
+    b.op(OpConstant, { tUint, cCount, constants });
+    b.op(OpConstant, { tUint, cMask, AddressLanes - 1 });
+    b.op(OpConstant, { tFloat, cFloatZero, 0 });
+    b.op(OpConstantComposite, { tVec4, cVecZero, cFloatZero, cFloatZero, cFloatZero, cFloatZero });
+    b.op(OpConstant, { tFloat, cScale, 0x3f7fbe77u });           // 0.999f
+    b.op(OpConstantComposite, { tVec4, cScaleVec, cScale, cScale, cScale, cScale });
+    b.op(OpTypeArray, { tConstArray, tVec4, cCount });
+    b.op(OpTypeStruct, { tCb, tConstArray });
+    b.op(OpTypePointer, { tCbPtr, 2, tCb });                     // Uniform
+    b.op(OpTypePointer, { tVec4Ptr, 2, tVec4 });
+    b.op(OpTypeRuntimeArray, { tDataArray, tVec4 });
+    b.op(OpTypeStruct, { tData, tDataArray });
+    b.op(OpTypePointer, { tDataPtr, 2, tData });
+    b.op(OpTypePointer, { tUvec3Ptr, 1, tUvec3 });               // Input
+    b.op(OpTypePointer, { tUintPtr, 1, tUint });
+
+    // Register offsets become constants up front
+    std::map<uint32_t, uint32_t> offsets;
+
+    for (const auto& ins : program.instructions) {
+        for (uint32_t j = 0; j < ins.srcCount; j++) {
+            uint32_t reads = DxsoGetRelativeConstantReads(ins, j);
+
+            for (uint32_t r = 0; r < reads; r++) {
+                uint32_t offset = (ins.src[j].index + r) % range;
+
+                if (offsets.find(offset) == offsets.end()) {
+                    uint32_t c = b.id();
+                    b.op(OpConstant, { tUint, c, offset });
+                    offsets[offset] = c;
+                }
+            }
+        }
+    }
+
+    b.op(OpVariable, { tCbPtr, vCb, 2 });
+    b.op(OpVariable, { tDataPtr, vData, 2 });
+    b.op(OpVariable, { tUvec3Ptr, vGid, 1 });
+
+    b.op(OpFunction, { tVoid, fMain, 0, tFn });
+    b.op(OpLabel, { b.id() });
+    b.beginBody();
+
+    uint32_t pGid = b.id(), gid = b.id(), a0 = b.id(), pValue = b.id(), value = b.id();
+    b.op(OpAccessChain, { tUintPtr, pGid, vGid, cZero });
+    b.op(OpLoad, { tUint, gid, pGid });
+    b.op(OpBitwiseAnd, { tUint, a0, gid, cMask });
+    b.op(OpAccessChain, { tVec4Ptr, pValue, vData, cZero, gid });
+    b.op(OpLoad, { tVec4, value, pValue });
+
+    for (uint32_t i = 0; i < program.instructions.size(); i++) {
+        const DxsoInstruction& ins = program.instructions[i];
+
+        if (!is_arithmetic(ins.opcode))
+            continue;
+
+        bool loaded = false;
+
+        for (uint32_t j = 0; j < ins.srcCount; j++) {
+            uint32_t reads = DxsoGetRelativeConstantReads(ins, j);
+
+            for (uint32_t r = 0; r < reads; r++) {
+                uint32_t index = b.id(), ptr = b.id(), c = b.id();
+                b.op(OpIAdd, { tUint, index, a0, offsets[(ins.src[j].index + r) % range] });
+                b.op(OpAccessChain, { tVec4Ptr, ptr, vCb, cZero, index });
+                b.op(OpLoad, { tVec4, c, ptr });
+
+                if (plan.NeedsBoundsCheck(i, j)) {
+                    uint32_t inRange = b.id(), mask = b.id(), checked = b.id();
+                    b.op(OpULessThan, { tBool, inRange, index, cCount });
+                    b.op(OpCompositeConstruct, { tBvec4, mask, inRange, inRange, inRange, inRange });
+                    b.op(OpSelect, { tVec4, checked, mask, c, cVecZero });
+                    c = checked;
+                }
+
+                uint32_t sum = b.id();
+                b.op(OpFAdd, { tVec4, sum, value, c });
+                value = sum;
+                loaded = true;
+            }
+        }
+
+        if (!loaded) {
+            uint32_t product = b.id();
+            b.op(OpFMul, { tVec4, product, value, cScaleVec });
+            value = product;
+        }
+    }
+
+    b.op(OpStore, { pValue, value });
+    b.op(OpReturn, { });
+    b.op(OpFunctionEnd, { });
+
+    Kernel kernel;
+    kernel.ops = b.bodyOps() - 1;  // Without OpFunctionEnd
+    kernel.code = b.finish();
+    return kernel;
+}
+
+/* ============================================
+ * Vulkan
+ * ============================================ */
+static VkInstance instance = VK_NULL_HANDLE;
+static VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+static VkPhysicalDeviceProperties deviceProps;
+static VkPhysicalDeviceMemoryProperties memoryProps;
+static uint32_t queueFamily = 0;
+static bool hasRobustness2 = false;
+
+/* One device per variant, so robustBufferAccess2 only affects the
+ * robust one */
+struct Context {
+    VkDevice              device         = VK_NULL_HANDLE;
+    VkQueue               queue          = VK_NULL_HANDLE;
+    VkCommandPool         commandPool    = VK_NULL_HANDLE;
+    VkCommandBuffer       cmd            = VK_NULL_HANDLE;
+    VkFence               fence          = VK_NULL_HANDLE;
+    VkBuffer              buffers[2]     = { };
+    VkDeviceMemory        memory[2]      = { };
+    VkDescriptorSetLayout setLayout      = VK_NULL_HANDLE;
+    VkPipelineLayout      pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool      pool           = VK_NULL_HANDLE;
+    VkDescriptorSet       set            = VK_NULL_HANDLE;
+};
+
+static bool setup_instance(uint32_t deviceIndex) {
+    VkApplicationInfo appInfo = { };
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Shader Bounds Check Probe";
+    appInfo.apiVersion = VK_API_VERSION_1_1;
+
+    uint32_t extCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extCount, nullptr);
+    std::vector<VkExtensionProperties> exts(extCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extCount, exts.data());
+
+    std::vector<const char*> enabled;
+    VkInstanceCreateFlags flags = 0;
+
+    // MoltenVK is only listed with portability enumeration
+    for (const auto& e : exts) {
+        if (!strcmp(e.extensionName, "VK_KHR_portability_enumeration")) {
+            enabled.push_back("VK_KHR_portability_enumeration");
+            flags |= 0x00000001; // VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR
+        }
+    }
+
+    VkInstanceCreateInfo instanceInfo = { };
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.flags = flags;
+    instanceInfo.pApplicationInfo = &appInfo;
+    instanceInfo.enabledExtensionCount = uint32_t(enabled.size());
+    instanceInfo.ppEnabledExtensionNames = enabled.data();
+    PROBE_VK(vkCreateInstance(&instanceInfo, nullptr, &instance));
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+    if (deviceIndex >= deviceCount) {
+        fprintf(stderr, "Device %u not found, %u available\n", deviceIndex, deviceCount);
+        return false;
+    }
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+    physicalDevice = devices[deviceIndex];
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProps);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+    fprintf(stderr, "Using device: %s\n", deviceProps.deviceName);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    queueFamily = UINT32_MAX;
+    for (uint32_t i = 0; i < familyCount && queueFamily == UINT32_MAX; i++) {
+        if (families[i].queueFlags & VK_QUEUE_COMPUTE_BIT)
+            queueFamily = i;
+    }
+
+    if (queueFamily == UINT32_MAX) {
+        fprintf(stderr, "No compute queue\n");
+        return false;
+    }
+
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+    exts.resize(extCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, exts.data());
+
+    for (const auto& e : exts) {
+        if (!strcmp(e.extensionName, VK_EXT_ROBUSTNESS_2_EXTENSION_NAME)) {
+            VkPhysicalDeviceRobustness2FeaturesEXT robustness2 = { };
+            robustness2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT;
+
+            VkPhysicalDeviceFeatures2 features = { };
+            features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            features.pNext = &robustness2;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+            hasRobustness2 = robustness2.robustBufferAccess2 && features.features.robustBufferAccess;
+        }
+    }
+
+    return true;
+}
+
+static bool find_memory_type(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* index) {
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool create_buffer(Context& ctx, uint32_t slot, VkDeviceSize size, VkBufferUsageFlags usage, float fill) {
+    VkBufferCreateInfo bufferInfo = { };
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    PROBE_VK(vkCreateBuffer(ctx.device, &bufferInfo, nullptr, &ctx.buffers[slot]));
+
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements(ctx.device, ctx.buffers[slot], &memReqs);
+
+    VkMemoryAllocateInfo memInfo = { };
+    memInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memInfo.allocationSize = memReqs.size;
+
+    if (!find_memory_type(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+        | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &memInfo.memoryTypeIndex)) {
+        fprintf(stderr, "FAILED: no host visible memory\n");
+        return false;
+    }
+
+    PROBE_VK(vkAllocateMemory(ctx.device, &memInfo, nullptr, &ctx.memory[slot]));
+    PROBE_VK(vkBindBufferMemory(ctx.device, ctx.buffers[slot], ctx.memory[slot], 0));
+
+    void* data = nullptr;
+    PROBE_VK(vkMapMemory(ctx.device, ctx.memory[slot], 0, size, 0, &data));
+    std::fill_n(static_cast<float*>(data), size / sizeof(float), fill);
+    vkUnmapMemory(ctx.device, ctx.memory[slot]);
+    return true;
+}
+
+static bool setup_context(Context& ctx, bool robust, uint32_t invocations) {
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = { };
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = queueFamily;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    VkPhysicalDeviceRobustness2FeaturesEXT robustness2 = { };
+    robustness2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ROBUSTNESS_2_FEATURES_EXT;
+    robustness2.robustBufferAccess2 = VK_TRUE;
+
+    VkPhysicalDeviceFeatures2 features = { };
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &robustness2;
+    features.features.robustBufferAccess = VK_TRUE;
+
+    std::vector<const char*> exts;
+
+    uint32_t extCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, nullptr);
+    std::vector<VkExtensionProperties> available(extCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extCount, available.data());
+
+    // Must be enabled where it is exposed
+    for (const auto& e : available) {
+        if (!strcmp(e.extensionName, "VK_KHR_portability_subset"))
+            exts.push_back("VK_KHR_portability_subset");
+    }
+
+    VkDeviceCreateInfo deviceInfo = { };
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+
+    if (robust && hasRobustness2) {
+        exts.push_back(VK_EXT_ROBUSTNESS_2_EXTENSION_NAME);
+        deviceInfo.pNext = &features;
+    }
+
+    deviceInfo.enabledExtensionCount = uint32_t(exts.size());
+    deviceInfo.ppEnabledExtensionNames = exts.data();
+    PROBE_VK(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &ctx.device));
+    vkGetDeviceQueue(ctx.device, queueFamily, 0, &ctx.queue);
+
+    VkCommandPoolCreateInfo poolInfo = { };
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    PROBE_VK(vkCreateCommandPool(ctx.device, &poolInfo, nullptr, &ctx.commandPool));
+
+    VkCommandBufferAllocateInfo allocInfo = { };
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = ctx.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    PROBE_VK(vkAllocateCommandBuffers(ctx.device, &allocInfo, &ctx.cmd));
+
+    VkFenceCreateInfo fenceInfo = { };
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    PROBE_VK(vkCreateFence(ctx.device, &fenceInfo, nullptr, &ctx.fence));
+
+    // Constants sized for vertex shaders, the largest set
+    if (!create_buffer(ctx, 0, 256 * 16, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 0.5f)
+     || !create_buffer(ctx, 1, VkDeviceSize(invocations) * 16, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 1.0f))
+        return false;
+
+    VkDescriptorSetLayoutBinding bindings[2] = { };
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = { };
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = bindings;
+    PROBE_VK(vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &ctx.setLayout));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = { };
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &ctx.setLayout;
+    PROBE_VK(vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &ctx.pipelineLayout));
+
+    VkDescriptorPoolSize poolSizes[2] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+
+    VkDescriptorPoolCreateInfo descriptorPoolInfo = { };
+    descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptorPoolInfo.maxSets = 1;
+    descriptorPoolInfo.poolSizeCount = 2;
+    descriptorPoolInfo.pPoolSizes = poolSizes;
+    PROBE_VK(vkCreateDescriptorPool(ctx.device, &descriptorPoolInfo, nullptr, &ctx.pool));
+
+    VkDescriptorSetAllocateInfo setInfo = { };
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = ctx.pool;
+    setInfo.descriptorSetCount = 1;
+    setInfo.pSetLayouts = &ctx.setLayout;
+    PROBE_VK(vkAllocateDescriptorSets(ctx.device, &setInfo, &ctx.set));
+
+    VkDescriptorBufferInfo bufferInfos[2] = {
+        { ctx.buffers[0], 0, VK_WHOLE_SIZE },
+        { ctx.buffers[1], 0, VK_WHOLE_SIZE },
+    };
+
+    VkWriteDescriptorSet writes[2] = { };
+    for (uint32_t i = 0; i < 2; i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = ctx.set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = bindings[i].descriptorType;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(ctx.device, 2, writes, 0, nullptr);
+    return true;
+}
+
+static void cleanup_context(Context& ctx) {
+    if (!ctx.device)
+        return;
+
+    vkDeviceWaitIdle(ctx.device);
+    vkDestroyDescriptorPool(ctx.device, ctx.pool, nullptr);
+    vkDestroyPipelineLayout(ctx.device, ctx.pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(ctx.device, ctx.setLayout, nullptr);
+
+    for (uint32_t i = 0; i < 2; i++) {
+        vkDestroyBuffer(ctx.device, ctx.buffers[i], nullptr);
+        vkFreeMemory(ctx.device, ctx.memory[i], nullptr);
+    }
+
+    vkDestroyFence(ctx.device, ctx.fence, nullptr);
+    vkDestroyCommandPool(ctx.device, ctx.commandPool, nullptr);
+    vkDestroyDevice(ctx.device, nullptr);
+}
+
+struct Timing {
+    double compileUs  = 0.0;
+    double dispatchUs = 0.0;
+};
+
+static bool run_kernel(Context& ctx, const Kernel& kernel, uint32_t invocations, uint32_t iterations, Timing& timing) {
+    std::vector<double> compiles, dispatches;
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        auto start = Clock::now();
+
+        VkShaderModuleCreateInfo moduleInfo = { };
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = kernel.code.size() * sizeof(uint32_t);
+        moduleInfo.pCode = kernel.code.data();
+
+        VkShaderModule module;
+        PROBE_VK(vkCreateShaderModule(ctx.device, &moduleInfo, nullptr, &module));
+
+        VkComputePipelineCreateInfo pipelineInfo = { };
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = ctx.pipelineLayout;
+
+        VkPipeline pipeline;
+        PROBE_VK(vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        compiles.push_back(elapsed_us(start));
+
+        vkDestroyShaderModule(ctx.device, module, nullptr);
+
+        VkCommandBufferBeginInfo beginInfo = { };
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        PROBE_VK(vkBeginCommandBuffer(ctx.cmd, &beginInfo));
+        vkCmdBindPipeline(ctx.cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        vkCmdBindDescriptorSets(ctx.cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ctx.pipelineLayout, 0, 1, &ctx.set, 0, nullptr);
+        vkCmdDispatch(ctx.cmd, invocations / 64, 1, 1);
+        PROBE_VK(vkEndCommandBuffer(ctx.cmd));
+
+        VkSubmitInfo submitInfo = { };
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &ctx.cmd;
+
+        start = Clock::now();
+        PROBE_VK(vkQueueSubmit(ctx.queue, 1, &submitInfo, ctx.fence));
+        PROBE_VK(vkWaitForFences(ctx.device, 1, &ctx.fence, VK_TRUE, UINT64_MAX));
+        dispatches.push_back(elapsed_us(start));
+
+        PROBE_VK(vkResetFences(ctx.device, 1, &ctx.fence));
+        PROBE_VK(vkResetCommandBuffer(ctx.cmd, 0));
+        vkDestroyPipeline(ctx.device, pipeline, nullptr);
+    }
+
+    timing.compileUs = median(compiles);
+    timing.dispatchUs = median(dispatches);
+    return true;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+struct Result {
+    bool                  supported = false;
+    bool                  ps        = false;
+    DxsoBoundsCheckStats  stats;
+    uint32_t              ops[2]    = { };
+    Timing                timing[2];
+};
+
+int main(int argc, char** argv) {
+    const char* traces = "traces";
+    uint32_t deviceIndex = 0;
+    uint32_t invocations = 65536;
+    uint32_t iterations = 5;
+    uint32_t limit = UINT32_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--traces") && i + 1 < argc)
+            traces = argv[++i];
+        else if (!strcmp(argv[i], "--device") && i + 1 < argc)
+            deviceIndex = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--invocations") && i + 1 < argc)
+            invocations = std::max(64, atoi(argv[++i])) & ~63u;
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--limit") && i + 1 < argc)
+            limit = uint32_t(std::max(1, atoi(argv[++i])));
+        else {
+            fprintf(stderr, "Usage: %s [--traces DIR] [--device N] [--invocations N] [--iterations N] [--limit N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> shaders = load_shaders(traces);
+
+    if (shaders.empty()) {
+        fprintf(stderr, "No shaders found in %s/*.d3d9trace\n", traces);
+        return 1;
+    }
+
+    if (shaders.size() > limit)
+        shaders.resize(limit);
+
+    Context contexts[2];
+
+    if (!setup_instance(deviceIndex)
+     || !setup_context(contexts[0], true, invocations)
+     || !setup_context(contexts[1], false, invocations)) {
+        cleanup_context(contexts[0]);
+        cleanup_context(contexts[1]);
+        if (instance) vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+
+    std::vector<Result> results(shaders.size());
+    bool failed = false;
+
+    for (size_t i = 0; i < shaders.size() && !failed; i++) {
+        const auto& code = shaders[i];
+        Result& r = results[i];
+
+        size_t dwords = D3D9GetShaderBytecodeSize(code.data(), code.size());
+        DxsoProgram program;
+
+        if (!dwords || !DxsoDecode(code.data(), dwords, program))
+            continue;
+
+        r.supported = true;
+        r.ps = program.type == DxsoProgramType::PixelShader;
+
+        for (uint32_t v = 0; v < 2 && !failed; v++) {
+            DxsoBoundsCheckPlan plan(program, v == 0);
+            Kernel kernel = make_kernel(program, plan);
+
+            if (v == 1)
+                r.stats = plan.GetStats();
+
+            r.ops[v] = kernel.ops;
+            failed = !run_kernel(contexts[v], kernel, invocations, iterations, r.timing[v]);
+        }
+    }
+
+    uint32_t supported = 0, withReads = 0;
+    uint64_t relativeReads = 0, ops[2] = { }, opsWithReads[2] = { };
+    double compileUs[2] = { }, dispatchUs[2] = { }, dispatchWithReads[2] = { };
+    bool first = true;
+
+    printf("{\n");
+    printf("  \"benchmark\": \"bounds_check\",\n");
+    printf("  \"traces\": \"%s\",\n", traces);
+    printf("  \"device\": \"%s\",\n", deviceProps.deviceName);
+    printf("  \"robustness2\": %s,\n", hasRobustness2 ? "true" : "false");
+    printf("  \"invocations\": %u,\n", invocations);
+    printf("  \"iterations\": %u,\n", iterations);
+    printf("  \"shaders\": [\n");
+
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const Result& r = results[i];
+
+        printf("%s    { \"index\": %zu, \"supported\": %s", first ? "" : ",\n", i, r.supported ? "true" : "false");
+        first = false;
+
+        if (r.supported) {
+            supported++;
+            relativeReads += r.stats.relativeReads;
+
+            for (uint32_t v = 0; v < 2; v++) {
+                ops[v]        += r.ops[v];
+                compileUs[v]  += r.timing[v].compileUs;
+                dispatchUs[v] += r.timing[v].dispatchUs;
+
+                if (r.stats.relativeReads) {
+                    opsWithReads[v]      += r.ops[v];
+                    dispatchWithReads[v] += r.timing[v].dispatchUs;
+                }
+            }
+
+            withReads += r.stats.relativeReads ? 1 : 0;
+
+            printf(", \"type\": \"%s\", \"instructions\": %u, \"relative_reads\": %u,\n",
+                r.ps ? "ps" : "vs", r.stats.instructions, r.stats.relativeReads);
+            printf("      \"robust\": { \"spirv_ops\": %u, \"compile_us\": %.1f, \"dispatch_us\": %.1f },\n",
+                r.ops[0], r.timing[0].compileUs, r.timing[0].dispatchUs);
+            printf("      \"manual\": { \"spirv_ops\": %u, \"compile_us\": %.1f, \"dispatch_us\": %.1f }",
+                r.ops[1], r.timing[1].compileUs, r.timing[1].dispatchUs);
+        }
+
+        printf(" }");
+    }
+
+    auto ratio = [] (double a, double b) { return b > 0.0 ? a / b : 0.0; };
+
+    printf("\n  ],\n");
+    printf("  \"total\": {\n");
+    printf("    \"unique\": %zu,\n", shaders.size());
+    printf("    \"supported\": %u,\n", supported);
+    printf("    \"with_relative_reads\": %u,\n", withReads);
+    printf("    \"relative_reads\": %llu,\n", (unsigned long long)relativeReads);
+    printf("    \"robust\": { \"spirv_ops\": %llu, \"compile_us\": %.1f, \"dispatch_us\": %.1f },\n",
+        (unsigned long long)ops[0], compileUs[0], dispatchUs[0]);
+    printf("    \"manual\": { \"spirv_ops\": %llu, \"compile_us\": %.1f, \"dispatch_us\": %.1f },\n",
+        (unsigned long long)ops[1], compileUs[1], dispatchUs[1]);
+    printf("    \"spirv_ops_ratio\": %.3f,\n", ratio(double(ops[1]), double(ops[0])));
+    printf("    \"spirv_ops_ratio_with_reads\": %.3f,\n", ratio(double(opsWithReads[1]), double(opsWithReads[0])));
+    printf("    \"compile_ratio\": %.3f,\n", ratio(compileUs[1], compileUs[0]));
+    printf("    \"dispatch_ratio\": %.3f,\n", ratio(dispatchUs[1], dispatchUs[0]));
+    printf("    \"dispatch_ratio_with_reads\": %.3f\n", ratio(dispatchWithReads[1], dispatchWithReads[0]));
+    printf("  }\n");
+    printf("}\n");
+
+    cleanup_context(contexts[0]);
+    cleanup_context(contexts[1]);
+    vkDestroyInstance(instance, nullptr);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,1066 @@
+/*
+ * Vulkan API Cost Probes
+ *
+ * Measures the Vulkan operations our stutter analysis points at, on
+ * whatever driver the loader picks:
+ *
+ * - submit: vkQueueSubmit CPU time and submit-to-fence latency by
+ *   command buffers per submit
+ * - descriptors: allocate, update and bind cost per set by combined
+ *   image sampler count. 16 is a D3D9 pixel shader's sampler slots,
+ *   32 the same with DXVK's depth-compare duplicates (1x vs 2x).
+ *   Counts over the device's per-stage sampler or sampled image
+ *   limit (at least 16, MoltenVK may report just that) are reported
+ *   as skipped
+ * - pipelines: shader module and compute pipeline creation time by
+ *   shader size, each shader distinct so no driver cache hits
+ * - present: vkAcquireNextImageKHR and vkQueuePresentKHR CPU time on
+ *   a VK_EXT_headless_surface swapchain, skipped without it
+ *
+ * Times are median and p99 in microseconds. On Linux, run against a
+ * software driver (lavapipe, SwiftShader) via VK_ICD_FILENAMES to
+ * compare relative costs between changes; absolute numbers are only
+ * comparable on the same driver and machine.
+ *
+ * Run with: make probe-vulkan
+ * Output: JSON on stdout
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <vulkan/vulkan.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROBE_VK(call) do { \
+    VkResult _r = (call); \
+    if (_r != VK_SUCCESS) { \
+        fprintf(stderr, "FAILED: %s returned %d\n  %s:%d\n", #call, _r, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+// Global Vulkan state
+static VkInstance instance = VK_NULL_HANDLE;
+static VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+static VkDevice device = VK_NULL_HANDLE;
+static VkQueue queue = VK_NULL_HANDLE;
+static uint32_t queueFamily = 0;
+static VkCommandPool commandPool = VK_NULL_HANDLE;
+static VkPhysicalDeviceProperties deviceProps;
+static VkPhysicalDeviceMemoryProperties memoryProps;
+static int hasHeadless = 0;
+static int hasSwapchain = 0;
+
+static uint32_t iterations = 200;
+
+/* ============================================
+ * Timing
+ * ============================================ */
+typedef struct {
+    double median;
+    double p99;
+} Stats;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorts the samples, nearest-rank percentiles */
+static Stats get_stats(double* samples, uint32_t count) {
+    Stats s = { 0.0, 0.0 };
+    if (!count)
+        return s;
+
+    qsort(samples, count, sizeof(double), compare_double);
+    s.median = samples[(count - 1) / 2];
+    s.p99 = samples[(count * 99 + 99) / 100 - 1];
+    return s;
+}
+
+static void print_stats(const char* name, Stats s, const char* suffix) {
+    printf("\"%s\": { \"median\": %.3f, \"p99\": %.3f }%s", name, s.median, s.p99, suffix);
+}
+
+/* ============================================
+ * Helpers
+ * ============================================ */
+static int has_extension(const VkExtensionProperties* exts, uint32_t count, const char* name) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(exts[i].extensionName, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int find_memory_type(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* index) {
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Compute shader doing a chain of `ops` dependent float operations on
+ * a storage buffer value, so the driver can neither fold nor drop
+ * them. `seed` goes into a constant to make every shader distinct.
+ */
+typedef struct {
+    uint32_t* words;
+    uint32_t count;
+    uint32_t capacity;
+} SpirvBuffer;
+
+static void spv_push(SpirvBuffer* b, uint32_t word) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        b->words = realloc(b->words, b->capacity * sizeof(uint32_t));
+    }
+    b->words[b->count++] = word;
+}
+
+static void spv_op(SpirvBuffer* b, uint32_t op, uint32_t n, const uint32_t* operands) {
+    spv_push(b, ((n + 1) << 16) | op);
+    for (uint32_t i = 0; i < n; i++)
+        spv_push(b, operands[i]);
+}
+
+#define SPV(b, op, ...) do { \
+    const uint32_t _ops[] = { __VA_ARGS__ }; \
+    spv_op(b, op, COUNT(_ops), _ops); \
+} while(0)
+
+static SpirvBuffer make_compute_shader(uint32_t ops, uint32_t seed) {
+    enum {
+        idVoid = 1, idFnType, idFloat, idStruct, idPtrStruct, idPtrFloat, idInt,
+        idZero, idSeed, idScale, idVar, idMain, idLabel, idPtr, idFirst
+    };
+
+    float seedValue = 1.0f + (float)seed * 1e-6f;
+    float scaleValue = 0.999f;
+    uint32_t seedBits, scaleBits;
+    memcpy(&seedBits, &seedValue, sizeof(seedBits));
+    memcpy(&scaleBits, &scaleValue, sizeof(scaleBits));
+
+    SpirvBuffer b = { NULL, 0, 0 };
+
+    // Header, bound patched below
+    spv_push(&b, 0x07230203u);
+    spv_push(&b, 0x00010000u);
+    spv_push(&b, 0);
+    spv_push(&b, 0);
+    spv_push(&b, 0);
+
+    SPV(&b, 17, 1);                                 // OpCapability Shader
+    SPV(&b, 14, 0, 1);                              // OpMemoryModel Logical GLSL450
+    SPV(&b, 15, 5, idMain, 0x6e69616du, 0);         // OpEntryPoint GLCompute "main"
+    SPV(&b, 16, idMain, 17, 1, 1, 1);               // OpExecutionMode LocalSize 1 1 1
+    SPV(&b, 71, idStruct, 3);                       // OpDecorate BufferBlock
+    SPV(&b, 72, idStruct, 0, 35, 0);                // OpMemberDecorate Offset 0
+    SPV(&b, 71, idVar, 34, 0);                      // OpDecorate DescriptorSet 0
+    SPV(&b, 71, idVar, 33, 0);                      // OpDecorate Binding 0
+    SPV(&b, 19, idVoid);                            // OpTypeVoid
+    SPV(&b, 33, idFnType, idVoid);                  // OpTypeFunction
+    SPV(&b, 22, idFloat, 32);                       // OpTypeFloat 32
+    SPV(&b, 30, idStruct, idFloat);                 // OpTypeStruct
+    SPV(&b, 32, idPtrStruct, 2, idStruct);          // OpTypePointer Uniform
+    SPV(&b, 32, idPtrFloat, 2, idFloat);            // OpTypePointer Uniform
+    SPV(&b, 21, idInt, 32, 1);                      // OpTypeInt 32 signed
+    SPV(&b, 43, idInt, idZero, 0);                  // OpConstant
+    SPV(&b, 43, idFloat, idSeed, seedBits);
+    SPV(&b, 43, idFloat, idScale, scaleBits);
+    SPV(&b, 59, idPtrStruct, idVar, 2);             // OpVariable Uniform
+    SPV(&b, 54, idVoid, idMain, 0, idFnType);       // OpFunction
+    SPV(&b, 248, idLabel);                          // OpLabel
+    SPV(&b, 65, idPtrFloat, idPtr, idVar, idZero);  // OpAccessChain
+    SPV(&b, 61, idFloat, idFirst, idPtr);           // OpLoad
+
+    uint32_t value = idFirst;
+    for (uint32_t i = 0; i < ops; i++) {
+        uint32_t id = idFirst + 1 + i;
+        if (i & 1)
+            SPV(&b, 129, idFloat, id, value, idSeed);   // OpFAdd
+        else
+            SPV(&b, 133, idFloat, id, value, idScale);  // OpFMul
+        value = id;
+    }
+
+    SPV(&b, 62, idPtr, value);                      // OpStore
+    spv_push(&b, (1u << 16) | 253);                 // OpReturn
+    spv_push(&b, (1u << 16) | 56);                  // OpFunctionEnd
+
+    b.words[3] = value + 1;
+    return b;
+}
+
+/* ============================================
+ * Probe: Queue submission
+ * ============================================ */
+static const uint32_t submitBatches[] = { 1, 4, 16, 64 };
+
+typedef struct {
+    Stats submit;
+    Stats roundtrip;
+} SubmitResult;
+
+static int probe_submit(SubmitResult* results) {
+    enum { MaxBatch = 64 };
+    VkCommandBuffer cmds[MaxBatch];
+
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = MaxBatch,
+    };
+    PROBE_VK(vkAllocateCommandBuffers(device, &allocInfo, cmds));
+
+    // Empty command buffers: the cost measured is the submission itself
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    for (uint32_t i = 0; i < MaxBatch; i++) {
+        PROBE_VK(vkBeginCommandBuffer(cmds[i], &beginInfo));
+        PROBE_VK(vkEndCommandBuffer(cmds[i]));
+    }
+
+    VkFenceCreateInfo fenceInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence;
+    PROBE_VK(vkCreateFence(device, &fenceInfo, NULL, &fence));
+
+    double* submitTimes = malloc(iterations * sizeof(double));
+    double* roundTimes = malloc(iterations * sizeof(double));
+
+    for (uint32_t b = 0; b < COUNT(submitBatches); b++) {
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = submitBatches[b],
+            .pCommandBuffers = cmds,
+        };
+
+        for (uint32_t i = 0; i < iterations + 10; i++) {
+            double t0 = now_us();
+            PROBE_VK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+            double t1 = now_us();
+            PROBE_VK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+            double t2 = now_us();
+            PROBE_VK(vkResetFences(device, 1, &fence));
+
+            // First few warm up the driver's submission path
+            if (i >= 10) {
+                submitTimes[i - 10] = t1 - t0;
+                roundTimes[i - 10] = t2 - t0;
+            }
+        }
+
+        results[b].submit = get_stats(submitTimes, iterations);
+        results[b].roundtrip = get_stats(roundTimes, iterations);
+    }
+
+    free(submitTimes);
+    free(roundTimes);
+    vkDestroyFence(device, fence, NULL);
+    vkFreeCommandBuffers(device, commandPool, MaxBatch, cmds);
+    return 1;
+}
+
+/* ============================================
+ * Probe: Descriptor sets
+ * ============================================ */
+static const uint32_t descriptorCounts[] = { 1, 4, 16, 32 };
+
+typedef struct {
+    Stats allocate;
+    Stats update;
+    Stats bind;
+    int skipped;            // over the per-stage limit
+} DescriptorResult;
+
+/* Combined image samplers one fragment shader stage can use */
+static uint32_t descriptor_limit(void) {
+    const VkPhysicalDeviceLimits* limits = &deviceProps.limits;
+    uint32_t limit = limits->maxPerStageDescriptorSamplers;
+
+    if (limit > limits->maxPerStageDescriptorSampledImages)
+        limit = limits->maxPerStageDescriptorSampledImages;
+    if (limit > limits->maxPerStageResources)
+        limit = limits->maxPerStageResources;
+    return limit;
+}
+
+static int probe_descriptors(DescriptorResult* results) {
+    enum { SetsPerRound = 64, MaxBindings = 32 };
+
+    // One small sampled image is enough, descriptors only point at it
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { 4, 4, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkImage image;
+    PROBE_VK(vkCreateImage(device, &imageInfo, NULL, &image));
+
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements(device, image, &memReqs);
+
+    VkMemoryAllocateInfo memInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memReqs.size,
+    };
+    if (!find_memory_type(memReqs.memoryTypeBits, 0, &memInfo.memoryTypeIndex)) {
+        fprintf(stderr, "FAILED: no memory type for image\n");
+        return 0;
+    }
+
+    VkDeviceMemory memory;
+    PROBE_VK(vkAllocateMemory(device, &memInfo, NULL, &memory));
+    PROBE_VK(vkBindImageMemory(device, image, memory, 0));
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+    };
+    VkImageView view;
+    PROBE_VK(vkCreateImageView(device, &viewInfo, NULL, &view));
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .maxLod = 0.25f,
+    };
+    VkSampler sampler;
+    PROBE_VK(vkCreateSampler(device, &samplerInfo, NULL, &sampler));
+
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer cmd;
+    PROBE_VK(vkAllocateCommandBuffers(device, &allocInfo, &cmd));
+
+    uint32_t rounds = iterations / 4 + 1;
+    double* allocTimes = malloc(rounds * sizeof(double));
+    double* updateTimes = malloc(rounds * sizeof(double));
+    double* bindTimes = malloc(rounds * sizeof(double));
+
+    VkDescriptorImageInfo imageDescs[MaxBindings];
+    VkWriteDescriptorSet writes[MaxBindings];
+    VkDescriptorSetLayoutBinding bindings[MaxBindings];
+
+    for (uint32_t i = 0; i < MaxBindings; i++) {
+        imageDescs[i] = (VkDescriptorImageInfo) { sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        };
+    }
+
+    for (uint32_t c = 0; c < COUNT(descriptorCounts); c++) {
+        uint32_t count = descriptorCounts[c];
+
+        // Larger layouts would be invalid usage on this device
+        results[c].skipped = count > descriptor_limit();
+        if (results[c].skipped)
+            continue;
+
+        // One binding per slot, as DXVK lays out D3D9 samplers
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = count,
+            .pBindings = bindings,
+        };
+        VkDescriptorSetLayout setLayout;
+        PROBE_VK(vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &setLayout));
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+        };
+        VkPipelineLayout pipelineLayout;
+        PROBE_VK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout));
+
+        VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, count * SetsPerRound };
+        VkDescriptorPoolCreateInfo poolInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .maxSets = SetsPerRound,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize,
+        };
+        VkDescriptorPool pool;
+        PROBE_VK(vkCreateDescriptorPool(device, &poolInfo, NULL, &pool));
+
+        VkDescriptorSet sets[SetsPerRound];
+
+        for (uint32_t r = 0; r < rounds + 2; r++) {
+            VkDescriptorSetAllocateInfo setInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool = pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &setLayout,
+            };
+
+            // Sets one at a time, as DXVK allocates them per draw
+            double t0 = now_us();
+            for (uint32_t s = 0; s < SetsPerRound; s++)
+                PROBE_VK(vkAllocateDescriptorSets(device, &setInfo, &sets[s]));
+            double t1 = now_us();
+
+            for (uint32_t s = 0; s < SetsPerRound; s++) {
+                for (uint32_t i = 0; i < count; i++) {
+                    writes[i] = (VkWriteDescriptorSet) {
+                        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet = sets[s],
+                        .dstBinding = i,
+                        .descriptorCount = 1,
+                        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .pImageInfo = &imageDescs[i],
+                    };
+                }
+                vkUpdateDescriptorSets(device, count, writes, 0, NULL);
+            }
+            double t2 = now_us();
+
+            VkCommandBufferBeginInfo beginInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            };
+            PROBE_VK(vkBeginCommandBuffer(cmd, &beginInfo));
+            double t3 = now_us();
+            for (uint32_t s = 0; s < SetsPerRound; s++) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout, 0, 1, &sets[s], 0, NULL);
+            }
+            double t4 = now_us();
+            PROBE_VK(vkEndCommandBuffer(cmd));
+            PROBE_VK(vkResetCommandBuffer(cmd, 0));
+            PROBE_VK(vkResetDescriptorPool(device, pool, 0));
+
+            if (r >= 2) {
+                allocTimes[r - 2] = (t1 - t0) / SetsPerRound;
+                updateTimes[r - 2] = (t2 - t1) / SetsPerRound;
+                bindTimes[r - 2] = (t4 - t3) / SetsPerRound;
+            }
+        }
+
+        results[c].allocate = get_stats(allocTimes, rounds);
+        results[c].update = get_stats(updateTimes, rounds);
+        results[c].bind = get_stats(bindTimes, rounds);
+
+        vkDestroyDescriptorPool(device, pool, NULL);
+        vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+        vkDestroyDescriptorSetLayout(device, setLayout, NULL);
+    }
+
+    free(allocTimes);
+    free(updateTimes);
+    free(bindTimes);
+    vkFreeCommandBuffers(device, commandPool, 1, &cmd);
+    vkDestroySampler(device, sampler, NULL);
+    vkDestroyImageView(device, view, NULL);
+    vkDestroyImage(device, image, NULL);
+    vkFreeMemory(device, memory, NULL);
+    return 1;
+}
+
+/* ============================================
+ * Probe: Pipeline creation
+ * ============================================ */
+static const uint32_t shaderOps[] = { 16, 64, 256, 1024, 4096 };
+
+typedef struct {
+    uint32_t bytes;
+    Stats module;
+    Stats pipeline;
+} PipelineResult;
+
+static int probe_pipelines(PipelineResult* results) {
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    VkDescriptorSetLayout setLayout;
+    PROBE_VK(vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &setLayout));
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+    };
+    VkPipelineLayout pipelineLayout;
+    PROBE_VK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout));
+
+    // Compiles are slow, especially on software drivers
+    uint32_t count = iterations / 10 + 1;
+    double* moduleTimes = malloc(count * sizeof(double));
+    double* pipelineTimes = malloc(count * sizeof(double));
+    uint32_t seed = 0;
+
+    for (uint32_t s = 0; s < COUNT(shaderOps); s++) {
+        for (uint32_t i = 0; i < count; i++) {
+            SpirvBuffer code = make_compute_shader(shaderOps[s], ++seed);
+            results[s].bytes = code.count * sizeof(uint32_t);
+
+            VkShaderModuleCreateInfo moduleInfo = {
+                .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+                .codeSize = code.count * sizeof(uint32_t),
+                .pCode = code.words,
+            };
+
+            double t0 = now_us();
+            VkShaderModule module;
+            PROBE_VK(vkCreateShaderModule(device, &moduleInfo, NULL, &module));
+            double t1 = now_us();
+
+            VkComputePipelineCreateInfo pipelineInfo = {
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage = {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = module,
+                    .pName = "main",
+                },
+                .layout = pipelineLayout,
+            };
+
+            VkPipeline pipeline;
+            PROBE_VK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &pipeline));
+            double t2 = now_us();
+
+            moduleTimes[i] = t1 - t0;
+            pipelineTimes[i] = t2 - t1;
+
+            vkDestroyPipeline(device, pipeline, NULL);
+            vkDestroyShaderModule(device, module, NULL);
+            free(code.words);
+        }
+
+        results[s].module = get_stats(moduleTimes, count);
+        results[s].pipeline = get_stats(pipelineTimes, count);
+    }
+
+    free(moduleTimes);
+    free(pipelineTimes);
+    vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+    vkDestroyDescriptorSetLayout(device, setLayout, NULL);
+    return 1;
+}
+
+/* ============================================
+ * Probe: Presentation
+ * ============================================ */
+typedef struct {
+    uint32_t images;
+    VkExtent2D extent;
+    Stats acquire;
+    Stats present;
+    Stats frame;
+} PresentResult;
+
+static int probe_present(PresentResult* result) {
+    enum { MaxImages = 8 };
+
+    PFN_vkCreateHeadlessSurfaceEXT pfnCreateHeadlessSurface =
+        (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+    if (!pfnCreateHeadlessSurface) {
+        fprintf(stderr, "FAILED: vkCreateHeadlessSurfaceEXT not found\n");
+        return 0;
+    }
+
+    VkHeadlessSurfaceCreateInfoEXT surfaceInfo = {
+        .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+    };
+    VkSurfaceKHR surface;
+    PROBE_VK(pfnCreateHeadlessSurface(instance, &surfaceInfo, NULL, &surface));
+
+    VkBool32 supported = VK_FALSE;
+    PROBE_VK(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, queueFamily, surface, &supported));
+    if (!supported) {
+        fprintf(stderr, "FAILED: queue family cannot present\n");
+        vkDestroySurfaceKHR(instance, surface, NULL);
+        return 0;
+    }
+
+    VkSurfaceCapabilitiesKHR caps;
+    PROBE_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &caps));
+
+    uint32_t formatCount = 1;
+    VkSurfaceFormatKHR format;
+    VkResult vr = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, &format);
+    if (vr != VK_SUCCESS && vr != VK_INCOMPLETE) {
+        fprintf(stderr, "FAILED: vkGetPhysicalDeviceSurfaceFormatsKHR returned %d\n", vr);
+        return 0;
+    }
+
+    VkExtent2D extent = caps.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        extent.width = 1280;
+        extent.height = 720;
+    }
+
+    uint32_t imageCount = caps.minImageCount < 2 ? 2 : caps.minImageCount;
+    if (caps.maxImageCount && imageCount > caps.maxImageCount)
+        imageCount = caps.maxImageCount;
+
+    VkCompositeAlphaFlagBitsKHR alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    while (!(caps.supportedCompositeAlpha & alpha) && alpha < VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR)
+        alpha = (VkCompositeAlphaFlagBitsKHR)(alpha << 1);
+
+    // FIFO is the only mode every driver has
+    VkSwapchainCreateInfoKHR swapchainInfo = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = surface,
+        .minImageCount = imageCount,
+        .imageFormat = format.format,
+        .imageColorSpace = format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .preTransform = caps.currentTransform,
+        .compositeAlpha = alpha,
+        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        .clipped = VK_TRUE,
+    };
+    VkSwapchainKHR swapchain;
+    PROBE_VK(vkCreateSwapchainKHR(device, &swapchainInfo, NULL, &swapchain));
+
+    // The driver may create more images than requested, and the
+    // acquire index can be any of them
+    PROBE_VK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, NULL));
+    if (imageCount > MaxImages) {
+        fprintf(stderr, "FAILED: swapchain has %u images, at most %u supported\n", imageCount, MaxImages);
+        vkDestroySwapchainKHR(device, swapchain, NULL);
+        vkDestroySurfaceKHR(instance, surface, NULL);
+        return 0;
+    }
+
+    VkImage images[MaxImages];
+    PROBE_VK(vkGetSwapchainImagesKHR(device, swapchain, &imageCount, images));
+
+    // One command buffer per image, moving it to the present layout
+    VkCommandBuffer cmds[MaxImages];
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = imageCount,
+    };
+    PROBE_VK(vkAllocateCommandBuffers(device, &allocInfo, cmds));
+
+    VkSemaphore acquireSems[2];
+    VkSemaphore renderSems[MaxImages];
+    VkSemaphoreCreateInfo semInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+
+    for (uint32_t i = 0; i < imageCount; i++) {
+        VkCommandBufferBeginInfo beginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        PROBE_VK(vkBeginCommandBuffer(cmds[i], &beginInfo));
+
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = images[i],
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        };
+        vkCmdPipelineBarrier(cmds[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        PROBE_VK(vkEndCommandBuffer(cmds[i]));
+        PROBE_VK(vkCreateSemaphore(device, &semInfo, NULL, &renderSems[i]));
+    }
+
+    for (uint32_t i = 0; i < 2; i++)
+        PROBE_VK(vkCreateSemaphore(device, &semInfo, NULL, &acquireSems[i]));
+
+    VkFenceCreateInfo fenceInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence;
+    PROBE_VK(vkCreateFence(device, &fenceInfo, NULL, &fence));
+
+    uint32_t frames = iterations;
+    double* acquireTimes = malloc(frames * sizeof(double));
+    double* presentTimes = malloc(frames * sizeof(double));
+    double* frameTimes = malloc(frames * sizeof(double));
+    double last = 0.0;
+
+    for (uint32_t f = 0; f < frames + 10; f++) {
+        VkSemaphore acquireSem = acquireSems[f & 1];
+        uint32_t index;
+
+        double t0 = now_us();
+        vr = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, acquireSem, VK_NULL_HANDLE, &index);
+        double t1 = now_us();
+        if (vr != VK_SUCCESS && vr != VK_SUBOPTIMAL_KHR) {
+            fprintf(stderr, "FAILED: vkAcquireNextImageKHR returned %d\n", vr);
+            return 0;
+        }
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &acquireSem,
+            .pWaitDstStageMask = &waitStage,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &cmds[index],
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &renderSems[index],
+        };
+        PROBE_VK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+
+        VkPresentInfoKHR presentInfo = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &renderSems[index],
+            .swapchainCount = 1,
+            .pSwapchains = &swapchain,
+            .pImageIndices = &index,
+        };
+
+        double t2 = now_us();
+        vr = vkQueuePresentKHR(queue, &presentInfo);
+        double t3 = now_us();
+        if (vr != VK_SUCCESS && vr != VK_SUBOPTIMAL_KHR) {
+            fprintf(stderr, "FAILED: vkQueuePresentKHR returned %d\n", vr);
+            return 0;
+        }
+
+        // Keeps semaphores and command buffers free for reuse
+        PROBE_VK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+        PROBE_VK(vkResetFences(device, 1, &fence));
+
+        if (f >= 10) {
+            acquireTimes[f - 10] = t1 - t0;
+            presentTimes[f - 10] = t3 - t2;
+            frameTimes[f - 10] = t0 - last;
+        }
+        last = t0;
+    }
+
+    PROBE_VK(vkQueueWaitIdle(queue));
+
+    result->images = imageCount;
+    result->extent = extent;
+    result->acquire = get_stats(acquireTimes, frames);
+    result->present = get_stats(presentTimes, frames);
+    result->frame = get_stats(frameTimes, frames);
+
+    free(acquireTimes);
+    free(presentTimes);
+    free(frameTimes);
+    vkDestroyFence(device, fence, NULL);
+    for (uint32_t i = 0; i < 2; i++)
+        vkDestroySemaphore(device, acquireSems[i], NULL);
+    for (uint32_t i = 0; i < imageCount; i++)
+        vkDestroySemaphore(device, renderSems[i], NULL);
+    vkFreeCommandBuffers(device, commandPool, imageCount, cmds);
+    vkDestroySwapchainKHR(device, swapchain, NULL);
+    vkDestroySurfaceKHR(instance, surface, NULL);
+    return 1;
+}
+
+/* ============================================
+ * Setup
+ * ============================================ */
+static int setup_vulkan(uint32_t deviceIndex, int wantPresent) {
+    uint32_t extCount = 0;
+    vkEnumerateInstanceExtensionProperties(NULL, &extCount, NULL);
+    VkExtensionProperties* exts = malloc((extCount + 1) * sizeof(VkExtensionProperties));
+    vkEnumerateInstanceExtensionProperties(NULL, &extCount, exts);
+
+    const char* instanceExts[3];
+    uint32_t instanceExtCount = 0;
+    VkInstanceCreateFlags instanceFlags = 0;
+
+    hasHeadless = wantPresent
+        && has_extension(exts, extCount, VK_KHR_SURFACE_EXTENSION_NAME)
+        && has_extension(exts, extCount, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+
+    if (hasHeadless) {
+        instanceExts[instanceExtCount++] = VK_KHR_SURFACE_EXTENSION_NAME;
+        instanceExts[instanceExtCount++] = VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME;
+    }
+
+    // MoltenVK is only listed with portability enumeration
+    if (has_extension(exts, extCount, "VK_KHR_portability_enumeration")) {
+        instanceExts[instanceExtCount++] = "VK_KHR_portability_enumeration";
+        instanceFlags |= 0x00000001; // VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR
+    }
+    free(exts);
+
+    VkApplicationInfo appInfo = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "Vulkan API Cost Probes",
+        .apiVersion = VK_API_VERSION_1_1,
+    };
+
+    VkInstanceCreateInfo instanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .flags = instanceFlags,
+        .pApplicationInfo = &appInfo,
+        .enabledExtensionCount = instanceExtCount,
+        .ppEnabledExtensionNames = instanceExts,
+    };
+
+    if (vkCreateInstance(&instanceInfo, NULL, &instance) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create instance\n");
+        return 0;
+    }
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, NULL);
+    if (deviceIndex >= deviceCount) {
+        fprintf(stderr, "Device %u not found, %u available\n", deviceIndex, deviceCount);
+        return 0;
+    }
+
+    VkPhysicalDevice* devices = malloc(deviceCount * sizeof(VkPhysicalDevice));
+    vkEnumeratePhysicalDevices(instance, &deviceCount, devices);
+    physicalDevice = devices[deviceIndex];
+    free(devices);
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProps);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+    fprintf(stderr, "Using device: %s\n", deviceProps.deviceName);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, NULL);
+    VkQueueFamilyProperties* families = malloc(familyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+
+    const VkQueueFlags wanted = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    queueFamily = UINT32_MAX;
+    for (uint32_t i = 0; i < familyCount && queueFamily == UINT32_MAX; i++) {
+        if ((families[i].queueFlags & wanted) == wanted)
+            queueFamily = i;
+    }
+    free(families);
+
+    if (queueFamily == UINT32_MAX) {
+        fprintf(stderr, "No graphics and compute queue\n");
+        return 0;
+    }
+
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extCount, NULL);
+    exts = malloc((extCount + 1) * sizeof(VkExtensionProperties));
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extCount, exts);
+
+    const char* deviceExts[2];
+    uint32_t deviceExtCount = 0;
+
+    hasSwapchain = hasHeadless && has_extension(exts, extCount, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (hasSwapchain)
+        deviceExts[deviceExtCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+
+    // Must be enabled where it is exposed
+    if (has_extension(exts, extCount, "VK_KHR_portability_subset"))
+        deviceExts[deviceExtCount++] = "VK_KHR_portability_subset";
+    free(exts);
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = queueFamily,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+
+    VkDeviceCreateInfo deviceInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queueInfo,
+        .enabledExtensionCount = deviceExtCount,
+        .ppEnabledExtensionNames = deviceExts,
+    };
+
+    if (vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create device\n");
+        return 0;
+    }
+
+    vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+    if (vkCreateCommandPool(device, &poolInfo, NULL, &commandPool) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create command pool\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+static void cleanup_vulkan(void) {
+    if (commandPool) vkDestroyCommandPool(device, commandPool, NULL);
+    if (device) vkDestroyDevice(device, NULL);
+    if (instance) vkDestroyInstance(instance, NULL);
+}
+
+static const char* device_type_name(VkPhysicalDeviceType type) {
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+        default: return "other";
+    }
+}
+
+int main(int argc, char** argv) {
+    uint32_t deviceIndex = 0;
+    int wantPresent = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--device") && i + 1 < argc)
+            deviceIndex = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = (uint32_t)atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-present"))
+            wantPresent = 0;
+        else {
+            fprintf(stderr, "Usage: %s [--device N] [--iterations N] [--no-present]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (iterations < 10)
+        iterations = 10;
+
+    if (!setup_vulkan(deviceIndex, wantPresent)) {
+        cleanup_vulkan();
+        return 1;
+    }
+
+    SubmitResult submit[COUNT(submitBatches)];
+    DescriptorResult descriptors[COUNT(descriptorCounts)];
+    PipelineResult pipelines[COUNT(shaderOps)];
+    PresentResult present;
+
+    int failed = 0;
+    int submitOk = probe_submit(submit);
+    int descriptorsOk = probe_descriptors(descriptors);
+    int pipelinesOk = probe_pipelines(pipelines);
+    int presentOk = hasSwapchain && probe_present(&present);
+
+    failed = !submitOk + !descriptorsOk + !pipelinesOk + (hasSwapchain && !presentOk);
+
+    printf("{\n");
+    printf("  \"benchmark\": \"probe_vulkan\",\n");
+    printf("  \"device\": \"%s\",\n", deviceProps.deviceName);
+    printf("  \"device_type\": \"%s\",\n", device_type_name(deviceProps.deviceType));
+    printf("  \"api_version\": \"%u.%u.%u\",\n", VK_VERSION_MAJOR(deviceProps.apiVersion),
+        VK_VERSION_MINOR(deviceProps.apiVersion), VK_VERSION_PATCH(deviceProps.apiVersion));
+    printf("  \"driver_version\": %u,\n", deviceProps.driverVersion);
+    printf("  \"iterations\": %u,\n", iterations);
+
+    printf("  \"submit\": ");
+    if (submitOk) {
+        printf("[\n");
+        for (uint32_t i = 0; i < COUNT(submitBatches); i++) {
+            printf("    { \"command_buffers\": %u, ", submitBatches[i]);
+            print_stats("submit_us", submit[i].submit, ", ");
+            print_stats("roundtrip_us", submit[i].roundtrip, " }");
+            printf("%s\n", i + 1 < COUNT(submitBatches) ? "," : "");
+        }
+        printf("  ],\n");
+    } else {
+        printf("null,\n");
+    }
+
+    printf("  \"descriptors\": ");
+    if (descriptorsOk) {
+        printf("[\n");
+        for (uint32_t i = 0; i < COUNT(descriptorCounts); i++) {
+            printf("    { \"bindings\": %u, ", descriptorCounts[i]);
+            if (descriptors[i].skipped) {
+                printf("\"skipped\": \"per-stage limit %u\" }", descriptor_limit());
+            } else {
+                print_stats("allocate_us", descriptors[i].allocate, ", ");
+                print_stats("update_us", descriptors[i].update, ", ");
+                print_stats("bind_us", descriptors[i].bind, " }");
+            }
+            printf("%s\n", i + 1 < COUNT(descriptorCounts) ? "," : "");
+        }
+        printf("  ],\n");
+    } else {
+        printf("null,\n");
+    }
+
+    printf("  \"pipelines\": ");
+    if (pipelinesOk) {
+        printf("[\n");
+        for (uint32_t i = 0; i < COUNT(shaderOps); i++) {
+            printf("    { \"ops\": %u, \"bytes\": %u, ", shaderOps[i], pipelines[i].bytes);
+            print_stats("module_us", pipelines[i].module, ", ");
+            print_stats("pipeline_us", pipelines[i].pipeline, " }");
+            printf("%s\n", i + 1 < COUNT(shaderOps) ? "," : "");
+        }
+        printf("  ],\n");
+    } else {
+        printf("null,\n");
+    }
+
+    printf("  \"present\": ");
+    if (presentOk) {
+        printf("{ \"images\": %u, \"width\": %u, \"height\": %u,\n    ",
+            present.images, present.extent.width, present.extent.height);
+        print_stats("acquire_us", present.acquire, ",\n    ");
+        print_stats("present_us", present.present, ",\n    ");
+        print_stats("frame_us", present.frame, " }\n");
+    } else {
+        printf("{ \"skipped\": \"%s\" }\n", !wantPresent ? "--no-present"
+            : hasSwapchain ? "failed" : "no VK_EXT_headless_surface");
+    }
+    printf("}\n");
+
+    cleanup_vulkan();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * Biased Device Lock Test Suite
+ *
+ * These tests verify the owner-biased recursive mutex
+ * (src/util/sync/sync_biased.h): the owning thread enters without
+ * touching the mutex, other threads revoke the bias, and mutual
+ * exclusion holds with and without the process-wide barrier.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_biased_owner_fast_path - Does the owner stop taking the mutex?
+ * 2. test_biased_recursion - Do nested locks across a grant unwind?
+ * 3. test_biased_revocation - Does another thread revoke and exclude?
+ * 4. test_biased_rebias - Does the bias move to a new owner?
+ * 5. test_biased_exclusion - Is the lock exclusive under contention?
+ * 6. test_biased_revocation_unlocked - Is the mutex free while revoking?
+ */
+
+#include "util/sync/sync_biased.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace dxvk::sync;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static BiasedMutexOptions make_options(bool asymmetric) {
+    BiasedMutexOptions options;
+    options.rebiasThreshold = 8;
+    options.asymmetric = asymmetric;
+    return options;
+}
+
+/* ============================================
+ * Test: Owner fast path
+ * ============================================ */
+int test_biased_owner_fast_path(void) {
+    printf("TEST: biased_owner_fast_path\n");
+
+    BiasedRecursiveMutex mutex(make_options(true));
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        mutex.lock();
+        mutex.unlock();
+    }
+
+    BiasedMutexStats stats = mutex.getStats();
+    TEST_ASSERT(stats.rebiases == 1, "Lock not biased towards the only thread");
+    TEST_ASSERT(stats.slowAcquires == 8, "Owner kept taking the mutex");
+    TEST_ASSERT(stats.contentions == 0 && stats.revocations == 0, "Spurious contention");
+
+    TEST_ASSERT(mutex.try_lock(), "try_lock failed for the owner");
+    mutex.unlock();
+    TEST_ASSERT(mutex.getStats().slowAcquires == 8, "try_lock took the mutex");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Recursion across the bias grant
+ * ============================================ */
+int test_biased_recursion(void) {
+    printf("TEST: biased_recursion\n");
+
+    BiasedRecursiveMutex mutex(make_options(true));
+
+    // The eighth outer acquisition grants the bias while
+    // the mutex is held, the nested ones take the fast path
+    for (uint32_t i = 0; i < 16; i++) {
+        mutex.lock();
+        mutex.lock();
+        mutex.lock();
+        mutex.unlock();
+        mutex.unlock();
+        mutex.unlock();
+    }
+
+    // Every level must have been released, or this blocks
+    std::atomic<bool> acquired = { false };
+    std::thread other([&] {
+        mutex.lock();
+        acquired = true;
+        mutex.unlock();
+    });
+    other.join();
+
+    TEST_ASSERT(acquired, "Other thread did not get the lock");
+    TEST_ASSERT(mutex.getStats().slowAcquires == 9, "Nested locks took the mutex");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Revocation
+ * ============================================ */
+int test_biased_revocation(void) {
+    printf("TEST: biased_revocation\n");
+
+    BiasedRecursiveMutex mutex(make_options(true));
+
+    for (uint32_t i = 0; i < 16; i++) {
+        mutex.lock();
+        mutex.unlock();
+    }
+
+    // Owner is inside when the other thread arrives
+    mutex.lock();
+
+    std::atomic<bool> acquired = { false };
+    std::atomic<bool> release = { false };
+
+    std::thread other([&] {
+        mutex.lock();
+        acquired = true;
+        while (!release)
+            std::this_thread::yield();
+        mutex.unlock();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TEST_ASSERT(!acquired, "Other thread entered while the owner was inside");
+
+    mutex.unlock();
+
+    while (!acquired)
+        std::this_thread::yield();
+
+    // The former owner must now wait for the mutex
+    TEST_ASSERT(!mutex.try_lock(), "Former owner entered after revocation");
+
+    release = true;
+    other.join();
+
+    BiasedMutexStats stats = mutex.getStats();
+    TEST_ASSERT(stats.revocations == 1, "Bias not revoked");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Bias moves to a new owner
+ * ============================================ */
+int test_biased_rebias(void) {
+    printf("TEST: biased_rebias\n");
+
+    BiasedRecursiveMutex mutex(make_options(true));
+
+    for (uint32_t i = 0; i < 16; i++) {
+        mutex.lock();
+        mutex.unlock();
+    }
+
+    // e.g. a loading thread hands over to the render loop
+    std::thread other([&] {
+        for (uint32_t i = 0; i < 1000; i++) {
+            mutex.lock();
+            mutex.unlock();
+        }
+    });
+    other.join();
+
+    BiasedMutexStats stats = mutex.getStats();
+    TEST_ASSERT(stats.revocations == 1, "Bias not revoked once");
+    TEST_ASSERT(stats.rebiases == 2, "Bias not granted to the new thread");
+    TEST_ASSERT(stats.slowAcquires == 16, "New owner kept taking the mutex");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Mutual exclusion under contention
+ * ============================================ */
+static int run_exclusion(bool asymmetric) {
+    BiasedRecursiveMutex mutex(make_options(asymmetric));
+
+    const uint32_t threads = 4;
+    const uint32_t iterations = 20000;
+
+    uint64_t counter = 0;
+    std::atomic<uint32_t> inside = { 0 };
+    std::atomic<bool> overlap = { false };
+    std::vector<std::thread> workers;
+
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            for (uint32_t i = 0; i < iterations; i++) {
+                // Thread 0 is the game thread, the others call rarely
+                if (t && (i % 16))
+                    continue;
+
+                std::lock_guard lock(mutex);
+
+                if (inside.fetch_add(1) != 0)
+                    overlap = true;
+
+                counter += 1;
+                inside.fetch_sub(1);
+            }
+        });
+    }
+
+    for (auto& w : workers)
+        w.join();
+
+    uint64_t expected = iterations + (threads - 1) * (iterations / 16);
+
+    TEST_ASSERT(!overlap, "Two threads inside the lock");
+    TEST_ASSERT(counter == expected, "Lost updates");
+    return 1;
+}
+
+int test_biased_exclusion(void) {
+    printf("TEST: biased_exclusion\n");
+
+    printf("  process-wide barrier: %s\n",
+        AsymmetricBarrier::isSupported() ? "yes" : "no, using fences");
+
+    if (!run_exclusion(true))
+        return 0;
+
+    if (!run_exclusion(false))
+        return 0;
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Revocation waits without the mutex
+ * ============================================ */
+int test_biased_revocation_unlocked(void) {
+    printf("TEST: biased_revocation_unlocked\n");
+
+    BiasedRecursiveMutex mutex(make_options(true));
+
+    for (uint32_t i = 0; i < 16; i++) {
+        mutex.lock();
+        mutex.unlock();
+    }
+
+    mutex.lock();
+
+    std::atomic<bool> acquired = { false };
+
+    std::thread revoker([&] {
+        mutex.lock();
+        acquired = true;
+        mutex.unlock();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // A third thread takes the mutex while the revocation is pending,
+    // but must not enter while the owner is still inside
+    std::atomic<bool> done = { false };
+    std::atomic<bool> entered = { false };
+
+    std::thread third([&] {
+        mutex.getStats();
+
+        if (mutex.try_lock()) {
+            entered = true;
+            mutex.unlock();
+        }
+
+        done = true;
+    });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    while (!done && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+
+    bool freed = done;
+    bool excluded = !entered && !acquired;
+
+    mutex.unlock();
+    third.join();
+    revoker.join();
+
+    TEST_ASSERT(freed, "Mutex held while waiting for the owner");
+    TEST_ASSERT(excluded, "Thread entered while the owner was inside");
+    TEST_ASSERT(acquired, "Revoking thread never entered");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Biased Device Lock Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_biased_owner_fast_path()) passed++; else failed++;
+    if (test_biased_recursion()) passed++; else failed++;
+    if (test_biased_revocation()) passed++; else failed++;
+    if (test_biased_rebias()) passed++; else failed++;
+    if (test_biased_exclusion()) passed++; else failed++;
+    if (test_biased_revocation_unlocked()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
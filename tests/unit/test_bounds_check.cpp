@@ -0,0 +1,200 @@
+/*
+ * Bounds Check Test Suite
+ *
+ * These tests verify the shader bounds check plan
+ * (src/dxso/dxso_bounds_check.h): which constant loads the manual
+ * fallback for a missing robustBufferAccess2 guards, and the
+ * instruction counts it reports for both variants.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_bounds_constant_count - Is the right constant count used per shader type?
+ * 2. test_bounds_relative_reads - Are relative constant loads found, matrix rows included?
+ * 3. test_bounds_plan - Does only the manual variant guard them, and count the ops?
+ */
+
+#include "dxso/dxso_bounds_check.h"
+
+#include <stdio.h>
+
+#include <initializer_list>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* ============================================
+ * Bytecode assembler
+ * ============================================ */
+static const uint32_t Relative = 1u << 13;
+
+static uint32_t reg_token(DxsoRegisterType type, uint32_t index) {
+    uint32_t t = uint32_t(type);
+    return 0x80000000u | ((t & 0x7) << 28) | ((t & 0x18) << 8) | index;
+}
+
+static uint32_t dst(DxsoRegisterType type, uint32_t index) {
+    return reg_token(type, index) | (0xfu << 16);
+}
+
+static uint32_t src(DxsoRegisterType type, uint32_t index) {
+    return reg_token(type, index) | (0xe4u << 16);
+}
+
+struct Assembler {
+    std::vector<uint32_t> code;
+
+    Assembler(bool ps, uint32_t major) {
+        code.push_back((ps ? 0xffff0000u : 0xfffe0000u) | (major << 8));
+    }
+
+    void op(DxsoOpcode opcode, std::initializer_list<uint32_t> params) {
+        code.push_back(uint32_t(opcode) | (uint32_t(params.size()) << 24));
+        code.insert(code.end(), params.begin(), params.end());
+    }
+
+    DxsoProgram finish() {
+        code.push_back(uint32_t(DxsoOpcode::End));
+        DxsoProgram program;
+        if (!DxsoDecode(code.data(), code.size(), program))
+            program.instructions.clear();
+        return program;
+    }
+};
+
+static const DxsoRegisterType R = DxsoRegisterType::Temp;
+static const DxsoRegisterType V = DxsoRegisterType::Input;
+static const DxsoRegisterType C = DxsoRegisterType::Const;
+static const DxsoRegisterType A = DxsoRegisterType::Addr;
+static const DxsoRegisterType L = DxsoRegisterType::Loop;
+
+/* A skinning style vertex shader */
+static DxsoProgram skinning_shader() {
+    Assembler vs(false, 3);
+    vs.op(DxsoOpcode::Dcl, { 0x80000000u, dst(V, 0) });
+    vs.op(DxsoOpcode::Mova, { dst(A, 0), src(V, 1) });                                  // 1
+    vs.op(DxsoOpcode::Mul, { dst(R, 0), src(V, 0), src(C, 20) | Relative, src(A, 0) }); // 2
+    vs.op(DxsoOpcode::M4x3, { dst(R, 1), src(V, 0), src(C, 40) | Relative, src(A, 0) }); // 3: 3 rows
+    vs.op(DxsoOpcode::Mad, { dst(R, 2), src(C, 8) | Relative, src(A, 0),
+        src(C, 9) | Relative, src(A, 0), src(R, 0) });                                  // 4: two loads
+    vs.op(DxsoOpcode::Dp4, { dst(R, 3), src(R, 2), src(C, 4) });                        // 5: absolute
+    vs.op(DxsoOpcode::Mov, { dst(DxsoRegisterType::Output, 0), src(R, 3) });            // 6
+    return vs.finish();
+}
+
+/* ============================================
+ * Test: Constant count
+ * ============================================ */
+int test_bounds_constant_count(void) {
+    printf("TEST: bounds_constant_count\n");
+
+    DxsoProgram vs2 = Assembler(false, 2).finish();
+    DxsoProgram ps2 = Assembler(true, 2).finish();
+    DxsoProgram ps3 = Assembler(true, 3).finish();
+
+    TEST_ASSERT(DxsoGetFloatConstantCount(vs2) == 256, "vs_2_0");
+    TEST_ASSERT(DxsoGetFloatConstantCount(skinning_shader()) == 256, "vs_3_0");
+    TEST_ASSERT(DxsoGetFloatConstantCount(ps2) == 32, "ps_2_0");
+    TEST_ASSERT(DxsoGetFloatConstantCount(ps3) == 224, "ps_3_0");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Relative reads
+ * ============================================ */
+int test_bounds_relative_reads(void) {
+    printf("TEST: bounds_relative_reads\n");
+
+    DxsoProgram vs = skinning_shader();
+    TEST_ASSERT(vs.instructions.size() == 7, "Decode failed");
+
+    const auto& ins = vs.instructions;
+    TEST_ASSERT(DxsoGetRelativeConstantReads(ins[2], 0) == 0, "Input counted");
+    TEST_ASSERT(DxsoGetRelativeConstantReads(ins[2], 1) == 1, "Relative operand");
+    TEST_ASSERT(DxsoGetRelativeConstantReads(ins[3], 1) == 3, "m4x3 rows");
+    TEST_ASSERT(DxsoGetRelativeConstantReads(ins[4], 0) == 1
+             && DxsoGetRelativeConstantReads(ins[4], 1) == 1, "Both mad operands");
+    TEST_ASSERT(DxsoGetRelativeConstantReads(ins[5], 1) == 0, "Absolute constant counted");
+
+    // ps_3_0 inputs indexed by aL are not constant loads
+    Assembler ps(true, 3);
+    ps.op(DxsoOpcode::Add, { dst(R, 0), src(V, 0) | Relative, src(L, 0), src(C, 1) });
+    DxsoProgram p = ps.finish();
+    TEST_ASSERT(p.instructions.size() == 1, "ps decode failed");
+    TEST_ASSERT(DxsoGetRelativeConstantReads(p.instructions[0], 0) == 0, "Relative input counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Plan
+ * ============================================ */
+int test_bounds_plan(void) {
+    printf("TEST: bounds_plan\n");
+
+    DxsoProgram vs = skinning_shader();
+
+    DxsoBoundsCheckPlan manual(vs, false);
+    TEST_ASSERT(manual.GetCheckMask(2) == 0x2, "mul mask");
+    TEST_ASSERT(manual.GetCheckMask(3) == 0x2, "m4x3 mask");
+    TEST_ASSERT(manual.GetCheckMask(4) == 0x3, "mad mask");
+    TEST_ASSERT(manual.GetCheckMask(5) == 0x0, "Absolute load guarded");
+    TEST_ASSERT(manual.NeedsBoundsCheck(4, 1) && !manual.NeedsBoundsCheck(4, 2), "NeedsBoundsCheck");
+
+    DxsoBoundsCheckStats stats = manual.GetStats();
+    TEST_ASSERT(stats.instructions == 7, "Instruction count");
+    TEST_ASSERT(stats.relativeReads == 6 && stats.checks == 6, "Check counts");
+    TEST_ASSERT(stats.checkOps == 6 * DxsoBoundsCheckPlan::OpsPerCheck, "Check ops");
+
+    // robustBufferAccess2 returns zero itself
+    DxsoBoundsCheckPlan robust(vs, true);
+    for (uint32_t i = 0; i < vs.instructions.size(); i++)
+        TEST_ASSERT(robust.GetCheckMask(i) == 0, "Robust variant guarded");
+
+    stats = robust.GetStats();
+    TEST_ASSERT(stats.relativeReads == 6 && stats.checks == 0 && stats.checkOps == 0, "Robust stats");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Bounds Check Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 3;
+
+    if (test_bounds_constant_count()) passed++; else failed++;
+    if (test_bounds_relative_reads()) passed++; else failed++;
+    if (test_bounds_plan()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
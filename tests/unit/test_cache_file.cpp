@@ -0,0 +1,494 @@
+/*
+ * Cache File Test Suite
+ *
+ * These tests verify the memory-mapped shader/pipeline cache file
+ * (src/dxvk/dxvk_cache_file.h). CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_cache_roundtrip - Do written entries come back intact?
+ * 2. test_cache_missing - Are unknown keys and missing files handled?
+ * 3. test_cache_corrupt_entry - Is corruption isolated to one entry?
+ * 4. test_cache_replace_corrupt - Can a corrupted entry be replaced through the journal?
+ * 5. test_cache_forged_offset - Is an index entry pointing past the data rejected?
+ * 6. test_cache_bad_header - Is a damaged header rejected?
+ * 7. test_cache_journal - Are appended entries visible and persistent?
+ * 8. test_cache_torn_journal - Is a torn journal tail ignored?
+ * 9. test_cache_append_after_torn - Are records appended after a crash kept?
+ * 10. test_cache_compact - Does compaction merge the journal?
+ */
+
+#include "dxvk/dxvk_cache_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static std::string tempDir;
+
+static std::string temp_path(const char* name) {
+    std::string path = tempDir + "/" + name;
+    remove(path.c_str());
+    remove(DxvkCacheFile::journalPath(path).c_str());
+    return path;
+}
+
+static DxvkCacheFileKey make_key(uint32_t i) {
+    DxvkCacheFileKey key;
+    key.lo = 0x9e3779b97f4a7c15ull * (i + 1);
+    key.hi = 0xc2b2ae3d27d4eb4full * (i + 7);
+    return key;
+}
+
+static std::vector<char> make_blob(uint32_t i) {
+    std::vector<char> blob(64 + (i * 37) % 512);
+    for (size_t j = 0; j < blob.size(); j++)
+        blob[j] = char((i * 131 + j * 7) & 0xff);
+    return blob;
+}
+
+static bool write_cache(const std::string& path, uint32_t count) {
+    DxvkCacheFileWriter writer;
+    for (uint32_t i = 0; i < count; i++) {
+        std::vector<char> blob = make_blob(i);
+        writer.add(make_key(i), blob.data(), blob.size());
+    }
+    return writer.write(path);
+}
+
+static bool entry_matches(DxvkCacheFile& cache, uint32_t i) {
+    const void* data = nullptr;
+    size_t size = 0;
+    std::vector<char> expected = make_blob(i);
+
+    return cache.lookup(make_key(i), &data, &size) == DxvkCacheLookup::Found
+        && size == expected.size()
+        && !memcmp(data, expected.data(), size);
+}
+
+static long file_size(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void flip_byte(const std::string& path, long offset) {
+    FILE* f = fopen(path.c_str(), "r+b");
+    fseek(f, offset, SEEK_SET);
+    int value = fgetc(f) ^ 0xff;
+    fseek(f, offset, SEEK_SET);
+    fputc(value, f);
+    fclose(f);
+}
+
+/* ============================================
+ * Test: Round trip
+ * ============================================ */
+int test_cache_roundtrip(void) {
+    printf("TEST: cache_roundtrip\n");
+
+    std::string path = temp_path("roundtrip.bin");
+    TEST_ASSERT(write_cache(path, 1000), "Writer failed");
+
+    DxvkCacheFile cache(path);
+    TEST_ASSERT(cache.isMapped(), "Cache file not mapped");
+    TEST_ASSERT(cache.entryCount() == 1000, "Wrong entry count");
+
+    for (uint32_t i = 0; i < 1000; i++)
+        TEST_ASSERT(entry_matches(cache, i), "Entry data mismatch");
+
+    DxvkCacheFileStats stats = cache.getStats();
+    TEST_ASSERT(stats.hits == 1000 && stats.corrupt == 0, "Unexpected stats");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Missing keys and files
+ * ============================================ */
+int test_cache_missing(void) {
+    printf("TEST: cache_missing\n");
+
+    std::string path = temp_path("missing.bin");
+    TEST_ASSERT(write_cache(path, 100), "Writer failed");
+
+    DxvkCacheFile cache(path);
+    const void* data = nullptr;
+    size_t size = 0;
+
+    for (uint32_t i = 100; i < 200; i++)
+        TEST_ASSERT(cache.lookup(make_key(i), &data, &size) == DxvkCacheLookup::Missing, "Unknown key found");
+
+    // A cache that does not exist yet is empty, not an error
+    DxvkCacheFile none(temp_path("does-not-exist.bin"));
+    TEST_ASSERT(!none.isMapped(), "Missing file reported as mapped");
+    TEST_ASSERT(none.lookup(make_key(0), &data, &size) == DxvkCacheLookup::Missing, "Lookup in missing file");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Corrupted entry is isolated
+ * ============================================ */
+int test_cache_corrupt_entry(void) {
+    printf("TEST: cache_corrupt_entry\n");
+
+    std::string path = temp_path("corrupt.bin");
+    TEST_ASSERT(write_cache(path, 64), "Writer failed");
+
+    // Flip one byte inside the blob of the entry stored at index 10
+    DxvkCacheFileEntry victim;
+    { FILE* f = fopen(path.c_str(), "rb");
+      DxvkCacheFileHeader header;
+      TEST_ASSERT(fread(&header, sizeof(header), 1, f) == 1, "Header read failed");
+      fseek(f, long(header.indexOffset + 10 * sizeof(DxvkCacheFileEntry)), SEEK_SET);
+      TEST_ASSERT(fread(&victim, sizeof(victim), 1, f) == 1, "Index read failed");
+      fclose(f);
+      flip_byte(path, long(header.dataOffset + victim.offset + victim.size / 2)); }
+
+    DxvkCacheFile cache(path);
+    const void* data = nullptr;
+    size_t size = 0;
+
+    TEST_ASSERT(cache.lookup(victim.key, &data, &size) == DxvkCacheLookup::Corrupt, "Corruption not detected");
+    TEST_ASSERT(cache.lookup(victim.key, &data, &size) == DxvkCacheLookup::Corrupt, "Corruption state not sticky");
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < 64; i++)
+        found += entry_matches(cache, i) ? 1 : 0;
+
+    TEST_ASSERT(found == 63, "Corruption affected other entries");
+    TEST_ASSERT(cache.getStats().corrupt == 3, "Corrupt counter mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Corrupted entry replaced
+ * ============================================ */
+int test_cache_replace_corrupt(void) {
+    printf("TEST: cache_replace_corrupt\n");
+
+    std::string path = temp_path("replace.bin");
+    TEST_ASSERT(write_cache(path, 64), "Writer failed");
+
+    DxvkCacheFileEntry victim;
+    { FILE* f = fopen(path.c_str(), "rb");
+      DxvkCacheFileHeader header;
+      TEST_ASSERT(fread(&header, sizeof(header), 1, f) == 1, "Header read failed");
+      fseek(f, long(header.indexOffset + 10 * sizeof(DxvkCacheFileEntry)), SEEK_SET);
+      TEST_ASSERT(fread(&victim, sizeof(victim), 1, f) == 1, "Index read failed");
+      fclose(f);
+      flip_byte(path, long(header.dataOffset + victim.offset + victim.size / 2)); }
+
+    uint32_t index = 0;
+    while (index < 64 && !(make_key(index) == victim.key))
+        index++;
+    TEST_ASSERT(index < 64, "Victim key not found");
+
+    std::vector<char> blob = make_blob(index);
+
+    { DxvkCacheFile cache(path);
+      const void* data = nullptr;
+      size_t size = 0;
+
+      TEST_ASSERT(cache.lookup(victim.key, &data, &size) == DxvkCacheLookup::Corrupt, "Corruption not detected");
+
+      // The corrupted copy must not block the replacement
+      TEST_ASSERT(cache.append(victim.key, blob.data(), blob.size()), "Append failed");
+      TEST_ASSERT(cache.getStats().journalEntries == 1, "Replacement not journaled");
+      TEST_ASSERT(entry_matches(cache, index), "Replacement not served");
+
+      // Valid entries are still not journaled again
+      std::vector<char> other = make_blob(index ^ 1);
+      TEST_ASSERT(cache.append(make_key(index ^ 1), other.data(), other.size()), "Append failed");
+      TEST_ASSERT(cache.getStats().journalEntries == 1, "Valid entry journaled"); }
+
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(entry_matches(cache, index), "Replacement lost on reopen");
+      TEST_ASSERT(cache.getStats().corrupt == 0, "Replacement counted as corrupt"); }
+
+    TEST_ASSERT(DxvkCacheFile::compact(path), "Compaction failed");
+
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(cache.getStats().journalEntries == 0, "Journal not merged");
+
+      uint32_t found = 0;
+      for (uint32_t i = 0; i < 64; i++)
+          found += entry_matches(cache, i) ? 1 : 0;
+      TEST_ASSERT(found == 64, "Replacement not compacted"); }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Forged entry offset
+ * ============================================ */
+int test_cache_forged_offset(void) {
+    printf("TEST: cache_forged_offset\n");
+
+    std::string path = temp_path("forged.bin");
+    TEST_ASSERT(write_cache(path, 16), "Writer failed");
+
+    // An offset that wraps around to zero when the size is added,
+    // pointing 2 GB before the mapping, and two past the blob region
+    const uint64_t offsets[] = { 0ull - 0x80000000ull, ~0ull, 1ull << 40 };
+    const uint32_t sizes[] = { 0x80000000u, 1u, 1u };
+    DxvkCacheFileEntry victims[3];
+
+    { FILE* f = fopen(path.c_str(), "r+b");
+      DxvkCacheFileHeader header;
+      TEST_ASSERT(fread(&header, sizeof(header), 1, f) == 1, "Header read failed");
+
+      for (uint32_t i = 0; i < 3; i++) {
+          long offset = long(header.indexOffset + (4 + i) * sizeof(DxvkCacheFileEntry));
+          fseek(f, offset, SEEK_SET);
+          TEST_ASSERT(fread(&victims[i], sizeof(victims[i]), 1, f) == 1, "Index read failed");
+          victims[i].offset = offsets[i];
+          victims[i].size = sizes[i];
+          fseek(f, offset, SEEK_SET);
+          TEST_ASSERT(fwrite(&victims[i], sizeof(victims[i]), 1, f) == 1, "Index write failed");
+      }
+
+      fclose(f); }
+
+    DxvkCacheFile cache(path);
+    const void* data = nullptr;
+    size_t size = 0;
+
+    for (uint32_t i = 0; i < 3; i++)
+        TEST_ASSERT(cache.lookup(victims[i].key, &data, &size) == DxvkCacheLookup::Corrupt, "Forged offset accepted");
+
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < 16; i++)
+        found += entry_matches(cache, i) ? 1 : 0;
+
+    TEST_ASSERT(found == 13, "Forged entries affected other entries");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Damaged header is rejected
+ * ============================================ */
+int test_cache_bad_header(void) {
+    printf("TEST: cache_bad_header\n");
+
+    std::string path = temp_path("header.bin");
+    TEST_ASSERT(write_cache(path, 16), "Writer failed");
+
+    flip_byte(path, 0);
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(!cache.isMapped(), "Bad magic accepted"); }
+
+    // Truncating the blob region must invalidate the header
+    TEST_ASSERT(write_cache(path, 16), "Writer failed");
+    TEST_ASSERT(truncate(path.c_str(), file_size(path) - 1) == 0, "Truncate failed");
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(!cache.isMapped(), "Truncated file accepted"); }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Journal appends
+ * ============================================ */
+int test_cache_journal(void) {
+    printf("TEST: cache_journal\n");
+
+    std::string path = temp_path("journal.bin");
+    TEST_ASSERT(write_cache(path, 50), "Writer failed");
+
+    { DxvkCacheFile cache(path);
+      for (uint32_t i = 50; i < 80; i++) {
+          std::vector<char> blob = make_blob(i);
+          TEST_ASSERT(cache.append(make_key(i), blob.data(), blob.size()), "Append failed");
+      }
+      for (uint32_t i = 0; i < 80; i++)
+          TEST_ASSERT(entry_matches(cache, i), "Entry missing after append");
+
+      // Entries already in the mapped file are not duplicated
+      std::vector<char> blob = make_blob(3);
+      TEST_ASSERT(cache.append(make_key(3), blob.data(), blob.size()), "Duplicate append failed");
+      TEST_ASSERT(cache.getStats().journalEntries == 30, "Duplicate entry journaled"); }
+
+    // Reopen: journal must be replayed
+    DxvkCacheFile cache(path);
+    TEST_ASSERT(cache.entryCount() == 50, "Main file modified by append");
+    TEST_ASSERT(cache.getStats().journalEntries == 30, "Journal not replayed");
+    for (uint32_t i = 0; i < 80; i++)
+        TEST_ASSERT(entry_matches(cache, i), "Entry missing after reopen");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Torn journal tail
+ * ============================================ */
+int test_cache_torn_journal(void) {
+    printf("TEST: cache_torn_journal\n");
+
+    std::string path = temp_path("torn.bin");
+
+    { DxvkCacheFile cache(path);
+      for (uint32_t i = 0; i < 10; i++) {
+          std::vector<char> blob = make_blob(i);
+          TEST_ASSERT(cache.append(make_key(i), blob.data(), blob.size()), "Append failed");
+      } }
+
+    // Simulate a crash in the middle of writing the last record
+    std::string journal = DxvkCacheFile::journalPath(path);
+    TEST_ASSERT(truncate(journal.c_str(), file_size(journal) - 5) == 0, "Truncate failed");
+
+    DxvkCacheFile cache(path);
+    TEST_ASSERT(cache.getStats().journalEntries == 9, "Torn record not dropped");
+    for (uint32_t i = 0; i < 9; i++)
+        TEST_ASSERT(entry_matches(cache, i), "Intact record lost");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Appends after a torn tail
+ * ============================================ */
+int test_cache_append_after_torn(void) {
+    printf("TEST: cache_append_after_torn\n");
+
+    std::string path = temp_path("torn_append.bin");
+    std::string journal = DxvkCacheFile::journalPath(path);
+
+    { DxvkCacheFile cache(path);
+      for (uint32_t i = 0; i < 10; i++) {
+          std::vector<char> blob = make_blob(i);
+          TEST_ASSERT(cache.append(make_key(i), blob.data(), blob.size()), "Append failed");
+      } }
+
+    long intactSize = file_size(journal);
+    TEST_ASSERT(truncate(journal.c_str(), intactSize - 5) == 0, "Truncate failed");
+
+    // Opening drops the torn record, so new records follow the intact ones
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(file_size(journal) < intactSize - 5, "Torn tail not cut off");
+
+      for (uint32_t i = 9; i < 20; i++) {
+          std::vector<char> blob = make_blob(i);
+          TEST_ASSERT(cache.append(make_key(i), blob.data(), blob.size()), "Append failed");
+      } }
+
+    { DxvkCacheFile cache(path);
+      TEST_ASSERT(cache.getStats().journalEntries == 20, "Records after the torn tail lost");
+      for (uint32_t i = 0; i < 20; i++)
+          TEST_ASSERT(entry_matches(cache, i), "Entry missing after reopen"); }
+
+    TEST_ASSERT(DxvkCacheFile::compact(path), "Compaction failed");
+
+    DxvkCacheFile cache(path);
+    TEST_ASSERT(cache.entryCount() == 20, "Records after the torn tail not compacted");
+    for (uint32_t i = 0; i < 20; i++)
+        TEST_ASSERT(entry_matches(cache, i), "Entry lost in compaction");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Compaction
+ * ============================================ */
+int test_cache_compact(void) {
+    printf("TEST: cache_compact\n");
+
+    std::string path = temp_path("compact.bin");
+    TEST_ASSERT(write_cache(path, 200), "Writer failed");
+
+    { DxvkCacheFile cache(path);
+      for (uint32_t i = 200; i < 300; i++) {
+          std::vector<char> blob = make_blob(i);
+          TEST_ASSERT(cache.append(make_key(i), blob.data(), blob.size()), "Append failed");
+      } }
+
+    TEST_ASSERT(DxvkCacheFile::compact(path), "Compaction failed");
+    TEST_ASSERT(file_size(DxvkCacheFile::journalPath(path)) < 0, "Journal not removed");
+
+    DxvkCacheFile cache(path);
+    TEST_ASSERT(cache.entryCount() == 300, "Journal not merged");
+    TEST_ASSERT(cache.getStats().journalEntries == 0, "Stale journal entries");
+    for (uint32_t i = 0; i < 300; i++)
+        TEST_ASSERT(entry_matches(cache, i), "Entry lost in compaction");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Cache File Test Suite\n");
+    printf("========================================\n\n");
+
+    char dirTemplate[] = "/tmp/test_cache_file.XXXXXX";
+    if (!mkdtemp(dirTemplate)) {
+        fprintf(stderr, "Failed to create temp directory\n");
+        return 1;
+    }
+    tempDir = dirTemplate;
+
+    int passed = 0;
+    int failed = 0;
+    int total = 10;
+
+    if (test_cache_roundtrip()) passed++; else failed++;
+    if (test_cache_missing()) passed++; else failed++;
+    if (test_cache_corrupt_entry()) passed++; else failed++;
+    if (test_cache_replace_corrupt()) passed++; else failed++;
+    if (test_cache_forged_offset()) passed++; else failed++;
+    if (test_cache_bad_header()) passed++; else failed++;
+    if (test_cache_journal()) passed++; else failed++;
+    if (test_cache_torn_journal()) passed++; else failed++;
+    if (test_cache_append_after_torn()) passed++; else failed++;
+    if (test_cache_compact()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    std::string cleanup = "rm -rf " + tempDir;
+    if (system(cleanup.c_str()) != 0)
+        fprintf(stderr, "Failed to remove %s\n", tempDir.c_str());
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
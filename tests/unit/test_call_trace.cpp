@@ -0,0 +1,395 @@
+/*
+ * Call Trace Test Suite
+ *
+ * These tests verify the binary call trace used by the Vulkan timing
+ * layer (src/util/trace/trace_ring.h, trace_summary.h): per-thread
+ * rings that drop instead of blocking, the writer and its drain
+ * thread, and the summarizer's statistics and slow-call timeline.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_trace_ring_wrap - Do records survive wrapping, are overflows dropped?
+ * 2. test_trace_writer_threads - Does every record reach the file, are drops counted?
+ * 3. test_trace_writer_ring_reuse - Are rings of exited threads reused?
+ * 4. test_trace_summary_stats - Are count/avg/p99/max right per function?
+ * 5. test_trace_summary_slow_calls - Are slow calls listed in start order?
+ * 6. test_trace_summary_truncated - Is a file cut mid-record still read?
+ */
+
+#include "util/trace/trace_summary.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <thread>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static std::string temp_path(const char* name) {
+    return std::string("/tmp/") + name + "." + std::to_string(getpid()) + ".bin";
+}
+
+/* Builds a trace file image with the given records */
+static std::vector<uint8_t> make_trace(const std::vector<std::string>& names,
+        const std::vector<TraceRecord>& records, double ticksPerNs) {
+    std::string blob;
+    for (const auto& n : names) {
+        blob += n;
+        blob += '\0';
+    }
+
+    TraceFileHeader header = { };
+    memcpy(header.magic, TraceFileMagic, sizeof(header.magic));
+    header.version    = TraceFileVersion;
+    header.recordSize = sizeof(TraceRecord);
+    header.ticksPerNs = ticksPerNs;
+    header.nameCount  = uint32_t(names.size());
+    header.nameBytes  = uint32_t(blob.size());
+
+    std::vector<uint8_t> data(sizeof(header) + blob.size() + records.size() * sizeof(TraceRecord));
+    memcpy(&data[0], &header, sizeof(header));
+    memcpy(&data[sizeof(header)], blob.data(), blob.size());
+    if (!records.empty())
+        memcpy(&data[sizeof(header) + blob.size()], records.data(), records.size() * sizeof(TraceRecord));
+    return data;
+}
+
+/* ============================================
+ * Test 1: Ring wrap and overflow
+ * ============================================ */
+int test_trace_ring_wrap(void) {
+    printf("TEST: trace_ring_wrap\n");
+
+    TraceRing ring(3, 5);  // rounded up to 8
+    std::vector<TraceRecord> out;
+    auto collect = [&] (const TraceRecord* r, size_t n) { out.insert(out.end(), r, r + n); };
+
+    uint32_t next = 0;
+
+    // Push and drain in uneven batches so reads straddle the end
+    for (uint32_t round = 0; round < 10; round++) {
+        for (uint32_t i = 0; i < 3 + round % 4; i++, next++)
+            TEST_ASSERT(ring.push(next, 100 * next, 100 * next + next), "Push into free space failed");
+        ring.drain(collect);
+    }
+
+    TEST_ASSERT(out.size() == next, "Records lost");
+
+    for (uint32_t i = 0; i < next; i++) {
+        TEST_ASSERT(out[i].id == i && out[i].start == 100 * i, "Records out of order");
+        TEST_ASSERT(out[i].duration == i && out[i].thread == 3, "Record fields wrong");
+    }
+
+    // A full ring drops new records and counts them
+    for (uint32_t i = 0; i < 8; i++)
+        TEST_ASSERT(ring.push(i, 0, 1), "Push into free space failed");
+
+    TEST_ASSERT(!ring.push(8, 0, 1) && !ring.push(9, 0, 1), "Full ring accepted a record");
+    TEST_ASSERT(ring.dropped() == 2, "Drops not counted");
+
+    out.clear();
+    TEST_ASSERT(ring.drain(collect) == 8 && out.back().id == 7, "Kept records lost");
+    TEST_ASSERT(ring.push(10, 0, 1), "Drained ring still full");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test 2: Writer with several threads
+ * ============================================ */
+int test_trace_writer_threads(void) {
+    printf("TEST: trace_writer_threads\n");
+
+    const uint32_t threadCount = 4;
+    const uint32_t callCount   = 20000;
+
+    std::string path = temp_path("test_call_trace");
+    TraceWriterStats stats;
+
+    { TraceWriterOptions options;
+      options.ringCapacity    = 1u << 16;
+      options.drainIntervalMs = 1;
+
+      TraceWriter writer(path, { "vkQueueSubmit", "vkCmdDraw", "vkCmdBindPipeline", "vkCmdDrawIndexed" }, options);
+      TEST_ASSERT(writer.isOpen(), "Trace file not opened");
+
+      std::vector<std::thread> threads;
+
+      for (uint32_t t = 0; t < threadCount; t++) {
+          threads.emplace_back([&writer, t, callCount] {
+              for (uint32_t i = 0; i < callCount; i++) {
+                  uint64_t start = TraceClock::now();
+                  writer.record(t, start, start + i);
+              }
+          });
+      }
+
+      for (auto& t : threads)
+          t.join();
+
+      stats = writer.getStats(); }
+
+    TEST_ASSERT(stats.threads == threadCount && stats.dropped == 0, "Unexpected rings or drops");
+
+    TraceSummary summary;
+    TEST_ASSERT(summary.loadFile(path), "Trace file not readable");
+    remove(path.c_str());
+
+    TEST_ASSERT(summary.records().size() == threadCount * callCount, "Records missing from file");
+    TEST_ASSERT(summary.dropped() == 0, "Drop count wrong");
+    TEST_ASSERT(summary.threadCount() == threadCount, "Thread count wrong");
+
+    // Each function was called from exactly one thread
+    auto functions = summary.functions();
+    TEST_ASSERT(functions.size() == threadCount, "Function count wrong");
+
+    for (const auto& f : functions) {
+        TEST_ASSERT(f.count == callCount, "Calls missing for a function");
+        TEST_ASSERT(f.name == summary.name(f.id), "Name table mismatch");
+    }
+
+    for (size_t i = 1; i < summary.records().size(); i++)
+        TEST_ASSERT(summary.records()[i - 1].start <= summary.records()[i].start, "Records not sorted");
+
+    // A ring that overflows before the drain thread wakes up
+    { TraceWriterOptions options;
+      options.ringCapacity    = 16;
+      options.drainIntervalMs = 10000;
+
+      TraceWriter writer(path, { "vkCmdDraw" }, options);
+
+      for (uint32_t i = 0; i < 100; i++)
+          writer.record(0, i, i + 1);
+
+      writer.close();
+      stats = writer.getStats();
+      TEST_ASSERT(stats.records == 16 && !writer.isOpen(), "Close did not drain"); }
+
+    TEST_ASSERT(summary.loadFile(path), "Trace file not readable");
+    remove(path.c_str());
+
+    TEST_ASSERT(stats.dropped == 84, "Overflow not counted");
+    TEST_ASSERT(summary.records().size() == 16 && summary.dropped() == 84, "Drop count not in file");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test 3: Rings of exited threads
+ * ============================================ */
+int test_trace_writer_ring_reuse(void) {
+    printf("TEST: trace_writer_ring_reuse\n");
+
+    const uint32_t threadCount = 8;
+    const uint32_t callCount   = 100;
+
+    std::string path = temp_path("test_call_trace_reuse");
+    TraceWriterStats stats;
+
+    { TraceWriterOptions options;
+      options.ringCapacity    = 1u << 10;
+      options.drainIntervalMs = 10000;
+
+      TraceWriter writer(path, { "vkQueueSubmit" }, options);
+      TEST_ASSERT(writer.isOpen(), "Trace file not opened");
+
+      // One thread after another, none recording at the same time
+      for (uint32_t t = 0; t < threadCount; t++) {
+          std::thread thread([&writer, t, callCount] {
+              for (uint32_t i = 0; i < callCount; i++)
+                  writer.record(0, t * callCount + i, t * callCount + i + 1);
+          });
+
+          thread.join();
+      }
+
+      // Two at once need two rings
+      std::atomic<uint32_t> ready = { 0 };
+      std::vector<std::thread> threads;
+
+      for (uint32_t t = 0; t < 2; t++) {
+          threads.emplace_back([&writer, &ready, threadCount, callCount] {
+              writer.record(0, threadCount * callCount, threadCount * callCount + 1);
+              ready += 1;
+
+              while (ready < 2)
+                  std::this_thread::yield();
+          });
+      }
+
+      for (auto& t : threads)
+          t.join();
+
+      stats = writer.getStats(); }
+
+    TEST_ASSERT(stats.threads == threadCount + 2, "Thread count wrong");
+    TEST_ASSERT(stats.rings == 2, "Rings of exited threads not reused");
+    TEST_ASSERT(stats.dropped == 0, "Records dropped");
+
+    TraceSummary summary;
+    TEST_ASSERT(summary.loadFile(path), "Trace file not readable");
+    remove(path.c_str());
+
+    // Records written before a ring changed hands keep their thread
+    TEST_ASSERT(summary.records().size() == threadCount * callCount + 2, "Records missing from file");
+    TEST_ASSERT(summary.threadCount() == threadCount + 2, "Threads merged in the file");
+
+    for (const auto& rec : summary.records()) {
+        uint32_t thread = std::min(uint32_t(rec.start / callCount), threadCount);
+        TEST_ASSERT(rec.thread == thread || (thread == threadCount && rec.thread > thread), "Record has wrong thread");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test 4: Per-function statistics
+ * ============================================ */
+int test_trace_summary_stats(void) {
+    printf("TEST: trace_summary_stats\n");
+
+    // Two ticks per ns. Draw takes 1..200 ns, submit always 5 us.
+    std::vector<TraceRecord> records;
+    for (uint32_t i = 1; i <= 200; i++)
+        records.push_back({ 1000 + 10 * i, 2 * i, 1, 0 });
+    for (uint32_t i = 0; i < 3; i++)
+        records.push_back({ 5000 * i, 10000, 0, 1 });
+
+    TraceSummary summary;
+    TEST_ASSERT(summary.load(make_trace({ "vkQueueSubmit", "vkCmdDraw", "vkCmdDispatch" }, records, 2.0)), "Trace rejected");
+
+    auto functions = summary.functions();
+    TEST_ASSERT(functions.size() == 2, "Uncalled function listed");
+
+    // Submit: 15 us total, draw: 20.1 us total
+    const TraceCallStats& draw   = functions[0];
+    const TraceCallStats& submit = functions[1];
+
+    TEST_ASSERT(draw.name == "vkCmdDraw" && submit.name == "vkQueueSubmit", "Not sorted by total time");
+    TEST_ASSERT(draw.count == 200 && submit.count == 3, "Counts wrong");
+    TEST_ASSERT(draw.totalNs == 20100.0 && draw.avgNs == 100.5, "Draw total/avg wrong");
+    TEST_ASSERT(draw.p99Ns == 198.0 && draw.maxNs == 200.0, "Draw p99/max wrong");
+    TEST_ASSERT(submit.avgNs == 5000.0 && submit.p99Ns == 5000.0 && submit.maxNs == 5000.0, "Submit stats wrong");
+
+    TEST_ASSERT(summary.threadCount() == 2, "Thread count wrong");
+    TEST_ASSERT(summary.spanMs() == 0.01, "Span wrong");
+    TEST_ASSERT(summary.name(7) == "<unknown>", "Out-of-range id not handled");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test 5: Slow-call timeline
+ * ============================================ */
+int test_trace_summary_slow_calls(void) {
+    printf("TEST: trace_summary_slow_calls\n");
+
+    // Written out of order, as the drain thread interleaves rings
+    std::vector<TraceRecord> records = {
+        { 3000000, 4000000, 1, 1 },   // 3 ms in, 4 ms long
+        { 1000000,     500, 0, 0 },
+        { 1000000, 2000000, 0, 0 },   // first, 2 ms long
+        { 2000000,  999999, 1, 1 },   // just under 1 ms
+    };
+
+    TraceSummary summary;
+    TEST_ASSERT(summary.load(make_trace({ "vkWaitForFences", "vkQueuePresentKHR" }, records, 1.0)), "Trace rejected");
+
+    auto slow = summary.slowCalls(1e6);
+    TEST_ASSERT(slow.size() == 2, "Wrong number of slow calls");
+    TEST_ASSERT(slow[0].name == "vkWaitForFences" && slow[0].timeMs == 0.0 && slow[0].durationNs == 2e6, "First slow call wrong");
+    TEST_ASSERT(slow[1].name == "vkQueuePresentKHR" && slow[1].timeMs == 2.0 && slow[1].thread == 1, "Second slow call wrong");
+
+    TEST_ASSERT(summary.slowCalls(1e9).empty(), "Threshold ignored");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test 6: Truncated and invalid files
+ * ============================================ */
+int test_trace_summary_truncated(void) {
+    printf("TEST: trace_summary_truncated\n");
+
+    std::vector<TraceRecord> records;
+    for (uint32_t i = 0; i < 10; i++)
+        records.push_back({ i, 1, 0, 0 });
+
+    std::vector<uint8_t> data = make_trace({ "vkCmdDraw" }, records, 1.0);
+
+    // Cut in the middle of the last record, as a crash would
+    data.resize(data.size() - sizeof(TraceRecord) / 2);
+
+    TraceSummary summary;
+    TEST_ASSERT(summary.load(data), "Truncated trace rejected");
+    TEST_ASSERT(summary.records().size() == 9, "Partial record not dropped");
+
+    // No records at all is a valid, empty trace
+    TEST_ASSERT(summary.load(make_trace({ "vkCmdDraw" }, { }, 1.0)), "Empty trace rejected");
+    TEST_ASSERT(summary.functions().empty() && summary.spanMs() == 0.0, "Empty trace not empty");
+
+    // Headers that cannot be trusted
+    std::vector<uint8_t> bad = make_trace({ "vkCmdDraw" }, records, 1.0);
+    bad[0] = 'X';
+    TEST_ASSERT(!summary.load(bad), "Bad magic accepted");
+
+    bad = make_trace({ "vkCmdDraw" }, records, 1.0);
+    bad.resize(sizeof(TraceFileHeader) + 4);
+    TEST_ASSERT(!summary.load(bad), "Cut name table accepted");
+
+    bad = make_trace({ "vkCmdDraw" }, records, 0.0);
+    TEST_ASSERT(!summary.load(bad), "Zero clock rate accepted");
+
+    TEST_ASSERT(!summary.loadFile("/nonexistent/trace.bin"), "Missing file accepted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Call Trace Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_trace_ring_wrap()) passed++; else failed++;
+    if (test_trace_writer_threads()) passed++; else failed++;
+    if (test_trace_writer_ring_reuse()) passed++; else failed++;
+    if (test_trace_summary_stats()) passed++; else failed++;
+    if (test_trace_summary_slow_calls()) passed++; else failed++;
+    if (test_trace_summary_truncated()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
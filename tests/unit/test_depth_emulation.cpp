@@ -0,0 +1,245 @@
+/*
+ * Depth Format Emulation Test Suite
+ *
+ * These tests verify D24S8 emulation on devices without
+ * D24_UNORM_S8_UINT (src/d3d9/d3d9_depth_emulation.h): the packing
+ * matches an integer reference conversion, and packed copies are
+ * converted once per image version.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_depth_format_info - Which formats are emulated?
+ * 2. test_depth_pack_reference - Does packing round like a unorm conversion?
+ * 3. test_depth_roundtrip - Does every 24-bit value survive a round trip?
+ * 4. test_depth_conversion_cache - One conversion per image version?
+ */
+
+#include "d3d9/d3d9_depth_emulation.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* Reference: round(d * (2^24 - 1)) with exact rational arithmetic.
+ * A float in [0, 1] is m * 2^e with a 24-bit mantissa, so the
+ * product fits in 128 bits. */
+static uint32_t reference_unorm24(float depth) {
+    if (!(depth > 0.0f))
+        return 0;
+    if (depth >= 1.0f)
+        return 0xffffff;
+
+    int exp;
+    float mant = frexpf(depth, &exp);                // depth = mant * 2^exp, mant in [0.5, 1)
+    uint64_t m = uint64_t(ldexpf(mant, 24));         // 24-bit integer mantissa
+    int shift = 24 - exp;                            // depth = m / 2^shift
+
+    if (shift > 64)
+        return 0;
+
+    unsigned __int128 num = (unsigned __int128)m * 16777215u;
+    unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+    return uint32_t((num + half) >> shift);
+}
+
+/* ============================================
+ * Test: Format mapping
+ * ============================================ */
+int test_depth_format_info(void) {
+    printf("TEST: depth_format_info\n");
+
+    D3D9DepthFormatSupport apple;
+    D3D9DepthFormatSupport desktop = { true };
+
+    const D3D9DepthFormat d24[] = { D3D9DepthFormat::D24S8, D3D9DepthFormat::D24X8,
+                                    D3D9DepthFormat::Intz, D3D9DepthFormat::Df24 };
+
+    for (D3D9DepthFormat f : d24) {
+        D3D9DepthFormatInfo a = D3D9GetDepthFormatInfo(f, apple);
+        D3D9DepthFormatInfo d = D3D9GetDepthFormatInfo(f, desktop);
+
+        TEST_ASSERT(a.emulated && a.format == D3D9DepthVkFormat::D32_SFLOAT_S8_UINT, "D24 not emulated on Apple");
+        TEST_ASSERT(!d.emulated && d.format == D3D9DepthVkFormat::D24_UNORM_S8_UINT, "D24 emulated with native support");
+    }
+
+    D3D9DepthFormatInfo d16 = D3D9GetDepthFormatInfo(D3D9DepthFormat::D16, apple);
+    TEST_ASSERT(!d16.emulated && d16.format == D3D9DepthVkFormat::D16_UNORM, "D16 emulated");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Packing against the reference
+ * ============================================ */
+int test_depth_pack_reference(void) {
+    printf("TEST: depth_pack_reference\n");
+
+    // Edge cases
+    TEST_ASSERT(D3D9PackD24S8(0.0f, 0) == 0, "Zero");
+    TEST_ASSERT(D3D9PackD24S8(1.0f, 0xff) == 0xffffffff, "One");
+    TEST_ASSERT(D3D9PackD24S8(-0.5f, 3) == 3, "Negative not clamped");
+    TEST_ASSERT(D3D9PackD24S8(2.0f, 0) == 0xffffff00, "Above one not clamped");
+    TEST_ASSERT(D3D9PackD24S8(std::numeric_limits<float>::quiet_NaN(), 7) == 7, "NaN not zero");
+    TEST_ASSERT(D3D9PackD24S8(std::numeric_limits<float>::infinity(), 0) == 0xffffff00, "Infinity");
+    TEST_ASSERT(D3D9PackD24S8(std::numeric_limits<float>::denorm_min(), 0) == 0, "Denormal");
+
+    // Values right around rounding boundaries
+    for (uint32_t u = 0; u < 0xffffff; u += 4099) {
+        double boundary = (double(u) + 0.5) / 16777215.0;
+        float below = std::nextafter(float(boundary), 0.0f);
+        float above = std::nextafter(float(boundary), 1.0f);
+
+        TEST_ASSERT((D3D9PackD24S8(below, 0) >> 8) == reference_unorm24(below), "Rounding below boundary");
+        TEST_ASSERT((D3D9PackD24S8(above, 0) >> 8) == reference_unorm24(above), "Rounding above boundary");
+    }
+
+    // Random depth and stencil through the bulk conversion
+    std::mt19937 rng(66);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+    const uint32_t count = 1 << 16;
+    std::vector<float> depth(count);
+    std::vector<uint8_t> stencil(count);
+    std::vector<uint32_t> packed(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        depth[i] = dist(rng);
+        stencil[i] = uint8_t(rng());
+    }
+
+    D3D9ConvertD32S8ToD24S8(packed.data(), depth.data(), stencil.data(), count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT((packed[i] >> 8) == reference_unorm24(depth[i]), "Depth differs from reference");
+        TEST_ASSERT((packed[i] & 0xff) == stencil[i], "Stencil lost");
+    }
+
+    // D24X8 has no stencil
+    D3D9ConvertD32S8ToD24S8(packed.data(), depth.data(), nullptr, 16);
+    TEST_ASSERT((packed[5] & 0xff) == 0, "X8 bits not zero");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Round trip of all 24-bit values
+ * ============================================ */
+int test_depth_roundtrip(void) {
+    printf("TEST: depth_roundtrip\n");
+
+    for (uint32_t u = 0; u <= 0xffffff; u++) {
+        float d = D3D9UnpackD24S8Depth(u << 8);
+
+        if (D3D9PackD24S8(d, 0) != (u << 8)) {
+            fprintf(stderr, "  value 0x%06x unpacked to %.9g\n", u, double(d));
+            TEST_ASSERT(false, "D24 value did not survive D32F storage");
+        }
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Conversion per image version
+ * ============================================ */
+int test_depth_conversion_cache(void) {
+    printf("TEST: depth_conversion_cache\n");
+
+    std::vector<D3D9DepthConversion> passes;
+    D3D9DepthEmulator emulator(D3D9DepthFormatSupport(),
+        [&] (const D3D9DepthConversion& c) { passes.push_back(c); });
+
+    // Main depth buffer, an INTZ shadow map and a D16 buffer
+    TEST_ASSERT(emulator.RegisterImage(1, D3D9DepthFormat::D24S8, 1920, 1080).emulated, "D24S8 not emulated");
+    TEST_ASSERT(emulator.RegisterImage(2, D3D9DepthFormat::Intz, 2048, 2048).emulated, "INTZ not emulated");
+    TEST_ASSERT(!emulator.RegisterImage(3, D3D9DepthFormat::D16, 256, 256).emulated, "D16 emulated");
+
+    // First readback converts, the second reuses the copy
+    D3D9DepthPackedView v = emulator.GetPacked(1);
+    TEST_ASSERT(v.emulated && v.converted, "First request not converted");
+    TEST_ASSERT(passes.size() == 1 && passes[0].image == 1 && passes[0].width == 1920, "Conversion request");
+
+    v = emulator.GetPacked(1);
+    TEST_ASSERT(v.emulated && !v.converted && passes.size() == 1, "Unchanged image converted again");
+
+    // The frame writes depth; one conversion however often it is read
+    emulator.MarkWritten(1);
+    for (uint32_t i = 0; i < 5; i++)
+        emulator.GetPacked(1);
+    TEST_ASSERT(passes.size() == 2 && passes[1].version == v.version + 1, "Written image not converted once");
+
+    // Shadow map sampled exactly every frame, only rendered every other
+    for (uint32_t frame = 0; frame < 4; frame++) {
+        if (frame % 2 == 0)
+            emulator.MarkWritten(2);
+        emulator.GetPacked(2);
+    }
+    TEST_ASSERT(passes.size() == 4, "Shadow map conversions");
+
+    // Native formats never convert
+    v = emulator.GetPacked(3);
+    TEST_ASSERT(!v.emulated && !v.converted && passes.size() == 4, "Native format converted");
+    emulator.MarkWritten(3);
+
+    TEST_ASSERT(emulator.EndFrame() == 4, "Frame conversion count");
+    TEST_ASSERT(emulator.EndFrame() == 0, "Frame counter not reset");
+
+    D3D9DepthEmulationStats stats = emulator.GetStats();
+    TEST_ASSERT(stats.conversions == 4 && stats.reuses == 7, "Stats mismatch");
+    TEST_ASSERT(stats.emulatedImages == 2, "Emulated image count");
+
+    emulator.UnregisterImage(1);
+    TEST_ASSERT(!emulator.IsEmulated(1) && emulator.IsEmulated(2), "Image not unregistered");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Depth Format Emulation Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 4;
+
+    if (test_depth_format_info()) passed++; else failed++;
+    if (test_depth_pack_reference()) passed++; else failed++;
+    if (test_depth_roundtrip()) passed++; else failed++;
+    if (test_depth_conversion_cache()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,299 @@
+/*
+ * Discard Ring Test Suite
+ *
+ * These tests verify the rename-on-discard slice ring
+ * (src/d3d9/d3d9_discard_ring.h) with a synthetic lock pattern
+ * generator: every frame issues a number of D3DLOCK_DISCARD locks,
+ * each followed by D3DLOCK_NOOVERWRITE appends and draws, and the
+ * simulated GPU completes a frame's commands a few frames later.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_discard_nooverwrite - Does NOOVERWRITE stay on the same slice?
+ * 2. test_discard_never_in_use - Is a slice only reused after its fence?
+ * 3. test_discard_steady_state - Does allocation stop once warmed up?
+ * 4. test_discard_adaptive - Does the ring grow with bursts and shrink after?
+ * 5. test_discard_max_slices - Does the cap turn growth into stalls?
+ */
+
+#include "d3d9/d3d9_discard_ring.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* Simulated device: one command list per frame, submitted at
+ * present and completed 'latency' frames later */
+struct FakeDevice {
+    uint32_t latency = 2;
+    uint64_t recording = 1;
+    uint64_t completed = 0;
+    uint32_t waits = 0;
+    uint32_t liveChunks = 0;
+    uint64_t nextHandle = 0;
+
+    std::map<uint64_t, std::vector<uint8_t>> chunks;
+
+    /* Last command list that read each slice, keyed by mapped address */
+    std::map<void*, uint64_t> sliceReadBy;
+    bool overwroteInFlight = false;
+
+    std::unique_ptr<D3D9DiscardRing> makeRing(D3D9DiscardRingOptions options, uint64_t sliceSize) {
+        return std::make_unique<D3D9DiscardRing>(options, sliceSize,
+            [this] (uint64_t size) {
+                D3D9DiscardChunk c;
+                c.handle = ++nextHandle;
+                chunks[c.handle].resize(size);
+                c.mapPtr = chunks[c.handle].data();
+                liveChunks++;
+                return c;
+            },
+            [this] (const D3D9DiscardChunk& c) {
+                chunks.erase(c.handle);
+                liveChunks--;
+            },
+            [this] (uint64_t seq) { return seq <= completed; },
+            [this] (uint64_t seq) {
+                waits++;
+                if (seq >= recording)
+                    present();
+                completed = std::max(completed, seq);
+            });
+    }
+
+    /* CPU writes to a slice: must not be read by a pending list */
+    void write(const D3D9DiscardSlice& slice) {
+        auto entry = sliceReadBy.find(slice.mapPtr);
+        if (entry != sliceReadBy.end() && entry->second > completed)
+            overwroteInFlight = true;
+    }
+
+    void draw(const D3D9DiscardSlice& slice) {
+        sliceReadBy[slice.mapPtr] = recording;
+    }
+
+    void present() {
+        recording++;
+        if (recording > latency + 1)
+            completed = std::max(completed, recording - latency - 1);
+    }
+};
+
+/* Synthetic lock pattern: 'discards' DISCARD locks per frame, each
+ * followed by 'appends' NOOVERWRITE locks, with a draw after every lock */
+static void run_frame(FakeDevice& dev, D3D9DiscardRing& ring, uint32_t discards, uint32_t appends) {
+    for (uint32_t d = 0; d < discards; d++) {
+        D3D9DiscardSlice slice = ring.Lock(D3D9DiscardLockMode::Discard, dev.recording);
+        dev.write(slice);
+        dev.draw(slice);
+
+        for (uint32_t a = 0; a < appends; a++) {
+            D3D9DiscardSlice append = ring.Lock(D3D9DiscardLockMode::NoOverwrite, dev.recording);
+            dev.draw(append);
+        }
+    }
+
+    ring.EndFrame();
+    dev.present();
+}
+
+/* ============================================
+ * Test: NOOVERWRITE keeps the slice
+ * ============================================ */
+int test_discard_nooverwrite(void) {
+    printf("TEST: discard_nooverwrite\n");
+
+    FakeDevice dev;
+    auto ring = dev.makeRing(D3D9DiscardRingOptions(), 4096);
+
+    D3D9DiscardSlice first = ring->Lock(D3D9DiscardLockMode::Discard, dev.recording);
+    dev.draw(first);
+
+    for (uint32_t i = 0; i < 100; i++) {
+        D3D9DiscardSlice slice = ring->Lock(D3D9DiscardLockMode::NoOverwrite, dev.recording);
+        TEST_ASSERT(slice.mapPtr == first.mapPtr, "NOOVERWRITE renamed the buffer");
+        TEST_ASSERT(slice.fence == 0, "NOOVERWRITE returned a fence");
+    }
+
+    D3D9DiscardSlice plain = ring->Lock(D3D9DiscardLockMode::Default, dev.recording);
+    TEST_ASSERT(plain.mapPtr == first.mapPtr, "Plain lock renamed the buffer");
+    TEST_ASSERT(plain.fence == dev.recording, "Plain lock did not return a fence");
+
+    D3D9DiscardSlice next = ring->Lock(D3D9DiscardLockMode::Discard, dev.recording);
+    TEST_ASSERT(next.mapPtr != first.mapPtr, "DISCARD did not rename the buffer");
+
+    D3D9DiscardRingStats stats = ring->GetStats();
+    TEST_ASSERT(stats.noOverwrites == 100 && stats.discards == 2, "Lock counters mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Slices in use are never handed out
+ * ============================================ */
+int test_discard_never_in_use(void) {
+    printf("TEST: discard_never_in_use\n");
+
+    std::mt19937 rng(7);
+
+    for (uint32_t latency = 0; latency < 4; latency++) {
+        FakeDevice dev;
+        dev.latency = latency;
+
+        D3D9DiscardRingOptions options;
+        options.maxSlices = 16;
+        auto ring = dev.makeRing(options, 256);
+
+        for (uint32_t f = 0; f < 500; f++)
+            run_frame(dev, *ring, rng() % 12, rng() % 4);
+
+        TEST_ASSERT(!dev.overwroteInFlight, "Slice reused while the GPU was reading it");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: No allocations in steady state
+ * ============================================ */
+int test_discard_steady_state(void) {
+    printf("TEST: discard_steady_state\n");
+
+    FakeDevice dev;
+    dev.latency = 2;
+    auto ring = dev.makeRing(D3D9DiscardRingOptions(), 64 << 10);
+
+    for (uint32_t f = 0; f < 10; f++)
+        run_frame(dev, *ring, 8, 3);
+
+    D3D9DiscardRingStats warm = ring->GetStats();
+
+    for (uint32_t f = 0; f < 1000; f++)
+        run_frame(dev, *ring, 8, 3);
+
+    D3D9DiscardRingStats stats = ring->GetStats();
+    TEST_ASSERT(stats.allocations == warm.allocations, "Allocated in steady state");
+    TEST_ASSERT(stats.stalls == 0, "Stalled in steady state");
+    TEST_ASSERT(stats.slices >= 8 * 3, "Ring smaller than discards times latency");
+    TEST_ASSERT(stats.slices <= 8 * 3 * 2, "Ring grew past twice the demand");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Growth and shrinking
+ * ============================================ */
+int test_discard_adaptive(void) {
+    printf("TEST: discard_adaptive\n");
+
+    FakeDevice dev;
+    dev.latency = 1;
+
+    D3D9DiscardRingOptions options;
+    options.shrinkFrames = 50;
+    auto ring = dev.makeRing(options, 1024);
+
+    for (uint32_t f = 0; f < 20; f++)
+        run_frame(dev, *ring, 2, 0);
+
+    uint32_t calm = ring->GetStats().slices;
+
+    // Burst, e.g. a UI-heavy scene
+    for (uint32_t f = 0; f < 20; f++)
+        run_frame(dev, *ring, 20, 0);
+
+    uint32_t burst = ring->GetStats().slices;
+    TEST_ASSERT(burst > calm, "Ring did not grow with the burst");
+
+    for (uint32_t f = 0; f < 400; f++)
+        run_frame(dev, *ring, 2, 0);
+
+    D3D9DiscardRingStats stats = ring->GetStats();
+    TEST_ASSERT(stats.slices < burst, "Ring did not shrink after the burst");
+    TEST_ASSERT(stats.frees > 0, "No chunk released");
+    TEST_ASSERT(dev.liveChunks == stats.allocations - stats.frees, "Chunk accounting mismatch");
+    TEST_ASSERT(!dev.overwroteInFlight, "Slice reused while the GPU was reading it");
+
+    ring.reset();
+    TEST_ASSERT(dev.liveChunks == 0, "Chunks leaked on destruction");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Slice cap
+ * ============================================ */
+int test_discard_max_slices(void) {
+    printf("TEST: discard_max_slices\n");
+
+    FakeDevice dev;
+    dev.latency = 3;
+
+    D3D9DiscardRingOptions options;
+    options.initialSlices = 2;
+    options.maxSlices = 8;
+    auto ring = dev.makeRing(options, 512);
+
+    for (uint32_t f = 0; f < 20; f++)
+        run_frame(dev, *ring, 6, 1);
+
+    D3D9DiscardRingStats stats = ring->GetStats();
+    TEST_ASSERT(stats.slices == 8, "Ring exceeded or missed the cap");
+    TEST_ASSERT(stats.stalls > 0, "Capped ring did not stall");
+    TEST_ASSERT(dev.waits == stats.stalls, "Stall count does not match waits");
+    TEST_ASSERT(!dev.overwroteInFlight, "Slice reused while the GPU was reading it");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Discard Ring Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_discard_nooverwrite()) passed++; else failed++;
+    if (test_discard_never_in_use()) passed++; else failed++;
+    if (test_discard_steady_state()) passed++; else failed++;
+    if (test_discard_adaptive()) passed++; else failed++;
+    if (test_discard_max_slices()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,280 @@
+/*
+ * Triangle Fan Conversion Test Suite
+ *
+ * These tests verify the fan to list conversion
+ * (src/d3d9/d3d9_fan_convert.h): converted draws produce exactly
+ * the triangles of the fan, with the same winding and flat shading
+ * vertex, and conversions of indexed fans are cached by buffer,
+ * version and range.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_fan_pattern_simd - Does the SIMD pattern match the scalar one?
+ * 2. test_fan_non_indexed - Same triangles, winding and provoking vertex?
+ * 3. test_fan_indexed - Same for indexed fans and UP draws?
+ * 4. test_fan_cache - Hits, version bumps, eviction and invalidation?
+ */
+
+#include "d3d9/d3d9_fan_convert.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+struct Tri {
+    uint32_t v[3];
+};
+
+/* What D3D9 draws for a fan over the given vertex indices */
+static std::vector<Tri> reference_fan(const std::vector<uint32_t>& fan) {
+    std::vector<Tri> tris;
+    for (size_t i = 0; i + 2 < fan.size(); i++)
+        tris.push_back({ { fan[0], fan[i + 1], fan[i + 2] } });
+    return tris;
+}
+
+/* Resolves a converted draw to vertex indices */
+static std::vector<Tri> resolve(const D3D9FanDraw& draw, uint32_t vertexOffset) {
+    std::vector<Tri> tris;
+    for (uint32_t i = 0; i < draw.indexCount; i += 3) {
+        Tri t;
+        for (uint32_t j = 0; j < 3; j++) {
+            uint32_t index = draw.indexType == D3D9IndexType::Uint16
+                ? static_cast<const uint16_t*>(draw.indices)[i + j]
+                : static_cast<const uint32_t*>(draw.indices)[i + j];
+            t.v[j] = index + vertexOffset;
+        }
+        tris.push_back(t);
+    }
+    return tris;
+}
+
+/* Same triangles in the same order, each a rotation of the reference
+ * (same winding) whose first vertex is the flat shading vertex, the
+ * second vertex of the fan triangle */
+static bool equivalent(const std::vector<Tri>& ref, const std::vector<Tri>& out) {
+    if (ref.size() != out.size())
+        return false;
+
+    for (size_t i = 0; i < ref.size(); i++) {
+        const Tri& r = ref[i];
+        const Tri& o = out[i];
+
+        if (o.v[0] != r.v[1] || o.v[1] != r.v[2] || o.v[2] != r.v[0])
+            return false;
+    }
+
+    return true;
+}
+
+/* ============================================
+ * Test: SIMD pattern
+ * ============================================ */
+int test_fan_pattern_simd(void) {
+    printf("TEST: fan_pattern_simd\n");
+
+    const uint32_t counts[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 100, 1023, 65534 };
+
+    for (uint32_t count : counts) {
+        std::vector<uint16_t> a16(count * 3 + 1, 0xdead), b16(count * 3 + 1, 0xdead);
+        std::vector<uint32_t> a32(count * 3 + 1, 0xdead), b32(count * 3 + 1, 0xdead);
+
+        fan_scalar::Generate(a16.data(), 0, count);
+        fan_simd::Generate(b16.data(), count);
+        fan_scalar::Generate(a32.data(), 0, count);
+        fan_simd::Generate(b32.data(), count);
+
+        TEST_ASSERT(a16 == b16, "16-bit SIMD pattern mismatch");
+        TEST_ASSERT(a32 == b32, "32-bit SIMD pattern mismatch");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Non-indexed fans
+ * ============================================ */
+int test_fan_non_indexed(void) {
+    printf("TEST: fan_non_indexed\n");
+
+    D3D9FanConverter converter;
+
+    // DrawPrimitive(D3DPT_TRIANGLEFAN, startVertex, primCount)
+    const uint32_t draws[][2] = { { 0, 1 }, { 4, 2 }, { 100, 30 }, { 7, 2000 }, { 0, 65534 }, { 3, 70000 } };
+
+    for (const auto& d : draws) {
+        uint32_t startVertex = d[0];
+        uint32_t primCount = d[1];
+
+        std::vector<uint32_t> fan;
+        for (uint32_t i = 0; i < primCount + 2; i++)
+            fan.push_back(startVertex + i);
+
+        D3D9FanDraw draw = converter.ConvertNonIndexed(primCount);
+        TEST_ASSERT(draw.indexCount == primCount * 3, "Index count");
+        TEST_ASSERT(equivalent(reference_fan(fan), resolve(draw, startVertex)), "Triangles differ from the fan");
+
+        bool wide = primCount + 2 > 0x10000;
+        TEST_ASSERT((draw.indexType == D3D9IndexType::Uint32) == wide, "Index type");
+    }
+
+    // Smaller fans reuse the pattern
+    D3D9FanDraw a = converter.ConvertNonIndexed(10);
+    D3D9FanDraw b = converter.ConvertNonIndexed(500);
+    TEST_ASSERT(a.id == b.id && a.indices == b.indices, "Pattern not shared");
+
+    D3D9FanCacheStats stats = converter.GetStats();
+    TEST_ASSERT(stats.patternGrowths == 4, "Pattern regrown");
+    TEST_ASSERT(stats.nonIndexedDraws == 8, "Draw count");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Indexed fans
+ * ============================================ */
+int test_fan_indexed(void) {
+    printf("TEST: fan_indexed\n");
+
+    D3D9FanConverter converter;
+    std::mt19937 rng(65);
+
+    std::vector<uint16_t> indices16(4096);
+    std::vector<uint32_t> indices32(4096);
+    for (uint32_t i = 0; i < 4096; i++) {
+        indices16[i] = uint16_t(rng());
+        indices32[i] = rng() & 0xffffff;
+    }
+
+    for (uint32_t n = 0; n < 200; n++) {
+        uint32_t startIndex = rng() % 2048;
+        uint32_t primCount = 1 + rng() % 1000;
+        uint32_t baseVertex = rng() % 100;
+        bool wide = n & 1;
+        bool user = (n % 3) == 0;
+
+        std::vector<uint32_t> fan;
+        for (uint32_t i = 0; i < primCount + 2; i++)
+            fan.push_back(baseVertex + (wide ? indices32[startIndex + i] : indices16[startIndex + i]));
+
+        const void* src = wide
+            ? static_cast<const void*>(&indices32[startIndex])
+            : static_cast<const void*>(&indices16[startIndex]);
+
+        D3D9FanDraw draw = converter.ConvertIndexed(user ? 0 : (wide ? 2 : 1), 1,
+            wide ? D3D9IndexType::Uint32 : D3D9IndexType::Uint16, src, startIndex, primCount);
+
+        TEST_ASSERT(equivalent(reference_fan(fan), resolve(draw, baseVertex)), "Triangles differ from the fan");
+    }
+
+    // Degenerate fan: all triangles share the pivot
+    const uint16_t same[] = { 5, 5, 5, 5 };
+    D3D9FanDraw draw = converter.ConvertIndexed(0, 0, D3D9IndexType::Uint16, same, 0, 2);
+    TEST_ASSERT(equivalent(reference_fan({ 5, 5, 5, 5 }), resolve(draw, 0)), "Degenerate fan");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Conversion cache
+ * ============================================ */
+int test_fan_cache(void) {
+    printf("TEST: fan_cache\n");
+
+    D3D9FanCacheOptions options;
+    options.maxCachedBytes = 3 * 100 * 2 * 3;  // Three conversions of 100 triangles
+
+    D3D9FanConverter converter(options);
+
+    std::vector<uint16_t> indices(1024);
+    for (uint32_t i = 0; i < 1024; i++)
+        indices[i] = uint16_t(i * 7);
+
+    auto convert = [&] (uint64_t buffer, uint64_t version, uint32_t start) {
+        return converter.ConvertIndexed(buffer, version, D3D9IndexType::Uint16, &indices[start], start, 100);
+    };
+
+    D3D9FanDraw a = convert(1, 1, 0);
+    D3D9FanDraw b = convert(1, 1, 0);
+    TEST_ASSERT(a.id == b.id, "Same range not cached");
+
+    D3D9FanDraw c = convert(1, 1, 200);
+    TEST_ASSERT(c.id != a.id, "Different range shared");
+
+    // The buffer was locked and rewritten
+    indices[0] = 999;
+    D3D9FanDraw d = convert(1, 2, 0);
+    TEST_ASSERT(d.id != a.id, "New version served stale data");
+    TEST_ASSERT(static_cast<const uint16_t*>(d.indices)[2] == 999, "Pivot from old version");
+
+    D3D9FanCacheStats stats = converter.GetStats();
+    TEST_ASSERT(stats.indexedHits == 1 && stats.indexedMisses == 3, "Hit and miss counts");
+    TEST_ASSERT(stats.cachedBytes == 1800 && stats.evictions == 0, "Cached bytes");
+
+    // Touch version 1 at 200, then add a fourth: the least recently
+    // used conversion (version 1 at 0) goes
+    convert(1, 1, 200);
+    convert(2, 1, 0);
+    stats = converter.GetStats();
+    TEST_ASSERT(stats.evictions == 1 && stats.cachedBytes == 1800, "Eviction");
+
+    uint64_t misses = stats.indexedMisses;
+    convert(1, 1, 200);
+    TEST_ASSERT(converter.GetStats().indexedMisses == misses, "Recently used entry evicted");
+    convert(1, 1, 0);
+    TEST_ASSERT(converter.GetStats().indexedMisses == misses + 1, "Least recently used entry kept");
+
+    // Destroying buffer 1 drops its conversions
+    converter.InvalidateBuffer(1);
+    TEST_ASSERT(converter.GetStats().cachedBytes == 600, "Buffer not invalidated");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Triangle Fan Conversion Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 4;
+
+    if (test_fan_pattern_simd()) passed++; else failed++;
+    if (test_fan_non_indexed()) passed++; else failed++;
+    if (test_fan_indexed()) passed++; else failed++;
+    if (test_fan_cache()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
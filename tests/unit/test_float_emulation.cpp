@@ -0,0 +1,703 @@
+/*
+ * Float Emulation Test Suite
+ *
+ * These tests verify the FastStrict float emulation plan
+ * (src/dxso/dxso_float_emulation.h): the bytecode decoder, which
+ * multiply operands the analysis leaves unclamped, and that shaders
+ * run with the FastStrict plan give bit for bit the results of
+ * Strict. A small interpreter executes decoded shaders with the
+ * NClamp semantics DxsoCompiler emits in SPIR-V.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_float_decode - Are tokens, modifiers and comments decoded?
+ * 2. test_float_bounds - Are only possibly non-finite operands clamped?
+ * 3. test_float_control_flow - Do branches, loops and calls stay sound?
+ * 4. test_float_strict_reference - Does FastStrict match Strict bit for bit?
+ */
+
+#include "dxso/dxso_float_emulation.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <cfloat>
+#include <cmath>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* ============================================
+ * Bytecode assembler
+ * ============================================ */
+static uint32_t reg_token(DxsoRegisterType type, uint32_t index) {
+    uint32_t t = uint32_t(type);
+    return 0x80000000u | ((t & 0x7) << 28) | ((t & 0x18) << 8) | index;
+}
+
+static uint32_t dst(DxsoRegisterType type, uint32_t index, uint32_t mask = 0xf, bool sat = false) {
+    return reg_token(type, index) | (mask << 16) | (sat ? 1u << 20 : 0u);
+}
+
+static uint32_t src(DxsoRegisterType type, uint32_t index, uint32_t swizzle = 0xe4,
+                    DxsoRegModifier mod = DxsoRegModifier::None) {
+    return reg_token(type, index) | (swizzle << 16) | (uint32_t(mod) << 24);
+}
+
+static uint32_t float_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+struct Assembler {
+    std::vector<uint32_t> code;
+
+    Assembler(bool ps, uint32_t major, uint32_t minor = 0) {
+        code.push_back((ps ? 0xffff0000u : 0xfffe0000u) | (major << 8) | minor);
+    }
+
+    void op(DxsoOpcode opcode, std::initializer_list<uint32_t> params, uint32_t control = 0) {
+        code.push_back(uint32_t(opcode) | (control << 16) | (uint32_t(params.size()) << 24));
+        code.insert(code.end(), params.begin(), params.end());
+    }
+
+    void def(uint32_t index, float x, float y, float z, float w) {
+        op(DxsoOpcode::Def, { dst(DxsoRegisterType::Const, index),
+            float_bits(x), float_bits(y), float_bits(z), float_bits(w) });
+    }
+
+    void comment(uint32_t dwords) {
+        code.push_back(uint32_t(DxsoOpcode::Comment) | (dwords << 16));
+        code.insert(code.end(), dwords, 0x12345678u);
+    }
+
+    DxsoProgram finish() {
+        code.push_back(uint32_t(DxsoOpcode::End));
+        DxsoProgram program;
+        if (!DxsoDecode(code.data(), code.size(), program))
+            program.instructions.clear();
+        return program;
+    }
+};
+
+static const DxsoRegisterType R = DxsoRegisterType::Temp;
+static const DxsoRegisterType V = DxsoRegisterType::Input;
+static const DxsoRegisterType C = DxsoRegisterType::Const;
+static const DxsoRegisterType T = DxsoRegisterType::Addr;
+static const DxsoRegisterType S = DxsoRegisterType::Sampler;
+
+/* ============================================
+ * Reference interpreter
+ * ============================================ */
+struct Vec4 {
+    float v[4];
+};
+
+struct Inputs {
+    Vec4 c[32];
+    Vec4 v[8];
+    int  i[4];
+    std::vector<float> texels;
+};
+
+struct Machine {
+    const DxsoProgram& program;
+    const DxsoFloatEmulationPlan& plan;
+    const Inputs& in;
+
+    Vec4 r[32] = { };
+    Vec4 c[32];
+    Vec4 out[4] = { };
+    bool breaking = false;
+
+    Machine(const DxsoProgram& p, const DxsoFloatEmulationPlan& pl, const Inputs& i)
+    : program(p), plan(pl), in(i) {
+        memcpy(c, in.c, sizeof(c));
+        for (const auto& ins : program.instructions) {
+            if (ins.opcode == DxsoOpcode::Def)
+                memcpy(c[ins.dst.index].v, ins.def, sizeof(Vec4));
+        }
+    }
+
+    /* GLSL.std.450 NClamp: NaN becomes the lower bound */
+    static float nclamp(float x, float lo, float hi) {
+        return std::isnan(x) ? lo : std::fmin(std::fmax(x, lo), hi);
+    }
+
+    Vec4 load(const DxsoRegister& reg, uint32_t offset = 0) const {
+        const Vec4* file = nullptr;
+        switch (reg.type) {
+            case DxsoRegisterType::Temp:  file = r; break;
+            case DxsoRegisterType::Const: file = c; break;
+            case DxsoRegisterType::Input:
+            case DxsoRegisterType::Addr:  file = in.v; break;
+            default: return Vec4();
+        }
+
+        Vec4 raw = file[reg.index + offset];
+        Vec4 result;
+        for (uint32_t k = 0; k < 4; k++) {
+            float x = raw.v[reg.component(k)];
+            switch (reg.modifier) {
+                case DxsoRegModifier::Neg:    x = -x; break;
+                case DxsoRegModifier::Abs:    x = std::fabs(x); break;
+                case DxsoRegModifier::AbsNeg: x = -std::fabs(x); break;
+                default: break;
+            }
+            result.v[k] = x;
+        }
+        return result;
+    }
+
+    static Vec4 clamped(Vec4 a, bool clamp) {
+        if (clamp) {
+            for (float& x : a.v)
+                x = nclamp(x, -FLT_MAX, FLT_MAX);
+        }
+        return a;
+    }
+
+    static bool compare(uint32_t control, float a, float b) {
+        switch (control) {
+            case 1: return a > b;
+            case 2: return a == b;
+            case 3: return a >= b;
+            case 4: return a < b;
+            case 5: return a != b;
+            case 6: return a <= b;
+            default: return false;
+        }
+    }
+
+    float sample(uint32_t sampler, const Vec4& coord, uint32_t k) const {
+        uint32_t h = sampler * 0x9e3779b9u + k;
+        for (float x : coord.v) {
+            uint32_t u;
+            memcpy(&u, &x, sizeof(u));
+            h = (h ^ u) * 0x01000193u;
+        }
+        return in.texels[h % in.texels.size()];
+    }
+
+    size_t find_end(size_t begin, size_t& elseIndex) const {
+        uint32_t depth = 0;
+        elseIndex = 0;
+        for (size_t i = begin + 1; i < program.instructions.size(); i++) {
+            DxsoOpcode op = program.instructions[i].opcode;
+            if (op == DxsoOpcode::If || op == DxsoOpcode::Ifc || op == DxsoOpcode::Rep)
+                depth++;
+            else if (op == DxsoOpcode::EndIf || op == DxsoOpcode::EndRep) {
+                if (!depth--)
+                    return i;
+            } else if (op == DxsoOpcode::Else && !depth)
+                elseIndex = i;
+        }
+        return program.instructions.size();
+    }
+
+    void run(size_t begin, size_t end) {
+        for (size_t i = begin; i < end && !breaking; i++) {
+            const DxsoInstruction& ins = program.instructions[i];
+
+            if (ins.opcode == DxsoOpcode::Ifc) {
+                size_t elseIndex;
+                size_t endIndex = find_end(i, elseIndex);
+                bool taken = compare(ins.control, load(ins.src[0]).v[0], load(ins.src[1]).v[0]);
+
+                if (taken)
+                    run(i + 1, elseIndex ? elseIndex : endIndex);
+                else if (elseIndex)
+                    run(elseIndex + 1, endIndex);
+
+                i = endIndex;
+            } else if (ins.opcode == DxsoOpcode::Rep) {
+                size_t elseIndex;
+                size_t endIndex = find_end(i, elseIndex);
+                int count = in.i[ins.src[0].index];
+
+                for (int n = 0; n < count && !breaking; n++)
+                    run(i + 1, endIndex);
+
+                breaking = false;
+                i = endIndex;
+            } else if (ins.opcode == DxsoOpcode::BreakC) {
+                breaking = compare(ins.control, load(ins.src[0]).v[0], load(ins.src[1]).v[0]);
+            } else {
+                execute(uint32_t(i), ins);
+            }
+        }
+    }
+
+    void execute(uint32_t index, const DxsoInstruction& ins) {
+        if (!ins.hasDst || ins.opcode == DxsoOpcode::Dcl || ins.opcode == DxsoOpcode::Def)
+            return;
+
+        Vec4 a = ins.srcCount > 0 ? load(ins.src[0]) : Vec4();
+        Vec4 b = ins.srcCount > 1 ? load(ins.src[1]) : Vec4();
+        Vec4 s = ins.srcCount > 2 ? load(ins.src[2]) : Vec4();
+        Vec4 d = { };
+
+        Vec4 ca = clamped(a, plan.NeedsClamp(index, 0));
+        Vec4 cb = clamped(b, plan.NeedsClamp(index, 1));
+
+        auto dot = [] (const Vec4& x, const Vec4& y, uint32_t n) {
+            float sum = x.v[0] * y.v[0];
+            for (uint32_t k = 1; k < n; k++)
+                sum = sum + x.v[k] * y.v[k];
+            return sum;
+        };
+
+        for (uint32_t k = 0; k < 4; k++) {
+            float x = a.v[k], y = b.v[k], z = s.v[k];
+
+            switch (ins.opcode) {
+                case DxsoOpcode::Mov:    d.v[k] = x; break;
+                case DxsoOpcode::Abs:    d.v[k] = std::fabs(x); break;
+                case DxsoOpcode::Add:    d.v[k] = x + y; break;
+                case DxsoOpcode::Sub:    d.v[k] = x - y; break;
+                case DxsoOpcode::Mul:    d.v[k] = ca.v[k] * cb.v[k]; break;
+                case DxsoOpcode::Mad:    d.v[k] = ca.v[k] * cb.v[k] + z; break;
+                case DxsoOpcode::Dp3:    d.v[k] = dot(ca, cb, 3); break;
+                case DxsoOpcode::Dp4:    d.v[k] = dot(ca, cb, 4); break;
+                case DxsoOpcode::Dp2Add: d.v[k] = dot(ca, cb, 2) + s.v[0]; break;
+                case DxsoOpcode::Rcp:    d.v[k] = 1.0f / a.v[0]; break;
+                case DxsoOpcode::Rsq:    d.v[k] = 1.0f / std::sqrt(std::fabs(a.v[0])); break;
+                case DxsoOpcode::Exp:    d.v[k] = std::exp2(a.v[0]); break;
+                case DxsoOpcode::Frc:    d.v[k] = x - std::floor(x); break;
+                case DxsoOpcode::Min:    d.v[k] = std::fmin(x, y); break;
+                case DxsoOpcode::Max:    d.v[k] = std::fmax(x, y); break;
+                case DxsoOpcode::Slt:    d.v[k] = x < y ? 1.0f : 0.0f; break;
+                case DxsoOpcode::Sge:    d.v[k] = x >= y ? 1.0f : 0.0f; break;
+                case DxsoOpcode::Cmp:    d.v[k] = x >= 0.0f ? y : z; break;
+                case DxsoOpcode::Lrp:    d.v[k] = x * (y - z) + z; break;
+                case DxsoOpcode::Tex:    d.v[k] = sample(ins.src[1].index, a, k); break;
+
+                case DxsoOpcode::M4x4:
+                case DxsoOpcode::M3x3: {
+                    uint32_t n = ins.opcode == DxsoOpcode::M4x4 ? 4 : 3;
+                    if (k < n)
+                        d.v[k] = dot(ca, clamped(load(ins.src[1], k), plan.NeedsClamp(index, 1 + k)), n);
+                } break;
+
+                default:
+                    d.v[k] = NAN;
+            }
+
+            if (ins.dst.saturate)
+                d.v[k] = nclamp(d.v[k], 0.0f, 1.0f);
+        }
+
+        Vec4* file = ins.dst.type == DxsoRegisterType::Temp ? r : out;
+        for (uint32_t k = 0; k < 4; k++) {
+            if ((ins.dst.mask >> k) & 1)
+                file[ins.dst.index].v[k] = d.v[k];
+        }
+    }
+};
+
+/* Runs a shader, returns temps and outputs */
+static std::vector<uint32_t> run_shader(const DxsoProgram& program, D3D9FloatEmulation mode, const Inputs& in) {
+    DxsoFloatEmulationPlan plan(program, mode);
+    Machine m(program, plan, in);
+    m.run(0, program.instructions.size());
+
+    std::vector<uint32_t> result(sizeof(m.r) / 4 + sizeof(m.out) / 4);
+    memcpy(result.data(), m.r, sizeof(m.r));
+    memcpy(result.data() + sizeof(m.r) / 4, m.out, sizeof(m.out));
+    return result;
+}
+
+/* ============================================
+ * Test: Decoder
+ * ============================================ */
+int test_float_decode(void) {
+    printf("TEST: float_decode\n");
+
+    Assembler vs(false, 3);
+    vs.comment(3);
+    vs.op(DxsoOpcode::Dcl, { 0x80000000u, dst(V, 0) });
+    vs.def(4, 1.0f, 2.0f, 3.0f, 4.0f);
+    // mad_sat r1.xy, -r0.wzyx, |c[a0.x + 2]|, v0
+    vs.op(DxsoOpcode::Mad, { dst(R, 1, 0x3, true), src(R, 0, 0x1b, DxsoRegModifier::Neg),
+        src(C, 2, 0xe4, DxsoRegModifier::Abs) | (1u << 13), src(DxsoRegisterType::Addr, 0, 0),
+        src(V, 0) });
+    vs.op(DxsoOpcode::Mov, { dst(DxsoRegisterType::Output, 0), src(R, 1) });
+
+    DxsoProgram p = vs.finish();
+    TEST_ASSERT(p.instructions.size() == 4, "Instruction count");
+    TEST_ASSERT(p.type == DxsoProgramType::VertexShader && p.major == 3, "Version");
+
+    const DxsoInstruction& mad = p.instructions[2];
+    TEST_ASSERT(mad.opcode == DxsoOpcode::Mad && mad.srcCount == 3, "Relative token taken as source");
+    TEST_ASSERT(mad.dst.mask == 0x3 && mad.dst.saturate, "Destination");
+    TEST_ASSERT(mad.src[0].modifier == DxsoRegModifier::Neg && mad.src[0].component(0) == 3, "Source 0");
+    TEST_ASSERT(mad.src[1].relative && mad.src[1].index == 2 && mad.src[1].modifier == DxsoRegModifier::Abs, "Source 1");
+    TEST_ASSERT(mad.src[2].type == DxsoRegisterType::Input, "Source 2");
+
+    const DxsoInstruction& def = p.instructions[1];
+    TEST_ASSERT(def.dst.index == 4 && def.def[3] == float_bits(4.0f), "Def values");
+
+    // Shader model 1 and truncated code are rejected
+    uint32_t ps14[] = { 0xffff0104u, 0x0000ffffu };
+    TEST_ASSERT(!DxsoDecode(ps14, 2, p), "SM1 accepted");
+
+    std::vector<uint32_t> truncated = vs.code;
+    truncated.resize(truncated.size() - 3);
+    TEST_ASSERT(!DxsoDecode(truncated.data(), truncated.size(), p), "Truncated code accepted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Operand bounds
+ * ============================================ */
+static DxsoProgram bounds_shader(uint32_t major) {
+    Assembler ps(true, major);
+    ps.def(10, 0.5f, 2.0f, 0.0f, 1.0f);
+    ps.def(20, 1.0f, 0.0f, 0.0f, 0.0f);
+    ps.def(21, 0.0f, 1.0f, 0.0f, 0.0f);
+    ps.def(22, 0.0f, 0.0f, 1.0f, 0.0f);
+    ps.def(23, 0.0f, 0.0f, 0.0f, 1.0f);
+    ps.op(DxsoOpcode::Tex, { dst(R, 0), src(T, 0), src(S, 0) });                 // 5
+    ps.op(DxsoOpcode::Mul, { dst(R, 1), src(R, 0), src(C, 10) });                // 6: texture sample
+    ps.op(DxsoOpcode::Mul, { dst(R, 2), src(V, 0), src(C, 10) });                // 7: color input
+    ps.op(DxsoOpcode::Mul, { dst(R, 3, 0xf, true), src(R, 0), src(C, 0) });      // 8: uniform constant
+    ps.op(DxsoOpcode::Mul, { dst(R, 4), src(R, 3), src(V, 0) });                 // 9: saturated
+    ps.op(DxsoOpcode::Rcp, { dst(R, 5, 0x1), src(R, 4, 0x00) });                 // 10
+    ps.op(DxsoOpcode::Mad, { dst(R, 6), src(R, 5, 0x00), src(C, 10), src(R, 0) });  // 11: rcp
+    ps.op(DxsoOpcode::Dp3, { dst(R, 7), src(R, 2), src(R, 4, 0xe4, DxsoRegModifier::Neg) });  // 12
+    ps.op(DxsoOpcode::Mov, { dst(R, 2, 0x8), src(R, 0) });                       // 13: w only
+    ps.op(DxsoOpcode::Mul, { dst(R, 8, 0x7), src(R, 2), src(C, 10) });           // 14: xyz still bounded
+    ps.op(DxsoOpcode::M4x4, { dst(R, 9), src(R, 2), src(C, 20) });               // 15: def rows
+    ps.op(DxsoOpcode::M3x3, { dst(R, 10, 0x7), src(R, 2), src(C, 0) });          // 16: uniform rows
+    ps.op(DxsoOpcode::Mov, { dst(DxsoRegisterType::ColorOut, 0), src(R, 1) });
+    return ps.finish();
+}
+
+int test_float_bounds(void) {
+    printf("TEST: float_bounds\n");
+
+    DxsoProgram ps2 = bounds_shader(2);
+    TEST_ASSERT(!ps2.instructions.empty(), "Decode failed");
+
+    DxsoFloatEmulationPlan plan(ps2, D3D9FloatEmulation::FastStrict);
+
+    TEST_ASSERT(plan.GetClampMask(6) == 0x1, "Texture sample not clamped");
+    TEST_ASSERT(plan.GetClampMask(7) == 0x0, "Color input clamped");
+    TEST_ASSERT(plan.GetClampMask(8) == 0x3, "Texture times uniform");
+    TEST_ASSERT(plan.GetClampMask(9) == 0x0, "Saturated result clamped");
+    TEST_ASSERT(plan.GetClampMask(11) == 0x1, "rcp result not clamped");
+    TEST_ASSERT(plan.GetClampMask(12) == 0x0, "Bounded dp3 clamped");
+    TEST_ASSERT(plan.GetClampMask(14) == 0x0, "Unwritten components lost");
+    TEST_ASSERT(plan.GetClampMask(15) == 0x1, "m4x4: w unbounded, rows defined");
+    TEST_ASSERT(plan.GetClampMask(16) == 0xe, "m3x3: xyz bounded, rows uniform");
+
+    DxsoFloatEmulationStats stats = plan.GetStats();
+    TEST_ASSERT(stats.analyzed && stats.multiplies == 14, "Multiply count");
+    TEST_ASSERT(stats.strictClamps == 23 && stats.clamps == 8, "Clamp counts");
+
+    // Strict clamps everything, Disabled nothing
+    DxsoFloatEmulationPlan strict(ps2, D3D9FloatEmulation::Strict);
+    DxsoFloatEmulationPlan disabled(ps2, D3D9FloatEmulation::Disabled);
+    TEST_ASSERT(strict.GetClampMask(7) == 0x3 && strict.GetClampMask(15) == 0x1f, "Strict mask");
+    TEST_ASSERT(strict.GetStats().clamps == 23 && !strict.GetStats().analyzed, "Strict stats");
+    TEST_ASSERT(disabled.GetStats().clamps == 0, "Disabled clamps");
+
+    // ps_3_0 inputs are arbitrary interpolants
+    DxsoProgram ps3 = bounds_shader(3);
+    DxsoFloatEmulationPlan plan3(ps3, D3D9FloatEmulation::FastStrict);
+    TEST_ASSERT(plan3.GetClampMask(7) == 0x1, "ps_3_0 input not clamped");
+
+    DxsoFloatAnalysisOptions options;
+    options.saturatedColorInputs = false;
+    DxsoFloatEmulationPlan unsaturated(ps2, D3D9FloatEmulation::FastStrict, options);
+    TEST_ASSERT(unsaturated.GetClampMask(7) == 0x1, "Option ignored");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Control flow
+ * ============================================ */
+int test_float_control_flow(void) {
+    printf("TEST: float_control_flow\n");
+
+    // Either branch may have run
+    Assembler a(true, 3);
+    a.def(10, 2.0f, 2.0f, 2.0f, 2.0f);
+    a.op(DxsoOpcode::Ifc, { src(C, 0), src(C, 1) }, 1);                          // 1
+    a.op(DxsoOpcode::Mov, { dst(R, 0), src(C, 10) });                            // 2
+    a.op(DxsoOpcode::Else, { });                                                 // 3
+    a.op(DxsoOpcode::Tex, { dst(R, 0), src(T, 0), src(S, 0) });                  // 4
+    a.op(DxsoOpcode::EndIf, { });                                                // 5
+    a.op(DxsoOpcode::Mul, { dst(R, 1), src(R, 0), src(C, 10) });                 // 6
+    a.op(DxsoOpcode::Mul, { dst(R, 2), src(R, 3), src(C, 10) });                 // 7: r3 still zero
+
+    // Growing values in a loop are widened
+    a.op(DxsoOpcode::Mov, { dst(R, 4), src(C, 10) });                            // 8
+    a.op(DxsoOpcode::Rep, { src(DxsoRegisterType::ConstInt, 0) });               // 9
+    a.op(DxsoOpcode::Mul, { dst(R, 4), src(R, 4), src(C, 10) });                 // 10
+    a.op(DxsoOpcode::Mul, { dst(R, 5), src(R, 10), src(C, 10) });                // 11: r10 written below
+    a.op(DxsoOpcode::BreakC, { src(R, 4), src(C, 10) }, 1);                      // 12
+    a.op(DxsoOpcode::Tex, { dst(R, 10), src(T, 0), src(S, 0) });                 // 13
+    a.op(DxsoOpcode::EndRep, { });                                               // 14
+    a.op(DxsoOpcode::Mul, { dst(R, 6), src(R, 4), src(C, 10) });                 // 15
+
+    // Stable values in a loop stay bounded
+    a.op(DxsoOpcode::Rep, { src(DxsoRegisterType::ConstInt, 0) });               // 16
+    a.op(DxsoOpcode::Mov, { dst(R, 7, 0xf, true), src(R, 7) });                  // 17
+    a.op(DxsoOpcode::EndRep, { });                                               // 18
+    a.op(DxsoOpcode::Mul, { dst(R, 8), src(R, 7), src(C, 10) });                 // 19
+    DxsoProgram p = a.finish();
+    TEST_ASSERT(!p.instructions.empty(), "Decode failed");
+
+    DxsoFloatEmulationPlan plan(p, D3D9FloatEmulation::FastStrict);
+    TEST_ASSERT(plan.GetStats().analyzed, "Not analysed");
+    TEST_ASSERT(plan.GetClampMask(6) == 0x1, "Else branch lost");
+    TEST_ASSERT(plan.GetClampMask(7) == 0x0, "Untouched temp clamped");
+    TEST_ASSERT(plan.GetClampMask(10) == 0x1, "Loop value not widened");
+    TEST_ASSERT(plan.GetClampMask(11) == 0x1, "Back edge lost");
+    TEST_ASSERT(plan.GetClampMask(15) == 0x1, "Loop exit lost");
+    TEST_ASSERT(plan.GetClampMask(19) == 0x0, "Stable loop value clamped");
+
+    // Subroutines fall back to Strict
+    Assembler b(false, 3);
+    b.op(DxsoOpcode::Mul, { dst(R, 0), src(R, 1), src(R, 2) });
+    b.op(DxsoOpcode::Call, { reg_token(DxsoRegisterType::Label, 0) });
+    b.op(DxsoOpcode::Ret, { });
+    b.op(DxsoOpcode::Label, { reg_token(DxsoRegisterType::Label, 0) });
+    b.op(DxsoOpcode::Ret, { });
+    DxsoProgram q = b.finish();
+    TEST_ASSERT(q.instructions.size() == 5, "Decode failed");
+
+    DxsoFloatEmulationPlan fallback(q, D3D9FloatEmulation::FastStrict);
+    TEST_ASSERT(!fallback.GetStats().analyzed && fallback.GetClampMask(0) == 0x3, "No fallback");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: FastStrict against Strict
+ * ============================================ */
+static const float special[] = {
+    0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, 1e-30f, 1e30f, -1e30f,
+    FLT_MAX, -FLT_MAX, FLT_MIN, INFINITY, -INFINITY, NAN,
+};
+
+static std::vector<uint32_t> random_shader(std::mt19937& rng) {
+    bool ps = rng() % 4 != 0;
+    uint32_t major = 2 + rng() % 2;
+    Assembler a(ps, major);
+
+    auto pick = [&] (bool finiteOnly) {
+        uint32_t n = sizeof(special) / sizeof(special[0]) - (finiteOnly ? 3 : 0);
+        return special[rng() % n];
+    };
+
+    // Finite defs, c24 holds infinities
+    for (uint32_t i = 20; i < 24; i++)
+        a.def(i, pick(true), pick(true), pick(true), pick(true));
+    a.def(24, INFINITY, -INFINITY, 1.0f, 0.0f);
+
+    auto any_src = [&] () {
+        static const DxsoRegModifier mods[] = { DxsoRegModifier::None, DxsoRegModifier::None,
+            DxsoRegModifier::Neg, DxsoRegModifier::Abs, DxsoRegModifier::AbsNeg };
+        DxsoRegModifier mod = mods[rng() % 5];
+        uint32_t swizzle = rng() % 4 ? 0xe4 : rng() & 0xff;
+
+        switch (rng() % 6) {
+            case 0:  return src(V, rng() % 4, swizzle, mod);
+            case 1:  return src(C, rng() % 8, swizzle, mod);
+            case 2:  return src(C, 20 + rng() % 5, swizzle, mod);
+            default: return src(R, rng() % 8, swizzle, mod);
+        }
+    };
+
+    static const DxsoOpcode ops[] = {
+        DxsoOpcode::Mov, DxsoOpcode::Add, DxsoOpcode::Sub, DxsoOpcode::Mul, DxsoOpcode::Mul,
+        DxsoOpcode::Mad, DxsoOpcode::Mad, DxsoOpcode::Dp3, DxsoOpcode::Dp4, DxsoOpcode::Dp2Add,
+        DxsoOpcode::Rcp, DxsoOpcode::Rsq, DxsoOpcode::Exp, DxsoOpcode::Frc, DxsoOpcode::Min,
+        DxsoOpcode::Max, DxsoOpcode::Slt, DxsoOpcode::Sge, DxsoOpcode::Cmp, DxsoOpcode::Lrp,
+        DxsoOpcode::Abs, DxsoOpcode::Tex, DxsoOpcode::M4x4, DxsoOpcode::M3x3,
+    };
+
+    // Open blocks, innermost last
+    std::vector<DxsoOpcode> open;
+    uint32_t loops = 0;
+    uint32_t count = 20 + rng() % 40;
+
+    auto close = [&] () {
+        if (open.back() == DxsoOpcode::Rep) {
+            a.op(DxsoOpcode::EndRep, { });
+            loops--;
+        } else {
+            a.op(DxsoOpcode::EndIf, { });
+        }
+        open.pop_back();
+    };
+
+    for (uint32_t n = 0; n < count; n++) {
+        uint32_t roll = rng() % 20;
+
+        if (roll == 0 && open.size() < 2) {
+            a.op(DxsoOpcode::Ifc, { any_src(), any_src() }, 1 + rng() % 6);
+            open.push_back(DxsoOpcode::Ifc);
+        } else if (roll == 1 && open.size() < 2) {
+            a.op(DxsoOpcode::Rep, { src(DxsoRegisterType::ConstInt, rng() % 4) });
+            open.push_back(DxsoOpcode::Rep);
+            loops++;
+        } else if (roll == 2 && loops) {
+            a.op(DxsoOpcode::BreakC, { any_src(), any_src() }, 1 + rng() % 6);
+        } else if (roll == 3 && !open.empty() && open.back() == DxsoOpcode::Ifc) {
+            a.op(DxsoOpcode::Else, { });
+            open.back() = DxsoOpcode::Else;
+        } else if (roll == 4 && !open.empty()) {
+            close();
+        } else {
+            DxsoOpcode op = ops[rng() % (sizeof(ops) / sizeof(ops[0]))];
+            uint32_t d = dst(R, rng() % 8, 1 + rng() % 15, rng() % 4 == 0);
+
+            switch (op) {
+                case DxsoOpcode::Tex:
+                    a.op(op, { d, any_src(), src(S, rng() % 2) });
+                    break;
+                case DxsoOpcode::M4x4:
+                case DxsoOpcode::M3x3:
+                    a.op(op, { d, any_src(), src(C, rng() % 2 ? 0 : 20) });
+                    break;
+                case DxsoOpcode::Mad:
+                case DxsoOpcode::Dp2Add:
+                case DxsoOpcode::Cmp:
+                case DxsoOpcode::Lrp:
+                    a.op(op, { d, any_src(), any_src(), any_src() });
+                    break;
+                case DxsoOpcode::Mov:
+                case DxsoOpcode::Rcp:
+                case DxsoOpcode::Rsq:
+                case DxsoOpcode::Exp:
+                case DxsoOpcode::Frc:
+                case DxsoOpcode::Abs:
+                    a.op(op, { d, any_src() });
+                    break;
+                default:
+                    a.op(op, { d, any_src(), any_src() });
+            }
+        }
+    }
+
+    while (!open.empty())
+        close();
+
+    a.code.push_back(uint32_t(DxsoOpcode::End));
+    return a.code;
+}
+
+int test_float_strict_reference(void) {
+    printf("TEST: float_strict_reference\n");
+
+    std::mt19937 rng(67);
+
+    uint32_t runs = 0;
+    uint32_t disabledDiffers = 0;
+    uint64_t strictClamps = 0;
+    uint64_t fastClamps = 0;
+
+    for (uint32_t s = 0; s < 400; s++) {
+        std::vector<uint32_t> code = random_shader(rng);
+
+        DxsoProgram program;
+        TEST_ASSERT(DxsoDecode(code.data(), code.size(), program), "Generated shader not decoded");
+
+        DxsoFloatEmulationStats stats = DxsoFloatEmulationPlan(program, D3D9FloatEmulation::FastStrict).GetStats();
+        TEST_ASSERT(stats.analyzed, "Generated shader not analysed");
+        strictClamps += stats.strictClamps;
+        fastClamps += stats.clamps;
+
+        bool colorInputs = program.type == DxsoProgramType::PixelShader && program.major < 3;
+
+        for (uint32_t n = 0; n < 20; n++) {
+            Inputs in;
+            for (auto& c : in.c) {
+                for (float& x : c.v)
+                    x = special[rng() % (sizeof(special) / sizeof(special[0]))];
+            }
+            for (auto& v : in.v) {
+                for (float& x : v.v) {
+                    // ps_2_x color inputs are saturated
+                    x = colorInputs ? float(rng() % 5) * 0.25f
+                                    : special[rng() % (sizeof(special) / sizeof(special[0]))];
+                }
+            }
+            for (int& i : in.i)
+                i = int(rng() % 4);
+            in.texels.assign(std::begin(special), std::end(special));
+
+            std::vector<uint32_t> strict = run_shader(program, D3D9FloatEmulation::Strict, in);
+            std::vector<uint32_t> fast = run_shader(program, D3D9FloatEmulation::FastStrict, in);
+            std::vector<uint32_t> disabled = run_shader(program, D3D9FloatEmulation::Disabled, in);
+
+            if (strict != fast) {
+                fprintf(stderr, "  shader %u, input set %u\n", s, n);
+                TEST_ASSERT(false, "FastStrict differs from Strict");
+            }
+
+            disabledDiffers += strict != disabled;
+            runs++;
+        }
+    }
+
+    // The inputs do hit 0 * inf, and the analysis does drop clamps
+    printf("  %u runs, %u differ without emulation, %llu of %llu clamps kept\n",
+        runs, disabledDiffers, (unsigned long long)fastClamps, (unsigned long long)strictClamps);
+    TEST_ASSERT(disabledDiffers > runs / 10, "Inputs never need emulation");
+    TEST_ASSERT(fastClamps < strictClamps, "No clamps dropped");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Float Emulation Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 4;
+
+    if (test_float_decode()) passed++; else failed++;
+    if (test_float_bounds()) passed++; else failed++;
+    if (test_float_control_flow()) passed++; else failed++;
+    if (test_float_strict_reference()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,360 @@
+/*
+ * Format Conversion Test Suite
+ *
+ * These tests verify the texture format conversion kernels and the
+ * background converter (src/d3d9/d3d9_format_convert.h). SIMD kernels
+ * must be bit-exact against the scalar reference. CPU only.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_convert_reference - Do scalar kernels produce known values?
+ * 2. test_convert_simd_exact - Do SIMD kernels match scalar for all widths?
+ * 3. test_convert_exhaustive16 - Do 16-bit kernels match for every input value?
+ * 4. test_convert_pitch - Are row pitches honoured?
+ * 5. test_convert_async - Do queued jobs complete and match?
+ * 6. test_convert_wait_helps - Does Wait() finish jobs without workers free?
+ */
+
+#include "d3d9/d3d9_format_convert.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static const D3D9ConversionFormat allFormats[] = {
+    D3D9ConversionFormat::R8G8B8,
+    D3D9ConversionFormat::L8,
+    D3D9ConversionFormat::A8L8,
+    D3D9ConversionFormat::X1R5G5B5,
+    D3D9ConversionFormat::A1R5G5B5,
+    D3D9ConversionFormat::R5G6B5,
+    D3D9ConversionFormat::A4R4G4B4,
+    D3D9ConversionFormat::P8,
+};
+
+static std::vector<uint32_t> make_palette(void) {
+    std::vector<uint8_t> entries(256 * 4);
+    for (uint32_t i = 0; i < entries.size(); i++)
+        entries[i] = uint8_t(i * 37 + 11);
+    std::vector<uint32_t> palette(256);
+    D3D9ConvertPalette(entries.data(), palette.data());
+    return palette;
+}
+
+static uint32_t convert_one(D3D9ConversionFormat format, const uint8_t* src) {
+    uint32_t dst = 0;
+    D3D9GetConvertRowFn(format, D3D9ConversionIsa::Scalar)(src, &dst, 1, nullptr);
+    return dst;
+}
+
+/* ============================================
+ * Test: Scalar reference values
+ * ============================================ */
+int test_convert_reference(void) {
+    printf("TEST: convert_reference\n");
+
+    const uint8_t rgb[] = { 0x10, 0x20, 0x30 };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::R8G8B8, rgb) == 0xff302010u, "R8G8B8");
+
+    const uint8_t l[] = { 0x7f };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::L8, l) == 0xff7f7f7fu, "L8");
+
+    const uint8_t al[] = { 0x40, 0x80 };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::A8L8, al) == 0x80404040u, "A8L8");
+
+    const uint8_t white565[] = { 0xff, 0xff };
+    const uint8_t red565[] = { 0x00, 0xf8 };
+    const uint8_t green565[] = { 0xe0, 0x07 };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::R5G6B5, white565) == 0xffffffffu, "R5G6B5 white");
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::R5G6B5, red565) == 0xffff0000u, "R5G6B5 red");
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::R5G6B5, green565) == 0xff00ff00u, "R5G6B5 green");
+
+    const uint8_t opaqueBlue1555[] = { 0x1f, 0x80 };
+    const uint8_t clearBlue1555[] = { 0x1f, 0x00 };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::A1R5G5B5, opaqueBlue1555) == 0xff0000ffu, "A1R5G5B5 opaque");
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::A1R5G5B5, clearBlue1555) == 0x000000ffu, "A1R5G5B5 clear");
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::X1R5G5B5, clearBlue1555) == 0xff0000ffu, "X1R5G5B5 ignores alpha");
+
+    const uint8_t argb4444[] = { 0x21, 0x43 };
+    TEST_ASSERT(convert_one(D3D9ConversionFormat::A4R4G4B4, argb4444) == 0x44332211u, "A4R4G4B4");
+
+    // PALETTEENTRY is R, G, B, flags; converted palette is B8G8R8A8
+    const uint8_t entry[256 * 4] = { 0x11, 0x22, 0x33, 0x44 };
+    uint32_t palette[256];
+    D3D9ConvertPalette(entry, palette);
+    const uint8_t index[] = { 0 };
+    uint32_t dst = 0;
+    D3D9GetConvertRowFn(D3D9ConversionFormat::P8, D3D9ConversionIsa::Scalar)(index, &dst, 1, palette);
+    TEST_ASSERT(dst == 0x44112233u, "P8 palette order");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: SIMD kernels match scalar, all row widths
+ * ============================================ */
+int test_convert_simd_exact(void) {
+    printf("TEST: convert_simd_exact\n");
+
+    D3D9ConversionIsa isa = D3D9GetBestConversionIsa();
+    printf("  Best ISA: %s\n", isa == D3D9ConversionIsa::Avx2 ? "AVX2" :
+                               isa == D3D9ConversionIsa::Neon ? "NEON" : "scalar");
+
+    if (isa == D3D9ConversionIsa::Scalar) {
+        printf("  SKIPPED: no SIMD kernels on this CPU\n");
+        return 1;
+    }
+
+    std::mt19937 rng(42);
+    std::vector<uint32_t> palette = make_palette();
+
+    for (D3D9ConversionFormat format : allFormats) {
+        D3D9ConvertRowFn ref = D3D9GetConvertRowFn(format, D3D9ConversionIsa::Scalar);
+        D3D9ConvertRowFn simd = D3D9GetConvertRowFn(format, isa);
+        uint32_t bpp = D3D9ConversionSourceBpp(format);
+
+        // Widths around every vector size, plus odd source offsets
+        for (uint32_t width = 0; width <= 130; width++) {
+            for (uint32_t offset = 0; offset < 3; offset++) {
+                std::vector<uint8_t> src(width * bpp + offset);
+                for (auto& b : src)
+                    b = uint8_t(rng());
+
+                std::vector<uint32_t> expected(width + 1, 0xdeadbeef);
+                std::vector<uint32_t> actual(width + 1, 0xdeadbeef);
+
+                ref(src.data() + offset, expected.data(), width, palette.data());
+                simd(src.data() + offset, actual.data(), width, palette.data());
+
+                if (memcmp(expected.data(), actual.data(), expected.size() * 4)) {
+                    fprintf(stderr, "  %s mismatch at width %u offset %u\n",
+                        D3D9ConversionFormatName(format), width, offset);
+                    TEST_ASSERT(false, "SIMD kernel differs from scalar reference");
+                }
+            }
+        }
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Every 16-bit input value
+ * ============================================ */
+int test_convert_exhaustive16(void) {
+    printf("TEST: convert_exhaustive16\n");
+
+    D3D9ConversionIsa isa = D3D9GetBestConversionIsa();
+
+    std::vector<uint16_t> src(65536);
+    for (uint32_t i = 0; i < src.size(); i++)
+        src[i] = uint16_t(i);
+
+    const D3D9ConversionFormat formats[] = {
+        D3D9ConversionFormat::A8L8,
+        D3D9ConversionFormat::X1R5G5B5,
+        D3D9ConversionFormat::A1R5G5B5,
+        D3D9ConversionFormat::R5G6B5,
+        D3D9ConversionFormat::A4R4G4B4,
+    };
+
+    for (D3D9ConversionFormat format : formats) {
+        std::vector<uint32_t> expected(src.size());
+        std::vector<uint32_t> actual(src.size());
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(src.data());
+
+        D3D9GetConvertRowFn(format, D3D9ConversionIsa::Scalar)(bytes, expected.data(), uint32_t(src.size()), nullptr);
+        D3D9GetConvertRowFn(format, isa)(bytes, actual.data(), uint32_t(src.size()), nullptr);
+
+        TEST_ASSERT(expected == actual, "Kernel differs for some 16-bit input");
+
+        // Full-scale channels must widen to exactly 0xff
+        if (format == D3D9ConversionFormat::R5G6B5)
+            TEST_ASSERT(expected[0xffff] == 0xffffffffu, "R5G6B5 max not 0xff");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Row pitch
+ * ============================================ */
+int test_convert_pitch(void) {
+    printf("TEST: convert_pitch\n");
+
+    D3D9FormatConverter converter(1);
+
+    const uint32_t w = 37, h = 9, srcPitch = 128, dstPitch = 256;
+    std::vector<uint8_t> src(srcPitch * h);
+    for (uint32_t i = 0; i < src.size(); i++)
+        src[i] = uint8_t(i * 7);
+
+    std::vector<uint8_t> dst(dstPitch * h, 0xcd);
+
+    D3D9ConversionJob job;
+    job.format = D3D9ConversionFormat::R8G8B8;
+    job.src = src.data();
+    job.srcPitch = srcPitch;
+    job.dst = dst.data();
+    job.dstPitch = dstPitch;
+    job.width = w;
+    job.height = h;
+    converter.ConvertSync(job);
+
+    for (uint32_t y = 0; y < h; y++) {
+        uint32_t expected[w];
+        convert_scalar::R8G8B8(src.data() + y * srcPitch, expected, w, nullptr);
+        TEST_ASSERT(!memcmp(dst.data() + y * dstPitch, expected, w * 4), "Row data mismatch");
+        TEST_ASSERT(dst[y * dstPitch + w * 4] == 0xcd, "Wrote past row width");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Background conversion
+ * ============================================ */
+int test_convert_async(void) {
+    printf("TEST: convert_async\n");
+
+    D3D9FormatConverter converter(3);
+    std::vector<uint32_t> palette = make_palette();
+    std::mt19937 rng(7);
+
+    struct Image {
+        D3D9ConversionJob job;
+        std::vector<uint8_t> src;
+        std::vector<uint8_t> dst;
+        uint64_t fence;
+    };
+
+    std::vector<Image> images(32);
+
+    for (uint32_t i = 0; i < images.size(); i++) {
+        Image& img = images[i];
+        D3D9ConversionFormat format = allFormats[i % 8];
+        uint32_t size = 64u << (i % 4);
+
+        img.src.resize(size * size * D3D9ConversionSourceBpp(format));
+        for (auto& b : img.src)
+            b = uint8_t(rng());
+        img.dst.resize(size * size * 4);
+
+        img.job.format = format;
+        img.job.src = img.src.data();
+        img.job.srcPitch = size * D3D9ConversionSourceBpp(format);
+        img.job.dst = img.dst.data();
+        img.job.dstPitch = size * 4;
+        img.job.width = size;
+        img.job.height = size;
+        img.job.palette = palette.data();
+        img.fence = converter.Submit(img.job);
+    }
+
+    for (Image& img : images) {
+        converter.Wait(img.fence);
+        TEST_ASSERT(converter.IsComplete(img.fence), "Fence not signaled after wait");
+
+        std::vector<uint8_t> expected(img.dst.size());
+        D3D9ConversionJob ref = img.job;
+        ref.dst = expected.data();
+        for (uint32_t y = 0; y < ref.height; y++) {
+            D3D9GetConvertRowFn(ref.format, D3D9ConversionIsa::Scalar)(
+                ref.src + y * ref.srcPitch,
+                reinterpret_cast<uint32_t*>(ref.dst + y * ref.dstPitch),
+                ref.width, ref.palette);
+        }
+        TEST_ASSERT(expected == img.dst, "Async conversion mismatch");
+    }
+
+    D3D9ConversionStats stats = converter.GetStats();
+    TEST_ASSERT(stats.jobs == images.size(), "Job count mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Waiting thread runs queued work
+ * ============================================ */
+int test_convert_wait_helps(void) {
+    printf("TEST: convert_wait_helps\n");
+
+    // One worker, many slices: Wait() must make progress on its own
+    D3D9FormatConverter converter(1);
+
+    const uint32_t size = 2048;
+    std::vector<uint8_t> src(size * size, 0x5a);
+    std::vector<uint8_t> dst(size * size * 4);
+
+    D3D9ConversionJob job;
+    job.format = D3D9ConversionFormat::L8;
+    job.src = src.data();
+    job.srcPitch = size;
+    job.dst = dst.data();
+    job.dstPitch = size * 4;
+    job.width = size;
+    job.height = size;
+
+    uint64_t fence = converter.Submit(job);
+    converter.Wait(fence);
+
+    const uint32_t* pixels = reinterpret_cast<const uint32_t*>(dst.data());
+    for (uint32_t i = 0; i < size * size; i++)
+        TEST_ASSERT(pixels[i] == 0xff5a5a5au, "Pixel not converted");
+
+    // Fences of finished jobs stay signaled, unknown fences count as done
+    TEST_ASSERT(converter.IsComplete(fence), "Fence not signaled");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Format Conversion Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_convert_reference()) passed++; else failed++;
+    if (test_convert_simd_exact()) passed++; else failed++;
+    if (test_convert_exhaustive16()) passed++; else failed++;
+    if (test_convert_pitch()) passed++; else failed++;
+    if (test_convert_async()) passed++; else failed++;
+    if (test_convert_wait_helps()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
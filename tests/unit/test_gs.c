@@ -1,154 +1,1849 @@
 /*
  * Geometry Shader Test Suite for MoltenVK
- * 
+ *
  * These tests verify geometry shader emulation.
  * Run with: make test-gs
+ *
+ * MoltenVK has no geometry shaders, so DXVK runs the vertex and
+ * geometry stages as a compute pre-pass that writes list vertices
+ * to a ring, compacted in input order with a prefix sum, and draws
+ * the ring with vkCmdDrawIndirect (src/dxvk/dxvk_gs_emulation.h).
+ * A stage that only copies its input is dropped instead. The tests
+ * run that pre-pass for three stages over a grid of triangles and
+ * check both the ring and the rendered image:
+ *
+ *   passthrough - emits the input triangle
+ *   culling     - emits only even input triangles
+ *   amplify     - emits the input triangle, cuts, then a 4 vertex
+ *                 strip completing it to a quad 32 pixels lower
+ *
+ * The vertex stage is the identity, positions are already in clip
+ * space. Everything runs on any Vulkan 1.0 device.
+ *
+ * Test progression:
+ * 1. test_gs_feature_supported - Native geometry shaders, or do we emulate them?
+ * 2. test_gs_basic_passthrough - Does the fast path match the pre-pass?
+ * 3. test_gs_amplification - Are strips assembled and extra primitives drawn in order?
+ * 4. test_gs_culling - Are dropped primitives compacted away?
+ * 5. test_gs_layered_rendering - Is a stage writing the layer skipped without shaderOutputLayer?
+ * 6. test_gs_throughput - How many primitives/s does the pre-pass sustain?
  */
 
+#define _POSIX_C_SOURCE 199309L
+
 #include <vulkan/vulkan.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+#define TEST_VK(call) do { \
+    VkResult _r = (call); \
+    if (_r != VK_SUCCESS) { \
+        fprintf(stderr, "FAILED: %s returned %d\n  %s:%d\n", #call, _r, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
 
+// Global Vulkan state
 static VkInstance instance = VK_NULL_HANDLE;
 static VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 static VkDevice device = VK_NULL_HANDLE;
+static VkQueue queue = VK_NULL_HANDLE;
+static uint32_t queueFamily = 0;
+static VkPhysicalDeviceMemoryProperties memoryProps;
+
+static int nativeGs = 0;
+static int outputLayer = 0;
+
+/* ============================================
+ * Pre-pass
+ * ============================================ */
+
+/*
+ * Input is a triangle list, one triangle per 8x8 pixel cell of the
+ * upper half of a 64x64 target. Every output vertex is one vec4.
+ */
+#define TARGET_SIZE         64
+#define GRID_COLUMNS        8
+#define GRID_ROWS           4
+#define GRID_TRIANGLES      (GRID_COLUMNS * GRID_ROWS)
+#define BENCH_TRIANGLES     65536
+#define VERTEX_BYTES        16
+
+// Default scratch, and half the default ring so the benchmark wraps
+#define SCRATCH_SIZE        (4u << 20)
+#define RING_SIZE           (8u << 20)
+
+#define SCAN_BLOCK_SIZE     64
+#define MAX_SCAN_BLOCKS     4096
+#define MAX_BATCHES         64
+
+enum {
+    GS_PASSTHROUGH,         // maxvertexcount(3), copies its input
+    GS_CULL,                // maxvertexcount(3), odd primitives emit nothing
+    GS_AMPLIFY,             // maxvertexcount(7), triangle, cut, quad strip
+};
+
+static const uint32_t gsMaxVertexCount[] = { 3, 3, 7 };
+static const char* const gsNames[] = { "passthrough", "culling", "amplify" };
+
+enum {
+    PASS_GS,                // One invocation per primitive, fills its slot
+    PASS_BLOCK_SUM,         // One invocation per scan block
+    PASS_BLOCK_SCAN,        // One invocation, block offsets and draw args
+    PASS_COMPACT,           // One invocation per primitive, copies to the ring
+};
+
+// Push constants
+typedef struct {
+    uint32_t pass;
+    uint32_t program;
+    uint32_t primitiveCount;
+    uint32_t slotVertices;
+    uint32_t firstVertex;
+    uint32_t blockCount;
+    uint32_t firstPrimitive;
+    uint32_t indirectIndex;
+} GsArgs;
+
+typedef struct {
+    uint32_t* words;
+    uint32_t count;
+    uint32_t capacity;
+} SpirvBuffer;
+
+static void spv_push(SpirvBuffer* b, uint32_t word) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        b->words = realloc(b->words, b->capacity * sizeof(uint32_t));
+    }
+    b->words[b->count++] = word;
+}
+
+static void spv_op(SpirvBuffer* b, uint32_t op, uint32_t n, const uint32_t* operands) {
+    spv_push(b, ((n + 1) << 16) | op);
+    for (uint32_t i = 0; i < n; i++)
+        spv_push(b, operands[i]);
+}
+
+#define SPV(b, op, ...) do { \
+    const uint32_t _ops[] = { __VA_ARGS__ }; \
+    spv_op(b, op, COUNT(_ops), _ops); \
+} while(0)
+
+static void spv_header(SpirvBuffer* b) {
+    // Bound patched by the caller
+    spv_push(b, 0x07230203u);
+    spv_push(b, 0x00010000u);
+    spv_push(b, 0);
+    spv_push(b, 0);
+    spv_push(b, 0);
+    SPV(b, 17, 1);                                          // OpCapability Shader
+    SPV(b, 14, 0, 1);                                       // OpMemoryModel Logical GLSL450
+}
+
+static void spv_end(SpirvBuffer* b, uint32_t bound) {
+    spv_push(b, (1u << 16) | 253);                          // OpReturn
+    spv_push(b, (1u << 16) | 56);                           // OpFunctionEnd
+    b->words[3] = bound;
+}
+
+// Ids of the pre-pass module
+enum {
+    idVoid = 1, idFnVoid, idBool, idUint, idFloat, idVec4, idUvec3,
+    idVec4Array, idUintArray, idVec4Struct, idUintStruct, idArgsStruct,
+    idPtrVec4Struct, idPtrUintStruct, idPtrArgsStruct,
+    idPtrVec4, idPtrUint, idPtrPcUint, idPtrInputUvec3, idPtrFnUint,
+    idU0, idU1, idU2, idU3, idU4, idU5, idU6, idU7, idU8, idU64, idF0, idF1, idShift,
+    idVertices, idScratch, idCounts, idBlockSums, idRing, idIndirect, idArgs, idGid,
+    idMain, idFirst
+};
+
+/*
+ * for (var = <stored by the caller>; var < limit; var++), body
+ * goes between spv_loop_begin and spv_loop_end
+ */
+typedef struct {
+    uint32_t header, cond, body, cont, merge;
+    uint32_t i;             // Loaded counter, valid in the body
+} SpvLoop;
+
+static SpvLoop spv_loop_begin(SpirvBuffer* b, uint32_t* next, uint32_t var, uint32_t limit) {
+    SpvLoop l;
+    l.header = (*next)++;
+    l.cond = (*next)++;
+    l.body = (*next)++;
+    l.cont = (*next)++;
+    l.merge = (*next)++;
+    l.i = (*next)++;
+
+    uint32_t inRange = (*next)++;
+
+    SPV(b, 249, l.header);                                  // OpBranch
+    SPV(b, 248, l.header);                                  // OpLabel
+    SPV(b, 246, l.merge, l.cont, 0);                        // OpLoopMerge
+    SPV(b, 249, l.cond);
+    SPV(b, 248, l.cond);
+    SPV(b, 61, idUint, l.i, var);                           // OpLoad
+    SPV(b, 176, idBool, inRange, l.i, limit);               // OpULessThan
+    SPV(b, 250, inRange, l.body, l.merge);                  // OpBranchConditional
+    SPV(b, 248, l.body);
+    return l;
+}
+
+static void spv_loop_end(SpirvBuffer* b, uint32_t* next, const SpvLoop* l, uint32_t var) {
+    uint32_t inc = (*next)++;
+
+    SPV(b, 249, l->cont);
+    SPV(b, 248, l->cont);
+    SPV(b, 128, idUint, inc, l->i, idU1);                   // OpIAdd
+    SPV(b, 62, var, inc);                                   // OpStore
+    SPV(b, 249, l->header);
+    SPV(b, 248, l->merge);
+}
+
+/*
+ * EmitVertex and CutVertex of the stage. The emits are unrolled
+ * here, so strips are assembled into list triangles at build time;
+ * odd triangles of a strip swap their first two vertices, like
+ * Vulkan does.
+ */
+typedef struct {
+    uint32_t strip[2];      // Last two vertices of the current strip
+    uint32_t length;        // Vertices in the current strip
+    uint32_t written;       // List vertices stored to the slot
+    uint32_t base;          // First scratch vertex of the slot
+} GsEmitter;
+
+static void gs_emit(SpirvBuffer* b, uint32_t* next, GsEmitter* e, uint32_t vertex) {
+    if (e->length >= 2) {
+        int odd = (e->length - 2) & 1;
+        const uint32_t tri[3] = {
+            odd ? e->strip[1] : e->strip[0],
+            odd ? e->strip[0] : e->strip[1],
+            vertex,
+        };
+
+        for (uint32_t k = 0; k < 3; k++) {
+            uint32_t index = (*next)++;
+            uint32_t ptr = (*next)++;
+
+            SPV(b, 128, idUint, index, e->base, idU0 + e->written + k);
+            SPV(b, 65, idPtrVec4, ptr, idScratch, idU0, index);     // OpAccessChain
+            SPV(b, 62, ptr, tri[k]);
+        }
+
+        e->written += 3;
+    }
+
+    e->strip[0] = e->strip[1];
+    e->strip[1] = vertex;
+    e->length += 1;
+}
+
+static void gs_cut(GsEmitter* e) {
+    e->length = 0;
+}
+
+/*
+ * GLSL equivalent, p = gl_GlobalInvocationID.x:
+ *
+ *   GS:      if (p < primitiveCount) {
+ *              uint q = firstPrimitive + p;
+ *              vec4 v[3] = vertices[3 * q + k];          // identity VS
+ *              bool emitted = program != CULL || (q & 1) == 0;
+ *              if (emitted) { emit v0, v1, v2 }
+ *              if (program == AMPLIFY) {
+ *                cut; a, b, c = v + (0, 1, 0, 0); d = b + c - a;
+ *                emit a, b, c, d                          // 2 triangles
+ *              }
+ *              counts[p] = (emitted ? 3 : 0) + (program == AMPLIFY ? 6 : 0);
+ *            }
+ *   SUM:     if (p < blockCount) blockSums[p] = sum of the block's counts
+ *   SCAN:    if (p == 0) { exclusive scan of blockSums;
+ *              indirect[indirectIndex] = { total, 1, firstVertex, 0 } }
+ *   COMPACT: if (p < primitiveCount) {
+ *              uint o = blockSums[p / 64] + counts of the block before p;
+ *              ring[firstVertex + o + k] = scratch[p * slotVertices + k]
+ *                for k < counts[p]
+ *            }
+ *
+ * Storage writes are not ordered between invocations, so each pass
+ * is its own dispatch.
+ */
+static SpirvBuffer make_gs_prepass(void) {
+    uint32_t next = idFirst;
+    SpirvBuffer b = { NULL, 0, 0 };
+
+    spv_header(&b);
+    SPV(&b, 15, 5, idMain, 0x6e69616du, 0, idGid);          // OpEntryPoint GLCompute "main"
+    SPV(&b, 16, idMain, 17, 64, 1, 1);                      // OpExecutionMode LocalSize 64 1 1
+
+    // Decorations
+    SPV(&b, 71, idGid, 11, 28);                             // BuiltIn GlobalInvocationId
+    SPV(&b, 71, idVec4Array, 6, 16);                        // ArrayStride 16
+    SPV(&b, 71, idUintArray, 6, 4);                         // ArrayStride 4
+    SPV(&b, 71, idVec4Struct, 3);                           // BufferBlock
+    SPV(&b, 72, idVec4Struct, 0, 35, 0);                    // OpMemberDecorate Offset
+    SPV(&b, 71, idUintStruct, 3);
+    SPV(&b, 72, idUintStruct, 0, 35, 0);
+    SPV(&b, 71, idArgsStruct, 2);                           // Block
+    for (uint32_t i = 0; i < 8; i++)
+        SPV(&b, 72, idArgsStruct, i, 35, 4 * i);
+
+    const uint32_t vars[] = { idVertices, idScratch, idCounts, idBlockSums, idRing, idIndirect };
+    for (uint32_t i = 0; i < COUNT(vars); i++) {
+        SPV(&b, 71, vars[i], 34, 0);                        // DescriptorSet 0
+        SPV(&b, 71, vars[i], 33, i);                        // Binding i
+    }
+
+    // Types, constants, variables
+    SPV(&b, 19, idVoid);                                    // OpTypeVoid
+    SPV(&b, 33, idFnVoid, idVoid);                          // OpTypeFunction
+    SPV(&b, 20, idBool);                                    // OpTypeBool
+    SPV(&b, 21, idUint, 32, 0);                             // OpTypeInt 32 unsigned
+    SPV(&b, 22, idFloat, 32);                               // OpTypeFloat 32
+    SPV(&b, 23, idVec4, idFloat, 4);                        // OpTypeVector
+    SPV(&b, 23, idUvec3, idUint, 3);
+    SPV(&b, 29, idVec4Array, idVec4);                       // OpTypeRuntimeArray
+    SPV(&b, 29, idUintArray, idUint);
+    SPV(&b, 30, idVec4Struct, idVec4Array);                 // OpTypeStruct
+    SPV(&b, 30, idUintStruct, idUintArray);
+    SPV(&b, 30, idArgsStruct, idUint, idUint, idUint, idUint, idUint, idUint, idUint, idUint);
+    SPV(&b, 32, idPtrVec4Struct, 2, idVec4Struct);          // OpTypePointer Uniform
+    SPV(&b, 32, idPtrUintStruct, 2, idUintStruct);
+    SPV(&b, 32, idPtrArgsStruct, 9, idArgsStruct);          // PushConstant
+    SPV(&b, 32, idPtrVec4, 2, idVec4);
+    SPV(&b, 32, idPtrUint, 2, idUint);
+    SPV(&b, 32, idPtrPcUint, 9, idUint);
+    SPV(&b, 32, idPtrInputUvec3, 1, idUvec3);               // Input
+    SPV(&b, 32, idPtrFnUint, 7, idUint);                    // Function
+
+    // 0 to 8, enough for every slot offset the emits use
+    const uint32_t u[] = { idU0, idU1, idU2, idU3, idU4, idU5, idU6, idU7, idU8 };
+    for (uint32_t i = 0; i < COUNT(u); i++)
+        SPV(&b, 43, idUint, u[i], i);                       // OpConstant
+    SPV(&b, 43, idUint, idU64, SCAN_BLOCK_SIZE);
+    SPV(&b, 43, idFloat, idF0, 0x00000000u);
+    SPV(&b, 43, idFloat, idF1, 0x3f800000u);
+    SPV(&b, 44, idVec4, idShift, idF0, idF1, idF0, idF0);   // OpConstantComposite
+
+    SPV(&b, 59, idPtrVec4Struct, idVertices, 2);            // OpVariable Uniform
+    SPV(&b, 59, idPtrVec4Struct, idScratch, 2);
+    SPV(&b, 59, idPtrUintStruct, idCounts, 2);
+    SPV(&b, 59, idPtrUintStruct, idBlockSums, 2);
+    SPV(&b, 59, idPtrVec4Struct, idRing, 2);
+    SPV(&b, 59, idPtrUintStruct, idIndirect, 2);
+    SPV(&b, 59, idPtrArgsStruct, idArgs, 9);
+    SPV(&b, 59, idPtrInputUvec3, idGid, 1);
+
+    // Instruction helpers, results get the next id
+    #define ID(name) uint32_t name = next++
+    #define LOAD_ARG(name, member) \
+        ID(name##Ptr); SPV(&b, 65, idPtrPcUint, name##Ptr, idArgs, u[member]); \
+        ID(name); SPV(&b, 61, idUint, name, name##Ptr)
+    #define LOAD_UINT(name, buffer, index) \
+        ID(name##Ptr); SPV(&b, 65, idPtrUint, name##Ptr, buffer, idU0, index); \
+        ID(name); SPV(&b, 61, idUint, name, name##Ptr)
+    #define STORE_UINT(buffer, index, value) do { \
+        ID(_ptr); SPV(&b, 65, idPtrUint, _ptr, buffer, idU0, index); \
+        SPV(&b, 62, _ptr, value); \
+    } while(0)
+    #define SELECTION(cond, body, merge) \
+        SPV(&b, 247, merge, 0); \
+        SPV(&b, 250, cond, body, merge); \
+        SPV(&b, 248, body)
+    #define END_SELECTION(merge) \
+        SPV(&b, 249, merge); \
+        SPV(&b, 248, merge)
+
+    ID(lEntry);
+    ID(iVar); ID(accVar);
+
+    SPV(&b, 54, idVoid, idMain, 0, idFnVoid);               // OpFunction
+    SPV(&b, 248, lEntry);
+    SPV(&b, 59, idPtrFnUint, iVar, 7);                      // OpVariable Function
+    SPV(&b, 59, idPtrFnUint, accVar, 7);
+    ID(gid); SPV(&b, 61, idUvec3, gid, idGid);
+    ID(p); SPV(&b, 81, idUint, p, gid, 0);                  // OpCompositeExtract
+    LOAD_ARG(pass, 0);
+    LOAD_ARG(program, 1);
+    LOAD_ARG(count, 2);
+    LOAD_ARG(slot, 3);
+    LOAD_ARG(firstVertex, 4);
+    LOAD_ARG(blockCount, 5);
+    LOAD_ARG(firstPrimitive, 6);
+    LOAD_ARG(indirectIndex, 7);
+    ID(inRange); SPV(&b, 176, idBool, inRange, p, count);
+
+    // Stage
+    ID(lGs); ID(lGsEnd);
+    ID(isGs); SPV(&b, 170, idBool, isGs, pass, idU0);       // OpIEqual
+    ID(doGs); SPV(&b, 167, idBool, doGs, isGs, inRange);    // OpLogicalAnd
+    SELECTION(doGs, lGs, lGsEnd);
+
+    ID(q); SPV(&b, 128, idUint, q, firstPrimitive, p);
+    ID(q3); SPV(&b, 132, idUint, q3, q, idU3);              // OpIMul
+    uint32_t v[3];
+
+    for (uint32_t k = 0; k < 3; k++) {
+        ID(index); SPV(&b, 128, idUint, index, q3, u[k]);
+        ID(ptr); SPV(&b, 65, idPtrVec4, ptr, idVertices, idU0, index);
+        v[k] = next++;
+        SPV(&b, 61, idVec4, v[k], ptr);
+    }
+
+    ID(slotBase); SPV(&b, 132, idUint, slotBase, p, slot);
+    ID(isCull); SPV(&b, 170, idBool, isCull, program, idU1);
+    ID(odd); SPV(&b, 199, idUint, odd, q, idU1);            // OpBitwiseAnd
+    ID(isOdd); SPV(&b, 170, idBool, isOdd, odd, idU1);
+    ID(culled); SPV(&b, 167, idBool, culled, isCull, isOdd);
+    ID(emitted); SPV(&b, 168, idBool, emitted, culled);     // OpLogicalNot
+    ID(isAmplify); SPV(&b, 170, idBool, isAmplify, program, idU2);
+
+    GsEmitter emitter = { { 0, 0 }, 0, 0, slotBase };
+
+    ID(lEmit); ID(lEmitEnd);
+    SELECTION(emitted, lEmit, lEmitEnd);
+    for (uint32_t k = 0; k < 3; k++)
+        gs_emit(&b, &next, &emitter, v[k]);
+    END_SELECTION(lEmitEnd);
+
+    ID(lAmplify); ID(lAmplifyEnd);
+    SELECTION(isAmplify, lAmplify, lAmplifyEnd);
+    gs_cut(&emitter);
+
+    uint32_t shifted[3];
+    for (uint32_t k = 0; k < 3; k++) {
+        shifted[k] = next++;
+        SPV(&b, 129, idVec4, shifted[k], v[k], idShift);    // OpFAdd
+    }
+
+    ID(bc); SPV(&b, 129, idVec4, bc, shifted[1], shifted[2]);
+    ID(d); SPV(&b, 131, idVec4, d, bc, shifted[0]);         // OpFSub
+
+    for (uint32_t k = 0; k < 3; k++)
+        gs_emit(&b, &next, &emitter, shifted[k]);
+    gs_emit(&b, &next, &emitter, d);
+    END_SELECTION(lAmplifyEnd);
+
+    ID(baseCount); SPV(&b, 169, idUint, baseCount, emitted, idU3, idU0);        // OpSelect
+    ID(extraCount); SPV(&b, 169, idUint, extraCount, isAmplify, idU6, idU0);
+    ID(listCount); SPV(&b, 128, idUint, listCount, baseCount, extraCount);
+    STORE_UINT(idCounts, p, listCount);
+    END_SELECTION(lGsEnd);
+
+    // Block sums
+    ID(lSum); ID(lSumEnd);
+    ID(isSum); SPV(&b, 170, idBool, isSum, pass, idU1);
+    ID(blockInRange); SPV(&b, 176, idBool, blockInRange, p, blockCount);
+    ID(doSum); SPV(&b, 167, idBool, doSum, isSum, blockInRange);
+    SELECTION(doSum, lSum, lSumEnd);
+
+    ID(sumStart); SPV(&b, 132, idUint, sumStart, p, idU64);
+    ID(remaining); SPV(&b, 130, idUint, remaining, count, sumStart);           // OpISub
+    ID(partial); SPV(&b, 176, idBool, partial, remaining, idU64);
+    ID(sumLength); SPV(&b, 169, idUint, sumLength, partial, remaining, idU64);
+    SPV(&b, 62, iVar, idU0);
+    SPV(&b, 62, accVar, idU0);
+
+    SpvLoop sumLoop = spv_loop_begin(&b, &next, iVar, sumLength);
+    ID(sumIndex); SPV(&b, 128, idUint, sumIndex, sumStart, sumLoop.i);
+    LOAD_UINT(sumCount, idCounts, sumIndex);
+    ID(sumAcc); SPV(&b, 61, idUint, sumAcc, accVar);
+    ID(sumNext); SPV(&b, 128, idUint, sumNext, sumAcc, sumCount);
+    SPV(&b, 62, accVar, sumNext);
+    spv_loop_end(&b, &next, &sumLoop, iVar);
+
+    ID(blockSum); SPV(&b, 61, idUint, blockSum, accVar);
+    STORE_UINT(idBlockSums, p, blockSum);
+    END_SELECTION(lSumEnd);
+
+    // Block scan and draw arguments
+    ID(lScan); ID(lScanEnd);
+    ID(isScan); SPV(&b, 170, idBool, isScan, pass, idU2);
+    ID(isFirst); SPV(&b, 170, idBool, isFirst, p, idU0);
+    ID(doScan); SPV(&b, 167, idBool, doScan, isScan, isFirst);
+    SELECTION(doScan, lScan, lScanEnd);
+
+    SPV(&b, 62, iVar, idU0);
+    SPV(&b, 62, accVar, idU0);
+
+    SpvLoop scanLoop = spv_loop_begin(&b, &next, iVar, blockCount);
+    LOAD_UINT(scanSum, idBlockSums, scanLoop.i);
+    ID(scanAcc); SPV(&b, 61, idUint, scanAcc, accVar);
+    STORE_UINT(idBlockSums, scanLoop.i, scanAcc);
+    ID(scanNext); SPV(&b, 128, idUint, scanNext, scanAcc, scanSum);
+    SPV(&b, 62, accVar, scanNext);
+    spv_loop_end(&b, &next, &scanLoop, iVar);
+
+    ID(total); SPV(&b, 61, idUint, total, accVar);
+    ID(argsBase); SPV(&b, 132, idUint, argsBase, indirectIndex, idU4);
+    const uint32_t drawArgs[4] = { total, idU1, firstVertex, idU0 };
+
+    for (uint32_t i = 0; i < 4; i++) {
+        ID(argIndex); SPV(&b, 128, idUint, argIndex, argsBase, u[i]);
+        STORE_UINT(idIndirect, argIndex, drawArgs[i]);
+    }
+
+    END_SELECTION(lScanEnd);
+
+    // Compaction
+    ID(lCompact); ID(lCompactEnd);
+    ID(isCompact); SPV(&b, 170, idBool, isCompact, pass, idU3);
+    ID(doCompact); SPV(&b, 167, idBool, doCompact, isCompact, inRange);
+    SELECTION(doCompact, lCompact, lCompactEnd);
+
+    ID(block); SPV(&b, 134, idUint, block, p, idU64);       // OpUDiv
+    ID(blockStart); SPV(&b, 132, idUint, blockStart, block, idU64);
+    LOAD_UINT(blockOffset, idBlockSums, block);
+    SPV(&b, 62, iVar, blockStart);
+    SPV(&b, 62, accVar, blockOffset);
+
+    SpvLoop prefixLoop = spv_loop_begin(&b, &next, iVar, p);
+    LOAD_UINT(prefixCount, idCounts, prefixLoop.i);
+    ID(prefixAcc); SPV(&b, 61, idUint, prefixAcc, accVar);
+    ID(prefixNext); SPV(&b, 128, idUint, prefixNext, prefixAcc, prefixCount);
+    SPV(&b, 62, accVar, prefixNext);
+    spv_loop_end(&b, &next, &prefixLoop, iVar);
+
+    ID(offset); SPV(&b, 61, idUint, offset, accVar);
+    ID(dstBase); SPV(&b, 128, idUint, dstBase, firstVertex, offset);
+    ID(srcBase); SPV(&b, 132, idUint, srcBase, p, slot);
+    LOAD_UINT(copyCount, idCounts, p);
+    SPV(&b, 62, iVar, idU0);
+
+    SpvLoop copyLoop = spv_loop_begin(&b, &next, iVar, copyCount);
+    ID(srcIndex); SPV(&b, 128, idUint, srcIndex, srcBase, copyLoop.i);
+    ID(dstIndex); SPV(&b, 128, idUint, dstIndex, dstBase, copyLoop.i);
+    ID(srcPtr); SPV(&b, 65, idPtrVec4, srcPtr, idScratch, idU0, srcIndex);
+    ID(value); SPV(&b, 61, idVec4, value, srcPtr);
+    ID(dstPtr); SPV(&b, 65, idPtrVec4, dstPtr, idRing, idU0, dstIndex);
+    SPV(&b, 62, dstPtr, value);
+    spv_loop_end(&b, &next, &copyLoop, iVar);
+
+    END_SELECTION(lCompactEnd);
+
+    #undef END_SELECTION
+    #undef SELECTION
+    #undef STORE_UINT
+    #undef LOAD_UINT
+    #undef LOAD_ARG
+    #undef ID
+
+    spv_end(&b, next);
+    return b;
+}
+
+/*
+ * Vertex stage of the ring draw and the fast path: forwards
+ * location 0 to gl_Position
+ */
+static SpirvBuffer make_vertex_shader(void) {
+    enum {
+        vsVoid = 1, vsFnVoid, vsFloat, vsVec4, vsUint, vsU0, vsPerVertex,
+        vsPtrInVec4, vsPtrOutPerVertex, vsPtrOutVec4, vsIn, vsOut, vsMain,
+        vsEntry, vsPos, vsPtr, vsBound
+    };
+
+    SpirvBuffer b = { NULL, 0, 0 };
+
+    spv_header(&b);
+    SPV(&b, 15, 0, vsMain, 0x6e69616du, 0, vsIn, vsOut);    // OpEntryPoint Vertex "main"
+    SPV(&b, 71, vsIn, 30, 0);                               // Location 0
+    SPV(&b, 71, vsPerVertex, 2);                            // Block
+    SPV(&b, 72, vsPerVertex, 0, 11, 0);                     // BuiltIn Position
+    SPV(&b, 19, vsVoid);
+    SPV(&b, 33, vsFnVoid, vsVoid);
+    SPV(&b, 22, vsFloat, 32);
+    SPV(&b, 23, vsVec4, vsFloat, 4);
+    SPV(&b, 21, vsUint, 32, 0);
+    SPV(&b, 43, vsUint, vsU0, 0);
+    SPV(&b, 30, vsPerVertex, vsVec4);
+    SPV(&b, 32, vsPtrInVec4, 1, vsVec4);                    // Input
+    SPV(&b, 32, vsPtrOutPerVertex, 3, vsPerVertex);         // Output
+    SPV(&b, 32, vsPtrOutVec4, 3, vsVec4);
+    SPV(&b, 59, vsPtrInVec4, vsIn, 1);
+    SPV(&b, 59, vsPtrOutPerVertex, vsOut, 3);
+    SPV(&b, 54, vsVoid, vsMain, 0, vsFnVoid);
+    SPV(&b, 248, vsEntry);
+    SPV(&b, 61, vsVec4, vsPos, vsIn);
+    SPV(&b, 65, vsPtrOutVec4, vsPtr, vsOut, vsU0);
+    SPV(&b, 62, vsPtr, vsPos);
+    spv_end(&b, vsBound);
+    return b;
+}
+
+/* Fragment stage: white */
+static SpirvBuffer make_fragment_shader(void) {
+    enum {
+        fsVoid = 1, fsFnVoid, fsFloat, fsVec4, fsF1, fsWhite, fsPtrOutVec4,
+        fsOut, fsMain, fsEntry, fsBound
+    };
+
+    SpirvBuffer b = { NULL, 0, 0 };
+
+    spv_header(&b);
+    SPV(&b, 15, 4, fsMain, 0x6e69616du, 0, fsOut);          // OpEntryPoint Fragment "main"
+    SPV(&b, 16, fsMain, 7);                                 // OriginUpperLeft
+    SPV(&b, 71, fsOut, 30, 0);                              // Location 0
+    SPV(&b, 19, fsVoid);
+    SPV(&b, 33, fsFnVoid, fsVoid);
+    SPV(&b, 22, fsFloat, 32);
+    SPV(&b, 23, fsVec4, fsFloat, 4);
+    SPV(&b, 43, fsFloat, fsF1, 0x3f800000u);
+    SPV(&b, 44, fsVec4, fsWhite, fsF1, fsF1, fsF1, fsF1);
+    SPV(&b, 32, fsPtrOutVec4, 3, fsVec4);
+    SPV(&b, 59, fsPtrOutVec4, fsOut, 3);
+    SPV(&b, 54, fsVoid, fsMain, 0, fsFnVoid);
+    SPV(&b, 248, fsEntry);
+    SPV(&b, 62, fsOut, fsWhite);
+    spv_end(&b, fsBound);
+    return b;
+}
+
+/* ============================================
+ * Emulation state
+ * ============================================ */
+typedef struct {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* data;
+} HostBuffer;
+
+static VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+static VkPipelineLayout prepassLayout = VK_NULL_HANDLE;
+static VkPipelineLayout drawLayout = VK_NULL_HANDLE;
+static VkPipeline prepassPipeline = VK_NULL_HANDLE;
+static VkPipeline drawPipeline = VK_NULL_HANDLE;
+static VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+static VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+static VkRenderPass clearPass = VK_NULL_HANDLE;
+static VkRenderPass loadPass = VK_NULL_HANDLE;
+static VkImage target = VK_NULL_HANDLE;
+static VkDeviceMemory targetMemory = VK_NULL_HANDLE;
+static VkImageView targetView = VK_NULL_HANDLE;
+static VkFramebuffer framebuffer = VK_NULL_HANDLE;
+static VkCommandPool commandPool = VK_NULL_HANDLE;
+static VkCommandBuffer cmd = VK_NULL_HANDLE;
+static VkFence fence = VK_NULL_HANDLE;
+
+static HostBuffer vertexBuffer, scratchBuffer, countBuffer, blockSumBuffer;
+static HostBuffer ringBuffer, indirectBuffer, readbackBuffer;
+
+/*
+ * What DxvkGsEmulation plans, with the limits of one test. Every
+ * test is one command list, so ranges only ever overlap ranges of
+ * the same list.
+ */
+typedef struct {
+    uint32_t firstPrimitive;
+    uint32_t primitiveCount;
+    uint32_t blockCount;
+    uint32_t firstVertex;
+    int barrier;
+} GsBatch;
+
+typedef struct {
+    uint32_t begin;
+    uint32_t end;
+} GsRange;
+
+static uint32_t scratchLimit = SCRATCH_SIZE;
+static uint32_t ringLimit = RING_SIZE;
+static uint32_t ringHead = 0;
+static GsRange ringRanges[MAX_BATCHES];
+static uint32_t ringRangeCount = 0;
+
+static uint32_t slot_vertices(uint32_t program) {
+    return (gsMaxVertexCount[program] - 2) * 3;
+}
+
+static int is_passthrough(uint32_t program) {
+    return program == GS_PASSTHROUGH;
+}
+
+enum {
+    PATH_PASSTHROUGH,
+    PATH_COMPUTE,
+    PATH_UNSUPPORTED,       // draw is skipped
+};
+
+static uint32_t skippedDraws = 0;
+
+/*
+ * As DxvkGsEmulation::selectPath. A stage that writes the layer
+ * never takes the fast path, and the ring draw can only write it
+ * from the vertex stage, which needs shaderOutputLayer.
+ */
+static uint32_t select_path(uint32_t program, int exportsLayer) {
+    if (is_passthrough(program) && !exportsLayer)
+        return PATH_PASSTHROUGH;
+
+    if (exportsLayer && !outputLayer)
+        return PATH_UNSUPPORTED;
+
+    return PATH_COMPUTE;
+}
+
+static uint32_t plan_draw(uint32_t program, uint32_t primitiveCount, GsBatch* batches) {
+    uint32_t slotBytes = slot_vertices(program) * VERTEX_BYTES;
+    uint32_t limit = scratchLimit / slotBytes;
+
+    if (limit > ringLimit / slotBytes)
+        limit = ringLimit / slotBytes;
+    if (limit > SCAN_BLOCK_SIZE * MAX_SCAN_BLOCKS)
+        limit = SCAN_BLOCK_SIZE * MAX_SCAN_BLOCKS;
+
+    uint32_t batchCount = 0;
+
+    for (uint32_t first = 0; first < primitiveCount && batchCount < MAX_BATCHES; first += limit) {
+        GsBatch* batch = &batches[batchCount++];
+        batch->firstPrimitive = first;
+        batch->primitiveCount = primitiveCount - first < limit ? primitiveCount - first : limit;
+        batch->blockCount = (batch->primitiveCount + SCAN_BLOCK_SIZE - 1) / SCAN_BLOCK_SIZE;
+
+        uint32_t size = batch->primitiveCount * slotBytes;
+        uint32_t begin = ringHead;
+
+        if (begin + size > ringLimit)
+            begin = 0;
+
+        batch->barrier = 0;
+
+        for (uint32_t i = 0; i < ringRangeCount; i++) {
+            if (ringRanges[i].begin < begin + size && ringRanges[i].end > begin)
+                batch->barrier = 1;
+        }
+
+        if (ringRangeCount < MAX_BATCHES)
+            ringRanges[ringRangeCount++] = (GsRange) { begin, begin + size };
+
+        ringHead = begin + size;
+        batch->firstVertex = begin / VERTEX_BYTES;
+    }
+
+    return batchCount;
+}
+
+static int find_memory_type(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* index) {
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int create_host_buffer(VkDeviceSize size, HostBuffer* buffer) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+               | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+               | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+               | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+               | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    TEST_VK(vkCreateBuffer(device, &bufferInfo, NULL, &buffer->buffer));
+
+    VkMemoryRequirements req;
+    vkGetBufferMemoryRequirements(device, buffer->buffer, &req);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = req.size,
+    };
+
+    TEST_ASSERT(find_memory_type(req.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &allocInfo.memoryTypeIndex), "No host visible memory");
+
+    TEST_VK(vkAllocateMemory(device, &allocInfo, NULL, &buffer->memory));
+    TEST_VK(vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0));
+    TEST_VK(vkMapMemory(device, buffer->memory, 0, size, 0, &buffer->data));
+    return 1;
+}
+
+static void destroy_host_buffer(HostBuffer* buffer) {
+    if (buffer->buffer) vkDestroyBuffer(device, buffer->buffer, NULL);
+    if (buffer->memory) vkFreeMemory(device, buffer->memory, NULL);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static int create_shader(SpirvBuffer code, VkShaderModule* module) {
+    VkShaderModuleCreateInfo moduleInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = code.count * sizeof(uint32_t),
+        .pCode = code.words,
+    };
+
+    VkResult result = vkCreateShaderModule(device, &moduleInfo, NULL, module);
+    free(code.words);
+    TEST_VK(result);
+    return 1;
+}
+
+static int create_render_pass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkRenderPass* pass) {
+    VkAttachmentDescription attachment = {
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = loadOp,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .initialLayout = initialLayout,
+        .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    };
+
+    VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorRef,
+    };
+
+    // Draws of earlier batches
+    VkSubpassDependency dependency = {
+        .srcSubpass = VK_SUBPASS_EXTERNAL,
+        .dstSubpass = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+    };
+
+    VkRenderPassCreateInfo passInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &attachment,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = 1,
+        .pDependencies = &dependency,
+    };
+
+    TEST_VK(vkCreateRenderPass(device, &passInfo, NULL, pass));
+    return 1;
+}
+
+static int setup_target(void) {
+    TEST_ASSERT(create_render_pass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, &clearPass), "Clear pass");
+    TEST_ASSERT(create_render_pass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, &loadPass), "Load pass");
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = { TARGET_SIZE, TARGET_SIZE, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    TEST_VK(vkCreateImage(device, &imageInfo, NULL, &target));
+
+    VkMemoryRequirements req;
+    vkGetImageMemoryRequirements(device, target, &req);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = req.size,
+    };
+
+    TEST_ASSERT(find_memory_type(req.memoryTypeBits, 0, &allocInfo.memoryTypeIndex), "No image memory");
+    TEST_VK(vkAllocateMemory(device, &allocInfo, NULL, &targetMemory));
+    TEST_VK(vkBindImageMemory(device, target, targetMemory, 0));
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = target,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+    };
+
+    TEST_VK(vkCreateImageView(device, &viewInfo, NULL, &targetView));
+
+    VkFramebufferCreateInfo framebufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = clearPass,
+        .attachmentCount = 1,
+        .pAttachments = &targetView,
+        .width = TARGET_SIZE,
+        .height = TARGET_SIZE,
+        .layers = 1,
+    };
+
+    TEST_VK(vkCreateFramebuffer(device, &framebufferInfo, NULL, &framebuffer));
+    return 1;
+}
+
+static int setup_draw_pipeline(void) {
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    };
+
+    TEST_VK(vkCreatePipelineLayout(device, &layoutInfo, NULL, &drawLayout));
+
+    VkShaderModule vs, fs;
+    TEST_ASSERT(create_shader(make_vertex_shader(), &vs), "Vertex shader");
+
+    if (!create_shader(make_fragment_shader(), &fs)) {
+        vkDestroyShaderModule(device, vs, NULL);
+        return 0;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vs,
+            .pName = "main",
+        }, {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fs,
+            .pName = "main",
+        },
+    };
+
+    VkVertexInputBindingDescription binding = { 0, VERTEX_BYTES, VK_VERTEX_INPUT_RATE_VERTEX };
+    VkVertexInputAttributeDescription attribute = { 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0 };
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = 1,
+        .pVertexAttributeDescriptions = &attribute,
+    };
+
+    // The ring is always a list, strips were assembled by the pre-pass
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+
+    VkViewport viewport = { 0.0f, 0.0f, TARGET_SIZE, TARGET_SIZE, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { TARGET_SIZE, TARGET_SIZE } };
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = &viewport,
+        .scissorCount = 1,
+        .pScissors = &scissor,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {
+        .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                        | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blendAttachment,
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertexInput,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterization,
+        .pMultisampleState = &multisample,
+        .pColorBlendState = &blend,
+        .layout = drawLayout,
+        .renderPass = clearPass,
+    };
+
+    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &drawPipeline);
+    vkDestroyShaderModule(device, vs, NULL);
+    vkDestroyShaderModule(device, fs, NULL);
+    TEST_VK(result);
+    return 1;
+}
+
+static int setup_emulation(void) {
+    VkDescriptorSetLayoutBinding bindings[6];
+
+    for (uint32_t i = 0; i < 6; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 6,
+        .pBindings = bindings,
+    };
+
+    TEST_VK(vkCreateDescriptorSetLayout(device, &setLayoutInfo, NULL, &setLayout));
+
+    VkPushConstantRange pushRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(GsArgs),
+    };
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushRange,
+    };
+
+    TEST_VK(vkCreatePipelineLayout(device, &layoutInfo, NULL, &prepassLayout));
+
+    VkShaderModule module;
+    TEST_ASSERT(create_shader(make_gs_prepass(), &module), "Pre-pass shader");
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+        },
+        .layout = prepassLayout,
+    };
+
+    VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &prepassPipeline);
+    vkDestroyShaderModule(device, module, NULL);
+    TEST_VK(result);
+
+    TEST_ASSERT(setup_target(), "Render target");
+    TEST_ASSERT(setup_draw_pipeline(), "Draw pipeline");
+
+    TEST_ASSERT(create_host_buffer(BENCH_TRIANGLES * 3 * VERTEX_BYTES, &vertexBuffer), "Vertex buffer");
+    TEST_ASSERT(create_host_buffer(SCRATCH_SIZE, &scratchBuffer), "Scratch buffer");
+    TEST_ASSERT(create_host_buffer(SCAN_BLOCK_SIZE * MAX_SCAN_BLOCKS * 4, &countBuffer), "Count buffer");
+    TEST_ASSERT(create_host_buffer(MAX_SCAN_BLOCKS * 4, &blockSumBuffer), "Block sum buffer");
+    TEST_ASSERT(create_host_buffer(RING_SIZE, &ringBuffer), "Ring buffer");
+    TEST_ASSERT(create_host_buffer(MAX_BATCHES * sizeof(VkDrawIndirectCommand), &indirectBuffer), "Indirect buffer");
+    TEST_ASSERT(create_host_buffer(TARGET_SIZE * TARGET_SIZE * 4, &readbackBuffer), "Readback buffer");
+
+    // Triangle (1,1) (7,1) (1,7) in pixels of each 8x8 cell, the
+    // grid repeats for the benchmark
+    float* vertices = vertexBuffer.data;
 
+    for (uint32_t q = 0; q < BENCH_TRIANGLES; q++) {
+        uint32_t cell = q % GRID_TRIANGLES;
+        float x = (float)(8 * (cell % GRID_COLUMNS) + 1);
+        float y = (float)(8 * (cell / GRID_COLUMNS) + 1);
+        const float corners[3][2] = { { x, y }, { x + 6.0f, y }, { x, y + 6.0f } };
+
+        for (uint32_t k = 0; k < 3; k++) {
+            float* v = vertices + 4 * (3 * q + k);
+            v[0] = corners[k][0] / (TARGET_SIZE / 2) - 1.0f;
+            v[1] = corners[k][1] / (TARGET_SIZE / 2) - 1.0f;
+            v[2] = 0.0f;
+            v[3] = 1.0f;
+        }
+    }
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 6,
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+    };
+
+    TEST_VK(vkCreateDescriptorPool(device, &poolInfo, NULL, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &setLayout,
+    };
+
+    TEST_VK(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet));
+
+    const HostBuffer* buffers[] = {
+        &vertexBuffer, &scratchBuffer, &countBuffer, &blockSumBuffer, &ringBuffer, &indirectBuffer,
+    };
+
+    VkDescriptorBufferInfo bufferInfos[6];
+    VkWriteDescriptorSet writes[6];
+
+    for (uint32_t i = 0; i < 6; i++) {
+        bufferInfos[i] = (VkDescriptorBufferInfo) { buffers[i]->buffer, 0, VK_WHOLE_SIZE };
+        writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfos[i],
+        };
+    }
+
+    vkUpdateDescriptorSets(device, 6, writes, 0, NULL);
+
+    VkCommandPoolCreateInfo commandPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+
+    TEST_VK(vkCreateCommandPool(device, &commandPoolInfo, NULL, &commandPool));
+
+    VkCommandBufferAllocateInfo cmdInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    TEST_VK(vkAllocateCommandBuffers(device, &cmdInfo, &cmd));
+
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+
+    TEST_VK(vkCreateFence(device, &fenceInfo, NULL, &fence));
+    return 1;
+}
+
+static void cleanup_emulation(void) {
+    if (!device) return;
+
+    if (fence) vkDestroyFence(device, fence, NULL);
+    if (commandPool) vkDestroyCommandPool(device, commandPool, NULL);
+    if (descriptorPool) vkDestroyDescriptorPool(device, descriptorPool, NULL);
+
+    destroy_host_buffer(&vertexBuffer);
+    destroy_host_buffer(&scratchBuffer);
+    destroy_host_buffer(&countBuffer);
+    destroy_host_buffer(&blockSumBuffer);
+    destroy_host_buffer(&ringBuffer);
+    destroy_host_buffer(&indirectBuffer);
+    destroy_host_buffer(&readbackBuffer);
+
+    if (framebuffer) vkDestroyFramebuffer(device, framebuffer, NULL);
+    if (targetView) vkDestroyImageView(device, targetView, NULL);
+    if (target) vkDestroyImage(device, target, NULL);
+    if (targetMemory) vkFreeMemory(device, targetMemory, NULL);
+    if (clearPass) vkDestroyRenderPass(device, clearPass, NULL);
+    if (loadPass) vkDestroyRenderPass(device, loadPass, NULL);
+
+    if (drawPipeline) vkDestroyPipeline(device, drawPipeline, NULL);
+    if (prepassPipeline) vkDestroyPipeline(device, prepassPipeline, NULL);
+    if (drawLayout) vkDestroyPipelineLayout(device, drawLayout, NULL);
+    if (prepassLayout) vkDestroyPipelineLayout(device, prepassLayout, NULL);
+    if (setLayout) vkDestroyDescriptorSetLayout(device, setLayout, NULL);
+}
+
+/* ============================================
+ * Recording
+ * ============================================ */
+static void barrier(VkPipelineStageFlags srcStages, VkPipelineStageFlags dstStages) {
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                       | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+                       | VK_ACCESS_HOST_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier(cmd, srcStages, dstStages, 0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+}
+
+static void dispatch(const GsArgs* args, uint32_t invocations) {
+    vkCmdPushConstants(cmd, prepassLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(*args), args);
+    vkCmdDispatch(cmd, (invocations + 63) / 64, 1, 1);
+    barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+      | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT);
+}
+
+static void begin_render_pass(VkRenderPass pass) {
+    VkClearValue clear = { .color = { .float32 = { 0.0f, 0.0f, 0.0f, 0.0f } } };
+
+    VkRenderPassBeginInfo passInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = pass,
+        .framebuffer = framebuffer,
+        .renderArea = { { 0, 0 }, { TARGET_SIZE, TARGET_SIZE } },
+        .clearValueCount = 1,
+        .pClearValues = &clear,
+    };
+
+    vkCmdBeginRenderPass(cmd, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+/*
+ * Command buffer in recording state with a cleared target and a
+ * fresh ring
+ */
+static int begin_frame(void) {
+    memset(ringBuffer.data, 0xff, RING_SIZE);
+    memset(indirectBuffer.data, 0, MAX_BATCHES * sizeof(VkDrawIndirectCommand));
+    ringHead = 0;
+    ringRangeCount = 0;
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    TEST_VK(vkResetCommandBuffer(cmd, 0));
+    TEST_VK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    begin_render_pass(clearPass);
+    vkCmdEndRenderPass(cmd);
+    return 1;
+}
+
+/*
+ * The pre-pass of each batch outside the render pass, then its
+ * draw, like the context records it
+ */
+static uint32_t record_prepass(uint32_t program, uint32_t primitiveCount, GsBatch* batches) {
+    VkDeviceSize zero = 0;
+    uint32_t batchCount = plan_draw(program, primitiveCount, batches);
+
+    for (uint32_t i = 0; i < batchCount; i++) {
+        const GsBatch* batch = &batches[i];
+
+        // The compaction overwrites a range an earlier draw reads
+        if (batch->barrier)
+            barrier(VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        GsArgs args = {
+            .program = program,
+            .primitiveCount = batch->primitiveCount,
+            .slotVertices = slot_vertices(program),
+            .firstVertex = batch->firstVertex,
+            .blockCount = batch->blockCount,
+            .firstPrimitive = batch->firstPrimitive,
+            .indirectIndex = i,
+        };
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, prepassPipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, prepassLayout, 0, 1, &descriptorSet, 0, NULL);
+
+        args.pass = PASS_GS;
+        dispatch(&args, batch->primitiveCount);
+        args.pass = PASS_BLOCK_SUM;
+        dispatch(&args, batch->blockCount);
+        args.pass = PASS_BLOCK_SCAN;
+        dispatch(&args, 1);
+        args.pass = PASS_COMPACT;
+        dispatch(&args, batch->primitiveCount);
+
+        begin_render_pass(loadPass);
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+        vkCmdBindVertexBuffers(cmd, 0, 1, &ringBuffer.buffer, &zero);
+        vkCmdDrawIndirect(cmd, indirectBuffer.buffer, i * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+        vkCmdEndRenderPass(cmd);
+    }
+
+    return batchCount;
+}
+
+/*
+ * A draw with the stage. Returns the number of pre-pass batches,
+ * zero for the fast path and for skipped draws.
+ */
+static uint32_t record_draw(uint32_t program, int exportsLayer, uint32_t primitiveCount, GsBatch* batches) {
+    uint32_t path = select_path(program, exportsLayer);
+
+    if (path == PATH_UNSUPPORTED) {
+        skippedDraws += 1;
+        return 0;
+    }
+
+    if (path == PATH_COMPUTE)
+        return record_prepass(program, primitiveCount, batches);
+
+    VkDeviceSize zero = 0;
+
+    begin_render_pass(loadPass);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+    vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer.buffer, &zero);
+    vkCmdDraw(cmd, 3 * primitiveCount, 1, 0, 0);
+    vkCmdEndRenderPass(cmd);
+    return 0;
+}
+
+/*
+ * Copies the target to readbackBuffer, submits and waits
+ */
+static int end_frame(void) {
+    VkImageMemoryBarrier imageBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = target,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+    };
+
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, NULL, 0, NULL, 1, &imageBarrier);
+
+    VkBufferImageCopy region = {
+        .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageExtent = { TARGET_SIZE, TARGET_SIZE, 1 },
+    };
+
+    vkCmdCopyImageToBuffer(cmd, target, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer.buffer, 1, &region);
+    barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT);
+
+    TEST_VK(vkEndCommandBuffer(cmd));
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+    };
+
+    TEST_VK(vkResetFences(device, 1, &fence));
+    TEST_VK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    TEST_VK(vkWaitForFences(device, 1, &fence, VK_TRUE, ~0ull));
+    return 1;
+}
+
+/* One draw of the grid, rendered and read back */
+static int render_grid(uint32_t program, int exportsLayer, GsBatch* batches, uint32_t* batchCount) {
+    TEST_ASSERT(begin_frame(), "Command buffer");
+    *batchCount = record_draw(program, exportsLayer, GRID_TRIANGLES, batches);
+    TEST_ASSERT(end_frame(), "Submit");
+    return 1;
+}
+
+static const VkDrawIndirectCommand* draw_args(uint32_t batch) {
+    return (const VkDrawIndirectCommand*)indirectBuffer.data + batch;
+}
+
+/* Vertices the draws of a frame read from the ring, in draw order */
+static uint32_t ring_vertices(const GsBatch* batches, uint32_t batchCount, float* out, uint32_t maxVertices) {
+    const float* ring = ringBuffer.data;
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < batchCount; i++) {
+        const VkDrawIndirectCommand* args = draw_args(i);
+
+        if (args->firstVertex != batches[i].firstVertex)
+            return ~0u;
+
+        for (uint32_t v = 0; v < args->vertexCount && count < maxVertices; v++, count++)
+            memcpy(out + 4 * count, ring + 4 * (args->firstVertex + v), VERTEX_BYTES);
+    }
+
+    return count;
+}
+
+static const float* input_vertex(uint32_t q, uint32_t k) {
+    return (const float*)vertexBuffer.data + 4 * (3 * q + k);
+}
+
+static int same_vertex(const float* v, const float* expected, float shift) {
+    return v[0] == expected[0] && v[1] == expected[1] + shift
+        && v[2] == expected[2] && v[3] == expected[3];
+}
+
+static int lit(uint32_t x, uint32_t y) {
+    const uint8_t* pixels = readbackBuffer.data;
+    return pixels[4 * (y * TARGET_SIZE + x)] == 0xff;
+}
+
+/*
+ * Checks pixels of grid cell q: inside the triangle, past its
+ * hypotenuse, and the same points 32 pixels lower
+ */
+static int check_cell(uint32_t q, int triangle, int quadBelow) {
+    uint32_t x = 8 * (q % GRID_COLUMNS);
+    uint32_t y = 8 * (q / GRID_COLUMNS);
+
+    return lit(x + 2, y + 2) == triangle
+        && !lit(x + 5, y + 5)
+        && lit(x + 2, y + 34) == quadBelow
+        && lit(x + 5, y + 37) == quadBelow
+        && !lit(x, y) && !lit(x, y + 32);
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* ============================================
+ * Test: Feature Supported
+ * ============================================ */
 int test_gs_feature_supported(void) {
     printf("TEST: gs_feature_supported\n");
-    
-    VkPhysicalDeviceFeatures features;
-    vkGetPhysicalDeviceFeatures(physicalDevice, &features);
-    
-    if (features.geometryShader) {
+
+    if (nativeGs)
         printf("  Geometry shaders: SUPPORTED\n");
-        return 1;
-    } else {
+    else
         printf("  Geometry shaders: NOT SUPPORTED\n");
-        printf("  This is what needs to be implemented!\n");
-        return 0;
-    }
+
+    // The emulation needs nothing beyond Vulkan 1.0 compute
+    TEST_ASSERT(prepassPipeline != VK_NULL_HANDLE, "Pre-pass not created");
+    TEST_ASSERT(drawPipeline != VK_NULL_HANDLE, "Ring draw pipeline not created");
+
+    if (!nativeGs)
+        printf("  Using the compute pre-pass\n");
+
+    printf("  PASSED\n");
+    return 1;
 }
 
+/* ============================================
+ * Test: Basic Passthrough
+ * ============================================ */
 int test_gs_basic_passthrough(void) {
     printf("TEST: gs_basic_passthrough\n");
-    
-    // A passthrough GS: input triangle, output triangle unchanged
-    // This is the simplest possible GS
-    
-    printf("  TODO: Implement passthrough GS test\n");
-    return 0;
+
+    // A stage that copies its input takes the fast path
+    TEST_ASSERT(is_passthrough(GS_PASSTHROUGH), "Passthrough stage not detected");
+
+    GsBatch batches[MAX_BATCHES];
+    uint32_t batchCount;
+
+    TEST_ASSERT(render_grid(GS_PASSTHROUGH, 0, batches, &batchCount), "Fast path");
+    TEST_ASSERT(batchCount == 0, "Fast path ran the pre-pass");
+
+    static uint8_t fastImage[TARGET_SIZE * TARGET_SIZE * 4];
+    memcpy(fastImage, readbackBuffer.data, sizeof(fastImage));
+
+    for (uint32_t q = 0; q < GRID_TRIANGLES; q++)
+        TEST_ASSERT(check_cell(q, 1, 0), "Fast path image");
+
+    // The same stage through the pre-pass must draw the same
+    TEST_ASSERT(begin_frame(), "Command buffer");
+    batchCount = record_prepass(GS_PASSTHROUGH, GRID_TRIANGLES, batches);
+    TEST_ASSERT(end_frame(), "Submit");
+    TEST_ASSERT(batchCount == 1, "Batch count");
+
+    TEST_ASSERT(draw_args(0)->vertexCount == 3 * GRID_TRIANGLES && draw_args(0)->instanceCount == 1, "Draw arguments");
+
+    static float ring[3 * GRID_TRIANGLES * 4];
+    TEST_ASSERT(ring_vertices(batches, 1, ring, 3 * GRID_TRIANGLES) == 3 * GRID_TRIANGLES, "Ring vertex count");
+
+    for (uint32_t q = 0; q < GRID_TRIANGLES; q++) {
+        for (uint32_t k = 0; k < 3; k++)
+            TEST_ASSERT(same_vertex(ring + 4 * (3 * q + k), input_vertex(q, k), 0.0f), "Ring vertex");
+    }
+
+    TEST_ASSERT(memcmp(fastImage, readbackBuffer.data, sizeof(fastImage)) == 0, "Pre-pass image differs from the fast path");
+
+    printf("  Fast path matches the pre-pass, %u triangles\n", GRID_TRIANGLES);
+    printf("  PASSED\n");
+    return 1;
 }
 
+/* ============================================
+ * Test: Amplification
+ * ============================================ */
 int test_gs_amplification(void) {
     printf("TEST: gs_amplification\n");
-    
-    // GS that outputs more primitives than input
-    // e.g., input 1 triangle, output 2 triangles
-    
-    printf("  TODO: Implement amplification test\n");
-    return 0;
+
+    // Scratch for 10 primitives, so the draw takes 4 batches
+    scratchLimit = 10 * slot_vertices(GS_AMPLIFY) * VERTEX_BYTES;
+
+    GsBatch batches[MAX_BATCHES];
+    uint32_t batchCount;
+    int rendered = render_grid(GS_AMPLIFY, 0, batches, &batchCount);
+    scratchLimit = SCRATCH_SIZE;
+
+    TEST_ASSERT(rendered, "Render");
+    TEST_ASSERT(batchCount == 4, "Batch count");
+
+    // Every input triangle makes 3: itself, then a quad strip
+    static float ring[9 * GRID_TRIANGLES * 4];
+    TEST_ASSERT(ring_vertices(batches, batchCount, ring, 9 * GRID_TRIANGLES) == 9 * GRID_TRIANGLES, "Ring vertex count");
+
+    for (uint32_t q = 0; q < GRID_TRIANGLES; q++) {
+        const float* out = ring + 4 * 9 * q;
+        const float* a = input_vertex(q, 0);
+        const float* b = input_vertex(q, 1);
+        const float* c = input_vertex(q, 2);
+        const float d[4] = { b[0] + c[0] - a[0], b[1] + c[1] - a[1], 0.0f, 1.0f };
+
+        TEST_ASSERT(same_vertex(out, a, 0.0f) && same_vertex(out + 4, b, 0.0f)
+                 && same_vertex(out + 8, c, 0.0f), "Input triangle");
+
+        // Strip (a, b, c, d): (a, b, c), then (c, b, d) to keep the winding
+        TEST_ASSERT(same_vertex(out + 12, a, 1.0f) && same_vertex(out + 16, b, 1.0f)
+                 && same_vertex(out + 20, c, 1.0f), "First strip triangle");
+        TEST_ASSERT(same_vertex(out + 24, c, 1.0f) && same_vertex(out + 28, b, 1.0f)
+                 && same_vertex(out + 32, d, 1.0f), "Second strip triangle");
+    }
+
+    for (uint32_t q = 0; q < GRID_TRIANGLES; q++)
+        TEST_ASSERT(check_cell(q, 1, 1), "Image");
+
+    printf("  %u triangles in, %u out, %u batches\n", GRID_TRIANGLES, 3 * GRID_TRIANGLES, batchCount);
+    printf("  PASSED\n");
+    return 1;
 }
 
+/* ============================================
+ * Test: Culling
+ * ============================================ */
 int test_gs_culling(void) {
     printf("TEST: gs_culling\n");
-    
-    // GS that outputs fewer primitives than input
-    // e.g., conditionally emit primitives
-    
-    printf("  TODO: Implement culling test\n");
-    return 0;
+
+    GsBatch batches[MAX_BATCHES];
+    uint32_t batchCount;
+
+    TEST_ASSERT(render_grid(GS_CULL, 0, batches, &batchCount), "Render");
+    TEST_ASSERT(batchCount == 1, "Batch count");
+
+    // Only even triangles, without gaps
+    TEST_ASSERT(draw_args(0)->vertexCount == 3 * GRID_TRIANGLES / 2, "Draw arguments");
+
+    static float ring[3 * GRID_TRIANGLES * 4];
+    TEST_ASSERT(ring_vertices(batches, batchCount, ring, 3 * GRID_TRIANGLES) == 3 * GRID_TRIANGLES / 2, "Ring vertex count");
+
+    for (uint32_t i = 0; i < GRID_TRIANGLES / 2; i++) {
+        for (uint32_t k = 0; k < 3; k++)
+            TEST_ASSERT(same_vertex(ring + 4 * (3 * i + k), input_vertex(2 * i, k), 0.0f), "Ring vertex");
+    }
+
+    for (uint32_t q = 0; q < GRID_TRIANGLES; q++)
+        TEST_ASSERT(check_cell(q, !(q & 1), 0), "Image");
+
+    printf("  %u triangles in, %u out\n", GRID_TRIANGLES, GRID_TRIANGLES / 2);
+    printf("  PASSED\n");
+    return 1;
 }
 
+/* ============================================
+ * Test: Layered Rendering
+ * ============================================ */
 int test_gs_layered_rendering(void) {
     printf("TEST: gs_layered_rendering\n");
-    
-    // GS that sets gl_Layer for layered framebuffers
-    
-    printf("  TODO: Implement layered rendering test\n");
-    return 0;
+
+    // A stage that copies its input but also sets gl_Layer for a
+    // layered framebuffer. The ring draw would have to write the
+    // layer from the vertex stage.
+    printf("  shaderOutputLayer: %s\n", outputLayer ? "SUPPORTED" : "NOT SUPPORTED");
+
+    GsBatch batches[MAX_BATCHES];
+    uint32_t batchCount;
+    uint32_t skipped = skippedDraws;
+
+    TEST_ASSERT(select_path(GS_PASSTHROUGH, 1) != PATH_PASSTHROUGH, "Layered stage took the fast path");
+    TEST_ASSERT(render_grid(GS_PASSTHROUGH, 1, batches, &batchCount), "Render");
+
+    if (!outputLayer) {
+        // Without vertex layer output the draw is skipped, not drawn to layer 0
+        TEST_ASSERT(select_path(GS_PASSTHROUGH, 1) == PATH_UNSUPPORTED, "Path without shaderOutputLayer");
+        TEST_ASSERT(skippedDraws == skipped + 1, "Skipped draw not counted");
+        TEST_ASSERT(batchCount == 0, "Skipped draw ran the pre-pass");
+
+        for (uint32_t q = 0; q < GRID_TRIANGLES; q++)
+            TEST_ASSERT(check_cell(q, 0, 0), "Skipped draw rendered");
+
+        printf("  Draw skipped, %u skipped draw(s)\n", skippedDraws);
+    } else {
+        // The pre-pass runs, the vertex stage of the ring draw writes
+        // the layer; this suite's target has a single layer
+        TEST_ASSERT(select_path(GS_PASSTHROUGH, 1) == PATH_COMPUTE, "Path with shaderOutputLayer");
+        TEST_ASSERT(skippedDraws == skipped && batchCount == 1, "Layered draw skipped");
+
+        for (uint32_t q = 0; q < GRID_TRIANGLES; q++)
+            TEST_ASSERT(check_cell(q, 1, 0), "Layered draw image");
+
+        printf("  Drawn through the pre-pass\n");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Throughput
+ * ============================================ */
+int test_gs_throughput(void) {
+    printf("TEST: gs_throughput\n");
+
+    // Output triangles per input triangle, times 2
+    static const struct {
+        uint32_t program;
+        int fastPath;
+        uint32_t outputRatio;
+    } cases[] = {
+        { GS_PASSTHROUGH, 1, 2 },
+        { GS_PASSTHROUGH, 0, 2 },
+        { GS_CULL,        0, 1 },
+        { GS_AMPLIFY,     0, 6 },
+    };
+
+    const uint32_t iterations = 5;
+
+    for (uint32_t i = 0; i < COUNT(cases); i++) {
+        GsBatch batches[MAX_BATCHES];
+        uint32_t batchCount = 0;
+        double best = 1e30;
+
+        // The first run warms up the driver
+        for (uint32_t n = 0; n <= iterations; n++) {
+            TEST_ASSERT(begin_frame(), "Command buffer");
+            double start = now_seconds();
+
+            batchCount = cases[i].fastPath
+                ? record_draw(cases[i].program, 0, BENCH_TRIANGLES, batches)
+                : record_prepass(cases[i].program, BENCH_TRIANGLES, batches);
+
+            TEST_ASSERT(end_frame(), "Submit");
+            double elapsed = now_seconds() - start;
+
+            if (n && elapsed < best)
+                best = elapsed;
+        }
+
+        uint32_t outputs = BENCH_TRIANGLES / 2 * cases[i].outputRatio;
+        uint32_t vertices = 0;
+
+        for (uint32_t b = 0; b < batchCount; b++)
+            vertices += draw_args(b)->vertexCount;
+
+        TEST_ASSERT(cases[i].fastPath || vertices == 3 * outputs, "Output vertex count");
+
+        printf("  %-11s %-9s %u batch(es)  %7.2f Mprim/s in  %7.2f Mprim/s out\n",
+               gsNames[cases[i].program], cases[i].fastPath ? "fast path" : "pre-pass", batchCount,
+               BENCH_TRIANGLES / best * 1e-6, outputs / best * 1e-6);
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Vulkan Setup
+ * ============================================ */
+static int has_instance_layer(const char* name) {
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, NULL);
+
+    VkLayerProperties* layers = malloc(layerCount * sizeof(VkLayerProperties));
+    vkEnumerateInstanceLayerProperties(&layerCount, layers);
+
+    int found = 0;
+    for (uint32_t i = 0; i < layerCount; i++) {
+        if (strcmp(layers[i].layerName, name) == 0)
+            found = 1;
+    }
+
+    free(layers);
+    return found;
 }
 
 int setup_vulkan(void) {
+    // Create instance
     VkApplicationInfo appInfo = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pApplicationName = "GS Test",
+        .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
+        .pEngineName = "Test",
+        .engineVersion = VK_MAKE_VERSION(1, 0, 0),
         .apiVersion = VK_API_VERSION_1_2,
     };
-    
+
+    const char* layers[] = { "VK_LAYER_KHRONOS_validation" };
+
+    // Validation if installed, software drivers often come without
     VkInstanceCreateInfo instanceInfo = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
         .pApplicationInfo = &appInfo,
+        .enabledLayerCount = has_instance_layer(layers[0]) ? 1 : 0,
+        .ppEnabledLayerNames = layers,
     };
-    
+
     if (vkCreateInstance(&instanceInfo, NULL, &instance) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create instance\n");
+        fprintf(stderr, "Failed to create Vulkan instance\n");
         return 0;
     }
-    
+
+    // Get physical device
     uint32_t deviceCount = 1;
     vkEnumeratePhysicalDevices(instance, &deviceCount, &physicalDevice);
-    
+
+    if (physicalDevice == VK_NULL_HANDLE) {
+        fprintf(stderr, "No Vulkan device found\n");
+        return 0;
+    }
+
+    // Print device info
     VkPhysicalDeviceProperties props;
     vkGetPhysicalDeviceProperties(physicalDevice, &props);
-    printf("Using device: %s\n\n", props.deviceName);
-    
-    float priority = 1.0f;
+    printf("Using device: %s\n", props.deviceName);
+    printf("Driver version: %d.%d.%d\n",
+           VK_VERSION_MAJOR(props.driverVersion),
+           VK_VERSION_MINOR(props.driverVersion),
+           VK_VERSION_PATCH(props.driverVersion));
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+
+    VkPhysicalDeviceFeatures supported;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+    nativeGs = supported.geometryShader;
+
+    // Layer output from the vertex stage, what the ring draw would need
+    if (props.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceVulkan12Features features12 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        };
+
+        VkPhysicalDeviceFeatures2 features2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &features12,
+        };
+
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+        outputLayer = features12.shaderOutputLayer;
+    }
+
+    // Find queue family, the emulation needs compute
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties* queueFamilies = malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies);
+
+    const VkQueueFlags queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        if ((queueFamilies[i].queueFlags & queueFlags) == queueFlags) {
+            queueFamily = i;
+            break;
+        }
+    }
+    free(queueFamilies);
+
+    // Create device, with geometry shaders where the driver has them
+    float queuePriority = 1.0f;
     VkDeviceQueueCreateInfo queueInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = 0,
+        .queueFamilyIndex = queueFamily,
         .queueCount = 1,
-        .pQueuePriorities = &priority,
+        .pQueuePriorities = &queuePriority,
     };
-    
+
     VkPhysicalDeviceFeatures features = {
-        .geometryShader = VK_TRUE,
+        .geometryShader = nativeGs ? VK_TRUE : VK_FALSE,
     };
-    
+
     VkDeviceCreateInfo deviceInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .queueCreateInfoCount = 1,
         .pQueueCreateInfos = &queueInfo,
         .pEnabledFeatures = &features,
     };
-    
-    VkResult result = vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device);
-    if (result != VK_SUCCESS) {
-        printf("Note: Could not create device with GS (error %d)\n", result);
-        printf("Creating device without GS...\n");
-        
-        features.geometryShader = VK_FALSE;
-        vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device);
+
+    if (vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device) != VK_SUCCESS) {
+        fprintf(stderr, "Failed to create Vulkan device\n");
+        return 0;
     }
-    
+
+    vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+    if (!setup_emulation()) {
+        fprintf(stderr, "Failed to set up the GS emulation\n");
+        return 0;
+    }
+
+    printf("\n");
     return 1;
 }
 
 void cleanup_vulkan(void) {
+    cleanup_emulation();
     if (device) vkDestroyDevice(device, NULL);
     if (instance) vkDestroyInstance(instance, NULL);
 }
 
+/* ============================================
+ * Main
+ * ============================================ */
 int main(void) {
     printf("========================================\n");
     printf("Geometry Shader Test Suite\n");
     printf("========================================\n\n");
-    
-    if (!setup_vulkan()) return 1;
-    
-    int passed = 0, failed = 0;
-    
+
+    if (!setup_vulkan()) {
+        cleanup_vulkan();
+        return 1;
+    }
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    // Run tests in order of complexity
     if (test_gs_feature_supported()) passed++; else failed++;
     if (test_gs_basic_passthrough()) passed++; else failed++;
     if (test_gs_amplification()) passed++; else failed++;
     if (test_gs_culling()) passed++; else failed++;
     if (test_gs_layered_rendering()) passed++; else failed++;
-    
+    if (test_gs_throughput()) passed++; else failed++;
+
     printf("\n========================================\n");
-    printf("Results: %d/5 PASSED, %d FAILED\n", passed, failed);
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
     printf("========================================\n");
-    
+
     cleanup_vulkan();
-    
-    return (failed == 0) ? 0 : 1;
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
 }
@@ -0,0 +1,329 @@
+/*
+ * Geometry Shader Emulation Test Suite
+ *
+ * These tests verify the geometry stage emulation planner
+ * (src/dxvk/dxvk_gs_emulation.h): when the stage is dropped, how
+ * large the scratch slots are, how draws are split into batches
+ * and how ring ranges are reused.
+ * CPU only, no Vulkan device needed. test_gs runs the pre-pass.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_gs_emu_slot_size - Are strips bounded by their list vertices?
+ * 2. test_gs_emu_passthrough - Are trivial stages dropped, and only those?
+ * 3. test_gs_emu_unsupported - Are draws the pre-pass cannot run skipped?
+ * 4. test_gs_emu_batching - Are large draws split by the scratch size?
+ * 5. test_gs_emu_primitive_order - Are instances flattened in D3D order?
+ * 6. test_gs_emu_ring - Does the ring wrap, wait and ask for barriers?
+ */
+
+#include "dxvk/dxvk_gs_emulation.h"
+
+#include <stdio.h>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/*
+ * Sequence numbers up to `done` are complete, waits complete
+ * everything up to the sequence waited for
+ */
+struct FakeDevice {
+    uint64_t done = 0;
+    uint32_t waits = 0;
+    uint64_t lastWait = 0;
+};
+
+static DxvkGsEmulation makeEmulation(FakeDevice& dev, uint32_t ringSize, uint32_t scratchSize) {
+    DxvkGsOptions options;
+    options.ringSize = ringSize;
+    options.scratchSize = scratchSize;
+
+    return DxvkGsEmulation(options,
+        [&dev] (uint64_t sequence) { return sequence <= dev.done; },
+        [&dev] (uint64_t sequence) {
+            dev.waits += 1;
+            dev.lastWait = sequence;
+            dev.done = std::max(dev.done, sequence);
+        });
+}
+
+static DxvkGsInfo triangleStage(uint32_t maxVertexCount) {
+    DxvkGsInfo gs;
+    gs.outputTopology = DxvkGsOutputTopology::TriangleStrip;
+    gs.maxVertexCount = maxVertexCount;
+    gs.outputStride = 16;
+    return gs;
+}
+
+static DxvkGsDrawInfo triangles(uint32_t vertexCount) {
+    DxvkGsDrawInfo draw;
+    draw.topology = DxvkXfbTopology::TriangleList;
+    draw.vertexCount = vertexCount;
+    return draw;
+}
+
+/* ============================================
+ * Test: Slot size
+ * ============================================ */
+int test_gs_emu_slot_size(void) {
+    printf("TEST: gs_emu_slot_size\n");
+
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::TriangleStrip, 3) == 3, "One triangle");
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::TriangleStrip, 4) == 6, "Quad strip");
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::TriangleStrip, 7) == 15, "Seven vertex strip");
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::TriangleStrip, 2) == 0, "Short strip");
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::LineStrip, 4) == 6, "Line strip");
+    TEST_ASSERT(dxvkGsMaxListVertices(DxvkGsOutputTopology::PointList, 5) == 5, "Points");
+
+    FakeDevice dev;
+    DxvkGsEmulation gs = makeEmulation(dev, 1u << 20, 1u << 16);
+    TEST_ASSERT(gs.getSlotVertices(triangleStage(6)) == 12, "Slot vertices");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Passthrough
+ * ============================================ */
+int test_gs_emu_passthrough(void) {
+    printf("TEST: gs_emu_passthrough\n");
+
+    FakeDevice dev;
+    DxvkGsEmulation emu = makeEmulation(dev, 1u << 20, 1u << 16);
+
+    DxvkGsInfo gs = triangleStage(3);
+    gs.copiesInput = true;
+
+    DxvkGsDrawInfo strip = triangles(10);
+    strip.topology = DxvkXfbTopology::TriangleStrip;
+
+    TEST_ASSERT(emu.selectPath(gs, triangles(9)) == DxvkGsPath::Passthrough, "Triangle list");
+    TEST_ASSERT(emu.selectPath(gs, strip) == DxvkGsPath::Passthrough, "Triangle strip");
+
+    DxvkGsDrawInfo indirect = triangles(0);
+    indirect.indirect = true;
+    TEST_ASSERT(emu.selectPath(gs, indirect) == DxvkGsPath::Passthrough, "Indirect passthrough");
+
+    // Anything else the stage does needs the pre-pass
+    DxvkGsDrawInfo lines = triangles(8);
+    lines.topology = DxvkXfbTopology::LineList;
+    TEST_ASSERT(emu.selectPath(gs, lines) == DxvkGsPath::Compute, "Lines in, triangles out");
+
+    DxvkGsInfo instanced = gs;
+    instanced.instanceCount = 2;
+    TEST_ASSERT(emu.selectPath(instanced, triangles(9)) == DxvkGsPath::Compute, "Stage instancing");
+
+    TEST_ASSERT(emu.selectPath(triangleStage(3), triangles(9)) == DxvkGsPath::Compute, "Not a copy");
+
+    std::vector<DxvkGsBatch> batches(1);
+    TEST_ASSERT(emu.draw(gs, triangles(9), 1, batches) == DxvkGsPath::Passthrough, "Draw");
+    TEST_ASSERT(batches.empty(), "Passthrough draw has batches");
+    TEST_ASSERT(emu.getStats().passthroughDraws == 1 && emu.getStats().computeDraws == 0, "Stats");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Unsupported draws
+ * ============================================ */
+int test_gs_emu_unsupported(void) {
+    printf("TEST: gs_emu_unsupported\n");
+
+    FakeDevice dev;
+    DxvkGsEmulation emu = makeEmulation(dev, 1u << 20, 1024);
+
+    DxvkGsDrawInfo indirect = triangles(0);
+    indirect.indirect = true;
+    TEST_ASSERT(emu.selectPath(triangleStage(6), indirect) == DxvkGsPath::Unsupported, "Indirect");
+
+    // Can never emit a whole triangle
+    TEST_ASSERT(emu.selectPath(triangleStage(2), triangles(3)) == DxvkGsPath::Unsupported, "Empty stage");
+
+    // 126 list vertices of 16 bytes do not fit the scratch buffer
+    TEST_ASSERT(emu.selectPath(triangleStage(44), triangles(3)) == DxvkGsPath::Unsupported, "Slot too large");
+
+    DxvkGsInfo layered = triangleStage(3);
+    layered.copiesInput = true;
+    layered.exportsLayer = true;
+    TEST_ASSERT(emu.selectPath(layered, triangles(3)) == DxvkGsPath::Unsupported, "Layer without vertex output");
+
+    DxvkGsOptions options;
+    options.vertexLayerOutput = true;
+    DxvkGsEmulation layerEmu(options, [] (uint64_t) { return true; }, [] (uint64_t) { });
+    TEST_ASSERT(layerEmu.selectPath(layered, triangles(3)) == DxvkGsPath::Compute, "Layer with vertex output");
+
+    std::vector<DxvkGsBatch> batches;
+    TEST_ASSERT(emu.draw(triangleStage(6), indirect, 1, batches) == DxvkGsPath::Unsupported, "Draw");
+    TEST_ASSERT(batches.empty() && emu.getStats().skippedDraws == 1, "Skipped draw");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Batching
+ * ============================================ */
+int test_gs_emu_batching(void) {
+    printf("TEST: gs_emu_batching\n");
+
+    // 6 list vertices of 16 bytes per slot, 100 slots of scratch
+    FakeDevice dev;
+    DxvkGsEmulation emu = makeEmulation(dev, 1u << 20, 100 * 96);
+    DxvkGsInfo gs = triangleStage(4);
+
+    TEST_ASSERT(emu.getBatchLimit(gs) == 100, "Batch limit");
+
+    std::vector<DxvkGsBatch> batches;
+    TEST_ASSERT(emu.draw(gs, triangles(750), 1, batches) == DxvkGsPath::Compute, "Path");
+    TEST_ASSERT(batches.size() == 3, "Batch count");
+
+    const uint32_t first[] = { 0, 100, 200 };
+    const uint32_t count[] = { 100, 100, 50 };
+    const uint32_t blocks[] = { 2, 2, 1 };
+
+    for (uint32_t i = 0; i < 3; i++) {
+        TEST_ASSERT(batches[i].firstPrimitive == first[i], "First primitive");
+        TEST_ASSERT(batches[i].primitiveCount == count[i], "Primitive count");
+        TEST_ASSERT(batches[i].blockCount == blocks[i], "Scan blocks");
+        TEST_ASSERT(batches[i].ringOffset == first[i] * 96, "Ring offset");
+        TEST_ASSERT(batches[i].firstVertex == first[i] * 6, "First vertex");
+        TEST_ASSERT(!batches[i].barrier, "Barrier without overlap");
+    }
+
+    // Draw and stage instances multiply the input primitives
+    DxvkGsDrawInfo instanced = triangles(30);
+    instanced.instanceCount = 4;
+    gs.instanceCount = 3;
+
+    emu.draw(gs, instanced, 1, batches);
+    TEST_ASSERT(batches.size() == 2 && batches[1].primitiveCount == 20, "Instanced batches");
+
+    // An empty draw records nothing
+    emu.draw(gs, triangles(2), 1, batches);
+    TEST_ASSERT(batches.empty(), "Empty draw");
+
+    DxvkGsStats stats = emu.getStats();
+    TEST_ASSERT(stats.computeDraws == 3 && stats.batches == 5, "Stats");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Primitive order
+ * ============================================ */
+int test_gs_emu_primitive_order(void) {
+    printf("TEST: gs_emu_primitive_order\n");
+
+    FakeDevice dev;
+    DxvkGsEmulation emu = makeEmulation(dev, 1u << 20, 1u << 16);
+
+    DxvkGsInfo gs = triangleStage(3);
+    gs.instanceCount = 2;
+
+    DxvkGsDrawInfo draw = triangles(9);
+    draw.instanceCount = 2;
+
+    // 3 primitives, 2 stage instances, 2 draw instances
+    uint32_t index = 0;
+
+    for (uint32_t i = 0; i < 2; i++) {
+        for (uint32_t p = 0; p < 3; p++) {
+            for (uint32_t g = 0; g < 2; g++) {
+                DxvkGsPrimitive prim = emu.getPrimitive(gs, draw, index++);
+                TEST_ASSERT(prim.instance == i && prim.primitive == p && prim.gsInstance == g, "Order");
+            }
+        }
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Ring reuse
+ * ============================================ */
+int test_gs_emu_ring(void) {
+    printf("TEST: gs_emu_ring\n");
+
+    // Ring of 4 slots of 3 vertices, one slot per batch
+    FakeDevice dev;
+    DxvkGsEmulation emu = makeEmulation(dev, 4 * 48, 48);
+    DxvkGsInfo gs = triangleStage(3);
+
+    std::vector<DxvkGsBatch> batches;
+    emu.draw(gs, triangles(9), 1, batches);
+    TEST_ASSERT(batches.size() == 3 && batches[2].ringOffset == 96, "First list");
+
+    // The next list wraps around and overwrites ranges of list 1
+    emu.draw(gs, triangles(6), 2, batches);
+    TEST_ASSERT(batches[0].ringOffset == 144 && batches[1].ringOffset == 0, "Wrap");
+    TEST_ASSERT(dev.waits == 1 && dev.lastWait == 1, "Wait for list 1");
+    TEST_ASSERT(!batches[1].barrier, "Barrier across lists");
+
+    // Once list 2 is done, list 3 can reuse its ranges without waiting,
+    // but wrapping onto its own range needs a barrier
+    dev.done = 2;
+    emu.draw(gs, triangles(15), 3, batches);
+    TEST_ASSERT(batches.size() == 5 && batches[4].ringOffset == batches[0].ringOffset, "Own wrap");
+    TEST_ASSERT(dev.waits == 1, "Waited for a completed list");
+    TEST_ASSERT(!batches[3].barrier && batches[4].barrier, "Barrier within a list");
+
+    // Ranges start on a vertex of the draw's stride
+    DxvkGsInfo wide = triangleStage(3);
+    wide.outputStride = 20;
+
+    DxvkGsEmulation alignEmu = makeEmulation(dev, 1024, 1024);
+    alignEmu.draw(gs, triangles(3), 4, batches);
+    alignEmu.draw(wide, triangles(3), 4, batches);
+    TEST_ASSERT(batches[0].ringOffset == 60 && batches[0].firstVertex == 3, "Aligned to the stride");
+
+    DxvkGsStats stats = emu.getStats();
+    TEST_ASSERT(stats.wraps == 2 && stats.stalls == 1, "Stats");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Geometry Shader Emulation Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_gs_emu_slot_size()) passed++; else failed++;
+    if (test_gs_emu_passthrough()) passed++; else failed++;
+    if (test_gs_emu_unsupported()) passed++; else failed++;
+    if (test_gs_emu_batching()) passed++; else failed++;
+    if (test_gs_emu_primitive_order()) passed++; else failed++;
+    if (test_gs_emu_ring()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
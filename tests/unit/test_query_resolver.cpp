@@ -0,0 +1,453 @@
+/*
+ * Query Resolver Test Suite
+ *
+ * These tests verify the batched query resolver
+ * (src/d3d9/d3d9_query_resolver.h) against a simulated GPU that
+ * executes query copies when a command list completes.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_query_one_copy_per_frame - Is a frame resolved with one copy?
+ * 2. test_query_poll_no_flush - Does GetData poll without flushing?
+ * 3. test_query_flush_old - Do old queries block instead of spinning?
+ * 4. test_query_spin_same_frame - Does spinning within a frame progress?
+ * 5. test_query_pool_wrap - Is a wrapping range split and reused safely?
+ * 6. test_query_lost_result - Are overwritten results conservative?
+ * 7. test_query_active_not_copied - Are queries still active left out of a resolve?
+ * 8. test_query_unavailable_requeued - Is a slot copied before its query finished copied again?
+ */
+
+#include "d3d9/d3d9_query_resolver.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* Simulated GPU: copies recorded into the current command list write
+ * the query values into the resolve buffer once that list completes */
+struct FakeGpu {
+    struct Copy {
+        uint64_t sequence;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    std::vector<D3D9QueryResultSlot> results;
+    std::vector<uint64_t> queryValues;  // what the GPU measured per slot
+    std::vector<bool> active;           // begun but not ended
+    std::vector<bool> late;             // not finished when the next copy runs
+    std::vector<Copy> copies;
+    uint32_t activeCopies = 0;          // copies covering an active query, invalid
+
+    uint64_t recording = 1;   // command list being recorded
+    uint64_t completed = 0;
+    uint32_t submits = 0;
+    uint32_t waits = 0;
+
+    explicit FakeGpu(uint32_t poolSize)
+    : results(poolSize), queryValues(poolSize, 0), active(poolSize, false), late(poolSize, false) {
+        memset(results.data(), 0, results.size() * sizeof(D3D9QueryResultSlot));
+    }
+
+    std::unique_ptr<D3D9QueryBatchResolver> makeResolver(D3D9QueryResolverOptions options) {
+        return std::make_unique<D3D9QueryBatchResolver>(options, results.data(),
+            [this] (uint32_t first, uint32_t count) {
+                for (uint32_t i = first; i < first + count; i++)
+                    activeCopies += active[i] ? 1 : 0;
+                copies.push_back({ recording, first, count });
+            },
+            [this] () { return recording; },
+            [this] (uint64_t seq) { return seq <= completed; },
+            [this] (uint64_t seq) {
+                waits++;
+                if (seq >= recording)
+                    submit();
+                complete(seq);
+            });
+    }
+
+    void submit() {
+        recording++;
+        submits++;
+    }
+
+    void complete(uint64_t seq) {
+        for (auto& c : copies) {
+            if (c.sequence > completed && c.sequence <= seq) {
+                for (uint32_t i = c.first; i < c.first + c.count; i++) {
+                    // Copies without VK_QUERY_RESULT_WAIT_BIT
+                    results[i] = { late[i] ? 0 : queryValues[i], late[i] ? 0u : 1u };
+                    late[i] = false;
+                }
+            }
+        }
+        if (seq > completed)
+            completed = seq;
+    }
+
+    /* Present: submit the frame, and let the GPU finish everything
+     * submitted 'latency' frames ago */
+    void present(uint32_t latency) {
+        submit();
+        if (recording > latency + 1)
+            complete(recording - latency - 1);
+    }
+};
+
+/* Begins a query whose GPU result will be 'value' */
+static void begin(FakeGpu& gpu, D3D9QueryBatchResolver& resolver, D3D9BatchedQuery& q, uint64_t value) {
+    uint32_t slot = resolver.Begin(q);
+    gpu.queryValues[slot] = value;
+    gpu.active[slot] = true;
+}
+
+static void end(FakeGpu& gpu, D3D9QueryBatchResolver& resolver, D3D9BatchedQuery& q) {
+    gpu.active[q.alloc % gpu.active.size()] = false;
+    resolver.End(q);
+}
+
+static void issue(FakeGpu& gpu, D3D9QueryBatchResolver& resolver, D3D9BatchedQuery& q, uint64_t value) {
+    begin(gpu, resolver, q, value);
+    end(gpu, resolver, q);
+}
+
+/* ============================================
+ * Test: One copy per frame
+ * ============================================ */
+int test_query_one_copy_per_frame(void) {
+    printf("TEST: query_one_copy_per_frame\n");
+
+    FakeGpu gpu(4096);
+    auto resolver = gpu.makeResolver(D3D9QueryResolverOptions());
+
+    std::vector<D3D9BatchedQuery> queries(200);
+
+    for (uint32_t f = 0; f < 3; f++) {
+        for (auto& q : queries)
+            issue(gpu, *resolver, q, f);
+
+        resolver->EndFrame();
+        gpu.present(1);
+    }
+
+    D3D9QueryResolverStats stats = resolver->GetStats();
+    TEST_ASSERT(stats.batches == 3, "Expected one batch per frame");
+    TEST_ASSERT(stats.copies == 3, "Expected one copy per frame");
+    TEST_ASSERT(gpu.copies[0].count == 200, "Copy does not cover the frame's queries");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Poll without flushing
+ * ============================================ */
+int test_query_poll_no_flush(void) {
+    printf("TEST: query_poll_no_flush\n");
+
+    FakeGpu gpu(4096);
+    auto resolver = gpu.makeResolver(D3D9QueryResolverOptions());
+
+    std::vector<D3D9BatchedQuery> queries(32);
+    for (uint32_t i = 0; i < queries.size(); i++)
+        issue(gpu, *resolver, queries[i], 1000 + i);
+
+    resolver->EndFrame();
+    gpu.present(2);
+
+    // Frame 1: copy still in flight, polling with FLUSH must not submit
+    uint64_t value = 0;
+    for (auto& q : queries)
+        TEST_ASSERT(resolver->GetData(q, true, value) == D3D9QueryStatus::NotReady, "Result ready too early");
+
+    resolver->EndFrame();
+    gpu.present(2);
+    TEST_ASSERT(gpu.submits == 2, "GetData caused a submit");
+
+    resolver->EndFrame();
+    gpu.present(2);
+
+    // Frame 3: first frame's list has completed
+    for (uint32_t i = 0; i < queries.size(); i++) {
+        TEST_ASSERT(resolver->GetData(queries[i], false, value) == D3D9QueryStatus::Ready, "Result not ready");
+        TEST_ASSERT(value == 1000 + i, "Wrong query result");
+    }
+
+    TEST_ASSERT(gpu.waits == 0, "GetData waited");
+    TEST_ASSERT(resolver->GetStats().earlyFlushes == 0, "Early flush without spinning");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Old queries block on their copy
+ * ============================================ */
+int test_query_flush_old(void) {
+    printf("TEST: query_flush_old\n");
+
+    FakeGpu gpu(4096);
+    D3D9QueryResolverOptions options;
+    options.maxPollFrames = 2;
+    auto resolver = gpu.makeResolver(options);
+
+    D3D9BatchedQuery q;
+    issue(gpu, *resolver, q, 77);
+
+    uint64_t value = 0;
+
+    for (uint32_t f = 0; f < 2; f++) {
+        resolver->EndFrame();
+        gpu.present(10);
+        if (f == 0)
+            TEST_ASSERT(resolver->GetData(q, true, value) == D3D9QueryStatus::NotReady, "Blocked too early");
+    }
+
+    // Two frames old: D3DGETDATA_FLUSH blocks instead of returning S_FALSE
+    TEST_ASSERT(resolver->GetData(q, true, value) == D3D9QueryStatus::Ready, "Old query not resolved");
+    TEST_ASSERT(value == 77, "Wrong query result");
+    TEST_ASSERT(gpu.waits == 1 && resolver->GetStats().waits == 1, "Wait not counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Spinning on a query within a frame
+ * ============================================ */
+int test_query_spin_same_frame(void) {
+    printf("TEST: query_spin_same_frame\n");
+
+    FakeGpu gpu(4096);
+    D3D9QueryResolverOptions options;
+    options.spinPolls = 16;
+    auto resolver = gpu.makeResolver(options);
+
+    D3D9BatchedQuery q;
+    issue(gpu, *resolver, q, 5);
+
+    uint64_t value = 0;
+    uint32_t polls = 0;
+    D3D9QueryStatus status;
+
+    while ((status = resolver->GetData(q, true, value)) != D3D9QueryStatus::Ready) {
+        TEST_ASSERT(++polls < 1000, "Spinning query never resolved");
+
+        if (status == D3D9QueryStatus::Flush)
+            gpu.submit();
+
+        // GPU catches up with whatever was submitted a while ago
+        if (polls % 32 == 0)
+            gpu.complete(gpu.recording - 1);
+    }
+
+    TEST_ASSERT(value == 5, "Wrong query result");
+    TEST_ASSERT(polls >= options.spinPolls, "Resolved before spinning");
+    TEST_ASSERT(resolver->GetStats().earlyFlushes == 1, "Expected exactly one early flush");
+    TEST_ASSERT(gpu.submits == 1, "Expected exactly one submit");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Pool wrap-around
+ * ============================================ */
+int test_query_pool_wrap(void) {
+    printf("TEST: query_pool_wrap\n");
+
+    FakeGpu gpu(8);
+    D3D9QueryResolverOptions options;
+    options.poolSize = 8;
+    auto resolver = gpu.makeResolver(options);
+
+    std::vector<D3D9BatchedQuery> queries(6);
+
+    // Frame 0 uses slots 1..6, frame 1 wraps around: 7, 0..4
+    for (uint32_t f = 0; f < 2; f++) {
+        for (uint32_t i = 0; i < queries.size(); i++)
+            issue(gpu, *resolver, queries[i], f * 100 + i);
+
+        resolver->EndFrame();
+        gpu.present(1);
+    }
+
+    TEST_ASSERT(resolver->GetStats().copies == 3, "Wrapping range not split");
+    TEST_ASSERT(resolver->GetStats().slotWaits > 0, "Slot reuse did not wait for the previous copy");
+
+    gpu.complete(gpu.recording - 1);
+
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < queries.size(); i++) {
+        TEST_ASSERT(resolver->GetData(queries[i], false, value) == D3D9QueryStatus::Ready, "Result not ready");
+        TEST_ASSERT(value == 100 + i, "Wrong result after wrap");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Result overwritten before GetData
+ * ============================================ */
+int test_query_lost_result(void) {
+    printf("TEST: query_lost_result\n");
+
+    FakeGpu gpu(4);
+    D3D9QueryResolverOptions options;
+    options.poolSize = 4;
+    auto resolver = gpu.makeResolver(options);
+
+    D3D9BatchedQuery old;
+    issue(gpu, *resolver, old, 0);
+    resolver->EndFrame();
+    gpu.present(0);
+
+    std::vector<D3D9BatchedQuery> queries(4);
+    for (auto& q : queries)
+        issue(gpu, *resolver, q, 9);
+
+    resolver->EndFrame();
+    gpu.present(0);
+
+    // An occluded result would hide the object, report it visible
+    uint64_t value = 0;
+    TEST_ASSERT(resolver->GetData(old, false, value) == D3D9QueryStatus::Ready, "Lost query not resolved");
+    TEST_ASSERT(value == ~0ull, "Lost query not reported as visible");
+    TEST_ASSERT(resolver->GetStats().lostResults == 1, "Lost result not counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Active query during an early resolve
+ * ============================================ */
+int test_query_active_not_copied(void) {
+    printf("TEST: query_active_not_copied\n");
+
+    FakeGpu gpu(4096);
+    D3D9QueryResolverOptions options;
+    options.spinPolls = 4;
+    auto resolver = gpu.makeResolver(options);
+
+    // Slot 2 stays active across the resolve, slots 1 and 3 around
+    // it are done
+    D3D9BatchedQuery spun, open, other;
+    issue(gpu, *resolver, spun, 5);
+    begin(gpu, *resolver, open, 7);
+    issue(gpu, *resolver, other, 6);
+
+    uint64_t value = 0;
+    D3D9QueryStatus status;
+
+    while ((status = resolver->GetData(spun, true, value)) == D3D9QueryStatus::NotReady)
+        continue;
+
+    TEST_ASSERT(status == D3D9QueryStatus::Flush, "Spinning query not resolved early");
+    TEST_ASSERT(gpu.activeCopies == 0, "Active query copied");
+    TEST_ASSERT(gpu.copies.size() == 2
+             && gpu.copies[0].first == 1 && gpu.copies[0].count == 1
+             && gpu.copies[1].first == 3 && gpu.copies[1].count == 1,
+        "Early resolve does not cover exactly the ended queries");
+
+    gpu.submit();
+
+    // Ends in the next batch and is copied with it
+    end(gpu, *resolver, open);
+    resolver->EndFrame();
+    gpu.present(0);
+
+    TEST_ASSERT(gpu.activeCopies == 0, "Active query copied");
+    TEST_ASSERT(gpu.copies.size() == 3 && gpu.copies[2].first == 2 && gpu.copies[2].count == 1,
+        "Query ended after the resolve not copied");
+
+    TEST_ASSERT(resolver->GetData(open, false, value) == D3D9QueryStatus::Ready && value == 7, "Wrong result");
+    TEST_ASSERT(resolver->GetData(spun, false, value) == D3D9QueryStatus::Ready && value == 5, "Wrong result");
+    TEST_ASSERT(resolver->GetData(other, false, value) == D3D9QueryStatus::Ready && value == 6, "Wrong result");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Copy ran before the query finished
+ * ============================================ */
+int test_query_unavailable_requeued(void) {
+    printf("TEST: query_unavailable_requeued\n");
+
+    FakeGpu gpu(4096);
+    auto resolver = gpu.makeResolver(D3D9QueryResolverOptions());
+
+    D3D9BatchedQuery slow, fast;
+    issue(gpu, *resolver, slow, 3);
+    issue(gpu, *resolver, fast, 4);
+    gpu.late[slow.alloc % 4096] = true;
+
+    resolver->EndFrame();
+    gpu.present(0);
+
+    uint64_t value = 0;
+    TEST_ASSERT(resolver->GetData(fast, false, value) == D3D9QueryStatus::Ready && value == 4, "Wrong result");
+    TEST_ASSERT(resolver->GetData(slow, false, value) == D3D9QueryStatus::NotReady, "Unavailable result returned");
+    TEST_ASSERT(resolver->GetStats().requeues == 1, "Unavailable slot not requeued");
+
+    // The slot goes into the next batch, alone
+    resolver->EndFrame();
+    gpu.present(0);
+
+    TEST_ASSERT(gpu.copies.size() == 2 && gpu.copies[1].first == slow.alloc % 4096 && gpu.copies[1].count == 1,
+        "Unavailable slot not copied again");
+    TEST_ASSERT(resolver->GetData(slow, false, value) == D3D9QueryStatus::Ready && value == 3, "Query never became ready");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Query Resolver Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 8;
+
+    if (test_query_one_copy_per_frame()) passed++; else failed++;
+    if (test_query_poll_no_flush()) passed++; else failed++;
+    if (test_query_flush_old()) passed++; else failed++;
+    if (test_query_spin_same_frame()) passed++; else failed++;
+    if (test_query_pool_wrap()) passed++; else failed++;
+    if (test_query_lost_result()) passed++; else failed++;
+    if (test_query_active_not_copied()) passed++; else failed++;
+    if (test_query_unavailable_requeued()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
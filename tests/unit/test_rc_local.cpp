@@ -0,0 +1,270 @@
+/*
+ * Local Reference Table Test Suite
+ *
+ * These tests verify the CS-thread reference table
+ * (src/util/rc/util_rc_local.h): binding references are counted
+ * locally, and the real reference is only dropped after the epoch
+ * an object was retired in has completed.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_rc_local_single_ref - Is one atomic reference held per object?
+ * 2. test_rc_local_epoch - Does an object live until its epoch completes?
+ * 3. test_rc_local_rebind - Does rebinding before reconcile keep it alive?
+ * 4. test_rc_local_many_objects - Does the table grow correctly?
+ * 5. test_rc_local_destroy - Are all references dropped on destruction?
+ */
+
+#include "util/rc/util_rc_local.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static uint32_t g_destroyed = 0;
+
+/* Mirrors DXVK's RcObject: decRef returns the new count */
+class TestView {
+public:
+    explicit TestView(uint32_t refs) : m_refCount(refs) { }
+    ~TestView() { g_destroyed++; }
+
+    uint32_t incRef() { return ++m_refCount; }
+    uint32_t decRef() { return --m_refCount; }
+    uint32_t refs() const { return m_refCount.load(); }
+
+private:
+    std::atomic<uint32_t> m_refCount;
+};
+
+/* ============================================
+ * Test: One real reference per object
+ * ============================================ */
+int test_rc_local_single_ref(void) {
+    printf("TEST: rc_local_single_ref\n");
+
+    TestView* view = new TestView(1);  // held by the game
+    RcLocalTable<TestView> table;
+
+    TestView* slots[8] = { };
+
+    // Bind the same view to every slot (e.g. color and depth), twice
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (auto& slot : slots) {
+            table.rebind(slot, nullptr);
+            table.rebind(slot, view);
+        }
+    }
+
+    TEST_ASSERT(view->refs() == 2, "Table holds more than one real reference");
+    TEST_ASSERT(table.getRefs(view) == 8, "Local count mismatch");
+    TEST_ASSERT(table.getStats().atomicIncs == 1, "Binds touched the atomic count");
+
+    for (auto& slot : slots)
+        table.rebind(slot, nullptr);
+
+    table.reconcile(1);
+    table.retire(1);
+
+    TEST_ASSERT(view->refs() == 1, "Real reference not dropped");
+
+    view->decRef();
+    delete view;
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Epoch-deferred release
+ * ============================================ */
+int test_rc_local_epoch(void) {
+    printf("TEST: rc_local_epoch\n");
+
+    g_destroyed = 0;
+
+    TestView* view = new TestView(1);
+    RcLocalTable<TestView> table;
+
+    TestView* slot = nullptr;
+    table.rebind(slot, view);
+
+    // The game releases its reference, the binding keeps the view alive
+    view->decRef();
+
+    table.rebind(slot, nullptr);
+    table.reconcile(5);
+
+    TEST_ASSERT(g_destroyed == 0, "View destroyed at reconcile");
+    TEST_ASSERT(table.getStats().retired == 1, "View not retired");
+
+    table.retire(4);
+    TEST_ASSERT(g_destroyed == 0, "View destroyed before its epoch completed");
+
+    table.retire(5);
+    TEST_ASSERT(g_destroyed == 1, "View not destroyed after its epoch");
+    TEST_ASSERT(table.getStats().retired == 0, "Retire list not drained");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Rebinding keeps the table reference
+ * ============================================ */
+int test_rc_local_rebind(void) {
+    printf("TEST: rc_local_rebind\n");
+
+    TestView* a = new TestView(1);
+    TestView* b = new TestView(1);
+    RcLocalTable<TestView> table;
+
+    TestView* slot = nullptr;
+
+    // Ping-pong between two views within one chunk
+    for (uint32_t i = 0; i < 1000; i++)
+        table.rebind(slot, (i & 1) ? a : b);
+
+    table.reconcile(1);
+
+    RcLocalStats stats = table.getStats();
+    TEST_ASSERT(stats.atomicIncs == 2, "Rebinding took new real references");
+    TEST_ASSERT(stats.retired == 1, "Unbound view not retired");
+    TEST_ASSERT(stats.objects == 1, "Bound view dropped from the table");
+    TEST_ASSERT(table.getRefs(a) == 1, "Bound view lost its binding");
+
+    table.rebind(slot, nullptr);
+    table.reconcile(2);
+    table.retire(2);
+
+    TEST_ASSERT(a->refs() == 1 && b->refs() == 1, "Real references not dropped");
+
+    delete a;
+    delete b;
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Table growth
+ * ============================================ */
+int test_rc_local_many_objects(void) {
+    printf("TEST: rc_local_many_objects\n");
+
+    const uint32_t count = 5000;
+
+    std::vector<TestView*> views;
+    for (uint32_t i = 0; i < count; i++)
+        views.push_back(new TestView(1));
+
+    RcLocalTable<TestView> table;
+    std::vector<TestView*> slots(count, nullptr);
+
+    for (uint32_t i = 0; i < count; i++)
+        table.rebind(slots[i], views[i]);
+
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT(table.getRefs(views[i]) == 1, "Lost an entry while growing");
+        TEST_ASSERT(views[i]->refs() == 2, "Wrong real reference count");
+    }
+
+    // Unbind every other view, the rest must survive the rehash
+    for (uint32_t i = 0; i < count; i += 2)
+        table.rebind(slots[i], nullptr);
+
+    table.reconcile(1);
+    table.retire(1);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t expected = (i & 1) ? 1 : 0;
+        TEST_ASSERT(table.getRefs(views[i]) == expected, "Entry lost after reconcile");
+        TEST_ASSERT(views[i]->refs() == 1 + expected, "Wrong real reference count after reconcile");
+    }
+
+    for (uint32_t i = 1; i < count; i += 2)
+        table.rebind(slots[i], nullptr);
+
+    table.reconcile(2);
+    table.retire(2);
+
+    TEST_ASSERT(table.getStats().objects == 0, "Table not empty");
+
+    for (auto v : views)
+        delete v;
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Destruction
+ * ============================================ */
+int test_rc_local_destroy(void) {
+    printf("TEST: rc_local_destroy\n");
+
+    g_destroyed = 0;
+
+    {   RcLocalTable<TestView> table;
+        TestView* bound = nullptr;
+        TestView* retired = nullptr;
+
+        table.rebind(bound, new TestView(0));
+        table.rebind(retired, new TestView(0));
+        table.rebind(retired, nullptr);
+        table.reconcile(10);
+
+        TEST_ASSERT(g_destroyed == 0, "Object destroyed early");
+    }
+
+    TEST_ASSERT(g_destroyed == 2, "Table leaked references");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Local Reference Table Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_rc_local_single_ref()) passed++; else failed++;
+    if (test_rc_local_epoch()) passed++; else failed++;
+    if (test_rc_local_rebind()) passed++; else failed++;
+    if (test_rc_local_many_objects()) passed++; else failed++;
+    if (test_rc_local_destroy()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
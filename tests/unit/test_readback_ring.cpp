@@ -0,0 +1,315 @@
+/*
+ * Readback Ring Test Suite
+ *
+ * These tests verify the render target readback ring
+ * (src/d3d9/d3d9_readback_ring.h) against a simulated GPU whose
+ * copies complete a fixed number of frames after submission.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_readback_disabled - Does the ring stay out of the way when off?
+ * 2. test_readback_previous_frame - Are reads served from the last copy?
+ * 3. test_readback_latency - Is the newest completed copy picked?
+ * 4. test_readback_wait_pending - Does a read wait on one copy, not the device?
+ * 5. test_readback_slot_busy - Are copies skipped while the GPU owns a slot?
+ * 6. test_readback_idle_eviction - Are unused surfaces freed?
+ */
+
+#include "d3d9/d3d9_readback_ring.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* Simulated GPU: a copy snapshots the surface when submitted and
+ * becomes visible 'latency' frames later, like a real GPU timeline */
+struct FakeGpu {
+    uint32_t latency = 1;
+    uint64_t completed = 0;
+    uint64_t submitted = 0;
+    uint32_t waits = 0;
+    uint32_t liveBuffers = 0;
+    uint64_t nextHandle = 0;
+
+    std::map<uint64_t, uint32_t> surfaceValue;
+    std::map<uint64_t, std::vector<uint32_t>> buffers;
+    std::vector<std::pair<uint64_t, uint64_t>> inFlight;  // sequence, frame submitted
+    std::map<uint64_t, std::pair<uint32_t*, uint32_t>> pendingWrites;
+    uint64_t frame = 0;
+
+    std::unique_ptr<D3D9ReadbackRing> makeRing(D3D9ReadbackOptions options) {
+        return std::make_unique<D3D9ReadbackRing>(options,
+            [this] (size_t size) {
+                D3D9ReadbackBuffer b;
+                b.handle = ++nextHandle;
+                buffers[b.handle].assign(size / 4, 0);
+                b.mapPtr = buffers[b.handle].data();
+                liveBuffers++;
+                return b;
+            },
+            [this] (const D3D9ReadbackBuffer& b) {
+                buffers.erase(b.handle);
+                liveBuffers--;
+            },
+            [this] (uint64_t surface, const D3D9ReadbackBuffer& b) {
+                uint64_t seq = ++submitted;
+                pendingWrites[seq] = { static_cast<uint32_t*>(b.mapPtr), surfaceValue[surface] };
+                inFlight.push_back({ seq, frame });
+                return seq;
+            },
+            [this] (uint64_t seq) { return seq <= completed; },
+            [this] (uint64_t seq) { waits++; retire(seq); });
+    }
+
+    void retire(uint64_t seq) {
+        for (uint64_t s = completed + 1; s <= seq; s++) {
+            auto w = pendingWrites.find(s);
+            if (w != pendingWrites.end()) {
+                w->second.first[0] = w->second.second;
+                pendingWrites.erase(w);
+            }
+        }
+        completed = std::max(completed, seq);
+    }
+
+    /* Advance one frame: copies older than 'latency' frames finish */
+    void tick() {
+        frame++;
+        uint64_t done = completed;
+        for (auto& f : inFlight) {
+            if (f.second + latency <= frame)
+                done = std::max(done, f.first);
+        }
+        retire(done);
+    }
+};
+
+/* ============================================
+ * Test: Disabled ring
+ * ============================================ */
+int test_readback_disabled(void) {
+    printf("TEST: readback_disabled\n");
+
+    FakeGpu gpu;
+    auto ring = gpu.makeRing(D3D9ReadbackOptions());
+
+    for (uint32_t f = 0; f < 5; f++) {
+        TEST_ASSERT(ring->Read(1, 64).status == D3D9ReadbackStatus::Sync, "Disabled ring served data");
+        ring->EndFrame();
+        gpu.tick();
+    }
+
+    TEST_ASSERT(gpu.submitted == 0, "Disabled ring issued copies");
+    TEST_ASSERT(ring->GetStats().syncsForced == 5, "Forced syncs not counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Serve previous frame's copy
+ * ============================================ */
+int test_readback_previous_frame(void) {
+    printf("TEST: readback_previous_frame\n");
+
+    FakeGpu gpu;
+    gpu.latency = 1;
+    D3D9ReadbackOptions options;
+    options.enabled = true;
+    auto ring = gpu.makeRing(options);
+
+    // Frame 0: first read syncs and subscribes the surface
+    gpu.surfaceValue[1] = 100;
+    TEST_ASSERT(ring->Read(1, 64).status == D3D9ReadbackStatus::Sync, "First read must sync");
+    ring->EndFrame();
+    gpu.tick();
+
+    for (uint32_t f = 1; f < 10; f++) {
+        gpu.surfaceValue[1] = 100 + f;
+        D3D9ReadbackResult r = ring->Read(1, 64);
+
+        TEST_ASSERT(r.status == D3D9ReadbackStatus::Served, "Read not served from ring");
+        TEST_ASSERT(r.frameAge == 1, "Expected one frame of latency");
+        TEST_ASSERT(*static_cast<const uint32_t*>(r.data) == 100 + f - 1, "Stale or wrong data");
+
+        ring->EndFrame();
+        gpu.tick();
+    }
+
+    D3D9ReadbackStats stats = ring->GetStats();
+    TEST_ASSERT(stats.syncsAvoided == 9 && stats.syncsForced == 1, "Sync counters mismatch");
+    TEST_ASSERT(gpu.waits == 0, "Ring waited on the GPU");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Deeper GPU latency
+ * ============================================ */
+int test_readback_latency(void) {
+    printf("TEST: readback_latency\n");
+
+    FakeGpu gpu;
+    gpu.latency = 2;
+    D3D9ReadbackOptions options;
+    options.enabled = true;
+    options.slotCount = 4;
+    auto ring = gpu.makeRing(options);
+
+    ring->Read(1, 64);
+    for (uint32_t f = 0; f < 3; f++) {
+        gpu.surfaceValue[1] = 200 + f;
+        ring->EndFrame();
+        gpu.tick();
+    }
+
+    // Copies of frames 0 and 1 have completed, frame 2 is in flight
+    D3D9ReadbackResult r = ring->Read(1, 64);
+    TEST_ASSERT(r.status == D3D9ReadbackStatus::Served, "Read not served");
+    TEST_ASSERT(r.frameAge == 2, "Newest completed copy not picked");
+    TEST_ASSERT(*static_cast<const uint32_t*>(r.data) == 201, "Wrong copy served");
+    TEST_ASSERT(gpu.waits == 0, "Ring waited on the GPU");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Wait for a pending copy
+ * ============================================ */
+int test_readback_wait_pending(void) {
+    printf("TEST: readback_wait_pending\n");
+
+    FakeGpu gpu;
+    gpu.latency = 5;
+    D3D9ReadbackOptions options;
+    options.enabled = true;
+    auto ring = gpu.makeRing(options);
+
+    gpu.surfaceValue[1] = 42;
+    ring->Read(1, 64);
+    ring->EndFrame();
+    gpu.tick();
+
+    // Nothing completed yet: wait for the one copy instead of a device sync
+    D3D9ReadbackResult r = ring->Read(1, 64);
+    TEST_ASSERT(r.status == D3D9ReadbackStatus::Waited, "Pending copy not waited on");
+    TEST_ASSERT(*static_cast<const uint32_t*>(r.data) == 42, "Wrong data after wait");
+    TEST_ASSERT(gpu.waits == 1, "Wait callback not used");
+    TEST_ASSERT(ring->GetStats().copyWaits == 1, "Copy wait not counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Slot still owned by the GPU
+ * ============================================ */
+int test_readback_slot_busy(void) {
+    printf("TEST: readback_slot_busy\n");
+
+    FakeGpu gpu;
+    gpu.latency = 4;
+    D3D9ReadbackOptions options;
+    options.enabled = true;
+    options.slotCount = 2;
+    auto ring = gpu.makeRing(options);
+
+    ring->Read(1, 64);
+    for (uint32_t f = 0; f < 4; f++) {
+        ring->EndFrame();
+        gpu.tick();
+    }
+
+    // Two slots, four frames of latency: frames 2 and 3 find their slot busy
+    D3D9ReadbackStats stats = ring->GetStats();
+    TEST_ASSERT(stats.copiesIssued == 2, "Copies issued into busy slots");
+    TEST_ASSERT(stats.copiesSkipped == 2, "Skipped copies not counted");
+    TEST_ASSERT(gpu.waits == 0, "Ring waited on the GPU");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Idle surfaces are evicted
+ * ============================================ */
+int test_readback_idle_eviction(void) {
+    printf("TEST: readback_idle_eviction\n");
+
+    FakeGpu gpu;
+    gpu.latency = 1;
+    D3D9ReadbackOptions options;
+    options.enabled = true;
+    options.idleFrames = 5;
+    auto ring = gpu.makeRing(options);
+
+    ring->Read(1, 64);
+    ring->Read(2, 128);
+
+    for (uint32_t f = 0; f < 10; f++) {
+        ring->Read(1, 64);
+        ring->EndFrame();
+        gpu.tick();
+    }
+
+    TEST_ASSERT(ring->GetStats().surfaces == 1, "Idle surface not evicted");
+    TEST_ASSERT(gpu.liveBuffers == options.slotCount, "Evicted buffers not freed");
+
+    // Resize means the old copies are useless
+    TEST_ASSERT(ring->Read(1, 256).status == D3D9ReadbackStatus::Sync, "Resized surface served stale data");
+
+    ring.reset();
+    TEST_ASSERT(gpu.liveBuffers == 0, "Buffers leaked on destruction");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Readback Ring Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_readback_disabled()) passed++; else failed++;
+    if (test_readback_previous_frame()) passed++; else failed++;
+    if (test_readback_latency()) passed++; else failed++;
+    if (test_readback_wait_pending()) passed++; else failed++;
+    if (test_readback_slot_busy()) passed++; else failed++;
+    if (test_readback_idle_eviction()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
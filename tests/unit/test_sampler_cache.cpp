@@ -0,0 +1,322 @@
+/*
+ * Sampler Cache Test Suite
+ *
+ * These tests verify the packed sampler key and the lock-free
+ * sampler heap cache (src/d3d9/d3d9_sampler_cache.h).
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_sampler_key_normalize - Do equivalent states share a key?
+ * 2. test_sampler_key_roundtrip - Does unpacking restore the state?
+ * 3. test_sampler_cache_hit - Is a slot written once and reused?
+ * 4. test_sampler_cache_lru - Are only stale slots evicted, oldest first?
+ * 5. test_sampler_cache_threads - Do concurrent lookups agree?
+ */
+
+#include "d3d9/d3d9_sampler_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* ============================================
+ * Test: Key normalization
+ * ============================================ */
+int test_sampler_key_normalize(void) {
+    printf("TEST: sampler_key_normalize\n");
+
+    D3D9SamplerState a;
+    a.magFilter = 2;  // D3DTEXF_LINEAR
+    a.minFilter = 2;
+    a.mipFilter = 2;
+
+    // Anisotropy and border color have no effect here
+    D3D9SamplerState b = a;
+    b.maxAnisotropy = 16;
+    b.borderColor = 0xff00ff00;
+    TEST_ASSERT(D3D9PackSamplerKey(a) == D3D9PackSamplerKey(b), "Unused fields change the key");
+
+    // ...but they do once they are used
+    D3D9SamplerState c = b;
+    c.minFilter = 3;  // D3DTEXF_ANISOTROPIC
+    D3D9SamplerState d = c;
+    d.maxAnisotropy = 8;
+    TEST_ASSERT(D3D9PackSamplerKey(c) != D3D9PackSamplerKey(d), "Anisotropy ignored");
+
+    D3D9SamplerState e = b;
+    e.addressV = 4;  // D3DTADDRESS_BORDER
+    D3D9SamplerState f = e;
+    f.borderColor = 0xffffffff;
+    TEST_ASSERT(D3D9PackSamplerKey(e) != D3D9PackSamplerKey(f), "Border color ignored");
+
+    // LOD bias rounds to 1/4 and clamps
+    D3D9SamplerState g = a;
+    g.mipLodBias = 0.3f;
+    D3D9SamplerState h = a;
+    h.mipLodBias = 0.2f;
+    TEST_ASSERT(D3D9PackSamplerKey(g) == D3D9PackSamplerKey(h), "LOD bias not rounded");
+    g.mipLodBias = 100.0f;
+    TEST_ASSERT(D3D9UnpackSamplerKey(D3D9PackSamplerKey(g)).mipLodBias == 15.75f, "LOD bias not clamped");
+
+    // Keys are never zero, zero marks free map entries
+    D3D9SamplerState zero;
+    zero.addressU = zero.addressV = zero.addressW = 0;
+    zero.magFilter = zero.minFilter = 0;
+    zero.maxAnisotropy = 0;
+    TEST_ASSERT(D3D9PackSamplerKey(zero) != 0, "Zero key");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Pack/unpack round trip
+ * ============================================ */
+int test_sampler_key_roundtrip(void) {
+    printf("TEST: sampler_key_roundtrip\n");
+
+    uint32_t checked = 0;
+
+    for (uint32_t u = 1; u <= 5; u++)
+    for (uint32_t v = 1; v <= 5; v++)
+    for (uint32_t mag = 0; mag <= 3; mag++)
+    for (uint32_t min = 0; min <= 3; min++)
+    for (uint32_t mip = 0; mip <= 2; mip++)
+    for (uint32_t aniso = 1; aniso <= 16; aniso *= 2) {
+        D3D9SamplerState s;
+        s.addressU = u;
+        s.addressV = v;
+        s.addressW = 3;
+        s.magFilter = mag;
+        s.minFilter = min;
+        s.mipFilter = mip;
+        s.maxAnisotropy = aniso;
+        s.maxMipLevel = (u + v) & 15;
+        s.mipLodBias = -1.25f;
+        s.borderColor = 0x80402010;
+        s.depthCompare = mip & 1;
+
+        D3D9SamplerKey key = D3D9PackSamplerKey(s);
+        D3D9SamplerState r = D3D9UnpackSamplerKey(key);
+
+        TEST_ASSERT(D3D9PackSamplerKey(r) == key, "Unpacked state packs to another key");
+        TEST_ASSERT(r.addressU == u && r.addressV == v && r.addressW == 3, "Address modes lost");
+        TEST_ASSERT(r.magFilter == mag && r.minFilter == min && r.mipFilter == mip, "Filters lost");
+        TEST_ASSERT(r.mipLodBias == -1.25f && r.maxMipLevel == s.maxMipLevel, "LOD state lost");
+        TEST_ASSERT(r.depthCompare == s.depthCompare, "Depth compare lost");
+
+        bool isAniso = mag == 3 || min == 3;
+        TEST_ASSERT(r.maxAnisotropy == (isAniso ? aniso : 1), "Anisotropy not normalized");
+
+        bool isBorder = u == 4 || v == 4;
+        TEST_ASSERT(r.borderColor == (isBorder ? 0x80402010 : 0), "Border color not normalized");
+        checked++;
+    }
+
+    TEST_ASSERT(checked == 5 * 5 * 4 * 4 * 3 * 5, "Not all states checked");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+static D3D9SamplerKey test_key(uint32_t i) {
+    D3D9SamplerState s;
+    s.maxMipLevel = i & 15;
+    s.addressU = 1 + (i >> 4) % 5;
+    s.addressV = 1 + (i >> 4) / 5 % 5;
+    s.mipLodBias = float(int32_t(i >> 4) / 25) * 0.25f - 8.0f;
+    return D3D9PackSamplerKey(s);
+}
+
+/* ============================================
+ * Test: Hits
+ * ============================================ */
+int test_sampler_cache_hit(void) {
+    printf("TEST: sampler_cache_hit\n");
+
+    std::vector<D3D9SamplerKey> heap(16, 0);
+    uint32_t writes = 0;
+
+    D3D9SamplerCacheOptions options;
+    options.heapSize = 16;
+    D3D9SamplerCache cache(options, [&] (uint32_t slot, D3D9SamplerKey key) {
+        heap[slot] = key;
+        writes++;
+    });
+
+    uint32_t slots[8];
+    for (uint32_t i = 0; i < 8; i++)
+        slots[i] = cache.Lookup(test_key(i));
+
+    for (uint32_t pass = 0; pass < 100; pass++) {
+        for (uint32_t i = 0; i < 8; i++) {
+            uint32_t slot = cache.Lookup(test_key(i));
+            TEST_ASSERT(slot == slots[i], "Hit returned another slot");
+            TEST_ASSERT(heap[slot] == test_key(i), "Slot holds another sampler");
+        }
+    }
+
+    D3D9SamplerCacheStats stats = cache.GetStats();
+    TEST_ASSERT(writes == 8 && stats.misses == 8, "Descriptor written more than once");
+    TEST_ASSERT(stats.keys == 8 && stats.evictions == 0, "Unexpected key or eviction count");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: LRU reuse
+ * ============================================ */
+int test_sampler_cache_lru(void) {
+    printf("TEST: sampler_cache_lru\n");
+
+    std::vector<D3D9SamplerKey> heap(4, 0);
+
+    D3D9SamplerCacheOptions options;
+    options.heapSize = 4;
+    options.frameLatency = 2;
+    D3D9SamplerCache cache(options, [&] (uint32_t slot, D3D9SamplerKey key) { heap[slot] = key; });
+
+    // Frame 1: fill the heap
+    uint32_t slots[4];
+    for (uint32_t i = 0; i < 4; i++)
+        slots[i] = cache.Lookup(test_key(i));
+
+    // All slots were used this frame, nothing can be evicted
+    TEST_ASSERT(cache.Lookup(test_key(10)) == D3D9SamplerCache::InvalidSlot, "Evicted a slot in use");
+    TEST_ASSERT(cache.GetStats().overflows == 1, "Overflow not counted");
+
+    // Keys 1..3 stay hot, key 0 goes cold
+    for (uint32_t f = 0; f < 3; f++) {
+        cache.EndFrame();
+        for (uint32_t i = 1; i < 4; i++)
+            cache.Lookup(test_key(i));
+    }
+
+    uint32_t slot = cache.Lookup(test_key(10));
+    TEST_ASSERT(slot == slots[0], "Least recently used slot not reused");
+    TEST_ASSERT(heap[slot] == test_key(10), "Reused slot not rewritten");
+    TEST_ASSERT(cache.GetStats().evictions == 1, "Eviction not counted");
+
+    // Key 0 lost its slot, and every other slot is hot again
+    TEST_ASSERT(cache.Lookup(test_key(0)) == D3D9SamplerCache::InvalidSlot, "Evicted key still resident");
+
+    // Once everything cooled down, key 0 gets a slot again
+    for (uint32_t f = 0; f < 3; f++)
+        cache.EndFrame();
+
+    slot = cache.Lookup(test_key(0));
+    TEST_ASSERT(slot != D3D9SamplerCache::InvalidSlot && heap[slot] == test_key(0), "Evicted key not restored");
+
+    for (uint32_t i = 0; i < 4; i++) {
+        if (i != slot)
+            TEST_ASSERT(heap[i] != test_key(0), "Key resident in two slots");
+    }
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Concurrent lookups
+ * ============================================ */
+int test_sampler_cache_threads(void) {
+    printf("TEST: sampler_cache_threads\n");
+
+    const uint32_t keyCount = 200;
+    const uint32_t threadCount = 4;
+
+    std::vector<std::atomic<uint64_t>> heap(256);
+    for (auto& h : heap)
+        h = 0;
+    std::atomic<uint32_t> writes = { 0 };
+
+    D3D9SamplerCacheOptions options;
+    options.heapSize = 256;
+    D3D9SamplerCache cache(options, [&] (uint32_t slot, D3D9SamplerKey key) {
+        heap[slot].store(key);
+        writes++;
+    });
+
+    std::vector<std::vector<uint32_t>> results(threadCount, std::vector<uint32_t>(keyCount));
+    std::atomic<bool> mismatch = { false };
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t] {
+            for (uint32_t pass = 0; pass < 50; pass++) {
+                for (uint32_t i = 0; i < keyCount; i++) {
+                    uint32_t k = (i * (t + 1) * 7 + pass) % keyCount;
+                    uint32_t slot = cache.Lookup(test_key(k));
+
+                    if (slot == D3D9SamplerCache::InvalidSlot || heap[slot].load() != test_key(k))
+                        mismatch = true;
+
+                    results[t][k] = slot;
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT(!mismatch, "Lookup returned a slot holding another sampler");
+    TEST_ASSERT(writes == keyCount, "Descriptor written more than once per key");
+
+    std::set<uint32_t> unique(results[0].begin(), results[0].end());
+    TEST_ASSERT(unique.size() == keyCount, "Two keys share a slot");
+
+    for (uint32_t t = 1; t < threadCount; t++)
+        TEST_ASSERT(results[t] == results[0], "Threads disagree on a slot");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Sampler Cache Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_sampler_key_normalize()) passed++; else failed++;
+    if (test_sampler_key_roundtrip()) passed++; else failed++;
+    if (test_sampler_cache_hit()) passed++; else failed++;
+    if (test_sampler_cache_lru()) passed++; else failed++;
+    if (test_sampler_cache_threads()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
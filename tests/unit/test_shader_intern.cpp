@@ -0,0 +1,363 @@
+/*
+ * Shader Intern Table Test Suite
+ *
+ * These tests verify the shader bytecode intern table
+ * (src/d3d9/d3d9_shader_intern.h): bytecode sizing, one translation
+ * per distinct bytecode when a creation trace is replayed, from one
+ * thread and from several, full compares on hash collisions, and
+ * failed translations.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_shader_bytecode_size - Is the end token found for SM1-3?
+ * 2. test_shader_intern_trace - Is each distinct bytecode translated once?
+ * 3. test_shader_intern_threads - Do concurrent creations share a translation?
+ * 4. test_shader_intern_collisions - Are colliding hashes told apart?
+ * 5. test_shader_intern_failures - Are failed translations cached or retried?
+ */
+
+#include "d3d9/d3d9_shader_intern.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* What the device keeps per shader: the compiled module and the
+ * descriptor metadata the draw path reads */
+struct CompiledShader {
+    uint32_t              id;
+    std::vector<uint32_t> bindings;
+};
+
+static uint32_t lcg(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+/* SM3 bytecode: version, a constant table comment, defs, movs, end */
+static std::vector<uint32_t> make_shader(bool ps, uint32_t seed) {
+    uint32_t state = seed * 2654435761u + 1;
+    std::vector<uint32_t> code = { ps ? 0xffff0300u : 0xfffe0300u };
+
+    uint32_t comment = 1 + lcg(state) % 6;
+    code.push_back((comment << 16) | 0xfffe);
+    for (uint32_t i = 0; i < comment; i++)
+        code.push_back(lcg(state));
+
+    uint32_t defs = lcg(state) % 3;
+    for (uint32_t i = 0; i < defs; i++) {
+        code.push_back(0x51u | (5u << 24));
+        code.push_back(0xa00f0000u | (200 + i));
+        for (uint32_t j = 0; j < 4; j++)
+            code.push_back(lcg(state));
+    }
+
+    uint32_t instructions = 4 + lcg(state) % 24;
+    for (uint32_t i = 0; i < instructions; i++) {
+        code.push_back(0x1u | (2u << 24));
+        code.push_back(0x800f0000u | (lcg(state) % 16));
+        code.push_back(0x80e40000u | (lcg(state) % 16));
+    }
+
+    code.push_back(0x0000ffffu);
+    return code;
+}
+
+/* Creation trace: every shader created once per material
+ * instance, in a shuffled order */
+struct Trace {
+    std::vector<std::vector<uint32_t>> shaders;
+    std::vector<uint32_t>              creates;
+};
+
+static Trace make_trace(uint32_t count) {
+    Trace trace;
+    uint32_t state = 7;
+
+    for (uint32_t i = 0; i < count; i++) {
+        trace.shaders.push_back(make_shader(i & 1, i));
+
+        uint32_t instances = 1 + lcg(state) % 12;
+        for (uint32_t j = 0; j < instances; j++)
+            trace.creates.push_back(i);
+    }
+
+    for (size_t i = trace.creates.size() - 1; i > 0; i--)
+        std::swap(trace.creates[i], trace.creates[lcg(state) % (i + 1)]);
+
+    return trace;
+}
+
+/* ============================================
+ * Test: Bytecode size
+ * ============================================ */
+int test_shader_bytecode_size(void) {
+    printf("TEST: shader_bytecode_size\n");
+
+    std::vector<uint32_t> sm3 = make_shader(true, 3);
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(sm3.data()) == sm3.size(), "SM3 size");
+
+    // The end token inside a comment or a def is not the end
+    std::vector<uint32_t> tricky = { 0xfffe0200u, (2u << 16) | 0xfffe, 0x0000ffffu, 0,
+        0x51u | (5u << 24), 0xa00f0000u, 0x0000ffffu, 0, 0, 0, 0x0000ffffu };
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(tricky.data()) == tricky.size(), "End token in data");
+
+    // vs_1_1: dp4 oPos.x, v0, c0 / def c1, 0xffff, ... / mov oD0, v1
+    std::vector<uint32_t> sm1 = { 0xfffe0101u,
+        0x09u, 0xc0010000u, 0x90e40000u, 0xa0e40000u,
+        0x51u, 0xa00f0001u, 0x0000ffffu, 0, 0, 0,
+        0x01u, 0xd00f0000u, 0x90e40001u,
+        0x0000ffffu };
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(sm1.data()) == sm1.size(), "SM1 size");
+
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(sm3.data(), sm3.size() - 1) == 0, "Missing end token");
+
+    uint32_t bad[] = { 0x00000300u, 0x0000ffffu };
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(bad) == 0, "Bad version token");
+    bad[0] = 0xffff0400u;
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(bad) == 0, "Unknown shader model");
+    TEST_ASSERT(D3D9GetShaderBytecodeSize(nullptr) == 0, "Null bytecode");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Trace replay
+ * ============================================ */
+int test_shader_intern_trace(void) {
+    printf("TEST: shader_intern_trace\n");
+
+    Trace trace = make_trace(120);
+    D3D9ShaderInternTable<CompiledShader> table;
+    uint32_t translated = 0;
+
+    std::vector<const CompiledShader*> byShader(trace.shaders.size(), nullptr);
+    uint64_t bytesTotal = 0;
+
+    for (uint32_t index : trace.creates) {
+        // The game's copy, as CreateVertexShader sees it
+        std::vector<uint32_t> code = trace.shaders[index];
+        size_t dwords = D3D9GetShaderBytecodeSize(code.data());
+        TEST_ASSERT(dwords == code.size(), "Bytecode size");
+
+        const CompiledShader* shader = table.Intern(code.data(), dwords,
+          [&] (const uint32_t* c, size_t n) {
+            translated++;
+            auto s = std::make_unique<CompiledShader>();
+            s->id = index;
+            s->bindings.assign(c + 1, c + std::min<size_t>(n, 4));
+            return s;
+          });
+
+        TEST_ASSERT(shader && shader->id == index, "Wrong shader");
+        TEST_ASSERT(!byShader[index] || byShader[index] == shader, "Duplicate translated again");
+        byShader[index] = shader;
+        bytesTotal += dwords * sizeof(uint32_t);
+    }
+
+    uint64_t bytesUnique = 0;
+    for (const auto& s : trace.shaders)
+        bytesUnique += s.size() * sizeof(uint32_t);
+
+    D3D9ShaderInternStats stats = table.GetStats();
+    TEST_ASSERT(translated == trace.shaders.size(), "Translations != unique bytecode");
+    TEST_ASSERT(stats.translations == translated && stats.shaders == translated, "Translation stats");
+    TEST_ASSERT(stats.creations == trace.creates.size(), "Creation count");
+    TEST_ASSERT(stats.duplicates == trace.creates.size() - trace.shaders.size(), "Duplicate count");
+    TEST_ASSERT(stats.bytesSaved == bytesTotal - bytesUnique, "Bytes saved");
+    TEST_ASSERT(stats.collisions == 0, "Unexpected collisions");
+
+    printf("  %zu creations, %u translations, %llu bytes saved\n",
+        trace.creates.size(), translated, (unsigned long long)stats.bytesSaved);
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Concurrent creations
+ * ============================================ */
+int test_shader_intern_threads(void) {
+    printf("TEST: shader_intern_threads\n");
+
+    Trace trace = make_trace(40);
+
+    // Every thread replays the trace from a different point, so
+    // new bytecode is regularly created by several at once
+    D3D9ShaderInternTable<CompiledShader> racing;
+    std::atomic<uint32_t> raced = { 0 };
+    std::atomic<uint32_t> mismatches = { 0 };
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < 8; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t n = 0; n < trace.creates.size(); n++) {
+                uint32_t index = trace.creates[(n + t * 17) % trace.creates.size()];
+                const auto& code = trace.shaders[index];
+
+                const CompiledShader* s = racing.Intern(code.data(), code.size(),
+                  [&] (const uint32_t*, size_t) {
+                    raced++;
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    return std::make_unique<CompiledShader>(CompiledShader { index, { } });
+                  });
+
+                if (!s || s->id != index)
+                    mismatches++;
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    D3D9ShaderInternStats stats = racing.GetStats();
+    TEST_ASSERT(mismatches == 0, "Wrong shader returned");
+    TEST_ASSERT(raced == trace.shaders.size(), "Concurrent creations translated twice");
+    TEST_ASSERT(stats.translations == raced && stats.creations == 8 * trace.creates.size(), "Stats");
+    TEST_ASSERT(stats.duplicates + stats.translations == stats.creations, "Duplicates");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Hash collisions
+ * ============================================ */
+struct LengthOnlyHash {
+    uint64_t operator () (const uint32_t*, size_t dwords) const {
+        return dwords;
+    }
+};
+
+int test_shader_intern_collisions(void) {
+    printf("TEST: shader_intern_collisions\n");
+
+    D3D9ShaderInternTable<CompiledShader, LengthOnlyHash> table;
+    uint32_t translated = 0;
+
+    auto intern = [&] (const std::vector<uint32_t>& code, uint32_t id) {
+        return table.Intern(code.data(), code.size(), [&] (const uint32_t*, size_t) {
+            translated++;
+            return std::make_unique<CompiledShader>(CompiledShader { id, { } });
+        });
+    };
+
+    // Same length, differing in one constant
+    std::vector<uint32_t> a = make_shader(false, 11);
+    std::vector<uint32_t> b = a;
+    b[b.size() - 2] ^= 1;
+    std::vector<uint32_t> c = a;
+    c[0] = 0xffff0300u;
+
+    const CompiledShader* sa = intern(a, 1);
+    const CompiledShader* sb = intern(b, 2);
+    const CompiledShader* sc = intern(c, 3);
+    TEST_ASSERT(sa->id == 1 && sb->id == 2 && sc->id == 3, "Colliding bytecode shared");
+
+    TEST_ASSERT(intern(b, 9) == sb && intern(a, 9) == sa && intern(c, 9) == sc, "Lookup after collision");
+    TEST_ASSERT(translated == 3, "Translations");
+
+    D3D9ShaderInternStats stats = table.GetStats();
+    TEST_ASSERT(stats.collisions == 2 && stats.duplicates == 3 && stats.shaders == 3, "Collision stats");
+
+    // Different length is a different key, no compare
+    std::vector<uint32_t> d = a;
+    d.insert(d.end() - 1, { 0x1u | (2u << 24), 0x800f0000u, 0x80e40000u });
+    TEST_ASSERT(intern(d, 4)->id == 4 && table.GetStats().collisions == 2, "Longer bytecode compared");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Failed translations
+ * ============================================ */
+int test_shader_intern_failures(void) {
+    printf("TEST: shader_intern_failures\n");
+
+    D3D9ShaderInternTable<CompiledShader> table;
+    std::vector<uint32_t> code = make_shader(true, 5);
+    uint32_t calls = 0;
+
+    // Rejected bytecode is rejected again without translating
+    auto reject = [&] (const uint32_t*, size_t) {
+        calls++;
+        return std::unique_ptr<CompiledShader>();
+    };
+
+    TEST_ASSERT(!table.Intern(code.data(), code.size(), reject), "Rejected shader returned");
+    TEST_ASSERT(!table.Intern(code.data(), code.size(), reject) && calls == 1, "Rejection not cached");
+
+    // A throwing translation is retried by the next creation
+    std::vector<uint32_t> other = make_shader(true, 6);
+    bool threw = false;
+
+    try {
+        table.Intern(other.data(), other.size(), [&] (const uint32_t*, size_t) -> std::unique_ptr<CompiledShader> {
+            throw std::runtime_error("out of memory");
+        });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+
+    TEST_ASSERT(threw, "Exception swallowed");
+    TEST_ASSERT(table.GetStats().shaders == 1, "Failed entry kept");
+
+    const CompiledShader* s = table.Intern(other.data(), other.size(), [&] (const uint32_t*, size_t) {
+        return std::make_unique<CompiledShader>(CompiledShader { 6, { } });
+    });
+
+    TEST_ASSERT(s && s->id == 6 && table.GetStats().shaders == 2, "Not retried");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Shader Intern Table Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_shader_bytecode_size()) passed++; else failed++;
+    if (test_shader_intern_trace()) passed++; else failed++;
+    if (test_shader_intern_threads()) passed++; else failed++;
+    if (test_shader_intern_collisions()) passed++; else failed++;
+    if (test_shader_intern_failures()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
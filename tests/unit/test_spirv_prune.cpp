@@ -0,0 +1,415 @@
+/*
+ * SPIR-V Binding Pruning Test Suite
+ *
+ * These tests verify the unused binding pass
+ * (src/dxvk/dxvk_spirv_prune.h): resource variables without loads
+ * are removed along with their names, decorations and entry point
+ * interface entries, everything else is kept word for word, and the
+ * reported masks match what the module uses.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_prune_unused_images - Are unsampled color/depth images removed?
+ * 2. test_prune_entry_point - Are SPIR-V 1.4 interface lists rewritten?
+ * 3. test_prune_conservative - Are ambiguous and invalid modules kept?
+ * 4. test_prune_binding_infos - Do the masks prune binding infos?
+ */
+
+#include "dxvk/dxvk_spirv_prune.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <initializer_list>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* ============================================
+ * Module builder
+ * ============================================ */
+enum : uint32_t {
+    OpName = 5, OpMemoryModel = 14, OpEntryPoint = 15, OpExecutionMode = 16, OpCapability = 17,
+    OpTypeVoid = 19, OpTypeFloat = 22, OpTypeVector = 23, OpTypeImage = 25, OpTypeSampledImage = 27,
+    OpTypeStruct = 30, OpTypePointer = 32, OpTypeFunction = 33, OpConstant = 43,
+    OpFunction = 54, OpFunctionEnd = 56, OpVariable = 59, OpLoad = 61, OpStore = 62,
+    OpAccessChain = 65, OpDecorate = 71, OpLabel = 248, OpReturn = 253,
+};
+
+enum : uint32_t {
+    UniformConstant = 0, Input = 1, Uniform = 2, Output = 3, Function = 7,
+};
+
+struct Module {
+    std::vector<uint32_t> code = { 0x07230203u, 0x00010400u, 0, 0, 0 };
+    uint32_t next = 100;  // keep ids clear of the literals below
+
+    uint32_t id() {
+        code[3] = ++next;
+        return next - 1;
+    }
+
+    void op(uint32_t opcode, std::initializer_list<uint32_t> words) {
+        code.push_back(((uint32_t(words.size()) + 1) << 16) | opcode);
+        code.insert(code.end(), words.begin(), words.end());
+    }
+
+    void name(uint32_t target, const char* str) {
+        std::vector<uint32_t> words = { target };
+        size_t len = strlen(str);
+        for (size_t i = 0; i <= len; i += 4) {
+            uint32_t w = 0;
+            for (size_t j = 0; j < 4 && i + j < len; j++)
+                w |= uint32_t(uint8_t(str[i + j])) << (8 * j);
+            words.push_back(w);
+        }
+        code.push_back(((uint32_t(words.size()) + 1) << 16) | OpName);
+        code.insert(code.end(), words.begin(), words.end());
+    }
+};
+
+/* Instructions of a module as (opcode, operands) */
+struct Inst {
+    uint32_t op;
+    std::vector<uint32_t> words;
+};
+
+static bool parse(const std::vector<uint32_t>& code, std::vector<Inst>& out) {
+    out.clear();
+    size_t pos = 5;
+    while (pos < code.size()) {
+        uint32_t n = code[pos] >> 16;
+        if (!n || pos + n > code.size())
+            return false;
+        out.push_back({ code[pos] & 0xffff, std::vector<uint32_t>(&code[pos + 1], &code[pos + n]) });
+        pos += n;
+    }
+    return true;
+}
+
+static bool mentions(const std::vector<Inst>& insts, uint32_t id) {
+    for (const auto& i : insts) {
+        for (uint32_t w : i.words) {
+            if (w == id)
+                return true;
+        }
+    }
+    return false;
+}
+
+/* A pixel shader the way DxsoCompiler declares samplers with the
+ * doubled layout: color and depth image per sampler, plus the
+ * fixed function and shared constant buffers */
+struct PixelShader {
+    Module m;
+    uint32_t main, color[4], depth[4], ffData, shared, outColor;
+};
+
+static PixelShader build_ps(std::initializer_list<uint32_t> sampled, bool useShared, bool interface14) {
+    PixelShader ps;
+    Module& m = ps.m;
+
+    uint32_t tVoid = m.id(), tFn = m.id(), tFloat = m.id(), tVec4 = m.id();
+    uint32_t tImage = m.id(), tDepthImage = m.id(), tSampled = m.id(), tSampledDepth = m.id();
+    uint32_t tPtrImage = m.id(), tPtrDepthImage = m.id();
+    uint32_t tStruct = m.id(), tPtrStruct = m.id(), tPtrOut = m.id();
+
+    ps.main = m.id();
+    for (uint32_t i = 0; i < 4; i++) {
+        ps.color[i] = m.id();
+        ps.depth[i] = m.id();
+    }
+    ps.ffData = m.id();
+    ps.shared = m.id();
+    ps.outColor = m.id();
+
+    m.op(OpCapability, { 1 });
+    m.op(OpMemoryModel, { 0, 1 });
+
+    std::vector<uint32_t> entry = { 4, ps.main, 0x6e69616du, 0 };
+    entry.push_back(ps.outColor);
+    if (interface14) {
+        for (uint32_t i = 0; i < 4; i++) {
+            entry.push_back(ps.color[i]);
+            entry.push_back(ps.depth[i]);
+        }
+        entry.push_back(ps.ffData);
+        entry.push_back(ps.shared);
+    }
+    m.code.push_back(((uint32_t(entry.size()) + 1) << 16) | OpEntryPoint);
+    m.code.insert(m.code.end(), entry.begin(), entry.end());
+    m.op(OpExecutionMode, { ps.main, 7 });
+
+    m.name(ps.main, "main");
+    for (uint32_t i = 0; i < 4; i++) {
+        m.name(ps.color[i], "s_2d");
+        m.name(ps.depth[i], "s_2d_shadow");
+    }
+    m.name(ps.shared, "SharedData");
+
+    for (uint32_t i = 0; i < 4; i++) {
+        m.op(OpDecorate, { ps.color[i], 34, 0 });
+        m.op(OpDecorate, { ps.color[i], 33, 17 + i });
+        m.op(OpDecorate, { ps.depth[i], 34, 0 });
+        m.op(OpDecorate, { ps.depth[i], 33, 33 + i });
+    }
+    m.op(OpDecorate, { ps.ffData, 34, 0 });
+    m.op(OpDecorate, { ps.ffData, 33, 15 });
+    m.op(OpDecorate, { ps.shared, 34, 0 });
+    m.op(OpDecorate, { ps.shared, 33, 16 });
+    m.op(OpDecorate, { ps.outColor, 30, 0 });
+
+    m.op(OpTypeVoid, { tVoid });
+    m.op(OpTypeFunction, { tFn, tVoid });
+    m.op(OpTypeFloat, { tFloat, 32 });
+    m.op(OpTypeVector, { tVec4, tFloat, 4 });
+    m.op(OpTypeImage, { tImage, tFloat, 1, 0, 0, 0, 1, 0 });
+    m.op(OpTypeImage, { tDepthImage, tFloat, 1, 1, 0, 0, 1, 0 });
+    m.op(OpTypeSampledImage, { tSampled, tImage });
+    m.op(OpTypeSampledImage, { tSampledDepth, tDepthImage });
+    m.op(OpTypePointer, { tPtrImage, UniformConstant, tImage });
+    m.op(OpTypePointer, { tPtrDepthImage, UniformConstant, tDepthImage });
+    m.op(OpTypeStruct, { tStruct, tVec4 });
+    m.op(OpTypePointer, { tPtrStruct, Uniform, tStruct });
+    m.op(OpTypePointer, { tPtrOut, Output, tVec4 });
+
+    for (uint32_t i = 0; i < 4; i++) {
+        m.op(OpVariable, { tPtrImage, ps.color[i], UniformConstant });
+        m.op(OpVariable, { tPtrDepthImage, ps.depth[i], UniformConstant });
+    }
+    m.op(OpVariable, { tPtrStruct, ps.ffData, Uniform });
+    m.op(OpVariable, { tPtrStruct, ps.shared, Uniform });
+    m.op(OpVariable, { tPtrOut, ps.outColor, Output });
+
+    m.op(OpFunction, { tVoid, ps.main, 0, tFn });
+    m.op(OpLabel, { m.id() });
+
+    // Sampled: both the color and the depth path are loaded, the
+    // sampler's depth spec constant picks one at pipeline compile
+    for (uint32_t s : sampled) {
+        m.op(OpLoad, { tImage, m.id(), ps.color[s] });
+        m.op(OpLoad, { tDepthImage, m.id(), ps.depth[s] });
+    }
+
+    uint32_t chain = m.id();
+    m.op(OpAccessChain, { tPtrOut, chain, ps.ffData, 0 });
+    if (useShared)
+        m.op(OpAccessChain, { tPtrOut, m.id(), ps.shared, 0 });
+
+    uint32_t value = m.id();
+    m.op(OpLoad, { tVec4, value, chain });
+    m.op(OpStore, { ps.outColor, value });
+    m.op(OpReturn, { });
+    m.op(OpFunctionEnd, { });
+    return ps;
+}
+
+/* ============================================
+ * Test: Unused images
+ * ============================================ */
+int test_prune_unused_images(void) {
+    printf("TEST: prune_unused_images\n");
+
+    PixelShader ps = build_ps({ 0, 2 }, false, false);
+    std::vector<uint32_t> code = ps.m.code;
+    size_t size = code.size();
+
+    DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+    TEST_ASSERT(usage.valid, "Module rejected");
+    TEST_ASSERT(usage.bindings.size() == 10, "Resource variable count");
+    TEST_ASSERT(usage.declared[0].count() == 10 && usage.used[0].count() == 5, "Binding counts");
+    TEST_ASSERT(usage.removed == 5, "Removed variables");
+
+    TEST_ASSERT(usage.isUsed(0, 17) && usage.isUsed(0, 33) && usage.isUsed(0, 19) && usage.isUsed(0, 35), "Sampled images");
+    TEST_ASSERT(!usage.isUsed(0, 18) && !usage.isUsed(0, 34) && usage.isDeclared(0, 18), "Unsampled images");
+    TEST_ASSERT(usage.isUsed(0, 15) && !usage.isUsed(0, 16), "Constant buffers");
+    TEST_ASSERT(!usage.isDeclared(1, 17), "Wrong set");
+
+    std::vector<Inst> insts;
+    TEST_ASSERT(parse(code, insts), "Pruned module malformed");
+    TEST_ASSERT(code.size() < size && memcmp(code.data(), ps.m.code.data(), 20) == 0, "Header changed");
+
+    // Dead variables have no trace left, live ones are intact
+    const uint32_t dead[] = { ps.color[1], ps.depth[1], ps.color[3], ps.depth[3], ps.shared };
+    for (uint32_t id : dead)
+        TEST_ASSERT(!mentions(insts, id), "Dead variable still referenced");
+
+    const uint32_t live[] = { ps.color[0], ps.depth[0], ps.color[2], ps.depth[2], ps.ffData, ps.outColor };
+    for (uint32_t id : live) {
+        uint32_t decorations = 0, variables = 0;
+        for (const auto& i : insts) {
+            decorations += i.op == OpDecorate && i.words[0] == id;
+            variables += i.op == OpVariable && i.words[1] == id;
+        }
+        TEST_ASSERT(variables == 1 && decorations >= 1, "Live variable damaged");
+    }
+
+    // Pruning is idempotent
+    std::vector<uint32_t> again = code;
+    DxvkSpirvBindingUsage second = DxvkSpirvBindingPruner::prune(again);
+    TEST_ASSERT(again == code && second.removed == 0 && second.used[0] == usage.used[0], "Second pass changed module");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Entry point interface
+ * ============================================ */
+int test_prune_entry_point(void) {
+    printf("TEST: prune_entry_point\n");
+
+    PixelShader ps = build_ps({ 1 }, true, true);
+    std::vector<uint32_t> code = ps.m.code;
+
+    DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+    TEST_ASSERT(usage.valid && usage.removed == 6, "Removed variables");
+
+    std::vector<Inst> insts;
+    TEST_ASSERT(parse(code, insts), "Pruned module malformed");
+
+    const Inst* entry = nullptr;
+    for (const auto& i : insts) {
+        if (i.op == OpEntryPoint)
+            entry = &i;
+    }
+
+    // Model, function, "main" + terminator, then the interface
+    TEST_ASSERT(entry && entry->words.size() == 4 + 5, "Interface length");
+    TEST_ASSERT(entry->words[2] == 0x6e69616du && entry->words[3] == 0, "Name damaged");
+
+    const uint32_t expected[] = { ps.outColor, ps.color[1], ps.depth[1], ps.ffData, ps.shared };
+    TEST_ASSERT(memcmp(&entry->words[4], expected, sizeof(expected)) == 0, "Interface ids");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Conservative cases
+ * ============================================ */
+int test_prune_conservative(void) {
+    printf("TEST: prune_conservative\n");
+
+    // Everything used: unchanged
+    PixelShader full = build_ps({ 0, 1, 2, 3 }, true, false);
+    std::vector<uint32_t> code = full.m.code;
+    DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+    TEST_ASSERT(usage.valid && usage.removed == 0 && code == full.m.code, "Fully used module changed");
+    TEST_ASSERT(usage.declared[0] == usage.used[0], "Masks differ");
+
+    // A literal equal to a dead variable's id keeps it
+    PixelShader lit = build_ps({ 0 }, false, false);
+    lit.m.code.insert(lit.m.code.end() - 1, { (4u << 16) | OpConstant, 3, lit.m.id(), lit.depth[3] });
+    code = lit.m.code;
+    usage = DxvkSpirvBindingPruner::prune(code);
+    TEST_ASSERT(usage.isUsed(0, 36) && !usage.isUsed(0, 20), "Literal not treated as a use");
+
+    // Invalid modules are left alone
+    std::vector<uint32_t> bad = full.m.code;
+    bad[0] = 0xdeadbeef;
+    std::vector<uint32_t> copy = bad;
+    TEST_ASSERT(!DxvkSpirvBindingPruner::prune(copy).valid && copy == bad, "Bad magic accepted");
+
+    bad = full.m.code;
+    bad.resize(bad.size() - 1);
+    bad.back() = 0;  // zero word count
+    copy = bad;
+    TEST_ASSERT(!DxvkSpirvBindingPruner::prune(copy).valid && copy == bad, "Malformed module accepted");
+
+    std::vector<uint32_t> empty;
+    TEST_ASSERT(!DxvkSpirvBindingPruner::prune(empty).valid, "Empty module accepted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Binding infos and masks
+ * ============================================ */
+struct BindingInfo {
+    uint32_t set;
+    uint32_t binding;
+};
+
+int test_prune_binding_infos(void) {
+    printf("TEST: prune_binding_infos\n");
+
+    PixelShader ps = build_ps({ 2 }, true, false);
+    std::vector<uint32_t> code = ps.m.code;
+    DxvkSpirvBindingUsage usage = DxvkSpirvBindingPruner::prune(code);
+
+    // What DxsoCompiler put in m_bindings, plus the spec constant
+    // buffer which the module does not declare here
+    std::vector<BindingInfo> infos;
+    for (uint32_t i = 0; i < 4; i++) {
+        infos.push_back({ 0, 17 + i });
+        infos.push_back({ 0, 33 + i });
+    }
+    infos.push_back({ 0, 15 });
+    infos.push_back({ 0, 16 });
+    infos.push_back({ 0, 51 });
+
+    infos.erase(std::remove_if(infos.begin(), infos.end(), [&] (const BindingInfo& b) {
+        return usage.isDeclared(b.set, b.binding) && !usage.isUsed(b.set, b.binding);
+    }), infos.end());
+
+    TEST_ASSERT(infos.size() == 5, "Binding infos left");
+
+    // The device only binds what is dirty and used
+    DxvkBindingMask dirty;
+    for (uint32_t b = 15; b < 52; b++)
+        dirty.set(b);
+
+    DxvkBindingMask bind = dirty & usage.used[0];
+    TEST_ASSERT(bind.count() == 4 && bind.test(19) && bind.test(35) && !bind.test(17), "Bound slots");
+
+    DxvkBindingMask m;
+    m.set(0); m.set(63); m.set(64); m.set(255); m.set(256);
+    TEST_ASSERT(m.count() == 4 && m.test(255) && !m.test(256), "Mask bounds");
+    m.clr(63);
+    TEST_ASSERT(!m.test(63) && (m | bind).count() == 7 && m.any() && !DxvkBindingMask().any(), "Mask ops");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("SPIR-V Binding Pruning Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 4;
+
+    if (test_prune_unused_images()) passed++; else failed++;
+    if (test_prune_entry_point()) passed++; else failed++;
+    if (test_prune_conservative()) passed++; else failed++;
+    if (test_prune_binding_infos()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
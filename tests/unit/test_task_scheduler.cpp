@@ -0,0 +1,356 @@
+/*
+ * Task Scheduler Test Suite
+ *
+ * These tests verify the work-stealing deque and task scheduler
+ * (src/util/task/): every item is taken exactly once, dependency
+ * graphs run in order, priorities are inherited along dependencies
+ * and waiting threads help out.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_task_deque_order - LIFO for the owner, FIFO for thieves, growth?
+ * 2. test_task_deque_concurrent - Is each item taken exactly once?
+ * 3. test_task_dependency_graph - Does a random DAG run in dependency order?
+ * 4. test_task_priority_inheritance - Does an idle dependency jump the queue?
+ * 5. test_task_wait_helps - Does a waiter run the task with all workers busy?
+ * 6. test_task_nested_spawn - Do tasks spawned by tasks all run?
+ */
+
+#include "util/task/task_scheduler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* Blocks a worker until opened */
+struct Gate {
+    std::atomic<bool> open = { false };
+    std::atomic<bool> entered = { false };
+
+    void block() {
+        entered = true;
+        while (!open)
+            std::this_thread::yield();
+    }
+
+    void waitEntered() {
+        while (!entered)
+            std::this_thread::yield();
+    }
+};
+
+/* ============================================
+ * Test: Deque ordering and growth
+ * ============================================ */
+int test_task_deque_order(void) {
+    printf("TEST: task_deque_order\n");
+
+    TaskDeque<uintptr_t*> deque(4);
+    std::vector<uintptr_t> items(100);
+
+    for (auto& i : items)
+        deque.push(&i);
+
+    TEST_ASSERT(deque.size() == 100, "Size mismatch after growth");
+
+    bool aborted = false;
+    TEST_ASSERT(deque.steal(aborted) == &items[0], "Steal not FIFO");
+    TEST_ASSERT(deque.pop() == &items[99], "Pop not LIFO");
+
+    for (uint32_t i = 98; i >= 1; i--)
+        TEST_ASSERT(deque.pop() == &items[i], "Lost item while growing");
+
+    TEST_ASSERT(deque.pop() == nullptr, "Pop from empty deque");
+    TEST_ASSERT(deque.steal(aborted) == nullptr && !aborted, "Steal from empty deque");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Concurrent owner and thieves
+ * ============================================ */
+int test_task_deque_concurrent(void) {
+    printf("TEST: task_deque_concurrent\n");
+
+    const uint32_t count = 200000;
+    const uint32_t thieves = 3;
+
+    TaskDeque<uint32_t*> deque(16);
+    std::vector<uint32_t> items(count);
+    std::vector<std::atomic<uint32_t>> taken(count);
+    std::atomic<bool> done = { false };
+
+    for (uint32_t i = 0; i < count; i++)
+        items[i] = i;
+
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < thieves; t++) {
+        threads.emplace_back([&] {
+            while (!done) {
+                bool aborted = false;
+                if (uint32_t* item = deque.steal(aborted))
+                    taken[*item]++;
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    // Owner pushes in bursts and pops some back
+    for (uint32_t i = 0; i < count; i++) {
+        deque.push(&items[i]);
+
+        if (i % 3 == 0) {
+            if (uint32_t* item = deque.pop())
+                taken[*item]++;
+        }
+    }
+
+    while (uint32_t* item = deque.pop())
+        taken[*item]++;
+
+    // Thieves may still hold a claimed item
+    while (true) {
+        uint32_t total = 0;
+        for (auto& t : taken)
+            total += t.load();
+        if (total >= count)
+            break;
+        std::this_thread::yield();
+    }
+
+    done = true;
+    for (auto& t : threads)
+        t.join();
+
+    for (uint32_t i = 0; i < count; i++)
+        TEST_ASSERT(taken[i] == 1, "Item taken zero or multiple times");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Random dependency graph
+ * ============================================ */
+int test_task_dependency_graph(void) {
+    printf("TEST: task_dependency_graph\n");
+
+    TaskScheduler scheduler(4);
+
+    const uint32_t count = 2000;
+    std::mt19937 rng(63);
+
+    std::vector<std::vector<uint32_t>> deps(count);
+    std::vector<std::atomic<uint32_t>> order(count);
+    std::atomic<uint32_t> clock = { 0 };
+    std::vector<TaskRef> tasks(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        TaskPriority priority = TaskPriority(rng() % 3);
+        tasks[i] = scheduler.create(priority, [&, i] {
+            order[i] = ++clock;
+        });
+
+        // Up to four edges to earlier tasks, some already finished
+        uint32_t edges = i ? rng() % 5 : 0;
+        for (uint32_t e = 0; e < edges; e++) {
+            uint32_t d = rng() % i;
+            deps[i].push_back(d);
+            scheduler.addDependency(tasks[i], tasks[d]);
+        }
+
+        // Submit in batches so that dependencies are in every state
+        if (i % 16 == 15) {
+            for (uint32_t j = i - 15; j <= i; j++)
+                scheduler.submit(tasks[j]);
+        }
+    }
+
+    scheduler.wait(tasks[count - 1]);
+
+    for (uint32_t i = 0; i < count; i++)
+        scheduler.wait(tasks[i]);
+
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT(order[i] != 0, "Task did not run");
+
+        for (uint32_t d : deps[i])
+            TEST_ASSERT(order[d] < order[i], "Task ran before its dependency");
+    }
+
+    TEST_ASSERT(clock == count, "Task ran more than once");
+
+    TaskSchedulerStats stats = scheduler.getStats();
+    TEST_ASSERT(stats.executed == count, "Executed count mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Priority inheritance
+ * ============================================ */
+int test_task_priority_inheritance(void) {
+    printf("TEST: task_priority_inheritance\n");
+
+    TaskScheduler scheduler(1);
+    Gate gate;
+
+    TaskRef blocker = scheduler.spawn(TaskPriority::FrameCritical, [&] { gate.block(); });
+    gate.waitEntered();
+
+    std::mutex mutex;
+    std::vector<char> order;
+    auto record = [&] (char c) { std::lock_guard lock(mutex); order.push_back(c); };
+
+    // Prefetch work is queued before the idle dependency
+    std::vector<TaskRef> prefetch;
+    for (uint32_t i = 0; i < 8; i++)
+        prefetch.push_back(scheduler.spawn(TaskPriority::Prefetch, [&] { record('p'); }));
+
+    TaskRef cache = scheduler.spawn(TaskPriority::Idle, [&] { record('i'); });
+    TaskRef frame = scheduler.spawn(TaskPriority::FrameCritical, [&] { record('f'); }, { cache });
+
+    TEST_ASSERT(cache->getPriority() == TaskPriority::FrameCritical, "Dependency not boosted");
+
+    gate.open = true;
+
+    // Poll instead of waiting, so that only the worker runs tasks
+    for (const auto& p : prefetch) {
+        while (!p->isDone())
+            std::this_thread::yield();
+    }
+
+    TEST_ASSERT(frame->isDone(), "Frame task not done");
+    TEST_ASSERT(order.size() == 10, "Tasks missing");
+    TEST_ASSERT(order[0] == 'i' && order[1] == 'f', "Boosted dependency waited behind prefetch work");
+    TEST_ASSERT(scheduler.getStats().boosts >= 1, "Boost not counted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Waiting thread helps
+ * ============================================ */
+int test_task_wait_helps(void) {
+    printf("TEST: task_wait_helps\n");
+
+    TaskScheduler scheduler(1);
+    Gate gate;
+
+    TaskRef blocker = scheduler.spawn(TaskPriority::Idle, [&] { gate.block(); });
+    gate.waitEntered();
+
+    // A chain of idle tasks, the only worker is stuck
+    std::atomic<uint32_t> value = { 0 };
+    TaskRef last = scheduler.spawn(TaskPriority::Idle, [&] { value = value * 10 + 1; });
+
+    for (uint32_t i = 2; i <= 5; i++)
+        last = scheduler.spawn(TaskPriority::Idle, [&, i] { value = value * 10 + i; }, { last });
+
+    scheduler.wait(last);
+
+    TEST_ASSERT(value == 12345, "Chain did not run in order on the waiting thread");
+    TEST_ASSERT(!blocker->isDone(), "Blocker finished early");
+
+    gate.open = true;
+    scheduler.wait(blocker);
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Nested spawning
+ * ============================================ */
+static void spawn_tree(TaskScheduler& scheduler, std::atomic<uint32_t>& count, uint32_t depth) {
+    count++;
+
+    if (!depth)
+        return;
+
+    for (uint32_t i = 0; i < 4; i++) {
+        scheduler.spawn(TaskPriority::Prefetch, [&scheduler, &count, depth] {
+            spawn_tree(scheduler, count, depth - 1);
+        });
+    }
+}
+
+int test_task_nested_spawn(void) {
+    printf("TEST: task_nested_spawn\n");
+
+    TaskScheduler scheduler(4);
+    std::atomic<uint32_t> count = { 0 };
+
+    // 1 + 4 + ... + 4^6 tasks
+    const uint32_t expected = (16384 - 1) / 3;
+
+    scheduler.wait(scheduler.spawn(TaskPriority::Prefetch, [&] {
+        spawn_tree(scheduler, count, 6);
+    }));
+
+    while (count != expected)
+        std::this_thread::yield();
+
+    TaskSchedulerStats stats = scheduler.getStats();
+    printf("  executed %llu, steals %llu of %llu attempts\n",
+        (unsigned long long)stats.executed,
+        (unsigned long long)stats.steals,
+        (unsigned long long)stats.stealAttempts);
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Task Scheduler Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_task_deque_order()) passed++; else failed++;
+    if (test_task_deque_concurrent()) passed++; else failed++;
+    if (test_task_dependency_graph()) passed++; else failed++;
+    if (test_task_priority_inheritance()) passed++; else failed++;
+    if (test_task_wait_helps()) passed++; else failed++;
+    if (test_task_nested_spawn()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
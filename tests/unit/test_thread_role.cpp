@@ -0,0 +1,345 @@
+/*
+ * Thread Role Registry Test Suite
+ *
+ * These tests verify the thread role registry
+ * (src/util/util_thread_role.h): policies are derived from the CPU
+ * topology, affinity and priority are applied to registered and
+ * running threads, and thread CPU clocks are attributed per role.
+ * Affinity, priority and CPU time checks need Linux.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_thread_role_parse_cpu_list - Are CPU lists parsed strictly?
+ * 2. test_thread_role_default_policy - Do hybrid CPUs split the roles?
+ * 3. test_thread_role_classify_cores - Are boosted cores still performance cores?
+ * 4. test_thread_role_affinity - Is the policy applied to live threads?
+ * 5. test_thread_role_cpu_time - Is CPU time attributed per thread and role?
+ */
+
+#include "util/util_thread_role.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+/* ============================================
+ * Test: CPU list parsing
+ * ============================================ */
+int test_thread_role_parse_cpu_list(void) {
+    printf("TEST: thread_role_parse_cpu_list\n");
+
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("0-3,8") == 0x10f, "Range and single CPU");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("5") == 0x20, "Single CPU");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("0,63") == 0x8000000000000001ull, "Highest CPU");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("") == 0, "Empty list");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("3-1") == 0, "Reversed range accepted");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("64") == 0, "CPU beyond the mask accepted");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("2x") == 0, "Trailing garbage accepted");
+    TEST_ASSERT(ThreadRoleRegistry::parseCpuList("1-") == 0, "Open range accepted");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Default policies
+ * ============================================ */
+int test_thread_role_default_policy(void) {
+    printf("TEST: thread_role_default_policy\n");
+
+    // 4 performance and 4 efficiency cores
+    ThreadRoleRegistry hybrid(ThreadCpuTopology { 0x0f, 0xf0 });
+
+    ThreadRolePolicy render = hybrid.getPolicy(ThreadRole::RenderCritical);
+    ThreadRolePolicy submit = hybrid.getPolicy(ThreadRole::Submit);
+    ThreadRolePolicy compile = hybrid.getPolicy(ThreadRole::BackgroundCompile);
+    ThreadRolePolicy io = hybrid.getPolicy(ThreadRole::Io);
+
+    TEST_ASSERT(render.cpuMask == 0x0f && submit.cpuMask == 0x0f, "Render threads not on performance cores");
+    TEST_ASSERT(compile.cpuMask == 0xf0, "Compile workers not on efficiency cores");
+    TEST_ASSERT(io.cpuMask == 0, "I/O threads restricted");
+    TEST_ASSERT(compile.priority < render.priority, "Compile workers not below render priority");
+
+    ThreadRoleRegistry uniform(ThreadCpuTopology { 0xff, 0 });
+
+    TEST_ASSERT(uniform.getPolicy(ThreadRole::RenderCritical).cpuMask == 0, "Homogeneous CPU restricted");
+    TEST_ASSERT(uniform.getPolicy(ThreadRole::BackgroundCompile).cpuMask == 0, "Homogeneous CPU restricted");
+
+    ThreadCpuTopology detected = ThreadRoleRegistry::detectTopology();
+    printf("  detected: performance 0x%llx, efficiency 0x%llx\n",
+        (unsigned long long)detected.performanceMask,
+        (unsigned long long)detected.efficiencyMask);
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Core classification
+ * ============================================ */
+int test_thread_role_classify_cores(void) {
+    printf("TEST: thread_role_classify_cores\n");
+
+    // 8 identical cores, per-core boost spreads cpuinfo_max_freq
+    std::array<uint64_t, 64> boosted = { 5300000, 5300000, 5200000, 5200000,
+                                         5100000, 5100000, 5000000, 4900000 };
+    ThreadCpuTopology uniform = ThreadRoleRegistry::classifyCores(boosted);
+
+    TEST_ASSERT(uniform.performanceMask == 0xff, "Boosted cores split");
+    TEST_ASSERT(!uniform.isHeterogeneous(), "Identical cores treated as hybrid");
+
+    // 8 boosted performance cores, 8 efficiency cores, 2 absent
+    std::array<uint64_t, 64> hybrid = { 5800000, 5800000, 5500000, 5500000,
+                                        5500000, 5500000, 5400000, 5400000,
+                                        4300000, 4300000, 4300000, 4300000,
+                                        4300000, 4300000, 4300000, 4300000,
+                                        0, 0 };
+    ThreadCpuTopology split = ThreadRoleRegistry::classifyCores(hybrid);
+
+    TEST_ASSERT(split.performanceMask == 0xff, "Performance cores misclassified");
+    TEST_ASSERT(split.efficiencyMask == 0xff00, "Efficiency cores misclassified");
+
+    // cpu_capacity as on Apple Silicon, 4 P and 4 E cores
+    std::array<uint64_t, 64> capacity = { 446, 446, 446, 446, 1024, 1024, 1024, 1024 };
+    ThreadCpuTopology apple = ThreadRoleRegistry::classifyCores(capacity);
+
+    TEST_ASSERT(apple.performanceMask == 0xf0 && apple.efficiencyMask == 0x0f, "Capacities misclassified");
+
+    // Windows efficiency classes plus one, P cores are class 1
+    std::array<uint64_t, 64> classes = { 2, 2, 2, 2, 1, 1, 1, 1 };
+    ThreadCpuTopology windows = ThreadRoleRegistry::classifyCores(classes);
+
+    TEST_ASSERT(windows.performanceMask == 0x0f && windows.efficiencyMask == 0xf0, "Efficiency classes misclassified");
+
+    std::array<uint64_t, 64> none = { };
+    ThreadCpuTopology unknown = ThreadRoleRegistry::classifyCores(none);
+
+    TEST_ASSERT(!unknown.performanceMask && !unknown.efficiencyMask, "Absent cores classified");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Affinity and priority
+ * ============================================ */
+int test_thread_role_affinity(void) {
+    printf("TEST: thread_role_affinity\n");
+
+#if defined(__linux__)
+    cpu_set_t available;
+    CPU_ZERO(&available);
+    sched_getaffinity(0, sizeof(available), &available);
+
+    uint32_t first = 0;
+    while (first < 64 && !CPU_ISSET(first, &available))
+        first++;
+    TEST_ASSERT(first < 64, "No CPU available");
+
+    ThreadRoleRegistry registry(ThreadCpuTopology { 0, 0 });
+
+    std::atomic<uint32_t> step = { 0 };
+    std::atomic<int> cpuCount = { -1 };
+    std::atomic<bool> onFirst = { false };
+    std::atomic<int> nice = { 0 };
+
+    std::thread worker([&] {
+        ThreadRoleScope scope(registry, ThreadRole::BackgroundCompile, "dxvk-shader");
+        step = 1;
+
+        // Wait for the policy to change while we run
+        while (step != 2)
+            std::this_thread::yield();
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        cpuCount = CPU_COUNT(&set);
+        onFirst = CPU_ISSET(first, &set);
+        nice = getpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)));
+        step = 3;
+    });
+
+    while (step != 1)
+        std::this_thread::yield();
+
+    bool applied = registry.setPolicy(ThreadRole::BackgroundCompile,
+        ThreadRolePolicy { uint64_t(1) << first, ThreadPriority::Low });
+    step = 2;
+
+    while (step != 3)
+        std::this_thread::yield();
+    worker.join();
+
+    TEST_ASSERT(applied, "Policy not applied");
+    TEST_ASSERT(cpuCount == 1 && onFirst, "Affinity not applied to the running thread");
+    TEST_ASSERT(nice == 10, "Priority not applied to the running thread");
+
+    // The main thread must not be affected
+    cpu_set_t own;
+    CPU_ZERO(&own);
+    sched_getaffinity(0, sizeof(own), &own);
+    TEST_ASSERT(CPU_EQUAL(&own, &available), "Policy leaked to another thread");
+    TEST_ASSERT(registry.getStats().policyFailures == 0, "Policy failures counted");
+
+    // High priority falls back to the default nice value without CAP_SYS_NICE
+    std::atomic<int> submitNice = { 1 };
+
+    std::thread submit([&] {
+        ThreadRoleScope scope(registry, ThreadRole::Submit, "dxvk-submit");
+        submitNice = getpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)));
+    });
+    submit.join();
+
+    TEST_ASSERT(submitNice <= 0, "High priority not applied");
+    TEST_ASSERT(registry.getStats().policyFailures == 0, "Unprivileged High priority counted as failure");
+
+    // A thread pinned before it registers gets the process affinity
+    // for a role without a mask, not its own pin
+    std::atomic<int> ioCount = { -1 };
+
+    std::thread io([&] {
+        cpu_set_t pin;
+        CPU_ZERO(&pin);
+        CPU_SET(first, &pin);
+        sched_setaffinity(0, sizeof(pin), &pin);
+
+        ThreadRoleScope scope(registry, ThreadRole::Io, "dxvk-io");
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        ioCount = CPU_COUNT(&set);
+    });
+    io.join();
+
+    TEST_ASSERT(ioCount == CPU_COUNT(&available), "Caller's affinity used as the available set");
+#else
+    printf("  skipped, needs Linux\n");
+#endif
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: CPU time per thread and role
+ * ============================================ */
+int test_thread_role_cpu_time(void) {
+    printf("TEST: thread_role_cpu_time\n");
+
+#if defined(__linux__)
+    ThreadRoleRegistry registry(ThreadCpuTopology { 0, 0 });
+
+    const uint64_t spinNs = 50000000;
+
+    std::atomic<uint32_t> ready = { 0 };
+    std::atomic<bool> exit = { false };
+
+    // CS thread burns CPU, the I/O thread sleeps
+    std::thread busy([&] {
+        ThreadRoleScope scope(registry, ThreadRole::RenderCritical, "dxvk-cs");
+        struct timespec start, now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
+        do {
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        } while (uint64_t(now.tv_sec - start.tv_sec) * 1000000000ull
+               + uint64_t(now.tv_nsec) - uint64_t(start.tv_nsec) < spinNs);
+
+        ready += 1;
+        while (!exit)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    std::thread idle([&] {
+        ThreadRoleScope scope(registry, ThreadRole::Io, "dxvk-io");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ready += 1;
+        while (!exit)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    while (ready != 2)
+        std::this_thread::yield();
+
+    auto samples = registry.sampleThreads();
+    TEST_ASSERT(samples.size() == 2, "Threads not registered");
+
+    uint64_t busyNs = 0;
+    uint64_t idleNs = 0;
+
+    for (const auto& s : samples) {
+        if (s.name == "dxvk-cs")
+            busyNs = s.cpuTimeNs;
+        if (s.name == "dxvk-io")
+            idleNs = s.cpuTimeNs;
+    }
+
+    printf("  busy %.1f ms, idle %.1f ms\n", double(busyNs) / 1e6, double(idleNs) / 1e6);
+
+    TEST_ASSERT(busyNs >= spinNs, "Busy thread CPU time too low");
+    TEST_ASSERT(idleNs < spinNs / 2, "Sleeping thread charged CPU time");
+
+    exit = true;
+    busy.join();
+    idle.join();
+
+    // Exited threads keep counting towards their role
+    auto roles = registry.sampleRoles();
+    TEST_ASSERT(registry.getStats().threads == 0, "Threads not unregistered");
+    TEST_ASSERT(roles[uint32_t(ThreadRole::RenderCritical)] >= busyNs, "CPU time of exited thread lost");
+    TEST_ASSERT(roles[uint32_t(ThreadRole::Submit)] == 0, "CPU time charged to the wrong role");
+#else
+    printf("  skipped, needs Linux\n");
+#endif
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Thread Role Registry Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_thread_role_parse_cpu_list()) passed++; else failed++;
+    if (test_thread_role_default_policy()) passed++; else failed++;
+    if (test_thread_role_classify_cores()) passed++; else failed++;
+    if (test_thread_role_affinity()) passed++; else failed++;
+    if (test_thread_role_cpu_time()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
@@ -0,0 +1,329 @@
+/*
+ * Upload Scheduler Test Suite
+ *
+ * These tests verify the per-frame managed texture upload scheduler
+ * (src/d3d9/d3d9_upload_scheduler.h). CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_upload_tails_first - Do mip tails of all textures go first?
+ * 2. test_upload_progressive - Does the chain complete within budget?
+ * 3. test_upload_draw_tail - Does a draw on an empty texture block on the tail only?
+ * 4. test_upload_draw_strict - Does a strict draw get the full chain?
+ * 5. test_upload_oversized_mip - Is progress made when a mip exceeds the budget?
+ * 6. test_upload_requeue - Are re-queued and removed textures accounted for?
+ * 7. test_upload_skip_large - Do smaller mips fill the budget behind one that does not fit?
+ */
+
+#include "d3d9/d3d9_upload_scheduler.h"
+
+#include <stdio.h>
+
+#include <map>
+#include <vector>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+struct UploadLog {
+    std::map<uint64_t, std::vector<uint32_t>> mips;
+    uint32_t count = 0;
+
+    D3D9UploadFn fn() {
+        return [this] (uint64_t texture, uint32_t mip) {
+            mips[texture].push_back(mip);
+            count++;
+        };
+    }
+};
+
+/* DXT1 mip chain down to 1x1, 8 bytes per 4x4 block */
+static std::vector<uint64_t> dxt1_chain(uint32_t size) {
+    std::vector<uint64_t> mips;
+    for (uint32_t s = size; s > 0; s /= 2) {
+        uint64_t blocks = std::max(1u, s / 4);
+        mips.push_back(blocks * blocks * 8);
+    }
+    return mips;
+}
+
+static uint64_t sum(const std::vector<uint64_t>& v) {
+    uint64_t total = 0;
+    for (uint64_t x : v)
+        total += x;
+    return total;
+}
+
+static D3D9UploadSchedulerOptions byte_budget(uint64_t bytes) {
+    D3D9UploadSchedulerOptions options;
+    options.budgetBytes = bytes;
+    options.budgetTimeUs = ~0ull;
+    options.mipTailBytes = 64 << 10;
+    return options;
+}
+
+/* ============================================
+ * Test: Mip tails first
+ * ============================================ */
+int test_upload_tails_first(void) {
+    printf("TEST: upload_tails_first\n");
+
+    UploadLog log;
+    // 1024x1024 DXT1: mip 0 = 512K, 1 = 128K, 2 = 32K -> tail starts at mip 2
+    D3D9UploadScheduler scheduler(byte_budget(200 << 10), log.fn());
+
+    for (uint64_t t = 1; t <= 4; t++)
+        scheduler.Enqueue(t, dxt1_chain(1024));
+
+    scheduler.ProcessFrame();
+
+    for (uint64_t t = 1; t <= 4; t++) {
+        TEST_ASSERT(scheduler.GetResidentMip(t) == 2, "Tail not uploaded for every texture");
+        TEST_ASSERT(log.mips[t].front() == 10, "Smallest mip not uploaded first");
+    }
+
+    D3D9UploadStats stats = scheduler.GetStats();
+    TEST_ASSERT(stats.budgetHitFrames == 1, "Budget hit not counted");
+    TEST_ASSERT(stats.blockingBytes == 0, "Budgeted upload counted as blocking");
+    TEST_ASSERT(stats.deferredBytes == 4 * ((512 + 128) << 10), "Deferred bytes mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Progressive completion within budget
+ * ============================================ */
+int test_upload_progressive(void) {
+    printf("TEST: upload_progressive\n");
+
+    UploadLog log;
+    const uint64_t budget = 600 << 10;
+    D3D9UploadScheduler scheduler(byte_budget(budget), log.fn());
+
+    uint64_t total = 0;
+    for (uint64_t t = 1; t <= 16; t++) {
+        std::vector<uint64_t> chain = dxt1_chain(t % 2 ? 512 : 1024);
+        total += sum(chain);
+        scheduler.Enqueue(t, chain);
+    }
+
+    std::map<uint64_t, uint32_t> lastLod;
+    uint32_t frames = 0;
+
+    while (scheduler.GetStats().pendingTextures && frames < 1000) {
+        scheduler.ProcessFrame();
+        frames++;
+
+        TEST_ASSERT(scheduler.GetStats().frameBytes <= budget, "Frame exceeded byte budget");
+
+        for (uint64_t t = 1; t <= 16; t++) {
+            uint32_t lod = scheduler.GetResidentMip(t);
+            TEST_ASSERT(!lastLod.count(t) || lod <= lastLod[t], "Resident range shrank");
+            lastLod[t] = lod;
+        }
+    }
+
+    D3D9UploadStats stats = scheduler.GetStats();
+    TEST_ASSERT(stats.pendingTextures == 0, "Uploads never completed");
+    TEST_ASSERT(stats.uploadedBytes == total, "Uploaded bytes mismatch");
+    TEST_ASSERT(stats.deferredBytes == 0, "Deferred bytes left over");
+    TEST_ASSERT(frames > 1, "Burst was not spread over frames");
+
+    for (uint64_t t = 1; t <= 16; t++) {
+        const std::vector<uint32_t>& mips = log.mips[t];
+        for (size_t i = 0; i < mips.size(); i++)
+            TEST_ASSERT(mips[i] == mips.size() - 1 - i, "Mips not uploaded smallest to largest, once each");
+    }
+
+    printf("  Burst of %.1f MB spread over %u frames\n", double(total) / (1 << 20), frames);
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Draw on empty texture blocks on the tail only
+ * ============================================ */
+int test_upload_draw_tail(void) {
+    printf("TEST: upload_draw_tail\n");
+
+    UploadLog log;
+    D3D9UploadScheduler scheduler(byte_budget(1 << 20), log.fn());
+
+    std::vector<uint64_t> chain = dxt1_chain(1024);
+    scheduler.Enqueue(7, chain);
+
+    uint32_t lod = scheduler.PrepareDraw(7, false);
+    TEST_ASSERT(lod == 2, "Draw did not get the mip tail");
+
+    uint64_t tail = sum(chain) - chain[0] - chain[1];
+    TEST_ASSERT(scheduler.GetStats().blockingBytes == tail, "Blocked on more than the tail");
+
+    // Second draw: data is there, nothing to wait for
+    TEST_ASSERT(scheduler.PrepareDraw(7, false) == 2, "LOD clamp changed without uploads");
+    TEST_ASSERT(scheduler.GetStats().blockingBytes == tail, "Second draw blocked");
+
+    // Unknown textures are fully resident
+    TEST_ASSERT(scheduler.PrepareDraw(99, false) == 0, "Unmanaged texture clamped");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Strict draw needs the full chain
+ * ============================================ */
+int test_upload_draw_strict(void) {
+    printf("TEST: upload_draw_strict\n");
+
+    UploadLog log;
+    D3D9UploadScheduler scheduler(byte_budget(1 << 20), log.fn());
+
+    std::vector<uint64_t> chain = dxt1_chain(256);
+    scheduler.Enqueue(3, chain);
+
+    TEST_ASSERT(scheduler.PrepareDraw(3, true) == 0, "Strict draw not fully resident");
+    TEST_ASSERT(log.mips[3].size() == chain.size(), "Not every mip uploaded");
+
+    D3D9UploadStats stats = scheduler.GetStats();
+    TEST_ASSERT(stats.blockingBytes == sum(chain), "Blocking bytes mismatch");
+    TEST_ASSERT(stats.pendingTextures == 0, "Completed texture still pending");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Mip larger than the budget
+ * ============================================ */
+int test_upload_oversized_mip(void) {
+    printf("TEST: upload_oversized_mip\n");
+
+    UploadLog log;
+    // 4096x4096 DXT1 mip 0 is 8 MB, budget is 1 MB
+    D3D9UploadScheduler scheduler(byte_budget(1 << 20), log.fn());
+
+    scheduler.Enqueue(1, dxt1_chain(4096));
+
+    uint32_t frames = 0;
+    while (scheduler.GetStats().pendingTextures && frames < 100) {
+        scheduler.ProcessFrame();
+        frames++;
+    }
+
+    TEST_ASSERT(scheduler.GetStats().pendingTextures == 0, "Stalled on oversized mip");
+    TEST_ASSERT(scheduler.GetStats().frameBytes == 8 << 20, "Oversized mip not uploaded alone");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Re-queue and removal
+ * ============================================ */
+int test_upload_requeue(void) {
+    printf("TEST: upload_requeue\n");
+
+    UploadLog log;
+    D3D9UploadScheduler scheduler(byte_budget(64 << 10), log.fn());
+
+    std::vector<uint64_t> chain = dxt1_chain(512);
+    scheduler.Enqueue(1, chain);
+    scheduler.Enqueue(2, chain);
+    scheduler.ProcessFrame();
+
+    // Application rewrote texture 1: everything is pending again
+    scheduler.Enqueue(1, chain);
+    TEST_ASSERT(scheduler.GetResidentMip(1) == chain.size(), "Re-queued texture still resident");
+
+    uint64_t deferred = scheduler.GetStats().deferredBytes;
+    scheduler.Remove(2);
+    TEST_ASSERT(scheduler.GetStats().deferredBytes == sum(chain), "Removed texture still deferred");
+    TEST_ASSERT(deferred > sum(chain), "Texture 2 had nothing deferred");
+    TEST_ASSERT(scheduler.GetStats().pendingTextures == 1, "Removed texture still pending");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Large mip at the head of the queue
+ * ============================================ */
+int test_upload_skip_large(void) {
+    printf("TEST: upload_skip_large\n");
+
+    UploadLog log;
+    D3D9UploadSchedulerOptions options = byte_budget(200 << 10);
+    options.mipTailBytes = 4 << 10;
+    D3D9UploadScheduler scheduler(options, log.fn());
+
+    // Tails are the 1K mips. After the tails, texture 1's 197K mip
+    // no longer fits, the 30K mips behind it do.
+    scheduler.Enqueue(1, { 197 << 10, 1 << 10 });
+
+    for (uint64_t t = 2; t <= 4; t++)
+        scheduler.Enqueue(t, { 30 << 10, 1 << 10 });
+
+    scheduler.ProcessFrame();
+
+    D3D9UploadStats stats = scheduler.GetStats();
+    TEST_ASSERT(stats.frameBytes == (4 + 90) << 10, "Budget not filled behind the large mip");
+    TEST_ASSERT(stats.pendingTextures == 1, "Small textures starved");
+    TEST_ASSERT(scheduler.GetResidentMip(1) == 1, "Large mip uploaded over budget");
+    TEST_ASSERT(stats.budgetHitFrames == 1, "Skipped mip not counted as budget hit");
+
+    // New small textures keep arriving, the skipped one goes first
+    scheduler.Enqueue(5, { 30 << 10, 1 << 10 });
+    scheduler.ProcessFrame();
+
+    TEST_ASSERT(scheduler.GetResidentMip(1) == 0, "Large mip starved");
+    TEST_ASSERT(log.mips[1].size() == 2, "Large texture upload count");
+    TEST_ASSERT(log.mips[5].size() == 1, "Tail of the new texture not uploaded");
+
+    scheduler.ProcessFrame();
+    TEST_ASSERT(scheduler.GetStats().pendingTextures == 0, "Uploads not completed");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Upload Scheduler Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 7;
+
+    if (test_upload_tails_first()) passed++; else failed++;
+    if (test_upload_progressive()) passed++; else failed++;
+    if (test_upload_draw_tail()) passed++; else failed++;
+    if (test_upload_draw_strict()) passed++; else failed++;
+    if (test_upload_oversized_mip()) passed++; else failed++;
+    if (test_upload_requeue()) passed++; else failed++;
+    if (test_upload_skip_large()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
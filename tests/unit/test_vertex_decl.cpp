@@ -0,0 +1,332 @@
+/*
+ * Vertex Declaration Cache Test Suite
+ *
+ * These tests verify the vertex declaration cache
+ * (src/d3d9/d3d9_vertex_decl.h): fetch formats and shader
+ * conversions per D3DDECLTYPE, interning, FVF translation and the
+ * memoized input layouts.
+ * CPU only, no Vulkan device needed.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_vertex_fetch_plan - Are formats Metal lacks converted or swizzled?
+ * 2. test_vertex_decl_intern - Do identical declarations share one object?
+ * 3. test_vertex_decl_fvf - Do FVF codes translate like D3D9 does?
+ * 4. test_vertex_input_layout - Do layouts match shader inputs and get memoized?
+ * 5. test_vertex_input_state - Is rebinding the same pair free?
+ */
+
+#include "d3d9/d3d9_vertex_decl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static const D3D9VertexElement DeclEnd = { 0xff, 0, D3D9DeclType::Unused, 0, D3D9DeclUsage::Position, 0 };
+
+/* Skinned mesh: position, weights, indices, normal, color, uv */
+static const D3D9VertexElement SkinnedDecl[] = {
+    { 0,  0, D3D9DeclType::Float3,   0, D3D9DeclUsage::Position,     0 },
+    { 0, 12, D3D9DeclType::UByte4N,  0, D3D9DeclUsage::BlendWeight,  0 },
+    { 0, 16, D3D9DeclType::UByte4,   0, D3D9DeclUsage::BlendIndices, 0 },
+    { 0, 20, D3D9DeclType::Short4N,  0, D3D9DeclUsage::Normal,       0 },
+    { 1,  0, D3D9DeclType::D3DColor, 0, D3D9DeclUsage::Color,        0 },
+    { 1,  4, D3D9DeclType::Float2,   0, D3D9DeclUsage::Texcoord,     0 },
+    DeclEnd,
+};
+
+/* ============================================
+ * Test: Fetch formats and conversions
+ * ============================================ */
+int test_vertex_fetch_plan(void) {
+    printf("TEST: vertex_fetch_plan\n");
+
+    D3D9VertexFormatSupport metal;
+    D3D9VertexFormatSupport full = { true, true };
+    D3D9VertexFormatSupport noBgra = { false, true };
+
+    D3D9VertexFetch f = D3D9GetVertexFetch(D3D9DeclType::Float3, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R32G32B32_SFLOAT && f.size == 12, "Float3 fetch");
+    TEST_ASSERT(f.convert == D3D9VertexConvert::None && f.swizzle == D3D9VertexFetch::IdentitySwizzle, "Float3 converted");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::D3DColor, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::B8G8R8A8_UNORM && f.swizzle == D3D9VertexFetch::IdentitySwizzle, "D3DCOLOR with BGRA fetch");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::D3DColor, noBgra);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R8G8B8A8_UNORM && f.swizzle == D3D9VertexFetch::BgraSwizzle, "D3DCOLOR not swizzled");
+
+    // Swizzle picks z, y, x, w
+    uint8_t s = D3D9VertexFetch::BgraSwizzle;
+    TEST_ASSERT((s & 3) == 2 && ((s >> 2) & 3) == 1 && ((s >> 4) & 3) == 0 && ((s >> 6) & 3) == 3, "BGRA swizzle");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::UByte4, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R8G8B8A8_UINT && f.convert == D3D9VertexConvert::UintToFloat, "UBYTE4 without scaled formats");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::UByte4, full);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R8G8B8A8_USCALED && f.convert == D3D9VertexConvert::None, "UBYTE4 with scaled formats");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::Short2, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R16G16_SINT && f.convert == D3D9VertexConvert::SintToFloat, "SHORT2 without scaled formats");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::UDec3, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::R32_UINT && f.convert == D3D9VertexConvert::UnpackUDec3, "UDEC3 not unpacked");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::Dec3N, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::A2B10G10R10_SNORM_PACK32 && f.convert == D3D9VertexConvert::None, "DEC3N fetch");
+
+    f = D3D9GetVertexFetch(D3D9DeclType::Unused, metal);
+    TEST_ASSERT(f.format == D3D9VertexFormat::Undefined && f.size == 0, "Unused type has a format");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Interning
+ * ============================================ */
+int test_vertex_decl_intern(void) {
+    printf("TEST: vertex_decl_intern\n");
+
+    D3D9VertexDeclCache cache;
+
+    D3D9VertexDecl* a = cache.Intern(SkinnedDecl);
+    D3D9VertexDecl* b = cache.Intern(SkinnedDecl);
+    TEST_ASSERT(a && a == b, "Identical declarations not shared");
+    TEST_ASSERT(a->Elements().size() == 6, "Element count");
+    TEST_ASSERT(a->StreamMask() == 0x3, "Stream mask");
+    TEST_ASSERT(a->TexcoordMask() == 0x1, "Texcoord mask");
+    TEST_ASSERT((a->Flags() & D3D9VertexDeclHasColor0) && (a->Flags() & D3D9VertexDeclHasBlendIndices), "Flags");
+    TEST_ASSERT(!(a->Flags() & D3D9VertexDeclHasPositionT), "PositionT flag");
+
+    // Same elements, different offset
+    D3D9VertexElement other[7];
+    memcpy(other, SkinnedDecl, sizeof(other));
+    other[5].offset = 8;
+
+    D3D9VertexDecl* c = cache.Intern(other);
+    TEST_ASSERT(c && c != a && c->Hash() != a->Hash(), "Different declarations shared");
+
+    // Invalid declarations
+    memcpy(other, SkinnedDecl, sizeof(other));
+    other[2].offset = 18;
+    TEST_ASSERT(!cache.Intern(other), "Misaligned offset accepted");
+
+    memcpy(other, SkinnedDecl, sizeof(other));
+    other[5].usage = D3D9DeclUsage::Color;
+    TEST_ASSERT(!cache.Intern(other), "Duplicate usage accepted");
+
+    memcpy(other, SkinnedDecl, sizeof(other));
+    other[1].type = D3D9DeclType::Unused;
+    TEST_ASSERT(!cache.Intern(other), "Unused type accepted");
+
+    memcpy(other, SkinnedDecl, sizeof(other));
+    other[4].stream = 16;
+    TEST_ASSERT(!cache.Intern(other), "Stream out of range accepted");
+
+    D3D9VertexDeclStats stats = cache.GetStats();
+    TEST_ASSERT(stats.decls == 2 && stats.internHits == 1, "Stats mismatch");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: FVF translation
+ * ============================================ */
+int test_vertex_decl_fvf(void) {
+    printf("TEST: vertex_decl_fvf\n");
+
+    // D3DFVF_XYZ | D3DFVF_NORMAL | D3DFVF_DIFFUSE | D3DFVF_TEX2 | D3DFVF_TEXCOORDSIZE3(1)
+    const uint32_t fvf = 0x002 | 0x010 | 0x040 | 0x200 | (1u << 18);
+
+    std::vector<D3D9VertexElement> elements;
+    TEST_ASSERT(D3D9VertexDeclCache::TranslateFvf(fvf, elements), "Valid FVF rejected");
+    TEST_ASSERT(elements.size() == 5, "Element count");
+
+    TEST_ASSERT(elements[0].usage == D3D9DeclUsage::Position && elements[0].type == D3D9DeclType::Float3 && elements[0].offset == 0, "Position");
+    TEST_ASSERT(elements[1].usage == D3D9DeclUsage::Normal && elements[1].offset == 12, "Normal");
+    TEST_ASSERT(elements[2].usage == D3D9DeclUsage::Color && elements[2].type == D3D9DeclType::D3DColor && elements[2].offset == 24, "Diffuse");
+    TEST_ASSERT(elements[3].usage == D3D9DeclUsage::Texcoord && elements[3].type == D3D9DeclType::Float2 && elements[3].offset == 28, "Texcoord 0");
+    TEST_ASSERT(elements[4].usageIndex == 1 && elements[4].type == D3D9DeclType::Float3 && elements[4].offset == 36, "Texcoord 1");
+
+    // D3DFVF_XYZB3 | D3DFVF_LASTBETA_UBYTE4: two weights and indices
+    elements.clear();
+    TEST_ASSERT(D3D9VertexDeclCache::TranslateFvf(0x00a | 0x1000, elements), "Blend FVF rejected");
+    TEST_ASSERT(elements.size() == 3, "Blend element count");
+    TEST_ASSERT(elements[1].usage == D3D9DeclUsage::BlendWeight && elements[1].type == D3D9DeclType::Float2, "Blend weights");
+    TEST_ASSERT(elements[2].usage == D3D9DeclUsage::BlendIndices && elements[2].type == D3D9DeclType::UByte4 && elements[2].offset == 20, "Blend indices");
+
+    // D3DFVF_XYZRHW | D3DFVF_SPECULAR
+    elements.clear();
+    TEST_ASSERT(D3D9VertexDeclCache::TranslateFvf(0x004 | 0x080, elements), "Pre-transformed FVF rejected");
+    TEST_ASSERT(elements[0].usage == D3D9DeclUsage::PositionT && elements[0].type == D3D9DeclType::Float4, "PositionT");
+    TEST_ASSERT(elements[1].usage == D3D9DeclUsage::Color && elements[1].usageIndex == 1, "Specular");
+
+    // Five weights do not fit, nine texcoords are invalid
+    elements.clear();
+    TEST_ASSERT(!D3D9VertexDeclCache::TranslateFvf(0x00e, elements), "Five weights accepted");
+    elements.clear();
+    TEST_ASSERT(!D3D9VertexDeclCache::TranslateFvf(0x002 | 0x900, elements), "Nine texcoords accepted");
+
+    // Memoized and shared with an identical explicit declaration
+    // created first, while each keeps its own FVF code
+    D3D9VertexDeclCache cache;
+
+    elements.clear();
+    D3D9VertexDeclCache::TranslateFvf(fvf, elements);
+    elements.push_back(DeclEnd);
+    D3D9VertexDecl* explicitDecl = cache.Intern(elements.data());
+
+    const D3D9FvfDecl* a = cache.FromFvf(fvf);
+    const D3D9FvfDecl* b = cache.FromFvf(fvf);
+    TEST_ASSERT(a && a == b && a->fvf == fvf, "FVF not memoized");
+    TEST_ASSERT(a->decl == explicitDecl, "FVF and explicit declaration not shared");
+
+    // The size of texcoord 1 does not matter with one texcoord
+    const uint32_t unusedSize = 0x002 | 0x100 | (1u << 18);
+    const D3D9FvfDecl* c = cache.FromFvf(0x002 | 0x100);
+    const D3D9FvfDecl* d = cache.FromFvf(unusedSize);
+    TEST_ASSERT(c && d && c->decl == d->decl, "Equivalent FVF codes not shared");
+    TEST_ASSERT(c->fvf == (0x002 | 0x100) && d->fvf == unusedSize, "FVF code collapsed");
+
+    TEST_ASSERT(!cache.FromFvf(0x00e) && !cache.FromFvf(0x00e), "Invalid FVF");
+    TEST_ASSERT(cache.GetStats().fvfMisses == 4, "FVF translated more than once");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Input layouts
+ * ============================================ */
+int test_vertex_input_layout(void) {
+    printf("TEST: vertex_input_layout\n");
+
+    D3D9VertexDeclCache cache;
+    D3D9VertexDecl* decl = cache.Intern(SkinnedDecl);
+
+    // Skinning shader that also reads a tangent the declaration lacks
+    D3D9VertexShaderInputs inputs({
+        { 0, D3D9DeclUsage::Position,     0 },
+        { 1, D3D9DeclUsage::BlendWeight,  0 },
+        { 2, D3D9DeclUsage::BlendIndices, 0 },
+        { 3, D3D9DeclUsage::Normal,       0 },
+        { 4, D3D9DeclUsage::Texcoord,     0 },
+        { 5, D3D9DeclUsage::Tangent,      0 },
+        { 7, D3D9DeclUsage::Color,        0 },
+    });
+
+    const D3D9InputLayout* layout = decl->GetLayout(inputs);
+    TEST_ASSERT(layout->attributes.size() == 6, "Attribute count");
+    TEST_ASSERT(layout->missingMask == (1u << 5), "Missing tangent");
+
+    const D3D9VertexAttribute& color = layout->attributes[5];
+    TEST_ASSERT(color.location == 7 && color.binding == 1 && color.offset == 0, "Color attribute");
+    TEST_ASSERT(color.format == D3D9VertexFormat::B8G8R8A8_UNORM, "Color format");
+
+    TEST_ASSERT(layout->conversions.size() == 1, "Conversion count");
+    TEST_ASSERT(layout->conversions[0].location == 2 && layout->conversions[0].convert == D3D9VertexConvert::UintToFloat, "Blend indices conversion");
+
+    TEST_ASSERT(layout->bindings.size() == 2, "Binding count");
+    TEST_ASSERT(layout->bindings[0].binding == 0 && layout->bindings[0].extent == 28, "Stream 0 extent");
+    TEST_ASSERT(layout->bindings[1].binding == 1 && layout->bindings[1].extent == 12, "Stream 1 extent");
+
+    // Equal signatures from another shader reuse the layout
+    D3D9VertexShaderInputs same(inputs.Inputs());
+    TEST_ASSERT(decl->GetLayout(same) == layout, "Layout not memoized");
+    TEST_ASSERT(cache.GetStats().layoutBuilds == 1, "Layout built twice");
+
+    // Pre-transformed positions feed position 0
+    const uint32_t fvf = 0x004 | 0x040;
+    D3D9VertexShaderInputs ff({
+        { 0, D3D9DeclUsage::Position, 0 },
+        { 1, D3D9DeclUsage::Color,    0 },
+    });
+
+    const D3D9InputLayout* rhw = cache.FromFvf(fvf)->decl->GetLayout(ff);
+    TEST_ASSERT(rhw->missingMask == 0 && rhw->attributes.size() == 2, "PositionT not matched");
+    TEST_ASSERT(rhw->attributes[0].format == D3D9VertexFormat::R32G32B32A32_SFLOAT, "PositionT format");
+    TEST_ASSERT(rhw->hash != layout->hash, "Layout hashes collide");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Bound state
+ * ============================================ */
+int test_vertex_input_state(void) {
+    printf("TEST: vertex_input_state\n");
+
+    D3D9VertexDeclCache cache;
+    D3D9VertexDecl* a = cache.FromFvf(0x002 | 0x040)->decl;
+    D3D9VertexDecl* b = cache.FromFvf(0x002 | 0x040 | 0x100)->decl;
+
+    D3D9VertexShaderInputs vs({
+        { 0, D3D9DeclUsage::Position, 0 },
+        { 1, D3D9DeclUsage::Color,    0 },
+    });
+
+    D3D9VertexShaderInputs vsCopy(vs.Inputs());
+
+    D3D9VertexInputState state;
+    TEST_ASSERT(state.Bind(a, &vs), "First bind not dirty");
+    const D3D9InputLayout* layoutA = state.GetLayout();
+
+    TEST_ASSERT(!state.Bind(a, &vs), "Rebind dirty");
+    TEST_ASSERT(!state.Bind(a, &vsCopy), "Equal shader inputs dirty");
+
+    // b has an extra texcoord the shader ignores, but it is
+    // a different declaration with its own layout object
+    TEST_ASSERT(state.Bind(b, &vs), "Declaration change not dirty");
+    TEST_ASSERT(state.Bind(a, &vs), "Switch back not dirty");
+    TEST_ASSERT(state.GetLayout() == layoutA, "Layout not reused");
+
+    TEST_ASSERT(cache.GetStats().layoutBuilds == 2, "Layouts rebuilt on rebind");
+
+    TEST_ASSERT(state.Bind(nullptr, &vs) && !state.GetLayout(), "Unbind");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Vertex Declaration Cache Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 5;
+
+    if (test_vertex_fetch_plan()) passed++; else failed++;
+    if (test_vertex_decl_intern()) passed++; else failed++;
+    if (test_vertex_decl_fvf()) passed++; else failed++;
+    if (test_vertex_input_layout()) passed++; else failed++;
+    if (test_vertex_input_state()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
@@ -1,15 +1,26 @@
 /*
  * Transform Feedback Test Suite for MoltenVK
- * 
+ *
  * These tests verify VK_EXT_transform_feedback emulation.
  * Run with: make test-xfb
- * 
+ *
+ * MoltenVK has no transform feedback, so DXVK compiles the vertex
+ * stage into a compute variant that stores its outputs to the
+ * capture buffer (src/dxvk/dxvk_xfb_emulation.h). The tests run
+ * that variant: a stage computing 2 * position, one invocation per
+ * primitive, writing at CPU computed offsets (direct) or at slots
+ * reserved with an atomic add (geometry amplification), with the
+ * GPU resolve dispatch and the counter and query handling around
+ * it. They run on any Vulkan 1.0 device; on one with the native
+ * extension, pass --emulate to mask it off like DXVK does.
+ *
  * Test progression:
- * 1. test_xfb_extension_present - Does MoltenVK advertise the extension?
+ * 1. test_xfb_extension_present - Does MoltenVK advertise the extension, or do we emulate it?
  * 2. test_xfb_basic_capture - Can we capture vertex output?
  * 3. test_xfb_query_primitives - Do primitive counts work?
  * 4. test_xfb_pause_resume - Does pause/resume work?
  * 5. test_xfb_overflow - Is overflow handled correctly?
+ * 6. test_xfb_atomic_capture - Does an amplifying stage get every primitive a slot?
  */
 
 #include <vulkan/vulkan.h>
@@ -33,48 +44,902 @@
     } \
 } while(0)
 
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
 // Global Vulkan state
 static VkInstance instance = VK_NULL_HANDLE;
 static VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 static VkDevice device = VK_NULL_HANDLE;
 static VkQueue queue = VK_NULL_HANDLE;
 static uint32_t queueFamily = 0;
+static VkPhysicalDeviceMemoryProperties memoryProps;
 
 // Extension function pointers
 static PFN_vkCmdBeginTransformFeedbackEXT vkCmdBeginTransformFeedbackEXT = NULL;
 static PFN_vkCmdEndTransformFeedbackEXT vkCmdEndTransformFeedbackEXT = NULL;
 static PFN_vkCmdBindTransformFeedbackBuffersEXT vkCmdBindTransformFeedbackBuffersEXT = NULL;
 
+static int nativeXfb = 0;
+static int maskNative = 0;
+
+/* ============================================
+ * Emulation variant
+ * ============================================ */
+
+/*
+ * Bindings of the variant: vertices (vec4, v[i] = (i, 0, 0, 1)),
+ * indices, the capture buffer and the GPU state. Non-indexed
+ * draws read the identity sequence at the start of the index
+ * buffer. Only triangle lists and strips, and only buffer 0 with
+ * a vec4 output, so one primitive is 48 bytes.
+ */
+#define VERTEX_COUNT        64
+#define INDEX_COUNT         128
+#define CAPTURE_SIZE        4096
+#define PRIMITIVE_BYTES     48
+
+enum {
+    XFB_DIRECT,             // Slot = primitive, counts from the CPU
+    XFB_DIRECT_GPU,         // Slot = primitive, offsets in the GPU state
+    XFB_ATOMIC,             // Emits p % 3 copies into reserved slots
+    XFB_RESOLVE,            // One invocation, applies drawNeeded
+};
+
+enum {
+    TOPOLOGY_TRIANGLE_LIST,
+    TOPOLOGY_TRIANGLE_STRIP,
+};
+
+// Push constants, DxvkXfbDrawArgs for one buffer
+typedef struct {
+    uint32_t primitiveCount;
+    uint32_t primitiveLimit;
+    uint32_t offset;
+    uint32_t topology;
+    uint32_t mode;
+    uint32_t bufferSize;
+    uint32_t primitiveBytes;
+    uint32_t firstIndex;
+} XfbArgs;
+
+// GPU state buffer
+typedef struct {
+    uint32_t offsets[4];
+    uint32_t written;
+    uint32_t needed;
+    uint32_t drawNeeded;
+    uint32_t pad;
+} XfbGpuState;
+
+typedef struct {
+    uint32_t* words;
+    uint32_t count;
+    uint32_t capacity;
+} SpirvBuffer;
+
+static void spv_push(SpirvBuffer* b, uint32_t word) {
+    if (b->count == b->capacity) {
+        b->capacity = b->capacity ? b->capacity * 2 : 256;
+        b->words = realloc(b->words, b->capacity * sizeof(uint32_t));
+    }
+    b->words[b->count++] = word;
+}
+
+static void spv_op(SpirvBuffer* b, uint32_t op, uint32_t n, const uint32_t* operands) {
+    spv_push(b, ((n + 1) << 16) | op);
+    for (uint32_t i = 0; i < n; i++)
+        spv_push(b, operands[i]);
+}
+
+#define SPV(b, op, ...) do { \
+    const uint32_t _ops[] = { __VA_ARGS__ }; \
+    spv_op(b, op, COUNT(_ops), _ops); \
+} while(0)
+
+/*
+ * GLSL equivalent:
+ *
+ *   uint p = gl_GlobalInvocationID.x;
+ *   if (mode == RESOLVE) {
+ *     if (p == 0) {
+ *       uint w = min(drawNeeded, (bufferSize - offsets[0]) / primitiveBytes);
+ *       offsets[0] += w * primitiveBytes; written += w;
+ *       needed += drawNeeded; drawNeeded = 0;
+ *     }
+ *   } else if (p < primitiveCount) {
+ *     uint emit = mode == ATOMIC ? p % 3 : 1;
+ *     uint base = gpu ? offsets[0] : offset;
+ *     uint limit = gpu ? (bufferSize - base) / primitiveBytes : primitiveLimit;
+ *     uint old = atomicAdd(drawNeeded, gpu ? emit : 0);
+ *     uint slot = mode == ATOMIC ? old : p;
+ *     vec4 v[3] = 2 * vertices[indices[firstIndex + seq(p, k)]];
+ *     for (c = 0; c < 2; c++)
+ *       if (c < emit && slot + c < limit)
+ *         capture[base / 16 + (slot + c) * 3 + k] = v[k] + vec4(0, c, 0, 0);
+ *   }
+ */
+static SpirvBuffer make_xfb_variant(void) {
+    enum {
+        idVoid = 1, idFnVoid, idBool, idUint, idFloat, idVec4, idUvec3,
+        idVec4Array, idUintArray, idVec4Struct, idUintStruct, idStateStruct, idArgsStruct,
+        idPtrVec4Struct, idPtrUintStruct, idPtrStateStruct, idPtrArgsStruct,
+        idPtrVec4, idPtrUint, idPtrPcUint, idPtrInputUvec3,
+        idU0, idU1, idU2, idU3, idU4, idU5, idU6, idU7, idF0, idF1, idF2,
+        idVertices, idIndices, idCapture, idState, idArgs, idGid,
+        idMain, idFirst
+    };
+
+    uint32_t next = idFirst;
+    SpirvBuffer b = { NULL, 0, 0 };
+
+    // Header, bound patched below
+    spv_push(&b, 0x07230203u);
+    spv_push(&b, 0x00010000u);
+    spv_push(&b, 0);
+    spv_push(&b, 0);
+    spv_push(&b, 0);
+
+    SPV(&b, 17, 1);                                         // OpCapability Shader
+    SPV(&b, 14, 0, 1);                                      // OpMemoryModel Logical GLSL450
+    SPV(&b, 15, 5, idMain, 0x6e69616du, 0, idGid);          // OpEntryPoint GLCompute "main"
+    SPV(&b, 16, idMain, 17, 64, 1, 1);                      // OpExecutionMode LocalSize 64 1 1
+
+    // Decorations
+    SPV(&b, 71, idGid, 11, 28);                             // BuiltIn GlobalInvocationId
+    SPV(&b, 71, idVec4Array, 6, 16);                        // ArrayStride 16
+    SPV(&b, 71, idUintArray, 6, 4);                         // ArrayStride 4
+    SPV(&b, 71, idVec4Struct, 3);                           // BufferBlock
+    SPV(&b, 72, idVec4Struct, 0, 35, 0);
+    SPV(&b, 71, idUintStruct, 3);
+    SPV(&b, 72, idUintStruct, 0, 35, 0);
+    SPV(&b, 71, idStateStruct, 3);
+    for (uint32_t i = 0; i < 7; i++)
+        SPV(&b, 72, idStateStruct, i, 35, 4 * i);           // OpMemberDecorate Offset
+    SPV(&b, 71, idArgsStruct, 2);                           // Block
+    for (uint32_t i = 0; i < 8; i++)
+        SPV(&b, 72, idArgsStruct, i, 35, 4 * i);
+
+    const uint32_t vars[] = { idVertices, idIndices, idCapture, idState };
+    for (uint32_t i = 0; i < COUNT(vars); i++) {
+        SPV(&b, 71, vars[i], 34, 0);                        // DescriptorSet 0
+        SPV(&b, 71, vars[i], 33, i);                        // Binding i
+    }
+
+    // Types, constants, variables
+    SPV(&b, 19, idVoid);                                    // OpTypeVoid
+    SPV(&b, 33, idFnVoid, idVoid);                          // OpTypeFunction
+    SPV(&b, 20, idBool);                                    // OpTypeBool
+    SPV(&b, 21, idUint, 32, 0);                             // OpTypeInt 32 unsigned
+    SPV(&b, 22, idFloat, 32);                               // OpTypeFloat 32
+    SPV(&b, 23, idVec4, idFloat, 4);                        // OpTypeVector
+    SPV(&b, 23, idUvec3, idUint, 3);
+    SPV(&b, 29, idVec4Array, idVec4);                       // OpTypeRuntimeArray
+    SPV(&b, 29, idUintArray, idUint);
+    SPV(&b, 30, idVec4Struct, idVec4Array);                 // OpTypeStruct
+    SPV(&b, 30, idUintStruct, idUintArray);
+    SPV(&b, 30, idStateStruct, idUint, idUint, idUint, idUint, idUint, idUint, idUint);
+    SPV(&b, 30, idArgsStruct, idUint, idUint, idUint, idUint, idUint, idUint, idUint, idUint);
+    SPV(&b, 32, idPtrVec4Struct, 2, idVec4Struct);          // OpTypePointer Uniform
+    SPV(&b, 32, idPtrUintStruct, 2, idUintStruct);
+    SPV(&b, 32, idPtrStateStruct, 2, idStateStruct);
+    SPV(&b, 32, idPtrArgsStruct, 9, idArgsStruct);          // PushConstant
+    SPV(&b, 32, idPtrVec4, 2, idVec4);
+    SPV(&b, 32, idPtrUint, 2, idUint);
+    SPV(&b, 32, idPtrPcUint, 9, idUint);
+    SPV(&b, 32, idPtrInputUvec3, 1, idUvec3);               // Input
+
+    const uint32_t u[] = { idU0, idU1, idU2, idU3, idU4, idU5, idU6, idU7 };
+    for (uint32_t i = 0; i < COUNT(u); i++)
+        SPV(&b, 43, idUint, u[i], i);                       // OpConstant
+    SPV(&b, 43, idFloat, idF0, 0x00000000u);
+    SPV(&b, 43, idFloat, idF1, 0x3f800000u);
+    SPV(&b, 43, idFloat, idF2, 0x40000000u);
+
+    SPV(&b, 59, idPtrVec4Struct, idVertices, 2);            // OpVariable Uniform
+    SPV(&b, 59, idPtrUintStruct, idIndices, 2);
+    SPV(&b, 59, idPtrVec4Struct, idCapture, 2);
+    SPV(&b, 59, idPtrStateStruct, idState, 2);
+    SPV(&b, 59, idPtrArgsStruct, idArgs, 9);
+    SPV(&b, 59, idPtrInputUvec3, idGid, 1);
+
+    // Instruction helpers, results get the next id
+    #define ID(name) uint32_t name = next++
+    #define LOAD_ARG(name, member) \
+        ID(name##Ptr); SPV(&b, 65, idPtrPcUint, name##Ptr, idArgs, u[member]); \
+        ID(name); SPV(&b, 61, idUint, name, name##Ptr)
+    #define LOAD_STATE(name, member) \
+        ID(name##Ptr); SPV(&b, 65, idPtrUint, name##Ptr, idState, u[member]); \
+        ID(name); SPV(&b, 61, idUint, name, name##Ptr)
+
+    ID(lEntry); ID(lResolve); ID(lResolveDo); ID(lResolveEnd);
+    ID(lDraw); ID(lDrawDo); ID(lDrawEnd); ID(lEnd);
+
+    SPV(&b, 54, idVoid, idMain, 0, idFnVoid);               // OpFunction
+    SPV(&b, 248, lEntry);                                   // OpLabel
+    ID(gid); SPV(&b, 61, idUvec3, gid, idGid);              // OpLoad
+    ID(p); SPV(&b, 81, idUint, p, gid, 0);                  // OpCompositeExtract
+    LOAD_ARG(mode, 4);
+    ID(isResolve); SPV(&b, 170, idBool, isResolve, mode, idU3);    // OpIEqual
+    SPV(&b, 247, lEnd, 0);                                  // OpSelectionMerge
+    SPV(&b, 250, isResolve, lResolve, lDraw);               // OpBranchConditional
+
+    // Resolve
+    SPV(&b, 248, lResolve);
+    ID(isFirst); SPV(&b, 170, idBool, isFirst, p, idU0);
+    SPV(&b, 247, lResolveEnd, 0);
+    SPV(&b, 250, isFirst, lResolveDo, lResolveEnd);
+
+    SPV(&b, 248, lResolveDo);
+    LOAD_STATE(offset, 0);
+    LOAD_STATE(drawNeeded, 6);
+    LOAD_ARG(size, 5);
+    LOAD_ARG(primBytes, 6);
+    ID(space); SPV(&b, 130, idUint, space, size, offset);           // OpISub
+    ID(limit); SPV(&b, 134, idUint, limit, space, primBytes);       // OpUDiv
+    ID(fits); SPV(&b, 176, idBool, fits, drawNeeded, limit);        // OpULessThan
+    ID(w); SPV(&b, 169, idUint, w, fits, drawNeeded, limit);        // OpSelect
+    ID(bytes); SPV(&b, 132, idUint, bytes, w, primBytes);           // OpIMul
+    ID(newOffset); SPV(&b, 128, idUint, newOffset, offset, bytes);  // OpIAdd
+    SPV(&b, 62, offsetPtr, newOffset);                              // OpStore
+    LOAD_STATE(written, 4);
+    ID(newWritten); SPV(&b, 128, idUint, newWritten, written, w);
+    SPV(&b, 62, writtenPtr, newWritten);
+    LOAD_STATE(needed, 5);
+    ID(newNeeded); SPV(&b, 128, idUint, newNeeded, needed, drawNeeded);
+    SPV(&b, 62, neededPtr, newNeeded);
+    SPV(&b, 62, drawNeededPtr, idU0);
+    SPV(&b, 249, lResolveEnd);                              // OpBranch
+
+    SPV(&b, 248, lResolveEnd);
+    SPV(&b, 249, lEnd);
+
+    // Draw
+    SPV(&b, 248, lDraw);
+    LOAD_ARG(count, 0);
+    ID(inRange); SPV(&b, 176, idBool, inRange, p, count);
+    SPV(&b, 247, lDrawEnd, 0);
+    SPV(&b, 250, inRange, lDrawDo, lDrawEnd);
+
+    SPV(&b, 248, lDrawDo);
+    ID(isAtomic); SPV(&b, 170, idBool, isAtomic, mode, idU2);
+    ID(isGpu); SPV(&b, 171, idBool, isGpu, mode, idU0);             // OpINotEqual
+    ID(pMod3); SPV(&b, 137, idUint, pMod3, p, idU3);                // OpUMod
+    ID(emit); SPV(&b, 169, idUint, emit, isAtomic, pMod3, idU1);
+
+    LOAD_STATE(gpuOffset, 0);
+    LOAD_ARG(cpuOffset, 2);
+    ID(base); SPV(&b, 169, idUint, base, isGpu, gpuOffset, cpuOffset);
+    LOAD_ARG(drawSize, 5);
+    LOAD_ARG(drawPrimBytes, 6);
+    ID(drawSpace); SPV(&b, 130, idUint, drawSpace, drawSize, base);
+    ID(gpuLimit); SPV(&b, 134, idUint, gpuLimit, drawSpace, drawPrimBytes);
+    LOAD_ARG(cpuLimit, 1);
+    ID(drawLimit); SPV(&b, 169, idUint, drawLimit, isGpu, gpuLimit, cpuLimit);
+
+    ID(reserve); SPV(&b, 169, idUint, reserve, isGpu, emit, idU0);
+    ID(counterPtr); SPV(&b, 65, idPtrUint, counterPtr, idState, idU6);
+    ID(old); SPV(&b, 234, idUint, old, counterPtr, idU1, idU0, reserve);   // OpAtomicIAdd Device Relaxed
+    ID(slot); SPV(&b, 169, idUint, slot, isAtomic, old, p);
+
+    ID(baseVec); SPV(&b, 194, idUint, baseVec, base, idU4);         // OpShiftRightLogical
+
+    // Vertex fetch in Vulkan order, see dxvkXfbPrimitiveVertex
+    LOAD_ARG(topology, 3);
+    LOAD_ARG(firstIndex, 7);
+    ID(isStrip); SPV(&b, 170, idBool, isStrip, topology, idU1);
+    ID(odd); SPV(&b, 199, idUint, odd, p, idU1);                    // OpBitwiseAnd
+    ID(p3); SPV(&b, 132, idUint, p3, p, idU3);
+    ID(p1); SPV(&b, 128, idUint, p1, p, idU1);
+    ID(p2); SPV(&b, 128, idUint, p2, p, idU2);
+
+    uint32_t out[3];
+
+    for (uint32_t k = 0; k < 3; k++) {
+        ID(listSeq); SPV(&b, 128, idUint, listSeq, p3, u[k]);
+        uint32_t stripSeq = p;
+
+        if (k == 1) {
+            stripSeq = next++;
+            SPV(&b, 128, idUint, stripSeq, p1, odd);
+        } else if (k == 2) {
+            stripSeq = next++;
+            SPV(&b, 130, idUint, stripSeq, p2, odd);
+        }
+
+        ID(seq); SPV(&b, 169, idUint, seq, isStrip, stripSeq, listSeq);
+        ID(indexPos); SPV(&b, 128, idUint, indexPos, seq, firstIndex);
+        ID(indexPtr); SPV(&b, 65, idPtrUint, indexPtr, idIndices, idU0, indexPos);
+        ID(index); SPV(&b, 61, idUint, index, indexPtr);
+        ID(vertexPtr); SPV(&b, 65, idPtrVec4, vertexPtr, idVertices, idU0, index);
+        ID(vertex); SPV(&b, 61, idVec4, vertex, vertexPtr);
+        out[k] = next++;
+        SPV(&b, 142, idVec4, out[k], vertex, idF2);                 // OpVectorTimesScalar
+    }
+
+    // Up to two copies
+    for (uint32_t c = 0; c < 2; c++) {
+        ID(lCopy); ID(lCopyEnd);
+
+        ID(emitted); SPV(&b, 176, idBool, emitted, u[c], emit);
+        ID(slotC); SPV(&b, 128, idUint, slotC, slot, u[c]);
+        ID(fitsC); SPV(&b, 176, idBool, fitsC, slotC, drawLimit);
+        ID(store); SPV(&b, 167, idBool, store, emitted, fitsC);      // OpLogicalAnd
+        SPV(&b, 247, lCopyEnd, 0);
+        SPV(&b, 250, store, lCopy, lCopyEnd);
+
+        SPV(&b, 248, lCopy);
+        ID(row); SPV(&b, 132, idUint, row, slotC, idU3);
+        ID(rowBase); SPV(&b, 128, idUint, rowBase, baseVec, row);
+        ID(copyOffset); SPV(&b, 80, idVec4, copyOffset, idF0, c ? idF1 : idF0, idF0, idF0);   // OpCompositeConstruct
+
+        for (uint32_t k = 0; k < 3; k++) {
+            ID(value); SPV(&b, 129, idVec4, value, out[k], copyOffset);  // OpFAdd
+            ID(dstIndex); SPV(&b, 128, idUint, dstIndex, rowBase, u[k]);
+            ID(dstPtr); SPV(&b, 65, idPtrVec4, dstPtr, idCapture, idU0, dstIndex);
+            SPV(&b, 62, dstPtr, value);
+        }
+
+        SPV(&b, 249, lCopyEnd);
+        SPV(&b, 248, lCopyEnd);
+    }
+
+    SPV(&b, 249, lDrawEnd);
+    SPV(&b, 248, lDrawEnd);
+    SPV(&b, 249, lEnd);
+
+    SPV(&b, 248, lEnd);
+    spv_push(&b, (1u << 16) | 253);                         // OpReturn
+    spv_push(&b, (1u << 16) | 56);                          // OpFunctionEnd
+
+    #undef LOAD_STATE
+    #undef LOAD_ARG
+    #undef ID
+
+    b.words[3] = next;
+    return b;
+}
+
+/* ============================================
+ * Emulation state
+ * ============================================ */
+typedef struct {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    void* data;
+} HostBuffer;
+
+static VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+static VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+static VkPipeline xfbPipeline = VK_NULL_HANDLE;
+static VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+static VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+static VkCommandPool commandPool = VK_NULL_HANDLE;
+static VkCommandBuffer cmd = VK_NULL_HANDLE;
+static VkFence fence = VK_NULL_HANDLE;
+
+static HostBuffer vertexBuffer, indexBuffer, captureBuffer, stateBuffer;
+static HostBuffer counterBuffer, queryBuffer;
+
+/*
+ * What DxvkXfbEmulation tracks, for buffer 0 only. A counter is
+ * either known on the CPU or only in counterBuffer.
+ */
+typedef struct {
+    int known;
+    uint32_t offset;
+} XfbCounter;
+
+typedef struct {
+    uint32_t size;
+    uint32_t offset;
+    int gpu;
+    uint64_t written;
+    uint64_t needed;
+} XfbStream;
+
+typedef struct {
+    uint64_t written;
+    uint64_t needed;
+} XfbQuery;
+
+static XfbStream xfb;
+
+static int find_memory_type(uint32_t typeBits, VkMemoryPropertyFlags flags, uint32_t* index) {
+    for (uint32_t i = 0; i < memoryProps.memoryTypeCount; i++) {
+        if ((typeBits & (1u << i)) && (memoryProps.memoryTypes[i].propertyFlags & flags) == flags) {
+            *index = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int create_host_buffer(VkDeviceSize size, HostBuffer* buffer) {
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+               | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+               | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    TEST_VK(vkCreateBuffer(device, &bufferInfo, NULL, &buffer->buffer));
+
+    VkMemoryRequirements req;
+    vkGetBufferMemoryRequirements(device, buffer->buffer, &req);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = req.size,
+    };
+
+    TEST_ASSERT(find_memory_type(req.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        &allocInfo.memoryTypeIndex), "No host visible memory");
+
+    TEST_VK(vkAllocateMemory(device, &allocInfo, NULL, &buffer->memory));
+    TEST_VK(vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0));
+    TEST_VK(vkMapMemory(device, buffer->memory, 0, size, 0, &buffer->data));
+    return 1;
+}
+
+static void destroy_host_buffer(HostBuffer* buffer) {
+    if (buffer->buffer) vkDestroyBuffer(device, buffer->buffer, NULL);
+    if (buffer->memory) vkFreeMemory(device, buffer->memory, NULL);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+static int setup_emulation(void) {
+    VkDescriptorSetLayoutBinding bindings[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding) {
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 4,
+        .pBindings = bindings,
+    };
+
+    TEST_VK(vkCreateDescriptorSetLayout(device, &setLayoutInfo, NULL, &setLayout));
+
+    VkPushConstantRange pushRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(XfbArgs),
+    };
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushRange,
+    };
+
+    TEST_VK(vkCreatePipelineLayout(device, &layoutInfo, NULL, &pipelineLayout));
+
+    SpirvBuffer code = make_xfb_variant();
+
+    VkShaderModuleCreateInfo moduleInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = code.count * sizeof(uint32_t),
+        .pCode = code.words,
+    };
+
+    VkShaderModule module;
+    VkResult result = vkCreateShaderModule(device, &moduleInfo, NULL, &module);
+    free(code.words);
+    TEST_VK(result);
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+        },
+        .layout = pipelineLayout,
+    };
+
+    result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &xfbPipeline);
+    vkDestroyShaderModule(device, module, NULL);
+    TEST_VK(result);
+
+    TEST_ASSERT(create_host_buffer(VERTEX_COUNT * 16, &vertexBuffer), "Vertex buffer");
+    TEST_ASSERT(create_host_buffer(INDEX_COUNT * 4, &indexBuffer), "Index buffer");
+    TEST_ASSERT(create_host_buffer(CAPTURE_SIZE, &captureBuffer), "Capture buffer");
+    TEST_ASSERT(create_host_buffer(sizeof(XfbGpuState), &stateBuffer), "State buffer");
+    TEST_ASSERT(create_host_buffer(16, &counterBuffer), "Counter buffer");
+    TEST_ASSERT(create_host_buffer(16, &queryBuffer), "Query buffer");
+
+    float* vertices = vertexBuffer.data;
+    uint32_t* indices = indexBuffer.data;
+
+    for (uint32_t i = 0; i < VERTEX_COUNT; i++) {
+        vertices[4 * i + 0] = (float)i;
+        vertices[4 * i + 1] = 0.0f;
+        vertices[4 * i + 2] = 0.0f;
+        vertices[4 * i + 3] = 1.0f;
+    }
+
+    for (uint32_t i = 0; i < INDEX_COUNT; i++)
+        indices[i] = i % VERTEX_COUNT;
+
+    VkDescriptorPoolSize poolSize = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 4,
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+    };
+
+    TEST_VK(vkCreateDescriptorPool(device, &poolInfo, NULL, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo setInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &setLayout,
+    };
+
+    TEST_VK(vkAllocateDescriptorSets(device, &setInfo, &descriptorSet));
+
+    const HostBuffer* buffers[] = { &vertexBuffer, &indexBuffer, &captureBuffer, &stateBuffer };
+    VkDescriptorBufferInfo bufferInfos[4];
+    VkWriteDescriptorSet writes[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        bufferInfos[i] = (VkDescriptorBufferInfo) { buffers[i]->buffer, 0, VK_WHOLE_SIZE };
+        writes[i] = (VkWriteDescriptorSet) {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &bufferInfos[i],
+        };
+    }
+
+    vkUpdateDescriptorSets(device, 4, writes, 0, NULL);
+
+    VkCommandPoolCreateInfo commandPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamily,
+    };
+
+    TEST_VK(vkCreateCommandPool(device, &commandPoolInfo, NULL, &commandPool));
+
+    VkCommandBufferAllocateInfo cmdInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    TEST_VK(vkAllocateCommandBuffers(device, &cmdInfo, &cmd));
+
+    VkFenceCreateInfo fenceInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+
+    TEST_VK(vkCreateFence(device, &fenceInfo, NULL, &fence));
+    return 1;
+}
+
+static void cleanup_emulation(void) {
+    if (!device) return;
+
+    if (fence) vkDestroyFence(device, fence, NULL);
+    if (commandPool) vkDestroyCommandPool(device, commandPool, NULL);
+    if (descriptorPool) vkDestroyDescriptorPool(device, descriptorPool, NULL);
+
+    destroy_host_buffer(&vertexBuffer);
+    destroy_host_buffer(&indexBuffer);
+    destroy_host_buffer(&captureBuffer);
+    destroy_host_buffer(&stateBuffer);
+    destroy_host_buffer(&counterBuffer);
+    destroy_host_buffer(&queryBuffer);
+
+    if (xfbPipeline) vkDestroyPipeline(device, xfbPipeline, NULL);
+    if (pipelineLayout) vkDestroyPipelineLayout(device, pipelineLayout, NULL);
+    if (setLayout) vkDestroyDescriptorSetLayout(device, setLayout, NULL);
+}
+
+/*
+ * Fresh capture buffer filled with 0xff, zeroed GPU state, and a
+ * command buffer in recording state.
+ */
+static int begin_test(uint32_t captureSize) {
+    memset(captureBuffer.data, 0xff, CAPTURE_SIZE);
+    memset(stateBuffer.data, 0, sizeof(XfbGpuState));
+    memset(counterBuffer.data, 0, 16);
+    memset(queryBuffer.data, 0, 16);
+    memset(&xfb, 0, sizeof(xfb));
+    xfb.size = captureSize;
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    TEST_VK(vkResetCommandBuffer(cmd, 0));
+    TEST_VK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, xfbPipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    return 1;
+}
+
+static void barrier(void) {
+    VkMemoryBarrier memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+                       | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                       | VK_ACCESS_HOST_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &memoryBarrier, 0, NULL, 0, NULL);
+}
+
+static int submit_test(void) {
+    TEST_VK(vkEndCommandBuffer(cmd));
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmd,
+    };
+
+    TEST_VK(vkResetFences(device, 1, &fence));
+    TEST_VK(vkQueueSubmit(queue, 1, &submitInfo, fence));
+    TEST_VK(vkWaitForFences(device, 1, &fence, VK_TRUE, ~0ull));
+    return 1;
+}
+
+static void copy_buffer(VkBuffer src, uint32_t srcOffset, VkBuffer dst, uint32_t dstOffset, uint32_t size) {
+    VkBufferCopy region = { srcOffset, dstOffset, size };
+    vkCmdCopyBuffer(cmd, src, dst, 1, &region);
+    barrier();
+}
+
+static void dispatch(const XfbArgs* args, uint32_t invocations) {
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(*args), args);
+    vkCmdDispatch(cmd, (invocations + 63) / 64, 1, 1);
+    barrier();
+}
+
+/*
+ * vkCmdBeginTransformFeedbackEXT. A counter only known on the GPU
+ * is copied into the state.
+ */
+static void xfb_begin(const XfbCounter* counter) {
+    xfb.offset = counter ? counter->offset : 0;
+    xfb.gpu = counter && !counter->known;
+
+    if (xfb.gpu)
+        copy_buffer(counterBuffer.buffer, 0, stateBuffer.buffer, 0, 4);
+}
+
+/*
+ * vkCmdEndTransformFeedbackEXT, storing the counter
+ */
+static void xfb_end(XfbCounter* counter) {
+    if (!counter)
+        return;
+
+    counter->known = !xfb.gpu;
+    counter->offset = xfb.gpu ? 0 : xfb.offset;
+
+    if (xfb.gpu)
+        copy_buffer(stateBuffer.buffer, 0, counterBuffer.buffer, 0, 4);
+}
+
+/*
+ * A captured draw, planned like DxvkXfbEmulation::draw
+ */
+static void xfb_draw(uint32_t topology, uint32_t firstIndex, uint32_t primitiveCount, int atomic) {
+    XfbArgs args = {
+        .primitiveCount = primitiveCount,
+        .offset = xfb.offset,
+        .topology = topology,
+        .bufferSize = xfb.size,
+        .primitiveBytes = PRIMITIVE_BYTES,
+        .firstIndex = firstIndex,
+    };
+
+    if (atomic || xfb.gpu) {
+        if (!xfb.gpu) {
+            vkCmdUpdateBuffer(cmd, stateBuffer.buffer, 0, 4, &xfb.offset);
+            barrier();
+        }
+
+        xfb.gpu = 1;
+
+        args.mode = atomic ? XFB_ATOMIC : XFB_DIRECT_GPU;
+        dispatch(&args, primitiveCount);
+
+        args.mode = XFB_RESOLVE;
+        dispatch(&args, 1);
+        return;
+    }
+
+    uint32_t space = xfb.size > xfb.offset ? xfb.size - xfb.offset : 0;
+    uint32_t limit = space / PRIMITIVE_BYTES;
+    uint32_t written = primitiveCount < limit ? primitiveCount : limit;
+
+    xfb.offset += written * PRIMITIVE_BYTES;
+    xfb.written += written;
+    xfb.needed += primitiveCount;
+
+    args.mode = XFB_DIRECT;
+    args.primitiveLimit = written;
+    dispatch(&args, primitiveCount);
+}
+
+/*
+ * Queries snapshot the CPU counts and copy the GPU counts
+ * to queryBuffer, at 0 on begin and at 8 on end.
+ */
+static void xfb_begin_query(XfbQuery* query) {
+    query->written = xfb.written;
+    query->needed = xfb.needed;
+    copy_buffer(stateBuffer.buffer, 16, queryBuffer.buffer, 0, 8);
+}
+
+static void xfb_end_query(XfbQuery* query) {
+    query->written = xfb.written - query->written;
+    query->needed = xfb.needed - query->needed;
+    copy_buffer(stateBuffer.buffer, 16, queryBuffer.buffer, 8, 8);
+}
+
+static XfbQuery xfb_query_result(const XfbQuery* query) {
+    const uint32_t* gpu = queryBuffer.data;
+    XfbQuery result = {
+        query->written + (gpu[2] - gpu[0]),
+        query->needed + (gpu[3] - gpu[1]),
+    };
+    return result;
+}
+
+static const XfbGpuState* gpu_state(void) {
+    return stateBuffer.data;
+}
+
+/*
+ * Checks that capture slot `slot` holds copy `copy` of triangle
+ * (a, b, c) of the vertex buffer
+ */
+static int check_triangle(uint32_t slot, uint32_t a, uint32_t b, uint32_t c, uint32_t copy) {
+    const float* data = (const float*)captureBuffer.data + 12 * slot;
+    const uint32_t v[3] = { a, b, c };
+
+    for (uint32_t k = 0; k < 3; k++) {
+        const float* out = data + 4 * k;
+
+        if (out[0] != 2.0f * (float)v[k] || out[1] != (float)copy
+         || out[2] != 0.0f || out[3] != 2.0f)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Bytes from `offset` on were never written */
+static int check_untouched(uint32_t offset) {
+    const uint8_t* data = captureBuffer.data;
+
+    for (uint32_t i = offset; i < CAPTURE_SIZE; i++) {
+        if (data[i] != 0xff)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * Atomic mode writes in no particular order: every slot must hold
+ * a distinct copy of some input triangle p of a list draw starting
+ * at vertex `first`, and every copy c < p % 3 must be there.
+ */
+static int check_atomic_slots(uint32_t firstSlot, uint32_t slotCount, uint32_t first, uint32_t primitiveCount) {
+    uint32_t seen[64] = { 0 };
+    uint32_t expected = 0;
+
+    for (uint32_t p = 0; p < primitiveCount; p++)
+        expected += p % 3;
+
+    if (primitiveCount > COUNT(seen) || slotCount > expected)
+        return 0;
+
+    const float* data = captureBuffer.data;
+
+    for (uint32_t s = firstSlot; s < firstSlot + slotCount; s++) {
+        // Unwritten slots are NaN
+        if (!(data[12 * s] >= 0.0f && data[12 * s + 1] >= 0.0f))
+            return 0;
+
+        uint32_t v0 = (uint32_t)(data[12 * s] / 2.0f);
+        uint32_t copy = (uint32_t)data[12 * s + 1];
+
+        if (v0 < first || (v0 - first) % 3)
+            return 0;
+
+        uint32_t p = (v0 - first) / 3;
+
+        if (p >= primitiveCount || copy >= p % 3 || (seen[p] & (1u << copy)))
+            return 0;
+
+        if (!check_triangle(s, v0, v0 + 1, v0 + 2, copy))
+            return 0;
+
+        seen[p] |= 1u << copy;
+    }
+
+    // Without overflow, every copy is there
+    if (slotCount == expected) {
+        for (uint32_t p = 0; p < primitiveCount; p++) {
+            if (seen[p] != (1u << (p % 3)) - 1)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
 /* ============================================
  * Test: Extension Present
  * ============================================ */
 int test_xfb_extension_present(void) {
     printf("TEST: xfb_extension_present\n");
-    
+
     uint32_t extensionCount = 0;
     vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, NULL);
-    
+
     VkExtensionProperties* extensions = malloc(extensionCount * sizeof(VkExtensionProperties));
     vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &extensionCount, extensions);
-    
+
     int found = 0;
     for (uint32_t i = 0; i < extensionCount; i++) {
         if (strcmp(extensions[i].extensionName, VK_EXT_TRANSFORM_FEEDBACK_EXTENSION_NAME) == 0) {
             found = 1;
-            printf("  Found VK_EXT_transform_feedback (spec version %d)\n", 
+            printf("  Found VK_EXT_transform_feedback (spec version %d)\n",
                    extensions[i].specVersion);
             break;
         }
     }
-    
+
     free(extensions);
-    
-    if (!found) {
+
+    if (!found)
         printf("  VK_EXT_transform_feedback NOT FOUND\n");
-        printf("  This is the first thing to implement!\n");
-        return 0;
-    }
-    
+    else if (maskNative)
+        printf("  Masked off by --emulate\n");
+
+    // The emulation needs nothing beyond Vulkan 1.0 compute
+    TEST_ASSERT(xfbPipeline != VK_NULL_HANDLE, "Emulation variant not created");
+
+    if (!nativeXfb)
+        printf("  Using the compute emulation\n");
+
+    printf("  PASSED\n");
     return 1;
 }
 
@@ -83,41 +948,49 @@ int test_xfb_extension_present(void) {
  * ============================================ */
 int test_xfb_basic_capture(void) {
     printf("TEST: xfb_basic_capture\n");
-    
-    // Skip if extension not present
-    if (!vkCmdBeginTransformFeedbackEXT) {
-        printf("  SKIPPED: Extension functions not loaded\n");
-        return 0;
-    }
-    
-    // Create a simple vertex shader that outputs position
-    // Input: vec4 position
-    // Output: vec4 position (captured via XFB)
-    
-    // ... shader creation code ...
-    
-    // Create XFB buffer
-    VkBufferCreateInfo bufferInfo = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = 1024,
-        .usage = VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_BUFFER_BIT_EXT,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-    };
-    
-    VkBuffer xfbBuffer;
-    VkResult result = vkCreateBuffer(device, &bufferInfo, NULL, &xfbBuffer);
-    
-    if (result != VK_SUCCESS) {
-        printf("  FAILED: Could not create XFB buffer (error %d)\n", result);
-        printf("  MoltenVK may not support TRANSFORM_FEEDBACK_BUFFER_BIT\n");
-        return 0;
+
+    if (nativeXfb) {
+        // Native buffers need the usage flag
+        VkBufferCreateInfo bufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = 1024,
+            .usage = VK_BUFFER_USAGE_TRANSFORM_FEEDBACK_BUFFER_BIT_EXT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+
+        VkBuffer xfbBuffer;
+        TEST_VK(vkCreateBuffer(device, &bufferInfo, NULL, &xfbBuffer));
+        vkDestroyBuffer(device, xfbBuffer, NULL);
+        printf("  Native XFB buffer created\n");
     }
-    
-    printf("  XFB buffer created successfully\n");
-    
-    // TODO: Complete test with actual rendering and verification
-    
-    vkDestroyBuffer(device, xfbBuffer, NULL);
+
+    // Indexed triangle list, then a 5 vertex strip
+    const uint32_t indices[] = { 4, 5, 6, 6, 5, 7, 9, 8, 10 };
+    memcpy((uint32_t*)indexBuffer.data + 64, indices, sizeof(indices));
+
+    TEST_ASSERT(begin_test(1024), "Command buffer");
+
+    XfbCounter counter;
+    xfb_begin(NULL);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 64, 3, 0);
+    xfb_draw(TOPOLOGY_TRIANGLE_STRIP, 0, 3, 0);
+    xfb_end(&counter);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    for (uint32_t p = 0; p < 3; p++)
+        TEST_ASSERT(check_triangle(p, indices[3 * p], indices[3 * p + 1], indices[3 * p + 2], 0), "Indexed list");
+
+    TEST_ASSERT(check_triangle(3, 0, 1, 2, 0), "Strip triangle 0");
+    TEST_ASSERT(check_triangle(4, 1, 3, 2, 0), "Strip triangle 1 winding");
+    TEST_ASSERT(check_triangle(5, 2, 3, 4, 0), "Strip triangle 2");
+    TEST_ASSERT(check_untouched(6 * PRIMITIVE_BYTES), "Written past the last primitive");
+
+    TEST_ASSERT(counter.known && counter.offset == 6 * PRIMITIVE_BYTES, "Counter");
+    TEST_ASSERT(gpu_state()->drawNeeded == 0, "Direct draws touched the GPU state");
+
+    printf("  Captured 6 triangles\n");
+    printf("  PASSED\n");
     return 1;
 }
 
@@ -126,25 +999,44 @@ int test_xfb_basic_capture(void) {
  * ============================================ */
 int test_xfb_query_primitives(void) {
     printf("TEST: xfb_query_primitives\n");
-    
-    // Create query pool for XFB statistics
-    VkQueryPoolCreateInfo queryInfo = {
-        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
-        .queryType = VK_QUERY_TYPE_TRANSFORM_FEEDBACK_STREAM_EXT,
-        .queryCount = 1,
-    };
-    
-    VkQueryPool queryPool;
-    VkResult result = vkCreateQueryPool(device, &queryInfo, NULL, &queryPool);
-    
-    if (result != VK_SUCCESS) {
-        printf("  FAILED: Could not create XFB query pool (error %d)\n", result);
-        return 0;
+
+    if (nativeXfb) {
+        VkQueryPoolCreateInfo queryInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TRANSFORM_FEEDBACK_STREAM_EXT,
+            .queryCount = 1,
+        };
+
+        VkQueryPool queryPool;
+        TEST_VK(vkCreateQueryPool(device, &queryInfo, NULL, &queryPool));
+        vkDestroyQueryPool(device, queryPool, NULL);
+        printf("  Native XFB query pool created\n");
     }
-    
-    printf("  XFB query pool created\n");
-    
-    vkDestroyQueryPool(device, queryPool, NULL);
+
+    // Room for 5 triangles: 1 before the query, 3 from a direct
+    // draw, then an atomic draw emitting 0 + 1 + 2 of which 1 fits
+    TEST_ASSERT(begin_test(5 * PRIMITIVE_BYTES), "Command buffer");
+
+    XfbQuery query;
+    xfb_begin(NULL);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 1, 0);
+    xfb_begin_query(&query);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 3, 0);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 3, 1);
+    xfb_end_query(&query);
+    xfb_end(NULL);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    XfbQuery result = xfb_query_result(&query);
+    printf("  Written %llu, needed %llu\n",
+           (unsigned long long)result.written, (unsigned long long)result.needed);
+
+    TEST_ASSERT(result.written == 4, "Primitives written");
+    TEST_ASSERT(result.needed == 6, "Primitives needed");
+    TEST_ASSERT(gpu_state()->offsets[0] == 5 * PRIMITIVE_BYTES, "GPU offset");
+
+    printf("  PASSED\n");
     return 1;
 }
 
@@ -153,8 +1045,46 @@ int test_xfb_query_primitives(void) {
  * ============================================ */
 int test_xfb_pause_resume(void) {
     printf("TEST: xfb_pause_resume\n");
-    printf("  TODO: Implement pause/resume test\n");
-    return 0;
+
+    const uint32_t indices[] = { 20, 21, 22 };
+    memcpy((uint32_t*)indexBuffer.data + 64, indices, sizeof(indices));
+
+    TEST_ASSERT(begin_test(1024), "Command buffer");
+
+    // Known counter: 2 triangles, pause, 1 more
+    XfbCounter counter;
+    xfb_begin(NULL);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 2, 0);
+    xfb_end(&counter);
+    TEST_ASSERT(counter.known && counter.offset == 96, "Paused counter");
+
+    // Draws while paused run without the variant, nothing to record
+    xfb_begin(&counter);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 64, 1, 0);
+
+    // GPU counter: 3 atomic copies of 3 inputs, pause, 2 more
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 30, 3, 1);
+    xfb_end(&counter);
+    TEST_ASSERT(!counter.known, "Counter known after an atomic draw");
+
+    xfb_begin(&counter);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 40, 2, 0);
+    xfb_end(&counter);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    TEST_ASSERT(check_triangle(0, 0, 1, 2, 0) && check_triangle(1, 3, 4, 5, 0), "Before pause");
+    TEST_ASSERT(check_triangle(2, 20, 21, 22, 0), "After resume");
+    TEST_ASSERT(check_atomic_slots(3, 3, 30, 3), "Atomic slots");
+    TEST_ASSERT(check_triangle(6, 40, 41, 42, 0) && check_triangle(7, 43, 44, 45, 0), "After GPU resume");
+    TEST_ASSERT(check_untouched(8 * PRIMITIVE_BYTES), "Written past the end");
+
+    const uint32_t* stored = counterBuffer.data;
+    TEST_ASSERT(stored[0] == 8 * PRIMITIVE_BYTES, "Stored counter");
+
+    printf("  Counter after resume: %u bytes\n", stored[0]);
+    printf("  PASSED\n");
+    return 1;
 }
 
 /* ============================================
@@ -162,13 +1092,104 @@ int test_xfb_pause_resume(void) {
  * ============================================ */
 int test_xfb_overflow(void) {
     printf("TEST: xfb_overflow\n");
-    printf("  TODO: Implement overflow test\n");
-    return 0;
+
+    // Room for 2.5 triangles, only whole ones are written
+    TEST_ASSERT(begin_test(120), "Command buffer");
+
+    XfbQuery query;
+    xfb_begin(NULL);
+    xfb_begin_query(&query);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 4, 0);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 1, 0);
+    xfb_end_query(&query);
+    xfb_end(NULL);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    XfbQuery result = xfb_query_result(&query);
+    TEST_ASSERT(result.written == 2 && result.needed == 5, "Direct counts");
+    TEST_ASSERT(check_triangle(0, 0, 1, 2, 0) && check_triangle(1, 3, 4, 5, 0), "Direct primitives");
+    TEST_ASSERT(check_untouched(2 * PRIMITIVE_BYTES), "Partial primitive written");
+
+    // Same on the GPU: 6 copies into room for 2
+    TEST_ASSERT(begin_test(2 * PRIMITIVE_BYTES), "Command buffer");
+
+    xfb_begin(NULL);
+    xfb_begin_query(&query);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 6, 1);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 2, 0);
+    xfb_end_query(&query);
+    xfb_end(NULL);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    result = xfb_query_result(&query);
+    TEST_ASSERT(result.written == 2 && result.needed == 8, "Atomic counts");
+    TEST_ASSERT(check_atomic_slots(0, 2, 0, 6), "Atomic primitives");
+    TEST_ASSERT(check_untouched(2 * PRIMITIVE_BYTES), "Atomic draw overflowed");
+    TEST_ASSERT(gpu_state()->offsets[0] == 2 * PRIMITIVE_BYTES, "GPU offset");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Atomic Capture
+ * ============================================ */
+int test_xfb_atomic_capture(void) {
+    printf("TEST: xfb_atomic_capture\n");
+
+    // 21 input triangles emit 0, 1 or 2 copies each, after a
+    // direct draw so the atomic slots start at a non-zero offset
+    TEST_ASSERT(begin_test(CAPTURE_SIZE), "Command buffer");
+
+    XfbQuery query;
+    xfb_begin(NULL);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 1, 0);
+    xfb_begin_query(&query);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 0, 16, 1);
+    xfb_draw(TOPOLOGY_TRIANGLE_LIST, 48, 5, 1);
+    xfb_end_query(&query);
+    xfb_end(NULL);
+
+    TEST_ASSERT(submit_test(), "Submit");
+
+    XfbQuery result = xfb_query_result(&query);
+    printf("  Written %llu, needed %llu\n",
+           (unsigned long long)result.written, (unsigned long long)result.needed);
+
+    // 16 inputs emit 15 copies, 5 emit 4
+    TEST_ASSERT(result.written == 19 && result.needed == 19, "Atomic counts");
+    TEST_ASSERT(check_triangle(0, 0, 1, 2, 0), "Direct primitive");
+    TEST_ASSERT(check_atomic_slots(1, 15, 0, 16), "First atomic draw");
+    TEST_ASSERT(check_atomic_slots(16, 4, 48, 5), "Second atomic draw");
+    TEST_ASSERT(check_untouched(20 * PRIMITIVE_BYTES), "Written past the end");
+    TEST_ASSERT(gpu_state()->offsets[0] == 20 * PRIMITIVE_BYTES, "GPU offset");
+
+    printf("  PASSED\n");
+    return 1;
 }
 
 /* ============================================
  * Vulkan Setup
  * ============================================ */
+static int has_instance_layer(const char* name) {
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, NULL);
+
+    VkLayerProperties* layers = malloc(layerCount * sizeof(VkLayerProperties));
+    vkEnumerateInstanceLayerProperties(&layerCount, layers);
+
+    int found = 0;
+    for (uint32_t i = 0; i < layerCount; i++) {
+        if (strcmp(layers[i].layerName, name) == 0)
+            found = 1;
+    }
+
+    free(layers);
+    return found;
+}
+
 int setup_vulkan(void) {
     // Create instance
     VkApplicationInfo appInfo = {
@@ -179,54 +1200,59 @@ int setup_vulkan(void) {
         .engineVersion = VK_MAKE_VERSION(1, 0, 0),
         .apiVersion = VK_API_VERSION_1_2,
     };
-    
+
     const char* layers[] = { "VK_LAYER_KHRONOS_validation" };
-    
+
+    // Validation if installed, software drivers often come without
     VkInstanceCreateInfo instanceInfo = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
         .pApplicationInfo = &appInfo,
-        .enabledLayerCount = 1,
+        .enabledLayerCount = has_instance_layer(layers[0]) ? 1 : 0,
         .ppEnabledLayerNames = layers,
     };
-    
+
     if (vkCreateInstance(&instanceInfo, NULL, &instance) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create Vulkan instance\n");
         return 0;
     }
-    
+
     // Get physical device
     uint32_t deviceCount = 1;
     vkEnumeratePhysicalDevices(instance, &deviceCount, &physicalDevice);
-    
+
     if (physicalDevice == VK_NULL_HANDLE) {
         fprintf(stderr, "No Vulkan device found\n");
         return 0;
     }
-    
+
     // Print device info
     VkPhysicalDeviceProperties props;
     vkGetPhysicalDeviceProperties(physicalDevice, &props);
     printf("Using device: %s\n", props.deviceName);
-    printf("Driver version: %d.%d.%d\n", 
+    printf("Driver version: %d.%d.%d\n",
            VK_VERSION_MAJOR(props.driverVersion),
            VK_VERSION_MINOR(props.driverVersion),
            VK_VERSION_PATCH(props.driverVersion));
-    
-    // Find queue family
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+
+    // Find queue family, the emulation needs compute
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
     VkQueueFamilyProperties* queueFamilies = malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies);
-    
+
+    const VkQueueFlags queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+
     for (uint32_t i = 0; i < queueFamilyCount; i++) {
-        if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if ((queueFamilies[i].queueFlags & queueFlags) == queueFlags) {
             queueFamily = i;
             break;
         }
     }
     free(queueFamilies);
-    
-    // Create device with XFB extension (if available)
+
+    // Create device with XFB extension (if available and not masked)
     float queuePriority = 1.0f;
     VkDeviceQueueCreateInfo queueInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
@@ -234,17 +1260,17 @@ int setup_vulkan(void) {
         .queueCount = 1,
         .pQueuePriorities = &queuePriority,
     };
-    
+
     const char* deviceExtensions[] = {
         VK_EXT_TRANSFORM_FEEDBACK_EXTENSION_NAME,
     };
-    
+
     VkPhysicalDeviceTransformFeedbackFeaturesEXT xfbFeatures = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TRANSFORM_FEEDBACK_FEATURES_EXT,
         .transformFeedback = VK_TRUE,
         .geometryStreams = VK_TRUE,
     };
-    
+
     VkDeviceCreateInfo deviceInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = &xfbFeatures,
@@ -253,17 +1279,21 @@ int setup_vulkan(void) {
         .enabledExtensionCount = 1,
         .ppEnabledExtensionNames = deviceExtensions,
     };
-    
-    VkResult result = vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device);
-    
+
+    VkResult result = VK_ERROR_EXTENSION_NOT_PRESENT;
+
+    if (!maskNative)
+        result = vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device);
+
     if (result != VK_SUCCESS) {
-        printf("Note: Could not create device with XFB extension (error %d)\n", result);
-        printf("Creating device without XFB for basic tests...\n");
-        
+        if (!maskNative)
+            printf("Note: Could not create device with XFB extension (error %d)\n", result);
+        printf("Creating device without XFB, using the emulation...\n");
+
         deviceInfo.pNext = NULL;
         deviceInfo.enabledExtensionCount = 0;
         deviceInfo.ppEnabledExtensionNames = NULL;
-        
+
         if (vkCreateDevice(physicalDevice, &deviceInfo, NULL, &device) != VK_SUCCESS) {
             fprintf(stderr, "Failed to create Vulkan device\n");
             return 0;
@@ -276,16 +1306,24 @@ int setup_vulkan(void) {
             vkGetDeviceProcAddr(device, "vkCmdEndTransformFeedbackEXT");
         vkCmdBindTransformFeedbackBuffersEXT = (PFN_vkCmdBindTransformFeedbackBuffersEXT)
             vkGetDeviceProcAddr(device, "vkCmdBindTransformFeedbackBuffersEXT");
-            
+
+        nativeXfb = vkCmdBeginTransformFeedbackEXT != NULL;
         printf("XFB extension enabled and functions loaded\n");
     }
-    
+
     vkGetDeviceQueue(device, queueFamily, 0, &queue);
-    
+
+    if (!setup_emulation()) {
+        fprintf(stderr, "Failed to set up the XFB emulation\n");
+        return 0;
+    }
+
+    printf("\n");
     return 1;
 }
 
 void cleanup_vulkan(void) {
+    cleanup_emulation();
     if (device) vkDestroyDevice(device, NULL);
     if (instance) vkDestroyInstance(instance, NULL);
 }
@@ -294,31 +1332,42 @@ void cleanup_vulkan(void) {
  * Main
  * ============================================ */
 int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--emulate") == 0) {
+            maskNative = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--emulate]\n", argv[0]);
+            return 1;
+        }
+    }
+
     printf("========================================\n");
     printf("Transform Feedback Test Suite\n");
     printf("========================================\n\n");
-    
+
     if (!setup_vulkan()) {
+        cleanup_vulkan();
         return 1;
     }
-    
+
     int passed = 0;
     int failed = 0;
-    int total = 5;
-    
+    int total = 6;
+
     // Run tests in order of complexity
     if (test_xfb_extension_present()) passed++; else failed++;
     if (test_xfb_basic_capture()) passed++; else failed++;
     if (test_xfb_query_primitives()) passed++; else failed++;
     if (test_xfb_pause_resume()) passed++; else failed++;
     if (test_xfb_overflow()) passed++; else failed++;
-    
+    if (test_xfb_atomic_capture()) passed++; else failed++;
+
     printf("\n========================================\n");
     printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
     printf("========================================\n");
-    
+
     cleanup_vulkan();
-    
+
     if (failed == 0) {
         printf("PASSED\n");
         return 0;
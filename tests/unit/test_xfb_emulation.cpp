@@ -0,0 +1,318 @@
+/*
+ * Transform Feedback Emulation Test Suite
+ *
+ * These tests verify the transform feedback emulation state
+ * (src/dxvk/dxvk_xfb_emulation.h): primitive order, offsets and
+ * query counts of draws resolved on the CPU, and when a draw has
+ * to be resolved on the GPU instead.
+ * CPU only, no Vulkan device needed. test_xfb runs the variant.
+ * Run with: make test-cpu
+ *
+ * Test progression:
+ * 1. test_xfb_emu_topology - Are primitives counted and ordered like Vulkan does?
+ * 2. test_xfb_emu_direct - Do direct draws advance the offsets of every buffer?
+ * 3. test_xfb_emu_overflow - Are only whole primitives written, and all counted?
+ * 4. test_xfb_emu_pause_resume - Do counters carry the offsets across sections?
+ * 5. test_xfb_emu_gpu_resolve - Do indirect and geometry draws move to the GPU state?
+ * 6. test_xfb_emu_query - Do queries count written and needed primitives?
+ */
+
+#include "dxvk/dxvk_xfb_emulation.h"
+
+#include <stdio.h>
+
+using namespace dxvk;
+
+#define TEST_ASSERT(cond, msg) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "FAILED: %s\n  %s:%d\n", msg, __FILE__, __LINE__); \
+        return 0; \
+    } \
+} while(0)
+
+static DxvkXfbDrawInfo triangles(uint32_t vertexCount) {
+    DxvkXfbDrawInfo info;
+    info.topology = DxvkXfbTopology::TriangleList;
+    info.vertexCount = vertexCount;
+    return info;
+}
+
+/* ============================================
+ * Test: Topology
+ * ============================================ */
+int test_xfb_emu_topology(void) {
+    printf("TEST: xfb_emu_topology\n");
+
+    TEST_ASSERT(dxvkXfbVerticesPerPrimitive(DxvkXfbTopology::PointList) == 1, "Point vertices");
+    TEST_ASSERT(dxvkXfbVerticesPerPrimitive(DxvkXfbTopology::LineStrip) == 2, "Line vertices");
+    TEST_ASSERT(dxvkXfbVerticesPerPrimitive(DxvkXfbTopology::TriangleFan) == 3, "Triangle vertices");
+
+    TEST_ASSERT(dxvkXfbPrimitiveCount(DxvkXfbTopology::TriangleList, 8) == 2, "List count");
+    TEST_ASSERT(dxvkXfbPrimitiveCount(DxvkXfbTopology::TriangleStrip, 6) == 4, "Strip count");
+    TEST_ASSERT(dxvkXfbPrimitiveCount(DxvkXfbTopology::TriangleStrip, 2) == 0, "Short strip");
+    TEST_ASSERT(dxvkXfbPrimitiveCount(DxvkXfbTopology::LineStrip, 1) == 0, "Short line strip");
+
+    // Odd strip triangles are (p, p+2, p+1)
+    const uint32_t strip[4][3] = { { 0, 1, 2 }, { 1, 3, 2 }, { 2, 3, 4 }, { 3, 5, 4 } };
+
+    for (uint32_t p = 0; p < 4; p++) {
+        for (uint32_t k = 0; k < 3; k++)
+            TEST_ASSERT(dxvkXfbPrimitiveVertex(DxvkXfbTopology::TriangleStrip, p, k) == strip[p][k], "Strip order");
+    }
+
+    TEST_ASSERT(dxvkXfbPrimitiveVertex(DxvkXfbTopology::TriangleFan, 2, 0) == 3
+             && dxvkXfbPrimitiveVertex(DxvkXfbTopology::TriangleFan, 2, 1) == 4
+             && dxvkXfbPrimitiveVertex(DxvkXfbTopology::TriangleFan, 2, 2) == 0, "Fan order");
+    TEST_ASSERT(dxvkXfbPrimitiveVertex(DxvkXfbTopology::LineList, 3, 1) == 7, "Line list order");
+    TEST_ASSERT(dxvkXfbPrimitiveVertex(DxvkXfbTopology::LineStrip, 3, 1) == 4, "Line strip order");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Direct draws
+ * ============================================ */
+int test_xfb_emu_direct(void) {
+    printf("TEST: xfb_emu_direct\n");
+
+    DxvkXfbEmulation xfb;
+    xfb.bindBuffer(0, 1024, 16);
+    xfb.bindBuffer(1, 1024, 8);
+
+    // Not capturing, nothing to do
+    DxvkXfbDrawArgs args = xfb.draw(triangles(6));
+    TEST_ASSERT(args.primitiveCount == 0 && !args.resolve, "Draw outside a section");
+
+    TEST_ASSERT(!xfb.begin(0, nullptr), "Begin without counters");
+    TEST_ASSERT(xfb.isActive(), "Not active");
+
+    args = xfb.draw(triangles(6));
+    TEST_ASSERT(args.mode == DxvkXfbEmulationMode::Direct, "Direct mode");
+    TEST_ASSERT(!args.resolve && !args.upload, "Resolved on the GPU");
+    TEST_ASSERT(args.primitiveCount == 2 && args.primitiveLimit == 2, "First draw counts");
+    TEST_ASSERT(args.primitiveVertices == 3, "Primitive vertices");
+    TEST_ASSERT(args.offsets[0] == 0 && args.offsets[1] == 0, "First draw offsets");
+
+    // 2 triangles of 3 vertices advanced both buffers by their stride
+    DxvkXfbDrawInfo strip;
+    strip.topology = DxvkXfbTopology::TriangleStrip;
+    strip.vertexCount = 5;
+    strip.instanceCount = 2;
+
+    args = xfb.draw(strip);
+    TEST_ASSERT(args.primitiveCount == 6 && args.primitiveLimit == 6, "Instanced strip counts");
+    TEST_ASSERT(args.offsets[0] == 96 && args.offsets[1] == 48, "Second draw offsets");
+    TEST_ASSERT(xfb.getOffset(0) == 96 + 288 && xfb.getOffset(1) == 48 + 144, "Final offsets");
+    TEST_ASSERT(xfb.getOffset(2) == 0, "Unbound buffer moved");
+
+    DxvkXfbCounter counters[2];
+    xfb.end(2, counters);
+    TEST_ASSERT(!xfb.isActive(), "Still active");
+    TEST_ASSERT(counters[0].known && counters[0].offset == 384, "Counter 0");
+    TEST_ASSERT(counters[1].known && counters[1].offset == 192, "Counter 1");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Overflow
+ * ============================================ */
+int test_xfb_emu_overflow(void) {
+    printf("TEST: xfb_emu_overflow\n");
+
+    // Room for 2.5 triangles in buffer 0, 10 in buffer 1
+    DxvkXfbEmulation xfb;
+    xfb.bindBuffer(0, 120, 16);
+    xfb.bindBuffer(1, 240, 8);
+    xfb.begin(0, nullptr);
+
+    TEST_ASSERT(xfb.getPrimitiveLimit(3) == 2, "Limit is the smallest buffer's");
+
+    xfb.beginQuery();
+    DxvkXfbDrawArgs args = xfb.draw(triangles(12));
+    TEST_ASSERT(args.primitiveCount == 4 && args.primitiveLimit == 2, "Clamped to whole primitives");
+    TEST_ASSERT(xfb.getOffset(0) == 96 && xfb.getOffset(1) == 48, "Offsets after overflow");
+
+    // Once full, nothing more is written
+    args = xfb.draw(triangles(3));
+    TEST_ASSERT(args.primitiveCount == 1 && args.primitiveLimit == 0, "Written into a full buffer");
+    TEST_ASSERT(xfb.getOffset(0) == 96, "Offset moved when full");
+
+    // Smaller primitives may still fit
+    DxvkXfbDrawInfo points;
+    points.topology = DxvkXfbTopology::PointList;
+    points.vertexCount = 4;
+    args = xfb.draw(points);
+    TEST_ASSERT(args.primitiveLimit == 1 && xfb.getOffset(0) == 112, "Point after triangles");
+
+    DxvkXfbQueryResult result = xfb.endQuery();
+    TEST_ASSERT(result.primitivesWritten == 3, "Written count");
+    TEST_ASSERT(result.primitivesNeeded == 9, "Needed count");
+
+    // Buffers the stage does not write never limit it
+    DxvkXfbEmulation unused;
+    unused.bindBuffer(0, 0, 0);
+    unused.bindBuffer(1, 48, 16);
+    unused.begin(0, nullptr);
+    TEST_ASSERT(unused.getPrimitiveLimit(3) == 1, "Unwritten buffer limits");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Pause and resume
+ * ============================================ */
+int test_xfb_emu_pause_resume(void) {
+    printf("TEST: xfb_emu_pause_resume\n");
+
+    DxvkXfbEmulation xfb;
+    xfb.bindBuffer(0, 1024, 16);
+    xfb.begin(0, nullptr);
+    xfb.draw(triangles(3));
+
+    DxvkXfbCounter counter;
+    xfb.end(1, &counter);
+    TEST_ASSERT(counter.known && counter.offset == 48, "Paused counter");
+
+    // Resuming continues where the section stopped
+    TEST_ASSERT(!xfb.begin(1, &counter), "Known counter needs a copy");
+    DxvkXfbDrawArgs args = xfb.draw(triangles(3));
+    TEST_ASSERT(args.offsets[0] == 48 && !args.resolve, "Resumed offset");
+    TEST_ASSERT(xfb.getOffset(0) == 96, "Offset after resume");
+
+    // Beginning without counters restarts at 0
+    xfb.end(0, nullptr);
+    xfb.begin(0, nullptr);
+    TEST_ASSERT(xfb.getOffset(0) == 0, "Restart offset");
+    xfb.end(0, nullptr);
+
+    // A counter we have no value for is loaded on the GPU
+    DxvkXfbCounter foreign;
+    TEST_ASSERT(xfb.begin(1, &foreign), "Unknown counter not loaded");
+    args = xfb.draw(triangles(3));
+    TEST_ASSERT(args.resolve && !args.upload, "Draw after unknown counter");
+
+    xfb.end(1, &counter);
+    TEST_ASSERT(!counter.known, "Counter known after GPU draw");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: GPU resolve
+ * ============================================ */
+int test_xfb_emu_gpu_resolve(void) {
+    printf("TEST: xfb_emu_gpu_resolve\n");
+
+    DxvkXfbEmulation xfb;
+    xfb.bindBuffer(0, 1024, 16);
+    xfb.begin(0, nullptr);
+    xfb.draw(triangles(6));
+
+    // A geometry stage emits any number of primitives
+    DxvkXfbDrawInfo gs = triangles(6);
+    gs.geometryVertices = 1;
+
+    DxvkXfbDrawArgs args = xfb.draw(gs);
+    TEST_ASSERT(args.mode == DxvkXfbEmulationMode::Atomic, "Geometry stage not atomic");
+    TEST_ASSERT(args.resolve && args.upload, "First GPU draw");
+    TEST_ASSERT(args.primitiveCount == 2 && args.primitiveVertices == 1, "Geometry draw counts");
+    TEST_ASSERT(args.offsets[0] == 96, "Uploaded offset");
+
+    // Offsets now live on the GPU, later draws follow them
+    args = xfb.draw(triangles(3));
+    TEST_ASSERT(args.mode == DxvkXfbEmulationMode::Direct, "Plain draw not direct");
+    TEST_ASSERT(args.resolve && !args.upload, "Draw after GPU draw");
+
+    xfb.end(0, nullptr);
+
+    // Indirect draws have no count on the CPU
+    xfb.begin(0, nullptr);
+    DxvkXfbDrawInfo indirect = triangles(0);
+    indirect.indirect = true;
+
+    args = xfb.draw(indirect);
+    TEST_ASSERT(args.mode == DxvkXfbEmulationMode::Direct, "Indirect draw not direct");
+    TEST_ASSERT(args.resolve && args.upload && args.primitiveCount == 0, "Indirect draw");
+
+    DxvkXfbCounter counter;
+    xfb.end(1, &counter);
+    TEST_ASSERT(!counter.known, "Counter known");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Test: Queries
+ * ============================================ */
+int test_xfb_emu_query(void) {
+    printf("TEST: xfb_emu_query\n");
+
+    DxvkXfbEmulation xfb;
+    xfb.bindBuffer(0, 1024, 16);
+    xfb.begin(0, nullptr);
+    xfb.draw(triangles(9));
+
+    // Queries count from their own begin, across sections
+    xfb.beginQuery();
+    xfb.draw(triangles(6));
+    DxvkXfbCounter counter;
+    xfb.end(1, &counter);
+    xfb.draw(triangles(30));
+    xfb.begin(1, &counter);
+    xfb.draw(triangles(3));
+
+    DxvkXfbQueryResult result = xfb.endQuery();
+    TEST_ASSERT(result.primitivesWritten == 3 && result.primitivesNeeded == 3, "CPU query");
+    TEST_ASSERT(!result.gpu, "CPU query needs GPU counts");
+
+    DxvkXfbDrawInfo gs = triangles(3);
+    gs.geometryVertices = 3;
+
+    xfb.beginQuery();
+    xfb.draw(gs);
+    result = xfb.endQuery();
+    TEST_ASSERT(result.gpu && result.primitivesWritten == 0, "GPU query");
+
+    printf("  PASSED\n");
+    return 1;
+}
+
+/* ============================================
+ * Main
+ * ============================================ */
+int main(int argc, char** argv) {
+    (void)argc; (void)argv;
+
+    printf("========================================\n");
+    printf("Transform Feedback Emulation Test Suite\n");
+    printf("========================================\n\n");
+
+    int passed = 0;
+    int failed = 0;
+    int total = 6;
+
+    if (test_xfb_emu_topology()) passed++; else failed++;
+    if (test_xfb_emu_direct()) passed++; else failed++;
+    if (test_xfb_emu_overflow()) passed++; else failed++;
+    if (test_xfb_emu_pause_resume()) passed++; else failed++;
+    if (test_xfb_emu_gpu_resolve()) passed++; else failed++;
+    if (test_xfb_emu_query()) passed++; else failed++;
+
+    printf("\n========================================\n");
+    printf("Results: %d/%d PASSED, %d FAILED\n", passed, total, failed);
+    printf("========================================\n");
+
+    if (failed == 0) {
+        printf("PASSED\n");
+        return 0;
+    } else {
+        printf("FAILED\n");
+        return 1;
+    }
+}
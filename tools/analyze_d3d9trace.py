@@ -1,5 +1,15 @@
 #!/usr/bin/env python3
-"""Analyze D3D9 trace files captured by the replay recorder."""
+"""Analyze D3D9 trace files captured by the replay recorder.
+
+Usage:
+  python analyze_d3d9trace.py [--dump-shaders DIR]
+
+--dump-shaders writes the bytecode of every vertex and pixel shader in the
+traces to DIR as vs_<id>.dxso / ps_<id>.dxso (deduplicated by content), for
+tests/bench/bench_float_emulation --shaders DIR. DIR/creates.txt lists the
+file of every shader object in creation order, duplicates included, for
+tests/bench/bench_shader_intern --shaders DIR.
+"""
 
 import struct
 import sys
@@ -199,6 +209,34 @@ def read_resource_entry(f):
 
     return entry
 
+def dump_shaders(filepath, resources, out_dir, seen, creates):
+    """Write shader bytecode of one trace to out_dir, skipping duplicates.
+
+    seen maps bytecode to its file name. Every shader object not seen in an
+    earlier trace is appended to creates, so duplicates show up there once
+    per object that was created with the same bytecode.
+    """
+    written = 0
+    with open(filepath, 'rb') as f:
+        for res in resources:
+            if res['type'] not in (5, 6) or not res['dataOffset']:
+                continue
+            key = (res['type'], res['id'])
+            if key in creates['objects']:
+                continue
+            f.seek(res['dataOffset'])
+            code = f.read(res['dataSize'])
+            if len(code) != res['dataSize']:
+                continue
+            creates['objects'].add(key)
+            if code not in seen:
+                prefix = 'vs' if res['type'] == 5 else 'ps'
+                seen[code] = f"{prefix}_{res['id']}.dxso"
+                (out_dir / seen[code]).write_bytes(code)
+                written += 1
+            creates['order'].append(seen[code])
+    return written
+
 def analyze_trace(filepath):
     """Analyze a single trace file."""
     print(f"\n{'='*60}")
@@ -297,6 +335,14 @@ def analyze_trace(filepath):
         return result
 
 def main():
+    dump_dir = None
+    if len(sys.argv) == 3 and sys.argv[1] == '--dump-shaders':
+        dump_dir = Path(sys.argv[2])
+        dump_dir.mkdir(parents=True, exist_ok=True)
+    elif len(sys.argv) != 1:
+        print(__doc__)
+        return
+
     traces_dir = Path("traces")
     if not traces_dir.exists():
         print("No traces directory found")
@@ -315,6 +361,17 @@ def main():
         if result:
             results.append((trace_file, result))
 
+    if dump_dir:
+        seen = {}
+        creates = {'objects': set(), 'order': []}
+        written = sum(dump_shaders(t, r['resources'], dump_dir, seen, creates) for t, r in results)
+        (dump_dir / "creates.txt").write_text("".join(f"{name}\n" for name in creates['order']))
+        order = creates['order']
+        sizes = {name: len(code) for code, name in seen.items()}
+        dup_bytes = sum(sizes[name] for name in order) - sum(sizes.values())
+        print(f"\nWrote {written} unique shaders to {dump_dir}")
+        print(f"  {len(order)} shader objects, {len(order) - written} duplicate bytecode ({dup_bytes:,} bytes)")
+
     # Summary comparison
     print(f"\n{'='*60}")
     print("SUMMARY - Batching Opportunity Analysis")
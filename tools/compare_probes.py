@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""Compare two probe_vulkan JSON results.
+
+Rows are matched by section and their size key (command_buffers,
+bindings, ops); every *_us median is compared. A row is a regression
+when the new median is more than THRESHOLD times the baseline. Rows
+the baseline has but the new run lacks, e.g. a probe that failed or
+was skipped, are listed as missing.
+
+Usage:
+  python3 tools/compare_probes.py BASELINE.json NEW.json [--threshold 1.25]
+
+Exits 1 if any regression or missing row is found.
+"""
+
+import json
+import sys
+
+SECTIONS = {
+    'submit': 'command_buffers',
+    'descriptors': 'bindings',
+    'pipelines': 'ops',
+}
+
+
+def load(path):
+    with open(path) as f:
+        return json.load(f)
+
+
+def rows(result):
+    """Yields (label, metric, median) for every timed value."""
+    for section, key in SECTIONS.items():
+        for row in result.get(section) or []:
+            for metric, value in row.items():
+                if metric.endswith('_us'):
+                    yield f"{section} {key}={row[key]}", metric, value['median']
+
+    present = result.get('present') or {}
+    for metric, value in present.items():
+        if metric.endswith('_us'):
+            yield 'present', metric, value['median']
+
+
+def compare(baseline, new, threshold):
+    """Returns (regressions, missing rows)."""
+    base = {(label, metric): median for label, metric, median in rows(baseline)}
+    seen = set()
+    regressions = 0
+
+    print(f"{'Probe':<28} {'Metric':<14} {'Base us':>11} {'New us':>11} {'Ratio':>7}")
+    print('-' * 75)
+
+    for label, metric, median in rows(new):
+        old = base.get((label, metric))
+        if old is None:
+            continue
+        seen.add((label, metric))
+
+        ratio = median / old if old > 0 else 1.0
+        flag = ''
+        if ratio > threshold:
+            flag = '  REGRESSION'
+            regressions += 1
+
+        print(f"{label:<28} {metric:<14} {old:>11.3f} {median:>11.3f} {ratio:>6.2f}x{flag}")
+
+    missing = [key for key in base if key not in seen]
+    for label, metric in missing:
+        print(f"{label:<28} {metric:<14} {base[(label, metric)]:>11.3f} {'-':>11} {'':>7}  MISSING")
+
+    return regressions, len(missing)
+
+
+def main():
+    args = sys.argv[1:]
+    threshold = 1.25
+
+    if '--threshold' in args:
+        i = args.index('--threshold')
+        threshold = float(args[i + 1])
+        del args[i:i + 2]
+
+    if len(args) != 2:
+        print(__doc__)
+        sys.exit(1)
+
+    baseline, new = load(args[0]), load(args[1])
+
+    for name, result in (('baseline', baseline), ('new', new)):
+        print(f"{name:<9} {result.get('device', '?')} ({result.get('device_type', '?')}, "
+              f"Vulkan {result.get('api_version', '?')})")
+
+    if baseline.get('device') != new.get('device'):
+        print("Warning: different devices, ratios are not meaningful")
+    print()
+
+    regressions, missing = compare(baseline, new, threshold)
+
+    print()
+    if missing:
+        print(f"{missing} rows missing from the new run")
+    if regressions:
+        print(f"{regressions} regressions over {threshold:.2f}x")
+    if regressions or missing:
+        sys.exit(1)
+    print(f"No regressions over {threshold:.2f}x")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,746 @@
+#!/usr/bin/env python3
+"""Offline SPIR-V -> MSL translation benchmark and cache builder.
+
+MoltenVK runs SPIRV-Cross on every pipeline compile. That translation is
+pure CPU work, so we can benchmark it (and pre-build its output) on any
+machine from the SPIR-V DXVK generates for our shaders.
+
+Collect the SPIR-V first by running the game with DXVK's shader dump enabled:
+  make run-shaderdump
+
+This writes one .spv per DxsoCompiler shader (VS_*/PS_*) and per fixed-function
+shader (FF_*) to shader-dump/. Then translate everything with MoltenVK's options:
+  make msl-cache
+
+To measure how much a deduplicating translation cache would save during
+pipeline compiles, replay the pipelines DXVK logged during that same run
+(run-shaderdump logs at debug level, which includes each pipeline's stages):
+  make msl-cache-bench
+
+To ship the translated cache to the runtime, pack it into the single mmapped
+cache file format read by src/dxvk/dxvk_cache_file.h:
+  make msl-cache-pack
+
+Usage:
+  python msl_cache.py build <spirv_dir> [--cache DIR] [--spirv-cross PATH]
+                                        [--force] [--output results.json]
+  python msl_cache.py bench <spirv_dir> <dxvk_log> [--jobs N] [--no-baseline]
+                                        [--output results.json]
+  python msl_cache.py pack [--cache DIR] [--output msl-cache.dxcf]
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from collections import defaultdict
+from concurrent.futures import Future, ThreadPoolExecutor
+from pathlib import Path
+
+SPIRV_MAGIC = 0x07230203
+
+# SPIRV-Cross CLI options matching how MoltenVK (f79c6c56) configures
+# CompilerMSL for our setup. Part of the cache key, so any change here
+# invalidates previously cached translations.
+MVK_MSL_ARGS = [
+    '--msl',
+    '--msl-version', '30100',       # Apple9 GPUs (M4) default to MSL 3.1
+    '--msl-argument-buffers',       # MVK_CONFIG_USE_METAL_ARGUMENT_BUFFERS=1
+    '--msl-decoration-binding',
+    '--msl-texture-buffer-native',
+    '--msl-force-native-arrays',
+    '--msl-pad-fragment-output',
+]
+
+CACHE_INDEX = 'index.json'
+
+
+def find_spirv_cross(explicit=None):
+    """Locate the spirv-cross CLI (explicit path, project build, then PATH)."""
+    candidates = []
+    if explicit:
+        candidates.append(Path(explicit))
+    project_dir = Path(__file__).resolve().parent.parent
+    candidates.append(project_dir / 'SPIRV-Cross' / 'build' / 'spirv-cross')
+
+    for candidate in candidates:
+        if candidate.is_file() and os.access(candidate, os.X_OK):
+            return str(candidate.resolve())
+
+    for path_dir in os.environ.get('PATH', '').split(os.pathsep):
+        candidate = Path(path_dir) / 'spirv-cross'
+        if candidate.is_file() and os.access(candidate, os.X_OK):
+            return str(candidate)
+
+    return None
+
+
+def shader_origin(name):
+    """Classify a dumped shader by the DXVK compiler that produced it."""
+    if name.startswith('FF_'):
+        return 'fixed-function'
+    if name.startswith(('VS_', 'PS_')):
+        return 'dxso'
+    return 'other'
+
+
+def collect_spirv(spirv_dir, unique=True):
+    """Collect all valid SPIR-V modules below spirv_dir.
+
+    Returns a list of dicts with name, path, origin, code and content hash.
+    With unique set, modules with identical code are only returned once.
+    """
+    modules = []
+    seen = set()
+
+    for path in sorted(Path(spirv_dir).rglob('*.spv')):
+        code = path.read_bytes()
+        if len(code) < 20 or int.from_bytes(code[:4], 'little') != SPIRV_MAGIC:
+            print(f"  Skipping {path.name}: not a SPIR-V module")
+            continue
+
+        digest = hashlib.sha256(code).hexdigest()
+        if unique and digest in seen:
+            continue
+        seen.add(digest)
+
+        modules.append({
+            'name': path.stem,
+            'path': str(path),
+            'origin': shader_origin(path.stem),
+            'code': code,
+            'spirv_hash': digest,
+        })
+
+    return modules
+
+
+def cache_key(spirv_hash, msl_args, binding_map=None):
+    """Content-addressed cache key: SPIR-V hash plus translation options.
+
+    MoltenVK hands the pipeline layout's resource bindings to CompilerMSL,
+    so the same SPIR-V can translate differently under another layout.
+    Callers translating on behalf of a pipeline pass its binding map.
+    """
+    h = hashlib.sha256()
+    h.update(bytes.fromhex(spirv_hash))
+    h.update('\0'.join(msl_args).encode())
+    if binding_map is not None:
+        h.update(b'\0bindings\0')
+        h.update(repr(binding_map).encode())
+    return h.hexdigest()
+
+
+def cache_path(cache_dir, key):
+    return Path(cache_dir) / key[:2] / f"{key}.metal"
+
+
+def measure_spawn_overhead(spirv_cross, runs=5):
+    """Median cost of starting spirv-cross without translating anything.
+
+    Subtracted from per-shader timings so the report shows translation
+    time rather than process startup.
+    """
+    samples = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run([spirv_cross, '--revision'],
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        samples.append((time.perf_counter() - start) * 1e6)
+    return statistics.median(samples)
+
+
+def translate(spirv_cross, module, msl_args, out_path):
+    """Run one SPIR-V -> MSL translation. Returns (ok, wall_us, stderr)."""
+    out_path.parent.mkdir(parents=True, exist_ok=True)
+
+    # One temp file per call: uncached replays translate the same module
+    # on several threads at once, and a shared name would race
+    with tempfile.NamedTemporaryFile(dir=out_path.parent, prefix=out_path.name + '.',
+                                     suffix='.tmp', delete=False) as tmp:
+        tmp_path = Path(tmp.name)
+
+    start = time.perf_counter()
+    result = subprocess.run(
+        [spirv_cross, module['path'], *msl_args, '--output', str(tmp_path)],
+        stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    wall_us = (time.perf_counter() - start) * 1e6
+
+    if result.returncode != 0:
+        tmp_path.unlink(missing_ok=True)
+        return False, wall_us, result.stderr.strip()
+
+    # Atomic rename so a partially written file never looks like a cache hit
+    os.replace(tmp_path, out_path)
+    return True, wall_us, ''
+
+
+def load_index(cache_dir):
+    index_path = Path(cache_dir) / CACHE_INDEX
+    if index_path.exists():
+        with open(index_path) as f:
+            return json.load(f)
+    return {'msl_args': MVK_MSL_ARGS, 'entries': {}}
+
+
+def save_index(cache_dir, index):
+    index_path = Path(cache_dir) / CACHE_INDEX
+    tmp_path = index_path.with_suffix('.json.tmp')
+    with open(tmp_path, 'w') as f:
+        json.dump(index, f, indent=2, sort_keys=True)
+    os.replace(tmp_path, index_path)
+
+
+def fmt_us(us):
+    if us >= 1000:
+        return f"{us/1000:.2f}ms"
+    return f"{us:.0f}µs"
+
+
+def build_cache(spirv_dir, cache_dir, spirv_cross, force=False, output=None):
+    """Translate every collected module and populate the MSL cache."""
+    print("=" * 70)
+    print("SPIR-V -> MSL TRANSLATION BENCHMARK")
+    print("=" * 70)
+    print(f"SPIR-V source: {spirv_dir}")
+    print(f"MSL cache:     {cache_dir}")
+    print(f"spirv-cross:   {spirv_cross}")
+    print(f"Options:       {' '.join(MVK_MSL_ARGS)}")
+
+    modules = collect_spirv(spirv_dir)
+    if not modules:
+        print("\nNo SPIR-V modules found.")
+        print("Run: make run-shaderdump first")
+        return None
+
+    origins = defaultdict(int)
+    for module in modules:
+        origins[module['origin']] += 1
+    print(f"\nUnique modules: {len(modules)} "
+          f"({', '.join(f'{k}: {v}' for k, v in sorted(origins.items()))})")
+
+    Path(cache_dir).mkdir(parents=True, exist_ok=True)
+    index = load_index(cache_dir)
+
+    spawn_us = measure_spawn_overhead(spirv_cross)
+    print(f"Process spawn overhead (subtracted): {fmt_us(spawn_us)}")
+
+    results = []
+    hits = 0
+    failures = []
+
+    for i, module in enumerate(modules, 1):
+        key = cache_key(module['spirv_hash'], MVK_MSL_ARGS)
+        out_path = cache_path(cache_dir, key)
+
+        if not force and out_path.exists() and key in index['entries']:
+            hits += 1
+            continue
+
+        ok, wall_us, err = translate(spirv_cross, module, MVK_MSL_ARGS, out_path)
+        if not ok:
+            failures.append((module['name'], err.splitlines()[0] if err else 'unknown error'))
+            continue
+
+        translate_us = max(0.0, wall_us - spawn_us)
+        entry = {
+            'name': module['name'],
+            'origin': module['origin'],
+            'spirv_hash': module['spirv_hash'],
+            'spirv_size': len(module['code']),
+            'msl_size': out_path.stat().st_size,
+            'translate_us': round(translate_us, 1),
+        }
+        index['entries'][key] = entry
+        results.append(entry)
+
+        if i % 100 == 0:
+            print(f"  {i}/{len(modules)} translated...")
+
+    index['msl_args'] = MVK_MSL_ARGS
+    save_index(cache_dir, index)
+
+    print(f"\nTranslated: {len(results)}  Cache hits: {hits}  Failed: {len(failures)}")
+
+    if results:
+        times = sorted(r['translate_us'] for r in results)
+        total = sum(times)
+        p95 = times[min(len(times) - 1, int(len(times) * 0.95))]
+
+        print("\n" + "=" * 70)
+        print("TRANSLATION TIME")
+        print("=" * 70)
+        print(f"  Total:  {fmt_us(total)}")
+        print(f"  Mean:   {fmt_us(total / len(times))}")
+        print(f"  Median: {fmt_us(statistics.median(times))}")
+        print(f"  P95:    {fmt_us(p95)}")
+        print(f"  Max:    {fmt_us(times[-1])}")
+
+        by_origin = defaultdict(list)
+        for r in results:
+            by_origin[r['origin']].append(r['translate_us'])
+        print(f"\n  {'Origin':<16} {'Count':>7} {'Mean':>10} {'Max':>10}")
+        for origin, values in sorted(by_origin.items()):
+            print(f"  {origin:<16} {len(values):>7} "
+                  f"{fmt_us(sum(values) / len(values)):>10} {fmt_us(max(values)):>10}")
+
+        print("\n" + "=" * 70)
+        print("SLOWEST SHADERS")
+        print("=" * 70)
+        print(f"{'Shader':<48} {'SPIR-V':>8} {'MSL':>8} {'Time':>10}")
+        print("-" * 78)
+        for r in sorted(results, key=lambda r: r['translate_us'], reverse=True)[:20]:
+            print(f"{r['name'][:48]:<48} {r['spirv_size']:>8} {r['msl_size']:>8} "
+                  f"{fmt_us(r['translate_us']):>10}")
+
+    if failures:
+        print("\n" + "=" * 70)
+        print(f"FAILED TRANSLATIONS - {len(failures)}")
+        print("=" * 70)
+        for name, err in failures[:20]:
+            print(f"  {name}: {err[:100]}")
+
+    report = {
+        'msl_args': MVK_MSL_ARGS,
+        'spawn_overhead_us': round(spawn_us, 1),
+        'modules': len(modules),
+        'translated': len(results),
+        'cache_hits': hits,
+        'failed': [name for name, _ in failures],
+        'shaders': results,
+    }
+
+    if output:
+        with open(output, 'w') as f:
+            json.dump(report, f, indent=2)
+        print(f"\nResults saved to: {output}")
+
+    return report
+
+
+# Cache file layout, must match src/dxvk/dxvk_cache_file.h:
+#   header: magic "DXCF", version, entryCount, reserved,
+#           indexOffset, dataOffset, dataSize
+#   index:  entryCount x (keyLo, keyHi, offset, size, crc32c), sorted by key
+#   data:   entry blobs
+CACHE_FILE_HEADER = struct.Struct('<4s3I3Q')
+CACHE_FILE_ENTRY = struct.Struct('<3Q2I')
+CACHE_FILE_VERSION = 1
+
+
+def _crc32c_table():
+    table = []
+    for i in range(256):
+        crc = i
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0x82f63b78 if crc & 1 else 0)
+        table.append(crc)
+    return table
+
+
+CRC32C_TABLE = _crc32c_table()
+
+
+def crc32c(data):
+    crc = 0xffffffff
+    for b in data:
+        crc = CRC32C_TABLE[(crc ^ b) & 0xff] ^ (crc >> 8)
+    return crc ^ 0xffffffff
+
+
+def pack_cache(cache_dir, output):
+    """Pack the MSL cache directory into one cache file.
+
+    The runtime maps this file and binary searches its sorted index instead
+    of opening one .metal file per shader. Keys are the first 128 bits of
+    the content-addressed cache key.
+    """
+    print("=" * 70)
+    print("MSL CACHE PACK")
+    print("=" * 70)
+
+    index = load_index(cache_dir)
+    entries = []
+    missing = 0
+
+    for key in index['entries']:
+        path = cache_path(cache_dir, key)
+        if not path.exists():
+            missing += 1
+            continue
+        raw = bytes.fromhex(key)[:16]
+        lo, hi = struct.unpack('<2Q', raw)
+        entries.append(((hi, lo), path.read_bytes()))
+
+    entries.sort(key=lambda e: e[0])
+
+    index_offset = CACHE_FILE_HEADER.size
+    data_offset = index_offset + len(entries) * CACHE_FILE_ENTRY.size
+
+    table = bytearray()
+    offset = 0
+    for (hi, lo), blob in entries:
+        table += CACHE_FILE_ENTRY.pack(lo, hi, offset, len(blob), crc32c(blob))
+        offset += len(blob)
+
+    header = CACHE_FILE_HEADER.pack(b'DXCF', CACHE_FILE_VERSION, len(entries), 0,
+                                    index_offset, data_offset, offset)
+
+    output = Path(output)
+    output.parent.mkdir(parents=True, exist_ok=True)
+    tmp_path = output.with_suffix(output.suffix + '.tmp')
+    with open(tmp_path, 'wb') as f:
+        f.write(header)
+        f.write(table)
+        for _, blob in entries:
+            f.write(blob)
+    os.replace(tmp_path, output)
+
+    # Journaled entries are superseded by the freshly packed file
+    Path(str(output) + '.journal').unlink(missing_ok=True)
+
+    print(f"Entries: {len(entries)}  Missing: {missing}")
+    print(f"Size:    {data_offset + offset} bytes")
+    print(f"Written: {output}")
+
+
+# Resource kinds reported by `spirv-cross --reflect`
+REFLECT_RESOURCE_KINDS = [
+    'ubos', 'ssbos', 'textures', 'separate_images', 'separate_samplers',
+    'images', 'acceleration_structures',
+]
+
+# Dynamic uniform buffers a pipeline layout may use, the Vulkan minimum of
+# maxDescriptorSetUniformBuffersDynamic. DXVK only binds uniform buffers with
+# dynamic offsets while the whole layout fits, so this depends on the other
+# stages of the pipeline too.
+MAX_DYNAMIC_UNIFORM_BUFFERS = 8
+
+# DXVK logs the stages of every graphics pipeline it compiles at debug level:
+#   debug:   vs  : VS_0123abcd...
+#   debug:   fs  : PS_4567ef01...
+PIPELINE_STAGE_RE = re.compile(r'^(?:\w+:)?\s+(vs|tcs|tes|gs|fs|cs)\s+:\s+(\S+)\s*$')
+
+
+def parse_pipelines(log_path):
+    """Parse the stage sets of compiled pipelines from a DXVK debug log.
+
+    Consecutive stage lines form one pipeline. Returns a list of tuples of
+    shader names in stage order.
+    """
+    pipelines = []
+    current = []
+
+    with open(log_path, 'r', errors='ignore') as f:
+        for line in f:
+            match = PIPELINE_STAGE_RE.match(line.rstrip('\n'))
+            if match:
+                current.append(match.group(2))
+                continue
+            if current:
+                pipelines.append(tuple(current))
+                current = []
+
+    if current:
+        pipelines.append(tuple(current))
+
+    return pipelines
+
+
+def reflect_bindings(spirv_cross, module):
+    """Descriptor bindings used by a module, as sorted (set, binding, kind) tuples."""
+    result = subprocess.run(
+        [spirv_cross, module['path'], '--reflect'],
+        stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+    if result.returncode != 0:
+        return ()
+
+    try:
+        reflection = json.loads(result.stdout)
+    except json.JSONDecodeError:
+        return ()
+
+    bindings = set()
+    for kind in REFLECT_RESOURCE_KINDS:
+        for resource in reflection.get(kind, []):
+            if 'binding' in resource:
+                bindings.add((resource.get('set', 0), resource['binding'], kind))
+    return tuple(sorted(bindings))
+
+
+def layout_args(binding_map):
+    """SPIRV-Cross options describing a pipeline's binding map.
+
+    The CLI cannot take MoltenVK's full resource binding table, so this
+    passes the part of the layout that changes the generated MSL: which
+    uniform buffers are dynamic.
+    """
+    ubos = [(s, b) for s, b, kind in binding_map if kind == 'ubos']
+    if len(ubos) > MAX_DYNAMIC_UNIFORM_BUFFERS:
+        return []
+
+    args = []
+    for desc_set, binding in ubos:
+        args += ['--msl-dynamic-buffer', str(desc_set), str(binding)]
+    return args
+
+
+class TranslationCache:
+    """In-process SPIR-V -> MSL translation cache with single-flight deduplication.
+
+    Keyed on (SPIR-V hash, pipeline binding map). The first request for a key
+    performs the translation; concurrent requests for the same key block on
+    that translation's future instead of translating again.
+    """
+
+    def __init__(self, translate_fn):
+        self._translate = translate_fn
+        self._lock = threading.Lock()
+        self._entries = {}
+
+        self.requests = 0
+        self.translations = 0
+        self.hits = 0       # key already translated
+        self.waits = 0      # key in flight on another thread
+
+    def get(self, key, *args):
+        with self._lock:
+            self.requests += 1
+            future = self._entries.get(key)
+            owner = future is None
+
+            if owner:
+                future = Future()
+                self._entries[key] = future
+                self.translations += 1
+            elif future.done():
+                self.hits += 1
+            else:
+                self.waits += 1
+
+        if owner:
+            try:
+                future.set_result(self._translate(*args))
+            except Exception as e:
+                future.set_exception(e)
+
+        return future.result()
+
+    @property
+    def avoided(self):
+        return self.hits + self.waits
+
+
+def replay_pipelines(pipelines, modules_by_name, binding_maps, spirv_cross,
+                     out_dir, jobs, use_cache):
+    """Compile every pipeline's stages like MoltenVK would, optionally cached.
+
+    Pipelines are compiled concurrently on `jobs` threads, and the stages of
+    each pipeline are translated in parallel on a separate stage pool.
+    Returns (wall_seconds, TranslationCache or None, translation count, failures).
+    """
+    translation_count = [0]
+    count_lock = threading.Lock()
+
+    def do_translate(module, key, binding_map):
+        with count_lock:
+            translation_count[0] += 1
+        out_path = Path(out_dir) / f"{key}.metal"
+        msl_args = MVK_MSL_ARGS + layout_args(binding_map)
+        ok, _, err = translate(spirv_cross, module, msl_args, out_path)
+        if not ok:
+            raise RuntimeError(f"{module['name']}: {err.splitlines()[0] if err else 'failed'}")
+        return out_path
+
+    cache = TranslationCache(do_translate) if use_cache else None
+    failures = []
+
+    with ThreadPoolExecutor(max_workers=jobs) as stage_pool, \
+         ThreadPoolExecutor(max_workers=jobs) as pipeline_pool:
+
+        def translate_stage(module, binding_map):
+            key = cache_key(module['spirv_hash'], MVK_MSL_ARGS, binding_map)
+            if cache:
+                return cache.get(key, module, key, binding_map)
+            return do_translate(module, key, binding_map)
+
+        def compile_pipeline(index, stages):
+            binding_map = binding_maps[index]
+            futures = [stage_pool.submit(translate_stage, modules_by_name[name], binding_map)
+                       for name in stages]
+            for future in futures:
+                try:
+                    future.result()
+                except (RuntimeError, OSError) as e:
+                    failures.append(str(e))
+
+        start = time.perf_counter()
+        list(pipeline_pool.map(lambda p: compile_pipeline(*p), enumerate(pipelines)))
+        wall = time.perf_counter() - start
+
+    return wall, cache, translation_count[0], failures
+
+
+def bench_pipelines(spirv_dir, log_path, spirv_cross, jobs, baseline=True, output=None):
+    """Replay trace-derived pipelines through the translation cache."""
+    print("=" * 70)
+    print("PIPELINE TRANSLATION CACHE BENCHMARK")
+    print("=" * 70)
+    print(f"SPIR-V source: {spirv_dir}")
+    print(f"Pipeline log:  {log_path}")
+    print(f"Threads:       {jobs}")
+
+    # Every dumped name, duplicates included: pipelines reference stages by
+    # name, and repeated translations of identical code are what we count
+    modules = collect_spirv(spirv_dir, unique=False)
+    modules_by_name = {m['name']: m for m in modules}
+
+    all_pipelines = parse_pipelines(log_path)
+    pipelines = [p for p in all_pipelines if all(name in modules_by_name for name in p)]
+    skipped = len(all_pipelines) - len(pipelines)
+
+    if not pipelines:
+        print("\nNo pipelines with dumped stages found.")
+        print("Run the game with DXVK_LOG_LEVEL=debug and DXVK_SHADER_DUMP_PATH set.")
+        return None
+
+    print(f"\nPipelines: {len(pipelines)}" +
+          (f" ({skipped} skipped, stages missing from dump)" if skipped else ""))
+
+    # MoltenVK translates each stage against the layout of the whole pipeline,
+    # i.e. the union of all stage bindings
+    reflected = {}
+    for name in sorted({n for p in pipelines for n in p}):
+        reflected[name] = reflect_bindings(spirv_cross, modules_by_name[name])
+
+    binding_maps = [tuple(sorted({b for name in p for b in reflected[name]}))
+                    for p in pipelines]
+
+    stage_requests = sum(len(p) for p in pipelines)
+    unique_keys = {(modules_by_name[name]['spirv_hash'], binding_maps[i])
+                   for i, p in enumerate(pipelines) for name in p}
+    print(f"Stage translations requested: {stage_requests}")
+    print(f"Unique (SPIR-V, binding map) keys: {len(unique_keys)}")
+    print(f"Distinct binding maps: {len(set(binding_maps))}")
+
+    report = {
+        'pipelines': len(pipelines),
+        'stage_requests': stage_requests,
+        'unique_keys': len(unique_keys),
+        'jobs': jobs,
+    }
+
+    with tempfile.TemporaryDirectory(prefix='msl-bench-') as out_dir:
+        if baseline:
+            print("\nReplaying without cache...")
+            base_wall, _, base_count, failures = replay_pipelines(
+                pipelines, modules_by_name, binding_maps, spirv_cross, out_dir, jobs, False)
+            report['baseline'] = {'wall_s': round(base_wall, 3), 'translations': base_count}
+            print(f"  {base_count} translations in {base_wall:.2f}s")
+
+        print("\nReplaying with deduplicating cache...")
+        wall, cache, count, failures = replay_pipelines(
+            pipelines, modules_by_name, binding_maps, spirv_cross, out_dir, jobs, True)
+        report['cached'] = {
+            'wall_s': round(wall, 3),
+            'translations': count,
+            'hits': cache.hits,
+            'inflight_waits': cache.waits,
+            'avoided': cache.avoided,
+        }
+        print(f"  {count} translations in {wall:.2f}s")
+
+    print("\n" + "=" * 70)
+    print("TRANSLATION CALLS")
+    print("=" * 70)
+    print(f"  Requested:         {cache.requests}")
+    print(f"  Performed:         {cache.translations}")
+    print(f"  Avoided:           {cache.avoided} "
+          f"({100 * cache.avoided / max(1, cache.requests):.1f}%)")
+    print(f"    cache hits:      {cache.hits}")
+    print(f"    in-flight waits: {cache.waits}")
+    if baseline:
+        base_wall = report['baseline']['wall_s']
+        print(f"  Wall time:         {base_wall:.2f}s -> {wall:.2f}s "
+              f"({base_wall / max(wall, 1e-6):.1f}x)")
+
+    if failures:
+        print(f"\n  Failed translations: {len(failures)}")
+        for err in sorted(set(failures))[:10]:
+            print(f"    {err[:100]}")
+
+    if output:
+        with open(output, 'w') as f:
+            json.dump(report, f, indent=2)
+        print(f"\nResults saved to: {output}")
+
+    return report
+
+
+def main():
+    parser = argparse.ArgumentParser(description='SPIR-V -> MSL translation benchmark and cache builder')
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    build = sub.add_parser('build', help='Translate dumped SPIR-V and populate the MSL cache')
+    build.add_argument('spirv_dir', help='Directory containing .spv files (DXVK_SHADER_DUMP_PATH)')
+    build.add_argument('--cache', default='build/msl-cache', help='MSL cache directory')
+    build.add_argument('--spirv-cross', help='Path to the spirv-cross CLI')
+    build.add_argument('--force', action='store_true', help='Re-translate cached modules')
+    build.add_argument('--output', '-o', help='Save per-shader results to JSON file')
+
+    bench = sub.add_parser('bench', help='Replay logged pipelines through a deduplicating translation cache')
+    bench.add_argument('spirv_dir', help='Directory containing .spv files (DXVK_SHADER_DUMP_PATH)')
+    bench.add_argument('dxvk_log', help='DXVK log written with DXVK_LOG_LEVEL=debug')
+    bench.add_argument('--spirv-cross', help='Path to the spirv-cross CLI')
+    bench.add_argument('--jobs', '-j', type=int, default=os.cpu_count() or 4,
+                       help='Concurrent translation threads')
+    bench.add_argument('--no-baseline', action='store_true',
+                       help='Skip the uncached replay')
+    bench.add_argument('--output', '-o', help='Save results to JSON file')
+
+    pack = sub.add_parser('pack', help='Pack the MSL cache into a single mmapped cache file')
+    pack.add_argument('--cache', default='build/msl-cache', help='MSL cache directory')
+    pack.add_argument('--output', '-o', default='build/msl-cache.dxcf', help='Cache file to write')
+
+    args = parser.parse_args()
+
+    if args.command == 'pack':
+        if not (Path(args.cache) / CACHE_INDEX).exists():
+            print(f"Error: {args.cache} has no {CACHE_INDEX}")
+            print("Run: make msl-cache first")
+            sys.exit(1)
+        pack_cache(args.cache, args.output)
+        return
+
+    spirv_cross = find_spirv_cross(args.spirv_cross)
+    if not spirv_cross:
+        print("Error: spirv-cross not found")
+        print("Run: make build-spirv-cross")
+        sys.exit(1)
+
+    if args.command == 'build':
+        if not os.path.isdir(args.spirv_dir):
+            print(f"Error: {args.spirv_dir} not found")
+            print("Run: make run-shaderdump first")
+            sys.exit(1)
+        build_cache(args.spirv_dir, args.cache, spirv_cross,
+                    force=args.force, output=args.output)
+    elif args.command == 'bench':
+        for path in (args.spirv_dir, args.dxvk_log):
+            if not os.path.exists(path):
+                print(f"Error: {path} not found")
+                sys.exit(1)
+        bench_pipelines(args.spirv_dir, args.dxvk_log, spirv_cross, max(1, args.jobs),
+                        baseline=not args.no_baseline, output=args.output)
+
+
+if __name__ == '__main__':
+    main()
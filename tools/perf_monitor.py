@@ -119,8 +119,46 @@ class DxvkPerfData(ctypes.Structure):
         ("historyIndex", ctypes.c_uint32),
         ("historyFrameTimes", ctypes.c_uint32 * HISTORY_SIZE),
 
+        # Managed texture uploads (D3D9UploadScheduler), carved from reserved
+        ("uploadFrameBytes", ctypes.c_uint64),
+        ("uploadDeferredBytes", ctypes.c_uint64),
+        ("uploadBlockingBytes", ctypes.c_uint64),
+        ("uploadFrames", ctypes.c_uint32),
+        ("uploadBudgetHitFrames", ctypes.c_uint32),
+
+        # Render target readback (D3D9ReadbackRing). Copy waits and forced
+        # syncs are also accounted in cpuWaitTimeUs.
+        ("readbackSyncsAvoided", ctypes.c_uint32),
+        ("readbackSyncsForced", ctypes.c_uint32),
+
+        # Submits caused by query GetData (D3D9QueryBatchResolver early
+        # flushes and blocking waits), included in submissions
+        ("querySubmits", ctypes.c_uint32),
+
+        # Dynamic buffer discards (D3D9DiscardRing), chunk allocations
+        # and discards that waited for a slice
+        ("discardAllocations", ctypes.c_uint32),
+        ("discardStalls", ctypes.c_uint32),
+
+        # Multithreaded device lock (sync::BiasedRecursiveMutex), slow
+        # acquisitions that had to wait and owner biases revoked
+        ("deviceLockContentions", ctypes.c_uint32),
+        ("deviceLockRevocations", ctypes.c_uint32),
+
+        # CPU time per thread role (ThreadRoleRegistry) in ms: render
+        # critical, submit, background compile, I/O
+        ("threadCpuTimeMs", ctypes.c_uint32 * 4),
+
+        # Vertex input setup (D3D9VertexInputState), CPU time this frame
+        # and input layouts built since device creation
+        ("vertexInputTimeUs", ctypes.c_uint32),
+        ("vertexLayoutBuilds", ctypes.c_uint32),
+
+        # Emulated D24S8 (D3D9DepthEmulator), conversion passes this frame
+        ("depthConversions", ctypes.c_uint32),
+
         # Reserved
-        ("reserved", ctypes.c_uint8 * 256),
+        ("reserved", ctypes.c_uint8 * 168),
     ]
 
 
@@ -217,7 +255,13 @@ class PerfMonitorApp:
                 'timestamp', 'frame_time_us', 'fps', 'fps_avg',
                 'draw_calls', 'primitives', 'submissions',
                 'shaders_compiled', 'pipelines_compiled',
-                'gpu_memory_mb'
+                'gpu_memory_mb', 'upload_frame_bytes', 'upload_deferred_bytes',
+                'upload_budget_hit_frames', 'readback_syncs_avoided',
+                'readback_syncs_forced', 'query_submits',
+                'discard_allocations', 'discard_stalls',
+                'device_lock_contentions', 'device_lock_revocations',
+                'cpu_render_ms', 'cpu_submit_ms', 'cpu_compile_ms', 'cpu_io_ms',
+                'vertex_input_us', 'vertex_layout_builds', 'depth_conversions'
             ])
 
         # Data history for graphs
@@ -299,6 +343,15 @@ class PerfMonitorApp:
         self.shader_detail_label = ttk.Label(shader_frame, text="compiled: --")
         self.shader_detail_label.pack()
 
+        # Managed texture uploads
+        upload_frame = ttk.Frame(stats_frame)
+        upload_frame.pack(side=tk.LEFT, padx=20)
+        ttk.Label(upload_frame, text="Deferred Uploads", style='Header.TLabel').pack()
+        self.upload_label = ttk.Label(upload_frame, text="-- MB", style='Value.TLabel')
+        self.upload_label.pack()
+        self.upload_detail_label = ttk.Label(upload_frame, text="budget hit: --")
+        self.upload_detail_label.pack()
+
         # Graph area
         graph_frame = ttk.Frame(main_frame)
         graph_frame.pack(fill=tk.BOTH, expand=True, pady=10)
@@ -387,6 +440,12 @@ class PerfMonitorApp:
             text=f"compiled: {data.shadersCompiled} pipes: {data.pipelinesCompiled}"
         )
 
+        self.upload_label.config(text=f"{data.uploadDeferredBytes / (1024 * 1024):.1f} MB")
+        hit_rate = data.uploadBudgetHitFrames / data.uploadFrames * 100 if data.uploadFrames else 0.0
+        self.upload_detail_label.config(
+            text=f"budget hit: {hit_rate:.0f}% blocked: {data.uploadBlockingBytes / (1024 * 1024):.1f} MB"
+        )
+
         # Present mode names
         present_modes = {
             0: "IMMEDIATE",
@@ -434,7 +493,21 @@ class PerfMonitorApp:
                 data.submissions,
                 data.shadersCompiled,
                 data.pipelinesCompiled,
-                gpu_mem_mb
+                gpu_mem_mb,
+                data.uploadFrameBytes,
+                data.uploadDeferredBytes,
+                data.uploadBudgetHitFrames,
+                data.readbackSyncsAvoided,
+                data.readbackSyncsForced,
+                data.querySubmits,
+                data.discardAllocations,
+                data.discardStalls,
+                data.deviceLockContentions,
+                data.deviceLockRevocations,
+                *data.threadCpuTimeMs,
+                data.vertexInputTimeUs,
+                data.vertexLayoutBuilds,
+                data.depthConversions
             ])
 
         # Schedule next update